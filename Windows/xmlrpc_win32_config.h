@@ -40,6 +40,9 @@
 #ifndef HAVE_SETGROUPS
 #define HAVE_SETGROUPS 0
 #endif
+#ifndef HAVE_PTHREAD_SETAFFINITY_NP
+#define HAVE_PTHREAD_SETAFFINITY_NP 0
+#endif
 #ifndef HAVE_ASPRINTF
 #define HAVE_ASPRINTF 0
 #endif
@@ -75,6 +78,9 @@
 #define HAVE_SYS_FILIO_H 0
 #define HAVE_SYS_IOCTL_H 0
 #define HAVE_SYS_SELECT_H 0
+#define HAVE_SYS_EPOLL_H 0
+#define HAVE_SYS_SENDFILE_H 0
+#define HAVE_ZLIB_H 0
 
 #define VA_LIST_IS_ARRAY 0
 
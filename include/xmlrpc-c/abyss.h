@@ -258,6 +258,57 @@ void
 ServerSetMaxSessionMem(TServer * const serverP,
                        size_t    const size);
 
+#define HAVE_SERVER_SET_CONN_QUEUE_DEPTH 1
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetConnQueueDepth(TServer *    const serverP,
+                        unsigned int const connQueueDepth);
+
+#define HAVE_SERVER_SET_EVENT_DRIVEN 1
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetEventDriven(TServer *  const serverP,
+                     abyss_bool const eventDriven);
+
+#define HAVE_SERVER_SET_ACCEPTOR_COUNT 1
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetAcceptorCount(TServer *    const serverP,
+                       unsigned int const acceptorCt);
+
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetAcceptorAffinity(TServer *  const serverP,
+                          abyss_bool const pinAcceptors);
+
+#define HAVE_SERVER_SET_PREFORK 1
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetPrefork(TServer *    const serverP,
+                 unsigned int const minWorkers,
+                 unsigned int const maxWorkers,
+                 unsigned int const maxRequests);
+
+#define HAVE_SERVER_SET_LOAD_SHEDDING 1
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetLoadShedding(TServer *    const serverP,
+                      unsigned int const targetMs,
+                      unsigned int const intervalMs,
+                      unsigned int const retryAfter);
+
+#define HAVE_SERVER_SET_LOG_BUFFER 1
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetLogBuffer(TServer *    const serverP,
+                   unsigned int const bufferSize,
+                   abyss_bool   const dropWhenFull);
+
+#define HAVE_SERVER_GET_LOG_DROPPED_CT 1
+XMLRPC_ABYSS_EXPORTED
+unsigned long
+ServerGetLogDroppedCt(TServer * const serverP);
+
 XMLRPC_ABYSS_EXPORTED
 void
 ServerInit2(TServer *     const serverP,
@@ -446,6 +497,14 @@ SessionGetBody(TSession *    const sessionP,
                size_t *      const outLenP,
                const char ** const errorP);
 
+#define HAVE_SESSION_READ_BODY 1
+XMLRPC_ABYSS_EXPORTED
+void
+SessionReadBody(TSession *    const sessionP,
+                size_t        const len,
+                char *        const buffer,
+                const char ** const errorP);
+
 XMLRPC_ABYSS_EXPORTED
 abyss_bool
 SessionRefillBuffer(TSession * const sessionP);
@@ -471,10 +530,36 @@ void
 SessionGetChannelInfo(TSession * const sessionP,
                       void **    const channelInfoPP);
 
+#define HAVE_SESSION_CLIENT_GONE 1
+XMLRPC_ABYSS_EXPORTED
+abyss_bool
+SessionClientGone(TSession * const sessionP);
+
+#define HAVE_SESSION_GET_AGE_MS 1
+XMLRPC_ABYSS_EXPORTED
+xmlrpc_uint32_t
+SessionGetAgeMs(TSession * const sessionP);
+
+XMLRPC_ABYSS_EXPORTED
+void
+SessionGetHttpVersion(TSession *     const sessionP,
+                      unsigned int * const majorP,
+                      unsigned int * const minorP);
+
 XMLRPC_ABYSS_EXPORTED
 void *
 SessionGetDefaultHandlerCtx(TSession * const sessionP);
 
+#define HAVE_SESSION_DEFER_RESPONSE 1
+XMLRPC_ABYSS_EXPORTED
+void
+SessionDeferResponse(TSession *   const sessionP,
+                     abyss_bool * const deferredP);
+
+XMLRPC_ABYSS_EXPORTED
+void
+SessionFinishDeferred(TSession * const sessionP);
+
 XMLRPC_ABYSS_EXPORTED
 const char *
 RequestHeaderValue(TSession *   const sessionP,
@@ -69,6 +69,55 @@ ChanSwitchOpenSslCreateFd(int            const fd,
                           TChanSwitch ** const chanSwitchPP,
                           const char **  const errorP);
 
+struct abyss_openSsl_sessionparms {
+/*----------------------------------------------------------------------------
+   How a client may resume a TLS session on a later connection instead of
+   doing a full handshake.
+-----------------------------------------------------------------------------*/
+    unsigned int cacheSize;
+        /* Maximum number of sessions in the server-side session cache.
+           Zero means no cache.  The cache is in the memory of one process,
+           so it does nothing across the workers of a pre-forking server;
+           use tickets for that.
+        */
+    unsigned int timeout;
+        /* Seconds after a full handshake that a client may resume the
+           session, either way.  Zero means the OpenSSL default.
+        */
+    abyss_bool   tickets;
+        /* Issue stateless session tickets, which the client presents to
+           resume a session and the server needs to remember nothing for.
+        */
+    unsigned int ticketKeyLifetime;
+        /* Seconds we encrypt tickets with one key before switching to a
+           new one.  We still accept tickets made with the previous key, so
+           a ticket works for at least this long.  Zero means 3600.
+        */
+    const unsigned char * ticketSecret;
+    size_t                ticketSecretLen;
+        /* The secret from which we derive the ticket keys.  Every server
+           with the same secret accepts every other one's tickets, with no
+           communication among them.  NULL means a random secret we make
+           now, which processes forked afterward share.
+        */
+};
+
+struct abyss_openSsl_stats {
+    unsigned long fullHandshakes;
+    unsigned long resumedHandshakes;
+    unsigned long failedHandshakes;
+};
+
+void
+ChanSwitchOpenSslSetSessionParms(
+    TChanSwitch *                             const chanSwitchP,
+    const struct abyss_openSsl_sessionparms * const parmsP,
+    const char **                             const errorP);
+
+void
+ChanSwitchOpenSslGetStats(TChanSwitch *                const chanSwitchP,
+                          struct abyss_openSsl_stats * const statsP);
+
 void
 ChannelOpenSslCreateSsl(SSL *                            const sslP,
                         TChannel **                      const channelPP,
@@ -20,6 +20,13 @@ ChanSwitchUnixCreate2(int                     const protocolFamily,
                       TChanSwitch **          const chanSwitchPP,
                       const char **           const errorP);
 
+void
+ChanSwitchUnixCreateReusePort(int                     const protocolFamily,
+                              const struct sockaddr * const sockAddrP,
+                              socklen_t               const sockAddrLen,
+                              TChanSwitch **          const chanSwitchPP,
+                              const char **           const errorP);
+
 void
 ChanSwitchUnixCreateIpV6Port(unsigned short const portNumber,
                              TChanSwitch ** const chanSwitchPP,
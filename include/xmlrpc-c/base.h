@@ -134,6 +134,7 @@ typedef enum {
     XMLRPC_TYPE_C_PTR    =  8,
     XMLRPC_TYPE_NIL      =  9,
     XMLRPC_TYPE_I8       = 10,
+    XMLRPC_TYPE_PRESERIALIZED = 11,
     XMLRPC_TYPE_DEAD     = 0xDEAD
 } xmlrpc_type;
 
@@ -170,6 +171,18 @@ xmlrpc_value *
 xmlrpc_value_new(xmlrpc_env *   const envP,
                  xmlrpc_value * const sourceValP);
 
+/* Equal values (same type, same XML-RPC value; struct member order doesn't
+   matter) have equal hashes.
+*/
+XMLRPC_LIB_EXPORTED
+unsigned int
+xmlrpc_value_hash(xmlrpc_value * const valueP);
+
+XMLRPC_LIB_EXPORTED
+xmlrpc_bool
+xmlrpc_value_equal(xmlrpc_value * const aP,
+                   xmlrpc_value * const bP);
+
 XMLRPC_LIB_EXPORTED
 xmlrpc_value *
 xmlrpc_int_new(xmlrpc_env * const envP,
@@ -449,6 +462,39 @@ xmlrpc_base64_new(xmlrpc_env *          const envP,
                   size_t                const length,
                   const unsigned char * const value);
 
+/* A base64 value whose bytes are the next 'length' bytes of the file open
+   as 'fd', from its current position.  The value reads them only when
+   it needs them, e.g. a piece at a time as it serializes.  It uses a
+   duplicate of 'fd'; the caller may close 'fd' right away.  The file must
+   not change while the value exists.
+
+   This saves holding the file's bytes in memory, but not the XML that
+   contains them: serializing the value still builds its whole base64
+   text, about 4/3 the size of the file, in the XML document.
+*/
+XMLRPC_LIB_EXPORTED
+xmlrpc_value *
+xmlrpc_base64_new_fd(xmlrpc_env * const envP,
+                     int          const fd,
+                     size_t       const length);
+
+typedef void (*xmlrpc_cptr_dtor_fn)(void *, void *);
+
+/* A base64 value whose bytes are the 'length' bytes at 'value', which the
+   value uses in place, e.g. an mmap region.  When the value is destroyed,
+   it calls dtor(dtorContext, value) if 'dtor' is non-null.
+
+   As with xmlrpc_base64_new_fd(), serializing the value still builds its
+   whole base64 text in memory.
+*/
+XMLRPC_LIB_EXPORTED
+xmlrpc_value *
+xmlrpc_base64_new_mapped(xmlrpc_env *          const envP,
+                         size_t                const length,
+                         const unsigned char * const value,
+                         xmlrpc_cptr_dtor_fn   const dtor,
+                         void *                const dtorContext);
+
 XMLRPC_LIB_EXPORTED
 xmlrpc_value *
 xmlrpc_base64_new_value(xmlrpc_env *   const envP,
@@ -680,8 +726,6 @@ xmlrpc_value *
 xmlrpc_cptr_new(xmlrpc_env * const envP,
                 void *       const value);
 
-typedef void (*xmlrpc_cptr_dtor_fn)(void *, void *);
-
 XMLRPC_LIB_EXPORTED
 xmlrpc_value *
 xmlrpc_cptr_new_dtor(xmlrpc_env *        const envP,
@@ -831,6 +875,29 @@ xmlrpc_serialize_fault(xmlrpc_env *       const envP,
                        xmlrpc_mem_block * const outputP,
                        const xmlrpc_env * const faultP);
 
+/* A preserialized value is XML that the user already has for the content of
+   a <value> element (e.g. "<struct>...</struct>").  The serializer copies it
+   through verbatim.
+*/
+
+XMLRPC_LIB_EXPORTED
+xmlrpc_value *
+xmlrpc_preserialized_new(xmlrpc_env *   const envP,
+                         xmlrpc_dialect const dialect,
+                         const char *   const xml,
+                         size_t         const xmlLength);
+
+XMLRPC_LIB_EXPORTED
+xmlrpc_value *
+xmlrpc_preserialize(xmlrpc_env *   const envP,
+                    xmlrpc_value * const valueP,
+                    xmlrpc_dialect const dialect);
+
+XMLRPC_LIB_EXPORTED
+void
+xmlrpc_value_set_memoize(xmlrpc_value * const valueP,
+                         xmlrpc_bool    const memoize);
+
 
 /*=========================================================================
 **  Decoding XML
@@ -904,7 +971,9 @@ char *xmlrpc_authcookie(void);
 /* Limit IDs. There will be more of these as time goes on. */
 #define XMLRPC_NESTING_LIMIT_ID   (0)
 #define XMLRPC_XML_SIZE_LIMIT_ID  (1)
-#define XMLRPC_LAST_LIMIT_ID      (XMLRPC_XML_SIZE_LIMIT_ID)
+#define XMLRPC_SERIALIZE_THREADS_LIMIT_ID (2)
+#define XMLRPC_SERIALIZE_PARALLEL_MIN_LIMIT_ID (3)
+#define XMLRPC_LAST_LIMIT_ID      (XMLRPC_SERIALIZE_PARALLEL_MIN_LIMIT_ID)
 
 /* By default, deserialized data may be no more than 64 levels deep. */
 #define XMLRPC_NESTING_LIMIT_DEFAULT  (64)
@@ -913,6 +982,13 @@ char *xmlrpc_authcookie(void);
 ** Some client and server modules may fail to enforce this properly. */
 #define XMLRPC_XML_SIZE_LIMIT_DEFAULT (512*1024)
 
+/* The serializer may use up to this many threads to serialize the items of
+** one array, but only for an array of at least
+** XMLRPC_SERIALIZE_PARALLEL_MIN_LIMIT_ID items.  By default, it uses only
+** the caller's thread. */
+#define XMLRPC_SERIALIZE_THREADS_LIMIT_DEFAULT (1)
+#define XMLRPC_SERIALIZE_PARALLEL_MIN_LIMIT_DEFAULT (16*1024)
+
 /* Set a specific limit to the specified value. */
 XMLRPC_LIB_EXPORTED
 extern void xmlrpc_limit_set (int const limit_id, size_t const value);
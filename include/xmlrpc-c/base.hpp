@@ -62,6 +62,7 @@ public:
         TYPE_C_PTR      = 8,
         TYPE_NIL        = 9,
         TYPE_I8         = 10,
+        TYPE_PRESERIALIZED = 11,
         TYPE_DEAD       = 0xDEAD
     };
 
@@ -469,7 +470,8 @@ public:
         CODE_REQUEST_REFUSED        = -507,
         CODE_INTROSPECTION_DISABLED = -508,
         CODE_LIMIT_EXCEEDED         = -509,
-        CODE_INVALID_UTF8           = -510
+        CODE_INVALID_UTF8           = -510,
+        CODE_METHOD_BUSY            = -511
     };
 
     fault();
@@ -57,6 +57,26 @@ struct _xmlrpc_value {
             xmlrpc_cptr_dtor_fn dtor;   // NULL if none
             void *              dtorContext;
         } cptr;
+        xmlrpc_dialect dialect;
+            /* For a preserialized value: the dialect of the XML in
+               'blockP'
+            */
+        struct {
+            /* For a base64 value whose bytes are not in 'blockP' (i.e.
+               'blockP' is NULL): where they are.
+            */
+            int                   fd;
+                /* File descriptor from which to read the bytes; -1 if
+                   they are in memory at 'bytes'.  We own it.
+                */
+            xmlrpc_int64          offset;
+                /* Position in the file of the first byte */
+            size_t                size;
+            const unsigned char * bytes;
+                /* The bytes, in memory we don't own */
+            xmlrpc_cptr_dtor_fn   dtor;   // NULL if none
+            void *                dtorContext;
+        } extBytes;
     } _value;
     
     /* Other data types use a memory block.
@@ -75,7 +95,11 @@ struct _xmlrpc_value {
        contents of a <string> element (except of course that for the
        non-XML characters, we have to stretch the definition of XML).
 
-       For base64, this is bytes of the byte string, directly.
+       For base64, this is bytes of the byte string, directly -- or NULL,
+       if they are somewhere else (see _value.extBytes).
+
+       For a preserialized value, this is the XML for the content of a
+       <value> element, with no terminating NUL.
     */
     xmlrpc_mem_block * blockP;
 
@@ -101,6 +125,16 @@ struct _xmlrpc_value {
            This is essentially a cached value of the result of a
            xmlrpc_read_datetime_str_old().  NULL means nothing cached.
         */
+    bool _memoize;
+        /* The user has promised not to modify this value or anything in it
+           again, so the serializer may remember the XML it generates for it
+           (in _memo) and reuse it the next time.
+        */
+    xmlrpc_mem_block * _memo[2];
+        /* The serialized content of a <value> element for this value,
+           indexed by xmlrpc_dialect.  NULL means not generated yet.
+           Always NULL when _memoize is false.  Protected by 'lockP'.
+        */
 };
 
 #define XMLRPC_ASSERT_VALUE_OK(val) \
@@ -152,6 +186,18 @@ XMLRPC_LIBINT_EXPORTED
 void
 xmlrpc_destroyArrayContents(xmlrpc_value * const arrayP);
 
+XMLRPC_LIBINT_EXPORTED
+size_t
+xmlrpc_base64Size(const xmlrpc_value * const valueP);
+
+XMLRPC_LIBINT_EXPORTED
+void
+xmlrpc_base64Read(xmlrpc_env *         const envP,
+                  const xmlrpc_value * const valueP,
+                  size_t               const start,
+                  size_t               const len,
+                  unsigned char *      const buffer);
+
 /*----------------------------------------------------------------------------
    The following are for use by the legacy xmlrpc_parse_value().  They don't
    do proper memory management, so they aren't appropriate for general use,
@@ -127,6 +127,12 @@ struct xmlrpc_curl_xportparms {
     xmlrpc_bool  tcp_keepalive;
     unsigned int tcp_keepidle_sec;
     unsigned int tcp_keepintvl_sec;
+    unsigned int compress_level;
+        /* Zlib level 1-9 at which to gzip the call; 0 means don't */
+    size_t       compress_min_size;
+        /* Don't gzip a call smaller than this.  0 means 1024 */
+    xmlrpc_bool  accept_compressed;
+        /* Ask the server to compress the response */
 };
 
 
@@ -311,6 +311,9 @@ public:
         constrOpt & tcp_keepalive     (bool         const& arg);
         constrOpt & tcp_keepidle_sec  (unsigned int const& arg);
         constrOpt & tcp_keepintvl_sec (unsigned int const& arg);
+        constrOpt & compress_level    (unsigned int const& arg);
+        constrOpt & compress_min_size (size_t       const& arg);
+        constrOpt & accept_compressed (bool         const& arg);
 
     private:
         struct constrOpt_impl * implP;
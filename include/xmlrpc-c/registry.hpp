@@ -126,6 +126,55 @@ public:
 
 };
 
+class XMLRPC_SERVERPP_EXPORTED completion {
+/*----------------------------------------------------------------------------
+   The means to complete a call of an asynchronous method (see class
+   'asyncMethod').  Copies all refer to the same call; complete it exactly
+   once, through any of them, from any thread.
+-----------------------------------------------------------------------------*/
+public:
+    completion(xmlrpc_completion * const completionP);
+
+    void
+    complete(xmlrpc_c::value const& result) const;
+
+    void
+    fail(xmlrpc_c::fault const& fault) const;
+
+private:
+    xmlrpc_completion * completionP;
+};
+
+class XMLRPC_SERVERPP_EXPORTED asyncMethod : public method {
+/*----------------------------------------------------------------------------
+   An XML-RPC method that need not produce its result before its execute()
+   method returns.  execute() may start the work elsewhere and return;
+   whatever finishes the work completes the call via 'completion'.
+
+   The call information remains valid until then, but the parameter list
+   doesn't outlive execute(); keep a copy of whatever you need of it.
+
+   If execute() throws, it must not have completed the call; the call
+   fails.
+
+   This base class is abstract.
+-----------------------------------------------------------------------------*/
+public:
+    asyncMethod();
+
+    virtual ~asyncMethod();
+
+    virtual void
+    execute(xmlrpc_c::paramList        const& paramList,
+            const xmlrpc_c::callInfo * const  callInfoP,
+            xmlrpc_c::completion       const  completion) = 0;
+
+    void
+    execute(xmlrpc_c::paramList const& paramList,
+            xmlrpc_c::value *   const  resultP);
+        // Throws an error; only a registry can execute an asyncMethod.
+};
+
 class XMLRPC_SERVERPP_EXPORTED methodPtr : public girmem::autoObjectPtr {
 
 public:
@@ -160,6 +209,20 @@ public:
     get() const;
 };
 
+class XMLRPC_SERVERPP_EXPORTED concurrencyLimit {
+/*----------------------------------------------------------------------------
+   A limit on how many calls of a method execute at once.  A call beyond
+   the limit waits for one of them to finish, or if 'maxQueued' calls are
+   waiting already, fails with fault code fault::CODE_METHOD_BUSY.
+-----------------------------------------------------------------------------*/
+public:
+    concurrencyLimit(unsigned int const maxConcurrent,
+                     unsigned int const maxQueued = 0);
+
+    unsigned int maxConcurrent;
+    unsigned int maxQueued;
+};
+
 struct registry_impl;
 
 class XMLRPC_SERVERPP_EXPORTED registry : public girmem::autoObject {
@@ -182,6 +245,20 @@ public:
     addMethod(std::string         const name,
               xmlrpc_c::methodPtr const methodP);
 
+    void
+    addMethod(std::string                      const  name,
+              xmlrpc_c::method *               const  methodP,
+              xmlrpc_c::concurrencyLimit       const& limit);
+
+    void
+    addMethod(std::string                      const  name,
+              xmlrpc_c::methodPtr              const  methodP,
+              xmlrpc_c::concurrencyLimit       const& limit);
+
+    struct xmlrpc_method_load_stats
+    methodLoadStats(std::string const& name) const;
+        // Only for a method added with a concurrency limit
+
     void
     setDefaultMethod(xmlrpc_c::defaultMethod * const methodP);
 
@@ -213,6 +290,12 @@ public:
     processCall(std::string                const& callXml,
                 const xmlrpc_c::callInfo * const  callInfoP,
                 std::string *              const  responseXmlP) const;
+
+    void
+    processCallAsync(std::string                      const& callXml,
+                     const xmlrpc_c::callInfo *       const  callInfoP,
+                     xmlrpc_registry_response_handler        handler,
+                     void *                           const  handlerArg) const;
         
     size_t
     maxStackSize() const;
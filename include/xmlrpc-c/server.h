@@ -122,6 +122,178 @@ xmlrpc_registry_add_method3(
     xmlrpc_registry *                  const registryP,
     const struct xmlrpc_method_info3 * const infoP);
 
+typedef struct xmlrpc_completion xmlrpc_completion;
+
+typedef void
+(*xmlrpc_method_async)(xmlrpc_value *      const paramArrayP,
+                       void *              const serverInfo,
+                       void *              const callInfo,
+                       xmlrpc_completion * const completionP);
+    /* An asynchronous method; see xmlrpc_registry_add_method_async().
+       'paramArrayP' and 'callInfo' remain valid until the method
+       completes the call.
+    */
+
+struct xmlrpc_method_info4 {
+    const char *      methodName;
+    xmlrpc_method2    methodFunction;
+    void *            serverInfo;
+    size_t            stackSize;
+    const char *      signatureString;
+    const char *      help;
+    unsigned int      cacheTtl;
+        /* How long, in milliseconds, the registry may answer a call with
+           the response to an earlier call that had the same parameters,
+           without executing the method.  Zero means never.
+        */
+    unsigned int      cacheMaxEntries;
+        /* Maximum number of responses the registry remembers for this
+           method.  Zero means a default.  Meaningless if 'cacheTtl' is zero.
+        */
+    xmlrpc_bool       singleFlight;
+        /* A call with the same parameters as one that is executing right
+           now does not execute the method; it waits for the executing call
+           and gets the same response (or fault).
+        */
+    xmlrpc_bool       parallelSafe;
+        /* The method may execute at the same time as other calls in the
+           same system.multicall, on a worker thread.  See
+           xmlrpc_registry_set_multicall_parallel().
+        */
+    unsigned int      maxConcurrent;
+        /* Maximum number of calls of the method executing at once.  Zero
+           means no limit.  A call beyond the limit waits in a queue, or
+           if the queue is full, fails with XMLRPC_METHOD_BUSY_ERROR
+           without executing the method.
+        */
+    unsigned int      maxQueued;
+        /* Maximum number of calls waiting for a chance to execute the
+           method.  Meaningless if 'maxConcurrent' is zero.
+        */
+    xmlrpc_method_async methodFunctionAsync;
+        /* The function of an asynchronous method (see
+           xmlrpc_registry_add_method_async()), instead of
+           'methodFunction', which must then be NULL.  An asynchronous
+           method can't cache its responses or coalesce calls.
+        */
+};
+
+#define XMLRPC_MI4SIZE(MBRNAME) \
+    XMLRPC_STRUCTSIZE(struct xmlrpc_method_info4, MBRNAME)
+
+/* XMLRPC_MI4SIZE(xyz) is the minimum size a struct xmlrpc_method_info4
+   can be that includes member 'xyz'.  Pass it as 'infoSize' to
+   xmlrpc_registry_add_method4() if you don't set members after 'xyz'.
+*/
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_add_method4(
+    xmlrpc_env *                       const envP,
+    xmlrpc_registry *                  const registryP,
+    const struct xmlrpc_method_info4 * const infoP,
+    unsigned int                       const infoSize);
+
+/* An asynchronous method doesn't produce its result before it returns.
+   It may start work elsewhere (another thread, an event loop, a request to
+   another server) and return right away; whatever finishes the work
+   completes the call with xmlrpc_completion_finish().  Until then, the
+   call has no thread, unless the server that runs it needs one to wait.
+*/
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_add_method_async(xmlrpc_env *        const envP,
+                                 xmlrpc_registry *   const registryP,
+                                 const char *        const methodName,
+                                 xmlrpc_method_async       method,
+                                 const char *        const signatureString,
+                                 const char *        const help,
+                                 void *              const serverInfo);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_completion_finish(xmlrpc_completion * const completionP,
+                         const xmlrpc_env *  const faultP,
+                         xmlrpc_value *      const resultP);
+    /* Complete the call: it fails with *faultP if that is a fault, and
+       otherwise succeeds with result *resultP.  Call this exactly once
+       per call, from any thread; *completionP does not exist after.  We
+       don't consume the caller's reference to *resultP.
+    */
+
+/* You may add and remove methods while a server is using the registry.
+   A call that is already executing a method you remove continues to.
+*/
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_remove_method(xmlrpc_env *      const envP,
+                              xmlrpc_registry * const registryP,
+                              const char *      const methodName);
+
+struct xmlrpc_method_cache_stats {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long entries;
+    unsigned long evictions;
+};
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_get_method_cache_stats(
+    xmlrpc_env *                       const envP,
+    xmlrpc_registry *                  const registryP,
+    const char *                       const methodName,
+    struct xmlrpc_method_cache_stats * const statsP);
+
+struct xmlrpc_method_load_stats {
+    unsigned long inFlight;
+        /* Calls executing the method now */
+    unsigned long queued;
+        /* Calls waiting to execute it now */
+    unsigned long rejected;
+        /* Calls that failed because the method was at its limit, ever */
+};
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_get_method_load_stats(
+    xmlrpc_env *                      const envP,
+    xmlrpc_registry *                 const registryP,
+    const char *                      const methodName,
+    struct xmlrpc_method_load_stats * const statsP);
+
+struct xmlrpc_multicall_parms {
+    unsigned int threads;
+        /* Number of worker threads that execute the calls of all
+           system.multicalls.  Must be at least 1.
+        */
+    unsigned int max_fanout;
+        /* Maximum number of calls of one system.multicall executing at
+           once.  Zero means 'threads'.
+        */
+    xmlrpc_bool  all_parallel_safe;
+        /* Treat every method as parallel-safe, as if it were registered
+           with xmlrpc_method_info4.parallelSafe.
+        */
+};
+
+#define XMLRPC_MCPSIZE(MBRNAME) \
+    XMLRPC_STRUCTSIZE(struct xmlrpc_multicall_parms, MBRNAME)
+
+/* XMLRPC_MCPSIZE(xyz) is analogous to XMLRPC_MI4SIZE, but for
+   struct xmlrpc_multicall_parms.
+*/
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_set_multicall_parallel(
+    xmlrpc_env *                          const envP,
+    xmlrpc_registry *                     const registryP,
+    const struct xmlrpc_multicall_parms * const parmsP,
+    unsigned int                          const parmSize);
+
 XMLRPC_SERVER_EXPORTED
 void
 xmlrpc_registry_set_default_method(xmlrpc_env *          const envP,
@@ -167,6 +339,49 @@ xmlrpc_registry_process_call2(xmlrpc_env *        const envP,
                               void *              const callInfo,
                               xmlrpc_mem_block ** const outputPP);
 
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_process_call_deadline(
+    xmlrpc_env *        const envP,
+    xmlrpc_registry *   const registryP,
+    const char *        const xmlData,
+    size_t              const xmlLen,
+    void *              const callInfo,
+    unsigned int        const msLeft,
+    xmlrpc_mem_block ** const outputPP);
+    /* Like xmlrpc_registry_process_call2(), for a call whose client will
+       stop waiting for the response in 'msLeft' milliseconds.  The call
+       fails with XMLRPC_TIMEOUT_ERROR if that time passes before it can
+       start executing, and while it waits for the method's concurrency
+       limit, it goes ahead of calls with later deadlines.
+    */
+
+typedef void
+(*xmlrpc_registry_response_handler)(const xmlrpc_env * const envP,
+                                    void *             const handlerArg,
+                                    xmlrpc_mem_block * const responseXmlP);
+    /* Receives the response to a call: the XML-RPC response (which may
+       be a fault response) as *responseXmlP, which the handler owns, or
+       the failure to produce one as *envP, and then 'responseXmlP' is
+       NULL.
+    */
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_process_call_async(
+    xmlrpc_registry *                const registryP,
+    const char *                     const xmlData,
+    size_t                           const xmlLen,
+    void *                           const callInfo,
+    xmlrpc_registry_response_handler       handler,
+    void *                           const handlerArg);
+    /* Like xmlrpc_registry_process_call2(), except that we deliver the
+       response by calling 'handler' exactly once.  If the method is
+       asynchronous, that is whenever it completes the call, maybe after
+       we return and in another thread; otherwise, it is before we
+       return.  'callInfo' must remain valid until then.
+    */
+
 XMLRPC_SERVER_EXPORTED
 xmlrpc_mem_block *
 xmlrpc_registry_process_call(xmlrpc_env *      const envP,
@@ -70,6 +70,8 @@ xmlrpc_server_abyss_global_term(void);
 
 typedef void ((*runfirstFn)(void *));
 
+struct ssl_ctx_st;  /* OpenSSL's SSL_CTX */
+
 typedef struct {
     const char *      config_file_name;
         /* NULL to use preferred proper API-level interface */
@@ -101,6 +103,51 @@ typedef struct {
     unsigned int      max_conn;
     unsigned int      max_conn_backlog;
     size_t            max_rpc_mem;
+    xmlrpc_bool       event_driven;
+    unsigned int      conn_queue_depth;
+    unsigned int      acceptor_count;
+    xmlrpc_bool       pin_acceptors;
+    unsigned int      prefork_min_workers;
+    unsigned int      prefork_max_workers;
+    unsigned int      prefork_max_requests;
+    unsigned int      compress_level;
+    size_t            compress_min_size;
+    struct ssl_ctx_st * ssl_ctx_p;
+        /* Serve HTTPS, with OpenSSL connections made in this context.  NULL
+           means serve plain HTTP.  The ssl_ members below apply only to
+           HTTPS.
+        */
+    unsigned int      ssl_session_cache_size;
+        /* Sessions in the server's TLS session cache.  0 means the OpenSSL
+           default.
+        */
+    unsigned int      ssl_session_timeout;
+        /* Seconds a client may resume a TLS session.  0 means the OpenSSL
+           default.
+        */
+    xmlrpc_bool       ssl_no_session_tickets;
+        /* Don't issue TLS session tickets */
+    unsigned int      ssl_ticket_key_lifetime;
+        /* Seconds before the session ticket key changes.  0 means 3600. */
+    const unsigned char * ssl_ticket_secret;
+    size_t            ssl_ticket_secret_len;
+        /* Secret from which we derive ticket keys; servers that share it
+           accept each other's tickets.  NULL means a random one.
+        */
+    unsigned int      shed_target_ms;
+    unsigned int      shed_interval_ms;
+        /* Refuse connections that wait too long for a thread, CoDel-style,
+           with this target and interval (see ServerSetLoadShedding()).
+           'shed_target_ms' 0 means don't; 'shed_interval_ms' 0 means 100.
+        */
+    unsigned int      shed_retry_after;
+        /* Seconds a refused client should wait to retry.  0 means 1. */
+    unsigned int      log_buffer_size;
+    xmlrpc_bool       log_drop_when_full;
+        /* Write the log file from a background thread, with a buffer of
+           this size for each server thread (see ServerSetLogBuffer()).
+           'log_buffer_size' 0 means write it synchronously.
+        */
 } xmlrpc_server_abyss_parms;
 
 
@@ -160,6 +207,19 @@ XMLRPC_SERVER_ABYSS_EXPORTED
 void
 xmlrpc_server_abyss_use_sigchld(xmlrpc_server_abyss_t * const serverP);
 
+struct xmlrpc_server_abyss_tls_stats {
+    unsigned long full_handshakes;
+    unsigned long resumed_handshakes;
+    unsigned long failed_handshakes;
+};
+
+XMLRPC_SERVER_ABYSS_EXPORTED
+void
+xmlrpc_server_abyss_get_tls_stats(
+    xmlrpc_env *                           const envP,
+    xmlrpc_server_abyss_t *                const serverP,
+    struct xmlrpc_server_abyss_tls_stats * const statsP);
+
 
 typedef struct xmlrpc_server_abyss_sig xmlrpc_server_abyss_sig;
 
@@ -177,6 +237,27 @@ xmlrpc_server_abyss_restore_sig(
 
 
 
+/*=========================================================================
+**  Information for a method about the call it is executing
+**=======================================================================*/
+
+/* A method of an Abyss XML-RPC server gets the call's Abyss session
+   (TSession *) as its 'callInfo' argument.
+*/
+
+#define HAVE_XMLRPC_SERVER_ABYSS_GET_CANCELED 1
+XMLRPC_SERVER_ABYSS_EXPORTED
+xmlrpc_bool
+xmlrpc_server_abyss_get_canceled(TSession * const abyssSessionP);
+
+#define HAVE_XMLRPC_SERVER_ABYSS_GET_TIME_LEFT 1
+XMLRPC_SERVER_ABYSS_EXPORTED
+xmlrpc_bool
+xmlrpc_server_abyss_get_time_left(TSession *     const abyssSessionP,
+                                  unsigned int * const msLeftP);
+
+
+
 /*=========================================================================
 **  Functions to make an XML-RPC server out of your own Abyss server
 **=======================================================================*/
@@ -189,6 +270,20 @@ xmlrpc_call_processor(xmlrpc_env *        const envP,
                       TSession *          const abyssSessionP,
                       xmlrpc_mem_block ** const responseXmlPP);
 
+typedef void
+xmlrpc_call_processor_async(
+    void *                           const processorArg,
+    const char *                     const callXml,
+    size_t                           const callXmlLen,
+    TSession *                       const abyssSessionP,
+    xmlrpc_registry_response_handler       responseHandler,
+    void *                           const responseHandlerArg);
+    /* Like xmlrpc_call_processor, except that it delivers the response by
+       calling 'responseHandler' exactly once, maybe after it returns and
+       from another thread.  'callXml' is valid only until it returns;
+       *abyssSessionP until it delivers the response.
+    */
+
 typedef struct {
     xmlrpc_call_processor * xml_processor;
     void *                  xml_processor_arg;
@@ -199,6 +294,18 @@ typedef struct {
         /* NULL means don't answer HTTP access control query */
     xmlrpc_bool             access_ctl_expires;
     unsigned int            access_ctl_max_age;
+    unsigned int            compress_level;
+        /* Zlib compression level 1-9 for responses to clients that accept
+           gzip or deflate.  0 means don't compress responses.
+        */
+    size_t                  compress_min_size;
+        /* Don't compress a response smaller than this.  0 means 1024 */
+    xmlrpc_call_processor_async * xml_processor_async;
+        /* Use this instead of 'xml_processor' (with 'xml_processor_arg')
+           when the Abyss server can hold the connection without a thread
+           while a call is in progress, i.e. when it is event-driven.
+           NULL means always use 'xml_processor'.
+        */
 } xmlrpc_server_abyss_handler_parms;
 
 #define XMLRPC_AHPSIZE(MBRNAME) \
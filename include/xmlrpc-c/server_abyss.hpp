@@ -74,6 +74,15 @@ public:
         constrOpt & logFileName       (std::string    const& arg);
         constrOpt & serverOwnsSignals (bool           const& arg);
         constrOpt & expectSigchld     (bool           const& arg);
+        constrOpt & eventDriven       (bool           const& arg);
+        constrOpt & connQueueDepth    (unsigned int   const& arg);
+        constrOpt & acceptorCount     (unsigned int   const& arg);
+        constrOpt & pinAcceptors      (bool           const& arg);
+        constrOpt & preforkMinWorkers (unsigned int   const& arg);
+        constrOpt & preforkMaxWorkers (unsigned int   const& arg);
+        constrOpt & preforkMaxRequests(unsigned int   const& arg);
+        constrOpt & compressLevel     (unsigned int   const& arg);
+        constrOpt & compressMinSize   (size_t         const& arg);
 
     private:
         struct constrOpt_impl * implP;
@@ -148,6 +157,16 @@ public:
     callInfo_serverAbyss(xmlrpc_c::serverAbyss * const abyssServerP,
                          TSession *              const abyssSessionP);
 
+    bool
+    canceled() const;
+        // The client has gone away, so a method that takes a long time
+        // may as well stop.
+
+    bool
+    timeLeft(unsigned int * const msLeftP) const;
+        // The client said how long it would wait for the response; this
+        // is how many milliseconds of that remain.  False if it didn't.
+
     xmlrpc_c::serverAbyss * const serverAbyssP;
         // The server that is processing the RPC.
     TSession * const abyssSessionP;
@@ -168,6 +187,14 @@ class XMLRPC_SERVER_ABYSSPP_EXPORTED callInfo_abyss : public xmlrpc_c::callInfo
 public:
     callInfo_abyss(TSession * const abyssSessionP);
 
+    bool
+    canceled() const;
+        // Same as callInfo_serverAbyss::canceled()
+
+    bool
+    timeLeft(unsigned int * const msLeftP) const;
+        // Same as callInfo_serverAbyss::timeLeft()
+
     TSession * abyssSessionP;
         // The HTTP transaction that embodies the RPC.  You can ask this
         // object things like what the IP address of the client is.
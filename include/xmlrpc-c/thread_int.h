@@ -0,0 +1,130 @@
+#ifndef THREAD_INT_H_INCLUDED
+#define THREAD_INT_H_INCLUDED
+
+/*============================================================================
+  This is a minimal thread facility for use inside the Xmlrpc-c libraries
+  other than Abyss (which has its own, with a great deal more function).
+  It uses the platform's native threads: POSIX threads or Windows threads,
+  as chosen by the build configuration.
+
+  An event is a one-shot signal: threads wait for it until some thread sets
+  it, and once set, it stays set.
+
+  A queue is a bounded first-in-first-out queue of pointers that any number
+  of threads may put to and get from.  Putting waits while the queue is
+  full; getting waits while it is empty.
+
+  A thread-local slot holds a pointer of which each thread has its own
+  copy, initially NULL.
+============================================================================*/
+
+#include "bool.h"
+#include "xmlrpc-c/c_util.h"  /* For XMLRPC_DLLEXPORT */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  XMLRPC_UTIL_EXPORTED marks a symbol in this file that is exported from
+  libxmlrpc_util.
+
+  XMLRPC_BUILDING_UTIL says this compilation is part of libxmlrpc_util, as
+  opposed to something that _uses_ libxmlrpc_util.
+*/
+#ifdef XMLRPC_BUILDING_UTIL
+#define XMLRPC_UTIL_EXPORTED XMLRPC_DLLEXPORT
+#else
+#define XMLRPC_UTIL_EXPORTED
+#endif
+
+struct xmlrpc_thread;
+
+typedef void xmlrpc_threadFn(void * arg);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_thread_create(struct xmlrpc_thread ** const threadPP,
+                     xmlrpc_threadFn *       const func,
+                     void *                  const arg,
+                     const char **           const errorP);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_thread_join(struct xmlrpc_thread * const threadP);
+
+struct xmlrpc_event;
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_event_create(struct xmlrpc_event ** const eventPP,
+                    const char **          const errorP);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_event_destroy(struct xmlrpc_event * const eventP);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_event_set(struct xmlrpc_event * const eventP);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_event_wait(struct xmlrpc_event * const eventP);
+
+struct xmlrpc_queue;
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_queue_create(struct xmlrpc_queue ** const queuePP,
+                    unsigned int           const capacity,
+                    const char **          const errorP);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_queue_destroy(struct xmlrpc_queue * const queueP);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_queue_put(struct xmlrpc_queue * const queueP,
+                 void *                const item,
+                 bool *                const closedP);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_queue_get(struct xmlrpc_queue * const queueP,
+                 void **               const itemP,
+                 bool *                const closedP);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_queue_close(struct xmlrpc_queue * const queueP);
+
+struct xmlrpc_tls;
+
+typedef void xmlrpc_tlsDestroyFn(void * value);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_tls_create(struct xmlrpc_tls ** const tlsPP,
+                  xmlrpc_tlsDestroyFn *const destroy,
+                  const char **        const errorP);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_tls_destroy(struct xmlrpc_tls * const tlsP);
+
+XMLRPC_UTIL_EXPORTED
+void *
+xmlrpc_tls_get(struct xmlrpc_tls * const tlsP);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_tls_set(struct xmlrpc_tls * const tlsP,
+               void *              const value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -35,6 +35,10 @@ XMLRPC_UTIL_EXPORTED
 void
 xmlrpc_gettimeofday(xmlrpc_timespec * const todP);
 
+XMLRPC_UTIL_EXPORTED
+uint64_t
+xmlrpc_monotonic_ms(void);
+
 XMLRPC_UTIL_EXPORTED
 void
 xmlrpc_timegm(const struct tm  * const brokenTime,
@@ -131,6 +131,7 @@ xmlrpc_assertion_failed(const char * const fileName,
 #define XMLRPC_INTROSPECTION_DISABLED_ERROR (-508)
 #define XMLRPC_LIMIT_EXCEEDED_ERROR         (-509)
 #define XMLRPC_INVALID_UTF8_ERROR           (-510)
+#define XMLRPC_METHOD_BUSY_ERROR            (-511)
 
 typedef struct _xmlrpc_env {
     int    fault_occurred;
@@ -0,0 +1,643 @@
+/*=============================================================================
+                                 accesslog.c
+===============================================================================
+  This is the asynchronous log file writer.  See accesslog.h for the concept.
+
+  Each thread that logs gets a ring buffer of its own the first time it
+  does, which it finds in a thread-local slot.  The thread is the only one
+  that puts lines in its ring and the writer thread is the only one that
+  takes them out, so the two need only atomic loads and stores of the ring's
+  head and tail, not a lock.  The lock on the list of rings is for adding a
+  thread's ring, which a thread does once, and for the writer's forgetting
+  rings whose threads have exited.
+
+  A thread that puts a line in its ring rings the writer's doorbell, unless
+  someone already has since the writer last woke up.  The writer then writes
+  what is in all the rings, up to FILE_SEGMENT_MAX pieces in one gathered
+  write.  While it writes, lines pile up in the rings, so the busier the
+  server, the more each write takes.
+
+  A thread that finds its ring full and may not drop the line puts itself
+  on a list of waiters, and the writer wakes everyone on the list each time
+  it has written some lines and so made room.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bool.h"
+#include "int.h"
+#include "mallocvar.h"
+#include "atomic.h"
+#include "xmlrpc-c/util_int.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/thread_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "file.h"
+
+#include "accesslog.h"
+
+/* Limits on a ring's size.  A line longer than the ring holds is cut short
+   to fit.
+*/
+#define RING_SIZE_MIN 256
+#define RING_SIZE_MAX (1U << 30)
+
+typedef struct logRing {
+    struct logRing * nextP;
+        /* Next ring in the log's list */
+    char *           buffer;
+    uint32_t         size;
+        /* Size of 'buffer'; a power of two, so that the positions below
+           stay consistent when they wrap around.
+        */
+    long volatile    head;
+        /* Number of bytes the writer has taken from the ring, ever
+           (modulo the range of 'long').  Only the writer changes this.
+        */
+    long volatile    tail;
+        /* Number of bytes the thread has put in the ring, ever.  Only the
+           thread changes this.
+        */
+    long volatile    orphaned;
+        /* The thread has exited, so nothing more will go into the ring */
+} logRing;
+
+struct roomWaiter {
+/*----------------------------------------------------------------------------
+   A thread waiting for the writer to make room in its ring
+-----------------------------------------------------------------------------*/
+    struct xmlrpc_event * roomP;
+        /* The writer sets this when it has made room */
+    struct roomWaiter *   nextP;
+};
+
+struct accessLog {
+    TFile *                fileP;
+    uint32_t               ringSize;
+    bool                   dropWhenFull;
+        /* A thread whose ring is full drops the line rather than wait */
+    struct xmlrpc_tls *    ringTlsP;
+        /* Each thread's ring */
+    struct lock *          ringsLockP;
+    logRing *              ringsP;
+        /* All the rings, including those of threads that have exited but
+           whose lines we haven't written yet.
+        */
+    struct roomWaiter *    roomWaiterP;
+        /* The threads waiting for room in their rings.  Protected by
+           'ringsLockP', like 'ringsP'.
+        */
+    struct xmlrpc_queue *  doorbellP;
+        /* Where threads wake the writer.  It never holds more than one
+           item.
+        */
+    long volatile          doorbellCt;
+        /* Number of times threads have rung the doorbell since the writer
+           last woke up.  Only the one that makes it 1 actually rings.
+        */
+    long volatile          droppedCt;
+        /* Number of lines threads have dropped because their rings were
+           full (or they couldn't get one, or couldn't wait for room)
+        */
+    struct xmlrpc_thread * writerP;
+};
+
+
+
+static uint32_t
+ringSizeFor(uint32_t const bufferSize) {
+
+    uint32_t size;
+
+    for (size = RING_SIZE_MIN;
+         size < bufferSize && size < RING_SIZE_MAX;
+         size *= 2);
+
+    return size;
+}
+
+
+
+static void
+orphanRing(void * const value) {
+/*----------------------------------------------------------------------------
+   This is the destructor of a thread's ring slot, which runs when the
+   thread exits.  The writer frees the ring after it has written the
+   thread's last lines.
+-----------------------------------------------------------------------------*/
+    logRing * const ringP = value;
+
+    xmlrpc_atomicStore(&ringP->orphaned, 1);
+}
+
+
+
+static void
+destroyRing(logRing * const ringP) {
+
+    free(ringP->buffer);
+
+    free(ringP);
+}
+
+
+
+static logRing *
+threadRing(TAccessLog * const accessLogP) {
+/*----------------------------------------------------------------------------
+   The calling thread's ring; we create it if the thread doesn't have one
+   yet.  NULL if we can't.
+-----------------------------------------------------------------------------*/
+    logRing * ringP;
+
+    ringP = xmlrpc_tls_get(accessLogP->ringTlsP);
+
+    if (!ringP) {
+        MALLOCVAR(ringP);
+
+        if (ringP) {
+            ringP->buffer = malloc(accessLogP->ringSize);
+
+            if (!ringP->buffer) {
+                free(ringP);
+                ringP = NULL;
+            } else {
+                ringP->size     = accessLogP->ringSize;
+                ringP->head     = 0;
+                ringP->tail     = 0;
+                ringP->orphaned = 0;
+
+                accessLogP->ringsLockP->acquire(accessLogP->ringsLockP);
+
+                ringP->nextP = accessLogP->ringsP;
+                accessLogP->ringsP = ringP;
+
+                accessLogP->ringsLockP->release(accessLogP->ringsLockP);
+
+                xmlrpc_tls_set(accessLogP->ringTlsP, ringP);
+            }
+        }
+    }
+    return ringP;
+}
+
+
+
+static void
+putInRing(logRing *     const ringP,
+          unsigned long const pos,
+          const char *  const data,
+          uint32_t      const len) {
+/*----------------------------------------------------------------------------
+   Copy 'data' into the ring at position 'pos', wrapping around the end of
+   the buffer if necessary.
+-----------------------------------------------------------------------------*/
+    uint32_t const start = pos & (ringP->size - 1);
+    uint32_t const firstLen = MIN(len, ringP->size - start);
+
+    memcpy(&ringP->buffer[start], data, firstLen);
+    memcpy(&ringP->buffer[0], data + firstLen, len - firstLen);
+}
+
+
+
+static void
+wakeWriter(TAccessLog * const accessLogP) {
+
+    if (xmlrpc_atomicIncrement(&accessLogP->doorbellCt) == 1) {
+        bool closed;
+
+        xmlrpc_queue_put(accessLogP->doorbellP, accessLogP, &closed);
+    }
+}
+
+
+
+static bool
+ringHasRoom(logRing * const ringP,
+            uint32_t  const len) {
+/*----------------------------------------------------------------------------
+   The ring has room for 'len' more bytes.  Only the ring's thread may ask.
+-----------------------------------------------------------------------------*/
+    unsigned long const head = xmlrpc_atomicLoad(&ringP->head);
+    unsigned long const tail = ringP->tail;
+
+    return ringP->size - (tail - head) >= len;
+}
+
+
+
+static void
+waitForRoom(TAccessLog * const accessLogP,
+            logRing *    const ringP,
+            uint32_t     const len,
+            bool *       const failedP) {
+/*----------------------------------------------------------------------------
+   Wait until ring *ringP, which is the calling thread's, has room for
+   'len' more bytes, or at least until the writer has taken something out
+   of it.
+
+   Return *failedP true if we can't wait.
+-----------------------------------------------------------------------------*/
+    struct roomWaiter waiter;
+    const char * error;
+
+    xmlrpc_event_create(&waiter.roomP, &error);
+
+    if (error) {
+        xmlrpc_strfree(error);
+        *failedP = true;
+    } else {
+        bool full;
+
+        /* We check under the lock, so if the writer makes room after we
+           look, it finds us on the list.
+        */
+        accessLogP->ringsLockP->acquire(accessLogP->ringsLockP);
+
+        full = !ringHasRoom(ringP, len);
+
+        if (full) {
+            waiter.nextP = accessLogP->roomWaiterP;
+            accessLogP->roomWaiterP = &waiter;
+        }
+        accessLogP->ringsLockP->release(accessLogP->ringsLockP);
+
+        if (full) {
+            wakeWriter(accessLogP);
+
+            xmlrpc_event_wait(waiter.roomP);
+
+            /* The writer sets the event while holding the lock, so once
+               we have had the lock, it is done with the event.
+            */
+            accessLogP->ringsLockP->acquire(accessLogP->ringsLockP);
+            accessLogP->ringsLockP->release(accessLogP->ringsLockP);
+        }
+        xmlrpc_event_destroy(waiter.roomP);
+
+        *failedP = false;
+    }
+}
+
+
+
+void
+AccessLogWrite(TAccessLog * const accessLogP,
+               const char * const line) {
+/*----------------------------------------------------------------------------
+   Log 'line', which has no newline at the end.  We don't write it to the
+   file; we just arrange for the writer thread to do it soon.
+-----------------------------------------------------------------------------*/
+    logRing * const ringP = threadRing(accessLogP);
+
+    if (!ringP)
+        xmlrpc_atomicIncrement(&accessLogP->droppedCt);
+    else {
+        uint32_t const lineLen = MIN(strlen(line), ringP->size - 1);
+        uint32_t const recordLen = lineLen + 1;
+
+        unsigned long const tail = ringP->tail;
+            /* Only we change it, so we needn't load it atomically */
+
+        bool done;
+
+        for (done = false; !done; ) {
+            if (ringHasRoom(ringP, recordLen)) {
+                putInRing(ringP, tail, line, lineLen);
+                putInRing(ringP, tail + lineLen, "\n", 1);
+
+                /* This makes the line visible to the writer */
+                xmlrpc_atomicStore(&ringP->tail, (long)(tail + recordLen));
+
+                wakeWriter(accessLogP);
+
+                done = true;
+            } else if (accessLogP->dropWhenFull) {
+                xmlrpc_atomicIncrement(&accessLogP->droppedCt);
+                done = true;
+            } else {
+                bool failed;
+
+                waitForRoom(accessLogP, ringP, recordLen, &failed);
+
+                if (failed) {
+                    xmlrpc_atomicIncrement(&accessLogP->droppedCt);
+                    done = true;
+                }
+            }
+        }
+    }
+}
+
+
+
+typedef struct {
+    /* Lines from rings, ready to write in one gathered write */
+    TFileSegment  segment[FILE_SEGMENT_MAX];
+    unsigned int  segmentCt;
+    logRing *     ringP[FILE_SEGMENT_MAX];
+    unsigned long newHead[FILE_SEGMENT_MAX];
+        /* Where each ring's head goes once we have written its lines */
+    unsigned int  ringCt;
+} batch;
+
+
+
+static void
+wakeRoomWaiters(TAccessLog * const accessLogP) {
+
+    accessLogP->ringsLockP->acquire(accessLogP->ringsLockP);
+
+    while (accessLogP->roomWaiterP) {
+        struct roomWaiter * const waiterP = accessLogP->roomWaiterP;
+
+        accessLogP->roomWaiterP = waiterP->nextP;
+
+        xmlrpc_event_set(waiterP->roomP);
+    }
+    accessLogP->ringsLockP->release(accessLogP->ringsLockP);
+}
+
+
+
+static void
+writeBatch(TAccessLog * const accessLogP,
+           batch *      const batchP) {
+/*----------------------------------------------------------------------------
+   Write the lines in *batchP and make the space they took in their rings
+   available again.
+
+   If the write fails, there's nobody to tell and nothing better to do with
+   the lines, so they're lost.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    if (batchP->segmentCt > 0)
+        FileWriteSegments(accessLogP->fileP,
+                          batchP->segment, batchP->segmentCt);
+
+    for (i = 0; i < batchP->ringCt; ++i)
+        xmlrpc_atomicStore(&batchP->ringP[i]->head,
+                           (long)batchP->newHead[i]);
+
+    if (batchP->ringCt > 0)
+        wakeRoomWaiters(accessLogP);
+
+    batchP->segmentCt = 0;
+    batchP->ringCt    = 0;
+}
+
+
+
+static void
+addRingToBatch(TAccessLog * const accessLogP,
+               batch *      const batchP,
+               logRing *    const ringP) {
+/*----------------------------------------------------------------------------
+   Add the lines that are in ring *ringP now to *batchP, writing what's
+   already there first if there isn't room.
+-----------------------------------------------------------------------------*/
+    unsigned long const head = ringP->head;
+    unsigned long const tail = xmlrpc_atomicLoad(&ringP->tail);
+
+    if (tail != head) {
+        uint32_t const usedLen = tail - head;
+        uint32_t const start = head & (ringP->size - 1);
+        uint32_t const firstLen = MIN(usedLen, ringP->size - start);
+
+        /* A ring takes at most two segments: the part up to the end of the
+           buffer and the part that wraps around to the beginning.
+        */
+        if (batchP->segmentCt + 2 > FILE_SEGMENT_MAX)
+            writeBatch(accessLogP, batchP);
+
+        batchP->segment[batchP->segmentCt].base = &ringP->buffer[start];
+        batchP->segment[batchP->segmentCt].len  = firstLen;
+        ++batchP->segmentCt;
+
+        if (usedLen > firstLen) {
+            batchP->segment[batchP->segmentCt].base = &ringP->buffer[0];
+            batchP->segment[batchP->segmentCt].len  = usedLen - firstLen;
+            ++batchP->segmentCt;
+        }
+        batchP->ringP[batchP->ringCt]   = ringP;
+        batchP->newHead[batchP->ringCt] = tail;
+        ++batchP->ringCt;
+    }
+}
+
+
+
+static void
+forgetOrphanedRings(TAccessLog * const accessLogP) {
+/*----------------------------------------------------------------------------
+   Destroy the rings of threads that have exited, once we have written all
+   their lines.
+-----------------------------------------------------------------------------*/
+    logRing ** linkP;
+
+    accessLogP->ringsLockP->acquire(accessLogP->ringsLockP);
+
+    for (linkP = &accessLogP->ringsP; *linkP; ) {
+        logRing * const ringP = *linkP;
+
+        /* The thread put its last line in before it set 'orphaned' */
+        if (xmlrpc_atomicLoad(&ringP->orphaned) &&
+            xmlrpc_atomicLoad(&ringP->tail) == ringP->head) {
+
+            *linkP = ringP->nextP;
+            destroyRing(ringP);
+        } else
+            linkP = &ringP->nextP;
+    }
+    accessLogP->ringsLockP->release(accessLogP->ringsLockP);
+}
+
+
+
+static void
+writeAllRings(TAccessLog * const accessLogP) {
+
+    batch batch;
+    logRing * ringP;
+
+    batch.segmentCt = 0;
+    batch.ringCt    = 0;
+
+    /* Rings that threads add while we work go at the front of the list,
+       where we don't look, but their threads ring the doorbell, so we'll
+       be back.  Only we remove rings, so the rest of the list stays put.
+    */
+    accessLogP->ringsLockP->acquire(accessLogP->ringsLockP);
+    ringP = accessLogP->ringsP;
+    accessLogP->ringsLockP->release(accessLogP->ringsLockP);
+
+    for (; ringP; ringP = ringP->nextP)
+        addRingToBatch(accessLogP, &batch, ringP);
+
+    writeBatch(accessLogP, &batch);
+
+    forgetOrphanedRings(accessLogP);
+}
+
+
+
+static void
+writerThread(void * const arg) {
+/*----------------------------------------------------------------------------
+   Write what the threads have logged whenever one says there is something,
+   until the doorbell closes.  Then write whatever is left and return.
+-----------------------------------------------------------------------------*/
+    TAccessLog * const accessLogP = arg;
+
+    bool closed;
+
+    do {
+        void * item;
+
+        xmlrpc_queue_get(accessLogP->doorbellP, &item, &closed);
+
+        xmlrpc_atomicStore(&accessLogP->doorbellCt, 0);
+
+        writeAllRings(accessLogP);
+    } while (!closed);
+}
+
+
+
+static void
+startWriter(TAccessLog *  const accessLogP,
+            const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Create the doorbell and the writer thread that answers it.
+-----------------------------------------------------------------------------*/
+    const char * error;
+
+    xmlrpc_queue_create(&accessLogP->doorbellP, 1, &error);
+
+    if (error) {
+        xmlrpc_asprintf(errorP, "Unable to create the log writer's "
+                        "doorbell.  %s", error);
+        xmlrpc_strfree(error);
+    } else {
+        xmlrpc_thread_create(&accessLogP->writerP, &writerThread, accessLogP,
+                             &error);
+
+        if (error) {
+            xmlrpc_asprintf(errorP, "Unable to create the log writer "
+                            "thread.  %s", error);
+            xmlrpc_strfree(error);
+
+            xmlrpc_queue_destroy(accessLogP->doorbellP);
+        } else
+            *errorP = NULL;
+    }
+}
+
+
+
+void
+AccessLogCreate(TFile *       const fileP,
+                uint32_t      const bufferSize,
+                bool          const dropWhenFull,
+                TAccessLog ** const accessLogPP,
+                const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Create a log writer that writes to the open file *fileP, which must stay
+   open until the writer is destroyed.
+
+   Each thread that logs gets a buffer of 'bufferSize' bytes (rounded up to
+   a power of two).
+-----------------------------------------------------------------------------*/
+    TAccessLog * accessLogP;
+
+    MALLOCVAR(accessLogP);
+
+    if (!accessLogP)
+        xmlrpc_asprintf(errorP, "Unable to allocate memory for log writer");
+    else {
+        accessLogP->fileP        = fileP;
+        accessLogP->ringSize     = ringSizeFor(bufferSize);
+        accessLogP->dropWhenFull = dropWhenFull;
+        accessLogP->ringsP       = NULL;
+        accessLogP->roomWaiterP  = NULL;
+        accessLogP->doorbellCt   = 0;
+        accessLogP->droppedCt    = 0;
+
+        accessLogP->ringsLockP = xmlrpc_lock_create();
+
+        if (!accessLogP->ringsLockP)
+            xmlrpc_asprintf(errorP, "Unable to create lock for log writer");
+        else {
+            const char * error;
+
+            xmlrpc_tls_create(&accessLogP->ringTlsP, &orphanRing, &error);
+
+            if (error) {
+                xmlrpc_asprintf(errorP, "Unable to create thread-local "
+                                "slot for log buffers.  %s", error);
+                xmlrpc_strfree(error);
+            } else {
+                startWriter(accessLogP, errorP);
+
+                if (*errorP)
+                    xmlrpc_tls_destroy(accessLogP->ringTlsP);
+            }
+            if (*errorP)
+                accessLogP->ringsLockP->destroy(accessLogP->ringsLockP);
+        }
+        if (*errorP)
+            free(accessLogP);
+        else
+            *accessLogPP = accessLogP;
+    }
+}
+
+
+
+unsigned long
+AccessLogDroppedCt(TAccessLog * const accessLogP) {
+/*----------------------------------------------------------------------------
+   The number of lines threads have dropped so far instead of logging them.
+-----------------------------------------------------------------------------*/
+    return (unsigned long)xmlrpc_atomicLoad(&accessLogP->droppedCt);
+}
+
+
+
+void
+AccessLogDestroy(TAccessLog * const accessLogP) {
+/*----------------------------------------------------------------------------
+   Write everything threads have logged, then destroy the log writer.
+
+   No thread may be logging.
+-----------------------------------------------------------------------------*/
+    xmlrpc_queue_close(accessLogP->doorbellP);
+
+    xmlrpc_thread_join(accessLogP->writerP);
+
+    /* Threads that still exist still point to their rings, but they'll
+       never look at them again, and with the slot gone, they won't
+       orphan them when they exit.
+    */
+    xmlrpc_tls_destroy(accessLogP->ringTlsP);
+
+    while (accessLogP->ringsP) {
+        logRing * const ringP = accessLogP->ringsP;
+
+        accessLogP->ringsP = ringP->nextP;
+
+        destroyRing(ringP);
+    }
+
+    xmlrpc_queue_destroy(accessLogP->doorbellP);
+
+    accessLogP->ringsLockP->destroy(accessLogP->ringsLockP);
+
+    free(accessLogP);
+}
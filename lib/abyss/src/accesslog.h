@@ -0,0 +1,44 @@
+#ifndef ACCESSLOG_H_INCLUDED
+#define ACCESSLOG_H_INCLUDED
+
+/*============================================================================
+   An asynchronous writer of the server's log file.
+
+   A thread that logs a line just copies it into a buffer of its own, without
+   taking a lock, and a background thread writes what all the threads have
+   buffered to the file, as few system calls as it can.  So a slow disk or a
+   high request rate doesn't make the server's threads wait on each other or
+   on the file.
+
+   When a thread's buffer is full, the thread either drops the line or waits
+   for the background thread to make room, as the creator chooses.
+
+   This works only where the server's threads are threads of one process.
+   The background thread doesn't survive a fork, and it doesn't get a chance
+   to write what is buffered when a process just exits.
+============================================================================*/
+
+#include "bool.h"
+#include "int.h"
+#include "file.h"
+
+typedef struct accessLog TAccessLog;
+
+void
+AccessLogCreate(TFile *       const fileP,
+                uint32_t      const bufferSize,
+                bool          const dropWhenFull,
+                TAccessLog ** const accessLogPP,
+                const char ** const errorP);
+
+void
+AccessLogDestroy(TAccessLog * const accessLogP);
+
+void
+AccessLogWrite(TAccessLog * const accessLogP,
+               const char * const line);
+
+unsigned long
+AccessLogDroppedCt(TAccessLog * const accessLogP);
+
+#endif
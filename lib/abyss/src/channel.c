@@ -100,6 +100,7 @@ ChannelCreate(const struct TChannelVtbl * const vtblP,
         channelP->implP = implP;
         channelP->vtbl = *vtblP;
         channelP->signature = channelSignature;
+        channelP->acceptTimeMs = 0;
         *channelPP = channelP;
 
         if (ChannelTraceIsActive)
@@ -206,3 +207,71 @@ ChannelFormatPeerInfo(TChannel *    const channelP,
 
 
 
+int
+ChannelPollFd(TChannel * const channelP) {
+/*----------------------------------------------------------------------------
+   The file descriptor an OS event mechanism (e.g. epoll) can watch to tell
+   when there is something to read from *channelP; -1 if there isn't one.
+
+   A channel has such a file descriptor only if it becoming readable
+   is the only way data can become available on the channel.  E.g. a
+   channel that buffers data internally does not.
+-----------------------------------------------------------------------------*/
+    int retval;
+
+    if (channelP->vtbl.pollFd)
+        retval = (*channelP->vtbl.pollFd)(channelP);
+    else
+        retval = -1;
+
+    return retval;
+}
+
+
+
+bool
+ChannelPeerHungUp(TChannel * const channelP) {
+/*----------------------------------------------------------------------------
+   The peer has closed the connection (or it has failed), as far as we can
+   tell right now without waiting and without reading anything from the
+   channel.  False if the channel can't tell.
+-----------------------------------------------------------------------------*/
+    bool retval;
+
+    if (channelP->vtbl.peerHungUp)
+        retval = (*channelP->vtbl.peerHungUp)(channelP);
+    else
+        retval = false;
+
+    return retval;
+}
+
+
+
+bool
+ChannelCanSendFile(TChannel * const channelP) {
+
+    return !!channelP->vtbl.sendFile;
+}
+
+
+
+void
+ChannelSendFile(TChannel * const channelP,
+                int        const fileFd,
+                uint64_t   const offset,
+                uint32_t   const len,
+                bool *     const failedP) {
+/*----------------------------------------------------------------------------
+   Send the 'len' bytes at offset 'offset' of the open file 'fileFd' on
+   the channel, without copying them through a buffer of ours.
+
+   Valid only if ChannelCanSendFile() says so.
+-----------------------------------------------------------------------------*/
+    assert(channelP->vtbl.sendFile);
+
+    (*channelP->vtbl.sendFile)(channelP, fileFd, offset, len, failedP);
+}
+
+
+
@@ -53,6 +53,16 @@ typedef void ChannelInterruptImpl(TChannel * const channelP);
 typedef void ChannelFormatPeerInfoImpl(TChannel *    const channelP,
                                        const char ** const peerStringP);
 
+typedef int ChannelPollFdImpl(TChannel * const channelP);
+
+typedef void ChannelSendFileImpl(TChannel * const channelP,
+                                 int        const fileFd,
+                                 uint64_t   const offset,
+                                 uint32_t   const len,
+                                 bool *     const failedP);
+
+typedef bool ChannelPeerHungUpImpl(TChannel * const channelP);
+
 struct TChannelVtbl {
     ChannelDestroyImpl            * destroy;
     ChannelWriteImpl              * write;
@@ -60,6 +70,18 @@ struct TChannelVtbl {
     ChannelWaitImpl               * wait;
     ChannelInterruptImpl          * interrupt;
     ChannelFormatPeerInfoImpl     * formatPeerInfo;
+    ChannelPollFdImpl             * pollFd;
+        /* NULL if the channel can't be waited for with an OS event
+           mechanism such as epoll.
+        */
+    ChannelSendFileImpl           * sendFile;
+        /* NULL if the channel can't have the OS send file contents on it
+           directly, e.g. because it encrypts what it sends.
+        */
+    ChannelPeerHungUpImpl         * peerHungUp;
+        /* NULL if the channel can't tell without reading whether the peer
+           has closed the connection.
+        */
 };
 
 struct _TChannel {
@@ -71,6 +93,11 @@ struct _TChannel {
         */
     void *              implP;
     struct TChannelVtbl vtbl;
+    uint64_t            acceptTimeMs;
+        /* When the server accepted the channel, as xmlrpc_monotonic_ms()
+           tells time.  Zero if no server accepted it (e.g. the user
+           supplied it) or the server has started a session on it.
+        */
 };
 
 #define TIME_INFINITE   0xffffffff
@@ -113,4 +140,20 @@ void
 ChannelFormatPeerInfo(TChannel *    const channelP,
                       const char ** const peerStringP);
 
+int
+ChannelPollFd(TChannel * const channelP);
+
+bool
+ChannelPeerHungUp(TChannel * const channelP);
+
+bool
+ChannelCanSendFile(TChannel * const channelP);
+
+void
+ChannelSendFile(TChannel * const channelP,
+                int        const fileFd,
+                uint64_t   const offset,
+                uint32_t   const len,
+                bool *     const failedP);
+
 #endif
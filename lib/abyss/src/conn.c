@@ -174,10 +174,24 @@ ConnCreate(TConn **            const connectionPP,
         connectionP->done         = done;
         connectionP->inbytes      = 0;
         connectionP->outbytes     = 0;
+        connectionP->holdOutput   = false;
+        connectionP->outBufferSize = 0;
         connectionP->trace        = getenv("ABYSS_TRACE_CONN");
 
-        makeThread(connectionP, foregroundBackground, useSigchld,
-                   jobStackSize, errorP);
+        if (!PoolCreateUnlocked(&connectionP->sessionPool,
+                                SESSION_POOL_ZONE_SIZE)) {
+            xmlrpc_asprintf(errorP, "Unable to allocate the memory pool "
+                            "for the connection's sessions");
+            free(connectionP);
+        } else {
+            makeThread(connectionP, foregroundBackground, useSigchld,
+                       jobStackSize, errorP);
+
+            if (*errorP) {
+                PoolFree(&connectionP->sessionPool);
+                free(connectionP);
+            }
+        }
     }
     *connectionPP = connectionP;
 }
@@ -238,6 +252,8 @@ ConnWaitAndRelease(TConn * const connectionP) {
         assert(connectionP->threadP);
         ThreadWaitAndRelease(connectionP->threadP);
     }
+    PoolFree(&connectionP->sessionPool);
+
     free(connectionP);
 }
 
@@ -502,6 +518,12 @@ ConnRead(TConn *       const connectionP,
         bool readyForRead;
         bool failed;
 
+        /* The client may be waiting for a response we're holding before it
+           sends more.  If we can't send it, we'll find out when we try to
+           send the response to the next request.
+        */
+        ConnFlush(connectionP);
+
         ChannelWait(connectionP->channelP, waitForRead, waitForWrite,
                     timeoutMs, &readyForRead, NULL, &failed);
 
@@ -530,6 +552,127 @@ ConnRead(TConn *       const connectionP,
 
 
 
+void
+ConnReadDirect(TConn *       const connectionP,
+               uint32_t      const timeout,
+               char *        const buffer,
+               size_t        const len,
+               const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Read exactly 'len' bytes on connection *connectionP from the channel into
+   'buffer', bypassing the connection's buffer.
+
+   This is for reading something whose size we already know, such as an
+   HTTP request body with a Content-Length, without copying it through the
+   connection buffer a piece at a time.  We ask the channel for all that is
+   left each time, so a large read takes as few system calls as the
+   network allows.
+
+   Don't wait more than 'timeout' seconds for each piece to arrive.  Fail
+   if that time passes without any data arriving, if the wait is
+   interrupted, or if the client closes the connection first.
+-----------------------------------------------------------------------------*/
+    uint32_t const timeoutMs = timeout * 1000;
+
+    size_t bytesRead;
+
+    if (timeoutMs < timeout)
+        /* Arithmetic overflow */
+        xmlrpc_asprintf(errorP, "Timeout value is too large");
+    else
+        *errorP = NULL;
+
+    /* As in ConnRead(), don't keep the client waiting for a response */
+    ConnFlush(connectionP);
+
+    for (bytesRead = 0; bytesRead < len && !*errorP; ) {
+        bool readyForRead;
+        bool failed;
+
+        ChannelWait(connectionP->channelP, true, false, timeoutMs,
+                    &readyForRead, NULL, &failed);
+
+        if (failed)
+            xmlrpc_asprintf(errorP,
+                            "Wait for stuff to arrive from client failed.");
+        else if (!readyForRead) {
+            traceReadTimeout(connectionP, timeout);
+            xmlrpc_asprintf(errorP, "Read from Abyss client "
+                            "connection timed out after %u seconds "
+                            "or was interrupted",
+                            timeout);
+        } else {
+            size_t   const bytesLeft = len - bytesRead;
+            uint32_t const bytesToRead =
+                (uint32_t)MIN(bytesLeft, 0x7fffffff);
+
+            uint32_t bytesReadThisTime;
+            bool readError;
+
+            ChannelRead(connectionP->channelP,
+                        (unsigned char *)&buffer[bytesRead], bytesToRead,
+                        &bytesReadThisTime, &readError);
+
+            if (readError)
+                xmlrpc_asprintf(errorP, "Error reading from channel");
+            else if (bytesReadThisTime == 0)
+                xmlrpc_asprintf(errorP, "Read from Abyss client "
+                                "connection failed because client closed "
+                                "the connection");
+            else {
+                if (connectionP->trace)
+                    traceBuffer("READ FROM CHANNEL",
+                                (unsigned char *)&buffer[bytesRead],
+                                bytesReadThisTime);
+                connectionP->inbytes += bytesReadThisTime;
+                bytesRead += bytesReadThisTime;
+            }
+        }
+    }
+}
+
+
+
+static bool
+writeToChannel(TConn *          const connectionP,
+               const char *     const buffer,
+               uint32_t         const size,
+               TChanWriteExpect const chanExpect) {
+
+    bool failed;
+
+    ChannelWrite(connectionP->channelP, (const unsigned char *)buffer, size,
+                 chanExpect, &failed);
+
+    traceChannelWrite(connectionP, buffer, size, failed);
+
+    return !failed;
+}
+
+
+
+static bool
+flushOutBuffer(TConn *          const connectionP,
+               TChanWriteExpect const chanExpect) {
+
+    bool succeeded;
+
+    if (connectionP->outBufferSize > 0) {
+        succeeded = writeToChannel(connectionP, connectionP->outBuffer,
+                                   connectionP->outBufferSize, chanExpect);
+
+        /* If the write failed, the data is lost; there's no point trying
+           again.
+        */
+        connectionP->outBufferSize = 0;
+    } else
+        succeeded = true;
+
+    return succeeded;
+}
+
+
+
 bool
 ConnWrite(TConn *          const connectionP,
           const void *     const buffer,
@@ -540,61 +683,124 @@ ConnWrite(TConn *          const connectionP,
 
   'expectation' is CONN_EXPECT_MORE to say the system should expect more
   data logically part of the same message to come in a future ConnWrite call.
-  (Some systems will choose to wait for that data and send it together with
-  'buffer').
+  In that case, or if the connection is holding output for pipelined
+  responses, we collect small writes in the connection's output buffer and
+  send them together later, so a response with many header lines costs one
+  system call instead of one per line.
+
+  Because we may not actually write anything to the channel now, success
+  doesn't mean the data made it; a failure to send buffered data shows up
+  as failure of a later ConnWrite() or ConnFlush().
 -----------------------------------------------------------------------------*/
+    bool const holding =
+        expectation == CONN_EXPECT_MORE || connectionP->holdOutput;
     TChanWriteExpect const chanExpect =
-        expectation == CONN_EXPECT_MORE ?
-            CHAN_EXPECT_MORE : CHAN_EXPECT_NOTHING;
+        holding ? CHAN_EXPECT_MORE : CHAN_EXPECT_NOTHING;
 
-    bool failed;
+    bool succeeded;
 
-    ChannelWrite(connectionP->channelP, buffer, size, chanExpect, &failed);
+    if (size > OUT_BUFFER_SIZE - connectionP->outBufferSize)
+        /* Doesn't fit; make room */
+        succeeded = flushOutBuffer(connectionP, CHAN_EXPECT_MORE);
+    else
+        succeeded = true;
 
-    traceChannelWrite(connectionP, buffer, size, failed);
+    if (succeeded) {
+        if (connectionP->outBufferSize == 0 &&
+            (!holding || size > OUT_BUFFER_SIZE))
+            /* Nothing to join it with, or too big to buffer */
+            succeeded = writeToChannel(connectionP, buffer, size, chanExpect);
+        else {
+            memcpy(&connectionP->outBuffer[connectionP->outBufferSize],
+                   buffer, size);
+            connectionP->outBufferSize += size;
 
-    if (!failed)
+            if (!holding)
+                succeeded = flushOutBuffer(connectionP, chanExpect);
+        }
+    }
+    if (succeeded)
         connectionP->outbytes += size;
 
-    return !failed;
+    return succeeded;
 }
 
 
 
 bool
-ConnWriteFromFile(TConn *       const connectionP,
-                  const TFile * const fileP,
-                  uint64_t      const start,
-                  uint64_t      const last,
-                  void *        const buffer,
-                  uint32_t      const buffersize,
-                  uint32_t      const rate) {
+ConnFlush(TConn * const connectionP) {
 /*----------------------------------------------------------------------------
-   Write the contents of the file stream *fileP, from offset 'start'
-   up through 'last', to the HTTP connection *connectionP.
+  Send anything ConnWrite() has been holding for connection *connectionP.
+-----------------------------------------------------------------------------*/
+    return flushOutBuffer(connectionP, CHAN_EXPECT_NOTHING);
+}
 
-   Meter the reading so as not to read more than 'rate' bytes per second.
 
-   Use the 'bufferSize' bytes at 'buffer' as an internal buffer for this.
+
+static bool
+sendFromFile(TConn *       const connectionP,
+             const TFile * const fileP,
+             uint64_t      const start,
+             uint64_t      const totalBytesToSend,
+             uint32_t      const chunkSize,
+             uint32_t      const waittime) {
+/*----------------------------------------------------------------------------
+   Have the channel send the file contents directly from the file, 'chunkSize'
+   bytes at a time, waiting 'waittime' milliseconds after each chunk.
 -----------------------------------------------------------------------------*/
-    bool retval;
-    uint32_t waittime;
-    bool success;
-    uint32_t readChunkSize;
+    uint64_t bytesSent;
+    bool failed;
 
-    if (rate > 0) {
-        readChunkSize = MIN(buffersize, rate);  /* One second's worth */
-        waittime = (1000 * buffersize) / rate;
-    } else {
-        readChunkSize = buffersize;
-        waittime = 0;
+    /* The response header is probably waiting in the output buffer.  The
+       file contents go right behind it.
+    */
+    failed = !flushOutBuffer(connectionP, CHAN_EXPECT_MORE);
+
+    for (bytesSent = 0;
+         bytesSent < totalBytesToSend && !failed; ) {
+
+        uint64_t const bytesLeft     = totalBytesToSend - bytesSent;
+        uint64_t const bytesToSend64 = MIN(chunkSize, bytesLeft);
+        uint32_t const bytesToSend   = (uint32_t)bytesToSend64;
+
+        assert(bytesToSend == bytesToSend64); /* chunkSize is uint32 */
+
+        ChannelSendFile(connectionP->channelP, fileP->fd,
+                        start + bytesSent, bytesToSend, &failed);
+
+        if (!failed) {
+            bytesSent += bytesToSend;
+            connectionP->outbytes += bytesToSend;
+
+            if (waittime > 0)
+                xmlrpc_millisecond_sleep(waittime);
+        }
     }
+    return !failed;
+}
+
+
+
+static bool
+copyFromFile(TConn *       const connectionP,
+             const TFile * const fileP,
+             uint64_t      const start,
+             uint64_t      const totalBytesToRead,
+             void *        const buffer,
+             uint32_t      const readChunkSize,
+             uint32_t      const waittime) {
+/*----------------------------------------------------------------------------
+   Read the file contents into 'buffer', 'readChunkSize' bytes at a time,
+   and write each chunk to the connection, waiting 'waittime' milliseconds
+   after each.
+-----------------------------------------------------------------------------*/
+    bool retval;
+    bool success;
 
     success = FileSeek(fileP, start, SEEK_SET);
     if (!success)
         retval = false;
     else {
-        uint64_t const totalBytesToRead = last - start + 1;
         uint64_t bytesread;
 
         bytesread = 0;  /* initial value */
@@ -627,6 +833,60 @@ ConnWriteFromFile(TConn *       const connectionP,
 
 
 
+/* The most we have the channel send directly from a file in one go when
+   we aren't metering.  It just has to fit a uint32_t; the channel sends
+   it in however many pieces it needs.
+*/
+#define SENDFILE_CHUNK_SIZE (1u << 30)
+
+bool
+ConnWriteFromFile(TConn *       const connectionP,
+                  const TFile * const fileP,
+                  uint64_t      const start,
+                  uint64_t      const last,
+                  void *        const buffer,
+                  uint32_t      const buffersize,
+                  uint32_t      const rate) {
+/*----------------------------------------------------------------------------
+   Write the contents of the file stream *fileP, from offset 'start'
+   up through 'last', to the HTTP connection *connectionP.
+
+   Meter the reading so as not to read more than 'rate' bytes per second.
+
+   Use the 'bufferSize' bytes at 'buffer' as an internal buffer for this.
+
+   If the channel can send directly from a file (e.g. with sendfile() on a
+   plain socket), we have it do that and don't use the buffer.  But not
+   when we're tracing the connection, since the trace shows the data we
+   write.
+-----------------------------------------------------------------------------*/
+    uint64_t const totalBytes = last - start + 1;
+
+    uint32_t waittime;
+    uint32_t readChunkSize;
+    bool retval;
+
+    if (rate > 0) {
+        readChunkSize = MIN(buffersize, rate);  /* One second's worth */
+        waittime = (1000 * buffersize) / rate;
+    } else {
+        readChunkSize = buffersize;
+        waittime = 0;
+    }
+
+    if (ChannelCanSendFile(connectionP->channelP) && !connectionP->trace)
+        retval = sendFromFile(connectionP, fileP, start, totalBytes,
+                              rate > 0 ? readChunkSize : SENDFILE_CHUNK_SIZE,
+                              waittime);
+    else
+        retval = copyFromFile(connectionP, fileP, start, totalBytes,
+                              buffer, readChunkSize, waittime);
+
+    return retval;
+}
+
+
+
 TServer *
 ConnServer(TConn * const connectionP) {
     return connectionP->server;
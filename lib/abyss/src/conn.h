@@ -4,6 +4,7 @@
 #include "bool.h"
 #include "xmlrpc-c/abyss.h"
 #include "thread.h"
+#include "data.h"
 
 struct TFile;
 
@@ -13,6 +14,16 @@ struct TFile;
        transfer we actually transfer in 4096 byte chunks.
     */
 
+#define OUT_BUFFER_SIZE 4096
+    /* Size of the buffer in which we collect small writes, e.g. the lines
+       of a response header, so they go to the channel together.
+    */
+
+#define SESSION_POOL_ZONE_SIZE 4096
+    /* Size of the pieces in which the session memory pool gets memory.
+       This is enough for all the memory of a typical session.
+    */
+
 struct _TConn {
     struct _TConn * nextOutstandingP;
         /* Link to the next connection in the list of outstanding
@@ -56,6 +67,23 @@ struct _TConn {
            is done with the connection, exits.
         */
     TThreadDoneFn * done;
+    bool holdOutput;
+        /* ConnWrite() should leave output in the output buffer even where
+           the writer expects no more, because another response follows
+           right away (the client pipelined its requests), so the responses
+           can go to the client together.  We send what we are holding
+           before we wait for input, and when the output buffer fills.
+           Whoever sets this must eventually call ConnFlush().
+        */
+    TPool sessionPool;
+        /* Where the current session on the connection gets most of the
+           memory for its request and response, e.g. header fields and the
+           URI.  The session resets it when it is done, so the next
+           session on a kept-alive connection reuses the same memory.
+        */
+    uint32_t outBufferSize;
+        /* Number of bytes in outBuffer[] not yet sent */
+    char outBuffer[OUT_BUFFER_SIZE];
     union {
         unsigned char b[BUFFER_SIZE];  /* Just bytes */
         char          t[BUFFER_SIZE];  /* Taken as text */
@@ -100,6 +128,9 @@ ConnWrite(TConn *          const connectionP,
           uint32_t         const size,
           TConnWriteExpect const expectation);
 
+bool
+ConnFlush(TConn * const connectionP);
+
 void
 ConnRead(TConn *       const connectionP,
          uint32_t      const timeout,
@@ -110,6 +141,13 @@ ConnRead(TConn *       const connectionP,
 void
 ConnReadInit(TConn * const connectionP);
 
+void
+ConnReadDirect(TConn *       const connectionP,
+               uint32_t      const timeout,
+               char *        const buffer,
+               size_t        const len,
+               const char ** const errorP);
+
 bool
 ConnWriteFromFile(TConn *              const connectionP,
                   const struct TFile * const fileP,
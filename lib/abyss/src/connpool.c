@@ -0,0 +1,372 @@
+/*=============================================================================
+                                 connpool.c
+===============================================================================
+  This is a pool of worker threads that serve server connections.  See
+  connpool.h for the concept.
+
+  The workers exist for the life of the pool, so the server doesn't create
+  and destroy a thread for every connection.  And when all of them are busy,
+  the server doesn't poll for one to finish: it puts the new channel in the
+  queue, and a worker that finishes a connection takes the next channel
+  right away.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "bool.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/util_int.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/thread_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/abyss.h"
+#include "trace.h"
+#include "thread.h"
+#include "channel.h"
+#include "conn.h"
+
+#include "connpool.h"
+
+/* This is the maximum amount of stack a worker thread uses, not counting
+   what the connection job uses.
+*/
+#define WORKER_STACK 1024
+
+struct pendingChannel {
+    /* A channel waiting in the queue for a worker */
+    TChannel * channelP;
+    void *     channelInfoP;
+};
+
+struct worker {
+    TConnPool * poolP;
+    TThread *   threadP;
+    TConn *     connectionP;
+        /* The connection the worker is serving; NULL if none.  Protected
+           by the pool lock.
+        */
+};
+
+struct connPool {
+    TServer *             serverP;
+    TThreadProc *         job;
+    TThreadDoneFn *       done;
+    struct xmlrpc_queue * queueP;
+        /* Queue of struct pendingChannel */
+    unsigned int          workerCt;
+    struct worker *       workers;
+        /* Array of 'workerCt' */
+    struct lock *         lockP;
+        /* Protects 'terminating' and the workers' 'connectionP' */
+    bool                  terminating;
+        /* The pool is shutting down; workers must not start serving any
+           more connections.
+        */
+};
+
+
+
+static void
+discardChannel(struct pendingChannel * const pendingP) {
+
+    ChannelDestroy(pendingP->channelP);
+    free(pendingP->channelInfoP);
+}
+
+
+
+static void
+serveChannel(struct worker *         const workerP,
+             struct pendingChannel * const pendingP) {
+/*----------------------------------------------------------------------------
+   Make a connection on the channel *pendingP and run the pool's job on it,
+   in this worker's thread.
+-----------------------------------------------------------------------------*/
+    TConnPool * const poolP = workerP->poolP;
+
+    TConn * connectionP;
+    const char * error;
+
+    /* We don't give the connection the 'done' function, because we must
+       make the connection unreachable by ConnPoolDestroy() before its
+       channel goes away.
+    */
+    ConnCreate(&connectionP, poolP->serverP,
+               pendingP->channelP, pendingP->channelInfoP,
+               poolP->job, 0, NULL, ABYSS_FOREGROUND, false, &error);
+
+    if (error) {
+        TraceMsg("Failed to create a connection for an accepted "
+                 "channel.  %s", error);
+        xmlrpc_strfree(error);
+        discardChannel(pendingP);
+    } else {
+        bool terminating;
+
+        poolP->lockP->acquire(poolP->lockP);
+        terminating = poolP->terminating;
+        if (!terminating)
+            workerP->connectionP = connectionP;
+        poolP->lockP->release(poolP->lockP);
+
+        if (!terminating) {
+            ConnProcess(connectionP);
+
+            poolP->lockP->acquire(poolP->lockP);
+            workerP->connectionP = NULL;
+            poolP->lockP->release(poolP->lockP);
+        }
+        if (poolP->done)
+            poolP->done(connectionP);
+
+        ConnWaitAndRelease(connectionP);
+    }
+}
+
+
+
+static TThreadProc workerFunc;
+
+static void
+workerFunc(void * const userHandle) {
+
+    struct worker * const workerP = userHandle;
+    TConnPool *     const poolP   = workerP->poolP;
+
+    bool closed;
+
+    for (closed = false; !closed; ) {
+        void * item;
+
+        xmlrpc_queue_get(poolP->queueP, &item, &closed);
+
+        if (!closed) {
+            struct pendingChannel * const pendingP = item;
+
+            serveChannel(workerP, pendingP);
+
+            free(pendingP);
+        }
+    }
+}
+
+
+
+static TThreadDoneFn workerDone;
+
+static void
+workerDone(void * const userHandle ATTR_UNUSED) {
+
+}
+
+
+
+static void
+destroyWorkers(TConnPool *  const poolP,
+               unsigned int const workerCt) {
+/*----------------------------------------------------------------------------
+   Wait for the first 'workerCt' workers of the pool to exit, and release
+   them.  Caller must have closed the queue.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    for (i = 0; i < workerCt; ++i)
+        ThreadWaitAndRelease(poolP->workers[i].threadP);
+
+    free(poolP->workers);
+}
+
+
+
+static void
+createWorkers(TConnPool *   const poolP,
+              unsigned int  const workerCt,
+              size_t        const jobStackSize,
+              const char ** const errorP) {
+
+    MALLOCARRAY(poolP->workers, workerCt);
+
+    if (poolP->workers == NULL)
+        xmlrpc_asprintf(errorP, "Could not allocate memory for %u "
+                        "worker thread descriptors", workerCt);
+    else {
+        unsigned int i;
+
+        for (i = 0, *errorP = NULL; i < workerCt && !*errorP; ++i) {
+            struct worker * const workerP = &poolP->workers[i];
+
+            const char * error;
+
+            workerP->poolP       = poolP;
+            workerP->connectionP = NULL;
+
+            ThreadCreate(&workerP->threadP, workerP,
+                         &workerFunc, &workerDone, false,
+                         WORKER_STACK + jobStackSize, &error);
+
+            if (error) {
+                xmlrpc_asprintf(errorP, "Failed to create worker thread "
+                                "%u.  %s", i, error);
+                xmlrpc_strfree(error);
+
+                xmlrpc_queue_close(poolP->queueP);
+                destroyWorkers(poolP, i);
+            } else
+                ThreadRun(workerP->threadP);
+        }
+        poolP->workerCt = workerCt;
+    }
+}
+
+
+
+bool
+ConnPoolIsAvailable(void) {
+/*----------------------------------------------------------------------------
+   A connection pool is possible.  That requires Abyss threads to be real
+   threads that share our memory, not processes.
+-----------------------------------------------------------------------------*/
+    return !ThreadForks();
+}
+
+
+
+void
+ConnPoolCreate(TServer *       const serverP,
+               TThreadProc *   const job,
+               TThreadDoneFn * const done,
+               unsigned int    const workerCt,
+               unsigned int    const queueDepth,
+               size_t          const jobStackSize,
+               TConnPool **    const poolPP,
+               const char **   const errorP) {
+/*----------------------------------------------------------------------------
+   Create a pool of 'workerCt' threads, fed by a queue of 'queueDepth'
+   channels, to serve connections for server *serverP.
+
+   For each channel, the pool runs 'job' on a connection on that channel,
+   then calls 'done' (unless it is NULL), both with the connection as
+   argument.  'job' may use up to 'jobStackSize' bytes of stack.
+-----------------------------------------------------------------------------*/
+    TConnPool * poolP;
+
+    assert(ConnPoolIsAvailable());
+    assert(workerCt > 0);
+    assert(queueDepth > 0);
+
+    MALLOCVAR(poolP);
+
+    if (poolP == NULL)
+        xmlrpc_asprintf(errorP, "Could not allocate memory for "
+                        "connection pool");
+    else {
+        poolP->serverP     = serverP;
+        poolP->job         = job;
+        poolP->done        = done;
+        poolP->terminating = false;
+
+        poolP->lockP = xmlrpc_lock_create();
+
+        if (poolP->lockP == NULL)
+            xmlrpc_asprintf(errorP, "Could not create lock");
+        else {
+            const char * error;
+
+            xmlrpc_queue_create(&poolP->queueP, queueDepth, &error);
+
+            if (error) {
+                xmlrpc_asprintf(errorP, "Could not create a queue for %u "
+                                "channels.  %s", queueDepth, error);
+                xmlrpc_strfree(error);
+            } else {
+                createWorkers(poolP, workerCt, jobStackSize, errorP);
+
+                if (*errorP)
+                    xmlrpc_queue_destroy(poolP->queueP);
+            }
+            if (*errorP)
+                poolP->lockP->destroy(poolP->lockP);
+        }
+        if (*errorP)
+            free(poolP);
+    }
+    *poolPP = poolP;
+}
+
+
+
+void
+ConnPoolDestroy(TConnPool * const poolP) {
+/*----------------------------------------------------------------------------
+   Shut down the pool: discard the channels still in the queue and end the
+   worker threads.
+
+   Workers that are serving connections finish them first, but we interrupt
+   any waiting they do on their channels, so that is quick.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    poolP->lockP->acquire(poolP->lockP);
+
+    poolP->terminating = true;
+
+    for (i = 0; i < poolP->workerCt; ++i) {
+        TConn * const connectionP = poolP->workers[i].connectionP;
+
+        if (connectionP)
+            ChannelInterrupt(connectionP->channelP);
+    }
+    poolP->lockP->release(poolP->lockP);
+
+    /* Workers take what's left in the queue and, seeing 'terminating',
+       discard it; then, finding the queue closed and empty, they exit.
+    */
+    xmlrpc_queue_close(poolP->queueP);
+
+    destroyWorkers(poolP, poolP->workerCt);
+
+    xmlrpc_queue_destroy(poolP->queueP);
+    poolP->lockP->destroy(poolP->lockP);
+    free(poolP);
+}
+
+
+
+void
+ConnPoolSubmit(TConnPool *   const poolP,
+               TChannel *    const channelP,
+               void *        const channelInfoP,
+               const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Have the pool serve channel *channelP.  Wait if necessary for there to be
+   room in the queue.
+
+   The pool then owns *channelP and *channelInfoP.  But if we fail, we
+   don't touch them.
+-----------------------------------------------------------------------------*/
+    struct pendingChannel * pendingP;
+
+    MALLOCVAR(pendingP);
+
+    if (pendingP == NULL)
+        xmlrpc_asprintf(errorP, "Could not allocate memory for a "
+                        "queued channel descriptor");
+    else {
+        bool closed;
+
+        pendingP->channelP     = channelP;
+        pendingP->channelInfoP = channelInfoP;
+
+        xmlrpc_queue_put(poolP->queueP, pendingP, &closed);
+
+        if (closed) {
+            xmlrpc_asprintf(errorP, "Connection pool is shutting down");
+            free(pendingP);
+        } else
+            *errorP = NULL;
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef CONNPOOL_H_INCLUDED
+#define CONNPOOL_H_INCLUDED
+
+/*============================================================================
+   A fixed set of pre-started threads that serve server connections.
+
+   The server puts each channel it accepts in a bounded queue; the next free
+   worker thread takes it, makes a connection on it, and runs the
+   connection's job (normally, serving HTTP requests until the connection
+   closes).  When the queue is full, the server waits for a worker to take
+   something from it.
+============================================================================*/
+
+#include "bool.h"
+#include "xmlrpc-c/abyss.h"
+
+#include "thread.h"
+
+typedef struct connPool TConnPool;
+
+bool
+ConnPoolIsAvailable(void);
+
+void
+ConnPoolCreate(TServer *       const serverP,
+               TThreadProc *   const job,
+               TThreadDoneFn * const done,
+               unsigned int    const workerCt,
+               unsigned int    const queueDepth,
+               size_t          const jobStackSize,
+               TConnPool **    const poolPP,
+               const char **   const errorP);
+
+void
+ConnPoolDestroy(TConnPool * const poolP);
+
+void
+ConnPoolSubmit(TConnPool *   const poolP,
+               TChannel *    const channelP,
+               void *        const channelInfoP,
+               const char ** const errorP);
+
+#endif
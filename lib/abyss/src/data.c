@@ -35,7 +35,9 @@
 #define _XOPEN_SOURCE 600  /* Make sure strdup() is in <string.h> */
 
 #include <assert.h>
+#include <stdarg.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "bool.h"
@@ -152,6 +154,12 @@ ListRemove(TList * const listP) {
 bool
 ListAddFromString(TList *      const listP,
                   const char * const stringArg) {
+/*----------------------------------------------------------------------------
+   Add to the list each of the comma-separated items in 'stringArg'.
+
+   The list items are newly malloc'ed copies, so the list should be an
+   auto-free one.
+-----------------------------------------------------------------------------*/
 
     bool retval;
     
@@ -187,11 +195,20 @@ ListAddFromString(TList *      const listP,
                         *p = '\0';
                     
                     if (t[0] != '\0') {
-                        bool added;
-                        added = ListAdd(listP, (void*)t);
-                        
-                        if (!added)
+                        /* 't' points into 'buffer', which we free below */
+                        char * const item = strdup(t);
+
+                        if (!item)
                             error = true;
+                        else {
+                            bool added;
+                            added = ListAdd(listP, item);
+
+                            if (!added) {
+                                free(item);
+                                error = true;
+                            }
+                        }
                     }
                 }
             }
@@ -408,13 +425,31 @@ void TableInit(TTable * const t)
 {
     t->item=NULL;
     t->size=t->maxsize=0;
+    t->poolP=NULL;
 }
 
+
+
+void
+TableInitPool(TTable * const tableP,
+              TPool *  const poolP) {
+/*----------------------------------------------------------------------------
+   Initialize a table whose memory comes from pool *poolP.  The table's
+   memory goes away when the pool is reset or freed; TableFree() doesn't
+   free anything.
+-----------------------------------------------------------------------------*/
+    TableInit(tableP);
+
+    tableP->poolP = poolP;
+}
+
+
+
 void TableFree(TTable * const t)
 {
     uint16_t i;
 
-    if (t->item)
+    if (t->item && !t->poolP)
     {
         if (t->size)
             for (i=t->size;i>0;i--)
@@ -431,6 +466,28 @@ void TableFree(TTable * const t)
 
 
 
+static char *
+tableStrdup(TTable *     const tableP,
+            const char * const string) {
+
+    if (tableP->poolP)
+        return (char *)PoolStrdup(tableP->poolP, string);
+    else
+        return strdup(string);
+}
+
+
+
+static void
+tableStrfree(TTable * const tableP,
+             char *   const string) {
+
+    if (!tableP->poolP)
+        free(string);
+}
+
+
+
 static void
 tableFindIndex(TTable *       const tableP,
                const char *   const targetName,
@@ -474,11 +531,11 @@ TableAddReplace(TTable *     const tableP,
     tableFindIndex(tableP, name, &found, &tableIndex);
 
     if (found) {
-        free(tableP->item[tableIndex].value);
+        tableStrfree(tableP, tableP->item[tableIndex].value);
         if (value)
-            tableP->item[tableIndex].value = strdup(value);
+            tableP->item[tableIndex].value = tableStrdup(tableP, value);
         else {
-            free(tableP->item[tableIndex].name);
+            tableStrfree(tableP, tableP->item[tableIndex].name);
             if (--tableP->size > 0)
                 tableP->item[tableIndex] = tableP->item[tableP->size];
         }
@@ -489,27 +546,58 @@ TableAddReplace(TTable *     const tableP,
 
 
 
+static TTableItem *
+tableGrow(TTable * const tableP,
+          uint16_t const newMaxSize) {
+/*----------------------------------------------------------------------------
+   Return a copy of the table's item array with room for 'newMaxSize' items,
+   or NULL if we can't get the memory.  A pool can't grow a block in place,
+   so there we copy and leave the old array to go away with the pool.
+-----------------------------------------------------------------------------*/
+    TTableItem * newItem;
+
+    if (tableP->poolP) {
+        newItem = PoolAlloc(tableP->poolP, newMaxSize * sizeof(TTableItem));
+        if (newItem && tableP->size > 0)
+            memcpy(newItem, tableP->item, tableP->size * sizeof(TTableItem));
+    } else
+        newItem = realloc(tableP->item, newMaxSize * sizeof(TTableItem));
+
+    return newItem;
+}
+
+
+
 bool
 TableAdd(TTable *     const t,
          const char * const name,
          const char * const value) {
 
+    char * nameCopy;
+    char * valueCopy;
+
     if (t->size>=t->maxsize) {
-        TTableItem *newitem;
-        
-        t->maxsize+=16;
+        TTableItem * const newitem = tableGrow(t, t->maxsize + 16);
 
-        newitem=(TTableItem *)realloc(t->item,(t->maxsize)*sizeof(TTableItem));
-        if (newitem)
+        if (newitem) {
             t->item=newitem;
-        else {
-            t->maxsize-=16;
+            t->maxsize+=16;
+        } else
             return false;
-        }
     }
 
-    t->item[t->size].name=strdup(name);
-    t->item[t->size].value=strdup(value);
+    nameCopy  = tableStrdup(t, name);
+    valueCopy = tableStrdup(t, value);
+
+    if (!nameCopy || !valueCopy) {
+        if (nameCopy)
+            tableStrfree(t, nameCopy);
+        if (valueCopy)
+            tableStrfree(t, valueCopy);
+        return false;
+    }
+    t->item[t->size].name=nameCopy;
+    t->item[t->size].value=valueCopy;
     t->item[t->size].hash=Hash16(name);
 
     ++t->size;
@@ -541,12 +629,17 @@ TableValue(TTable *     const tableP,
 ** Pool
 *********************************************************************/
 
+#define POOL_ALIGNMENT 8
+    /* Every block PoolAlloc() returns is aligned to this many bytes, which
+       is enough for any pointer or integer type.
+    */
+
 static TPoolZone *
 PoolZoneAlloc(uint32_t const zonesize) {
 
     TPoolZone * poolZoneP;
     
-    MALLOCARRAY(poolZoneP, zonesize);
+    poolZoneP = malloc(sizeof(TPoolZone) + zonesize);
     if (poolZoneP) {
         poolZoneP->pos    = &poolZoneP->data[0];
         poolZoneP->maxpos = poolZoneP->pos + zonesize;
@@ -566,24 +659,35 @@ PoolZoneFree(TPoolZone * const poolZoneP) {
 
 
 
+static bool
+poolInit(TPool *  const poolP,
+         uint32_t const zonesize) {
+
+    TPoolZone * const firstZoneP = PoolZoneAlloc(zonesize);
+
+    poolP->zonesize  = zonesize;
+    poolP->allocated = 0;
+    poolP->limit     = 0;
+
+    if (firstZoneP) {
+        poolP->firstzone   = firstZoneP;
+        poolP->currentzone = firstZoneP;
+    }
+    return firstZoneP != NULL;
+}
+
+
+
 bool
 PoolCreate(TPool *  const poolP,
            uint32_t const zonesize) {
 
     bool success;
 
-    poolP->zonesize = zonesize;
-
     poolP->lockP = xmlrpc_lock_create();
     if (poolP->lockP) {
-        TPoolZone * const firstZoneP = PoolZoneAlloc(zonesize);
+        success = poolInit(poolP, zonesize);
 
-        if (firstZoneP != NULL) {
-            poolP->firstzone   = firstZoneP;
-            poolP->currentzone = firstZoneP;
-            success = true;
-        } else
-            success = false;
         if (!success)
             poolP->lockP->destroy(poolP->lockP);
     } else
@@ -594,6 +698,71 @@ PoolCreate(TPool *  const poolP,
 
 
 
+bool
+PoolCreateUnlocked(TPool *  const poolP,
+                   uint32_t const zonesize) {
+/*----------------------------------------------------------------------------
+   Same as PoolCreate(), but for a pool that only one thread at a time uses,
+   so allocating from it needn't take a lock.
+-----------------------------------------------------------------------------*/
+    poolP->lockP = NULL;
+
+    return poolInit(poolP, zonesize);
+}
+
+
+
+void
+PoolSetLimit(TPool * const poolP,
+             size_t  const limit) {
+/*----------------------------------------------------------------------------
+   Make PoolAlloc() fail rather than hand out more than 'limit' bytes in
+   total before the next PoolReset().  Zero means no limit.
+-----------------------------------------------------------------------------*/
+    poolP->limit = limit;
+}
+
+
+
+static void *
+poolAlloc(TPool *  const poolP,
+          uint32_t const size) {
+
+    uint32_t const alignedSize =
+        (size + POOL_ALIGNMENT - 1) & ~(POOL_ALIGNMENT - 1);
+
+    TPoolZone * const curPoolZoneP = poolP->currentzone;
+    size_t const zoneSpace = curPoolZoneP->maxpos - curPoolZoneP->pos;
+
+    void * retval;
+
+    if (poolP->limit > 0 && poolP->allocated + alignedSize > poolP->limit)
+        retval = NULL;
+    else if (alignedSize <= zoneSpace) {
+        retval = curPoolZoneP->pos;
+        curPoolZoneP->pos += alignedSize;
+    } else {
+        uint32_t const zonesize = MAX(alignedSize, poolP->zonesize);
+
+        TPoolZone * const newPoolZoneP = PoolZoneAlloc(zonesize);
+        if (newPoolZoneP) {
+            newPoolZoneP->prev = curPoolZoneP;
+            newPoolZoneP->next = curPoolZoneP->next;
+            curPoolZoneP->next = newPoolZoneP;
+            poolP->currentzone = newPoolZoneP;
+            retval= newPoolZoneP->data;
+            newPoolZoneP->pos = newPoolZoneP->data + alignedSize;
+        } else
+            retval = NULL;
+    }
+    if (retval)
+        poolP->allocated += alignedSize;
+
+    return retval;
+}
+
+
+
 void *
 PoolAlloc(TPool *  const poolP,
           uint32_t const size) {
@@ -605,30 +774,13 @@ PoolAlloc(TPool *  const poolP,
     if (size == 0)
         retval = NULL;
     else {
-        poolP->lockP->acquire(poolP->lockP);
-        {
-            TPoolZone * const curPoolZoneP = poolP->currentzone;
-
-
-            if (curPoolZoneP->pos + size < curPoolZoneP->maxpos) {
-                retval = curPoolZoneP->pos;
-                curPoolZoneP->pos += size;
-            } else {
-                uint32_t const zonesize = MAX(size, poolP->zonesize);
-
-                TPoolZone * const newPoolZoneP = PoolZoneAlloc(zonesize);
-                if (newPoolZoneP) {
-                    newPoolZoneP->prev = curPoolZoneP;
-                    newPoolZoneP->next = curPoolZoneP->next;
-                    curPoolZoneP->next = newPoolZoneP;
-                    poolP->currentzone = newPoolZoneP;
-                    retval= newPoolZoneP->data;
-                    newPoolZoneP->pos = newPoolZoneP->data + size;
-                } else
-                    retval = NULL;
-            }
-        }
-        poolP->lockP->release(poolP->lockP);
+        if (poolP->lockP)
+            poolP->lockP->acquire(poolP->lockP);
+
+        retval = poolAlloc(poolP, size);
+
+        if (poolP->lockP)
+            poolP->lockP->release(poolP->lockP);
     }
     return retval;
 }
@@ -644,19 +796,22 @@ PoolReturn(TPool *  const poolP,
 -----------------------------------------------------------------------------*/
     TPoolZone * const curPoolZoneP = poolP->currentzone;
 
-    assert((char*)curPoolZoneP->data < (char*)blockP &&
+    assert((char*)curPoolZoneP->data <= (char*)blockP &&
            (char*)blockP < (char*)curPoolZoneP->pos);
 
+    poolP->allocated -= curPoolZoneP->pos - (char *)blockP;
+
     curPoolZoneP->pos = blockP;
 
-    if (curPoolZoneP->pos == curPoolZoneP->data) {
+    if (curPoolZoneP->pos == curPoolZoneP->data &&
+        curPoolZoneP != poolP->firstzone) {
         /* That emptied out the current zone.  Free it and make the previous
            zone current.
         */
+        assert(curPoolZoneP->prev);
 
-        assert(curPoolZoneP->prev);  /* entry condition */
-
-        curPoolZoneP->prev->next = NULL;
+        curPoolZoneP->prev->next = curPoolZoneP->next;
+        poolP->currentzone = curPoolZoneP->prev;
 
         PoolZoneFree(curPoolZoneP);
     }
@@ -664,6 +819,28 @@ PoolReturn(TPool *  const poolP,
 
 
 
+void
+PoolReset(TPool * const poolP) {
+/*----------------------------------------------------------------------------
+   Take back everything allocated from the pool, all at once.  We keep the
+   first zone for reuse and free the rest.
+-----------------------------------------------------------------------------*/
+    TPoolZone * poolZoneP;
+    TPoolZone * nextPoolZoneP;
+
+    for (poolZoneP = poolP->firstzone->next; poolZoneP;
+         poolZoneP = nextPoolZoneP) {
+        nextPoolZoneP = poolZoneP->next;
+        PoolZoneFree(poolZoneP);
+    }
+    poolP->firstzone->next = NULL;
+    poolP->firstzone->pos  = poolP->firstzone->data;
+    poolP->currentzone     = poolP->firstzone;
+    poolP->allocated       = 0;
+}
+
+
+
 void
 PoolFree(TPool * const poolP) {
 
@@ -674,7 +851,8 @@ PoolFree(TPool * const poolP) {
         nextPoolZoneP = poolZoneP->next;
         free(poolZoneP);
     }
-    poolP->lockP->destroy(poolP->lockP);
+    if (poolP->lockP)
+        poolP->lockP->destroy(poolP->lockP);
 }
 
 
@@ -694,3 +872,35 @@ PoolStrdup(TPool *      const poolP,
     }
     return newString;
 }
+
+
+
+const char *
+PoolPrintf(TPool *      const poolP,
+           const char * const fmt,
+           ...) {
+/*----------------------------------------------------------------------------
+   Like xmlrpc_asprintf(), but the string comes from pool *poolP.  Return
+   NULL if the pool can't supply the memory.
+-----------------------------------------------------------------------------*/
+    va_list args;
+    int len;
+    char * retval;
+
+    va_start(args, fmt);
+    len = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+
+    if (len < 0)
+        retval = NULL;
+    else {
+        retval = PoolAlloc(poolP, len + 1);
+
+        if (retval) {
+            va_start(args, fmt);
+            vsnprintf(retval, len + 1, fmt, args);
+            va_end(args);
+        }
+    }
+    return retval;
+}
@@ -3,6 +3,7 @@
 
 #include "bool.h"
 #include "int.h"
+#include "c_util.h"
 
 struct lock;
 
@@ -104,15 +105,26 @@ typedef struct
     uint16_t hash;
 } TTableItem;
 
+struct _TPool;
+
 typedef struct
 {
     TTableItem *item;
     uint16_t size,maxsize;
+    struct _TPool * poolP;
+        /* The pool from which the items and their strings come, so that
+           freeing the pool frees them.  NULL means they are individually
+           malloc'ed.
+        */
 } TTable;
 
 void
 TableInit(TTable * const t);
 
+void
+TableInitPool(TTable *        const t,
+              struct _TPool * const poolP);
+
 void
 TableFree(TTable * const t);
 
@@ -144,17 +156,35 @@ typedef struct _TPoolZone {
     char data[1];
 } TPoolZone;
 
-typedef struct {
+typedef struct _TPool {
     TPoolZone * firstzone;
     TPoolZone * currentzone;
     uint32_t zonesize;
     struct lock * lockP;
+        /* NULL means only one thread uses the pool, so it needs no lock */
+    size_t allocated;
+        /* Bytes handed out since the pool was created or last reset */
+    size_t limit;
+        /* Most bytes PoolAlloc() may hand out before a reset.  Zero means
+           no limit.
+        */
 } TPool;
 
 bool
 PoolCreate(TPool *  const poolP,
            uint32_t const zonesize);
 
+bool
+PoolCreateUnlocked(TPool *  const poolP,
+                   uint32_t const zonesize);
+
+void
+PoolSetLimit(TPool * const poolP,
+             size_t  const limit);
+
+void
+PoolReset(TPool * const poolP);
+
 void
 PoolFree(TPool * const poolP);
 
@@ -170,5 +200,10 @@ const char *
 PoolStrdup(TPool *      const poolP,
            const char * const origString);
 
+const char *
+PoolPrintf(TPool *      const poolP,
+           const char * const fmt,
+           ...) GNU_PRINTF_ATTR(2,3);
+
 
 #endif
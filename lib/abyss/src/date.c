@@ -29,25 +29,49 @@ static char *_DateMonth[12]=
 
 
 
-void
-DateToString(time_t        const datetime,
-             const char ** const dateStringP) {
+bool
+DateFormat(time_t const datetime,
+           char * const buffer,
+           size_t const bufferSize) {
+/*----------------------------------------------------------------------------
+   Format 'datetime' as an HTTP date (RFC 1123) into buffer[], which is
+   'bufferSize' bytes.  DATE_STRING_SIZE is enough.
 
+   Return false if we can't, because 'datetime' isn't representable.
+-----------------------------------------------------------------------------*/
     struct tm brokenTime;
+    bool retval;
 
     xmlrpc_gmtime(datetime, &brokenTime);
 
     if (mktime(&brokenTime) == (time_t)-1)
-        *dateStringP = NULL;
+        retval = false;
+    else {
+        snprintf(buffer, bufferSize, "%s, %02u %s %04u %02u:%02u:%02u UTC",
+                 _DateDay[brokenTime.tm_wday],
+                 brokenTime.tm_mday,
+                 _DateMonth[brokenTime.tm_mon],
+                 1900 + brokenTime.tm_year,
+                 brokenTime.tm_hour,
+                 brokenTime.tm_min,
+                 brokenTime.tm_sec);
+        retval = true;
+    }
+    return retval;
+}
+
+
+
+void
+DateToString(time_t        const datetime,
+             const char ** const dateStringP) {
+
+    char buffer[DATE_STRING_SIZE];
+
+    if (DateFormat(datetime, buffer, sizeof(buffer)))
+        *dateStringP = xmlrpc_strdupsol(buffer);
     else
-        xmlrpc_asprintf(dateStringP, "%s, %02u %s %04u %02u:%02u:%02u UTC",
-                        _DateDay[brokenTime.tm_wday],
-                        brokenTime.tm_mday,
-                        _DateMonth[brokenTime.tm_mon],
-                        1900 + brokenTime.tm_year,
-                        brokenTime.tm_hour,
-                        brokenTime.tm_min,
-                        brokenTime.tm_sec);
+        *dateStringP = NULL;
 }
 
 
@@ -1,10 +1,19 @@
 #ifndef DATE_H_INCLUDED
 #define DATE_H_INCLUDED
 
+#include <stddef.h>
 #include <time.h>
 
 #include "bool.h"
 
+#define DATE_STRING_SIZE 40
+    /* Enough for any string DateFormat() produces */
+
+bool
+DateFormat(time_t const datetime,
+           char * const buffer,
+           size_t const bufferSize);
+
 void
 DateToString(time_t        const datetime,
              const char ** const dateStringP);
@@ -56,6 +56,7 @@
     /* Same as above, but for AIX */
 
 #include <string.h>
+#include <assert.h>
 
 #if MSVCRT
   #include <io.h>
@@ -65,6 +66,7 @@
   #include <fcntl.h>
   #include <dirent.h>
   #include <sys/stat.h>
+  #include <sys/uio.h>
   typedef ssize_t readwriterc_t;
 #endif
 
@@ -171,6 +173,57 @@ FileWrite(const TFile * const fileP,
 
 
 
+bool
+FileWriteSegments(const TFile *        const fileP,
+                  const TFileSegment * const segments,
+                  unsigned int         const segmentCt) {
+/*----------------------------------------------------------------------------
+   Write the 'segmentCt' segments 'segments', in order, with as few system
+   calls as the OS allows: one, unless the OS writes only part of it.
+-----------------------------------------------------------------------------*/
+#if MSVCRT
+    unsigned int i;
+    bool success;
+
+    for (i = 0, success = true; i < segmentCt && success; ++i)
+        success = FileWrite(fileP, segments[i].base, segments[i].len);
+
+    return success;
+#else
+    struct iovec iov[FILE_SEGMENT_MAX];
+    unsigned int i;
+    bool failed;
+
+    assert(segmentCt <= FILE_SEGMENT_MAX);
+
+    for (i = 0; i < segmentCt; ++i) {
+        iov[i].iov_base = (void *)segments[i].base;
+        iov[i].iov_len  = segments[i].len;
+    }
+    for (i = 0, failed = false; i < segmentCt && !failed; ) {
+        readwriterc_t const rc = writev(fileP->fd, &iov[i], segmentCt - i);
+
+        if (rc <= 0)
+            failed = true;
+        else {
+            size_t left;
+
+            /* Skip what got written, which may end mid-segment */
+            for (left = rc; i < segmentCt && left >= iov[i].iov_len; ++i)
+                left -= iov[i].iov_len;
+
+            if (left > 0) {
+                iov[i].iov_base = (char *)iov[i].iov_base + left;
+                iov[i].iov_len -= left;
+            }
+        }
+    }
+    return !failed;
+#endif
+}
+
+
+
 int32_t
 FileRead(const TFile * const fileP,
          void *        const buffer,
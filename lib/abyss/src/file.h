@@ -62,6 +62,15 @@ typedef struct TFile {
     int fd;
 } TFile;
 
+typedef struct {
+    /* A piece of a gathered write; see FileWriteSegments() */
+    const void * base;
+    uint32_t     len;
+} TFileSegment;
+
+#define FILE_SEGMENT_MAX 64
+    /* Maximum number of segments in one FileWriteSegments() */
+
 bool
 FileOpen(TFile **     const filePP,
          const char * const name,
@@ -80,6 +89,11 @@ FileWrite(const TFile * const fileP,
           const void *  const buffer,
           uint32_t      const len);
 
+bool
+FileWriteSegments(const TFile *        const fileP,
+                  const TFileSegment * const segments,
+                  unsigned int         const segmentCt);
+
 int32_t
 FileRead(const TFile * const fileP,
          void *        const buffer,
@@ -31,11 +31,104 @@
 
 
 
+/*********************************************************************
+** Request header fields
+*********************************************************************/
+
+#define KNOWN_FIELD_HASH_SIZE 32
+
+static struct {
+    const char * name;
+    HttpField    field;
+} const knownFieldTable[KNOWN_FIELD_HASH_SIZE] = {
+    /* Indexed by knownFieldHash() of the name.  That hash is perfect for
+       these names, i.e. no two of them hash to the same slot.  If you add
+       a name, you may have to change the hash function too.
+    */
+    { "content-type", HTTPFIELD_CONTENT_TYPE },
+    { NULL, HTTPFIELD_OTHER },
+    { "user-agent", HTTPFIELD_USER_AGENT },
+    { "cookies", HTTPFIELD_COOKIES },
+    { NULL, HTTPFIELD_OTHER },
+    { "transfer-encoding", HTTPFIELD_TRANSFER_ENCODING },
+    { "content-length", HTTPFIELD_CONTENT_LENGTH },
+    { NULL, HTTPFIELD_OTHER },
+    { NULL, HTTPFIELD_OTHER },
+    { NULL, HTTPFIELD_OTHER },
+    { "connection", HTTPFIELD_CONNECTION },
+    { "accept-encoding", HTTPFIELD_ACCEPT_ENCODING },
+    { NULL, HTTPFIELD_OTHER },
+    { NULL, HTTPFIELD_OTHER },
+    { NULL, HTTPFIELD_OTHER },
+    { "referer", HTTPFIELD_REFERER },
+    { "from", HTTPFIELD_FROM },
+    { "range", HTTPFIELD_RANGE },
+    { NULL, HTTPFIELD_OTHER },
+    { NULL, HTTPFIELD_OTHER },
+    { "host", HTTPFIELD_HOST },
+    { "if-modified-since", HTTPFIELD_IF_MODIFIED_SINCE },
+    { NULL, HTTPFIELD_OTHER },
+    { NULL, HTTPFIELD_OTHER },
+    { NULL, HTTPFIELD_OTHER },
+    { NULL, HTTPFIELD_OTHER },
+    { "cookie", HTTPFIELD_COOKIE },
+    { NULL, HTTPFIELD_OTHER },
+    { "content-encoding", HTTPFIELD_CONTENT_ENCODING },
+    { "authorization", HTTPFIELD_AUTHORIZATION },
+    { "expect", HTTPFIELD_EXPECT },
+    { NULL, HTTPFIELD_OTHER }
+};
+
+
+
+static unsigned int
+knownFieldHash(const char * const name,
+               size_t       const nameLen) {
+
+    return (nameLen +
+            8  * (unsigned char)name[0] +
+            12 * (unsigned char)name[nameLen-1]) % KNOWN_FIELD_HASH_SIZE;
+}
+
+
+
+HttpField
+HTTPFieldFromName(const char * const name,
+                  size_t       const nameLen) {
+/*----------------------------------------------------------------------------
+   The known field whose (lower case) name is the 'nameLen' characters at
+   'name'; HTTPFIELD_OTHER if it isn't one we know.
+-----------------------------------------------------------------------------*/
+    HttpField retval;
+
+    if (nameLen == 0)
+        retval = HTTPFIELD_OTHER;
+    else {
+        unsigned int const slot = knownFieldHash(name, nameLen);
+
+        const char * const knownName = knownFieldTable[slot].name;
+
+        if (knownName && strlen(knownName) == nameLen &&
+            memcmp(knownName, name, nameLen) == 0)
+            retval = knownFieldTable[slot].field;
+        else
+            retval = HTTPFIELD_OTHER;
+    }
+    return retval;
+}
+
+
+
 const char *
 RequestHeaderValue(TSession *   const sessionP,
                    const char * const name) {
 
-    return TableValue(&sessionP->requestHeaderFields, name);
+    HttpField const field = HTTPFieldFromName(name, strlen(name));
+
+    if (field == HTTPFIELD_OTHER)
+        return TableValue(&sessionP->requestHeaderFields, name);
+    else
+        return sessionP->knownFieldValue[field];
 }
 
 
@@ -136,17 +229,16 @@ RequestAuth(TSession *   const sessionP,
 
     authValue = RequestHeaderValue(sessionP, "authorization");
     if (authValue) {
-        char * const valueBuffer = malloc(strlen(authValue) + 1);
+        char * const valueBuffer = (char *)SessionStrdup(sessionP, authValue);
             /* A buffer we can mangle as we parse the authorization: value */
 
-        if (!authValue)
+        if (!valueBuffer)
             /* Should return error, but we have no way to do that */
             authorized = false;
         else {
             const char * authType;
             char * authHdrPtr;
 
-            strcpy(valueBuffer, authValue);  /* initial value */
             authHdrPtr = &valueBuffer[0];
 
             NextToken((const char **)&authHdrPtr);
@@ -163,7 +255,8 @@ RequestAuth(TSession *   const sessionP,
                     xmlrpc_strfree(userPass);
 
                     if (xmlrpc_streq(authHdrPtr, userPassEncoded)) {
-                        sessionP->requestInfo.user = xmlrpc_strdupsol(user);
+                        sessionP->requestInfo.user =
+                            SessionStrdup(sessionP, user);
                         authorized = true;
                     } else
                         authorized = false;
@@ -171,8 +264,6 @@ RequestAuth(TSession *   const sessionP,
                     authorized = false;
             } else
                 authorized = false;
-
-            free(valueBuffer);
         }
     } else
         authorized = false;
@@ -4,6 +4,34 @@
 #include <sys/types.h>
 #include "xmlrpc-c/abyss.h"
 
+typedef enum {
+    /* An HTTP request header field that Abyss or the Xmlrpc-c request
+       handler looks up by name.  We keep the value of each of these in
+       the session, so a lookup doesn't have to search all the fields.
+    */
+    HTTPFIELD_ACCEPT_ENCODING,
+    HTTPFIELD_AUTHORIZATION,
+    HTTPFIELD_CONNECTION,
+    HTTPFIELD_CONTENT_ENCODING,
+    HTTPFIELD_CONTENT_LENGTH,
+    HTTPFIELD_CONTENT_TYPE,
+    HTTPFIELD_COOKIE,
+    HTTPFIELD_COOKIES,
+    HTTPFIELD_EXPECT,
+    HTTPFIELD_FROM,
+    HTTPFIELD_HOST,
+    HTTPFIELD_IF_MODIFIED_SINCE,
+    HTTPFIELD_RANGE,
+    HTTPFIELD_REFERER,
+    HTTPFIELD_TRANSFER_ENCODING,
+    HTTPFIELD_USER_AGENT,
+    HTTPFIELD_OTHER   /* Any other field; must be last */
+} HttpField;
+
+HttpField
+HTTPFieldFromName(const char * const name,
+                  size_t       const nameLen);
+
 const char *
 HTTPMethodName(TMethod const method);
 
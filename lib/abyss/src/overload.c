@@ -0,0 +1,124 @@
+/*=============================================================================
+                                 overload.c
+===============================================================================
+  This is the server overload detector.  See overload.h for the concept.
+
+  We use CoDel's "server queue" form: we watch for a whole interval the
+  least time any connection waited.  At the end of the interval, we are
+  overloaded for the next interval if that minimum exceeded the target.
+
+  While we are overloaded, we shed every connection that waited longer than
+  the target.  While we aren't, we still shed one that waited longer than a
+  whole interval, because by then its client has likely given up or
+  retried, and serving it would only make the connections behind it wait
+  longer.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+
+#include "bool.h"
+#include "int.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/time_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+
+#include "overload.h"
+
+struct overload {
+    struct lock * lockP;
+    uint32_t      targetMs;
+    uint32_t      intervalMs;
+    uint64_t      intervalEndMs;
+        /* When the current interval ends */
+    uint64_t      minWaitMs;
+        /* Least time a connection judged in the current interval waited.
+           Meaningful only if 'sawConn'.
+        */
+    bool          sawConn;
+        /* We have judged a connection in the current interval */
+    bool          overloaded;
+        /* The minimum wait in the last interval exceeded the target */
+};
+
+
+
+void
+OverloadCreate(uint32_t      const targetMs,
+               uint32_t      const intervalMs,
+               TOverload **  const overloadPP,
+               const char ** const errorP) {
+
+    TOverload * overloadP;
+
+    MALLOCVAR(overloadP);
+
+    if (!overloadP)
+        xmlrpc_asprintf(errorP, "Unable to allocate memory for overload "
+                        "detector");
+    else {
+        overloadP->lockP = xmlrpc_lock_create();
+
+        if (!overloadP->lockP) {
+            xmlrpc_asprintf(errorP, "Unable to create lock for overload "
+                            "detector");
+            free(overloadP);
+        } else {
+            overloadP->targetMs      = targetMs;
+            overloadP->intervalMs    = intervalMs;
+            overloadP->intervalEndMs = xmlrpc_monotonic_ms() + intervalMs;
+            overloadP->sawConn       = false;
+            overloadP->overloaded    = false;
+
+            *overloadPP = overloadP;
+            *errorP = NULL;
+        }
+    }
+}
+
+
+
+void
+OverloadDestroy(TOverload * const overloadP) {
+
+    overloadP->lockP->destroy(overloadP->lockP);
+
+    free(overloadP);
+}
+
+
+
+void
+OverloadJudge(TOverload * const overloadP,
+              uint64_t    const queuedSinceMs,
+              bool *      const shedP) {
+/*----------------------------------------------------------------------------
+   A server thread is about to serve a connection that has been waiting for
+   it since 'queuedSinceMs' (as xmlrpc_monotonic_ms() tells time).  Record
+   how long it waited and tell whether the server should refuse it instead.
+-----------------------------------------------------------------------------*/
+    uint64_t const nowMs = xmlrpc_monotonic_ms();
+    uint64_t const waitMs = nowMs > queuedSinceMs ? nowMs - queuedSinceMs : 0;
+
+    overloadP->lockP->acquire(overloadP->lockP);
+
+    if (nowMs >= overloadP->intervalEndMs) {
+        overloadP->overloaded =
+            overloadP->sawConn && overloadP->minWaitMs > overloadP->targetMs;
+
+        overloadP->intervalEndMs = nowMs + overloadP->intervalMs;
+        overloadP->sawConn = false;
+    }
+
+    if (!overloadP->sawConn || waitMs < overloadP->minWaitMs)
+        overloadP->minWaitMs = waitMs;
+    overloadP->sawConn = true;
+
+    *shedP = waitMs > (overloadP->overloaded ?
+                       overloadP->targetMs : overloadP->intervalMs);
+
+    overloadP->lockP->release(overloadP->lockP);
+}
@@ -0,0 +1,36 @@
+#ifndef OVERLOAD_H_INCLUDED
+#define OVERLOAD_H_INCLUDED
+
+/*============================================================================
+   An overload detector for a server, after the CoDel ("controlled delay")
+   queue management algorithm.
+
+   The server tells it how long each connection waited between being
+   accepted and getting a thread to serve it.  A standing queue -- one in
+   which even the connection that waited least in an interval waited longer
+   than the target -- means the server can't keep up, so the detector
+   declares overload and tells the server to refuse connections that waited
+   longer than the target.  A burst that the server works off within an
+   interval doesn't count.
+============================================================================*/
+
+#include "bool.h"
+#include "int.h"
+
+typedef struct overload TOverload;
+
+void
+OverloadCreate(uint32_t      const targetMs,
+               uint32_t      const intervalMs,
+               TOverload **  const overloadPP,
+               const char ** const errorP);
+
+void
+OverloadDestroy(TOverload * const overloadP);
+
+void
+OverloadJudge(TOverload * const overloadP,
+              uint64_t    const queuedSinceMs,
+              bool *      const shedP);
+
+#endif
@@ -0,0 +1,475 @@
+/*=============================================================================
+                                 prefork.c
+===============================================================================
+  This is the set of pre-forked worker processes that serve a server's
+  connections.  See prefork.h for the concept.
+
+  The master and the workers share a scoreboard: an array in shared memory
+  with a slot for each possible worker.  A worker records in its slot
+  whether it is idle (waiting to accept a connection) or busy (serving
+  one).  Every tick, the master replaces workers that have exited, forks a
+  new one if none is idle, and, at most once a second, retires one if more
+  than one is idle.
+
+  The master retires a worker with SIGTERM.  The worker finishes the
+  connection it is serving, if any, then exits.  A worker also exits on
+  its own when it has served its quota of requests, and the master
+  replaces it.
+=============================================================================*/
+
+#define _DEFAULT_SOURCE /* New name for SVID & BSD source defines */
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <errno.h>
+#if !MSVCRT
+  #include <unistd.h>
+  #include <signal.h>
+  #include <sys/types.h>
+  #include <sys/wait.h>
+  #include <sys/mman.h>
+#endif
+#ifdef __linux__
+  #include <sys/prctl.h>
+#endif
+
+#include "bool.h"
+#include "girmath.h"
+#include "xmlrpc-c/util_int.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/sleep_int.h"
+#include "xmlrpc-c/time_int.h"
+#include "xmlrpc-c/abyss.h"
+#include "trace.h"
+#include "chanswitch.h"
+#include "server.h"
+
+#include "prefork.h"
+
+#if !MSVCRT
+
+/* How often, in milliseconds, the master looks at the scoreboard */
+#define TICK_MS 100
+
+/* The least time, in milliseconds, between retiring one idle worker and the
+   next.  This keeps the pool from shrinking just because of a lull of a
+   few ticks.
+*/
+#define RETIRE_INTERVAL_MS 1000
+
+enum slotState {
+    SLOT_EMPTY,
+        /* No worker */
+    SLOT_STARTING,
+        /* Master has forked the worker, but the worker hasn't reported in */
+    SLOT_IDLE,
+        /* Worker is waiting to accept a connection */
+    SLOT_BUSY
+        /* Worker is serving a connection */
+};
+
+struct slot {
+    /* This is in memory the master shares with the workers */
+
+    volatile sig_atomic_t state;
+        /* An enum slotState.  The master sets SLOT_EMPTY and SLOT_STARTING;
+           the worker sets SLOT_IDLE and SLOT_BUSY.
+        */
+    pid_t pid;
+        /* Process ID of the worker.  Meaningful only to the master, and
+           only when 'state' is not SLOT_EMPTY.
+        */
+    bool retiring;
+        /* Master has told the worker to exit.  Meaningful only to the
+           master.
+        */
+};
+
+struct prefork {
+    TServer *         serverP;
+    TChanSwitch *     chanSwitchP;
+    TPreforkServeFn * serve;
+    unsigned int      minWorkers;
+    unsigned int      maxWorkers;
+    unsigned int      maxRequests;
+        /* Number of requests a worker serves before exiting.  Zero means
+           no limit.
+        */
+    struct slot *     slots;
+        /* The scoreboard: array of 'maxWorkers', in shared memory */
+    uint64_t          lastRetireMs;
+        /* When, on the xmlrpc_monotonic_ms() clock, we last retired an idle
+           worker
+        */
+    pid_t             masterPid;
+};
+
+static volatile sig_atomic_t retireRequested;
+    /* In a worker process: the master has asked this worker to exit */
+
+
+
+static void
+retireSignalHandler(int const signalClass ATTR_UNUSED) {
+
+    retireRequested = 1;
+}
+
+
+
+static void
+setupWorkerSignals(pid_t const masterPid) {
+/*----------------------------------------------------------------------------
+   Make SIGTERM ask this worker to exit when it is done with the current
+   connection rather than kill it, and interrupt a wait to accept a
+   connection.  The worker doesn't fork, so it has no use for whatever
+   SIGCHLD handling it inherited from the master.
+
+   Where the system can do it, also have the worker get that SIGTERM when
+   the master dies, so a master killed by a signal doesn't leave workers
+   behind accepting connections on its socket.
+-----------------------------------------------------------------------------*/
+    struct sigaction mysigaction;
+
+    retireRequested = 0;
+
+    sigemptyset(&mysigaction.sa_mask);
+    mysigaction.sa_flags = 0;  /* In particular, no SA_RESTART */
+
+    mysigaction.sa_handler = retireSignalHandler;
+    sigaction(SIGTERM, &mysigaction, NULL);
+
+    mysigaction.sa_handler = SIG_DFL;
+    sigaction(SIGCHLD, &mysigaction, NULL);
+
+#if defined(__linux__) && defined(PR_SET_PDEATHSIG)
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+    if (getppid() != masterPid)
+        /* The master died before we could ask to hear about it */
+        retireRequested = 1;
+}
+
+
+
+static void
+runWorker(struct prefork * const pfP,
+          struct slot *    const slotP) {
+/*----------------------------------------------------------------------------
+   Be a worker: accept and serve connections until the master tells us to
+   stop or we have served our quota of requests.  Then exit the process.
+-----------------------------------------------------------------------------*/
+    unsigned int requestsLeft;
+    bool done;
+
+    setupWorkerSignals(pfP->masterPid);
+
+    requestsLeft = pfP->maxRequests;
+
+    for (done = false; !done; ) {
+        slotP->state = SLOT_IDLE;
+
+        if (retireRequested)
+            done = true;
+        else {
+            TChannel * channelP;
+            void * channelInfoP;
+            const char * error;
+
+            ChanSwitchAccept(pfP->chanSwitchP, &channelP, &channelInfoP,
+                             &error);
+
+            if (error) {
+                TraceMsg("Prefork worker %d failed to accept a "
+                         "connection.  %s", (int)getpid(), error);
+                xmlrpc_strfree(error);
+                done = true;
+            } else if (!channelP) {
+                /* Interrupted: by our retire signal, or because the
+                   server is terminating.
+                */
+                done = true;
+            } else {
+                unsigned int const maxRequests =
+                    pfP->maxRequests > 0 ? requestsLeft : UINT_MAX;
+
+                unsigned int requestCt;
+
+                slotP->state = SLOT_BUSY;
+
+                pfP->serve(pfP->serverP, channelP, channelInfoP,
+                           maxRequests, &requestCt);
+
+                if (pfP->maxRequests > 0) {
+                    requestsLeft -= MIN(requestCt, requestsLeft);
+
+                    if (requestsLeft == 0)
+                        done = true;
+                }
+            }
+        }
+    }
+    exit(0);
+}
+
+
+
+static void
+startWorker(struct prefork * const pfP,
+            struct slot *    const slotP,
+            const char **    const errorP) {
+
+    pid_t rc;
+
+    slotP->state    = SLOT_STARTING;
+    slotP->retiring = false;
+
+    rc = fork();
+
+    if (rc < 0) {
+        xmlrpc_asprintf(errorP, "fork() failed, errno=%d (%s)",
+                        errno, strerror(errno));
+        slotP->state = SLOT_EMPTY;
+    } else if (rc == 0) {
+        /* This is the child */
+        runWorker(pfP, slotP);
+    } else {
+        /* This is the parent */
+        slotP->pid = rc;
+        *errorP = NULL;
+    }
+}
+
+
+
+static bool
+workerIsGone(pid_t const pid) {
+/*----------------------------------------------------------------------------
+   Worker process 'pid' has exited.  We reap it if nobody else has.
+
+   The user may have a SIGCHLD handler that reaps children (e.g. the one
+   xmlrpc_server_abyss_run_server() installs), in which case waitpid()
+   says it is not our child at all.
+-----------------------------------------------------------------------------*/
+    int status;
+    pid_t rc;
+
+    rc = waitpid(pid, &status, WNOHANG);
+
+    return rc == pid || (rc < 0 && errno == ECHILD);
+}
+
+
+
+static void
+reapWorkers(struct prefork * const pfP) {
+
+    unsigned int i;
+
+    for (i = 0; i < pfP->maxWorkers; ++i) {
+        struct slot * const slotP = &pfP->slots[i];
+
+        if (slotP->state != SLOT_EMPTY && workerIsGone(slotP->pid))
+            slotP->state = SLOT_EMPTY;
+    }
+}
+
+
+
+static struct slot *
+emptySlot(struct prefork * const pfP) {
+
+    unsigned int i;
+
+    for (i = 0; i < pfP->maxWorkers; ++i) {
+        if (pfP->slots[i].state == SLOT_EMPTY)
+            return &pfP->slots[i];
+    }
+    return NULL;
+}
+
+
+
+static void
+adjustWorkers(struct prefork * const pfP,
+              const char **    const errorP) {
+/*----------------------------------------------------------------------------
+   Start or retire workers according to how many there are and how many of
+   those are idle.
+-----------------------------------------------------------------------------*/
+    unsigned int activeCt;
+        /* Workers we haven't told to exit */
+    unsigned int idleCt;
+    struct slot * idleSlotP;
+        /* One of the idle workers */
+    unsigned int i;
+
+    for (i = 0, activeCt = 0, idleCt = 0, idleSlotP = NULL;
+         i < pfP->maxWorkers;
+         ++i) {
+        struct slot * const slotP = &pfP->slots[i];
+
+        if (slotP->state != SLOT_EMPTY && !slotP->retiring) {
+            ++activeCt;
+
+            if (slotP->state == SLOT_IDLE || slotP->state == SLOT_STARTING) {
+                ++idleCt;
+                if (slotP->state == SLOT_IDLE)
+                    idleSlotP = slotP;
+            }
+        }
+    }
+    *errorP = NULL;  /* initial value */
+
+    if (activeCt < pfP->minWorkers || (idleCt == 0 && activeCt <
+                                       pfP->maxWorkers)) {
+        unsigned int const startCt =
+            MAX(pfP->minWorkers, activeCt + 1) - activeCt;
+
+        for (i = 0; i < startCt && !*errorP; ++i) {
+            struct slot * const slotP = emptySlot(pfP);
+
+            /* There can be no empty slot while retiring workers are still
+               running.  We'll start it on a later tick.
+            */
+            if (slotP)
+                startWorker(pfP, slotP, errorP);
+        }
+    } else if (idleCt > 1 && activeCt > pfP->minWorkers && idleSlotP) {
+        uint64_t const nowMs = xmlrpc_monotonic_ms();
+
+        if (nowMs - pfP->lastRetireMs >= RETIRE_INTERVAL_MS) {
+            kill(idleSlotP->pid, SIGTERM);
+            idleSlotP->retiring = true;
+            pfP->lastRetireMs = nowMs;
+        }
+    }
+}
+
+
+
+static void
+stopWorkers(struct prefork * const pfP) {
+/*----------------------------------------------------------------------------
+   Tell all the workers to exit and wait for them to do so.
+
+   A worker waiting to accept a connection exits right away; one serving a
+   connection finishes it first.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+    bool allGone;
+
+    for (i = 0; i < pfP->maxWorkers; ++i) {
+        struct slot * const slotP = &pfP->slots[i];
+
+        if (slotP->state != SLOT_EMPTY)
+            kill(slotP->pid, SIGTERM);
+    }
+    for (allGone = false; !allGone; ) {
+        reapWorkers(pfP);
+
+        for (i = 0, allGone = true; i < pfP->maxWorkers; ++i) {
+            if (pfP->slots[i].state != SLOT_EMPTY)
+                allGone = false;
+        }
+        if (!allGone)
+            xmlrpc_millisecond_sleep(TICK_MS);
+    }
+}
+
+
+
+bool
+PreforkIsAvailable(void) {
+
+    return true;
+}
+
+
+
+void
+PreforkRun(TServer *         const serverP,
+           TChanSwitch *     const chanSwitchP,
+           TPreforkServeFn * const serve,
+           const char **     const errorP) {
+/*----------------------------------------------------------------------------
+   Serve connections from channel switch *chanSwitchP with worker
+   processes until the server is told to terminate, then wait for the
+   workers to finish.
+
+   'serve' is what a worker does with each connection it accepts.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = serverP->srvP;
+
+    struct prefork prefork;
+    void * mapped;
+
+    prefork.serverP        = serverP;
+    prefork.chanSwitchP    = chanSwitchP;
+    prefork.serve          = serve;
+    prefork.minWorkers     = srvP->preforkMinWorkers;
+    prefork.maxWorkers     = srvP->preforkMaxWorkers;
+    prefork.maxRequests    = srvP->preforkMaxRequests;
+    prefork.lastRetireMs   = 0;
+    prefork.masterPid      = getpid();
+
+    assert(prefork.maxWorkers > 0);
+    assert(prefork.minWorkers <= prefork.maxWorkers);
+
+    mapped = mmap(NULL, prefork.maxWorkers * sizeof(prefork.slots[0]),
+                  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (mapped == MAP_FAILED)
+        xmlrpc_asprintf(errorP, "Failed to map shared memory for the "
+                        "scoreboard of %u workers.  errno=%d (%s)",
+                        prefork.maxWorkers, errno, strerror(errno));
+    else {
+        unsigned int i;
+
+        prefork.slots = mapped;
+
+        for (i = 0; i < prefork.maxWorkers; ++i)
+            prefork.slots[i].state = SLOT_EMPTY;
+
+        *errorP = NULL;
+
+        while (!srvP->terminationRequested && !*errorP) {
+            reapWorkers(&prefork);
+
+            adjustWorkers(&prefork, errorP);
+
+            if (!*errorP)
+                xmlrpc_millisecond_sleep(TICK_MS);
+        }
+        stopWorkers(&prefork);
+
+        munmap(mapped, prefork.maxWorkers * sizeof(prefork.slots[0]));
+    }
+}
+
+
+
+#else  /* MSVCRT */
+
+bool
+PreforkIsAvailable(void) {
+
+    return false;
+}
+
+
+
+void
+PreforkRun(TServer *         const serverP ATTR_UNUSED,
+           TChanSwitch *     const chanSwitchP ATTR_UNUSED,
+           TPreforkServeFn * const serve ATTR_UNUSED,
+           const char **     const errorP) {
+
+    xmlrpc_asprintf(errorP, "Worker processes are not possible on Windows");
+}
+
+#endif  /* MSVCRT */
@@ -0,0 +1,34 @@
+#ifndef PREFORK_H_INCLUDED
+#define PREFORK_H_INCLUDED
+
+/*============================================================================
+   A set of long-lived worker processes that serve server connections.
+
+   The server process (the master) forks the workers ahead of time.  Each
+   worker accepts connections on the listening socket it inherits from the
+   master and serves them one at a time, so a worker that crashes takes
+   down only the connection it was serving.  The master does not serve
+   connections; it only keeps the number of workers between a minimum and
+   a maximum according to how many are idle, and replaces workers that
+   exit.
+============================================================================*/
+
+#include "bool.h"
+#include "xmlrpc-c/abyss.h"
+
+typedef void TPreforkServeFn(TServer *      const serverP,
+                             TChannel *     const channelP,
+                             void *         const channelInfoP,
+                             unsigned int   const maxRequests,
+                             unsigned int * const requestCtP);
+
+bool
+PreforkIsAvailable(void);
+
+void
+PreforkRun(TServer *         const serverP,
+           TChanSwitch *     const chanSwitchP,
+           TPreforkServeFn * const serve,
+           const char **     const errorP);
+
+#endif
@@ -0,0 +1,1202 @@
+/*=============================================================================
+                                 reactor.c
+===============================================================================
+  This is the event-driven owner of idle server connections.  See
+  reactor.h for the concept.
+
+  The reactor is an epoll instance that all the worker threads wait on.
+  Every idle connection is in it, armed for one event (EPOLLONESHOT), so
+  when a client sends something, exactly one worker wakes up for it.  That
+  worker reads what has arrived into the connection buffer.  If that
+  completes a request header, the worker processes the request (and any
+  others that are complete in the buffer), then rearms the connection.  If
+  not, it just rearms the connection and goes back to waiting.  So a worker
+  is tied up with a connection only while there is a request to process.
+
+  Connections that stay idle too long expire.  A worker that finds an
+  expired connection (while periodically looking after waking up) rearms it
+  so that it is ready immediately, and whichever worker gets that event
+  closes the connection.  This way, only a worker that has taken the
+  connection out of the reactor ever touches it.
+
+  An event refers to a connection by file descriptor and a generation
+  number, not a pointer, so that an event that is still in flight when a
+  connection gets closed can be recognized as stale and ignored.
+
+  When the request processor parks a connection, the worker simply leaves
+  it busy and goes back to waiting.  The thread that later resumes the
+  connection does what the worker would have done after the request.  If
+  more requests are already in the buffer, it arms the connection to be
+  ready immediately, so that a worker processes them.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#if HAVE_SYS_EPOLL_H
+  #include <unistd.h>
+  #include <sys/epoll.h>
+#endif
+
+#include "bool.h"
+#include "int.h"
+#include "girmath.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/util_int.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/time_int.h"
+#include "xmlrpc-c/thread_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/abyss.h"
+#include "trace.h"
+#include "thread.h"
+#include "channel.h"
+#include "conn.h"
+#include "server.h"
+
+#include "reactor.h"
+
+
+#if HAVE_SYS_EPOLL_H
+
+/* The most connections the reactor holds for each worker thread.  When it
+   has this many, the server waits to accept more until some go away.
+*/
+#define CONNS_PER_WORKER 64
+
+/* How often, in seconds, we look for connections that have been idle
+   too long.
+*/
+#define SCAN_INTERVAL 1
+
+#define WAKE_KEY (~(uint64_t)0)
+    /* The epoll key of the reactor's wakeup pipe */
+
+struct reactorConn {
+    TReactor * reactorP;
+    TConn * connectionP;
+    int fd;
+        /* The file descriptor we watch for the connection's channel */
+    uint32_t generation;
+        /* Distinguishes this connection from earlier ones that had the
+           same file descriptor.
+        */
+    unsigned int requestCount;
+        /* Number of requests we've handled so far on this connection */
+    uint64_t deadlineMs;
+        /* When, on the xmlrpc_monotonic_ms() clock, we give up on the
+           client sending the (rest of the) next request.
+        */
+    bool busy;
+        /* A worker has the connection, so it is not armed in the epoll
+           instance and not subject to the deadline.
+        */
+    bool expired;
+        /* The connection is past its deadline.  The worker that next gets
+           it closes it.
+        */
+};
+
+struct capacityWaiter {
+/*----------------------------------------------------------------------------
+   A thread waiting for room in the reactor for another connection
+-----------------------------------------------------------------------------*/
+    struct xmlrpc_event * roomP;
+        /* Set when a connection has left the reactor */
+    struct capacityWaiter * nextP;
+};
+
+struct reactor {
+    TServer * serverP;
+    TReactorProcessFn * processRequest;
+    int epollFd;
+    int wakePipe[2];
+        /* Writing to wakePipe[1] makes wakePipe[0] readable, which makes
+           every worker wake up and exit.
+        */
+    unsigned int workerCt;
+    TThread ** workers;
+        /* The worker threads; array of 'workerCt' */
+
+    struct lock * lockP;
+        /* Protects all the members below */
+    struct reactorConn ** connByFd;
+        /* connByFd[fd] is the connection whose channel has file descriptor
+           'fd'; NULL if none.  Array of 'connTableSize'.
+        */
+    unsigned int connTableSize;
+    unsigned int connCt;
+        /* Number of connections in the reactor, busy or not */
+    struct capacityWaiter * capacityWaiterP;
+        /* The threads waiting for 'connCt' to drop below the maximum, in
+           ReactorWaitForCapacity().  closeConn() wakes the first one.
+        */
+    int parkedCt;
+        /* Number of parked connections.  It can be briefly negative,
+           because a connection can be resumed just before the worker that
+           parked it counts it.
+        */
+    struct xmlrpc_event * unparkedP;
+        /* Set when 'parkedCt' drops to zero after 'workersGone', for
+           ReactorDestroy() to wait for.
+        */
+    bool workersGone;
+        /* The worker threads have exited, so nothing parks a connection
+           any more.
+        */
+    uint32_t nextGeneration;
+    uint64_t lastScanMs;
+        /* When, on the xmlrpc_monotonic_ms() clock, we last looked for idle
+           connections past their deadlines
+        */
+    bool terminating;
+        /* The reactor is shutting down.  Workers must not rearm any
+           connection.
+        */
+};
+
+
+
+static uint64_t
+eventKey(const struct reactorConn * const rconnP) {
+
+    return ((uint64_t)rconnP->generation << 32) | (uint32_t)rconnP->fd;
+}
+
+
+
+static void
+armConn(TReactor *           const reactorP,
+        struct reactorConn * const rconnP,
+        int                  const op,
+        bool                 const readyNow,
+        const char **        const errorP) {
+/*----------------------------------------------------------------------------
+   Arm the epoll instance for one event for connection *rconnP.
+
+   'readyNow' means arm it so the event happens immediately (because the
+   connection has expired).
+-----------------------------------------------------------------------------*/
+    struct epoll_event event;
+    int rc;
+
+    event.events   = EPOLLIN | EPOLLONESHOT | (readyNow ? EPOLLOUT : 0);
+    event.data.u64 = eventKey(rconnP);
+
+    rc = epoll_ctl(reactorP->epollFd, op, rconnP->fd, &event);
+
+    if (rc != 0)
+        xmlrpc_asprintf(errorP, "epoll_ctl() of file descriptor %d failed.  "
+                        "errno=%d (%s)",
+                        rconnP->fd, errno, strerror(errno));
+    else
+        *errorP = NULL;
+}
+
+
+
+static void
+unpark(TReactor * const reactorP) {
+/*----------------------------------------------------------------------------
+   Count a parked connection as resumed.  Caller holds the lock.
+-----------------------------------------------------------------------------*/
+    --reactorP->parkedCt;
+
+    if (reactorP->parkedCt == 0 && reactorP->workersGone)
+        xmlrpc_event_set(reactorP->unparkedP);
+}
+
+
+
+static void
+closeConn(TReactor *           const reactorP,
+          struct reactorConn * const rconnP,
+          bool                 const wasParked) {
+/*----------------------------------------------------------------------------
+   Take connection *rconnP out of the reactor and destroy it.
+
+   Caller must have the connection (i.e. it is busy or expired) and must
+   not hold the reactor lock.
+
+   'wasParked' means Caller has the connection by resuming it, so it no
+   longer counts as parked once we have destroyed it.
+-----------------------------------------------------------------------------*/
+    TConn * const connectionP = rconnP->connectionP;
+
+    reactorP->lockP->acquire(reactorP->lockP);
+
+    epoll_ctl(reactorP->epollFd, EPOLL_CTL_DEL, rconnP->fd, NULL);
+
+    assert(reactorP->connByFd[rconnP->fd] == rconnP);
+    reactorP->connByFd[rconnP->fd] = NULL;
+    --reactorP->connCt;
+
+    if (reactorP->capacityWaiterP) {
+        struct capacityWaiter * const waiterP = reactorP->capacityWaiterP;
+
+        reactorP->capacityWaiterP = waiterP->nextP;
+
+        xmlrpc_event_set(waiterP->roomP);
+    }
+
+    reactorP->lockP->release(reactorP->lockP);
+
+    /* Now that no event can lead to the connection, nobody else can get
+       it.  Note that the file descriptor number can't be reused until
+       ChannelDestroy() closes it.
+    */
+    ChannelDestroy(connectionP->channelP);
+    free(connectionP->channelInfoP);
+    ConnWaitAndRelease(connectionP);
+    free(rconnP);
+
+    if (wasParked) {
+        /* Only now may ReactorDestroy() go on, so this is the last we
+           touch the reactor.
+        */
+        reactorP->lockP->acquire(reactorP->lockP);
+        unpark(reactorP);
+        reactorP->lockP->release(reactorP->lockP);
+    }
+}
+
+
+
+static bool
+containsHttpVersion(const char * const line,
+                    size_t       const lineLen) {
+
+    size_t i;
+    bool found;
+
+    for (i = 0, found = false; i + 5 <= lineLen && !found; ++i)
+        found = (strncmp(&line[i], "HTTP/", 5) == 0);
+
+    return found;
+}
+
+
+
+static bool
+requestHeaderIsComplete(TConn * const connectionP) {
+/*----------------------------------------------------------------------------
+   The connection buffer contains a complete HTTP request header, or at
+   least as much as it ever will (because it is full).
+
+   Being a complete header means it is a single-line (HTTP 0.9) request or
+   it contains the empty line that ends a header.  Like SessionReadRequest(),
+   we ignore empty lines before the request line and take any of CRLF or LF
+   as the end of a line.
+-----------------------------------------------------------------------------*/
+    const char * const end = &connectionP->buffer.t[connectionP->buffersize];
+
+    const char * p;
+    const char * lineStart;
+    bool complete;
+    bool firstLine;
+
+    if (ConnBufferSpace(connectionP) == 0)
+        return true;
+
+    for (p = &connectionP->buffer.t[connectionP->bufferpos];
+         p < end && (*p == '\r' || *p == '\n');
+         ++p);
+
+    for (lineStart = p, firstLine = true, complete = false;
+         p < end && !complete;
+         ++p) {
+        if (*p == '\n') {
+            const char * const nextLine = p + 1;
+
+            if (firstLine) {
+                if (!containsHttpVersion(lineStart, p - lineStart))
+                    complete = true;  /* Single-line request */
+                firstLine = false;
+            } else if (p - lineStart == 0 ||
+                       (p - lineStart == 1 && *lineStart == '\r'))
+                complete = true;  /* Empty line: end of header */
+
+            lineStart = nextLine;
+        }
+    }
+    return complete;
+}
+
+
+
+static void
+returnConn(TReactor *           const reactorP,
+           struct reactorConn * const rconnP,
+           bool                 const readyNow,
+           bool                 const wasParked) {
+/*----------------------------------------------------------------------------
+   Give connection *rconnP, which Caller has, back to the reactor to wait
+   for more from the client.  Or close it if the reactor is shutting down.
+
+   'readyNow' means there are requests in the buffer already, so a worker
+   should take the connection again right away.
+
+   'wasParked' is as for closeConn().  We stop counting the connection as
+   parked in the same critical section in which we give it back, so that
+   once ReactorDestroy() sees no parked connections, no resumer is still
+   working on one.
+-----------------------------------------------------------------------------*/
+    bool mustClose;
+
+    reactorP->lockP->acquire(reactorP->lockP);
+
+    if (reactorP->terminating)
+        mustClose = true;
+    else {
+        const char * error;
+
+        rconnP->busy    = false;
+        rconnP->expired = false;
+
+        armConn(reactorP, rconnP, EPOLL_CTL_MOD, readyNow, &error);
+
+        if (error) {
+            TraceMsg("Unable to return connection to reactor.  %s", error);
+            xmlrpc_strfree(error);
+            rconnP->busy = true;
+            mustClose = true;
+        } else {
+            mustClose = false;
+
+            if (wasParked)
+                unpark(reactorP);
+        }
+    }
+    reactorP->lockP->release(reactorP->lockP);
+
+    if (mustClose)
+        closeConn(reactorP, rconnP, wasParked);
+}
+
+
+
+static uint64_t
+deadlineAfter(uint32_t const seconds) {
+/*----------------------------------------------------------------------------
+   The time on the xmlrpc_monotonic_ms() clock 'seconds' seconds from now.
+-----------------------------------------------------------------------------*/
+    return xmlrpc_monotonic_ms() + (uint64_t)seconds * 1000;
+}
+
+
+
+static void
+setDeadline(struct reactorConn * const rconnP,
+            bool                 const requestStarted) {
+/*----------------------------------------------------------------------------
+   Set the time by which the client must send the (rest of the) next
+   request on connection *rconnP.
+
+   'requestStarted' means the client has begun sending a new request since
+   we last set it.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = rconnP->reactorP->serverP->srvP;
+    TConn * const connectionP = rconnP->connectionP;
+
+    if (connectionP->bufferpos >= connectionP->buffersize)
+        rconnP->deadlineMs = deadlineAfter(srvP->keepalivetimeout);
+    else if (requestStarted)
+        rconnP->deadlineMs = deadlineAfter(srvP->timeout);
+}
+
+
+
+static void
+serviceConn(TReactor *           const reactorP,
+            struct reactorConn * const rconnP) {
+/*----------------------------------------------------------------------------
+   Read what the client has sent on connection *rconnP, which Caller has
+   taken from the reactor and which is supposedly readable, and process
+   any requests that are now complete.
+
+   If processing a request parks the connection, leave it as it is; it
+   is no longer ours.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = reactorP->serverP->srvP;
+    TConn * const connectionP = rconnP->connectionP;
+    bool const wasEmpty = connectionP->bufferpos >= connectionP->buffersize;
+
+    bool eof, timedOut;
+    const char * readError;
+    bool connectionDone;
+    bool parked;
+
+    parked = false;
+
+    if (ConnBufferSpace(connectionP) == 0) {
+        /* We were resumed with the buffer full of requests */
+        eof       = false;
+        timedOut  = true;
+        readError = NULL;
+    } else
+        ConnRead(connectionP, 0, &eof, &timedOut, &readError);
+
+    if (readError) {
+        TraceMsg("Failed to read from Abyss connection.  %s", readError);
+        xmlrpc_strfree(readError);
+        connectionDone = true;
+    } else if (eof)
+        connectionDone = true;
+    else {
+        /* If 'timedOut', the event was stale and there was nothing to read,
+           but there may be a request in the buffer nonetheless.
+        */
+        bool processedRequest;
+
+        for (connectionDone = false, processedRequest = false;
+             !connectionDone && !parked &&
+                 requestHeaderIsComplete(connectionP);) {
+
+            bool const lastReqOnConn =
+                rconnP->requestCount + 1 >= srvP->keepalivemaxconn;
+
+            bool keepalive;
+
+            reactorP->processRequest(connectionP, rconnP, lastReqOnConn,
+                                     &keepalive, &parked);
+
+            if (!parked) {
+                ++rconnP->requestCount;
+                processedRequest = true;
+
+                if (!keepalive || srvP->terminationRequested)
+                    connectionDone = true;
+
+                ConnReadInit(connectionP);
+            }
+        }
+        if (!parked) {
+            /* Send any responses we held back because more requests were
+               in the buffer; we're about to wait for the client.
+            */
+            ConnFlush(connectionP);
+
+            if (!connectionDone)
+                setDeadline(rconnP, wasEmpty || processedRequest);
+        }
+    }
+    if (parked) {
+        reactorP->lockP->acquire(reactorP->lockP);
+        ++reactorP->parkedCt;
+        reactorP->lockP->release(reactorP->lockP);
+    } else if (connectionDone)
+        closeConn(reactorP, rconnP, false);
+    else
+        returnConn(reactorP, rconnP, false, false);
+}
+
+
+
+void
+ReactorResumeConn(TReactorConn * const rconnP,
+                  bool           const keepalive) {
+/*----------------------------------------------------------------------------
+   Take back parked connection *rconnP, whose request is now finished.
+   'keepalive' means the connection may carry more requests.
+
+   Caller may be any thread.  Once we have given the connection back (or
+   closed it), we don't touch the reactor, which may be gone by then.
+-----------------------------------------------------------------------------*/
+    TReactor * const reactorP = rconnP->reactorP;
+    struct _TServer * const srvP = reactorP->serverP->srvP;
+    TConn * const connectionP = rconnP->connectionP;
+
+    ++rconnP->requestCount;
+
+    ConnReadInit(connectionP);
+
+    if (!keepalive || srvP->terminationRequested) {
+        ConnFlush(connectionP);
+        closeConn(reactorP, rconnP, true);
+    } else if (requestHeaderIsComplete(connectionP)) {
+        /* The client pipelined; let a worker process what it sent.  That
+           sends any response we're holding.
+        */
+        setDeadline(rconnP, true);
+        returnConn(reactorP, rconnP, true, true);
+    } else {
+        ConnFlush(connectionP);
+        setDeadline(rconnP, true);
+        returnConn(reactorP, rconnP, false, true);
+    }
+}
+
+
+
+static void
+handleEvent(TReactor * const reactorP,
+            uint64_t   const key) {
+
+    int      const fd         = (int)(key & 0xffffffff);
+    uint32_t const generation = (uint32_t)(key >> 32);
+
+    struct reactorConn * rconnP;
+
+    reactorP->lockP->acquire(reactorP->lockP);
+
+    if ((unsigned int)fd < reactorP->connTableSize &&
+        reactorP->connByFd[fd] &&
+        reactorP->connByFd[fd]->generation == generation &&
+        !reactorP->connByFd[fd]->busy) {
+
+        rconnP = reactorP->connByFd[fd];
+        rconnP->busy = true;
+    } else {
+        /* Event is for a connection that is gone or that some other worker
+           has.
+        */
+        rconnP = NULL;
+    }
+    reactorP->lockP->release(reactorP->lockP);
+
+    if (rconnP) {
+        if (rconnP->expired)
+            closeConn(reactorP, rconnP, false);
+        else
+            serviceConn(reactorP, rconnP);
+    }
+}
+
+
+
+static void
+expireIdleConns(TReactor * const reactorP) {
+/*----------------------------------------------------------------------------
+   Arrange for connections that have waited past their deadlines to be
+   closed, if it's time to look for them.
+-----------------------------------------------------------------------------*/
+    uint64_t const nowMs = xmlrpc_monotonic_ms();
+
+    reactorP->lockP->acquire(reactorP->lockP);
+
+    if (nowMs - reactorP->lastScanMs >= SCAN_INTERVAL * 1000) {
+        unsigned int fd;
+
+        reactorP->lastScanMs = nowMs;
+
+        for (fd = 0; fd < reactorP->connTableSize; ++fd) {
+            struct reactorConn * const rconnP = reactorP->connByFd[fd];
+
+            if (rconnP && !rconnP->busy && !rconnP->expired &&
+                nowMs >= rconnP->deadlineMs) {
+
+                const char * error;
+
+                rconnP->expired = true;
+
+                armConn(reactorP, rconnP, EPOLL_CTL_MOD, true, &error);
+
+                if (error) {
+                    TraceMsg("Unable to expire idle connection.  %s", error);
+                    xmlrpc_strfree(error);
+                }
+            }
+        }
+    }
+    reactorP->lockP->release(reactorP->lockP);
+}
+
+
+
+static TThreadProc workerFunc;
+
+static void
+workerFunc(void * const userHandle) {
+
+    TReactor * const reactorP = userHandle;
+
+    bool done;
+
+    for (done = false; !done; ) {
+        struct epoll_event event;
+        int rc;
+
+        rc = epoll_wait(reactorP->epollFd, &event, 1, SCAN_INTERVAL * 1000);
+
+        if (rc < 0) {
+            if (errno != EINTR) {
+                TraceMsg("epoll_wait() failed.  errno=%d (%s).  "
+                         "Reactor worker thread exiting",
+                         errno, strerror(errno));
+                done = true;
+            }
+        } else if (rc > 0) {
+            if (event.data.u64 == WAKE_KEY)
+                done = true;
+            else
+                handleEvent(reactorP, event.data.u64);
+        }
+        if (!done)
+            expireIdleConns(reactorP);
+    }
+}
+
+
+
+static TThreadDoneFn workerDone;
+
+static void
+workerDone(void * const userHandle ATTR_UNUSED) {
+
+}
+
+
+
+static void
+wakeWorkers(TReactor * const reactorP) {
+/*----------------------------------------------------------------------------
+   Make every worker thread exit as soon as it is done with whatever it
+   is doing now.
+
+   The wakeup pipe is level-triggered in the epoll instance and we never
+   read it, so every worker sees it.
+-----------------------------------------------------------------------------*/
+    ssize_t rc;
+
+    rc = write(reactorP->wakePipe[1], "x", 1);
+
+    if (rc != 1)
+        TraceMsg("Failed to write to reactor wakeup pipe.  errno=%d (%s)",
+                 errno, strerror(errno));
+}
+
+
+
+static void
+destroyWorkers(TReactor *   const reactorP,
+               unsigned int const workerCt) {
+
+    unsigned int i;
+
+    wakeWorkers(reactorP);
+
+    for (i = 0; i < workerCt; ++i)
+        ThreadWaitAndRelease(reactorP->workers[i]);
+
+    free(reactorP->workers);
+}
+
+
+
+static void
+createWorkers(TReactor *    const reactorP,
+              unsigned int  const workerCt,
+              size_t        const workerStackSize,
+              const char ** const errorP) {
+
+    MALLOCARRAY(reactorP->workers, workerCt);
+
+    if (reactorP->workers == NULL)
+        xmlrpc_asprintf(errorP, "Could not allocate memory for %u "
+                        "worker thread descriptors", workerCt);
+    else {
+        unsigned int i;
+
+        for (i = 0, *errorP = NULL; i < workerCt && !*errorP; ++i) {
+            const char * error;
+
+            ThreadCreate(&reactorP->workers[i], reactorP,
+                         &workerFunc, &workerDone, false,
+                         workerStackSize, &error);
+
+            if (error) {
+                xmlrpc_asprintf(errorP, "Failed to create worker thread "
+                                "%u.  %s", i, error);
+                xmlrpc_strfree(error);
+
+                destroyWorkers(reactorP, i);
+            } else
+                ThreadRun(reactorP->workers[i]);
+        }
+        reactorP->workerCt = workerCt;
+    }
+}
+
+
+
+static void
+createEpoll(TReactor *    const reactorP,
+            const char ** const errorP) {
+
+    reactorP->epollFd = epoll_create(64);
+
+    if (reactorP->epollFd < 0)
+        xmlrpc_asprintf(errorP, "epoll_create() failed.  errno=%d (%s)",
+                        errno, strerror(errno));
+    else {
+        int rc;
+
+        rc = pipe(reactorP->wakePipe);
+
+        if (rc != 0)
+            xmlrpc_asprintf(errorP, "Failed to create wakeup pipe.  "
+                            "errno=%d (%s)", errno, strerror(errno));
+        else {
+            struct epoll_event event;
+
+            event.events   = EPOLLIN;
+            event.data.u64 = WAKE_KEY;
+
+            rc = epoll_ctl(reactorP->epollFd, EPOLL_CTL_ADD,
+                           reactorP->wakePipe[0], &event);
+
+            if (rc != 0)
+                xmlrpc_asprintf(errorP, "Failed to add wakeup pipe to "
+                                "epoll instance.  errno=%d (%s)",
+                                errno, strerror(errno));
+            else
+                *errorP = NULL;
+
+            if (*errorP) {
+                close(reactorP->wakePipe[0]);
+                close(reactorP->wakePipe[1]);
+            }
+        }
+        if (*errorP)
+            close(reactorP->epollFd);
+    }
+}
+
+
+
+bool
+ReactorIsAvailable(void) {
+/*----------------------------------------------------------------------------
+   An event-driven server is possible.
+
+   That requires, besides epoll, that Abyss threads be real threads that
+   share our memory, not processes.
+-----------------------------------------------------------------------------*/
+    return !ThreadForks();
+}
+
+
+
+void
+ReactorCreate(TServer *           const serverP,
+              TReactorProcessFn * const processRequest,
+              unsigned int        const workerCt,
+              size_t              const workerStackSize,
+              TReactor **         const reactorPP,
+              const char **       const errorP) {
+/*----------------------------------------------------------------------------
+   Create a reactor for server *serverP, with 'workerCt' threads, which
+   process requests by calling 'processRequest'.
+-----------------------------------------------------------------------------*/
+    TReactor * reactorP;
+
+    assert(ReactorIsAvailable());
+    assert(workerCt > 0);
+
+    MALLOCVAR(reactorP);
+
+    if (reactorP == NULL)
+        xmlrpc_asprintf(errorP, "Could not allocate memory for reactor");
+    else {
+        reactorP->serverP        = serverP;
+        reactorP->processRequest = processRequest;
+        reactorP->connByFd       = NULL;
+        reactorP->connTableSize  = 0;
+        reactorP->connCt         = 0;
+        reactorP->capacityWaiterP = NULL;
+        reactorP->parkedCt       = 0;
+        reactorP->workersGone    = false;
+        reactorP->nextGeneration = 0;
+        reactorP->lastScanMs     = xmlrpc_monotonic_ms();
+        reactorP->terminating    = false;
+
+        reactorP->lockP = xmlrpc_lock_create();
+
+        if (reactorP->lockP == NULL)
+            xmlrpc_asprintf(errorP, "Could not create lock");
+        else {
+            const char * error;
+
+            xmlrpc_event_create(&reactorP->unparkedP, &error);
+
+            if (error) {
+                xmlrpc_asprintf(errorP, "Could not create event.  %s", error);
+                xmlrpc_strfree(error);
+            } else {
+                createEpoll(reactorP, errorP);
+
+                if (!*errorP) {
+                    createWorkers(reactorP, workerCt, workerStackSize,
+                                  errorP);
+
+                    if (*errorP) {
+                        close(reactorP->wakePipe[0]);
+                        close(reactorP->wakePipe[1]);
+                        close(reactorP->epollFd);
+                    }
+                }
+                if (*errorP)
+                    xmlrpc_event_destroy(reactorP->unparkedP);
+            }
+            if (*errorP)
+                reactorP->lockP->destroy(reactorP->lockP);
+        }
+        if (*errorP)
+            free(reactorP);
+    }
+    *reactorPP = reactorP;
+}
+
+
+
+static void
+waitForNoParkedConns(TReactor * const reactorP) {
+/*----------------------------------------------------------------------------
+   Wait for every parked connection to be resumed.  The workers must be
+   gone, so that no more get parked.
+-----------------------------------------------------------------------------*/
+    bool someParked;
+
+    reactorP->lockP->acquire(reactorP->lockP);
+
+    reactorP->workersGone = true;
+    someParked = reactorP->parkedCt > 0;
+
+    reactorP->lockP->release(reactorP->lockP);
+
+    if (someParked) {
+        xmlrpc_event_wait(reactorP->unparkedP);
+
+        /* unpark() sets the event with the lock held, so once we have the
+           lock, the resumer is done with the event and the reactor.
+        */
+        reactorP->lockP->acquire(reactorP->lockP);
+        assert(reactorP->parkedCt == 0);
+        reactorP->lockP->release(reactorP->lockP);
+    }
+}
+
+
+
+void
+ReactorDestroy(TReactor * const reactorP) {
+/*----------------------------------------------------------------------------
+   Shut down the reactor: close all its connections and end its threads.
+
+   Workers that are processing requests finish them first, but we interrupt
+   any waiting they do on their channels, so that is quick.  We also wait
+   for every parked connection to be resumed, which takes as long as the
+   requests on them do.
+-----------------------------------------------------------------------------*/
+    unsigned int fd;
+
+    reactorP->lockP->acquire(reactorP->lockP);
+
+    reactorP->terminating = true;
+
+    for (fd = 0; fd < reactorP->connTableSize; ++fd) {
+        struct reactorConn * const rconnP = reactorP->connByFd[fd];
+
+        if (rconnP && rconnP->busy)
+            ChannelInterrupt(rconnP->connectionP->channelP);
+    }
+    reactorP->lockP->release(reactorP->lockP);
+
+    destroyWorkers(reactorP, reactorP->workerCt);
+
+    /* A parked connection belongs to whatever thread is going to finish
+       its request, so wait for that.
+    */
+    waitForNoParkedConns(reactorP);
+
+    /* Now no thread but ours can touch a connection, and none is busy */
+
+    for (fd = 0; fd < reactorP->connTableSize; ++fd) {
+        struct reactorConn * const rconnP = reactorP->connByFd[fd];
+
+        if (rconnP)
+            closeConn(reactorP, rconnP, false);
+    }
+    assert(reactorP->connCt == 0);
+
+    close(reactorP->wakePipe[0]);
+    close(reactorP->wakePipe[1]);
+    close(reactorP->epollFd);
+    xmlrpc_event_destroy(reactorP->unparkedP);
+    reactorP->lockP->destroy(reactorP->lockP);
+    free(reactorP->connByFd);
+    free(reactorP);
+}
+
+
+
+bool
+ReactorCanTakeChannel(TChannel * const channelP) {
+
+    return ChannelPollFd(channelP) >= 0;
+}
+
+
+
+static void
+waitForRoom(TReactor *    const reactorP,
+            unsigned int  const maxConnCt,
+            bool *        const fullP,
+            const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Wait for a connection to leave the reactor, if it still has 'maxConnCt'
+   of them.  Return *fullP true if it has that many again by the time we
+   look (because some other thread took the room).
+-----------------------------------------------------------------------------*/
+    struct capacityWaiter waiter;
+    const char * error;
+
+    /* We don't create the event with the lock held, because that's slow.
+       Meanwhile, a connection may leave without seeing us waiting, so we
+       check again once we have the lock.
+    */
+    xmlrpc_event_create(&waiter.roomP, &error);
+
+    if (error) {
+        xmlrpc_asprintf(errorP, "Unable to create an event on which to wait "
+                        "for room in the reactor.  %s", error);
+        xmlrpc_strfree(error);
+    } else {
+        bool mustWait;
+
+        reactorP->lockP->acquire(reactorP->lockP);
+
+        mustWait = reactorP->connCt >= maxConnCt;
+
+        if (mustWait) {
+            waiter.nextP = reactorP->capacityWaiterP;
+            reactorP->capacityWaiterP = &waiter;
+        }
+        reactorP->lockP->release(reactorP->lockP);
+
+        if (mustWait)
+            xmlrpc_event_wait(waiter.roomP);
+
+        /* closeConn() sets the event with the lock held, so once we have
+           the lock, it is done with the event.
+        */
+        reactorP->lockP->acquire(reactorP->lockP);
+        *fullP = reactorP->connCt >= maxConnCt;
+        reactorP->lockP->release(reactorP->lockP);
+
+        xmlrpc_event_destroy(waiter.roomP);
+
+        *errorP = NULL;
+    }
+}
+
+
+
+void
+ReactorWaitForCapacity(TReactor *    const reactorP,
+                       const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Wait until the reactor has room for another connection.
+-----------------------------------------------------------------------------*/
+    unsigned int const maxConnCt = reactorP->workerCt * CONNS_PER_WORKER;
+
+    bool full;
+
+    reactorP->lockP->acquire(reactorP->lockP);
+    full = reactorP->connCt >= maxConnCt;
+    reactorP->lockP->release(reactorP->lockP);
+
+    for (*errorP = NULL; full && !*errorP; )
+        waitForRoom(reactorP, maxConnCt, &full, errorP);
+}
+
+
+
+static void
+makeRoomInConnTable(TReactor *    const reactorP,
+                    int           const fd,
+                    const char ** const errorP) {
+
+    if ((unsigned int)fd < reactorP->connTableSize)
+        *errorP = NULL;
+    else {
+        unsigned int const newSize =
+            MAX(MAX((unsigned int)fd + 1, reactorP->connTableSize * 2), 64);
+
+        struct reactorConn ** newTable;
+
+        newTable = realloc(reactorP->connByFd, newSize * sizeof(newTable[0]));
+
+        if (newTable == NULL)
+            xmlrpc_asprintf(errorP, "Could not allocate memory for a "
+                            "%u-entry connection table", newSize);
+        else {
+            unsigned int i;
+
+            for (i = reactorP->connTableSize; i < newSize; ++i)
+                newTable[i] = NULL;
+
+            reactorP->connByFd      = newTable;
+            reactorP->connTableSize = newSize;
+
+            *errorP = NULL;
+        }
+    }
+}
+
+
+
+static void
+addConn(TReactor *           const reactorP,
+        struct reactorConn * const rconnP,
+        const char **        const errorP) {
+
+    reactorP->lockP->acquire(reactorP->lockP);
+
+    makeRoomInConnTable(reactorP, rconnP->fd, errorP);
+
+    if (!*errorP) {
+        assert(reactorP->connByFd[rconnP->fd] == NULL);
+
+        rconnP->generation = reactorP->nextGeneration++;
+
+        armConn(reactorP, rconnP, EPOLL_CTL_ADD, false, errorP);
+
+        if (!*errorP) {
+            reactorP->connByFd[rconnP->fd] = rconnP;
+            ++reactorP->connCt;
+        }
+    }
+    reactorP->lockP->release(reactorP->lockP);
+}
+
+
+
+void
+ReactorAddChannel(TReactor *    const reactorP,
+                  TChannel *    const channelP,
+                  void *        const channelInfoP,
+                  const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Make a connection on channel *channelP, which has just been accepted,
+   and give it to the reactor to wait for requests on.
+
+   The connection then owns *channelP and *channelInfoP.  But if we fail,
+   we don't touch them.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = reactorP->serverP->srvP;
+
+    struct reactorConn * rconnP;
+
+    assert(ReactorCanTakeChannel(channelP));
+
+    MALLOCVAR(rconnP);
+
+    if (rconnP == NULL)
+        xmlrpc_asprintf(errorP, "Could not allocate memory for a "
+                        "reactor connection descriptor");
+    else {
+        TConn * connectionP;
+        const char * error;
+
+        /* The connection has no thread or job of its own; the reactor's
+           workers process it.
+        */
+        ConnCreate(&connectionP, reactorP->serverP, channelP, channelInfoP,
+                   NULL, 0, NULL, ABYSS_FOREGROUND, false, &error);
+
+        if (error) {
+            xmlrpc_asprintf(errorP, "Failed to create an Abyss "
+                            "connection.  %s", error);
+            xmlrpc_strfree(error);
+        } else {
+            rconnP->reactorP     = reactorP;
+            rconnP->connectionP  = connectionP;
+            rconnP->fd           = ChannelPollFd(channelP);
+            rconnP->requestCount = 0;
+            rconnP->deadlineMs   = deadlineAfter(srvP->keepalivetimeout);
+            rconnP->busy         = false;
+            rconnP->expired      = false;
+
+            addConn(reactorP, rconnP, errorP);
+
+            if (*errorP)
+                ConnWaitAndRelease(connectionP);
+        }
+        if (*errorP)
+            free(rconnP);
+    }
+}
+
+
+
+#else  /* HAVE_SYS_EPOLL_H */
+
+bool
+ReactorIsAvailable(void) {
+
+    return false;
+}
+
+
+
+void
+ReactorCreate(TServer *           const serverP ATTR_UNUSED,
+              TReactorProcessFn * const processRequest ATTR_UNUSED,
+              unsigned int        const workerCt ATTR_UNUSED,
+              size_t              const workerStackSize ATTR_UNUSED,
+              TReactor **         const reactorPP ATTR_UNUSED,
+              const char **       const errorP) {
+
+    xmlrpc_asprintf(errorP, "This Abyss was built without epoll, so it "
+                    "cannot run an event-driven server");
+}
+
+
+
+void
+ReactorDestroy(TReactor * const reactorP ATTR_UNUSED) {
+
+    assert(false);
+}
+
+
+
+bool
+ReactorCanTakeChannel(TChannel * const channelP ATTR_UNUSED) {
+
+    return false;
+}
+
+
+
+void
+ReactorWaitForCapacity(TReactor * const reactorP ATTR_UNUSED) {
+
+}
+
+
+
+void
+ReactorResumeConn(TReactorConn * const rconnP ATTR_UNUSED,
+                  bool           const keepalive ATTR_UNUSED) {
+
+    assert(false);
+}
+
+
+
+void
+ReactorAddChannel(TReactor *    const reactorP ATTR_UNUSED,
+                  TChannel *    const channelP ATTR_UNUSED,
+                  void *        const channelInfoP ATTR_UNUSED,
+                  const char ** const errorP) {
+
+    xmlrpc_asprintf(errorP, "This Abyss was built without epoll");
+}
+
+#endif  /* HAVE_SYS_EPOLL_H */
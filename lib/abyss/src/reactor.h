@@ -0,0 +1,66 @@
+#ifndef REACTOR_H_INCLUDED
+#define REACTOR_H_INCLUDED
+
+/*============================================================================
+   An event-driven owner of idle server connections.
+
+   Instead of each connection having a thread that sits waiting for the
+   client to send the next request, the reactor watches all idle
+   connections with one OS event mechanism (epoll) and gives a connection
+   to one of a fixed set of worker threads only when a complete HTTP request
+   header is in its buffer.  When the worker has processed the request, the
+   connection goes back to the reactor to wait for the next one.
+
+   The worker can also leave a request unfinished, so that some other
+   thread finishes it later.  The connection is then parked: it belongs
+   to no thread and the reactor doesn't watch it until that thread calls
+   ReactorResumeConn().
+============================================================================*/
+
+#include "bool.h"
+#include "xmlrpc-c/abyss.h"
+
+#include "conn.h"
+
+typedef struct reactor TReactor;
+
+typedef struct reactorConn TReactorConn;
+
+typedef void TReactorProcessFn(TConn *        const connectionP,
+                               TReactorConn * const rconnP,
+                               bool           const lastReqOnConn,
+                               bool *         const keepaliveP,
+                               bool *         const parkedP);
+
+bool
+ReactorIsAvailable(void);
+
+void
+ReactorCreate(TServer *           const serverP,
+              TReactorProcessFn * const processRequest,
+              unsigned int        const workerCt,
+              size_t              const workerStackSize,
+              TReactor **         const reactorPP,
+              const char **       const errorP);
+
+void
+ReactorDestroy(TReactor * const reactorP);
+
+bool
+ReactorCanTakeChannel(TChannel * const channelP);
+
+void
+ReactorWaitForCapacity(TReactor *    const reactorP,
+                       const char ** const errorP);
+
+void
+ReactorResumeConn(TReactorConn * const rconnP,
+                  bool           const keepalive);
+
+void
+ReactorAddChannel(TReactor *    const reactorP,
+                  TChannel *    const channelP,
+                  void *        const channelInfoP,
+                  const char ** const errorP);
+
+#endif
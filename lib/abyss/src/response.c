@@ -197,16 +197,14 @@ addConnectionHeaderFld(TSession * const sessionP) {
     struct _TServer * const srvP = ConnServer(sessionP->connP)->srvP;
 
     if (HTTPKeepalive(sessionP)) {
-        const char * keepaliveValue;
+        char keepaliveValue[64];
 
         ResponseAddField(sessionP, "Connection", "Keep-Alive");
 
-        xmlrpc_asprintf(&keepaliveValue, "timeout=%u, max=%u",
-                        srvP->keepalivetimeout, srvP->keepalivemaxconn);
+        snprintf(keepaliveValue, sizeof(keepaliveValue), "timeout=%u, max=%u",
+                 srvP->keepalivetimeout, srvP->keepalivemaxconn);
 
         ResponseAddField(sessionP, "Keep-Alive", keepaliveValue);
-
-        xmlrpc_strfree(keepaliveValue);
     } else
         ResponseAddField(sessionP, "Connection", "close");
 }
@@ -217,14 +215,10 @@ static void
 addDateHeaderFld(TSession * const sessionP) {
 
     if (sessionP->status >= 200) {
-        const char * dateValue;
-
-        DateToString(sessionP->date, &dateValue);
+        char dateValue[DATE_STRING_SIZE];
 
-        if (dateValue) {
+        if (DateFormat(sessionP->date, dateValue, sizeof(dateValue)))
             ResponseAddField(sessionP, "Date", dateValue);
-            xmlrpc_strfree(dateValue);
-        }
     }
 }
 
@@ -233,13 +227,7 @@ addDateHeaderFld(TSession * const sessionP) {
 static void
 addServerHeaderFld(TSession * const sessionP) {
 
-    const char * serverValue;
-
-    xmlrpc_asprintf(&serverValue, "Xmlrpc-c_Abyss/%s", XMLRPC_C_VERSION);
-
-    ResponseAddField(sessionP, "Server", serverValue);
-
-    xmlrpc_strfree(serverValue);
+    ResponseAddField(sessionP, "Server", "Xmlrpc-c_Abyss/" XMLRPC_C_VERSION);
 }
 
 
@@ -268,36 +256,6 @@ trailingWsPos(const char * const arg) {
 
 
 
-static const char *
-formatFieldValue(const char * const unformatted) {
-/*----------------------------------------------------------------------------
-   Return the string of characters that goes after the colon on the
-   HTTP header field line, given that 'unformatted' is its basic value.
------------------------------------------------------------------------------*/
-    const char * retval;
-
-    /* An HTTP header field value may not have leading or trailing white
-       space.
-    */
-    char * buffer;
-
-    buffer = malloc(strlen(unformatted) + 1);
-
-    if (buffer == NULL)
-        retval = xmlrpc_strnomemval();
-    else {
-        unsigned int const lead  = leadingWsCt(unformatted);
-        unsigned int const trail = trailingWsPos(unformatted);
-        assert(trail >= lead);
-        strncpy(buffer, &unformatted[lead], trail - lead);
-        buffer[trail - lead] = '\0';
-        retval = buffer;
-    }
-    return retval;
-}
-
-
-
 static void
 sendHeader(TConn * const connP,
            TTable  const fields) {
@@ -316,14 +274,22 @@ sendHeader(TConn * const connP,
 
     for (i = 0; i < fields.size; ++i) {
         TTableItem * const fieldP = &fields.item[i];
-        const char * const fieldValue = formatFieldValue(fieldP->value);
 
-        const char * line;
+        /* An HTTP header field value may not have leading or trailing
+           white space.
+        */
+        unsigned int const lead  = leadingWsCt(fieldP->value);
+        unsigned int const trail = trailingWsPos(fieldP->value);
 
-        xmlrpc_asprintf(&line, "%s: %s\r\n", fieldP->name, fieldValue);
-        ConnWrite(connP, line, strlen(line), CONN_EXPECT_MORE);
-        xmlrpc_strfree(line);
-        xmlrpc_strfree(fieldValue);
+        assert(trail >= lead);
+
+        /* The connection collects these small writes into one send */
+        ConnWrite(connP, fieldP->name, strlen(fieldP->name),
+                  CONN_EXPECT_MORE);
+        ConnWrite(connP, ": ", 2, CONN_EXPECT_MORE);
+        ConnWrite(connP, &fieldP->value[lead], trail - lead,
+                  CONN_EXPECT_MORE);
+        ConnWrite(connP, "\r\n", 2, CONN_EXPECT_MORE);
     }
 }
 
@@ -352,10 +318,10 @@ ResponseWriteStart(TSession * const sessionP) {
 
     {
         const char * const reason = HTTPReasonByStatus(sessionP->status);
-        const char * line;
-        xmlrpc_asprintf(&line,"HTTP/1.1 %u %s\r\n", sessionP->status, reason);
+        char line[128];
+        snprintf(line, sizeof(line), "HTTP/1.1 %u %s\r\n",
+                 sessionP->status, reason);
         ConnWrite(sessionP->connP, line, strlen(line), CONN_EXPECT_MORE);
-        xmlrpc_strfree(line);
     }
 
     addConnectionHeaderFld(sessionP);
@@ -374,7 +340,11 @@ ResponseWriteStart(TSession * const sessionP) {
     */
     sendHeader(sessionP->connP, sessionP->responseHeaderFields);
 
-    ConnWrite(sessionP->connP, "\r\n", 2, CONN_EXPECT_NOTHING);
+    /* The body, if any, follows, so the header can wait to go out with it.
+       The server flushes the connection at the end of the request in any
+       case.
+    */
+    ConnWrite(sessionP->connP, "\r\n", 2, CONN_EXPECT_MORE);
 }
 
 
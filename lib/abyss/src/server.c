@@ -22,10 +22,13 @@
 #endif
 
 #include "bool.h"
+#include "c_util.h"
 #include "girmath.h"
 #include "mallocvar.h"
+#include "atomic.h"
 #include "xmlrpc-c/string_int.h"
 #include "xmlrpc-c/sleep_int.h"
+#include "xmlrpc-c/time_int.h"
 #include "xmlrpc-c/lock.h"
 #include "xmlrpc-c/lock_platform.h"
 
@@ -34,6 +37,7 @@
 #include "thread.h"
 #include "session.h"
 #include "file.h"
+#include "accesslog.h"
 #include "conn.h"
 #include "chanswitch.h"
 #include "channel.h"
@@ -46,6 +50,10 @@
 #include "http.h"
 #include "handler.h"
 #include "sessionReadRequest.h"
+#include "reactor.h"
+#include "connpool.h"
+#include "prefork.h"
+#include "overload.h"
 
 #include "server.h"
 
@@ -68,8 +76,14 @@ ServerTerminate(TServer * const serverP) {
 
     srvP->terminationRequested = true;
 
-    if (srvP->chanSwitchP)
+    if (srvP->chanSwitchP) {
+        unsigned int i;
+
         ChanSwitchInterrupt(srvP->chanSwitchP);
+
+        for (i = 0; i < srvP->extraChanSwitchCt; ++i)
+            ChanSwitchInterrupt(srvP->extraChanSwitches[i]);
+    }
 }
 
 
@@ -94,40 +108,6 @@ initUnixStuff(struct _TServer * const srvP) {
 
 
 
-static void
-logOpen(struct _TServer * const srvP,
-        const char **     const errorP) {
-
-    bool success;
-
-    success = FileOpenCreate(&srvP->logfileP, srvP->logfilename,
-                             O_WRONLY | O_APPEND);
-    if (success) {
-        srvP->logLockP = xmlrpc_lock_create();
-        *errorP = NULL;
-
-        srvP->logfileisopen = true;
-
-        if (*errorP)
-            FileClose(srvP->logfileP);
-    } else
-        xmlrpc_asprintf(errorP, "Can't open log file '%s'", srvP->logfilename);
-}
-
-
-
-static void
-logClose(struct _TServer * const srvP) {
-
-    if (srvP->logfileisopen) {
-        FileClose(srvP->logfileP);
-        srvP->logLockP->destroy(srvP->logLockP);
-        srvP->logfileisopen = false;
-    }
-}
-
-
-
 static void
 setupTrace(struct _TServer * const srvP) {
 
@@ -168,6 +148,71 @@ trace(struct Tracer * const tracerP,
 
 
 
+static void
+logOpen(struct _TServer * const srvP,
+        const char **     const errorP) {
+/*----------------------------------------------------------------------------
+   Open the log file.  Caller holds the log lock.
+
+   If the user asked for buffered logging and the server's threads are
+   threads of this process, start an asynchronous writer for it.  Where a
+   server thread is a process of its own, or a worker process serves the
+   connections, a line left in a buffer when the process exits would be
+   lost, so we write synchronously.
+-----------------------------------------------------------------------------*/
+    bool success;
+
+    success = FileOpenCreate(&srvP->logfileP, srvP->logfilename,
+                             O_WRONLY | O_APPEND);
+    if (success) {
+        srvP->logfileisopen = true;
+
+        if (srvP->logBufferSize > 0 && !ThreadForks() &&
+            srvP->preforkMaxWorkers == 0) {
+            TAccessLog * accessLogP;
+            const char * error;
+
+            AccessLogCreate(srvP->logfileP, srvP->logBufferSize,
+                            srvP->logDropWhenFull, &accessLogP, &error);
+
+            if (error) {
+                TraceMsg("Failed to start asynchronous log writer.  "
+                         "Writing log file synchronously.  %s", error);
+                xmlrpc_strfree(error);
+            } else
+                xmlrpc_atomicStorePtr((void * volatile *)&srvP->accessLogP,
+                                      accessLogP);
+        }
+        *errorP = NULL;
+    } else
+        xmlrpc_asprintf(errorP, "Can't open log file '%s'", srvP->logfilename);
+}
+
+
+
+static void
+logClose(struct _TServer * const srvP) {
+
+    if (srvP->logfileisopen) {
+        if (srvP->accessLogP) {
+            unsigned long const droppedCt =
+                AccessLogDroppedCt(srvP->accessLogP);
+
+            if (droppedCt > 0)
+                trace(&srvP->tracer, "Dropped %lu log lines because a "
+                      "thread's log buffer was full", droppedCt);
+
+            /* This writes whatever the threads still have buffered */
+            AccessLogDestroy(srvP->accessLogP);
+            srvP->accessLogP = NULL;
+        }
+        FileClose(srvP->logfileP);
+        srvP->logfileisopen = false;
+    }
+}
+
+
+
 static void
 initChanSwitchStuff(struct _TServer * const srvP,
                     bool              const noAccept,
@@ -244,14 +289,36 @@ createServer(struct _TServer ** const srvPP,
                 srvP->maxConn          = 15;
                 srvP->maxConnBacklog   = 15;
                 srvP->maxSessionMem    = 0;
+                srvP->eventDriven      = false;
+                srvP->connQueueDepth   = 15;
+                srvP->acceptorCt       = 1;
+                srvP->pinAcceptors     = false;
+                srvP->extraChanSwitches = NULL;
+                srvP->extraChanSwitchCt = 0;
+                srvP->preforkMinWorkers = 0;
+                srvP->preforkMaxWorkers = 0;
+                srvP->preforkMaxRequests = 0;
+                srvP->shedTargetMs     = 0;
+                srvP->shedIntervalMs   = 100;
+                srvP->shedRetryAfter   = 1;
+                srvP->overloadP        = NULL;
+                srvP->shedResponse     = NULL;
 
                 initUnixStuff(srvP);
 
                 ListInitAutoFree(&srvP->handlers);
 
                 srvP->logfileisopen = false;
+                srvP->logBufferSize = 0;
+                srvP->logDropWhenFull = false;
+                srvP->accessLogP = NULL;
+                srvP->logLockP = xmlrpc_lock_create();
 
-                *errorP = NULL;
+                if (!srvP->logLockP)
+                    xmlrpc_asprintf(errorP,
+                                    "Unable to create lock for log file");
+                else
+                    *errorP = NULL;
 
                 if (*errorP)
                     HandlerDestroy(srvP->builtinHandlerP);
@@ -512,9 +579,21 @@ ServerFree(TServer * const serverP) {
 
     struct _TServer * const srvP = serverP->srvP;
 
+    if (srvP->extraChanSwitches) {
+        unsigned int i;
+
+        for (i = 0; i < srvP->extraChanSwitchCt; ++i)
+            ChanSwitchDestroy(srvP->extraChanSwitches[i]);
+
+        free(srvP->extraChanSwitches);
+    }
     if (srvP->weCreatedChanSwitch)
         ChanSwitchDestroy(srvP->chanSwitchP);
 
+    if (srvP->overloadP) {
+        OverloadDestroy(srvP->overloadP);
+        xmlrpc_strfree(srvP->shedResponse);
+    }
     xmlrpc_strfree(srvP->name);
 
     terminateHandlers(&srvP->handlers);
@@ -525,6 +604,8 @@ ServerFree(TServer * const serverP) {
 
     logClose(srvP);
 
+    srvP->logLockP->destroy(srvP->logLockP);
+
     if (srvP->logfilename)
         xmlrpc_strfree(srvP->logfilename);
 
@@ -644,6 +725,181 @@ ServerSetMaxSessionMem(TServer * const serverP,
 
 
 
+void
+ServerSetConnQueueDepth(TServer *    const serverP,
+                        unsigned int const connQueueDepth) {
+/*----------------------------------------------------------------------------
+   Set how many accepted connections may wait for a free thread in the
+   server's connection pool.  When that many are waiting, ServerRun() stops
+   accepting connections until a thread takes one.
+-----------------------------------------------------------------------------*/
+    if (connQueueDepth > 0)
+        serverP->srvP->connQueueDepth = connQueueDepth;
+}
+
+
+
+void
+ServerSetEventDriven(TServer *  const serverP,
+                     abyss_bool const eventDriven) {
+/*----------------------------------------------------------------------------
+   Have ServerRun() keep idle connections in an event-driven reactor,
+   with a fixed set of threads processing requests as they arrive, instead
+   of giving each connection a thread of its own to wait in.
+
+   Where the reactor isn't available (no epoll, or Abyss threads are
+   processes) or can't watch a particular channel (e.g. OpenSSL), the
+   server uses a thread per connection anyway.
+-----------------------------------------------------------------------------*/
+    serverP->srvP->eventDriven = eventDriven;
+}
+
+
+
+void
+ServerSetAcceptorCount(TServer *    const serverP,
+                       unsigned int const acceptorCt) {
+/*----------------------------------------------------------------------------
+   Have ServerRun() accept connections in 'acceptorCt' threads, each with
+   its own listening socket at the server's address, so the OS spreads
+   incoming connections among them.  Each acceptor serves its connections
+   separately from the others, with its own limit of maxConn connections.
+
+   You must call this before ServerInit().  If you supply the channel
+   switch, it must allow sharing its address (see
+   ChanSwitchUnixCreateReusePort()).
+
+   Where that isn't possible (Windows, or Abyss threads are processes), the
+   server uses one acceptor anyway.
+-----------------------------------------------------------------------------*/
+    if (acceptorCt > 0)
+        serverP->srvP->acceptorCt = acceptorCt;
+}
+
+
+
+void
+ServerSetAcceptorAffinity(TServer *  const serverP,
+                          abyss_bool const pinAcceptors) {
+/*----------------------------------------------------------------------------
+   Have each of the server's acceptors (see ServerSetAcceptorCount()) run,
+   along with the threads that serve its connections, on a CPU of its own,
+   where the system lets us do that.
+-----------------------------------------------------------------------------*/
+    serverP->srvP->pinAcceptors = pinAcceptors;
+}
+
+
+
+void
+ServerSetPrefork(TServer *    const serverP,
+                 unsigned int const minWorkers,
+                 unsigned int const maxWorkers,
+                 unsigned int const maxRequests) {
+/*----------------------------------------------------------------------------
+   Have ServerRun() serve connections with worker processes it forks ahead
+   of time, instead of with threads.  Each worker accepts connections on the
+   server's listening socket and serves them one at a time.  There are
+   between 'minWorkers' and 'maxWorkers' workers, depending upon how many
+   are busy.  A worker exits after serving 'maxRequests' HTTP requests and
+   the server starts a new one; zero means no limit.
+
+   'maxWorkers' zero means don't use worker processes.
+
+   A worker process serves connections itself, so event-driven operation,
+   the connection thread pool, and multiple acceptors don't apply.  Worker
+   processes aren't possible on Windows; the server uses threads there.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = serverP->srvP;
+
+    srvP->preforkMaxWorkers  = maxWorkers;
+    srvP->preforkMinWorkers  = MAX(1, MIN(minWorkers, maxWorkers));
+    srvP->preforkMaxRequests = maxRequests;
+}
+
+
+
+void
+ServerSetLoadShedding(TServer *    const serverP,
+                      unsigned int const targetMs,
+                      unsigned int const intervalMs,
+                      unsigned int const retryAfter) {
+/*----------------------------------------------------------------------------
+   Have ServerRun() refuse connections that wait too long for a thread to
+   serve them, so that when the server can't keep up, the clients it does
+   serve don't wait ever longer.  It refuses one with a 503 (Service
+   Unavailable) response that tells the client to retry after 'retryAfter'
+   seconds, without reading the request.
+
+   The server decides a connection waited too long after the manner of
+   CoDel: if in a whole interval of 'intervalMs' milliseconds no connection
+   waited less than 'targetMs' milliseconds, the server is overloaded and
+   refuses every connection that has waited longer than 'targetMs'.
+   Otherwise, it refuses only those that have waited longer than
+   'intervalMs'.
+
+   'targetMs' zero means don't refuse connections.  'intervalMs' and
+   'retryAfter' zero mean the defaults: 100 milliseconds and 1 second.
+
+   This applies only where the server has a thread to serve each connection
+   for its whole life, i.e. not to an event-driven server or one with
+   worker processes.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = serverP->srvP;
+
+    srvP->shedTargetMs = targetMs;
+    if (intervalMs > 0)
+        srvP->shedIntervalMs = intervalMs;
+    if (retryAfter > 0)
+        srvP->shedRetryAfter = retryAfter;
+}
+
+
+
+void
+ServerSetLogBuffer(TServer *    const serverP,
+                   unsigned int const bufferSize,
+                   abyss_bool   const dropWhenFull) {
+/*----------------------------------------------------------------------------
+   Have the server write its log file asynchronously: a thread that logs a
+   line copies it into a buffer of 'bufferSize' bytes of its own, and a
+   background thread writes the buffered lines to the file.  When a
+   thread's buffer is full, it drops the line if 'dropWhenFull' is true,
+   and otherwise waits for room.  ServerFree() writes whatever is still
+   buffered.
+
+   'bufferSize' zero means write the log file synchronously, which is the
+   default.
+
+   This applies only where the server's threads are threads of one process,
+   i.e. not where a thread is a forked process or the server has worker
+   processes; there, the server writes its log file synchronously anyway.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = serverP->srvP;
+
+    srvP->logBufferSize   = bufferSize;
+    srvP->logDropWhenFull = dropWhenFull;
+}
+
+
+
+unsigned long
+ServerGetLogDroppedCt(TServer * const serverP) {
+/*----------------------------------------------------------------------------
+   The number of log lines the server has dropped because a thread's log
+   buffer was full (see ServerSetLogBuffer()).  Zero if the server doesn't
+   write its log file asynchronously.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = serverP->srvP;
+
+    TAccessLog * const accessLogP =
+        xmlrpc_atomicLoadPtr((void * volatile *)&srvP->accessLogP);
+
+    return accessLogP ? AccessLogDroppedCt(accessLogP) : 0;
+}
+
+
+
 static URIHandler2
 makeUriHandler2(const struct uriHandler * const handlerP) {
 
@@ -730,6 +986,89 @@ traceRequestStart(struct Tracer * const tracerP,
 
 
 
+static void
+startRequest(TSession *      const sessionP,
+             bool            const lastReqOnConn,
+             uint32_t        const timeout,
+             struct Tracer * const tracerP) {
+/*----------------------------------------------------------------------------
+   Get one HTTP request from the client through session *sessionP's
+   connection buffer and run the handlers for it.  This is the first half
+   of processRequestFromClient().
+-----------------------------------------------------------------------------*/
+    TConn * const connectionP = sessionP->connP;
+
+    const char * error;
+    uint16_t httpErrorCode;
+
+    sessionP->serverDeniesKeepalive = lastReqOnConn;
+
+    connectionP->holdOutput = false;
+
+    SessionReadRequest(sessionP, timeout, &error, &httpErrorCode);
+
+    if (!error && !lastReqOnConn) {
+        /* If the client has already sent the next request, hold our
+           response to this one so it can go out with the next response.
+        */
+        connectionP->holdOutput = SessionNextRequestIsBuffered(sessionP);
+    }
+    if (error) {
+        /* The request may have failed because it used all the memory the
+           session may have; let the small error response have what it needs.
+        */
+        PoolSetLimit(sessionP->poolP, 0);
+
+        ResponseStatus(sessionP, httpErrorCode);
+        ResponseError2(sessionP, error);
+        xmlrpc_strfree(error);
+    } else {
+        traceRequestStart(tracerP, sessionP);
+        if (sessionP->version.major >= 2)
+            handleReqTooNewHttpVersion(sessionP);
+        else if (!HTTPRequestHasValidUri(sessionP))
+            handleReqInvalidURI(sessionP);
+        else
+            runUserHandler(sessionP, connectionP->server->srvP);
+    }
+}
+
+
+
+static void
+endRequest(TSession * const sessionP,
+           bool *     const keepAliveP) {
+/*----------------------------------------------------------------------------
+   Finish the response to session *sessionP's request, whose handler has
+   responded, and log the request.  This is the second half of
+   processRequestFromClient().
+-----------------------------------------------------------------------------*/
+    TConn * const connectionP = sessionP->connP;
+
+    bool bodySkipped;
+
+    assert(sessionP->status != 0);
+
+    if (sessionP->responseStarted)
+        ResponseWriteEnd(sessionP);
+    else
+        ResponseError(sessionP);
+
+    /* The next request on the connection starts after this one's body,
+       whether or not the handler read it.
+    */
+    SessionSkipUnreadBody(sessionP, &bodySkipped);
+
+    *keepAliveP = HTTPKeepalive(sessionP) && bodySkipped;
+
+    if (!*keepAliveP || !connectionP->holdOutput)
+        ConnFlush(connectionP);
+
+    SessionLog(sessionP);
+}
+
+
+
 static void
 processRequestFromClient(TConn *         const connectionP,
                          bool            const lastReqOnConn,
@@ -759,56 +1098,34 @@ processRequestFromClient(TConn *         const connectionP,
    (GET, POST, etc) and URL etc, and that response may be either to
    execute the request and send the response or refuse the request and let
    us call the next one in the list.
+
+   The handler can't defer its response, because we have a thread to wait
+   for it with anyway.
 -----------------------------------------------------------------------------*/
     TSession session;
-    const char * error;
-    uint16_t httpErrorCode;
 
     SessionInit(&session, connectionP);
 
-    session.serverDeniesKeepalive = lastReqOnConn;
-
-    SessionReadRequest(&session, timeout, &error, &httpErrorCode);
-
-    if (error) {
-        ResponseStatus(&session, httpErrorCode);
-        ResponseError2(&session, error);
-        xmlrpc_strfree(error);
-    } else {
-        traceRequestStart(tracerP, &session);
-        if (session.version.major >= 2)
-            handleReqTooNewHttpVersion(&session);
-        else if (!HTTPRequestHasValidUri(&session))
-            handleReqInvalidURI(&session);
-        else
-            runUserHandler(&session, connectionP->server->srvP);
-    }
+    startRequest(&session, lastReqOnConn, timeout, tracerP);
 
-    assert(session.status != 0);
-
-    if (session.responseStarted)
-        ResponseWriteEnd(&session);
-    else
-        ResponseError(&session);
-
-    *keepAliveP = HTTPKeepalive(&session);
-
-    SessionLog(&session);
+    endRequest(&session, keepAliveP);
 
     SessionTerm(&session);
 }
 
 
 
-static TThreadProc serverFunc;
-
 static void
-serverFunc(void * const userHandle) {
+serveRequests(TConn *        const connectionP,
+              unsigned int   const maxRequests,
+              unsigned int * const requestCountP) {
 /*----------------------------------------------------------------------------
    Do server stuff on one connection.  At its simplest, this means do
-   one HTTP request.  But with keepalive, it can be many requests.
+   one HTTP request.  But with keepalive, it can be many requests, up to
+   'maxRequests'.
+
+   Return as *requestCountP the number of requests we handled.
 -----------------------------------------------------------------------------*/
-    TConn *           const connectionP = userHandle;
     struct _TServer * const srvP = connectionP->server->srvP;
 
     unsigned int requestCount;
@@ -832,8 +1149,16 @@ serverFunc(void * const userHandle) {
            treat dead time between requests differently from dead time in
            the middle of a request.
         */
-        ConnRead(connectionP, srvP->keepalivetimeout,
-                 &timedOut, &eof, &readError);
+        if (connectionP->bufferpos < connectionP->buffersize) {
+            /* Client pipelined; the next request is already (at least
+               partly) in the buffer, following the last one.
+            */
+            timedOut  = false;
+            eof       = false;
+            readError = NULL;
+        } else
+            ConnRead(connectionP, srvP->keepalivetimeout,
+                     &timedOut, &eof, &readError);
 
         if (srvP->terminationRequested) {
             connectionDone = true;
@@ -847,7 +1172,7 @@ serverFunc(void * const userHandle) {
             connectionDone = true;
         } else {
             bool const lastReqOnConn =
-                requestCount + 1 >= srvP->keepalivemaxconn;
+                requestCount + 1 >= maxRequests;
 
             bool keepalive;
 
@@ -871,7 +1196,83 @@ serverFunc(void * const userHandle) {
             ConnReadInit(connectionP);
         }
     }
+    /* We may have been holding a response for a pipelined request we
+       never got to.
+    */
+    ConnFlush(connectionP);
+
     trace(&srvP->tracer, "PID %d done with connection", XMLRPC_GETPID());
+
+    *requestCountP = requestCount;
+}
+
+
+
+static bool
+mustShed(TConn * const connectionP) {
+/*----------------------------------------------------------------------------
+   The server is too busy to serve connection *connectionP, given how long
+   it waited for us to get to it.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = connectionP->server->srvP;
+    TChannel *        const channelP = connectionP->channelP;
+
+    bool shed;
+
+    if (srvP->overloadP && channelP->acceptTimeMs != 0)
+        OverloadJudge(srvP->overloadP, channelP->acceptTimeMs, &shed);
+    else
+        shed = false;
+
+    return shed;
+}
+
+
+
+static void
+refuseConnection(TConn * const connectionP) {
+/*----------------------------------------------------------------------------
+   Tell the client on connection *connectionP that the server is too busy
+   and it should try again later.
+
+   We don't read the request, let alone parse it.  But we do take whatever
+   of it has already arrived, without waiting for more, because closing a
+   TCP connection with unread data makes the OS reset it, and the client
+   may lose our response.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = connectionP->server->srvP;
+
+    bool eof, timedOut;
+    const char * readError;
+
+    trace(&srvP->tracer, "Refusing connection because server is overloaded");
+
+    ConnWrite(connectionP, srvP->shedResponse, strlen(srvP->shedResponse),
+              CONN_EXPECT_NOTHING);
+
+    ConnRead(connectionP, 0, &eof, &timedOut, &readError);
+
+    if (readError)
+        xmlrpc_strfree(readError);
+}
+
+
+
+static TThreadProc serverFunc;
+
+static void
+serverFunc(void * const userHandle) {
+
+    TConn *           const connectionP = userHandle;
+    struct _TServer * const srvP = connectionP->server->srvP;
+
+    if (mustShed(connectionP))
+        refuseConnection(connectionP);
+    else {
+        unsigned int requestCount;
+
+        serveRequests(connectionP, srvP->keepalivemaxconn, &requestCount);
+    }
 }
 
 
@@ -884,41 +1285,319 @@ serverFunc(void * const userHandle) {
 
 
 
-static void
-createSwitchFromPortNum(unsigned short const portNumber,
-                        TChanSwitch ** const chanSwitchPP,
-                        const char **  const errorP) {
+static TSessionFinishFn finishDeferredRequest;
+
+static void
+finishDeferredRequest(TSession * const sessionP) {
+/*----------------------------------------------------------------------------
+   Finish the request of session *sessionP, whose handler deferred its
+   response, now that the handler has returned and the response is done.
+   Then give the connection, which the reactor parked for the request,
+   back to the reactor.
+
+   We run in whatever thread finished the response.
+-----------------------------------------------------------------------------*/
+    TReactorConn * const rconnP = sessionP->finishDeferredArg;
+    struct _TServer * const srvP = sessionP->connP->server->srvP;
+
+    bool keepalive;
+
+    endRequest(sessionP, &keepalive);
+
+    trace(&srvP->tracer,
+          "Done processing the deferred HTTP request.  Keepalive = %s",
+          keepalive ? "YES" : "NO");
+
+    SessionTerm(sessionP);
+
+    free(sessionP);
+
+    ReactorResumeConn(rconnP, keepalive);
+}
+
+
+
+static TReactorProcessFn processRequestFromReactor;
+
+static void
+processRequestFromReactor(TConn *        const connectionP,
+                          TReactorConn * const rconnP,
+                          bool           const lastReqOnConn,
+                          bool *         const keepaliveP,
+                          bool *         const parkedP) {
+/*----------------------------------------------------------------------------
+   This is the reactor's way of processing a request, which it calls when
+   the connection buffer contains a complete request header.  It is the
+   event-driven counterpart of the body of serverFunc()'s loop.
+
+   Unlike there, the handler may defer its response (see
+   SessionDeferResponse()).  If it does and the response isn't done by the
+   time the handler returns, we return *parkedP true and whoever finishes
+   the response gives the connection back to the reactor.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = connectionP->server->srvP;
+
+    TSession * sessionP;
+
+    trace(&srvP->tracer,
+          "HTTP request header received on reactor connection.  "
+          "Processing");
+
+    /* The session may outlive this call, so it can't be on our stack */
+    MALLOCVAR(sessionP);
+
+    if (sessionP == NULL) {
+        processRequestFromClient(connectionP, lastReqOnConn, srvP->timeout,
+                                 &srvP->tracer, keepaliveP);
+        *parkedP = false;
+    } else {
+        bool stillDeferred;
+
+        SessionInit(sessionP, connectionP);
+
+        sessionP->finishDeferred    = &finishDeferredRequest;
+        sessionP->finishDeferredArg = rconnP;
+
+        startRequest(sessionP, lastReqOnConn, srvP->timeout, &srvP->tracer);
+
+        SessionHandlerReturned(sessionP, &stillDeferred);
+
+        if (stillDeferred) {
+            trace(&srvP->tracer, "Handler deferred its response.  "
+                  "Parking the connection");
+            *parkedP = true;
+        } else {
+            endRequest(sessionP, keepaliveP);
+
+            SessionTerm(sessionP);
+
+            free(sessionP);
+
+            *parkedP = false;
+        }
+    }
+    if (!*parkedP)
+        trace(&srvP->tracer,
+              "Done processing the HTTP request.  Keepalive = %s",
+              *keepaliveP ? "YES" : "NO");
+}
+
+
+
+static bool
+usingPrefork(struct _TServer * const srvP) {
+
+    return srvP->preforkMaxWorkers > 0 && PreforkIsAvailable();
+}
+
+
+
+static bool
+usingMultipleAcceptors(struct _TServer * const srvP) {
+/*----------------------------------------------------------------------------
+   The server has more than one acceptor (see ServerSetAcceptorCount()).
+   That requires listening sockets that can share an address and Abyss
+   threads that are real threads.  And worker processes take the place of
+   acceptors.
+-----------------------------------------------------------------------------*/
+#if MSVCRT
+    return false;
+#else
+    return srvP->acceptorCt > 1 && !ThreadForks() && !usingPrefork(srvP);
+#endif
+}
+
+
+
+static void
+createSwitchFromPortNum(unsigned short const portNumber,
+                        bool           const reusePort,
+                        TChanSwitch ** const chanSwitchPP,
+                        const char **  const errorP) {
+
+#if MSVCRT
+    ChanSwitchWinCreate(portNumber, chanSwitchPP, errorP);
+#else
+    if (reusePort) {
+        struct sockaddr_in sockAddr;
+
+        memset(&sockAddr, 0, sizeof(sockAddr));
+        sockAddr.sin_family      = AF_INET;
+        sockAddr.sin_port        = htons(portNumber);
+        sockAddr.sin_addr.s_addr = INADDR_ANY;
+
+        ChanSwitchUnixCreateReusePort(PF_INET,
+                                      (const struct sockaddr *)&sockAddr,
+                                      sizeof(sockAddr),
+                                      chanSwitchPP, errorP);
+    } else
+        ChanSwitchUnixCreate(portNumber, chanSwitchPP, errorP);
+#endif
+}
+
+
+
+static void
+createChanSwitch(struct _TServer * const srvP,
+                 const char **     const errorP) {
+
+    bool const reusePort = usingMultipleAcceptors(srvP);
+
+    TChanSwitch * chanSwitchP;
+    const char * error;
+
+    /* Not valid to call this when channel switch already exists: */
+    assert(srvP->chanSwitchP == NULL);
+
+    createSwitchFromPortNum(srvP->port, reusePort, &chanSwitchP, &error);
+
+    if (error) {
+        xmlrpc_asprintf(errorP,
+                        "Can't create channel switch.  %s", error);
+        xmlrpc_strfree(error);
+    } else {
+        *errorP = NULL;
+
+        srvP->weCreatedChanSwitch = true;
+        srvP->chanSwitchP         = chanSwitchP;
+    }
+}
+
+
+
+static void
+destroyChanSwitches(TChanSwitch ** const chanSwitches,
+                    unsigned int   const count) {
+
+    unsigned int i;
+
+    for (i = 0; i < count; ++i)
+        ChanSwitchDestroy(chanSwitches[i]);
+
+    free(chanSwitches);
+}
+
+
+
+static void
+createListeningSibling(struct _TServer *       const srvP,
+                       const struct sockaddr * const sockAddrP,
+                       size_t                  const sockAddrLen,
+                       TChanSwitch **          const chanSwitchPP,
+                       const char **           const errorP) {
+/*----------------------------------------------------------------------------
+   Create a channel switch that listens at the same address as the server's
+   main one, *sockAddrP.
+-----------------------------------------------------------------------------*/
+#if MSVCRT
+    xmlrpc_asprintf(errorP, "Multiple acceptors are not possible on Windows");
+#else
+    const char * error;
+
+    ChanSwitchUnixCreateReusePort(sockAddrP->sa_family, sockAddrP,
+                                  sockAddrLen, chanSwitchPP, &error);
+
+    if (error) {
+        xmlrpc_asprintf(errorP, "Can't create channel switch.  %s", error);
+        xmlrpc_strfree(error);
+    } else {
+        ChanSwitchListen(*chanSwitchPP, srvP->maxConnBacklog, &error);
+
+        if (error) {
+            xmlrpc_asprintf(errorP, "Failed to listen.  %s", error);
+            xmlrpc_strfree(error);
+            ChanSwitchDestroy(*chanSwitchPP);
+        } else
+            *errorP = NULL;
+    }
+#endif
+}
+
+
+
+static void
+createExtraChanSwitches(struct _TServer * const srvP,
+                        const char **     const errorP) {
+/*----------------------------------------------------------------------------
+   Create the listening channel switches for the server's acceptors other
+   than the first, which uses the server's main channel switch.
+
+   The main channel switch must be listening.
+-----------------------------------------------------------------------------*/
+#if MSVCRT
+    xmlrpc_asprintf(errorP, "Multiple acceptors are not possible on Windows");
+#else
+    unsigned int const extraCt = srvP->acceptorCt - 1;
+
+    struct sockaddr * sockAddrP;
+    size_t sockAddrLen;
+    const char * error;
+
+    ChanSwitchUnixGetListenName(srvP->chanSwitchP, &sockAddrP, &sockAddrLen,
+                                &error);
+
+    if (error) {
+        xmlrpc_asprintf(errorP, "Can't find out the address at which the "
+                        "server listens.  %s", error);
+        xmlrpc_strfree(error);
+    } else {
+        TChanSwitch ** chanSwitches;
+
+        MALLOCARRAY(chanSwitches, extraCt);
+
+        if (chanSwitches == NULL)
+            xmlrpc_asprintf(errorP, "Could not allocate memory for %u "
+                            "channel switch pointers", extraCt);
+        else {
+            unsigned int i;
+
+            for (i = 0, *errorP = NULL; i < extraCt && !*errorP; ++i) {
+                createListeningSibling(srvP, sockAddrP, sockAddrLen,
+                                       &chanSwitches[i], &error);
 
-#if MSVCRT
-    ChanSwitchWinCreate(portNumber, chanSwitchPP, errorP);
-#else
-    ChanSwitchUnixCreate(portNumber, chanSwitchPP, errorP);
+                if (error) {
+                    xmlrpc_asprintf(errorP, "Failed to create the channel "
+                                    "switch for acceptor %u.  %s",
+                                    i + 1, error);
+                    xmlrpc_strfree(error);
+
+                    destroyChanSwitches(chanSwitches, i);
+                }
+            }
+            if (!*errorP) {
+                srvP->extraChanSwitches = chanSwitches;
+                srvP->extraChanSwitchCt = extraCt;
+            }
+        }
+        free(sockAddrP);
+    }
 #endif
 }
 
 
 
 static void
-createChanSwitch(struct _TServer * const srvP,
-                 const char **     const errorP) {
-
-    TChanSwitch * chanSwitchP;
-    const char * error;
-
-    /* Not valid to call this when channel switch already exists: */
-    assert(srvP->chanSwitchP == NULL);
-
-    createSwitchFromPortNum(srvP->port, &chanSwitchP, &error);
+createOverloadDetector(struct _TServer * const srvP,
+                       const char **     const errorP) {
 
-    if (error) {
-        xmlrpc_asprintf(errorP,
-                        "Can't create channel switch.  %s", error);
-        xmlrpc_strfree(error);
-    } else {
-        *errorP = NULL;
+    OverloadCreate(srvP->shedTargetMs, srvP->shedIntervalMs,
+                   &srvP->overloadP, errorP);
 
-        srvP->weCreatedChanSwitch = true;
-        srvP->chanSwitchP         = chanSwitchP;
+    if (!*errorP) {
+        xmlrpc_asprintf(&srvP->shedResponse,
+                        "HTTP/1.1 503 Service Unavailable\r\n"
+                        "Retry-After: %u\r\n"
+                        "Content-Length: 0\r\n"
+                        "Connection: close\r\n"
+                        "\r\n",
+                        srvP->shedRetryAfter);
+
+        if (xmlrpc_strnomem(srvP->shedResponse)) {
+            xmlrpc_asprintf(errorP, "Unable to allocate memory for the "
+                            "overload response");
+            OverloadDestroy(srvP->overloadP);
+            srvP->overloadP = NULL;
+        }
     }
 }
 
@@ -968,9 +1647,26 @@ ServerInit2(TServer *     const serverP,
                                 "Failed to listen on bound socket.  %s",
                                 error);
                 xmlrpc_strfree(error);
-            } else {
-                srvP->readyToAccept = true;
+            } else if (usingMultipleAcceptors(srvP)) {
+                createExtraChanSwitches(srvP, &error);
+
+                if (error) {
+                    xmlrpc_asprintf(errorP, "Failed to set up %u acceptors.  "
+                                    "%s", srvP->acceptorCt, error);
+                    xmlrpc_strfree(error);
+                }
+            }
+            if (!*errorP && srvP->shedTargetMs > 0) {
+                createOverloadDetector(srvP, &error);
+
+                if (error) {
+                    xmlrpc_asprintf(errorP, "Failed to set up load "
+                                    "shedding.  %s", error);
+                    xmlrpc_strfree(error);
+                }
             }
+            if (!*errorP)
+                srvP->readyToAccept = true;
         }
     }
 }
@@ -1193,11 +1889,94 @@ destroyChannel(void * const userHandle) {
 
 
 static void
-processNewChannel(TServer *             const serverP,
-                  TChannel *            const channelP,
-                  void *                const channelInfoP,
-                  outstandingConnList * const outstandingConnListP,
-                  const char **         const errorP) {
+giveNewChannelToReactor(TServer *     const serverP,
+                        TReactor *    const reactorP,
+                        TChannel *    const channelP,
+                        void *        const channelInfoP,
+                        const char ** const errorP) {
+
+    struct _TServer * const srvP = serverP->srvP;
+
+    const char * error;
+
+    trace(&srvP->tracer, "Waiting for room in the reactor");
+
+    ReactorWaitForCapacity(reactorP, &error);
+
+    if (error) {
+        xmlrpc_asprintf(errorP, "Failed to wait for room in the reactor.  %s",
+                        error);
+        xmlrpc_strfree(error);
+    } else {
+        ReactorAddChannel(reactorP, channelP, channelInfoP, &error);
+
+        if (error) {
+            xmlrpc_asprintf(errorP, "Failed to give new connection to the "
+                            "reactor.  %s", error);
+            xmlrpc_strfree(error);
+        } else
+            *errorP = NULL;
+    }
+}
+
+
+
+static void
+giveNewChannelToPool(TServer *     const serverP,
+                     TConnPool **  const poolPP,
+                     TChannel *    const channelP,
+                     void *        const channelInfoP,
+                     const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Queue channel *channelP for a thread in connection pool **poolPP to
+   serve, waiting if the queue is full.
+
+   If there is no pool yet (*poolPP == NULL), create one.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = serverP->srvP;
+
+    const char * error;
+
+    if (!*poolPP) {
+        trace(&srvP->tracer, "Creating connection pool of %u threads "
+              "with a queue of %u", srvP->maxConn, srvP->connQueueDepth);
+
+        ConnPoolCreate(serverP, &serverFunc, &destroyChannel,
+                       srvP->maxConn, srvP->connQueueDepth,
+                       SERVER_FUNC_STACK + srvP->uriHandlerStackSize,
+                       poolPP, &error);
+
+        if (error) {
+            *poolPP = NULL;
+            xmlrpc_asprintf(errorP, "Failed to create connection pool.  %s",
+                            error);
+            xmlrpc_strfree(error);
+        } else
+            *errorP = NULL;
+    } else
+        *errorP = NULL;
+
+    if (!*errorP) {
+        trace(&srvP->tracer, "Waiting for room in the connection queue");
+
+        ConnPoolSubmit(*poolPP, channelP, channelInfoP, &error);
+
+        if (error) {
+            xmlrpc_asprintf(errorP, "Failed to queue new connection.  %s",
+                            error);
+            xmlrpc_strfree(error);
+        }
+    }
+}
+
+
+
+static void
+startConnectionThread(TServer *             const serverP,
+                      TChannel *            const channelP,
+                      void *                const channelInfoP,
+                      outstandingConnList * const outstandingConnListP,
+                      const char **         const errorP) {
 
     struct _TServer * const srvP = serverP->srvP;
 
@@ -1234,10 +2013,56 @@ processNewChannel(TServer *             const serverP,
 
 
 
+struct connDispatch {
+/*----------------------------------------------------------------------------
+   The means by which a server serves the connections it accepts.
+-----------------------------------------------------------------------------*/
+    TReactor * reactorP;
+        /* The reactor that holds idle connections, for an event-driven
+           server.  NULL if none.
+        */
+    TConnPool * poolP;
+        /* The pool of threads that serve connections.  NULL if there isn't
+           one (yet).
+        */
+    outstandingConnList * outstandingConnListP;
+        /* The connections that have threads of their own, where Abyss
+           threads are processes and therefore can't be pooled.
+        */
+};
+
+
+
+static void
+processNewChannel(TServer *             const serverP,
+                  TChannel *            const channelP,
+                  void *                const channelInfoP,
+                  struct connDispatch * const dispatchP,
+                  const char **         const errorP) {
+/*----------------------------------------------------------------------------
+   Start serving the client on newly accepted channel *channelP: give it to
+   the reactor if there is one and it can watch the channel; otherwise
+   queue it for the connection pool, or, where threads can't be pooled,
+   make a connection with its own thread.
+-----------------------------------------------------------------------------*/
+    if (dispatchP->reactorP && ReactorCanTakeChannel(channelP))
+        giveNewChannelToReactor(serverP, dispatchP->reactorP,
+                                channelP, channelInfoP, errorP);
+    else if (ConnPoolIsAvailable())
+        giveNewChannelToPool(serverP, &dispatchP->poolP,
+                             channelP, channelInfoP, errorP);
+    else
+        startConnectionThread(serverP, channelP, channelInfoP,
+                              dispatchP->outstandingConnListP, errorP);
+}
+
+
+
 static void
 acceptAndProcessNextConnection(
     TServer *             const serverP,
-    outstandingConnList * const outstandingConnListP,
+    TChanSwitch *         const chanSwitchP,
+    struct connDispatch * const dispatchP,
     const char **         const errorP) {
 
     struct _TServer * const srvP = serverP->srvP;
@@ -1249,9 +2074,8 @@ acceptAndProcessNextConnection(
     trace(&srvP->tracer, "Waiting for a new channel from channel switch");
 
     assert(srvP->readyToAccept);
-    assert(srvP->chanSwitchP);
 
-    ChanSwitchAccept(srvP->chanSwitchP, &channelP, &channelInfoP, &error);
+    ChanSwitchAccept(chanSwitchP, &channelP, &channelInfoP, &error);
 
     if (error) {
         xmlrpc_asprintf(errorP,
@@ -1264,8 +2088,10 @@ acceptAndProcessNextConnection(
 
             trace(&srvP->tracer, "Got a new channel from channel switch");
 
+            channelP->acceptTimeMs = xmlrpc_monotonic_ms();
+
             processNewChannel(serverP, channelP, channelInfoP,
-                              outstandingConnListP, &error);
+                              dispatchP, &error);
 
             if (error) {
                 xmlrpc_asprintf(errorP, "Failed to use new channel %lx",
@@ -1291,24 +2117,65 @@ acceptAndProcessNextConnection(
 
 
 static void
-serverRun2(TServer *     const serverP,
-           const char ** const errorP) {
-
+runAcceptor(TServer *     const serverP,
+            TChanSwitch * const chanSwitchP,
+            const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Accept connections from channel switch *chanSwitchP and serve them until
+   the server is told to terminate, then wait for those connections to
+   finish.
+-----------------------------------------------------------------------------*/
     struct _TServer * const srvP = serverP->srvP;
-    outstandingConnList * outstandingConnListP;
+    struct connDispatch dispatch;
+
+    createOutstandingConnList(&dispatch.outstandingConnListP);
 
-    createOutstandingConnList(&outstandingConnListP);
+    dispatch.poolP = NULL;  /* We create it when we first need it */
 
     *errorP = NULL;  /* initial value */
 
+    if (srvP->eventDriven && ReactorIsAvailable()) {
+        const char * error;
+
+        trace(&srvP->tracer, "Creating reactor with %u worker threads",
+              srvP->maxConn);
+
+        ReactorCreate(serverP, &processRequestFromReactor, srvP->maxConn,
+                      SERVER_FUNC_STACK + srvP->uriHandlerStackSize,
+                      &dispatch.reactorP, &error);
+
+        if (error) {
+            xmlrpc_asprintf(errorP, "Failed to create the reactor for "
+                            "event-driven operation.  %s", error);
+            xmlrpc_strfree(error);
+            dispatch.reactorP = NULL;
+        }
+    } else
+        dispatch.reactorP = NULL;
+
     trace(&srvP->tracer, "Starting main connection accepting loop");
 
     while (!srvP->terminationRequested && !*errorP)
-        acceptAndProcessNextConnection(serverP, outstandingConnListP, errorP);
+        acceptAndProcessNextConnection(serverP, chanSwitchP, &dispatch,
+                                       errorP);
 
     trace(&srvP->tracer, "Main connection accepting loop is done");
 
+    if (dispatch.reactorP) {
+        trace(&srvP->tracer, "Shutting down the reactor");
+
+        ReactorDestroy(dispatch.reactorP);
+    }
+    if (dispatch.poolP) {
+        trace(&srvP->tracer, "Shutting down the connection pool");
+
+        ConnPoolDestroy(dispatch.poolP);
+    }
+
     if (!*errorP) {
+        outstandingConnList * const outstandingConnListP =
+            dispatch.outstandingConnListP;
+
         trace(&srvP->tracer,
               "Interrupting and waiting for %u existing connections "
               "to finish",
@@ -1326,6 +2193,189 @@ serverRun2(TServer *     const serverP,
 
 
 
+static TPreforkServeFn serveChannelInWorker;
+
+static void
+serveChannelInWorker(TServer *      const serverP,
+                     TChannel *     const channelP,
+                     void *         const channelInfoP,
+                     unsigned int   const maxRequests,
+                     unsigned int * const requestCountP) {
+/*----------------------------------------------------------------------------
+   Serve the connection on channel *channelP, in a worker process, in the
+   foreground, but do no more than 'maxRequests' requests.  Destroy the
+   channel when done.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = serverP->srvP;
+
+    TConn * connectionP;
+    const char * error;
+
+    ConnCreate(&connectionP, serverP, channelP, channelInfoP,
+               &serverFunc, SERVER_FUNC_STACK + srvP->uriHandlerStackSize,
+               NULL, ABYSS_FOREGROUND, false, &error);
+
+    if (error) {
+        TraceMsg("Failed to create an Abyss connection.  %s", error);
+        xmlrpc_strfree(error);
+        *requestCountP = 0;
+    } else {
+        /* We serve the requests directly rather than with ConnProcess()
+           in order to limit and count them.
+        */
+        serveRequests(connectionP,
+                      MIN(srvP->keepalivemaxconn, maxRequests),
+                      requestCountP);
+
+        ConnWaitAndRelease(connectionP);
+    }
+    ChannelDestroy(channelP);
+    free(channelInfoP);
+}
+
+
+
+/* This is the maximum amount of stack an acceptor thread uses.  The
+   connections it accepts have threads of their own.
+*/
+#define ACCEPTOR_STACK 1024
+
+struct acceptor {
+    TServer *     serverP;
+    TChanSwitch * chanSwitchP;
+    unsigned int  index;
+    TThread *     threadP;
+    const char *  error;
+        /* Why the acceptor failed; NULL if it didn't */
+};
+
+
+
+static TThreadProc acceptorFunc;
+
+static void
+acceptorFunc(void * const userHandle) {
+
+    struct acceptor * const acceptorP = userHandle;
+    TServer *         const serverP   = acceptorP->serverP;
+    struct _TServer * const srvP      = serverP->srvP;
+
+    if (srvP->pinAcceptors) {
+        if (!ThreadPinToCpu(acceptorP->index))
+            trace(&srvP->tracer, "Could not pin acceptor %u to a CPU",
+                  acceptorP->index);
+    }
+    runAcceptor(serverP, acceptorP->chanSwitchP, &acceptorP->error);
+
+    if (acceptorP->error) {
+        /* Same as with a single acceptor: the server is done */
+        ServerTerminate(serverP);
+    }
+}
+
+
+
+static TThreadDoneFn acceptorDone;
+
+static void
+acceptorDone(void * const userHandle ATTR_UNUSED) {
+
+}
+
+
+
+static void
+runAcceptors(TServer *     const serverP,
+             const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Run each of the server's acceptors in a thread of its own, until the
+   server is told to terminate and they have all finished.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = serverP->srvP;
+    unsigned int const acceptorCt = 1 + srvP->extraChanSwitchCt;
+
+    struct acceptor * acceptors;
+
+    MALLOCARRAY(acceptors, acceptorCt);
+
+    if (acceptors == NULL)
+        xmlrpc_asprintf(errorP, "Could not allocate memory for %u "
+                        "acceptor descriptors", acceptorCt);
+    else {
+        unsigned int startedCt;
+        unsigned int i;
+
+        trace(&srvP->tracer, "Starting %u acceptor threads", acceptorCt);
+
+        for (startedCt = 0, *errorP = NULL;
+             startedCt < acceptorCt && !*errorP;
+            ) {
+            struct acceptor * const acceptorP = &acceptors[startedCt];
+
+            const char * error;
+
+            acceptorP->serverP     = serverP;
+            acceptorP->chanSwitchP = startedCt == 0 ?
+                srvP->chanSwitchP : srvP->extraChanSwitches[startedCt-1];
+            acceptorP->index       = startedCt;
+            acceptorP->error       = NULL;
+
+            ThreadCreate(&acceptorP->threadP, acceptorP,
+                         &acceptorFunc, &acceptorDone, false,
+                         ACCEPTOR_STACK, &error);
+
+            if (error) {
+                xmlrpc_asprintf(errorP, "Failed to create thread for "
+                                "acceptor %u.  %s", startedCt, error);
+                xmlrpc_strfree(error);
+
+                /* Stop the acceptors we already started */
+                ServerTerminate(serverP);
+            } else {
+                ThreadRun(acceptorP->threadP);
+                ++startedCt;
+            }
+        }
+        for (i = 0; i < startedCt; ++i) {
+            struct acceptor * const acceptorP = &acceptors[i];
+
+            ThreadWaitAndRelease(acceptorP->threadP);
+
+            if (acceptorP->error) {
+                if (!*errorP)
+                    xmlrpc_asprintf(errorP, "Acceptor %u failed.  %s",
+                                    i, acceptorP->error);
+                xmlrpc_strfree(acceptorP->error);
+            }
+        }
+        trace(&srvP->tracer, "All acceptor threads are done");
+
+        free(acceptors);
+    }
+}
+
+
+
+static void
+serverRun2(TServer *     const serverP,
+           const char ** const errorP) {
+
+    struct _TServer * const srvP = serverP->srvP;
+
+    if (usingPrefork(srvP)) {
+        trace(&srvP->tracer, "Serving with %u to %u worker processes",
+              srvP->preforkMinWorkers, srvP->preforkMaxWorkers);
+
+        PreforkRun(serverP, srvP->chanSwitchP, &serveChannelInWorker,
+                   errorP);
+    } else if (srvP->extraChanSwitchCt > 0)
+        runAcceptors(serverP, errorP);
+    else
+        runAcceptor(serverP, srvP->chanSwitchP, errorP);
+}
+
+
+
 void
 ServerRun(TServer * const serverP) {
 
@@ -1776,24 +2826,39 @@ LogWrite(TServer *    const serverP,
 
     struct _TServer * const srvP = serverP->srvP;
 
-    if (!srvP->logfileisopen && srvP->logfilename) {
-        const char * error;
-        logOpen(srvP, &error);
+    TAccessLog * accessLogP;
 
-        if (error) {
-            TraceMsg("Failed to open log file.  %s", error);
+    accessLogP = xmlrpc_atomicLoadPtr((void * volatile *)&srvP->accessLogP);
 
-            xmlrpc_strfree(error);
-        }
-    }
-    if (srvP->logfileisopen) {
-        const char * const lbr = "\n";
+    if (!accessLogP && srvP->logfilename) {
         srvP->logLockP->acquire(srvP->logLockP);
-        FileWrite(srvP->logfileP, msg, strlen(msg));
-        FileWrite(srvP->logfileP, lbr, strlen(lbr));
 
+        if (!srvP->logfileisopen) {
+            const char * error;
+            logOpen(srvP, &error);
+
+            if (error) {
+                TraceMsg("Failed to open log file.  %s", error);
+
+                xmlrpc_strfree(error);
+            }
+        }
+        accessLogP = srvP->accessLogP;
+
+        if (srvP->logfileisopen && !accessLogP) {
+            TFileSegment segment[2];
+
+            segment[0].base = msg;
+            segment[0].len  = strlen(msg);
+            segment[1].base = "\n";
+            segment[1].len  = 1;
+
+            FileWriteSegments(srvP->logfileP, segment, ARRAY_SIZE(segment));
+        }
         srvP->logLockP->release(srvP->logLockP);
     }
+    if (accessLogP)
+        AccessLogWrite(accessLogP, msg);
 }
 /*******************************************************************************
 **
@@ -41,6 +41,22 @@ struct _TServer {
     bool logfileisopen;
     struct TFile * logfileP;
     struct lock * logLockP;
+        /* Protects opening the log file and, when we write it
+           synchronously, writing it.
+        */
+    uint32_t logBufferSize;
+        /* Size of each thread's buffer for writing the log file
+           asynchronously (see accesslog.h).  Zero means write it
+           synchronously.
+        */
+    bool logDropWhenFull;
+        /* A thread whose log buffer is full drops the line instead of
+           waiting for room.
+        */
+    struct accessLog * accessLogP;
+        /* The asynchronous log writer.  NULL if we write the log file
+           synchronously or haven't opened it yet.
+        */
     const char * name;
     bool serverAcceptsConnections;
         /* We listen for and accept TCP connections for HTTP transactions.
@@ -65,6 +81,14 @@ struct _TServer {
         /* Maximum number of connections the server allows to exist (i.e.
            HTTP transactions in progress) at once.  Server will not accept
            a connection if it already has this many.
+
+           Where threads are pooled, this is the number of threads in the
+           connection pool.
+        */
+    uint32_t connQueueDepth;
+        /* Where threads are pooled, the maximum number of accepted
+           connections that may wait for a free thread.  Server will not
+           accept a connection while this many are waiting.
         */
     uint32_t maxConnBacklog;
         /* Maximum number of connections the server allows the OS to queue
@@ -107,6 +131,51 @@ struct _TServer {
            be aware of SIGCHLD and will instead poll for existence of PIDs
            to determine if a child has died.
         */
+    bool eventDriven;
+        /* Serve connections with a reactor (see reactor.h) rather than a
+           thread per connection, where that's possible.
+        */
+    uint32_t acceptorCt;
+        /* Number of threads that accept connections, each from its own
+           listening socket at the server's address, where that's possible.
+           Each has its own connections and its own threads to serve them.
+        */
+    bool pinAcceptors;
+        /* Restrict each acceptor thread, and the threads that serve its
+           connections, to a CPU of its own.
+        */
+    TChanSwitch ** extraChanSwitches;
+        /* The channel switches for the acceptors other than the first one,
+           which uses 'chanSwitchP'.  Array of 'extraChanSwitchCt'.  We
+           create these in ServerInit2().
+        */
+    unsigned int extraChanSwitchCt;
+    uint32_t preforkMinWorkers;
+    uint32_t preforkMaxWorkers;
+        /* Serve connections with between 'preforkMinWorkers' and
+           'preforkMaxWorkers' pre-forked worker processes (see prefork.h),
+           where that's possible.  'preforkMaxWorkers' zero means don't.
+        */
+    uint32_t preforkMaxRequests;
+        /* Number of requests a worker process serves before it exits and
+           the server replaces it.  Zero means no limit.
+        */
+    uint32_t shedTargetMs;
+    uint32_t shedIntervalMs;
+        /* Refuse connections that wait too long for a thread to serve them,
+           as decided by an overload detector (see overload.h) with this
+           target and interval.  'shedTargetMs' zero means don't.
+        */
+    uint32_t shedRetryAfter;
+        /* Seconds we tell a refused client to wait before it retries */
+    struct overload * overloadP;
+        /* The overload detector.  NULL if we don't shed load.  We create it
+           in ServerInit2().
+        */
+    const char * shedResponse;
+        /* The whole HTTP response with which we refuse a connection.
+           Meaningful only if 'overloadP' is non-null.
+        */
     size_t uriHandlerStackSize;
         /* The maximum amount of stack any URI handler request handler
            function will use.  Note that this is just the requirement
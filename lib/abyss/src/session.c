@@ -6,12 +6,16 @@
 #include <ctype.h>
 
 #include "bool.h"
+#include "c_util.h"
+#include "atomic.h"
 #include "xmlrpc-c/util_int.h"
 #include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/time_int.h"
 #include "xmlrpc-c/abyss.h"
 #include "server.h"
 #include "http.h"
 #include "conn.h"
+#include "channel.h"
 
 #include "session.h"
 
@@ -101,8 +105,13 @@ SessionRefillBuffer(TSession * const sessionP) {
 size_t
 SessionReadDataAvail(TSession * const sessionP) {
 
-    return sessionP->connP->buffersize - sessionP->connP->bufferpos;
+    size_t const bufferedCt =
+        sessionP->connP->buffersize - sessionP->connP->bufferpos;
 
+    /* Past the end of an unchunked body is the next request */
+    return !sessionP->requestIsChunked &&
+        sessionP->unchunkedState.lengthIsKnown ?
+        MIN(bufferedCt, sessionP->unchunkedState.bytesLeftCt) : bufferedCt;
 }
 
 
@@ -457,15 +466,25 @@ getSomeUnchunkedRequestBody(TSession *    const sessionP,
 -----------------------------------------------------------------------------*/
     uint32_t const bufferPos = sessionP->connP->bufferpos;
 
+    /* Anything in the buffer past the end of the body is the next request,
+       which the client has pipelined.
+    */
+    size_t const bodyMax =
+        sessionP->unchunkedState.lengthIsKnown ?
+        MIN(max, sessionP->unchunkedState.bytesLeftCt) : max;
+
     *outStartP = &sessionP->connP->buffer.t[bufferPos];
 
     assert(bufferPos <= sessionP->connP->buffersize);
 
-    *outLenP = MIN(max, sessionP->connP->buffersize - bufferPos);
+    *outLenP = MIN(bodyMax, sessionP->connP->buffersize - bufferPos);
 
     /* move pointer past the bytes we are returning */
     sessionP->connP->bufferpos += *outLenP;
 
+    if (sessionP->unchunkedState.lengthIsKnown)
+        sessionP->unchunkedState.bytesLeftCt -= *outLenP;
+
     assert(sessionP->connP->bufferpos <= sessionP->connP->buffersize);
 }
 
@@ -559,6 +578,204 @@ SessionGetBody(TSession *    const sessionP,
 
 
 
+static void
+readChunkedBody(TSession *    const sessionP,
+                size_t        const len,
+                char *        const buffer,
+                const char ** const errorP) {
+
+    size_t bytesRead;
+
+    for (bytesRead = 0, *errorP = NULL; bytesRead < len && !*errorP; ) {
+        const char * chunkStart;
+        size_t chunkLen;
+        abyss_bool eof;
+
+        SessionGetBody(sessionP, len - bytesRead, &eof,
+                       &chunkStart, &chunkLen, errorP);
+
+        if (!*errorP) {
+            if (eof)
+                xmlrpc_asprintf(errorP, "Request body ends after %lu "
+                                "bytes; expected %lu",
+                                (unsigned long)bytesRead, (unsigned long)len);
+            else {
+                memcpy(&buffer[bytesRead], chunkStart, chunkLen);
+                bytesRead += chunkLen;
+            }
+        }
+    }
+}
+
+
+
+static void
+readUnchunkedBody(TSession *    const sessionP,
+                  size_t        const len,
+                  char *        const buffer,
+                  const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Take whatever of the body is already in the connection buffer, then read
+   the rest directly from the channel into 'buffer'.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = sessionP->connP->server->srvP;
+
+    const char * bufferedStart;
+    size_t bufferedLen;
+
+    getSomeUnchunkedRequestBody(sessionP, len, &bufferedStart, &bufferedLen);
+
+    memcpy(buffer, bufferedStart, bufferedLen);
+
+    *errorP = NULL;  /* initial assumption */
+
+    if (bufferedLen < len) {
+        if (sessionP->continueRequired) {
+            bool succeeded;
+            succeeded = HTTPWriteContinue(sessionP);
+            if (!succeeded)
+                xmlrpc_asprintf(errorP, "Failed to send a Continue header "
+                                "to the client to tell it to go ahead with "
+                                "sending the body");
+            sessionP->continueRequired = false;
+        }
+        if (!*errorP) {
+            const char * error;
+
+            ConnReadDirect(sessionP->connP, srvP->timeout,
+                           &buffer[bufferedLen], len - bufferedLen, &error);
+
+            if (error) {
+                xmlrpc_asprintf(errorP, "Failed to get more data from "
+                                "the client.  %s", error);
+                xmlrpc_strfree(error);
+            } else if (sessionP->unchunkedState.lengthIsKnown)
+                sessionP->unchunkedState.bytesLeftCt -= len - bufferedLen;
+        }
+    }
+}
+
+
+
+void
+SessionReadBody(TSession *    const sessionP,
+                size_t        const len,
+                char *        const buffer,
+                const char ** const errorP) {
+/*-----------------------------------------------------------------------------
+   Read the next 'len' bytes of the HTTP request body into 'buffer', waiting
+   for them as necessary.
+
+   This is for a handler that knows the size of the body, e.g. from a
+   Content-Length header, and has a buffer that size.  Unless the body is
+   chunked, we read it from the channel straight into 'buffer', which takes
+   fewer system calls and copies than getting it a connection bufferful at
+   a time with SessionGetBody().
+
+   Fail if the body ends before 'len' bytes.
+
+   Assume the session has already received and processed the HTTP header.
+-----------------------------------------------------------------------------*/
+    if (sessionP->failureReason)
+        xmlrpc_asprintf(errorP, "The session has previously failed: %s",
+                        sessionP->failureReason);
+    else {
+        if (sessionP->requestIsChunked)
+            readChunkedBody(sessionP, len, buffer, errorP);
+        else if (sessionP->unchunkedState.lengthIsKnown &&
+                 len > sessionP->unchunkedState.bytesLeftCt)
+            xmlrpc_asprintf(errorP, "Request body has only %lu more bytes; "
+                            "%lu requested",
+                            (unsigned long)
+                            sessionP->unchunkedState.bytesLeftCt,
+                            (unsigned long)len);
+        else
+            readUnchunkedBody(sessionP, len, buffer, errorP);
+
+        if (*errorP && !sessionP->failureReason)
+            sessionP->failureReason = xmlrpc_strdupsol(*errorP);
+    }
+}
+
+
+
+bool
+SessionNextRequestIsBuffered(TSession * const sessionP) {
+/*----------------------------------------------------------------------------
+   The connection buffer contains, after the rest of this session's request
+   body, at least the start of another request: the client has pipelined
+   requests.
+
+   If we can't tell where the body ends without reading it (it is chunked),
+   we say no.
+-----------------------------------------------------------------------------*/
+    TConn * const connectionP = sessionP->connP;
+
+    uint32_t const bufferedCt =
+        connectionP->buffersize - connectionP->bufferpos;
+
+    bool retval;
+
+    if (sessionP->requestIsChunked)
+        retval = false;
+    else if (sessionP->unchunkedState.lengthIsKnown)
+        retval = bufferedCt > sessionP->unchunkedState.bytesLeftCt;
+    else
+        retval = bufferedCt > 0;
+
+    return retval;
+}
+
+
+
+void
+SessionSkipUnreadBody(TSession * const sessionP,
+                      bool *     const skippedP) {
+/*----------------------------------------------------------------------------
+   Discard whatever of the request body the handler did not read, as far as
+   it is already in the connection buffer, so the connection is positioned
+   at the next request.
+
+   Return *skippedP true iff we were able to do that, i.e. the rest of the
+   body was all in the buffer.  If not, the connection is unusable for
+   further requests.
+
+   A request with neither a Content-Length nor a chunked body has no body
+   (RFC 7230 Section 3.3.3).
+-----------------------------------------------------------------------------*/
+    if (!sessionP->validRequest)
+        *skippedP = false;
+    else if (sessionP->requestIsChunked) {
+        abyss_bool eof;
+        size_t outLen;
+        const char * error;
+
+        do {
+            const char * outStart;
+
+            getSomeChunkedRequestBody(sessionP, BUFFER_SIZE, &eof,
+                                      &outStart, &outLen, &error);
+        } while (!error && !eof && outLen > 0);
+
+        if (error) {
+            xmlrpc_strfree(error);
+            *skippedP = false;
+        } else
+            *skippedP = eof;
+    } else if (sessionP->unchunkedState.lengthIsKnown) {
+        const char * outStart;
+        size_t outLen;
+
+        getSomeUnchunkedRequestBody(sessionP, BUFFER_SIZE,
+                                    &outStart, &outLen);
+
+        *skippedP = (sessionP->unchunkedState.bytesLeftCt == 0);
+    } else
+        *skippedP = true;
+}
+
+
+
 void
 SessionGetRequestInfo(TSession *            const sessionP,
                       const TRequestInfo ** const requestInfoPP) {
@@ -577,6 +794,57 @@ SessionGetChannelInfo(TSession * const sessionP,
 
 
 
+abyss_bool
+SessionClientGone(TSession * const sessionP) {
+/*----------------------------------------------------------------------------
+   The client has closed the connection, so nothing we send in response to
+   the request will reach it.  A handler doing lengthy work for the request
+   can ask this now and then and give up when it's true.
+
+   We ask the OS each time, without waiting, so it's cheap but not free.
+   Any thread may ask, as long as the session exists.  Where the channel
+   can't tell (e.g. Windows), the answer is always false.
+
+   This is only advice: a client that has sent its whole request may shut
+   down just its sending side and still wait for the response, and we can't
+   tell that from a client that has closed the connection.  So true means
+   the client may well be gone, not that it surely is.
+-----------------------------------------------------------------------------*/
+    return ChannelPeerHungUp(sessionP->connP->channelP);
+}
+
+
+
+uint32_t
+SessionGetAgeMs(TSession * const sessionP) {
+/*----------------------------------------------------------------------------
+   How many milliseconds ago the request arrived.  For the first request on
+   a connection, that includes the time the connection waited in the
+   server's queue, so a handler can tell how much of a client's patience is
+   already used up.
+-----------------------------------------------------------------------------*/
+    uint64_t const nowMs = xmlrpc_monotonic_ms();
+
+    return nowMs > sessionP->arrivalTimeMs ?
+        (uint32_t)MIN(nowMs - sessionP->arrivalTimeMs, 0xffffffff) : 0;
+}
+
+
+
+void
+SessionGetHttpVersion(TSession *     const sessionP,
+                      unsigned int * const majorP,
+                      unsigned int * const minorP) {
+/*----------------------------------------------------------------------------
+   The HTTP version of the client's request, which limits what we may use
+   in the response (e.g. chunked transfer encoding needs 1.1).
+-----------------------------------------------------------------------------*/
+    *majorP = sessionP->version.major;
+    *minorP = sessionP->version.minor;
+}
+
+
+
 abyss_bool
 SessionLog(TSession * const sessionP) {
 
@@ -638,6 +906,12 @@ SessionInit(TSession * const sessionP,
 
     time(&sessionP->date);
 
+    if (connectionP->channelP->acceptTimeMs != 0) {
+        sessionP->arrivalTimeMs = connectionP->channelP->acceptTimeMs;
+        connectionP->channelP->acceptTimeMs = 0;
+    } else
+        sessionP->arrivalTimeMs = xmlrpc_monotonic_ms();
+
     sessionP->connP = connectionP;
 
     sessionP->responseStarted = false;
@@ -651,75 +925,121 @@ SessionInit(TSession * const sessionP,
 
     sessionP->chunkState.position = CHUNK_ATHEADER;
 
-    sessionP->memPoolP = NULL;
-
-    ListInit(&sessionP->cookies);
-    ListInit(&sessionP->ranges);
-    TableInit(&sessionP->requestHeaderFields);
-    TableInit(&sessionP->responseHeaderFields);
+    sessionP->unchunkedState.lengthIsKnown = false;
 
-    sessionP->status = 0;  /* No status from handler yet */
+    sessionP->poolP = &connectionP->sessionPool;
 
-    StringAlloc(&(sessionP->header));
-}
+    PoolSetLimit(sessionP->poolP, connectionP->server->srvP->maxSessionMem);
 
+    ListInitAutoFree(&sessionP->cookies);
+    ListInitAutoFree(&sessionP->ranges);
+    TableInitPool(&sessionP->requestHeaderFields, sessionP->poolP);
+    TableInitPool(&sessionP->responseHeaderFields, sessionP->poolP);
 
+    {
+        unsigned int i;
+        for (i = 0; i < ARRAY_SIZE(sessionP->knownFieldValue); ++i)
+            sessionP->knownFieldValue[i] = NULL;
+    }
 
-static void
-freeRequestInfo(TRequestInfo * const requestInfoP) {
-
-    xmlrpc_strfreenull(requestInfoP->host);
-
-    xmlrpc_strfreenull(requestInfoP->user);
+    sessionP->status = 0;  /* No status from handler yet */
 
-    xmlrpc_strfree(requestInfoP->uri);
+    sessionP->finishDeferred   = NULL;
+    sessionP->responseDeferred = false;
 
-    xmlrpc_strfree(requestInfoP->requestline);
+    StringAlloc(&(sessionP->header));
 }
 
 
 
 void
 SessionTerm(TSession * const sessionP) {
-
-    if (sessionP->validRequest)
-        freeRequestInfo(&sessionP->requestInfo);
-
+/*----------------------------------------------------------------------------
+   This frees everything the session got from its memory pool, e.g. the
+   strings in its request info.
+-----------------------------------------------------------------------------*/
     ListFree(&sessionP->cookies);
     ListFree(&sessionP->ranges);
     TableFree(&sessionP->requestHeaderFields);
     TableFree(&sessionP->responseHeaderFields);
     StringFree(&(sessionP->header));
 
-    if (sessionP->memPoolP)
-        xmlrpc_mem_pool_free(sessionP->memPoolP);
+    PoolReset(sessionP->poolP);
 }
 
 
 
 void
-SessionMakeMemPool(TSession *    const sessionP,
-                   size_t        const size,
-                   const char ** const errorP) {
+SessionDeferResponse(TSession *   const sessionP,
+                     abyss_bool * const deferredP) {
 /*----------------------------------------------------------------------------
-  Set up a memory pool for this session.  All future allocations of memory
-  for certain purposes will come from this pool.
+   Arrange for the handler to be able to return before it has responded to
+   the request.  The handler (or anything else it gives the session to) then
+   writes the response in the usual way, from any thread, and calls
+   SessionFinishDeferred() when it is done.  Abyss holds the connection
+   meanwhile, without tying up a thread.
+
+   Return *deferredP false if the server can't hold a connection without a
+   thread, in which case the handler must respond before returning, as
+   usual.  Only an event-driven server can.
+-----------------------------------------------------------------------------*/
+    assert(!sessionP->responseDeferred);
+
+    if (sessionP->finishDeferred) {
+        sessionP->responseDeferred  = true;
+        sessionP->deferralPartsLeft = 2;
+
+        *deferredP = true;
+    } else
+        *deferredP = false;
+}
+
 
-  The point of this is that the pool has limited size, so this puts a limit
-  on how much memory the session can use.
+
+void
+SessionFinishDeferred(TSession * const sessionP) {
+/*----------------------------------------------------------------------------
+   Finish the deferred response to the request of session *sessionP.  The
+   session ends, if not now then when the handler returns, so Caller must
+   not use it any more.
 -----------------------------------------------------------------------------*/
-    xmlrpc_env env;
+    assert(sessionP->responseDeferred);
+
+    if (xmlrpc_atomicDecrement(&sessionP->deferralPartsLeft) == 0)
+        sessionP->finishDeferred(sessionP);
+}
+
 
-    xmlrpc_env_init(&env);
 
-    sessionP->memPoolP = xmlrpc_mem_pool_new(&env, size);
+void
+SessionHandlerReturned(TSession * const sessionP,
+                       bool *     const stillDeferredP) {
+/*----------------------------------------------------------------------------
+   The handler has returned from processing the request of session
+   *sessionP.
 
-    if (env.fault_occurred)
-        *errorP = xmlrpc_strdupsol(env.fault_string);
+   Return *stillDeferredP true iff the handler deferred the response and
+   it isn't done yet, in which case the session belongs to whoever
+   finishes it and Caller must not touch it.  Otherwise, Caller finishes
+   the request in the usual way.
+-----------------------------------------------------------------------------*/
+    if (sessionP->responseDeferred)
+        *stillDeferredP =
+            xmlrpc_atomicDecrement(&sessionP->deferralPartsLeft) > 0;
     else
-        *errorP = NULL;
+        *stillDeferredP = false;
+}
 
-    xmlrpc_env_clean(&env);
+
+
+const char *
+SessionStrdup(TSession *   const sessionP,
+              const char * const string) {
+/*----------------------------------------------------------------------------
+   Like strdup(), but the copy lasts until the end of the session and comes
+   from the session's memory pool.  NULL if we can't get the memory.
+-----------------------------------------------------------------------------*/
+    return PoolStrdup(sessionP->poolP, string);
 }
 
 
@@ -7,12 +7,15 @@
 #include "date.h"
 #include "data.h"
 #include "conn.h"
+#include "http.h"
 
 typedef struct {
     uint8_t major;
     uint8_t minor;
 } httpVersion;
 
+typedef void TSessionFinishFn(TSession * const sessionP);
+
 typedef enum {
     /* This tells what is supposed to be at the current read position
        in the connection buffer.
@@ -30,15 +33,14 @@ struct _TSession {
            reads the request from the client and finds it to be valid HTTP,
            it becomes true.
         */
-    xmlrpc_mem_pool * memPoolP;
-        /* The memory pool from which various memory needed for our processing
-           comes.  We don't allocate all memory from here; just parts that
-           have unpredictable size that might allow a client to get more than
-           its share of system meomry if we didn't limit it.  This pool has a
-           limited size.
-
-           NULL means all memory comes from the general system pool and there
-           is therefore no protection of clients from each other.
+    TPool * poolP;
+        /* The memory pool from which most memory for the request and
+           response comes: the request header fields, the pieces of the URI,
+           the response header fields, and more.  It belongs to the
+           connection, which resets it after the session, so none of it
+           survives the session.  The pool refuses to give the session more
+           than the server's session memory limit, so a client can't get
+           more than its share of system memory.
         */
     const char * failureReason;
         /* This is non-null to indicate that we have encountered a protocol
@@ -84,6 +86,12 @@ struct _TSession {
            the field.
         */
 
+    const char * knownFieldValue[HTTPFIELD_OTHER];
+        /* Value of the first field of each kind we know, indexed by
+           HttpField; NULL if the request has no such field.  This points
+           to the value in 'requestHeaderFields'.
+        */
+
     TTable responseHeaderFields;
         /* All the fields of the header of the HTTP response.
            This gets successively computed; at any moment, it is the list of
@@ -100,6 +108,13 @@ struct _TSession {
 
     time_t date;
 
+    uint64_t arrivalTimeMs;
+        /* When the request arrived, as xmlrpc_monotonic_ms() tells time.
+           For the first request on a connection, this is when the server
+           accepted the connection, so it includes any time the connection
+           waited for a thread.
+        */
+
     bool chunkedwrite;
     bool chunkedwritemode;
 
@@ -123,6 +138,41 @@ struct _TSession {
                Meaningful only when 'position' is INCHUNK.
             */
     } chunkState;
+
+    struct {
+        /* Meaningful only when 'requestIsChunked' is false */
+
+        bool lengthIsKnown;
+            /* The request header has a valid Content-Length field */
+
+        uint64_t bytesLeftCt;
+            /* Number of bytes of the body we have not yet delivered to the
+               handler.  Anything after that on the connection is the next
+               request.
+
+               Meaningful only when 'lengthIsKnown' is true.
+            */
+    } unchunkedState;
+
+    TSessionFinishFn * finishDeferred;
+        /* The function that finishes the request after the handler has
+           deferred the response and both the handler has returned and the
+           response is done.  It ends the session.  NULL means the handler
+           can't defer the response, because the connection can't wait
+           for it without a thread.
+        */
+    void * finishDeferredArg;
+        /* For use by 'finishDeferred' */
+    bool responseDeferred;
+        /* The handler has deferred the response with
+           SessionDeferResponse().
+        */
+    long volatile deferralPartsLeft;
+        /* Of the two things that must happen before we can finish a
+           deferred response -- the handler returns and someone calls
+           SessionFinishDeferred() -- the number that haven't yet.
+           Meaningful only if 'responseDeferred' is true.
+        */
 };
 
 /*----------------------------------------------------------------------------
@@ -139,8 +189,18 @@ void
 SessionTerm(TSession * const sessionP);
 
 void
-SessionMakeMemPool(TSession *    const sessionP,
-                   size_t        const size,
-                   const char ** const errorP);
+SessionHandlerReturned(TSession * const sessionP,
+                       bool *     const stillDeferredP);
+
+bool
+SessionNextRequestIsBuffered(TSession * const sessionP);
+
+void
+SessionSkipUnreadBody(TSession * const sessionP,
+                      bool *     const skippedP);
+
+const char *
+SessionStrdup(TSession *   const sessionP,
+              const char * const string);
 
 #endif
@@ -42,16 +42,19 @@ initRequestInfo(TRequestInfo * const requestInfoP,
   Set up the request info structure.  For information that is
   controlled by the header, use the defaults -- I.e. the value that
   applies if the request contains no applicable header field.
+
+  The strings must last as long as the session, e.g. by being in the
+  session's memory pool; we don't copy them.
 -----------------------------------------------------------------------------*/
     XMLRPC_ASSERT_PTR_OK(requestLine);
     XMLRPC_ASSERT_PTR_OK(path);
 
-    requestInfoP->requestline = xmlrpc_strdupsol(requestLine);
+    requestInfoP->requestline = requestLine;
     requestInfoP->method      = httpMethod;
-    requestInfoP->host        = xmlrpc_strdupnull(host);
+    requestInfoP->host        = host;
     requestInfoP->port        = port;
-    requestInfoP->uri         = strdup(path);
-    requestInfoP->query       = xmlrpc_strdupnull(query);
+    requestInfoP->uri         = path;
+    requestInfoP->query       = query;
     requestInfoP->from        = NULL;
     requestInfoP->useragent   = NULL;
     requestInfoP->referer     = NULL;
@@ -74,18 +77,16 @@ firstLfPos(TConn * const connectionP,
    LF (linefeed aka newline) character in the buffer at or after 'lineStart'.
 
    If there is no LF in the buffer at or after 'lineStart', return NULL.
+
+   We use memchr() because the C library does it many bytes at a time
+   (with SIMD instructions where the machine has them).
 -----------------------------------------------------------------------------*/
     const char * const bufferEnd =
         connectionP->buffer.t + connectionP->buffersize;
 
-    char * p;
-
-    for (p = lineStart; p < bufferEnd && *p != '\n'; ++p);
+    assert(lineStart <= bufferEnd);
 
-    if (p < bufferEnd)
-        return p;
-    else
-        return NULL;
+    return memchr(lineStart, '\n', bufferEnd - lineStart);
 }
 
 
@@ -106,19 +107,27 @@ getLineInBuffer(TConn *       const connectionP,
    one by 'deadline'.
 -----------------------------------------------------------------------------*/
     char * lfPos;
+    char * scanStart;
+        /* Where in the buffer to look for LF.  There is none before this
+           in the line.
+        */
     bool timedOut;
 
     assert(lineStart <= connectionP->buffer.t + connectionP->buffersize);
 
-    for (*errorP = NULL, lfPos = NULL, timedOut = false;
+    for (*errorP = NULL, lfPos = NULL, timedOut = false,
+             scanStart = lineStart;
          !*errorP && !lfPos && !timedOut;
         ) {
         int const timeLeft = (int)(deadline - time(NULL));
         if (timeLeft <= 0)
             timedOut = true;
         else {
-            lfPos = firstLfPos(connectionP, lineStart);
+            lfPos = firstLfPos(connectionP, scanStart);
             if (!lfPos) {
+                /* No need to look again at what we just looked at */
+                scanStart = connectionP->buffer.t + connectionP->buffersize;
+
                 if (ConnBufferSpace(connectionP) < 1)
                     xmlrpc_asprintf(errorP, "HTTP request header does not "
                                     "fit in the server's connection buffer.");
@@ -508,7 +517,8 @@ parsePerCentEscape(const char ** const srcP,
 
 
 static void
-unescapeUri(const char *  const uriComponent,
+unescapeUri(TPool *       const poolP,
+            const char *  const uriComponent,
             const char ** const unescapedP,
             const char ** const errorP) {
 /*----------------------------------------------------------------------------
@@ -516,11 +526,11 @@ unescapeUri(const char *  const uriComponent,
    have %HH encoding, especially of characters that are delimiters within
    a URI like slash and colon.
 
-   Return the unescaped version as *unescapedP in newly malloced storage.
+   Return the unescaped version as *unescapedP in memory from pool *poolP.
 -----------------------------------------------------------------------------*/
     char * buffer;
 
-    buffer = strdup(uriComponent);
+    buffer = (char *)PoolStrdup(poolP, uriComponent);
 
     if (!buffer)
         xmlrpc_asprintf(errorP, "Couldn't get memory for URI unescape buffer");
@@ -556,9 +566,7 @@ unescapeUri(const char *  const uriComponent,
         }
         *dst = '\0';
 
-        if (*errorP)
-            xmlrpc_strfree(buffer);
-        else
+        if (!*errorP)
             *unescapedP = buffer;
     }
 }
@@ -566,21 +574,22 @@ unescapeUri(const char *  const uriComponent,
 
 
 static void
-parseHostPort(const char *     const hostport,
+parseHostPort(TPool *          const poolP,
+              const char *     const hostport,
               const char **    const hostP,
               unsigned short * const portP,
               const char **    const errorP) {
 /*----------------------------------------------------------------------------
    Parse a 'hostport', a string in the form www.acme.com:8080 .
 
-   Return the host name part (www.acme.com) as *hostP (in newly
-   malloced storage), and the port part (8080) as *portP.
+   Return the host name part (www.acme.com) as *hostP (in memory from pool
+   *poolP), and the port part (8080) as *portP.
 
    Default the port to 80 if 'hostport' doesn't have the port part.
 -----------------------------------------------------------------------------*/
     char * buffer;
 
-    buffer = strdup(hostport);
+    buffer = (char *)PoolStrdup(poolP, hostport);
 
     if (!buffer)
         xmlrpc_asprintf(errorP, "Couldn't get memory for host/port buffer");
@@ -607,33 +616,34 @@ parseHostPort(const char *     const hostport,
                                 "non-numeric for the port number after the "
                                 "colon in '%s'", hostport);
             } else {
-                *hostP = xmlrpc_strdupsol(buffer);
+                *hostP = buffer;
                 *portP = port;
                 *errorP = NULL;
             }
         } else {
-            *hostP  = xmlrpc_strdupsol(buffer);
+            *hostP  = buffer;
             *portP  = 80;
             *errorP = NULL;
         }
-        free(buffer);
     }
 }
 
 
 
 static void
-splitUriQuery(const char *  const requestUri,
+splitUriQuery(TPool *       const poolP,
+              const char *  const requestUri,
               const char ** const queryP,
               const char ** const noQueryP,
               const char ** const errorP) {
 /*----------------------------------------------------------------------------
    Split 'requestUri' at the question mark, returning the stuff after
-   as *queryP and the stuff before as *noQueryP.
+   as *queryP and the stuff before as *noQueryP, both in memory from
+   pool *poolP.
 -----------------------------------------------------------------------------*/
     char * buffer;
 
-    buffer = strdup(requestUri);
+    buffer = (char *)PoolStrdup(poolP, requestUri);
 
     if (!buffer)
         xmlrpc_asprintf(errorP, "Couldn't get memory for URI buffer");
@@ -642,7 +652,7 @@ splitUriQuery(const char *  const requestUri,
 
         if (qmark) {
             *qmark = '\0';
-            *queryP = xmlrpc_strdupsol(qmark + 1);
+            *queryP = qmark + 1;
         } else
             *queryP = NULL;
 
@@ -654,17 +664,16 @@ splitUriQuery(const char *  const requestUri,
 
 
 static void
-parseHttpHostPortPath(const char *    const hostportpath,
+parseHttpHostPortPath(TPool *         const poolP,
+                      const char *    const hostportpath,
                       const char **   const hostP,
                       unsigned short* const portP,
                       const char **   const pathP,
                       const char **   const errorP) {
 
-    const char * path;
-
     char * buffer;
 
-    buffer = strdup(hostportpath);
+    buffer = (char *)PoolStrdup(poolP, hostportpath);
 
     if (!buffer)
         xmlrpc_asprintf(errorP,
@@ -672,36 +681,39 @@ parseHttpHostPortPath(const char *    const hostportpath,
     else {
         char * const slashPos = strchr(buffer, '/');
 
+        const char * path;
         char * hostport;
 
         if (slashPos) {
-            path = xmlrpc_strdupsol(slashPos); /* Includes the initial slash */
+            /* Includes the initial slash */
+            path = PoolStrdup(poolP, slashPos);
 
             *slashPos = '\0';  /* NUL termination for hostport */
         } else
-            path = strdup("*");
+            path = "*";
 
         hostport = buffer;
 
-        /* The following interprets the port field without taking into account
-           any %HH encoding, as the RFC says may be there.  We ignore that
-           remote possibility out of laziness.
-        */
-        parseHostPort(hostport, hostP, portP, errorP);
-
-        if (*errorP)
-            xmlrpc_strfree(path);
-        else
-            *pathP = path;
+        if (!path)
+            xmlrpc_asprintf(errorP, "Couldn't get memory for the path");
+        else {
+            /* The following interprets the port field without taking into
+               account any %HH encoding, as the RFC says may be there.  We
+               ignore that remote possibility out of laziness.
+            */
+            parseHostPort(poolP, hostport, hostP, portP, errorP);
 
-        free(buffer);
+            if (!*errorP)
+                *pathP = path;
+        }
     }
 }
 
 
 
 static void
-unescapeHostPathQuery(const char *  const host,
+unescapeHostPathQuery(TPool *       const poolP,
+                      const char *  const host,
                       const char *  const path,
                       const char *  const query,
                       const char ** const hostP,
@@ -714,24 +726,21 @@ unescapeHostPathQuery(const char *  const host,
    Each may be NULL, in which case we return NULL.
 -----------------------------------------------------------------------------*/
     if (host)
-        unescapeUri(host, hostP, errorP);
-    else
+        unescapeUri(poolP, host, hostP, errorP);
+    else {
         *hostP = NULL;
+        *errorP = NULL;
+    }
     if (!*errorP) {
         if (path)
-            unescapeUri(path, pathP, errorP);
+            unescapeUri(poolP, path, pathP, errorP);
         else
             *pathP = NULL;
         if (!*errorP) {
             if (query)
-                unescapeUri(query, queryP, errorP);
+                unescapeUri(poolP, query, queryP, errorP);
             else
                 *queryP = NULL;
-            if (*errorP)
-                xmlrpc_strfree(*pathP);
-        } else {
-            if (*hostP)
-                xmlrpc_strfree(*hostP);
         }
     }
 }
@@ -739,7 +748,8 @@ unescapeHostPathQuery(const char *  const host,
 
 
 static void
-parseRequestUri(char *           const requestUri,
+parseRequestUri(TPool *          const poolP,
+                char *           const requestUri,
                 const char **    const hostP,
                 unsigned short * const portP,
                 const char **    const pathP,
@@ -762,7 +772,7 @@ parseRequestUri(char *           const requestUri,
   Return as *queryP the "parm" in the above example.  If it doesn't
   exist, return *queryP == NULL.
 
-  Return strings in newly malloc'ed storage.
+  Return strings in memory from pool *poolP.
 
   We can return syntactically invalid entities, e.g. a host name that
   contains "<", if 'requestUri' is similarly invalid.  We should fix that
@@ -778,35 +788,26 @@ parseRequestUri(char *           const requestUri,
     const char * host;
     unsigned short port;
 
-    splitUriQuery(requestUri, &query, &requestUriNoQuery, errorP);
+    splitUriQuery(poolP, requestUri, &query, &requestUriNoQuery, errorP);
     if (!*errorP) {
         if (requestUriNoQuery[0] == '/') {
             host = NULL;
-            path = xmlrpc_strdupsol(requestUriNoQuery);
+            path = requestUriNoQuery;
             port = 80;
             *errorP = NULL;
         } else {
             if (!xmlrpc_strneq(requestUriNoQuery, "http://", 7))
                 xmlrpc_asprintf(errorP, "Scheme is not http://");
             else
-                parseHttpHostPortPath(&requestUriNoQuery[7],
+                parseHttpHostPortPath(poolP, &requestUriNoQuery[7],
                                       &host, &port, &path, errorP);
         }
 
         if (!*errorP) {
             *portP = port;
-            unescapeHostPathQuery(host, path, query,
+            unescapeHostPathQuery(poolP, host, path, query,
                                   hostP, pathP, queryP, errorP);
-
-            if (host)
-                xmlrpc_strfree(host);
-            if (path)
-                xmlrpc_strfree(path);
         }
-
-        if (query)
-            xmlrpc_strfree(query);
-        xmlrpc_strfree(requestUriNoQuery);
     }
 }
 
@@ -854,7 +855,8 @@ parseHttpVersion(const char *  const textFromReqLine,
 
 
 static void
-parseRequestLine(char *           const requestLine,
+parseRequestLine(TPool *          const poolP,
+                 const char *     const requestLine,
                  TMethod *        const httpMethodP,
                  httpVersion *    const httpVersionP,
                  const char **    const hostP,
@@ -863,8 +865,10 @@ parseRequestLine(char *           const requestLine,
                  const char **    const queryP,
                  bool *           const moreLinesP,
                  const char **    const errorP) {
-
-    char * const requestBuffer = strdup(requestLine);
+/*----------------------------------------------------------------------------
+   Return strings in memory from pool *poolP.
+-----------------------------------------------------------------------------*/
+    char * const requestBuffer = (char *)PoolStrdup(poolP, requestLine);
 
     const char * httpMethodName;
     char * p;
@@ -899,7 +903,7 @@ parseRequestLine(char *           const requestLine,
                 const char * query;
                 const char * error;
 
-                parseRequestUri(requestUri,
+                parseRequestUri(poolP, requestUri,
                                 &host, &port, &path, &query, &error);
 
                 if (error) {
@@ -934,11 +938,6 @@ parseRequestLine(char *           const requestLine,
                         *errorP = NULL;
                         *moreLinesP = false;
                     }
-                    if (*errorP) {
-                        xmlrpc_strfree(host);
-                        xmlrpc_strfree(path);
-                        xmlrpc_strfree(query);
-                    }
                     *hostP = host;
                     *portP = port;
                     *pathP = path;
@@ -946,21 +945,6 @@ parseRequestLine(char *           const requestLine,
                 }
             }
         }
-        xmlrpc_strfree(requestBuffer);
-    }
-}
-
-
-
-static void
-strtolower(char * const s) {
-
-    char * t;
-
-    t = &s[0];
-    while (*t) {
-        *t = tolower(*t);
-        ++t;
     }
 }
 
@@ -969,6 +953,7 @@ strtolower(char * const s) {
 static void
 getFieldNameToken(char **       const pP,
                   char **       const fieldNameP,
+                  size_t *      const fieldNameLenP,
                   const char ** const errorP,
                   uint16_t *    const httpErrorCodeP) {
 /*----------------------------------------------------------------------------
@@ -976,30 +961,48 @@ getFieldNameToken(char **       const pP,
    name belongs, return the field name and advance *pP past that token.
 
    The field name is the lower case representation of the value of the
-   field name token.
+   field name token.  We return its length as *fieldNameLenP.
 
    If the field name is invalid, return a text explanation as *errorP
    and a suitable HTTP status code as *httpErrorCodeP.  If not, return
    *errorP == NULL and nothing as *httpErrorCodeP.
 -----------------------------------------------------------------------------*/
     char * fieldName;
+    size_t tokenLen;
 
     NextToken((const char **)pP);
 
-    fieldName = GetToken(pP);
-    if (!fieldName) {
+    fieldName = *pP;
+    tokenLen  = strcspn(fieldName, " \t\r\n");
+
+    /* Consume the token and the delimiter after it, like GetToken() */
+    if (fieldName[tokenLen] != '\0') {
+        fieldName[tokenLen] = '\0';
+        *pP = &fieldName[tokenLen + 1];
+    } else
+        *pP = &fieldName[tokenLen];
+
+    if (tokenLen == 0) {
         xmlrpc_asprintf(errorP, "The header has no field name token");
         *httpErrorCodeP = 400;  /* Bad Request */
     } else {
-        if (fieldName[strlen(fieldName)-1] != ':') {
+        if (fieldName[tokenLen-1] != ':') {
             /* Not a valid field name */
             xmlrpc_asprintf(errorP, "The field name token '%s' "
                             "does not end with a colon (:)", fieldName);
             *httpErrorCodeP = 400;  /* Bad Request */
         } else {
-            fieldName[strlen(fieldName)-1] = '\0';  /* remove trailing colon */
+            size_t const nameLen = tokenLen - 1;
 
-            strtolower(fieldName);
+            size_t i;
+
+            fieldName[nameLen] = '\0';  /* remove trailing colon */
+
+            for (i = 0; i < nameLen; ++i) {
+                if (fieldName[i] >= 'A' && fieldName[i] <= 'Z')
+                    fieldName[i] += 'a' - 'A';
+            }
+            *fieldNameLenP = nameLen;
 
             *errorP = NULL;
         }
@@ -1010,39 +1013,89 @@ getFieldNameToken(char **       const pP,
 
 
 static void
-processField(const char *  const fieldName,
+processContentLength(const char * const fieldValue,
+                     TSession *   const sessionP) {
+/*----------------------------------------------------------------------------
+   Note the body size the Content-Length field value 'fieldValue' gives, so we
+   know where the next request on the connection starts.
+
+   We don't fail the request if the value is invalid; the handler, which is
+   what cares about the body, decides that.  But as we then don't know where
+   the body ends, we don't keep the connection alive.
+-----------------------------------------------------------------------------*/
+    const char * p;
+    uint64_t value;
+    bool valid;
+
+    for (p = &fieldValue[0], value = 0, valid = isdigit(*p);
+         isdigit(*p) && valid;
+         ++p) {
+        unsigned int const digit = *p - '0';
+
+        if (value > ((uint64_t)-1 - digit) / 10)
+            valid = false;
+        else
+            value = value * 10 + digit;
+    }
+    while (*p == ' ' || *p == '\t')
+        ++p;
+
+    if (*p != '\0')
+        valid = false;
+
+    if (sessionP->unchunkedState.lengthIsKnown &&
+        value != sessionP->unchunkedState.bytesLeftCt)
+        valid = false;  /* Conflicting Content-Length fields */
+
+    if (valid) {
+        sessionP->unchunkedState.lengthIsKnown = true;
+        sessionP->unchunkedState.bytesLeftCt   = value;
+    } else {
+        sessionP->unchunkedState.lengthIsKnown = false;
+        sessionP->serverDeniesKeepalive = true;
+    }
+}
+
+
+
+static void
+processField(HttpField     const field,
              char *        const fieldValue,
              TSession *    const sessionP,
              const char ** const errorP,
              uint16_t *    const httpErrorCodeP) {
 /*----------------------------------------------------------------------------
-   We may modify *fieldValue, and we put pointers to *fieldValue and
-   *fieldName into *sessionP.
+   We may modify *fieldValue, and we put pointers to *fieldValue into
+   *sessionP.
 
    We must fix this some day.  *sessionP should point to individual
    malloc'ed strings.
 -----------------------------------------------------------------------------*/
     *errorP = NULL;  /* initial assumption */
 
-    if (xmlrpc_streq(fieldName, "connection")) {
+    switch (field) {
+    case HTTPFIELD_CONNECTION:
         if (xmlrpc_strcaseeq(fieldValue, "keep-alive"))
             sessionP->requestInfo.keepalive = true;
         else
             sessionP->requestInfo.keepalive = false;
-    } else if (xmlrpc_streq(fieldName, "host")) {
-        if (sessionP->requestInfo.host) {
-            xmlrpc_strfree(sessionP->requestInfo.host);
-            sessionP->requestInfo.host = NULL;
-        }
-        parseHostPort(fieldValue, &sessionP->requestInfo.host,
+        break;
+    case HTTPFIELD_HOST:
+        sessionP->requestInfo.host = NULL;
+        parseHostPort(sessionP->poolP, fieldValue,
+                      &sessionP->requestInfo.host,
                       &sessionP->requestInfo.port, errorP);
-    } else if (xmlrpc_streq(fieldName, "from"))
+        break;
+    case HTTPFIELD_FROM:
         sessionP->requestInfo.from = fieldValue;
-    else if (xmlrpc_streq(fieldName, "user-agent"))
+        break;
+    case HTTPFIELD_USER_AGENT:
         sessionP->requestInfo.useragent = fieldValue;
-    else if (xmlrpc_streq(fieldName, "referer"))
+        break;
+    case HTTPFIELD_REFERER:
         sessionP->requestInfo.referer = fieldValue;
-    else if (xmlrpc_streq(fieldName, "range")) {
+        break;
+    case HTTPFIELD_RANGE:
         if (xmlrpc_strneq(fieldValue, "bytes=", 6)) {
             bool succeeded;
             succeeded = ListAddFromString(&sessionP->ranges, &fieldValue[6]);
@@ -1053,7 +1106,8 @@ processField(const char *  const fieldName,
                 *httpErrorCodeP = 400;
             }
         }
-    } else if (xmlrpc_streq(fieldName, "cookies")) {
+        break;
+    case HTTPFIELD_COOKIES: {
         bool succeeded;
         succeeded = ListAddFromString(&sessionP->cookies, fieldValue);
         if (!succeeded) {
@@ -1061,10 +1115,15 @@ processField(const char *  const fieldName,
                             "cookies: header value '%s'", fieldValue);
             *httpErrorCodeP = 400;
         }
-    } else if (xmlrpc_streq(fieldName, "expect")) {
+    } break;
+    case HTTPFIELD_CONTENT_LENGTH:
+        processContentLength(fieldValue, sessionP);
+        break;
+    case HTTPFIELD_EXPECT:
         if (xmlrpc_strcaseeq(fieldValue, "100-continue"))
             sessionP->continueRequired = true;
-    } else if (xmlrpc_streq(fieldName, "transfer-encoding")) {
+        break;
+    case HTTPFIELD_TRANSFER_ENCODING:
         if (xmlrpc_strcaseeq(fieldValue, "chunked"))
             sessionP->requestIsChunked = true;
         else if (xmlrpc_strcaseeq(fieldValue, "identity")) {
@@ -1075,6 +1134,45 @@ processField(const char *  const fieldName,
                             "'identity'", fieldValue);
             *httpErrorCodeP = 501;
         }
+        break;
+    default:
+        /* Abyss itself doesn't care about the field */
+        break;
+    }
+}
+
+
+
+static void
+addField(TSession *    const sessionP,
+         const char *  const fieldName,
+         HttpField     const field,
+         const char *  const fieldValue,
+         const char ** const errorP,
+         uint16_t *    const httpErrorCodeP) {
+/*----------------------------------------------------------------------------
+   Add the field to the session's table of request header fields and, if it
+   is the first field of a kind we know, remember where its value is.
+
+   The table is in the session's memory pool, so failure normally means the
+   header is bigger than the server's limit on session memory.
+-----------------------------------------------------------------------------*/
+    TTable * const tableP = &sessionP->requestHeaderFields;
+
+    bool succeeded;
+
+    succeeded = TableAdd(tableP, fieldName, fieldValue);
+
+    if (!succeeded) {
+        xmlrpc_asprintf(errorP, "No memory for header field '%s'.  "
+                        "Header is too large", fieldName);
+        *httpErrorCodeP = 413;  /* Request entity too large */
+    } else {
+        *errorP = NULL;
+
+        if (field != HTTPFIELD_OTHER && !sessionP->knownFieldValue[field])
+            sessionP->knownFieldValue[field] =
+                tableP->item[tableP->size-1].value;
     }
 }
 
@@ -1120,21 +1218,27 @@ readAndProcessHeaderFields(TSession *    const sessionP,
             if (!endOfHeader) {
                 char * p;
                 char * fieldName;
+                size_t fieldNameLen;
 
                 p = &field[0];
-                getFieldNameToken(&p, &fieldName, errorP, httpErrorCodeP);
+                getFieldNameToken(&p, &fieldName, &fieldNameLen,
+                                  errorP, httpErrorCodeP);
                 if (!*errorP) {
+                    HttpField const knownField =
+                        HTTPFieldFromName(fieldName, fieldNameLen);
+
                     char * fieldValue;
 
                     NextToken((const char **)&p);
 
                     fieldValue = p;
 
-                    TableAdd(&sessionP->requestHeaderFields,
-                             fieldName, fieldValue);
+                    addField(sessionP, fieldName, knownField, fieldValue,
+                             errorP, httpErrorCodeP);
 
-                    processField(fieldName, fieldValue, sessionP, errorP,
-                                 httpErrorCodeP);
+                    if (!*errorP)
+                        processField(knownField, fieldValue, sessionP,
+                                     errorP, httpErrorCodeP);
                 }
             }
         }
@@ -1192,32 +1296,39 @@ SessionReadRequest(TSession *    const sessionP,
         bool moreFields;
         const char * error;
 
-        parseRequestLine(requestLine, &httpMethod, &sessionP->version,
-                         &host, &port, &path, &query,
-                         &moreFields, &error);
+        const char * const requestLineCopy =
+            PoolStrdup(sessionP->poolP, requestLine);
+            /* The request line outlives the connection buffer contents */
 
-        if (error) {
-            xmlrpc_asprintf(errorP, "Unable to parse the request header "
-                            "'%s'.  %s", requestLine, error);
-            *httpErrorCodeP = 400;  /* Bad request */
-            xmlrpc_strfree(error);
+        if (!requestLineCopy) {
+            xmlrpc_asprintf(errorP, "No memory for the request line.  "
+                            "It is too large");
+            *httpErrorCodeP = 413;  /* Request entity too large */
         } else {
-            initRequestInfo(&sessionP->requestInfo, sessionP->version,
-                            requestLine,
-                            httpMethod, host, port, path, query);
-
-            if (moreFields) {
-                readAndProcessHeaderFields(sessionP, deadline,
-                                           errorP, httpErrorCodeP);
-            } else
-                *errorP = NULL;
+            parseRequestLine(sessionP->poolP, requestLine,
+                             &httpMethod, &sessionP->version,
+                             &host, &port, &path, &query,
+                             &moreFields, &error);
 
-            if (!*errorP)
-                sessionP->validRequest = true;
+            if (error) {
+                xmlrpc_asprintf(errorP, "Unable to parse the request header "
+                                "'%s'.  %s", requestLine, error);
+                *httpErrorCodeP = 400;  /* Bad request */
+                xmlrpc_strfree(error);
+            } else {
+                initRequestInfo(&sessionP->requestInfo, sessionP->version,
+                                requestLineCopy,
+                                httpMethod, host, port, path, query);
+
+                if (moreFields) {
+                    readAndProcessHeaderFields(sessionP, deadline,
+                                               errorP, httpErrorCodeP);
+                } else
+                    *errorP = NULL;
 
-            xmlrpc_strfreenull(host);
-            xmlrpc_strfree(path);
-            xmlrpc_strfreenull(query);
+                if (!*errorP)
+                    sessionP->validRequest = true;
+            }
         }
     }
 }
@@ -21,13 +21,22 @@
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <time.h>
 
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 #include <openssl/rand.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/sha.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
 
 #include "xmlrpc-c/util_int.h"
 #include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
 #include "bool.h"
 #include "mallocvar.h"
 #include "trace.h"
@@ -51,6 +60,31 @@
 #define HAVE_SSL_ERROR_WANT_ACCEPT 0
 #endif
 
+/* OpenSSL 3 replaced the session ticket key callback, which works with a
+   HMAC_CTX, with one that works with an EVP_MAC_CTX.
+*/
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#define HAVE_TICKET_KEY_EVP_CB 1
+#else
+#define HAVE_TICKET_KEY_EVP_CB 0
+#endif
+
+#define TICKET_KEY_NAME_SIZE 16
+    /* Size of the key name OpenSSL puts at the front of a session ticket */
+
+#define DEFAULT_TICKET_KEY_LIFETIME 3600
+
+static unsigned char const sessionIdContext[] = "Xmlrpc-c Abyss";
+    /* OpenSSL resumes only sessions that were made in the same context.
+       All of ours are the same.
+    */
+
+static int sslSwitchIndex = -1;
+    /* The index of the OpenSSL "ex data" of an SSL connection object we
+       create in which we record the channel switch that accepted the
+       connection.
+    */
+
 
 
 static const char *
@@ -229,7 +263,13 @@ SocketOpenSslInit(const char ** const errorP) {
         /* readable error messages, don't call this if memory is tight */
 	SSL_library_init();   /* initialize library */
 
-	*errorP = NULL;
+	sslSwitchIndex = SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
+
+	if (sslSwitchIndex < 0)
+		xmlrpc_asprintf(errorP, "Could not get an OpenSSL ex data index "
+		                "for SSL connection objects");
+	else
+		*errorP = NULL;
 }
 
 
@@ -397,6 +437,21 @@ channelFormatPeerInfo(TChannel *    const channelP,
 
 
 
+static ChannelPeerHungUpImpl channelPeerHungUp;
+
+static bool
+channelPeerHungUp(TChannel * const channelP) {
+/*----------------------------------------------------------------------------
+   The TCP connection under the SSL connection tells us this; what OpenSSL
+   has buffered doesn't matter.
+-----------------------------------------------------------------------------*/
+    struct ChannelOpenSsl * const channelOpenSslP = channelP->implP;
+
+    return sockutil_peerHungUp(channelOpenSslP->fd);
+}
+
+
+
 static struct TChannelVtbl const channelVtbl = {
     &channelDestroy,
     &channelWrite,
@@ -404,6 +459,9 @@ static struct TChannelVtbl const channelVtbl = {
     &channelWait,
     &channelInterrupt,
     &channelFormatPeerInfo,
+    NULL,
+    NULL,
+    &channelPeerHungUp,
 };
 
 
@@ -552,6 +610,18 @@ struct ChanSwitchOpenSsl {
 
     sockutil_InterruptPipe interruptPipe;
         /* We use this to interrupt a wait for the next client to arrive */
+
+    bool ticketsActive;
+        /* We issue and accept session tickets with keys we derive from
+           'ticketSecret'.
+        */
+    unsigned char ticketSecret[SHA256_DIGEST_LENGTH];
+    unsigned int ticketKeyLifetime;
+        /* Seconds each ticket key is current */
+
+    struct lock * statsLockP;
+        /* Lock for 'stats' */
+    struct abyss_openSsl_stats stats;
 };
 
 
@@ -568,6 +638,11 @@ chanSwitchDestroy(TChanSwitch * const chanSwitchP) {
     if (!chanSwitchOpenSslP->userSuppliedFd)
         close(chanSwitchOpenSslP->listenFd);
 
+    chanSwitchOpenSslP->statsLockP->destroy(chanSwitchOpenSslP->statsLockP);
+
+    OPENSSL_cleanse(chanSwitchOpenSslP->ticketSecret,
+                    sizeof(chanSwitchOpenSslP->ticketSecret));
+
     free(chanSwitchOpenSslP);
 }
 
@@ -588,15 +663,36 @@ chanSwitchListen(TChanSwitch * const chanSwitchP,
 
 
 static void
-createSslFromAcceptedConn(int           const acceptedFd,
-                          SSL_CTX *     const sslCtxP,
-                          SSL **        const sslPP,
-                          const char ** const errorP) {
+countHandshake(struct ChanSwitchOpenSsl * const chanSwitchOpenSslP,
+               SSL *                      const sslP,
+               bool                       const failed) {
+
+    struct abyss_openSsl_stats * const statsP = &chanSwitchOpenSslP->stats;
+
+    chanSwitchOpenSslP->statsLockP->acquire(chanSwitchOpenSslP->statsLockP);
+
+    if (failed)
+        ++statsP->failedHandshakes;
+    else if (SSL_session_reused(sslP))
+        ++statsP->resumedHandshakes;
+    else
+        ++statsP->fullHandshakes;
+
+    chanSwitchOpenSslP->statsLockP->release(chanSwitchOpenSslP->statsLockP);
+}
+
+
+
+static void
+createSslFromAcceptedConn(int                        const acceptedFd,
+                          struct ChanSwitchOpenSsl * const chanSwitchOpenSslP,
+                          SSL **                     const sslPP,
+                          const char **              const errorP) {
 
     SSL * sslP;
     const char * error;
 
-    sslCreate(sslCtxP, &sslP, &error);
+    sslCreate(chanSwitchOpenSslP->sslCtxP, &sslP, &error);
 
     if (error) {
         xmlrpc_asprintf(errorP, "Failed to create SSL connection "
@@ -614,8 +710,13 @@ createSslFromAcceptedConn(int           const acceptedFd,
         } else {
             const char * error;
 
+            /* For the session ticket key callback */
+            SSL_set_ex_data(sslP, sslSwitchIndex, chanSwitchOpenSslP);
+
             sslAccept(sslP, &error);
 
+            countHandshake(chanSwitchOpenSslP, sslP, !!error);
+
             if (error) {
                 xmlrpc_asprintf(errorP,
                                 "Failed to set up SSL communication on "
@@ -635,11 +736,12 @@ createSslFromAcceptedConn(int           const acceptedFd,
 
 
 static void
-createChannelFromAcceptedConn(int             const acceptedFd,
-                              SSL_CTX *       const sslCtxP,
-                              TChannel **     const channelPP,
-                              void **         const channelInfoPP,
-                              const char **   const errorP) {
+createChannelFromAcceptedConn(
+    int                        const acceptedFd,
+    struct ChanSwitchOpenSsl * const chanSwitchOpenSslP,
+    TChannel **                const channelPP,
+    void **                    const channelInfoPP,
+    const char **              const errorP) {
 
     struct ChannelOpenSsl * channelOpenSslP;
 
@@ -651,7 +753,8 @@ createChannelFromAcceptedConn(int             const acceptedFd,
         SSL * sslP;
         const char * error;
 
-        createSslFromAcceptedConn(acceptedFd, sslCtxP, &sslP, &error);
+        createSslFromAcceptedConn(acceptedFd, chanSwitchOpenSslP,
+                                  &sslP, &error);
 
         if (error) {
             xmlrpc_asprintf(errorP, "Failed to create an OpenSSL connection "
@@ -724,7 +827,7 @@ chanSwitchAccept(TChanSwitch * const chanSwitchP,
             const char * error;
 
             createChannelFromAcceptedConn(
-                acceptedFd, chanSwitchOpenSslP->sslCtxP,
+                acceptedFd, chanSwitchOpenSslP,
                 &channelP, channelInfoPP, &error);
 
             if (error) {
@@ -806,24 +909,38 @@ createChanSwitch(int            const fd,
         chanSwitchOpenSslP->listenFd = fd;
         chanSwitchOpenSslP->userSuppliedFd = userSuppliedFd;
 
-        sockutil_interruptPipeInit(&chanSwitchOpenSslP->interruptPipe, errorP);
+        chanSwitchOpenSslP->ticketsActive = false;
+        memset(&chanSwitchOpenSslP->stats, 0,
+               sizeof(chanSwitchOpenSslP->stats));
+
+        chanSwitchOpenSslP->statsLockP = xmlrpc_lock_create();
+
+        if (!chanSwitchOpenSslP->statsLockP)
+            xmlrpc_asprintf(errorP, "Unable to create lock for OpenSSL "
+                            "channel switch statistics");
+        else
+            sockutil_interruptPipeInit(&chanSwitchOpenSslP->interruptPipe,
+                                       errorP);
 
         if (!*errorP) {
             ChanSwitchCreate(&chanSwitchVtbl, chanSwitchOpenSslP,
                              &chanSwitchP);
-            if (*errorP)
-                sockutil_interruptPipeTerm(chanSwitchOpenSslP->interruptPipe);
 
-            if (chanSwitchP == NULL)
+            if (chanSwitchP == NULL) {
                 xmlrpc_asprintf(errorP, "Unable to allocate memory for "
                                 "channel switch descriptor");
-            else {
+                sockutil_interruptPipeTerm(chanSwitchOpenSslP->interruptPipe);
+            } else {
                 *chanSwitchPP = chanSwitchP;
                 *errorP = NULL;
             }
         }
-        if (*errorP)
+        if (*errorP) {
+            if (chanSwitchOpenSslP->statsLockP)
+                chanSwitchOpenSslP->statsLockP->destroy(
+                    chanSwitchOpenSslP->statsLockP);
             free(chanSwitchOpenSslP);
+        }
     }
 }
 
@@ -977,3 +1094,304 @@ ChanSwitchOpenSslCreateFd(int            const fd,
 
 
 
+
+
+
+/*=============================================================================
+      Session resumption
+=============================================================================*/
+
+struct ticketKey {
+    unsigned char name[TICKET_KEY_NAME_SIZE];
+    unsigned char cipherKey[SHA256_DIGEST_LENGTH];  /* AES-256 key */
+    unsigned char macKey[SHA256_DIGEST_LENGTH];     /* HMAC-SHA256 key */
+};
+
+
+
+static void
+deriveKeyPart(const unsigned char * const secret,
+              char                  const label,
+              uint64_t              const epoch,
+              unsigned char *       const output) {
+/*----------------------------------------------------------------------------
+   Compute HMAC-SHA256(secret, label || epoch) into output[], which is
+   SHA256_DIGEST_LENGTH bytes.
+-----------------------------------------------------------------------------*/
+    unsigned char input[1 + 8];
+    unsigned int outputLen;
+    unsigned int i;
+
+    input[0] = label;
+    for (i = 0; i < 8; ++i)
+        input[1 + i] = (epoch >> (8 * (7 - i))) & 0xff;
+
+    HMAC(EVP_sha256(), secret, SHA256_DIGEST_LENGTH, input, sizeof(input),
+         output, &outputLen);
+}
+
+
+
+static void
+deriveTicketKey(const struct ChanSwitchOpenSsl * const chanSwitchOpenSslP,
+                uint64_t                         const epoch,
+                struct ticketKey *               const keyP) {
+/*----------------------------------------------------------------------------
+   The ticket key for key lifetime number 'epoch' (counting from the Unix
+   epoch).
+
+   Because the key is a function of only the secret and the time, every
+   process with the same secret uses the same key at the same time, without
+   sharing any memory or talking to each other.
+-----------------------------------------------------------------------------*/
+    unsigned char name[SHA256_DIGEST_LENGTH];
+
+    deriveKeyPart(chanSwitchOpenSslP->ticketSecret, 'n', epoch, name);
+    memcpy(keyP->name, name, sizeof(keyP->name));
+
+    deriveKeyPart(chanSwitchOpenSslP->ticketSecret, 'c', epoch,
+                  keyP->cipherKey);
+    deriveKeyPart(chanSwitchOpenSslP->ticketSecret, 'm', epoch,
+                  keyP->macKey);
+}
+
+
+
+static int
+setupTicketCipher(SSL *              const sslP,
+                  unsigned char *    const keyName,
+                  unsigned char *    const iv,
+                  EVP_CIPHER_CTX *   const cipherCtxP,
+                  int                const enc,
+                  struct ticketKey * const keyP) {
+/*----------------------------------------------------------------------------
+   The cipher part of the session ticket key callback: choose the key and
+   set up *cipherCtxP with it.  Return the key as *keyP so Caller can set
+   up the MAC with it.
+
+   Return value is as for the callback.
+-----------------------------------------------------------------------------*/
+    struct ChanSwitchOpenSsl * const chanSwitchOpenSslP =
+        SSL_get_ex_data(sslP, sslSwitchIndex);
+
+    int retval;
+
+    if (!chanSwitchOpenSslP || !chanSwitchOpenSslP->ticketsActive)
+        /* Not one of our connections; make no ticket or accept none */
+        retval = 0;
+    else {
+        uint64_t const epoch =
+            time(NULL) / chanSwitchOpenSslP->ticketKeyLifetime;
+
+        if (enc) {
+            deriveTicketKey(chanSwitchOpenSslP, epoch, keyP);
+
+            if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1)
+                retval = -1;
+            else {
+                memcpy(keyName, keyP->name, TICKET_KEY_NAME_SIZE);
+                EVP_EncryptInit_ex(cipherCtxP, EVP_aes_256_cbc(), NULL,
+                                   keyP->cipherKey, iv);
+                retval = 1;
+            }
+        } else {
+            /* The ticket may be from the current key or the previous one */
+            unsigned int age;
+            bool found;
+
+            for (age = 0, found = false; age < 2 && !found; ) {
+                deriveTicketKey(chanSwitchOpenSslP, epoch - age, keyP);
+
+                if (memcmp(keyName, keyP->name, TICKET_KEY_NAME_SIZE) == 0)
+                    found = true;
+                else
+                    ++age;
+            }
+            if (!found)
+                retval = 0;  /* Do a full handshake */
+            else {
+                EVP_DecryptInit_ex(cipherCtxP, EVP_aes_256_cbc(), NULL,
+                                   keyP->cipherKey, iv);
+
+                /* 2 means accept the ticket, but issue a new one, made with
+                   the current key.
+                */
+                retval = age == 0 ? 1 : 2;
+            }
+        }
+    }
+    return retval;
+}
+
+
+
+#if HAVE_TICKET_KEY_EVP_CB
+
+static int
+ticketKeyCallback(SSL *            const sslP,
+                  unsigned char *  const keyName,
+                  unsigned char *  const iv,
+                  EVP_CIPHER_CTX * const cipherCtxP,
+                  EVP_MAC_CTX *    const macCtxP,
+                  int              const enc) {
+
+    struct ticketKey key;
+    int retval;
+
+    retval = setupTicketCipher(sslP, keyName, iv, cipherCtxP, enc, &key);
+
+    if (retval > 0) {
+        OSSL_PARAM params[3];
+
+        params[0] = OSSL_PARAM_construct_octet_string(
+            OSSL_MAC_PARAM_KEY, key.macKey, sizeof(key.macKey));
+        params[1] = OSSL_PARAM_construct_utf8_string(
+            OSSL_MAC_PARAM_DIGEST, (char *)"SHA256", 0);
+        params[2] = OSSL_PARAM_construct_end();
+
+        if (!EVP_MAC_CTX_set_params(macCtxP, params))
+            retval = -1;
+    }
+    OPENSSL_cleanse(&key, sizeof(key));
+
+    return retval;
+}
+
+#else
+
+static int
+ticketKeyCallback(SSL *            const sslP,
+                  unsigned char *  const keyName,
+                  unsigned char *  const iv,
+                  EVP_CIPHER_CTX * const cipherCtxP,
+                  HMAC_CTX *       const hmacCtxP,
+                  int              const enc) {
+
+    struct ticketKey key;
+    int retval;
+
+    retval = setupTicketCipher(sslP, keyName, iv, cipherCtxP, enc, &key);
+
+    if (retval > 0) {
+        if (!HMAC_Init_ex(hmacCtxP, key.macKey, sizeof(key.macKey),
+                          EVP_sha256(), NULL))
+            retval = -1;
+    }
+    OPENSSL_cleanse(&key, sizeof(key));
+
+    return retval;
+}
+
+#endif
+
+
+
+static void
+setTickets(struct ChanSwitchOpenSsl *                const chanSwitchOpenSslP,
+           const struct abyss_openSsl_sessionparms * const parmsP,
+           const char **                             const errorP) {
+
+    SSL_CTX * const sslCtxP = chanSwitchOpenSslP->sslCtxP;
+
+    if (parmsP->ticketSecret) {
+        /* Any length of secret becomes a key of the right size */
+        SHA256(parmsP->ticketSecret, parmsP->ticketSecretLen,
+               chanSwitchOpenSslP->ticketSecret);
+        *errorP = NULL;
+    } else {
+        if (RAND_bytes(chanSwitchOpenSslP->ticketSecret,
+                       sizeof(chanSwitchOpenSslP->ticketSecret)) != 1) {
+            const char * const sslMsg = sslErrorMsg();
+
+            xmlrpc_asprintf(errorP, "Could not generate a random session "
+                            "ticket secret.  %s", sslMsg);
+            xmlrpc_strfree(sslMsg);
+        } else
+            *errorP = NULL;
+    }
+    if (!*errorP) {
+        chanSwitchOpenSslP->ticketKeyLifetime =
+            parmsP->ticketKeyLifetime > 0 ?
+            parmsP->ticketKeyLifetime : DEFAULT_TICKET_KEY_LIFETIME;
+
+#if HAVE_TICKET_KEY_EVP_CB
+        SSL_CTX_set_tlsext_ticket_key_evp_cb(sslCtxP, &ticketKeyCallback);
+#else
+        SSL_CTX_set_tlsext_ticket_key_cb(sslCtxP, &ticketKeyCallback);
+#endif
+        SSL_CTX_clear_options(sslCtxP, SSL_OP_NO_TICKET);
+
+        chanSwitchOpenSslP->ticketsActive = true;
+    }
+}
+
+
+
+void
+ChanSwitchOpenSslSetSessionParms(
+    TChanSwitch *                             const chanSwitchP,
+    const struct abyss_openSsl_sessionparms * const parmsP,
+    const char **                             const errorP) {
+/*----------------------------------------------------------------------------
+   Set up the OpenSSL channel switch *chanSwitchP to let clients resume TLS
+   sessions as *parmsP says.
+
+   This modifies the switch's SSL context (the one Caller supplied when
+   creating the switch), so it affects anything else that uses that context.
+   Call it before the switch accepts any connections.
+-----------------------------------------------------------------------------*/
+    if (chanSwitchP->vtbl.accept != &chanSwitchAccept)
+        xmlrpc_asprintf(errorP, "Channel switch is not an OpenSSL one");
+    else {
+        struct ChanSwitchOpenSsl * const chanSwitchOpenSslP =
+            chanSwitchP->implP;
+        SSL_CTX * const sslCtxP = chanSwitchOpenSslP->sslCtxP;
+
+        if (!SSL_CTX_set_session_id_context(sslCtxP, sessionIdContext,
+                                            sizeof(sessionIdContext) - 1))
+            xmlrpc_asprintf(errorP, "SSL_CTX_set_session_id_context() "
+                            "failed");
+        else {
+            if (parmsP->cacheSize > 0) {
+                SSL_CTX_set_session_cache_mode(sslCtxP,
+                                               SSL_SESS_CACHE_SERVER);
+                SSL_CTX_sess_set_cache_size(sslCtxP, parmsP->cacheSize);
+            } else
+                SSL_CTX_set_session_cache_mode(sslCtxP, SSL_SESS_CACHE_OFF);
+
+            if (parmsP->timeout > 0)
+                SSL_CTX_set_timeout(sslCtxP, parmsP->timeout);
+
+            if (parmsP->tickets)
+                setTickets(chanSwitchOpenSslP, parmsP, errorP);
+            else {
+                SSL_CTX_set_options(sslCtxP, SSL_OP_NO_TICKET);
+                chanSwitchOpenSslP->ticketsActive = false;
+                *errorP = NULL;
+            }
+        }
+    }
+}
+
+
+
+void
+ChanSwitchOpenSslGetStats(TChanSwitch *                const chanSwitchP,
+                          struct abyss_openSsl_stats * const statsP) {
+/*----------------------------------------------------------------------------
+   The TLS handshake counts for the OpenSSL channel switch *chanSwitchP.
+
+   In a server that forks a process for each connection or pre-forks worker
+   processes, each process counts its own handshakes, so these are just the
+   ones this process did.
+-----------------------------------------------------------------------------*/
+    struct ChanSwitchOpenSsl * const chanSwitchOpenSslP = chanSwitchP->implP;
+
+    assert(chanSwitchP->vtbl.accept == &chanSwitchAccept);
+
+    chanSwitchOpenSslP->statsLockP->acquire(chanSwitchOpenSslP->statsLockP);
+
+    *statsP = chanSwitchOpenSslP->stats;
+
+    chanSwitchOpenSslP->statsLockP->release(chanSwitchOpenSslP->statsLockP);
+}
@@ -26,6 +26,9 @@
 #if HAVE_SYS_FILIO_H
   #include <sys/filio.h>
 #endif
+#if HAVE_SYS_SENDFILE_H
+  #include <sys/sendfile.h>
+#endif
 
 #include "c_util.h"
 #include "int.h"
@@ -340,6 +343,86 @@ channelFormatPeerInfo(TChannel *    const channelP,
 
 
 
+static ChannelPollFdImpl channelPollFd;
+
+static int
+channelPollFd(TChannel * const channelP) {
+
+    struct socketUnix * const socketUnixP = channelP->implP;
+
+    return socketUnixP->fd;
+}
+
+
+
+static ChannelPeerHungUpImpl channelPeerHungUp;
+
+static bool
+channelPeerHungUp(TChannel * const channelP) {
+
+    struct socketUnix * const socketUnixP = channelP->implP;
+
+    return sockutil_peerHungUp(socketUnixP->fd);
+}
+
+
+
+#if HAVE_SYS_SENDFILE_H
+
+static ChannelSendFileImpl channelSendFile;
+
+static void
+channelSendFile(TChannel * const channelP,
+                int        const fileFd,
+                uint64_t   const offset,
+                uint32_t   const len,
+                bool *     const failedP) {
+/*----------------------------------------------------------------------------
+   Send file data with sendfile(), so the kernel moves it from the page
+   cache to the socket without its passing through user space.
+-----------------------------------------------------------------------------*/
+    struct socketUnix * const socketUnixP = channelP->implP;
+
+    off_t fileOffset;
+    size_t bytesLeft;
+    bool error;
+
+    fileOffset = (off_t)offset;
+
+    if ((uint64_t)fileOffset != offset)
+        /* Offset is too large for this system's off_t */
+        error = true;
+    else {
+        for (bytesLeft = len, error = false; bytesLeft > 0 && !error; ) {
+            ssize_t rc;
+
+            /* sendfile() advances 'fileOffset' by what it sends */
+            rc = sendfile(socketUnixP->fd, fileFd, &fileOffset, bytesLeft);
+
+            if (ChannelTraceIsActive) {
+                if (rc < 0)
+                    fprintf(stderr, "Abyss channel: sendfile() failed.  "
+                            "errno=%d (%s)\n", errno, strerror(errno));
+                else
+                    fprintf(stderr, "Abyss channel: sent %u bytes "
+                            "from file\n", (unsigned)rc);
+            }
+            if (rc <= 0)
+                /* 0 means the file is shorter than we thought; < 0 means
+                   severe error, including connection closed.
+                */
+                error = true;
+            else
+                bytesLeft -= rc;
+        }
+    }
+    *failedP = error;
+}
+
+#endif
+
+
+
 static struct TChannelVtbl const channelVtbl = {
     &channelDestroy,
     &channelWrite,
@@ -347,6 +430,13 @@ static struct TChannelVtbl const channelVtbl = {
     &channelWait,
     &channelInterrupt,
     &channelFormatPeerInfo,
+    &channelPollFd,
+#if HAVE_SYS_SENDFILE_H
+    &channelSendFile,
+#else
+    NULL,
+#endif
+    &channelPeerHungUp,
 };
 
 
@@ -766,12 +856,13 @@ ChanSwitchUnixCreate(unsigned short const portNumber,
 
 
 
-void
-ChanSwitchUnixCreate2(int                     const protocolFamily,
-                      const struct sockaddr * const sockAddrP,
-                      socklen_t               const sockAddrLen,
-                      TChanSwitch **          const chanSwitchPP,
-                      const char **           const errorP) {
+static void
+switchCreateSockAddr(int                     const protocolFamily,
+                     const struct sockaddr * const sockAddrP,
+                     socklen_t               const sockAddrLen,
+                     bool                    const reusePort,
+                     TChanSwitch **          const chanSwitchPP,
+                     const char **           const errorP) {
 
     int rc;
     rc = socket(protocolFamily, SOCK_STREAM, 0);
@@ -786,6 +877,8 @@ ChanSwitchUnixCreate2(int                     const protocolFamily,
                     protocolFamily);
 
         sockutil_setSocketOptions(socketFd, errorP);
+        if (!*errorP && reusePort)
+            sockutil_setReusePort(socketFd, errorP);
         if (!*errorP) {
             sockutil_bindSocketToPort(socketFd, sockAddrP, sockAddrLen,
                                       errorP);
@@ -798,7 +891,36 @@ ChanSwitchUnixCreate2(int                     const protocolFamily,
         if (*errorP)
             close(socketFd);
     }
+}
+
+
 
+void
+ChanSwitchUnixCreate2(int                     const protocolFamily,
+                      const struct sockaddr * const sockAddrP,
+                      socklen_t               const sockAddrLen,
+                      TChanSwitch **          const chanSwitchPP,
+                      const char **           const errorP) {
+
+    switchCreateSockAddr(protocolFamily, sockAddrP, sockAddrLen, false,
+                         chanSwitchPP, errorP);
+}
+
+
+
+void
+ChanSwitchUnixCreateReusePort(int                     const protocolFamily,
+                              const struct sockaddr * const sockAddrP,
+                              socklen_t               const sockAddrLen,
+                              TChanSwitch **          const chanSwitchPP,
+                              const char **           const errorP) {
+/*----------------------------------------------------------------------------
+   Same as ChanSwitchUnixCreate2(), except that other channel switches
+   created this way may listen at the same address, with the OS spreading
+   incoming connections among them (SO_REUSEPORT).
+-----------------------------------------------------------------------------*/
+    switchCreateSockAddr(protocolFamily, sockAddrP, sockAddrLen, true,
+                         chanSwitchPP, errorP);
 }
 
 
@@ -565,6 +565,9 @@ static struct TChannelVtbl const channelVtbl = {
     &channelWait,
     &channelInterrupt,
     &channelFormatPeerInfo,
+    NULL,
+    NULL,
+    NULL,
 };
 
 
@@ -5,6 +5,8 @@
   that use Unix sockets.
 =============================================================================*/
 
+#define _GNU_SOURCE  /* For POLLRDHUP, where it exists */
+
 #include "xmlrpc_config.h"
 
 #include <stdlib.h>
@@ -110,6 +112,52 @@ sockutil_connected(int const fd) {
 
 
 
+bool
+sockutil_peerHungUp(int const fd) {
+/*----------------------------------------------------------------------------
+   Return TRUE iff the peer of the connected stream socket on file
+   descriptor 'fd' has closed its end, or the connection has failed.  We
+   don't wait and we don't take any data from the socket.
+
+   Where poll() reports the peer's closing by itself (POLLRDHUP), data the
+   peer sent before closing (e.g. a pipelined HTTP request) doesn't hide the
+   close.  Elsewhere, we see the close only if no such data precedes it.
+
+   Note that we can't tell a peer that closed the connection from one that
+   only shut down its sending side.
+-----------------------------------------------------------------------------*/
+    struct pollfd pollfds[1];
+    bool hungUp;
+    int rc;
+
+    pollfds[0].fd = fd;
+#ifdef POLLRDHUP
+    pollfds[0].events = POLLRDHUP;
+#else
+    pollfds[0].events = POLLIN;
+#endif
+
+    rc = poll(pollfds, ARRAY_SIZE(pollfds), 0);
+
+    if (rc <= 0)
+        hungUp = false;
+    else if (pollfds[0].revents & (POLLHUP | POLLERR))
+        hungUp = true;
+    else {
+#ifdef POLLRDHUP
+        hungUp = !!(pollfds[0].revents & POLLRDHUP);
+#else
+        char c;
+
+        /* It's readable; end of file is how we see a close */
+        hungUp = (recv(fd, &c, 1, MSG_PEEK) == 0);
+#endif
+    }
+    return hungUp;
+}
+
+
+
 void
 sockutil_getSockName(int                const sockFd,
                      struct sockaddr ** const sockaddrPP,
@@ -389,6 +437,34 @@ sockutil_setSocketOptions(int           const fd,
 
 
 
+void
+sockutil_setReusePort(int           const fd,
+                      const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Let other sockets bind to the same address as socket 'fd', each
+   getting a share of the incoming connections.  Every such socket
+   needs this option before it is bound.
+-----------------------------------------------------------------------------*/
+#ifdef SO_REUSEPORT
+    int32_t n = 1;
+    int rc;
+
+    rc = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (char*)&n, sizeof(n));
+
+    if (rc < 0)
+        xmlrpc_asprintf(errorP, "Failed to set SO_REUSEPORT socket option.  "
+                        "setsockopt() failed with errno %d (%s)",
+                        errno, strerror(errno));
+    else
+        *errorP = NULL;
+#else
+    xmlrpc_asprintf(errorP, "This system does not have the SO_REUSEPORT "
+                    "socket option");
+#endif
+}
+
+
+
 static void
 traceSocketBound(const struct sockaddr * const sockAddrP,
                  socklen_t               const sockAddrLen) {
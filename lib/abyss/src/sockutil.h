@@ -22,6 +22,9 @@ sockutil_interruptPipeInterrupt(sockutil_InterruptPipe const interruptPipe);
 bool
 sockutil_connected(int const fd);
 
+bool
+sockutil_peerHungUp(int const fd);
+
 void
 sockutil_getSockName(int                const sockFd,
                      struct sockaddr ** const sockaddrPP,
@@ -53,6 +56,10 @@ void
 sockutil_setSocketOptions(int           const fd,
                           const char ** const errorP);
 
+void
+sockutil_setReusePort(int           const fd,
+                      const char ** const errorP);
+
 void
 sockutil_bindSocketToPort(int                     const fd,
                           const struct sockaddr * const sockAddrP,
@@ -46,6 +46,9 @@ ThreadRelease(TThread * const threadP);
 bool
 ThreadForks(void);
 
+bool
+ThreadPinToCpu(unsigned int const cpuIndex);
+
 void
 ThreadUpdateStatus(TThread * const threadP);
 
@@ -291,3 +291,11 @@ ThreadForks(void) {
 
 
 
+bool
+ThreadPinToCpu(unsigned int const cpuIndex ATTR_UNUSED) {
+
+    return false;
+}
+
+
+
@@ -1,8 +1,11 @@
+#define _GNU_SOURCE  /* But only when HAVE_PTHREAD_SETAFFINITY_NP */
+
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
 #include <signal.h>
 #include <pthread.h>
+#include <sched.h>
 
 #include "xmlrpc_config.h"
 
@@ -182,6 +185,64 @@ ThreadForks(void) {
 
 
 
+#if HAVE_PTHREAD_SETAFFINITY_NP
+
+bool
+ThreadPinToCpu(unsigned int const cpuIndex) {
+/*----------------------------------------------------------------------------
+   Restrict the calling thread to a single one of the CPUs on which it is
+   now allowed to run: the 'cpuIndex'th one, counting around again if there
+   are fewer.  Threads the calling thread creates later inherit the
+   restriction.
+
+   Return true iff we did it.
+-----------------------------------------------------------------------------*/
+    pthread_t const self = pthread_self();
+
+    cpu_set_t allowed;
+    bool success;
+    int rc;
+
+    rc = pthread_getaffinity_np(self, sizeof(allowed), &allowed);
+
+    if (rc != 0 || CPU_COUNT(&allowed) == 0)
+        success = false;
+    else {
+        unsigned int const target = cpuIndex % CPU_COUNT(&allowed);
+
+        unsigned int cpu;
+        unsigned int seen;
+
+        for (cpu = 0, seen = 0; seen <= target; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed))
+                ++seen;
+        }
+        {
+            cpu_set_t pinned;
+
+            CPU_ZERO(&pinned);
+            CPU_SET(cpu - 1, &pinned);
+
+            rc = pthread_setaffinity_np(self, sizeof(pinned), &pinned);
+
+            success = (rc == 0);
+        }
+    }
+    return success;
+}
+
+#else
+
+bool
+ThreadPinToCpu(unsigned int const cpuIndex ATTR_UNUSED) {
+
+    return false;
+}
+
+#endif
+
+
+
 void
 ThreadUpdateStatus(TThread * const threadP ATTR_UNUSED) {
 
@@ -159,6 +159,45 @@ ThreadForks(void) {
 
 
 
+bool
+ThreadPinToCpu(unsigned int const cpuIndex) {
+
+    DWORD_PTR processMask;
+    DWORD_PTR systemMask;
+    bool success;
+
+    if (!GetProcessAffinityMask(GetCurrentProcess(),
+                                &processMask, &systemMask) ||
+        processMask == 0)
+        success = FALSE;
+    else {
+        unsigned int cpuCt;
+        DWORD_PTR bit;
+
+        for (bit = 1, cpuCt = 0; bit != 0; bit <<= 1) {
+            if (processMask & bit)
+                ++cpuCt;
+        }
+        {
+            unsigned int const target = cpuIndex % cpuCt;
+
+            unsigned int seen;
+
+            for (bit = 1, seen = 0; ; bit <<= 1) {
+                if (processMask & bit) {
+                    if (seen == target)
+                        break;
+                    ++seen;
+                }
+            }
+        }
+        success = SetThreadAffinityMask(GetCurrentThread(), bit) != 0;
+    }
+    return success;
+}
+
+
+
 void
 ThreadUpdateStatus(TThread * const threadP ATTR_UNUSED) {
 
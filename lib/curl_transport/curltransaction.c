@@ -4,9 +4,14 @@
 
 #define _XOPEN_SOURCE 600  /* Make sure strdup() is in <string.h> */
 
+#include "xmlrpc_config.h"
+
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
+#if HAVE_ZLIB_H
+  #include <zlib.h>
+#endif
 
 #include "mallocvar.h"
 
@@ -107,6 +112,10 @@ struct curlTransaction {
     const char * serverUrl;  /* malloc'ed - belongs to this object */
     xmlrpc_mem_block * postDataP;
         /* The data to send for the POST method */
+    xmlrpc_mem_block * compressedPostDataP;
+        /* 'postDataP' gzipped, which is what we actually send, if we
+           compress it.  NULL if we don't.  Belongs to this object.
+        */
     xmlrpc_mem_block * responseDataP;
         /* This is normally where to put the body of the HTTP response.  But
            because of a quirk of Curl, if the response is not valid HTTP,
@@ -247,6 +256,32 @@ addAuthorizationHeader(xmlrpc_env *         const envP,
 
 
 
+static void
+addTimeoutHeader(xmlrpc_env *         const envP,
+                 struct curl_slist ** const headerListP,
+                 unsigned int         const timeoutMs) {
+/*----------------------------------------------------------------------------
+   Tell the server how long we will wait for the response, so it doesn't
+   bother executing a call whose result would arrive after we've given up.
+   An Xmlrpc-c Abyss server understands this header; other servers ignore
+   it.
+-----------------------------------------------------------------------------*/
+    const char * timeoutHeader;
+
+    xmlrpc_asprintf(&timeoutHeader, "X-Xmlrpc-Timeout: %u", timeoutMs);
+
+    if (xmlrpc_strnomem(timeoutHeader))
+        xmlrpc_faultf(envP, "Couldn't allocate memory for "
+                      "X-Xmlrpc-Timeout header");
+    else {
+        addHeader(envP, headerListP, timeoutHeader);
+
+        xmlrpc_strfree(timeoutHeader);
+    }
+}
+
+
+
 /*
   In HTTP 1.1, the client can send the header "Expect: 100-continue", which
   tells the server that the client isn't going to send the body until the
@@ -294,6 +329,8 @@ createCurlHeaderList(xmlrpc_env *               const envP,
                      const char *               const authHdrValue,
                      bool                       const dontAdvertise,
                      const char *               const userAgent,
+                     bool                       const compressed,
+                     unsigned int               const timeoutMs,
                      struct curl_slist **       const headerListP) {
 
     struct curl_slist * headerList;
@@ -301,12 +338,20 @@ createCurlHeaderList(xmlrpc_env *               const envP,
     headerList = NULL;  /* initial value - empty list */
 
     addContentTypeHeader(envP, &headerList);
+    if (!envP->fault_occurred) {
+        if (compressed)
+            addHeader(envP, &headerList, "Content-Encoding: gzip");
+    }
     if (!envP->fault_occurred) {
         addUserAgentHeader(envP, &headerList, !dontAdvertise, userAgent);
         if (!envP->fault_occurred) {
             if (authHdrValue)
                 addAuthorizationHeader(envP, &headerList, authHdrValue);
         }
+        if (!envP->fault_occurred) {
+            if (timeoutMs)
+                addTimeoutHeader(envP, &headerList, timeoutMs);
+        }
         if (!envP->fault_occurred)
             addExpectHeader(envP, &headerList);
     }
@@ -665,6 +710,131 @@ setupKeepalive(const struct curlSetup * const curlSetupP,
 
 
 
+#if HAVE_ZLIB_H
+
+static void
+gzipPostData(xmlrpc_env *         const envP,
+             xmlrpc_mem_block *   const postDataP,
+             unsigned int         const compressLevel,
+             xmlrpc_mem_block **  const compressedPP) {
+/*----------------------------------------------------------------------------
+   Gzip the contents of *postDataP at zlib level 'compressLevel' into a new
+   memory block *compressedPP.
+
+   We compress in one pass into a block zlib says is big enough for any
+   outcome, so there is no growing and copying.
+-----------------------------------------------------------------------------*/
+    z_stream zs;
+
+    zs.zalloc = Z_NULL;
+    zs.zfree  = Z_NULL;
+    zs.opaque = Z_NULL;
+
+    /* 16 added means gzip wrapper instead of zlib */
+    if (deflateInit2(&zs, compressLevel, Z_DEFLATED, 15 + 16, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+        xmlrpc_faultf(envP, "Couldn't create a zlib compressor");
+    else {
+        size_t const size = XMLRPC_MEMBLOCK_SIZE(char, postDataP);
+
+        xmlrpc_mem_block * const compressedP =
+            XMLRPC_MEMBLOCK_NEW(char, envP, deflateBound(&zs, size));
+
+        if (!envP->fault_occurred) {
+            zs.next_in   = (Bytef *)XMLRPC_MEMBLOCK_CONTENTS(char, postDataP);
+            zs.avail_in  = size;
+            zs.next_out  = (Bytef *)XMLRPC_MEMBLOCK_CONTENTS(char, compressedP);
+            zs.avail_out = XMLRPC_MEMBLOCK_SIZE(char, compressedP);
+
+            if (deflate(&zs, Z_FINISH) != Z_STREAM_END)
+                xmlrpc_faultf(envP, "zlib failed to compress the call.  %s",
+                              zs.msg ? zs.msg : "");
+            else
+                XMLRPC_MEMBLOCK_RESIZE(char, envP, compressedP, zs.total_out);
+
+            if (envP->fault_occurred)
+                XMLRPC_MEMBLOCK_FREE(char, compressedP);
+            else
+                *compressedPP = compressedP;
+        }
+        deflateEnd(&zs);
+    }
+}
+
+#else
+
+static void
+gzipPostData(xmlrpc_env *         const envP,
+             xmlrpc_mem_block *   const postDataP ATTR_UNUSED,
+             unsigned int         const compressLevel ATTR_UNUSED,
+             xmlrpc_mem_block **  const compressedPP ATTR_UNUSED) {
+
+    /* The transport refuses a compression level without zlib */
+
+    xmlrpc_faultf(envP, "This Xmlrpc-c was built without zlib");
+}
+
+#endif
+
+
+
+static void
+setupPostData(xmlrpc_env *             const envP,
+              curlTransaction *        const transP,
+              const struct curlSetup * const curlSetupP) {
+/*----------------------------------------------------------------------------
+   Set up the Curl session for the transaction *transP to send the call as
+   the POST body, gzipped if Caller wants that and it is big enough to be
+   worth it.
+
+   The server needs to know the length of the body up front, so we can't
+   compress it as Curl sends it; we compress it all first.
+-----------------------------------------------------------------------------*/
+    CURL * const curlSessionP = transP->curlSessionP;
+
+    transP->compressedPostDataP = NULL;  /* initial value */
+
+    if (curlSetupP->compressLevel > 0 &&
+        XMLRPC_MEMBLOCK_SIZE(char, transP->postDataP) >=
+        curlSetupP->compressMinSize) {
+
+        gzipPostData(envP, transP->postDataP, curlSetupP->compressLevel,
+                     &transP->compressedPostDataP);
+
+        if (!envP->fault_occurred) {
+            xmlrpc_mem_block * const compressedP =
+                transP->compressedPostDataP;
+
+            curl_easy_setopt(curlSessionP, CURLOPT_POSTFIELDSIZE,
+                             (long)XMLRPC_MEMBLOCK_SIZE(char, compressedP));
+            curl_easy_setopt(curlSessionP, CURLOPT_POSTFIELDS,
+                             XMLRPC_MEMBLOCK_CONTENTS(char, compressedP));
+        }
+    } else {
+        XMLRPC_MEMBLOCK_APPEND(char, envP, transP->postDataP, "\0", 1);
+        if (!envP->fault_occurred)
+            curl_easy_setopt(curlSessionP, CURLOPT_POSTFIELDS,
+                             XMLRPC_MEMBLOCK_CONTENTS(char, transP->postDataP));
+    }
+}
+
+
+
+static void
+requestCompressedResponse(CURL * const curlSessionP) {
+/*----------------------------------------------------------------------------
+   Have Curl send Accept-Encoding with every coding it can decode, and
+   decode the response body before it gets to us.
+-----------------------------------------------------------------------------*/
+#if HAVE_CURL_ACCEPT_ENCODING
+    curl_easy_setopt(curlSessionP, CURLOPT_ACCEPT_ENCODING, "");
+#else
+    curl_easy_setopt(curlSessionP, CURLOPT_ENCODING, "");
+#endif
+}
+
+
+
 static void
 setupCurlSession(xmlrpc_env *               const envP,
                  curlTransaction *          const transP,
@@ -709,10 +879,8 @@ setupCurlSession(xmlrpc_env *               const envP,
     curl_easy_setopt(curlSessionP, CURLOPT_POST, 1);
     curl_easy_setopt(curlSessionP, CURLOPT_URL, transP->serverUrl);
 
-    XMLRPC_MEMBLOCK_APPEND(char, envP, transP->postDataP, "\0", 1);
+    setupPostData(envP, transP, curlSetupP);
     if (!envP->fault_occurred) {
-        curl_easy_setopt(curlSessionP, CURLOPT_POSTFIELDS,
-                         XMLRPC_MEMBLOCK_CONTENTS(char, transP->postDataP));
         curl_easy_setopt(curlSessionP, CURLOPT_WRITEFUNCTION, collect);
         curl_easy_setopt(curlSessionP, CURLOPT_FILE, transP->responseDataP);
             /* CURLOPT_FILE is the older name for CURLOPT_WRITEDATA */
@@ -803,6 +971,9 @@ setupCurlSession(xmlrpc_env *               const envP,
         if (curlSetupP->verbose)
             curl_easy_setopt(curlSessionP, CURLOPT_VERBOSE, 1l);
 
+        if (curlSetupP->acceptCompressed)
+            requestCompressedResponse(curlSessionP);
+
         if (curlSetupP->timeout)
             setCurlTimeout(curlSessionP, curlSetupP->timeout);
 
@@ -841,6 +1012,8 @@ setupCurlSession(xmlrpc_env *               const envP,
                 struct curl_slist * headerList;
                 createCurlHeaderList(envP, authHdrValue,
                                      dontAdvertise, userAgent,
+                                     !!transP->compressedPostDataP,
+                                     curlSetupP->timeout,
                                      &headerList);
                 if (!envP->fault_occurred) {
                     curl_easy_setopt(
@@ -901,8 +1074,12 @@ curlTransaction_create(xmlrpc_env *               const envP,
                              serverP, dontAdvertise, userAgent,
                              curlSetupStuffP);
 
-            if (envP->fault_occurred)
+            if (envP->fault_occurred) {
+                if (curlTransactionP->compressedPostDataP)
+                    XMLRPC_MEMBLOCK_FREE(
+                        char, curlTransactionP->compressedPostDataP);
                 xmlrpc_strfree(curlTransactionP->serverUrl);
+            }
         }
         if (envP->fault_occurred)
             free(curlTransactionP);
@@ -916,6 +1093,8 @@ void
 curlTransaction_destroy(curlTransaction * const curlTransactionP) {
 
     curl_slist_free_all(curlTransactionP->headerList);
+    if (curlTransactionP->compressedPostDataP)
+        XMLRPC_MEMBLOCK_FREE(char, curlTransactionP->compressedPostDataP);
     xmlrpc_strfree(curlTransactionP->serverUrl);
 
     free(curlTransactionP);
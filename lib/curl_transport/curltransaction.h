@@ -95,6 +95,16 @@ struct curlSetup {
     unsigned int tcpKeepidle;
     unsigned int tcpKeepintvl;
 
+    unsigned int compressLevel;
+        /* 0 = send the call as is.  Otherwise, the zlib level at which to
+           gzip it, if it is at least 'compressMinSize' bytes.
+        */
+    size_t       compressMinSize;
+    bool         acceptCompressed;
+        /* Tell the server we accept a compressed response (Curl inflates
+           it)
+        */
+
     bool verbose;
 };
 
@@ -26,6 +26,13 @@
   #define HAVE_CURL_KEEPALIVE 0
 #endif
 
+#if CMAJOR > 7 || (CMAJOR == 7 && CMINOR >= 22)
+  /* CURLOPT_ACCEPT_ENCODING is 7.21.6; CURLOPT_ENCODING before that */
+  #define HAVE_CURL_ACCEPT_ENCODING 1
+#else
+  #define HAVE_CURL_ACCEPT_ENCODING 0
+#endif
+
 #undef CMAJOR
 #undef CMINOR
 
@@ -733,6 +733,32 @@ getConnectTimeoutParm(
 
 
 
+static void
+getCompressLevelParm(
+    xmlrpc_env *                          const envP,
+    const struct xmlrpc_curl_xportparms * const curlXportParmsP,
+    size_t                                const parmSize,
+    unsigned int *                        const compressLevelP) {
+
+    if (!curlXportParmsP || parmSize < XMLRPC_CXPSIZE(compress_level))
+        *compressLevelP = 0;
+    else {
+        unsigned int const compressLevel = curlXportParmsP->compress_level;
+
+        if (compressLevel > 0 && !HAVE_ZLIB_H)
+            xmlrpc_faultf(envP, "You cannot specify a 'compress_level' "
+                          "parameter because this Xmlrpc-c was built "
+                          "without zlib");
+        else if (compressLevel > 9)
+            xmlrpc_faultf(envP, "'compress_level' must be 0-9.  "
+                          "You specified %u", compressLevel);
+        else
+            *compressLevelP = compressLevel;
+    }
+}
+
+
+
 static void
 setVerbose(bool * const verboseP) {
 
@@ -961,6 +987,20 @@ getXportParms(xmlrpc_env *                          const envP,
         curlSetupP->tcpKeepintvl = 0;
     else
         curlSetupP->tcpKeepintvl = curlXportParmsP->tcp_keepintvl_sec;
+
+    getCompressLevelParm(envP, curlXportParmsP, parmSize,
+                         &curlSetupP->compressLevel);
+
+    if (!curlXportParmsP || parmSize < XMLRPC_CXPSIZE(compress_min_size) ||
+        curlXportParmsP->compress_min_size == 0)
+        curlSetupP->compressMinSize = 1024;
+    else
+        curlSetupP->compressMinSize = curlXportParmsP->compress_min_size;
+
+    if (!curlXportParmsP || parmSize < XMLRPC_CXPSIZE(accept_compressed))
+        curlSetupP->acceptCompressed = false;
+    else
+        curlSetupP->acceptCompressed = !!curlXportParmsP->accept_compressed;
 }
 
 
@@ -0,0 +1,639 @@
+/*=============================================================================
+                                  thread
+===============================================================================
+
+  This module provides a minimal thread facility appropriate for the platform
+  for which Xmlrpc-c is being built.  I.e. services chosen by the build
+  configuration.
+
+  A thread runs a function of the creator's choosing.  The creator must
+  eventually join the thread, which waits for the function to return and
+  releases the thread's resources.
+
+  An event lets threads wait until another thread says something has
+  happened.  It is set only once and never reset.
+
+  A queue passes pointers from threads that produce work to threads that
+  consume it, with at most a fixed number waiting in between.  A thread
+  that can't proceed because the queue is full or empty sleeps on a
+  condition variable until another thread changes that.
+
+  A thread-local slot is a POSIX thread-specific data key or a Windows TLS
+  index.  Windows doesn't tell us when a thread exits, so there we can't
+  destroy a thread's value when it does; with POSIX threads we can.
+
+============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#if HAVE_PTHREAD
+#include <pthread.h>
+#elif HAVE_WINDOWS_THREAD
+#define WIN32_WIN_LEAN_AND_MEAN
+#include <windows.h>
+#include <process.h>
+#endif
+
+#include "bool.h"
+#include "mallocvar.h"
+
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/thread_int.h"
+
+struct xmlrpc_thread {
+#if HAVE_PTHREAD
+    pthread_t thread;
+#elif HAVE_WINDOWS_THREAD
+    HANDLE handle;
+#endif
+    xmlrpc_threadFn * func;
+    void * arg;
+};
+
+struct xmlrpc_event {
+#if HAVE_PTHREAD
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+#elif HAVE_WINDOWS_THREAD
+    HANDLE handle;
+#endif
+    int isSet;
+};
+
+struct xmlrpc_queue {
+#if HAVE_PTHREAD
+    pthread_mutex_t mutex;
+    pthread_cond_t  notEmpty;
+    pthread_cond_t  notFull;
+#elif HAVE_WINDOWS_THREAD
+    CRITICAL_SECTION   mutex;
+    CONDITION_VARIABLE notEmpty;
+    CONDITION_VARIABLE notFull;
+#endif
+    void ** items;
+        /* Circular buffer of 'capacity' entries */
+    unsigned int capacity;
+    unsigned int head;
+        /* Index in items[] of the oldest item */
+    unsigned int count;
+        /* Number of items in the queue */
+    bool closed;
+};
+
+struct xmlrpc_tls {
+#if HAVE_PTHREAD
+    pthread_key_t key;
+#elif HAVE_WINDOWS_THREAD
+    DWORD index;
+#else
+    void * value;
+        /* With no threads, the one and only thread's value */
+#endif
+};
+
+#if HAVE_PTHREAD || HAVE_WINDOWS_THREAD
+  #define CAN_WAIT true
+#else
+  /* Waiting for a queue to change would be forever, as there's no other
+     thread to change it.
+  */
+  #define CAN_WAIT false
+#endif
+
+
+
+#if HAVE_PTHREAD
+static void *
+threadStart(void * const arg) {
+
+    struct xmlrpc_thread * const threadP = arg;
+
+    threadP->func(threadP->arg);
+
+    return NULL;
+}
+#elif HAVE_WINDOWS_THREAD
+static unsigned int __stdcall
+threadStart(void * const arg) {
+
+    struct xmlrpc_thread * const threadP = arg;
+
+    threadP->func(threadP->arg);
+
+    return 0;
+}
+#endif
+
+
+
+void
+xmlrpc_thread_create(struct xmlrpc_thread ** const threadPP,
+                     xmlrpc_threadFn *       const func,
+                     void *                  const arg,
+                     const char **           const errorP) {
+/*----------------------------------------------------------------------------
+   Create a thread that runs func(arg).  The thread starts right away.
+-----------------------------------------------------------------------------*/
+    struct xmlrpc_thread * threadP;
+
+    MALLOCVAR(threadP);
+
+    if (!threadP)
+        xmlrpc_asprintf(errorP, "Can't allocate memory for thread descriptor");
+    else {
+        threadP->func = func;
+        threadP->arg  = arg;
+
+#if HAVE_PTHREAD
+        {
+            int const rc =
+                pthread_create(&threadP->thread, NULL, &threadStart, threadP);
+            if (rc != 0)
+                xmlrpc_asprintf(errorP,
+                                "pthread_create() failed, errno = %d (%s)",
+                                rc, strerror(rc));
+            else
+                *errorP = NULL;
+        }
+#elif HAVE_WINDOWS_THREAD
+        {
+            unsigned int threadId;
+
+            threadP->handle = (HANDLE)
+                _beginthreadex(NULL, 0, &threadStart, threadP, 0, &threadId);
+
+            if (threadP->handle == NULL)
+                xmlrpc_asprintf(errorP, "_beginthreadex() failed, "
+                                "errno = %d (%s)", errno, strerror(errno));
+            else
+                *errorP = NULL;
+        }
+#else
+        xmlrpc_asprintf(errorP, "This Xmlrpc-c library was built without "
+                        "any thread facility");
+#endif
+        if (*errorP)
+            free(threadP);
+        else
+            *threadPP = threadP;
+    }
+}
+
+
+
+void
+xmlrpc_thread_join(struct xmlrpc_thread * const threadP) {
+/*----------------------------------------------------------------------------
+   Wait for thread *threadP to finish, then destroy it.
+-----------------------------------------------------------------------------*/
+#if HAVE_PTHREAD
+    pthread_join(threadP->thread, NULL);
+#elif HAVE_WINDOWS_THREAD
+    WaitForSingleObject(threadP->handle, INFINITE);
+    CloseHandle(threadP->handle);
+#endif
+    free(threadP);
+}
+
+
+
+void
+xmlrpc_event_create(struct xmlrpc_event ** const eventPP,
+                    const char **          const errorP) {
+/*----------------------------------------------------------------------------
+   Create an event, not set.
+-----------------------------------------------------------------------------*/
+    struct xmlrpc_event * eventP;
+
+    MALLOCVAR(eventP);
+
+    if (!eventP)
+        xmlrpc_asprintf(errorP, "Can't allocate memory for event descriptor");
+    else {
+        eventP->isSet = 0;
+
+#if HAVE_PTHREAD
+        {
+            int const rc = pthread_mutex_init(&eventP->mutex, NULL);
+            if (rc != 0)
+                xmlrpc_asprintf(errorP, "pthread_mutex_init() failed, "
+                                "errno = %d (%s)", rc, strerror(rc));
+            else {
+                int const rc = pthread_cond_init(&eventP->cond, NULL);
+                if (rc != 0) {
+                    xmlrpc_asprintf(errorP, "pthread_cond_init() failed, "
+                                    "errno = %d (%s)", rc, strerror(rc));
+                    pthread_mutex_destroy(&eventP->mutex);
+                } else
+                    *errorP = NULL;
+            }
+        }
+#elif HAVE_WINDOWS_THREAD
+        /* Manual reset, so it wakes every waiter and stays set */
+        eventP->handle = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+        if (eventP->handle == NULL)
+            xmlrpc_asprintf(errorP, "CreateEvent() failed, "
+                            "Windows error %ld", (long)GetLastError());
+        else
+            *errorP = NULL;
+#else
+        /* With no threads, nobody can wait while it is not set */
+        *errorP = NULL;
+#endif
+        if (*errorP)
+            free(eventP);
+        else
+            *eventPP = eventP;
+    }
+}
+
+
+
+void
+xmlrpc_event_destroy(struct xmlrpc_event * const eventP) {
+
+#if HAVE_PTHREAD
+    pthread_cond_destroy(&eventP->cond);
+    pthread_mutex_destroy(&eventP->mutex);
+#elif HAVE_WINDOWS_THREAD
+    CloseHandle(eventP->handle);
+#endif
+    free(eventP);
+}
+
+
+
+void
+xmlrpc_event_set(struct xmlrpc_event * const eventP) {
+/*----------------------------------------------------------------------------
+   Set event *eventP, waking up every thread waiting for it.
+-----------------------------------------------------------------------------*/
+#if HAVE_PTHREAD
+    pthread_mutex_lock(&eventP->mutex);
+    eventP->isSet = 1;
+    pthread_cond_broadcast(&eventP->cond);
+    pthread_mutex_unlock(&eventP->mutex);
+#elif HAVE_WINDOWS_THREAD
+    eventP->isSet = 1;
+    SetEvent(eventP->handle);
+#else
+    eventP->isSet = 1;
+#endif
+}
+
+
+
+void
+xmlrpc_event_wait(struct xmlrpc_event * const eventP) {
+/*----------------------------------------------------------------------------
+   Wait until event *eventP is set.  Return immediately if it already is.
+-----------------------------------------------------------------------------*/
+#if HAVE_PTHREAD
+    pthread_mutex_lock(&eventP->mutex);
+    while (!eventP->isSet)
+        pthread_cond_wait(&eventP->cond, &eventP->mutex);
+    pthread_mutex_unlock(&eventP->mutex);
+#elif HAVE_WINDOWS_THREAD
+    WaitForSingleObject(eventP->handle, INFINITE);
+#endif
+}
+
+
+
+void
+xmlrpc_queue_create(struct xmlrpc_queue ** const queuePP,
+                    unsigned int           const capacity,
+                    const char **          const errorP) {
+/*----------------------------------------------------------------------------
+   Create an empty queue that can hold 'capacity' items.  'capacity' must
+   be at least 1.
+-----------------------------------------------------------------------------*/
+    struct xmlrpc_queue * queueP;
+
+    assert(capacity >= 1);
+
+    MALLOCVAR(queueP);
+
+    if (!queueP)
+        xmlrpc_asprintf(errorP, "Can't allocate memory for queue descriptor");
+    else {
+        MALLOCARRAY(queueP->items, capacity);
+
+        if (!queueP->items)
+            xmlrpc_asprintf(errorP, "Can't allocate memory for a queue of "
+                            "%u items", capacity);
+        else {
+            queueP->capacity = capacity;
+            queueP->head     = 0;
+            queueP->count    = 0;
+            queueP->closed   = false;
+
+#if HAVE_PTHREAD
+            {
+                int const rc = pthread_mutex_init(&queueP->mutex, NULL);
+                if (rc != 0)
+                    xmlrpc_asprintf(errorP, "pthread_mutex_init() failed, "
+                                    "errno = %d (%s)", rc, strerror(rc));
+                else {
+                    pthread_cond_init(&queueP->notEmpty, NULL);
+                    pthread_cond_init(&queueP->notFull, NULL);
+                    *errorP = NULL;
+                }
+            }
+#elif HAVE_WINDOWS_THREAD
+            InitializeCriticalSection(&queueP->mutex);
+            InitializeConditionVariable(&queueP->notEmpty);
+            InitializeConditionVariable(&queueP->notFull);
+            *errorP = NULL;
+#else
+            *errorP = NULL;
+#endif
+            if (*errorP)
+                free(queueP->items);
+        }
+        if (*errorP)
+            free(queueP);
+        else
+            *queuePP = queueP;
+    }
+}
+
+
+
+void
+xmlrpc_queue_destroy(struct xmlrpc_queue * const queueP) {
+/*----------------------------------------------------------------------------
+   Destroy queue *queueP.  Nobody may be waiting on it.  Any items still in
+   it are simply forgotten.
+-----------------------------------------------------------------------------*/
+#if HAVE_PTHREAD
+    pthread_cond_destroy(&queueP->notFull);
+    pthread_cond_destroy(&queueP->notEmpty);
+    pthread_mutex_destroy(&queueP->mutex);
+#elif HAVE_WINDOWS_THREAD
+    DeleteCriticalSection(&queueP->mutex);
+#endif
+    free(queueP->items);
+    free(queueP);
+}
+
+
+
+static void
+lockQueue(struct xmlrpc_queue * const queueP) {
+
+#if HAVE_PTHREAD
+    pthread_mutex_lock(&queueP->mutex);
+#elif HAVE_WINDOWS_THREAD
+    EnterCriticalSection(&queueP->mutex);
+#endif
+}
+
+
+
+static void
+unlockQueue(struct xmlrpc_queue * const queueP) {
+
+#if HAVE_PTHREAD
+    pthread_mutex_unlock(&queueP->mutex);
+#elif HAVE_WINDOWS_THREAD
+    LeaveCriticalSection(&queueP->mutex);
+#endif
+}
+
+
+
+static void
+waitNotEmpty(struct xmlrpc_queue * const queueP) {
+
+#if HAVE_PTHREAD
+    pthread_cond_wait(&queueP->notEmpty, &queueP->mutex);
+#elif HAVE_WINDOWS_THREAD
+    SleepConditionVariableCS(&queueP->notEmpty, &queueP->mutex, INFINITE);
+#endif
+}
+
+
+
+static void
+waitNotFull(struct xmlrpc_queue * const queueP) {
+
+#if HAVE_PTHREAD
+    pthread_cond_wait(&queueP->notFull, &queueP->mutex);
+#elif HAVE_WINDOWS_THREAD
+    SleepConditionVariableCS(&queueP->notFull, &queueP->mutex, INFINITE);
+#endif
+}
+
+
+
+static void
+signalNotEmpty(struct xmlrpc_queue * const queueP) {
+
+#if HAVE_PTHREAD
+    pthread_cond_signal(&queueP->notEmpty);
+#elif HAVE_WINDOWS_THREAD
+    WakeConditionVariable(&queueP->notEmpty);
+#endif
+}
+
+
+
+static void
+signalNotFull(struct xmlrpc_queue * const queueP) {
+
+#if HAVE_PTHREAD
+    pthread_cond_signal(&queueP->notFull);
+#elif HAVE_WINDOWS_THREAD
+    WakeConditionVariable(&queueP->notFull);
+#endif
+}
+
+
+
+void
+xmlrpc_queue_put(struct xmlrpc_queue * const queueP,
+                 void *                const item,
+                 bool *                const closedP) {
+/*----------------------------------------------------------------------------
+   Add 'item' to the tail of queue *queueP, waiting first if necessary until
+   there is room for it.
+
+   If the queue is closed (before or while we wait), don't add it and
+   return *closedP true.
+-----------------------------------------------------------------------------*/
+    lockQueue(queueP);
+
+    while (queueP->count >= queueP->capacity && !queueP->closed && CAN_WAIT)
+        waitNotFull(queueP);
+
+    if (queueP->closed || queueP->count >= queueP->capacity)
+        *closedP = true;
+    else {
+        unsigned int const tail =
+            (queueP->head + queueP->count) % queueP->capacity;
+
+        queueP->items[tail] = item;
+        ++queueP->count;
+
+        *closedP = false;
+
+        signalNotEmpty(queueP);
+    }
+    unlockQueue(queueP);
+}
+
+
+
+void
+xmlrpc_queue_get(struct xmlrpc_queue * const queueP,
+                 void **               const itemP,
+                 bool *                const closedP) {
+/*----------------------------------------------------------------------------
+   Remove the item at the head of queue *queueP and return it as *itemP,
+   waiting first if necessary until there is one.
+
+   If the queue is closed and empty (before or while we wait), return
+   *closedP true and nothing as *itemP.  Items already in the queue when
+   it gets closed are still available.
+-----------------------------------------------------------------------------*/
+    lockQueue(queueP);
+
+    while (queueP->count == 0 && !queueP->closed && CAN_WAIT)
+        waitNotEmpty(queueP);
+
+    if (queueP->count == 0)
+        *closedP = true;
+    else {
+        *itemP = queueP->items[queueP->head];
+        queueP->head = (queueP->head + 1) % queueP->capacity;
+        --queueP->count;
+
+        *closedP = false;
+
+        signalNotFull(queueP);
+    }
+    unlockQueue(queueP);
+}
+
+
+
+void
+xmlrpc_queue_close(struct xmlrpc_queue * const queueP) {
+/*----------------------------------------------------------------------------
+   Close queue *queueP: nothing more can be put in it, and every thread
+   waiting to put or to get from an empty queue stops waiting.
+-----------------------------------------------------------------------------*/
+    lockQueue(queueP);
+
+    queueP->closed = true;
+
+#if HAVE_PTHREAD
+    pthread_cond_broadcast(&queueP->notEmpty);
+    pthread_cond_broadcast(&queueP->notFull);
+#elif HAVE_WINDOWS_THREAD
+    WakeAllConditionVariable(&queueP->notEmpty);
+    WakeAllConditionVariable(&queueP->notFull);
+#endif
+
+    unlockQueue(queueP);
+}
+
+
+
+void
+xmlrpc_tls_create(struct xmlrpc_tls ** const tlsPP,
+                  xmlrpc_tlsDestroyFn *const destroy,
+                  const char **        const errorP) {
+/*----------------------------------------------------------------------------
+   Create a thread-local slot.  When a thread that has a non-NULL value in
+   it exits, we call destroy(value), if 'destroy' is non-NULL and the
+   platform lets us.
+-----------------------------------------------------------------------------*/
+    struct xmlrpc_tls * tlsP;
+
+    MALLOCVAR(tlsP);
+
+    if (!tlsP)
+        xmlrpc_asprintf(errorP, "Can't allocate memory for thread-local "
+                        "slot descriptor");
+    else {
+#if HAVE_PTHREAD
+        int const rc = pthread_key_create(&tlsP->key, destroy);
+        if (rc != 0)
+            xmlrpc_asprintf(errorP, "pthread_key_create() failed, "
+                            "errno = %d (%s)", rc, strerror(rc));
+        else
+            *errorP = NULL;
+#elif HAVE_WINDOWS_THREAD
+        tlsP->index = TlsAlloc();
+        if (tlsP->index == TLS_OUT_OF_INDEXES)
+            xmlrpc_asprintf(errorP, "TlsAlloc() failed, "
+                            "Windows error %ld", (long)GetLastError());
+        else
+            *errorP = NULL;
+#else
+        tlsP->value = NULL;
+        *errorP = NULL;
+#endif
+        if (*errorP)
+            free(tlsP);
+        else
+            *tlsPP = tlsP;
+    }
+}
+
+
+
+void
+xmlrpc_tls_destroy(struct xmlrpc_tls * const tlsP) {
+/*----------------------------------------------------------------------------
+   Destroy thread-local slot *tlsP.  We don't destroy any values still in
+   it; Caller must take care of those.
+-----------------------------------------------------------------------------*/
+#if HAVE_PTHREAD
+    pthread_key_delete(tlsP->key);
+#elif HAVE_WINDOWS_THREAD
+    TlsFree(tlsP->index);
+#endif
+    free(tlsP);
+}
+
+
+
+void *
+xmlrpc_tls_get(struct xmlrpc_tls * const tlsP) {
+/*----------------------------------------------------------------------------
+   The calling thread's value in thread-local slot *tlsP.
+-----------------------------------------------------------------------------*/
+#if HAVE_PTHREAD
+    return pthread_getspecific(tlsP->key);
+#elif HAVE_WINDOWS_THREAD
+    return TlsGetValue(tlsP->index);
+#else
+    return tlsP->value;
+#endif
+}
+
+
+
+void
+xmlrpc_tls_set(struct xmlrpc_tls * const tlsP,
+               void *              const value) {
+/*----------------------------------------------------------------------------
+   Make 'value' the calling thread's value in thread-local slot *tlsP.
+-----------------------------------------------------------------------------*/
+#if HAVE_PTHREAD
+    pthread_setspecific(tlsP->key, value);
+#elif HAVE_WINDOWS_THREAD
+    TlsSetValue(tlsP->index, value);
+#else
+    tlsP->value = value;
+#endif
+}
@@ -78,6 +78,37 @@ xmlrpc_gettimeofday(xmlrpc_timespec * const todP) {
 
 
 
+uint64_t
+xmlrpc_monotonic_ms(void) {
+/*----------------------------------------------------------------------------
+   A count of milliseconds from some arbitrary point, for measuring
+   intervals and setting deadlines within this process.  Unlike the time
+   of day, it doesn't jump when someone sets the system clock.
+
+   Where the system has no monotonic clock, this is the time of day.
+-----------------------------------------------------------------------------*/
+    uint64_t retval;
+
+#if MSVCRT
+    retval = GetTickCount64();
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    retval = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+#else
+    xmlrpc_timespec now;
+
+    xmlrpc_gettimeofday(&now);
+
+    retval = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+#endif
+    return retval;
+}
+
+
+
 static bool
 isLeapYear(unsigned int const yearOfAd) {
 
@@ -0,0 +1,89 @@
+#ifndef XMLRPC_ATOMIC_H_INCLUDED
+#define XMLRPC_ATOMIC_H_INCLUDED
+
+/*============================================================================
+  Atomic memory operations, for data that threads share without a lock.
+
+  All of these are sequentially consistent: every thread sees all of them
+  happen in the same order, and in program order within each thread.
+
+  Increment and decrement return the new value.
+============================================================================*/
+
+#include "inline.h"
+
+#if defined(__GNUC__)
+
+static __inline__ long
+xmlrpc_atomicLoad(long volatile * const valueP) {
+    return __atomic_load_n(valueP, __ATOMIC_SEQ_CST);
+}
+
+static __inline__ void
+xmlrpc_atomicStore(long volatile * const valueP,
+                   long            const value) {
+    __atomic_store_n(valueP, value, __ATOMIC_SEQ_CST);
+}
+
+static __inline__ long
+xmlrpc_atomicIncrement(long volatile * const valueP) {
+    return __atomic_add_fetch(valueP, 1, __ATOMIC_SEQ_CST);
+}
+
+static __inline__ long
+xmlrpc_atomicDecrement(long volatile * const valueP) {
+    return __atomic_sub_fetch(valueP, 1, __ATOMIC_SEQ_CST);
+}
+
+static __inline__ void *
+xmlrpc_atomicLoadPtr(void * volatile * const pointerP) {
+    return __atomic_load_n(pointerP, __ATOMIC_SEQ_CST);
+}
+
+static __inline__ void
+xmlrpc_atomicStorePtr(void * volatile * const pointerP,
+                      void *            const pointer) {
+    __atomic_store_n(pointerP, pointer, __ATOMIC_SEQ_CST);
+}
+
+#elif defined(_WIN32)
+
+#include <windows.h>
+
+static __inline long
+xmlrpc_atomicLoad(long volatile * const valueP) {
+    return InterlockedCompareExchange(valueP, 0, 0);
+}
+
+static __inline void
+xmlrpc_atomicStore(long volatile * const valueP,
+                   long            const value) {
+    InterlockedExchange(valueP, value);
+}
+
+static __inline long
+xmlrpc_atomicIncrement(long volatile * const valueP) {
+    return InterlockedIncrement(valueP);
+}
+
+static __inline long
+xmlrpc_atomicDecrement(long volatile * const valueP) {
+    return InterlockedDecrement(valueP);
+}
+
+static __inline void *
+xmlrpc_atomicLoadPtr(void * volatile * const pointerP) {
+    return InterlockedCompareExchangePointer(pointerP, NULL, NULL);
+}
+
+static __inline void
+xmlrpc_atomicStorePtr(void * volatile * const pointerP,
+                      void *            const pointer) {
+    InterlockedExchangePointer(pointerP, pointer);
+}
+
+#else
+  #error "Don't know how to do atomic operations with this compiler"
+#endif
+
+#endif
@@ -10,19 +10,31 @@
 #include <errno.h>
 #include <time.h>
 #include <fcntl.h>
+#include <ctype.h>
+#if HAVE_ZLIB_H
+  #include <zlib.h>
+#endif
 
 #include "bool.h"
 #include "int.h"
 #include "mallocvar.h"
+#include "girmath.h"
 #include "xmlrpc-c/abyss.h"
 
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
+#include "xmlrpc-c/server_abyss.h"
 #include "xmlrpc-c/base_int.h"
 #include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/thread_int.h"
 
 #include "abyss_handler.h"
 
+/* We compress a response body this much at a time, sending each piece as
+   an HTTP chunk as soon as zlib produces it.
+*/
+#define COMPRESS_BUFFER_SIZE 16384
+
 
 
 static const char * trace_abyss;
@@ -56,13 +68,224 @@ addAuthCookie(xmlrpc_env * const envP,
 
 
 
+static bool
+tokenIs(const char * const token,
+        size_t       const tokenLen,
+        const char * const word) {
+/*----------------------------------------------------------------------------
+   The 'tokenLen'-byte token at 'token' is 'word', ignoring case.  'word'
+   is lower case.
+-----------------------------------------------------------------------------*/
+    bool matches;
+    size_t i;
+
+    for (i = 0, matches = (strlen(word) == tokenLen);
+         i < tokenLen && matches;
+         ++i)
+        matches = (tolower((unsigned char)token[i]) == word[i]);
+
+    return matches;
+}
+
+
+
+static bool
+qualityIsZero(const char * const parms,
+              const char * const parmsEnd) {
+/*----------------------------------------------------------------------------
+   The parameters of an Accept-Encoding element (e.g. ";q=0"), which are
+   the text from 'parms' to 'parmsEnd', give it quality zero, which means
+   the client does not accept that coding.
+-----------------------------------------------------------------------------*/
+    const char * const semicolon = memchr(parms, ';', parmsEnd - parms);
+
+    bool retval;
+
+    if (!semicolon)
+        retval = false;
+    else {
+        const char * const parm = semicolon + 1 + strspn(semicolon + 1, " \t");
+
+        if (parm + 2 <= parmsEnd && tolower((unsigned char)parm[0]) == 'q' &&
+            parm[1] == '=')
+            retval = (strtod(&parm[2], NULL) == 0);
+        else
+            retval = false;
+    }
+    return retval;
+}
+
+
+
+static bool
+acceptsCoding(const char * const acceptEncoding,
+              const char * const coding) {
+/*----------------------------------------------------------------------------
+   The Accept-Encoding header field value 'acceptEncoding' (e.g.
+   "gzip, deflate;q=0.5") names content coding 'coding' (e.g. "gzip"), and
+   not with quality zero.
+-----------------------------------------------------------------------------*/
+    const char * p;
+    bool accepts;
+
+    for (p = acceptEncoding, accepts = false; *p && !accepts; ) {
+        const char * const elementEnd = p + strcspn(p, ",");
+        const char * const name = p + strspn(p, " \t");
+        size_t const nameLen = strcspn(name, " \t;,");
+
+        if (tokenIs(name, nameLen, coding))
+            accepts = !qualityIsZero(name + nameLen, elementEnd);
+
+        p = *elementEnd ? elementEnd + 1 : elementEnd;
+    }
+    return accepts;
+}
+
+
+
+static const char *
+responseCoding(TSession *   const abyssSessionP,
+               size_t       const len,
+               unsigned int const compressLevel,
+               size_t       const compressMinSize) {
+/*----------------------------------------------------------------------------
+   The content coding ("gzip" or "deflate") in which to send a response body
+   of 'len' bytes to the client of session 'abyssSessionP', or NULL to send
+   it as is.
+
+   We compress only when we can chunk the response (HTTP 1.1), because
+   otherwise we would have to compress the whole body before sending any of
+   it, to know its Content-Length.
+-----------------------------------------------------------------------------*/
+    const char * coding;
+
+    coding = NULL;  /* initial assumption */
+
+    if (HAVE_ZLIB_H && compressLevel > 0 && len >= compressMinSize) {
+        const char * const acceptEncoding =
+            RequestHeaderValue(abyssSessionP, "accept-encoding");
+
+        unsigned int httpMajor, httpMinor;
+
+        SessionGetHttpVersion(abyssSessionP, &httpMajor, &httpMinor);
+
+        if (acceptEncoding &&
+            (httpMajor > 1 || (httpMajor == 1 && httpMinor >= 1))) {
+            if (acceptsCoding(acceptEncoding, "gzip"))
+                coding = "gzip";
+            else if (acceptsCoding(acceptEncoding, "deflate"))
+                coding = "deflate";
+        }
+    }
+    return coding;
+}
+
+
+
+static void
+sendPlainBody(TSession *   const abyssSessionP,
+              const char * const body,
+              uint32_t     const len) {
+
+    ResponseContentLength(abyssSessionP, len);
+
+    ResponseWriteStart(abyssSessionP);
+    ResponseWriteBody(abyssSessionP, body, len);
+    ResponseWriteEnd(abyssSessionP);
+}
+
+
+
+#if HAVE_ZLIB_H
+
+static void
+sendCompressedBody(TSession *   const abyssSessionP,
+                   const char * const body,
+                   uint32_t     const len,
+                   unsigned int const compressLevel,
+                   const char * const coding) {
+/*----------------------------------------------------------------------------
+   Send 'body' compressed in content coding 'coding', as a chunked response.
+
+   We compress a piece at a time into a buffer on the stack and send each
+   piece as soon as we have it, so the compressed body never exists in
+   memory all at once.
+
+   If we can't get a compressor (no memory), we just send the body as is.
+-----------------------------------------------------------------------------*/
+    int const windowBits = xmlrpc_streq(coding, "gzip") ? 15 + 16 : 15;
+        /* 16 added means gzip wrapper instead of zlib */
+
+    z_stream zs;
+    int rc;
+
+    zs.zalloc = Z_NULL;
+    zs.zfree  = Z_NULL;
+    zs.opaque = Z_NULL;
+
+    rc = deflateInit2(&zs, compressLevel, Z_DEFLATED, windowBits, 8,
+                      Z_DEFAULT_STRATEGY);
+
+    if (rc != Z_OK)
+        sendPlainBody(abyssSessionP, body, len);
+    else {
+        bool succeeded;
+
+        ResponseChunked(abyssSessionP);
+        ResponseAddField(abyssSessionP, "Content-Encoding", coding);
+
+        ResponseWriteStart(abyssSessionP);
+
+        zs.next_in  = (Bytef *)body;
+        zs.avail_in = len;
+
+        for (rc = Z_OK, succeeded = true; rc == Z_OK && succeeded; ) {
+            unsigned char compressed[COMPRESS_BUFFER_SIZE];
+
+            zs.next_out  = compressed;
+            zs.avail_out = sizeof(compressed);
+
+            rc = deflate(&zs, Z_FINISH);
+
+            if (zs.avail_out < sizeof(compressed))
+                succeeded = ResponseWriteBody(
+                    abyssSessionP, (const char *)compressed,
+                    sizeof(compressed) - zs.avail_out);
+        }
+        if (succeeded)
+            ResponseWriteEnd(abyssSessionP);
+
+        deflateEnd(&zs);
+    }
+}
+
+#else
+
+static void
+sendCompressedBody(TSession *   const abyssSessionP,
+                   const char * const body,
+                   uint32_t     const len,
+                   unsigned int const compressLevel ATTR_UNUSED,
+                   const char * const coding ATTR_UNUSED) {
+
+    /* responseCoding() never chooses a coding without zlib */
+
+    sendPlainBody(abyssSessionP, body, len);
+}
+
+#endif
+
+
+
 static void
 sendResponse(xmlrpc_env *      const envP,
              TSession *        const abyssSessionP,
              const char *      const body,
              size_t            const len,
              bool              const chunked,
-             ResponseAccessCtl const accessControl) {
+             ResponseAccessCtl const accessControl,
+             unsigned int      const compressLevel,
+             size_t            const compressMinSize) {
 /*----------------------------------------------------------------------------
    Generate an HTTP response containing body 'body' of length 'len'
    characters.
@@ -71,6 +294,9 @@ sendResponse(xmlrpc_env *      const envP,
    Abyss session 'abyssSessionP'.
 
    'chunked' means to make it a chunked response if possible.
+
+   'compressLevel' nonzero means to compress a body of at least
+   'compressMinSize' bytes at that zlib level, if the client accepts it.
 -----------------------------------------------------------------------------*/
     const char * http_cookie = NULL;
         /* This used to set http_cookie to getenv("HTTP_COOKIE"), but
@@ -102,15 +328,24 @@ sendResponse(xmlrpc_env *      const envP,
                       "large for Abyss to send");
     else {
         uint32_t const abyssLen = (uint32_t)len;
+        const char * const coding =
+            responseCoding(abyssSessionP, len, compressLevel, compressMinSize);
 
         /* See discussion below of quotes around "utf-8" */
         ResponseContentType(abyssSessionP, "text/xml; charset=utf-8");
-        ResponseContentLength(abyssSessionP, abyssLen);
         ResponseAccessControl(abyssSessionP, accessControl);
 
-        ResponseWriteStart(abyssSessionP);
-        ResponseWriteBody(abyssSessionP, body, abyssLen);
-        ResponseWriteEnd(abyssSessionP);
+        if (compressLevel > 0)
+            /* Whether we compress depends on the client's Accept-Encoding,
+               which a cache between us and the client must know.
+            */
+            ResponseAddField(abyssSessionP, "Vary", "Accept-Encoding");
+
+        if (coding)
+            sendCompressedBody(abyssSessionP, body, abyssLen,
+                               compressLevel, coding);
+        else
+            sendPlainBody(abyssSessionP, body, abyssLen);
     }
 }
 
@@ -147,80 +382,428 @@ sendError(TSession *   const abyssSessionP,
 
 
 static void
-traceChunkRead(TSession * const abyssSessionP) {
+sendFault(TSession *         const abyssSessionP,
+          const xmlrpc_env * const faultP) {
+/*----------------------------------------------------------------------------
+  Send an error response for failure *faultP to process an RPC.
+-----------------------------------------------------------------------------*/
+    uint16_t httpResponseStatus;
 
-    fprintf(stderr, "XML-RPC handler got a chunk of %u bytes\n",
-            (unsigned int)SessionReadDataAvail(abyssSessionP));
+    if (faultP->fault_code == XMLRPC_TIMEOUT_ERROR)
+        httpResponseStatus = 408;  /* Request Timeout */
+    else if (faultP->fault_code == XMLRPC_PARSE_ERROR)
+        httpResponseStatus = 400;  /* Bad Request (bad compression) */
+    else
+        httpResponseStatus = 500;  /* Internal Server Error */
+
+    sendError(abyssSessionP, httpResponseStatus, faultP->fault_string);
 }
 
 
 
+struct deferredResponse {
+/*----------------------------------------------------------------------------
+   What we need to send the response to an RPC whose response Abyss lets
+   us defer, whenever the XML processor delivers it.
+-----------------------------------------------------------------------------*/
+    TSession *        abyssSessionP;
+    bool              wantChunk;
+    ResponseAccessCtl accessControl;
+    unsigned int      compressLevel;
+    size_t            compressMinSize;
+};
+
+
+
 static void
-refillBufferFromConnection(xmlrpc_env * const envP,
-                           TSession *   const abyssSessionP,
-                           const char * const trace) {
+sendDeferredResponse(const xmlrpc_env * const envP,
+                     void *             const arg,
+                     xmlrpc_mem_block * const responseXmlP) {
 /*----------------------------------------------------------------------------
-   Get the next chunk of data from the connection into the buffer.
+   Send the response the XML processor delivers for a call whose response
+   we deferred, and end the deferral.
+
+   This is an xmlrpc_registry_response_handler.  It may run in any thread.
 -----------------------------------------------------------------------------*/
-    bool succeeded;
+    struct deferredResponse * const deferredP = arg;
+    TSession * const abyssSessionP = deferredP->abyssSessionP;
 
-    succeeded = SessionRefillBuffer(abyssSessionP);
+    xmlrpc_env env;
 
-    if (!succeeded)
-        xmlrpc_env_set_fault_formatted(
-            envP, XMLRPC_TIMEOUT_ERROR, "Timed out waiting for "
-            "client to send its POST data");
+    xmlrpc_env_init(&env);
+
+    if (envP->fault_occurred)
+        xmlrpc_env_set_fault(&env, envP->fault_code, envP->fault_string);
+    else {
+        sendResponse(&env, abyssSessionP,
+                     XMLRPC_MEMBLOCK_CONTENTS(char, responseXmlP),
+                     XMLRPC_MEMBLOCK_SIZE(char, responseXmlP),
+                     deferredP->wantChunk, deferredP->accessControl,
+                     deferredP->compressLevel, deferredP->compressMinSize);
+
+        XMLRPC_MEMBLOCK_FREE(char, responseXmlP);
+    }
+    if (env.fault_occurred)
+        sendFault(abyssSessionP, &env);
+
+    xmlrpc_env_clean(&env);
+
+    free(deferredP);
+
+    SessionFinishDeferred(abyssSessionP);
+}
+
+
+
+static void
+processXmlDeferred(TSession *                  const abyssSessionP,
+                   const char *                const callXml,
+                   size_t                      const callXmlLen,
+                   xmlrpc_call_processor_async       xmlProcessorAsync,
+                   void *                      const xmlProcessorArg,
+                   bool                        const wantChunk,
+                   ResponseAccessCtl           const accessControl,
+                   unsigned int                const compressLevel,
+                   size_t                      const compressMinSize,
+                   bool *                      const deferredP) {
+/*----------------------------------------------------------------------------
+   Process the RPC 'callXml' with 'xmlProcessorAsync', deferring the response
+   until it delivers it, so a call that waits for something doesn't tie up
+   our thread.
+
+   Return *deferredP false, having done nothing, if we can't defer the
+   response.  Otherwise, the response is sent or will be, and Caller must
+   not touch the session again.
+-----------------------------------------------------------------------------*/
+    struct deferredResponse * responseP;
+
+    MALLOCVAR(responseP);
+
+    if (responseP == NULL)
+        *deferredP = false;
+    else {
+        abyss_bool deferred;
+
+        SessionDeferResponse(abyssSessionP, &deferred);
+
+        if (!deferred)
+            free(responseP);
+        else {
+            responseP->abyssSessionP   = abyssSessionP;
+            responseP->wantChunk       = wantChunk;
+            responseP->accessControl   = accessControl;
+            responseP->compressLevel   = compressLevel;
+            responseP->compressMinSize = compressMinSize;
+
+            xmlProcessorAsync(xmlProcessorArg, callXml, callXmlLen,
+                              abyssSessionP, &sendDeferredResponse, responseP);
+        }
+        *deferredP = deferred;
+    }
+}
+
+
+
+/* A body buffer bigger than this, we free after use instead of keeping it
+   for the thread's next request, so a rare huge call doesn't leave every
+   thread holding that much memory.
+*/
+#define BODY_BUFFER_CACHE_MAX (1024 * 1024)
+
+struct bodyBuffer {
+    size_t allocated;
+    char * bytes;
+};
+
+
+
+static void
+destroyBodyBuffer(void * const arg) {
+
+    struct bodyBuffer * const bufferP = arg;
+
+    free(bufferP->bytes);
+    free(bufferP);
+}
+
+
+
+static struct bodyBuffer *
+getBodyBuffer(xmlrpc_env *        const envP,
+              struct xmlrpc_tls * const bodyCacheP,
+              size_t              const size) {
+/*----------------------------------------------------------------------------
+   A buffer of at least 'size' bytes to receive a request body in.
+
+   We reuse the one this thread used for its last request if it is big
+   enough.
+-----------------------------------------------------------------------------*/
+    struct bodyBuffer * const cachedP = xmlrpc_tls_get(bodyCacheP);
+
+    struct bodyBuffer * bufferP;
+
+    if (cachedP && cachedP->allocated >= size) {
+        xmlrpc_tls_set(bodyCacheP, NULL);
+        bufferP = cachedP;
+    } else {
+        MALLOCVAR(bufferP);
+
+        if (!bufferP)
+            xmlrpc_faultf(envP, "Couldn't allocate a body buffer descriptor");
+        else {
+            bufferP->bytes = malloc(size);
+
+            if (!bufferP->bytes) {
+                xmlrpc_faultf(envP, "Couldn't allocate a %lu-byte buffer "
+                              "for the request body", (unsigned long)size);
+                free(bufferP);
+            } else
+                bufferP->allocated = size;
+        }
+    }
+    return bufferP;
+}
+
+
+
+static void
+releaseBodyBuffer(struct xmlrpc_tls * const bodyCacheP,
+                  struct bodyBuffer * const bufferP) {
+
+    if (bufferP->allocated > BODY_BUFFER_CACHE_MAX)
+        destroyBodyBuffer(bufferP);
     else {
-        if (trace)
-            traceChunkRead(abyssSessionP);
+        struct bodyBuffer * const cachedP = xmlrpc_tls_get(bodyCacheP);
+
+        if (cachedP)
+            destroyBodyBuffer(cachedP);
+
+        xmlrpc_tls_set(bodyCacheP, bufferP);
     }
 }
 
 
 
 static void
-getBody(xmlrpc_env *        const envP,
-        TSession *          const abyssSessionP,
-        size_t              const contentSize,
-        const char *        const trace,
-        xmlrpc_mem_block ** const bodyP) {
+getBody(xmlrpc_env *         const envP,
+        TSession *           const abyssSessionP,
+        struct xmlrpc_tls *  const bodyCacheP,
+        size_t               const contentSize,
+        const char *         const trace,
+        struct bodyBuffer ** const bodyPP) {
 /*----------------------------------------------------------------------------
    Get the entire body, which is of size 'contentSize' bytes, from the
-   Abyss session and return it as the new memblock *bodyP.
+   Abyss session and return it in the new body buffer *bodyPP.
 
-   The first chunk of the body may already be in Abyss's buffer.  We
-   retrieve that before reading more.
+   We get the buffer from this thread's cache 'bodyCacheP', in one piece,
+   and have Abyss read the body straight into it.
 -----------------------------------------------------------------------------*/
-    xmlrpc_mem_block * body;
+    struct bodyBuffer * bodyP;
 
     if (trace)
         fprintf(stderr, "XML-RPC handler processing body.  "
                 "Content Size = %u bytes\n", (unsigned)contentSize);
 
-    body = xmlrpc_mem_block_new(envP, 0);
+    bodyP = getBodyBuffer(envP, bodyCacheP, contentSize);
+
     if (!envP->fault_occurred) {
-        size_t bytesRead;
+        const char * error;
+
+        SessionReadBody(abyssSessionP, contentSize, bodyP->bytes, &error);
+
+        if (error) {
+            xmlrpc_env_set_fault_formatted(
+                envP, XMLRPC_TIMEOUT_ERROR, "Failed to get the POST data "
+                "from the client.  %s", error);
+            xmlrpc_strfree(error);
+            releaseBodyBuffer(bodyCacheP, bodyP);
+        }
+    }
+    *bodyPP = bodyP;
+}
+
+
+
+#if HAVE_ZLIB_H
+
+static void
+growBodyBuffer(xmlrpc_env *        const envP,
+               struct bodyBuffer * const bufferP,
+               size_t              const size) {
+
+    char * const newBytes = realloc(bufferP->bytes, size);
+
+    if (!newBytes)
+        xmlrpc_faultf(envP, "Couldn't grow the request body buffer to "
+                      "%lu bytes", (unsigned long)size);
+    else {
+        bufferP->bytes     = newBytes;
+        bufferP->allocated = size;
+    }
+}
+
 
-        bytesRead = 0;
 
-        while (!envP->fault_occurred && bytesRead < contentSize) {
-            const char * chunkPtr;
-            size_t chunkLen;
+static void
+inflateBody(xmlrpc_env *         const envP,
+            TSession *           const abyssSessionP,
+            struct xmlrpc_tls *  const bodyCacheP,
+            size_t               const contentSize,
+            const char *         const trace,
+            struct bodyBuffer ** const bodyPP,
+            size_t *             const bodyLenP) {
+/*----------------------------------------------------------------------------
+   Same as getBody(), but the body is gzip- or zlib-compressed, and we
+   return it inflated, with its inflated length as *bodyLenP.
+
+   We inflate straight out of the Abyss connection buffer a piece at a time
+   as it arrives, so the compressed body never gets copied anywhere.
 
-            SessionGetReadData(abyssSessionP, contentSize - bytesRead,
-                               &chunkPtr, &chunkLen);
-            bytesRead += chunkLen;
+   We won't inflate past the XML size limit, so a small compressed body
+   can't make us allocate an arbitrary amount of memory.
+-----------------------------------------------------------------------------*/
+    size_t const sizeLimit = xmlrpc_limit_get(XMLRPC_XML_SIZE_LIMIT_ID);
 
-            assert(bytesRead <= contentSize);
+    struct bodyBuffer * bodyP;
+    z_stream zs;
 
-            XMLRPC_MEMBLOCK_APPEND(char, envP, body, chunkPtr, chunkLen);
-            if (bytesRead < contentSize)
-                refillBufferFromConnection(envP, abyssSessionP, trace);
+    if (trace)
+        fprintf(stderr, "XML-RPC handler inflating body.  "
+                "Content Size = %u bytes\n", (unsigned)contentSize);
+
+    /* XML typically compresses 5-10 times */
+    bodyP = getBodyBuffer(envP, bodyCacheP,
+                          MIN(sizeLimit, MAX(contentSize * 8, 4096)));
+
+    if (!envP->fault_occurred) {
+        zs.zalloc   = Z_NULL;
+        zs.zfree    = Z_NULL;
+        zs.opaque   = Z_NULL;
+        zs.next_in  = Z_NULL;
+        zs.avail_in = 0;
+
+        /* 32 added means accept either gzip or zlib wrapper */
+        if (inflateInit2(&zs, 15 + 32) != Z_OK)
+            xmlrpc_faultf(envP, "Couldn't create a zlib decompressor");
+        else {
+            size_t bytesLeftCt;
+            int rc;
+
+            zs.next_out  = (Bytef *)bodyP->bytes;
+            zs.avail_out = bodyP->allocated;
+
+            for (bytesLeftCt = contentSize, rc = Z_OK;
+                 rc != Z_STREAM_END && !envP->fault_occurred; ) {
+
+                if (zs.avail_in == 0) {
+                    const char * chunk;
+                    size_t chunkLen;
+                    abyss_bool eof;
+                    const char * error;
+
+                    if (bytesLeftCt == 0)
+                        xmlrpc_env_set_fault(
+                            envP, XMLRPC_PARSE_ERROR,
+                            "Compressed body ends prematurely");
+                    else {
+                        SessionGetBody(abyssSessionP, bytesLeftCt, &eof,
+                                       &chunk, &chunkLen, &error);
+                        if (error) {
+                            xmlrpc_env_set_fault_formatted(
+                                envP, XMLRPC_TIMEOUT_ERROR,
+                                "Failed to get the POST data "
+                                "from the client.  %s", error);
+                            xmlrpc_strfree(error);
+                        } else if (eof)
+                            xmlrpc_env_set_fault(
+                                envP, XMLRPC_PARSE_ERROR,
+                                "Compressed body ends prematurely");
+                        else {
+                            zs.next_in  = (Bytef *)chunk;
+                            zs.avail_in = chunkLen;
+                            bytesLeftCt -= chunkLen;
+                        }
+                    }
+                }
+                if (!envP->fault_occurred && zs.avail_out == 0) {
+                    if (bodyP->allocated >= sizeLimit)
+                        xmlrpc_env_set_fault_formatted(
+                            envP, XMLRPC_LIMIT_EXCEEDED_ERROR,
+                            "XML-RPC request too large when inflated "
+                            "(more than %u bytes)", (unsigned)sizeLimit);
+                    else {
+                        growBodyBuffer(envP, bodyP,
+                                       MIN(sizeLimit, bodyP->allocated * 2));
+                        if (!envP->fault_occurred) {
+                            zs.next_out  = (Bytef *)
+                                &bodyP->bytes[zs.total_out];
+                            zs.avail_out =
+                                bodyP->allocated - zs.total_out;
+                        }
+                    }
+                }
+                if (!envP->fault_occurred) {
+                    rc = inflate(&zs, Z_NO_FLUSH);
+
+                    if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR)
+                        xmlrpc_env_set_fault_formatted(
+                            envP, XMLRPC_PARSE_ERROR,
+                            "Compressed body is invalid.  %s",
+                            zs.msg ? zs.msg : "");
+                }
+            }
+            if (!envP->fault_occurred) {
+                if (zs.avail_in > 0 || bytesLeftCt > 0)
+                    xmlrpc_env_set_fault(
+                        envP, XMLRPC_PARSE_ERROR,
+                        "There is junk after the compressed body");
+                else
+                    *bodyLenP = zs.total_out;
+            }
+            inflateEnd(&zs);
         }
         if (envP->fault_occurred)
-            xmlrpc_mem_block_free(body);
+            releaseBodyBuffer(bodyCacheP, bodyP);
+    }
+    *bodyPP = bodyP;
+}
+
+#endif
+
+
+
+void
+xmlrpc_initBodyCache(xmlrpc_env *         const envP,
+                     struct xmlrpc_tls ** const bodyCachePP) {
+/*----------------------------------------------------------------------------
+   Create a per-thread cache of request body buffers for a URI handler.
+-----------------------------------------------------------------------------*/
+    const char * error;
+
+    xmlrpc_tls_create(bodyCachePP, &destroyBodyBuffer, &error);
+
+    if (error) {
+        xmlrpc_faultf(envP, "Failed to create a per-thread cache for "
+                      "request bodies.  %s", error);
+        xmlrpc_strfree(error);
     }
-    *bodyP = body;
+}
+
+
+
+void
+xmlrpc_termBodyCache(struct xmlrpc_tls * const bodyCacheP) {
+/*----------------------------------------------------------------------------
+   Destroy a per-thread body buffer cache.  The calling thread's buffer
+   goes with it.  We can't get at any other thread's, so a thread that is
+   still alive keeps its buffer until it exits.
+-----------------------------------------------------------------------------*/
+    struct bodyBuffer * const cachedP = xmlrpc_tls_get(bodyCacheP);
+
+    if (cachedP)
+        destroyBodyBuffer(cachedP);
+
+    xmlrpc_tls_destroy(bodyCacheP);
 }
 
 
@@ -303,6 +886,45 @@ processContentLength(TSession *    const httpRequestP,
 
 
 
+static void
+processContentEncoding(TSession *    const httpRequestP,
+                       bool *        const compressedP,
+                       const char ** const errorP) {
+/*----------------------------------------------------------------------------
+  Find out from the content-encoding header whether the client compressed
+  the body, and make sure it is a compression we can undo.
+-----------------------------------------------------------------------------*/
+    const char * const contentEncoding =
+        RequestHeaderValue(httpRequestP, "content-encoding");
+
+    *errorP = NULL;  /* initial assumption */
+
+    if (!contentEncoding)
+        *compressedP = false;
+    else {
+        size_t const len = strlen(contentEncoding);
+
+        if (tokenIs(contentEncoding, len, "identity"))
+            *compressedP = false;
+        else if (tokenIs(contentEncoding, len, "gzip")   ||
+                 tokenIs(contentEncoding, len, "x-gzip") ||
+                 tokenIs(contentEncoding, len, "deflate")) {
+            if (HAVE_ZLIB_H)
+                *compressedP = true;
+            else
+                xmlrpc_asprintf(errorP, "This server was built without "
+                                "zlib, so it can't accept a compressed "
+                                "body (content-encoding '%s')",
+                                contentEncoding);
+        } else
+            xmlrpc_asprintf(errorP, "This server does not understand "
+                            "content-encoding '%s'.  It understands "
+                            "gzip and deflate", contentEncoding);
+    }
+}
+
+
+
 static void
 traceHandlerCalled(TSession * const abyssSessionP) {
 
@@ -339,11 +961,16 @@ traceHandlerCalled(TSession * const abyssSessionP) {
 
 static void
 processCall(TSession *            const abyssSessionP,
+            struct xmlrpc_tls *   const bodyCacheP,
             size_t                const contentSize,
+            bool                  const bodyIsCompressed,
             xmlrpc_call_processor       xmlProcessor,
+            xmlrpc_call_processor_async xmlProcessorAsync,
             void *                const xmlProcessorArg,
             bool                  const wantChunk,
             ResponseAccessCtl     const accessControl,
+            unsigned int          const compressLevel,
+            size_t                const compressMinSize,
             const char *          const trace) {
 /*----------------------------------------------------------------------------
    Handle an RPC request.  This is an HTTP request that has the proper form
@@ -352,16 +979,29 @@ processCall(TSession *            const abyssSessionP,
    We get the body of the request, which is the text of the call,
    via the Abyss session 'abyssSessionP'.
 
-   Its content length is 'contentSize' bytes.
+   Its content length is 'contentSize' bytes.  We read it into a buffer
+   from the per-thread cache 'bodyCacheP'.  'bodyIsCompressed' means it is
+   gzip- or zlib-compressed and we inflate it into that buffer instead.
 
    We send the response to the request (which may contain the RPC response,
    but may be an error indication) via the Abyss session 'abyssSessionP'.
 
    We use 'xmlProcessor', with argument 'xmlProcessorArg' to execute the
-   RPC, i.e. turn the XML-RPC call into an XML-RPC response.
+   RPC, i.e. turn the XML-RPC call into an XML-RPC response.  But if
+   'xmlProcessorAsync' is not NULL and Abyss lets us defer the response, we
+   use that instead, and may return before the response is sent.
+
+   If the time the client said it would wait for the response has run out
+   by the time we have the call, we don't execute it at all.  We don't
+   likewise refuse a call whose client seems to have closed the connection,
+   because a client that only shut down its sending side looks the same and
+   still wants the response.
 
    'wantChunk' means Caller wants the HTTP reponse chunked.
 
+   'compressLevel' and 'compressMinSize' tell when and how to compress the
+   response, as for sendResponse().
+
    We use the Abyss session's memory pool for some memory allocations -
    essentially those that aren't predictable because they depend upon the data
    from the client.  We do this because the session's memory pool has a size
@@ -380,40 +1020,70 @@ processCall(TSession *            const abyssSessionP,
             &env, XMLRPC_LIMIT_EXCEEDED_ERROR,
             "XML-RPC request too large (%u bytes)", (unsigned)contentSize);
     else {
-        xmlrpc_mem_block * body;
+        struct bodyBuffer * bodyP;
+        size_t callXmlLen;
         /* Read XML data off the wire. */
-        getBody(&env, abyssSessionP, contentSize, trace, &body);
+#if HAVE_ZLIB_H
+        if (bodyIsCompressed)
+            inflateBody(&env, abyssSessionP, bodyCacheP, contentSize, trace,
+                        &bodyP, &callXmlLen);
+        else
+#else
+        assert(!bodyIsCompressed);
+#endif
+        {
+            getBody(&env, abyssSessionP, bodyCacheP, contentSize, trace,
+                    &bodyP);
+            callXmlLen = contentSize;
+        }
         if (!env.fault_occurred) {
-            xmlrpc_mem_block * output;
-
-            /* Process the RPC. */
-            xmlProcessor(
-                &env, xmlProcessorArg,
-                XMLRPC_MEMBLOCK_CONTENTS(char, body),
-                XMLRPC_MEMBLOCK_SIZE(char, body),
-                abyssSessionP,
-                &output);
-            if (!env.fault_occurred) {
-                /* Send out the result. */
-                sendResponse(&env, abyssSessionP,
-                             XMLRPC_MEMBLOCK_CONTENTS(char, output),
-                             XMLRPC_MEMBLOCK_SIZE(char, output),
-                             wantChunk, accessControl);
-
-                XMLRPC_MEMBLOCK_FREE(char, output);
+            unsigned int msLeft;
+
+            if (xmlrpc_server_abyss_get_time_left(abyssSessionP, &msLeft)
+                && msLeft == 0)
+                /* The client has given up waiting, so don't do the work */
+                xmlrpc_env_set_fault(
+                    &env, XMLRPC_TIMEOUT_ERROR,
+                    "The client's timeout expired before the call started");
+            else {
+                bool deferred;
+
+                if (xmlProcessorAsync)
+                    processXmlDeferred(abyssSessionP, bodyP->bytes, callXmlLen,
+                                       xmlProcessorAsync, xmlProcessorArg,
+                                       wantChunk, accessControl,
+                                       compressLevel, compressMinSize,
+                                       &deferred);
+                else
+                    deferred = false;
+
+                if (!deferred) {
+                    xmlrpc_mem_block * output;
+
+                    /* Process the RPC. */
+                    xmlProcessor(
+                        &env, xmlProcessorArg,
+                        bodyP->bytes,
+                        callXmlLen,
+                        abyssSessionP,
+                        &output);
+                    if (!env.fault_occurred) {
+                        /* Send out the result. */
+                        sendResponse(&env, abyssSessionP,
+                                     XMLRPC_MEMBLOCK_CONTENTS(char, output),
+                                     XMLRPC_MEMBLOCK_SIZE(char, output),
+                                     wantChunk, accessControl,
+                                     compressLevel, compressMinSize);
+
+                        XMLRPC_MEMBLOCK_FREE(char, output);
+                    }
+                }
             }
-            XMLRPC_MEMBLOCK_FREE(char, body);
+            releaseBodyBuffer(bodyCacheP, bodyP);
         }
     }
-    if (env.fault_occurred) {
-        uint16_t httpResponseStatus;
-        if (env.fault_code == XMLRPC_TIMEOUT_ERROR)
-            httpResponseStatus = 408;  /* Request Timeout */
-        else
-            httpResponseStatus = 500;  /* Internal Server Error */
-
-        sendError(abyssSessionP, httpResponseStatus, env.fault_string);
-    }
+    if (env.fault_occurred)
+        sendFault(abyssSessionP, &env);
 
     xmlrpc_env_clean(&env);
 }
@@ -454,6 +1124,7 @@ xmlrpc_termUriHandler(void * const arg) {
 
     xmlrpc_strfree(uriHandlerXmlrpcP->uriPath);
     xmlrpc_termAccessControl(&uriHandlerXmlrpcP->accessControl);
+    xmlrpc_termBodyCache(uriHandlerXmlrpcP->bodyCacheP);
     free(uriHandlerXmlrpcP);
 }
 
@@ -462,10 +1133,14 @@ xmlrpc_termUriHandler(void * const arg) {
 static void
 handleXmlRpcCallReq(TSession *           const abyssSessionP,
                     const TRequestInfo * const requestInfoP ATTR_UNUSED,
+                    struct xmlrpc_tls *  const bodyCacheP,
                     xmlrpc_call_processor      xmlProcessor,
+                    xmlrpc_call_processor_async xmlProcessorAsync,
                     void *               const xmlProcessorArg,
                     bool                 const wantChunk,
-                    ResponseAccessCtl    const accessControl) {
+                    ResponseAccessCtl    const accessControl,
+                    unsigned int         const compressLevel,
+                    size_t               const compressMinSize) {
 /*----------------------------------------------------------------------------
    Handle the HTTP request described by *requestInfoP, which arrived over
    Abyss HTTP session *abyssSessionP, which is an XML-RPC call
@@ -497,6 +1172,7 @@ handleXmlRpcCallReq(TSession *           const abyssSessionP,
         const char * error;
         bool missing;
         size_t contentSize;
+        bool compressed;
 
         processContentLength(abyssSessionP,
                              &contentSize, &missing, &error);
@@ -508,11 +1184,21 @@ handleXmlRpcCallReq(TSession *           const abyssSessionP,
                 sendError(abyssSessionP, 411, "You must send a "
                           "content-length HTTP header in an "
                           "XML-RPC call.");
-            else
-                processCall(abyssSessionP, contentSize,
-                            xmlProcessor, xmlProcessorArg,
-                            wantChunk, accessControl,
-                            trace_abyss);
+            else {
+                processContentEncoding(abyssSessionP, &compressed, &error);
+
+                if (error) {
+                    sendError(abyssSessionP, 415, error);
+                        /* 415 = Unsupported Media Type */
+                    xmlrpc_strfree(error);
+                } else
+                    processCall(abyssSessionP, bodyCacheP, contentSize,
+                                compressed, xmlProcessor, xmlProcessorAsync,
+                                xmlProcessorArg,
+                                wantChunk, accessControl,
+                                compressLevel, compressMinSize,
+                                trace_abyss);
+            }
         }
     }
 }
@@ -574,10 +1260,14 @@ xmlrpc_handleIfXmlrpcReq(void *        const handlerArg,
         switch (requestInfoP->method) {
         case m_post:
             handleXmlRpcCallReq(abyssSessionP, requestInfoP,
+                                uriHandlerXmlrpcP->bodyCacheP,
                                 uriHandlerXmlrpcP->xmlProcessor,
+                                uriHandlerXmlrpcP->xmlProcessorAsync,
                                 uriHandlerXmlrpcP->xmlProcessorArg,
                                 uriHandlerXmlrpcP->chunkResponse,
-                                uriHandlerXmlrpcP->accessControl);
+                                uriHandlerXmlrpcP->accessControl,
+                                uriHandlerXmlrpcP->compressLevel,
+                                uriHandlerXmlrpcP->compressMinSize);
             break;
         case m_options:
             handleXmlRpcOptionsReq(abyssSessionP,
@@ -603,7 +1293,7 @@ xmlrpc_abyss_handler_stacksize() {
 
    This doesn't include what the user's method function requires.
 -----------------------------------------------------------------------------*/
-    return 1024;
+    return 1024 + COMPRESS_BUFFER_SIZE;
 }
 
 
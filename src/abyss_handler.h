@@ -4,6 +4,7 @@
 #include "xmlrpc-c/abyss.h"
 #include "xmlrpc-c/server.h"
 #include "xmlrpc-c/server_abyss.h"
+#include "xmlrpc-c/thread_int.h"
 
 struct uriHandlerXmlrpc {
 /*----------------------------------------------------------------------------
@@ -15,8 +16,18 @@ struct uriHandlerXmlrpc {
     bool                    chunkResponse;
         /* The handler should chunk its response whenever possible */
     xmlrpc_call_processor * xmlProcessor;
+    xmlrpc_call_processor_async * xmlProcessorAsync;
+        /* Processor to use when Abyss lets us defer the response.  NULL
+           if none.
+        */
     void *                  xmlProcessorArg;
     ResponseAccessCtl       accessControl;
+    unsigned int            compressLevel;
+        /* Zlib level at which to compress responses; 0 means don't */
+    size_t                  compressMinSize;
+        /* Don't compress responses smaller than this */
+    struct xmlrpc_tls *     bodyCacheP;
+        /* Per-thread cache of buffers for request bodies */
 };
 
 
@@ -40,6 +51,13 @@ xmlrpc_initAccessCtl(ResponseAccessCtl * const accessCtlP,
 void
 xmlrpc_termAccessControl(ResponseAccessCtl * const accessCtlP);
 
+void
+xmlrpc_initBodyCache(xmlrpc_env *         const envP,
+                     struct xmlrpc_tls ** const bodyCachePP);
+
+void
+xmlrpc_termBodyCache(struct xmlrpc_tls * const bodyCacheP);
+
 void
 xmlrpc_abyss_handler_trace(const char * const trace);
 
@@ -0,0 +1,315 @@
+/*=========================================================================
+  XML-RPC server method registry
+  Per-method concurrency limits ("bulkheads")
+===========================================================================
+  A bulkhead limits how many calls of one method execute at once, so that
+  a slow method can't take every thread of the server and starve the
+  others.
+
+  A call that arrives while the method is at its limit waits in a short
+  queue for an executing call to finish.  When the queue is full too, the
+  call doesn't wait at all; the registry fails it right away.
+
+  The queue is in order of deadline, earliest first, so that when calls
+  pile up, the ones whose clients will give up soonest go first.  Calls
+  without a deadline go after all those with one.  Among calls with the
+  same deadline, and so among all calls when no client gives a deadline,
+  the queue is first-in-first-out.
+
+  A call that finishes hands its place directly to the first waiter, so a
+  new arrival can't take it ahead of the queue.
+=========================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+
+#include "bool.h"
+#include "int.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/thread_int.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/base_int.h"
+#include "xmlrpc-c/base.h"
+
+#include "bulkhead.h"
+
+
+typedef struct bulkheadWaiter {
+    struct bulkheadWaiter * nextP;
+    struct xmlrpc_event *   admittedP;
+        /* Set when an executing call has handed its place to us */
+    uint64_t                deadlineMs;
+        /* When our client gives up on us; zero means never */
+} bulkheadWaiter;
+
+struct xmlrpc_bulkhead {
+    struct lock *    lockP;
+    unsigned int     maxConcurrent;
+    unsigned int     maxQueued;
+    unsigned int     inFlightCt;
+        /* Number of calls that are executing the method */
+    unsigned int     queuedCt;
+        /* Number of calls waiting to execute the method, including any
+           that have reserved a place in the queue but are not in the
+           list yet.
+        */
+    bulkheadWaiter * headP;
+    bulkheadWaiter * tailP;
+        /* The waiting calls, first to be admitted first (i.e. in order
+           of deadline)
+        */
+    unsigned long    rejectedCt;
+        /* Number of calls we have turned away, ever */
+};
+
+
+
+void
+xmlrpc_bulkheadCreate(xmlrpc_env *       const envP,
+                      unsigned int       const maxConcurrent,
+                      unsigned int       const maxQueued,
+                      xmlrpc_bulkhead ** const bulkheadPP) {
+
+    xmlrpc_bulkhead * bulkheadP;
+
+    XMLRPC_ASSERT(maxConcurrent > 0);
+
+    MALLOCVAR(bulkheadP);
+
+    if (!bulkheadP)
+        xmlrpc_faultf(envP, "Unable to allocate memory for method "
+                      "concurrency limit");
+    else {
+        bulkheadP->lockP = xmlrpc_lock_create();
+
+        if (!bulkheadP->lockP) {
+            xmlrpc_faultf(envP, "Unable to create lock for method "
+                          "concurrency limit");
+            free(bulkheadP);
+        } else {
+            bulkheadP->maxConcurrent = maxConcurrent;
+            bulkheadP->maxQueued     = maxQueued;
+            bulkheadP->inFlightCt    = 0;
+            bulkheadP->queuedCt      = 0;
+            bulkheadP->headP         = NULL;
+            bulkheadP->tailP         = NULL;
+            bulkheadP->rejectedCt    = 0;
+
+            *bulkheadPP = bulkheadP;
+        }
+    }
+}
+
+
+
+void
+xmlrpc_bulkheadDestroy(xmlrpc_bulkhead * const bulkheadP) {
+/*----------------------------------------------------------------------------
+   Destroy the bulkhead.  No calls may be executing or waiting.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT(bulkheadP->inFlightCt == 0);
+    XMLRPC_ASSERT(bulkheadP->queuedCt == 0);
+
+    bulkheadP->lockP->destroy(bulkheadP->lockP);
+
+    free(bulkheadP);
+}
+
+
+
+static bool
+placeIsFree(const xmlrpc_bulkhead * const bulkheadP) {
+/*----------------------------------------------------------------------------
+   A call arriving now may execute right away.  Caller holds the lock.
+-----------------------------------------------------------------------------*/
+    return bulkheadP->inFlightCt < bulkheadP->maxConcurrent &&
+        bulkheadP->headP == NULL;
+}
+
+
+
+static bool
+goesBefore(const bulkheadWaiter * const waiterP,
+           const bulkheadWaiter * const otherP) {
+/*----------------------------------------------------------------------------
+   Waiter *waiterP, which is joining the queue, goes ahead of *otherP,
+   which is already in it.
+-----------------------------------------------------------------------------*/
+    return waiterP->deadlineMs != 0 &&
+        (otherP->deadlineMs == 0 || waiterP->deadlineMs < otherP->deadlineMs);
+}
+
+
+
+static void
+enqueue(xmlrpc_bulkhead * const bulkheadP,
+        bulkheadWaiter *  const waiterP) {
+/*----------------------------------------------------------------------------
+   Put *waiterP in the queue, in deadline order.  Caller holds the lock.
+-----------------------------------------------------------------------------*/
+    if (bulkheadP->tailP && !goesBefore(waiterP, bulkheadP->tailP)) {
+        /* The common case: no deadlines, or not an earlier one */
+        waiterP->nextP = NULL;
+        bulkheadP->tailP->nextP = waiterP;
+        bulkheadP->tailP = waiterP;
+    } else {
+        bulkheadWaiter ** linkP;
+
+        for (linkP = &bulkheadP->headP;
+             *linkP && !goesBefore(waiterP, *linkP);
+             linkP = &(*linkP)->nextP);
+
+        waiterP->nextP = *linkP;
+        *linkP = waiterP;
+
+        if (!waiterP->nextP)
+            bulkheadP->tailP = waiterP;
+    }
+}
+
+
+
+static void
+waitInQueue(xmlrpc_env *      const envP,
+            xmlrpc_bulkhead * const bulkheadP,
+            uint64_t          const deadlineMs) {
+/*----------------------------------------------------------------------------
+   Wait for a place to execute the method, in the queue in which the
+   caller has reserved a place.  Return when we have the place.
+
+   Caller does not hold the lock.
+-----------------------------------------------------------------------------*/
+    bulkheadWaiter waiter;
+    const char * error;
+
+    /* We don't create the event with the lock held, because that's slow.
+       Meanwhile, the call that would have handed its place to us may
+       finish without seeing us in the queue, so we check for that when
+       we come back.
+    */
+    xmlrpc_event_create(&waiter.admittedP, &error);
+
+    bulkheadP->lockP->acquire(bulkheadP->lockP);
+
+    if (error) {
+        --bulkheadP->queuedCt;
+
+        bulkheadP->lockP->release(bulkheadP->lockP);
+
+        xmlrpc_faultf(envP, "Unable to create an event on which to wait "
+                      "for the method's concurrency limit.  %s", error);
+        xmlrpc_strfree(error);
+    } else {
+        if (placeIsFree(bulkheadP)) {
+            --bulkheadP->queuedCt;
+            ++bulkheadP->inFlightCt;
+
+            xmlrpc_event_set(waiter.admittedP);
+        } else {
+            waiter.deadlineMs = deadlineMs;
+
+            enqueue(bulkheadP, &waiter);
+        }
+        bulkheadP->lockP->release(bulkheadP->lockP);
+
+        xmlrpc_event_wait(waiter.admittedP);
+
+        xmlrpc_event_destroy(waiter.admittedP);
+    }
+}
+
+
+
+void
+xmlrpc_bulkheadEnter(xmlrpc_env *      const envP,
+                     xmlrpc_bulkhead * const bulkheadP,
+                     bool              const mayWait,
+                     uint64_t          const deadlineMs,
+                     bool *            const admittedP) {
+/*----------------------------------------------------------------------------
+   Get a place to execute the method, waiting in the queue for one if
+   necessary and 'mayWait' is true.  Return *admittedP true if we got one;
+   the caller must give it back with xmlrpc_bulkheadLeave() when the call
+   is done.
+
+   'deadlineMs' is when the call's client will give up (as
+   xmlrpc_monotonic_ms() tells time), which decides our place in the
+   queue.  Zero means never.  We admit a call even if its deadline has
+   passed while it waited; that's for the caller to check.
+
+   Return *admittedP false if the method is at its limit and we can't wait
+   (because the queue is full or 'mayWait' is false).
+-----------------------------------------------------------------------------*/
+    bool mustWait;
+
+    bulkheadP->lockP->acquire(bulkheadP->lockP);
+
+    if (placeIsFree(bulkheadP)) {
+        ++bulkheadP->inFlightCt;
+        *admittedP = true;
+        mustWait = false;
+    } else if (mayWait && bulkheadP->queuedCt < bulkheadP->maxQueued) {
+        ++bulkheadP->queuedCt;
+        *admittedP = true;
+        mustWait = true;
+    } else {
+        ++bulkheadP->rejectedCt;
+        *admittedP = false;
+        mustWait = false;
+    }
+    bulkheadP->lockP->release(bulkheadP->lockP);
+
+    if (mustWait) {
+        waitInQueue(envP, bulkheadP, deadlineMs);
+
+        if (envP->fault_occurred)
+            *admittedP = false;
+    }
+}
+
+
+
+void
+xmlrpc_bulkheadLeave(xmlrpc_bulkhead * const bulkheadP) {
+/*----------------------------------------------------------------------------
+   A call that xmlrpc_bulkheadEnter() admitted is done.  Give its place to
+   the first waiting call, if any.
+-----------------------------------------------------------------------------*/
+    bulkheadWaiter * waiterP;
+
+    bulkheadP->lockP->acquire(bulkheadP->lockP);
+
+    waiterP = bulkheadP->headP;
+
+    if (waiterP) {
+        bulkheadP->headP = waiterP->nextP;
+        if (!bulkheadP->headP)
+            bulkheadP->tailP = NULL;
+        --bulkheadP->queuedCt;
+    } else
+        --bulkheadP->inFlightCt;
+
+    bulkheadP->lockP->release(bulkheadP->lockP);
+
+    /* The waiter is on its own stack, and stays there until we do this */
+    if (waiterP)
+        xmlrpc_event_set(waiterP->admittedP);
+}
+
+
+
+void
+xmlrpc_bulkheadGetStats(xmlrpc_bulkhead *                 const bulkheadP,
+                        struct xmlrpc_method_load_stats * const statsP) {
+
+    bulkheadP->lockP->acquire(bulkheadP->lockP);
+
+    statsP->inFlight = bulkheadP->inFlightCt;
+    statsP->queued   = bulkheadP->queuedCt;
+    statsP->rejected = bulkheadP->rejectedCt;
+
+    bulkheadP->lockP->release(bulkheadP->lockP);
+}
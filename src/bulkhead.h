@@ -0,0 +1,34 @@
+#ifndef BULKHEAD_H_INCLUDED
+#define BULKHEAD_H_INCLUDED
+
+#include "bool.h"
+#include "int.h"
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/server.h"
+
+typedef struct xmlrpc_bulkhead xmlrpc_bulkhead;
+
+void
+xmlrpc_bulkheadCreate(xmlrpc_env *       const envP,
+                      unsigned int       const maxConcurrent,
+                      unsigned int       const maxQueued,
+                      xmlrpc_bulkhead ** const bulkheadPP);
+
+void
+xmlrpc_bulkheadDestroy(xmlrpc_bulkhead * const bulkheadP);
+
+void
+xmlrpc_bulkheadEnter(xmlrpc_env *      const envP,
+                     xmlrpc_bulkhead * const bulkheadP,
+                     bool              const mayWait,
+                     uint64_t          const deadlineMs,
+                     bool *            const admittedP);
+
+void
+xmlrpc_bulkheadLeave(xmlrpc_bulkhead * const bulkheadP);
+
+void
+xmlrpc_bulkheadGetStats(xmlrpc_bulkhead *                 const bulkheadP,
+                        struct xmlrpc_method_load_stats * const statsP);
+
+#endif
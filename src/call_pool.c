@@ -0,0 +1,208 @@
+/*=========================================================================
+  XML-RPC server method registry
+  Call pool
+===========================================================================
+  A call pool is a fixed set of worker threads that execute jobs for a
+  registry, such as the calls in a system.multicall, so they can run at
+  the same time.  Jobs wait in a queue for a free worker.
+
+  The workers exist for the life of the pool, so we don't create and
+  destroy a thread for every job.
+=========================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+
+#include "bool.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/thread_int.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/base_int.h"
+#include "xmlrpc-c/base.h"
+
+#include "call_pool.h"
+
+/* Jobs that can wait in the queue, per worker */
+#define QUEUE_DEPTH_PER_WORKER 4
+
+struct pendingJob {
+    /* A job waiting in the queue for a worker */
+    xmlrpc_callPoolJob * job;
+    void *               arg;
+};
+
+struct xmlrpc_callPool {
+    struct xmlrpc_queue *   queueP;
+        /* Queue of struct pendingJob */
+    unsigned int            workerCt;
+    struct xmlrpc_thread ** workers;
+        /* Array of 'workerCt' */
+};
+
+
+
+static xmlrpc_threadFn workerFunc;
+
+static void
+workerFunc(void * const arg) {
+
+    xmlrpc_callPool * const poolP = arg;
+
+    bool closed;
+
+    for (closed = false; !closed; ) {
+        void * item;
+
+        xmlrpc_queue_get(poolP->queueP, &item, &closed);
+
+        if (!closed) {
+            struct pendingJob * const pendingP = item;
+
+            pendingP->job(pendingP->arg);
+
+            free(pendingP);
+        }
+    }
+}
+
+
+
+static void
+destroyWorkers(xmlrpc_callPool * const poolP,
+               unsigned int      const workerCt) {
+/*----------------------------------------------------------------------------
+   Wait for the first 'workerCt' workers of the pool to exit, and release
+   them.  Caller must have closed the queue.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    for (i = 0; i < workerCt; ++i)
+        xmlrpc_thread_join(poolP->workers[i]);
+
+    free(poolP->workers);
+}
+
+
+
+static void
+createWorkers(xmlrpc_env *      const envP,
+              xmlrpc_callPool * const poolP,
+              unsigned int      const workerCt) {
+
+    MALLOCARRAY(poolP->workers, workerCt);
+
+    if (poolP->workers == NULL)
+        xmlrpc_faultf(envP, "Could not allocate memory for %u "
+                      "worker thread descriptors", workerCt);
+    else {
+        unsigned int i;
+
+        for (i = 0; i < workerCt && !envP->fault_occurred; ++i) {
+            const char * error;
+
+            xmlrpc_thread_create(&poolP->workers[i], &workerFunc, poolP,
+                                 &error);
+
+            if (error) {
+                xmlrpc_faultf(envP, "Failed to create worker thread %u.  %s",
+                              i, error);
+                xmlrpc_strfree(error);
+
+                xmlrpc_queue_close(poolP->queueP);
+                destroyWorkers(poolP, i);
+            }
+        }
+        poolP->workerCt = workerCt;
+    }
+}
+
+
+
+void
+xmlrpc_callPoolCreate(xmlrpc_env *       const envP,
+                      unsigned int       const workerCt,
+                      xmlrpc_callPool ** const poolPP) {
+/*----------------------------------------------------------------------------
+   Create a pool of 'workerCt' threads.
+-----------------------------------------------------------------------------*/
+    xmlrpc_callPool * poolP;
+
+    XMLRPC_ASSERT(workerCt > 0);
+
+    MALLOCVAR(poolP);
+
+    if (poolP == NULL)
+        xmlrpc_faultf(envP, "Could not allocate memory for call pool");
+    else {
+        unsigned int const queueDepth = workerCt * QUEUE_DEPTH_PER_WORKER;
+
+        const char * error;
+
+        xmlrpc_queue_create(&poolP->queueP, queueDepth, &error);
+
+        if (error) {
+            xmlrpc_faultf(envP, "Could not create a queue for %u jobs.  %s",
+                          queueDepth, error);
+            xmlrpc_strfree(error);
+        } else {
+            createWorkers(envP, poolP, workerCt);
+
+            if (envP->fault_occurred)
+                xmlrpc_queue_destroy(poolP->queueP);
+        }
+        if (envP->fault_occurred)
+            free(poolP);
+    }
+    *poolPP = poolP;
+}
+
+
+
+void
+xmlrpc_callPoolDestroy(xmlrpc_callPool * const poolP) {
+/*----------------------------------------------------------------------------
+   Shut down the pool.  The workers finish the jobs in the queue first.
+-----------------------------------------------------------------------------*/
+    xmlrpc_queue_close(poolP->queueP);
+
+    destroyWorkers(poolP, poolP->workerCt);
+
+    xmlrpc_queue_destroy(poolP->queueP);
+
+    free(poolP);
+}
+
+
+
+void
+xmlrpc_callPoolSubmit(xmlrpc_env *         const envP,
+                      xmlrpc_callPool *    const poolP,
+                      xmlrpc_callPoolJob * const job,
+                      void *               const arg) {
+/*----------------------------------------------------------------------------
+   Have a worker of the pool run job(arg).  Wait if necessary for there to
+   be room in the queue.
+
+   If we fail, the job doesn't run.
+-----------------------------------------------------------------------------*/
+    struct pendingJob * pendingP;
+
+    MALLOCVAR(pendingP);
+
+    if (pendingP == NULL)
+        xmlrpc_faultf(envP, "Could not allocate memory for a queued job");
+    else {
+        bool closed;
+
+        pendingP->job = job;
+        pendingP->arg = arg;
+
+        xmlrpc_queue_put(poolP->queueP, pendingP, &closed);
+
+        if (closed) {
+            xmlrpc_faultf(envP, "Call pool is shutting down");
+            free(pendingP);
+        }
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef CALL_POOL_H_INCLUDED
+#define CALL_POOL_H_INCLUDED
+
+#include "xmlrpc-c/base.h"
+
+typedef struct xmlrpc_callPool xmlrpc_callPool;
+
+typedef void xmlrpc_callPoolJob(void * arg);
+
+void
+xmlrpc_callPoolCreate(xmlrpc_env *       const envP,
+                      unsigned int       const workerCt,
+                      xmlrpc_callPool ** const poolPP);
+
+void
+xmlrpc_callPoolDestroy(xmlrpc_callPool * const poolP);
+
+void
+xmlrpc_callPoolSubmit(xmlrpc_env *         const envP,
+                      xmlrpc_callPool *    const poolP,
+                      xmlrpc_callPoolJob * const job,
+                      void *               const arg);
+
+#endif
@@ -163,6 +163,9 @@ struct clientXmlTransport_curl::constrOpt_impl {
         bool         tcp_keepalive;
         unsigned int tcp_keepidle_sec;
         unsigned int tcp_keepintvl_sec;
+        unsigned int compress_level;
+        size_t       compress_min_size;
+        bool         accept_compressed;
     } value;
     struct {
         bool network_interface;
@@ -196,6 +199,9 @@ struct clientXmlTransport_curl::constrOpt_impl {
         bool tcp_keepalive;
         bool tcp_keepidle_sec;
         bool tcp_keepintvl_sec;
+        bool compress_level;
+        bool compress_min_size;
+        bool accept_compressed;
     } present;
 };
 
@@ -232,6 +238,9 @@ clientXmlTransport_curl::constrOpt_impl::constrOpt_impl() {
     present.tcp_keepalive     = false;
     present.tcp_keepidle_sec  = false;
     present.tcp_keepintvl_sec = false;
+    present.compress_level    = false;
+    present.compress_min_size = false;
+    present.accept_compressed = false;
 }
 
 
@@ -275,6 +284,9 @@ DEFINE_OPTION_SETTER(connect_timeout, unsigned int);
 DEFINE_OPTION_SETTER(tcp_keepalive, bool);
 DEFINE_OPTION_SETTER(tcp_keepidle_sec, unsigned int);
 DEFINE_OPTION_SETTER(tcp_keepintvl_sec, unsigned int);
+DEFINE_OPTION_SETTER(compress_level, unsigned int);
+DEFINE_OPTION_SETTER(compress_min_size, size_t);
+DEFINE_OPTION_SETTER(accept_compressed, bool);
 
 #undef DEFINE_OPTION_SETTER
 
@@ -367,6 +379,14 @@ clientXmlTransport_curl::initialize(constrOpt const& optExt) {
         opt.value.tcp_keepalive             : false;
     transportParms.tcp_keepidle_sec  = opt.present.tcp_keepidle_sec ?
         opt.value.tcp_keepidle_sec          : 0;
+    transportParms.tcp_keepintvl_sec = opt.present.tcp_keepintvl_sec ?
+        opt.value.tcp_keepintvl_sec         : 0;
+    transportParms.compress_level    = opt.present.compress_level ?
+        opt.value.compress_level            : 0;
+    transportParms.compress_min_size = opt.present.compress_min_size ?
+        opt.value.compress_min_size         : 0;
+    transportParms.accept_compressed = opt.present.accept_compressed ?
+        opt.value.accept_compressed         : false;
 
     this->c_transportOpsP = &xmlrpc_curl_transport_ops;
 
@@ -374,7 +394,7 @@ clientXmlTransport_curl::initialize(constrOpt const& optExt) {
 
     xmlrpc_curl_transport_ops.create(
         &env.env_c, 0, "", "",
-        &transportParms, XMLRPC_CXPSIZE(tcp_keepalive),
+        &transportParms, XMLRPC_CXPSIZE(accept_compressed),
         &this->c_transportP);
 
     if (env.env_c.fault_occurred)
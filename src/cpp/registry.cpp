@@ -78,6 +78,7 @@ method2::method2() {}
 method2::~method2() {}
 
 
+
 void
 method2::execute(xmlrpc_c::paramList const& paramList,
                  xmlrpc_c::value *   const  resultP) {
@@ -89,6 +90,60 @@ method2::execute(xmlrpc_c::paramList const& paramList,
 
 
 
+concurrencyLimit::concurrencyLimit(unsigned int const maxConcurrent,
+                                   unsigned int const maxQueued) :
+    maxConcurrent(maxConcurrent),
+    maxQueued(maxQueued) {}
+
+
+
+completion::completion(xmlrpc_completion * const completionP) :
+    completionP(completionP) {}
+
+
+
+void
+completion::complete(value const& result) const {
+
+    xmlrpc_value * const resultP(result.cValue());
+
+    xmlrpc_completion_finish(this->completionP, NULL, resultP);
+
+    xmlrpc_DECREF(resultP);
+}
+
+
+
+void
+completion::fail(fault const& fault) const {
+
+    env_wrap env;
+
+    xmlrpc_env_set_fault(&env.env_c, fault.getCode(),
+                         fault.getDescription().c_str());
+
+    xmlrpc_completion_finish(this->completionP, &env.env_c, NULL);
+}
+
+
+
+asyncMethod::asyncMethod() {}
+
+
+
+asyncMethod::~asyncMethod() {}
+
+
+
+void
+asyncMethod::execute(paramList const&,
+                     value *   const) {
+
+    throwf("This method is asynchronous.  Only a registry can execute it");
+}
+
+
+
 defaultMethod::~defaultMethod() {}
 
 
@@ -312,6 +367,48 @@ c_executeMethod(xmlrpc_env *   const envP,
  
 
 
+static void
+c_executeAsyncMethod(xmlrpc_value *      const paramArrayP,
+                     void *              const methodPtr,
+                     void *              const callInfoPtr,
+                     xmlrpc_completion * const completionP) {
+/*----------------------------------------------------------------------------
+   Same as c_executeMethod(), but for an asynchronous method.  This
+   function is of type 'xmlrpc_method_async'.
+-----------------------------------------------------------------------------*/
+    asyncMethod * const methodP(static_cast<asyncMethod *>(methodPtr));
+    callInfo * const callInfoP(static_cast<callInfo *>(callInfoPtr));
+
+    env_wrap env;
+
+    try {
+        paramList const paramList(pListFromXmlrpcArray(paramArrayP));
+
+        try {
+            methodP->execute(paramList, callInfoP, completion(completionP));
+        } catch (xmlrpc_c::fault const& fault) {
+            xmlrpc_env_set_fault(&env.env_c, fault.getCode(),
+                                 fault.getDescription().c_str());
+        }
+    } catch (exception const& e) {
+        xmlrpc_faultf(&env.env_c, "Unexpected error executing code for "
+                      "particular method, detected by Xmlrpc-c "
+                      "method registry code.  Method did not "
+                      "fail; rather, it did not complete at all.  %s",
+                      e.what());
+    } catch (...) {
+        xmlrpc_env_set_fault(&env.env_c, XMLRPC_INTERNAL_ERROR,
+                             "Unexpected error executing code for "
+                             "particular method, detected by Xmlrpc-c "
+                             "method registry code.  Method did not "
+                             "fail; rather, it did not complete at all.");
+    }
+    if (env.env_c.fault_occurred)
+        xmlrpc_completion_finish(completionP, &env.env_c, NULL);
+}
+
+
+
 static xmlrpc_value *
 c_executeDefaultMethod(xmlrpc_env *   const envP,
                        const char *   const , // host
@@ -376,39 +473,97 @@ c_executeDefaultMethod(xmlrpc_env *   const envP,
 
 
 void
-registry::addMethod(string   const name,
-                    method * const methodP) {
+registry::addMethod(string                 const  name,
+                    method *               const  methodP,
+                    concurrencyLimit       const& limit) {
 /*----------------------------------------------------------------------------
    Caller is responsible for ensuring *methodP exists as long as this
    registry does.
+
+   A 'limit' with 'maxConcurrent' zero means no limit.
 -----------------------------------------------------------------------------*/
-    struct xmlrpc_method_info3 methodInfo;
+    asyncMethod * const asyncMethodP(dynamic_cast<asyncMethod *>(methodP));
+
     env_wrap env;
 
+    string const signatureString(methodP->signature());
+    string const help(methodP->help());
+
+    struct xmlrpc_method_info4 methodInfo;
+
     methodInfo.methodName      = name.c_str();
-    methodInfo.methodFunction  = &c_executeMethod;
     methodInfo.serverInfo      = methodP;
     methodInfo.stackSize       = 0;
-    string const signatureString(methodP->signature());
     methodInfo.signatureString = signatureString.c_str();
-    string const help(methodP->help());
     methodInfo.help            = help.c_str();
-    
-	xmlrpc_registry_add_method3(&env.env_c, this->implP->c_registryP,
-                                &methodInfo);
-
+    methodInfo.cacheTtl        = 0;
+    methodInfo.cacheMaxEntries = 0;
+    methodInfo.singleFlight    = false;
+    methodInfo.parallelSafe    = false;
+    methodInfo.maxConcurrent   = limit.maxConcurrent;
+    methodInfo.maxQueued       = limit.maxQueued;
+
+    if (asyncMethodP) {
+        methodInfo.methodFunction      = NULL;
+        methodInfo.methodFunctionAsync = &c_executeAsyncMethod;
+        methodInfo.serverInfo          = asyncMethodP;
+    } else {
+        methodInfo.methodFunction      = &c_executeMethod;
+        methodInfo.methodFunctionAsync = NULL;
+    }
+    xmlrpc_registry_add_method4(&env.env_c, this->implP->c_registryP,
+                                &methodInfo,
+                                XMLRPC_MI4SIZE(methodFunctionAsync));
     throwIfError(env);
 }
 
 
 
+void
+registry::addMethod(string   const name,
+                    method * const methodP) {
+/*----------------------------------------------------------------------------
+   Caller is responsible for ensuring *methodP exists as long as this
+   registry does.
+-----------------------------------------------------------------------------*/
+    this->addMethod(name, methodP, concurrencyLimit(0));
+}
+
+
+
+void
+registry::addMethod(string                 const  name,
+                    methodPtr              const  methodP,
+                    concurrencyLimit       const& limit) {
+
+    this->addMethod(name, dynamic_cast<method *>(methodP.get()), limit);
+
+    this->implP->managedMethodList.push_back(methodP);
+}
+
+
+
 void
 registry::addMethod(string    const name,
                     methodPtr const methodP) {
 
-    this->addMethod(name, dynamic_cast<method *>(methodP.get()));
+    this->addMethod(name, methodP, concurrencyLimit(0));
+}
 
-    this->implP->managedMethodList.push_back(methodP);
+
+
+struct xmlrpc_method_load_stats
+registry::methodLoadStats(string const& name) const {
+
+    env_wrap env;
+    struct xmlrpc_method_load_stats stats;
+
+    xmlrpc_registry_get_method_load_stats(
+        &env.env_c, this->implP->c_registryP, name.c_str(), &stats);
+
+    throwIfError(env);
+
+    return stats;
 }
 
 
@@ -534,6 +689,27 @@ registry::processCall(string           const& callXml,
 
 
 
+void
+registry::processCallAsync(string                           const& callXml,
+                           const callInfo *                 const  callInfoP,
+                           xmlrpc_registry_response_handler        handler,
+                           void *                           const  handlerArg)
+    const {
+/*----------------------------------------------------------------------------
+   Process an XML-RPC call whose XML is 'callXml', delivering the response
+   by calling 'handler' exactly once, as xmlrpc_registry_process_call_async()
+   does.  If the method is asynchronous, that may be after we return, in
+   another thread, so *callInfoP must remain valid until then.
+-----------------------------------------------------------------------------*/
+    xmlrpc_registry_process_call_async(
+        this->implP->c_registryP,
+        callXml.c_str(), callXml.length(),
+        const_cast<callInfo *>(callInfoP),
+        handler, handlerArg);
+}
+
+
+
 void
 registry::processCall(string   const& callXml,
                       string * const  responseXmlP) const {
@@ -173,6 +173,28 @@ callInfo_serverAbyss::callInfo_serverAbyss(
 
 
 
+bool
+callInfo_serverAbyss::canceled() const {
+/*----------------------------------------------------------------------------
+   The client has closed the connection, so the result of the call will go
+   nowhere.  See xmlrpc_server_abyss_get_canceled().
+-----------------------------------------------------------------------------*/
+    return SessionClientGone(this->abyssSessionP);
+}
+
+
+
+bool
+callInfo_serverAbyss::timeLeft(unsigned int * const msLeftP) const {
+/*----------------------------------------------------------------------------
+   How much longer the client will wait for the result of the call.  See
+   xmlrpc_server_abyss_get_time_left().
+-----------------------------------------------------------------------------*/
+    return xmlrpc_server_abyss_get_time_left(this->abyssSessionP, msLeftP);
+}
+
+
+
 struct serverAbyss::constrOpt_impl {
 
     constrOpt_impl();
@@ -198,6 +220,15 @@ struct serverAbyss::constrOpt_impl {
         std::string    logFileName;
         bool           serverOwnsSignals;
         bool           expectSigchld;
+        bool           eventDriven;
+        unsigned int   connQueueDepth;
+        unsigned int   acceptorCount;
+        bool           pinAcceptors;
+        unsigned int   preforkMinWorkers;
+        unsigned int   preforkMaxWorkers;
+        unsigned int   preforkMaxRequests;
+        unsigned int   compressLevel;
+        size_t         compressMinSize;
     } value;
     struct {
         bool registryPtr;
@@ -220,6 +251,15 @@ struct serverAbyss::constrOpt_impl {
         bool logFileName;
         bool serverOwnsSignals;
         bool expectSigchld;
+        bool eventDriven;
+        bool connQueueDepth;
+        bool acceptorCount;
+        bool pinAcceptors;
+        bool preforkMinWorkers;
+        bool preforkMaxWorkers;
+        bool preforkMaxRequests;
+        bool compressLevel;
+        bool compressMinSize;
     } present;
 };
 
@@ -246,6 +286,15 @@ serverAbyss::constrOpt_impl::constrOpt_impl() {
     present.sockAddrLen       = false;
     present.serverOwnsSignals = false;
     present.expectSigchld     = false;
+    present.eventDriven       = false;
+    present.connQueueDepth    = false;
+    present.acceptorCount     = false;
+    present.pinAcceptors      = false;
+    present.preforkMinWorkers = false;
+    present.preforkMaxWorkers = false;
+    present.preforkMaxRequests = false;
+    present.compressLevel     = false;
+    present.compressMinSize   = false;
 
     // Set default values
     value.dontAdvertise     = false;
@@ -253,6 +302,12 @@ serverAbyss::constrOpt_impl::constrOpt_impl() {
     value.chunkResponse     = false;
     value.serverOwnsSignals = true;
     value.expectSigchld     = false;
+    value.eventDriven       = false;
+    value.pinAcceptors      = false;
+    value.preforkMinWorkers = 1;
+    value.preforkMaxRequests = 0;
+    value.compressLevel     = 0;
+    value.compressMinSize   = 0;
 }
 
 
@@ -285,6 +340,15 @@ DEFINE_OPTION_SETTER(sockAddrLen,       socklen_t);
 DEFINE_OPTION_SETTER(logFileName,       string);
 DEFINE_OPTION_SETTER(serverOwnsSignals, bool);
 DEFINE_OPTION_SETTER(expectSigchld,     bool);
+DEFINE_OPTION_SETTER(eventDriven,       bool);
+DEFINE_OPTION_SETTER(connQueueDepth,    unsigned int);
+DEFINE_OPTION_SETTER(acceptorCount,     unsigned int);
+DEFINE_OPTION_SETTER(pinAcceptors,      bool);
+DEFINE_OPTION_SETTER(preforkMinWorkers, unsigned int);
+DEFINE_OPTION_SETTER(preforkMaxWorkers, unsigned int);
+DEFINE_OPTION_SETTER(preforkMaxRequests, unsigned int);
+DEFINE_OPTION_SETTER(compressLevel,     unsigned int);
+DEFINE_OPTION_SETTER(compressMinSize,   size_t);
 
 #undef DEFINE_OPTION_SETTER
 
@@ -351,6 +415,13 @@ struct serverAbyss_impl {
                 TSession *    const  abyssSessionP,
                 std::string * const  responseP);
 
+    void
+    processCallAsync(
+        std::string                      const& call,
+        TSession *                       const  abyssSessionP,
+        xmlrpc_registry_response_handler        responseHandler,
+        void *                           const  responseHandlerArg);
+
     serverAbyss * const serverAbyssP;
         // The server for which we are the implementation.
 
@@ -405,6 +476,88 @@ processXmlrpcCall(xmlrpc_env *        const envP,
 
 
 
+struct asyncCall {
+/*----------------------------------------------------------------------------
+   An RPC that may complete after processXmlrpcCallAsync() returns, and
+   so needs its call information on the heap.
+-----------------------------------------------------------------------------*/
+    asyncCall(serverAbyss *                    const serverAbyssP,
+              TSession *                       const abyssSessionP,
+              xmlrpc_registry_response_handler       responseHandler,
+              void *                           const responseHandlerArg) :
+        callInfo(serverAbyssP, abyssSessionP),
+        responseHandler(responseHandler),
+        responseHandlerArg(responseHandlerArg) {}
+
+    callInfo_serverAbyss const callInfo;
+    xmlrpc_registry_response_handler const responseHandler;
+    void * const responseHandlerArg;
+};
+
+
+
+static void
+deliverAsyncResponse(const xmlrpc_env * const envP,
+                     void *             const arg,
+                     xmlrpc_mem_block * const responseXmlP) {
+
+    asyncCall * const callP(static_cast<asyncCall *>(arg));
+
+    callP->responseHandler(envP, callP->responseHandlerArg, responseXmlP);
+
+    delete(callP);
+}
+
+
+
+void
+serverAbyss_impl::processCallAsync(
+    string                           const& call,
+    TSession *                       const  abyssSessionP,
+    xmlrpc_registry_response_handler        responseHandler,
+    void *                           const  responseHandlerArg) {
+
+    asyncCall * const callP(
+        new asyncCall(this->serverAbyssP, abyssSessionP,
+                      responseHandler, responseHandlerArg));
+
+    this->registryP->processCallAsync(call, &callP->callInfo,
+                                      &deliverAsyncResponse, callP);
+}
+
+
+
+static void
+processXmlrpcCallAsync(
+    void *                           const arg,
+    const char *                     const callXml,
+    size_t                           const callXmlLen,
+    TSession *                       const abyssSessionP,
+    xmlrpc_registry_response_handler       responseHandler,
+    void *                           const responseHandlerArg) {
+/*----------------------------------------------------------------------------
+   Same as processXmlrpcCall(), but an asynchronous method may complete the
+   call after we return.  This is an xmlrpc_call_processor_async.
+-----------------------------------------------------------------------------*/
+    serverAbyss_impl * const implP(
+        static_cast<serverAbyss_impl *>(arg));
+
+    try {
+        string const call(callXml, callXmlLen);
+
+        implP->processCallAsync(call, abyssSessionP,
+                                responseHandler, responseHandlerArg);
+    } catch (exception const& e) {
+        env_wrap env;
+
+        xmlrpc_env_set_fault(&env.env_c, XMLRPC_INTERNAL_ERROR, e.what());
+
+        responseHandler(&env.env_c, responseHandlerArg, NULL);
+    }
+}
+
+
+
 static void
 validateListenOptions(serverAbyss::constrOpt_impl const& opt) {
 
@@ -508,16 +661,25 @@ static void
 chanSwitchCreateSockAddr(int                     const protocolFamily,
                          const struct sockaddr * const sockAddrP,
                          socklen_t               const sockAddrLen,
+                         bool                    const reusePort,
                          TChanSwitch **          const chanSwitchPP) {
-
+/*----------------------------------------------------------------------------
+   'reusePort' means let other channel switches listen at the same address,
+   for a server with multiple acceptors.  On Windows, where there are no
+   multiple acceptors, we ignore it.
+-----------------------------------------------------------------------------*/
     const char * error;
 
 #ifdef WIN32
     ChanSwitchWinCreate2(protocolFamily, sockAddrP, sockAddrLen,
                           chanSwitchPP, &error);
 #else
-    ChanSwitchUnixCreate2(protocolFamily, sockAddrP, sockAddrLen,
-                          chanSwitchPP, &error);
+    if (reusePort)
+        ChanSwitchUnixCreateReusePort(protocolFamily, sockAddrP, sockAddrLen,
+                                      chanSwitchPP, &error);
+    else
+        ChanSwitchUnixCreate2(protocolFamily, sockAddrP, sockAddrLen,
+                              chanSwitchPP, &error);
 #endif
     if (error) {
         string const errorS(error);
@@ -530,7 +692,8 @@ chanSwitchCreateSockAddr(int                     const protocolFamily,
 
 
 static TChanSwitch *
-newChanSwitchSockAddr(SockAddr const& sockAddr) {
+newChanSwitchSockAddr(SockAddr const& sockAddr,
+                      bool     const  reusePort) {
 
     int protocolFamily;
 
@@ -551,7 +714,7 @@ newChanSwitchSockAddr(SockAddr const& sockAddr) {
 
     chanSwitchCreateSockAddr(protocolFamily,
                              sockAddr.sockAddrP, sockAddr.sockAddrLen,
-                             &chanSwitchP);
+                             reusePort, &chanSwitchP);
 
     return chanSwitchP;
 }
@@ -559,7 +722,8 @@ newChanSwitchSockAddr(SockAddr const& sockAddr) {
 
 
 static TChanSwitch *
-newChanSwitchIpV4Port(unsigned int const portNumber) {
+newChanSwitchIpV4Port(unsigned int const portNumber,
+                      bool         const reusePort) {
 
     struct sockaddr_in sockAddr;
 
@@ -570,7 +734,7 @@ newChanSwitchIpV4Port(unsigned int const portNumber) {
     TChanSwitch * chanSwitchP;
 
     chanSwitchCreateSockAddr(PF_INET, (const struct sockaddr *)&sockAddr,
-                             sizeof(sockAddr),
+                             sizeof(sockAddr), reusePort,
                              &chanSwitchP);
 
     return chanSwitchP;
@@ -587,8 +751,13 @@ createServerBare(bool           const  logFileNameGiven,
                  unsigned int   const  portNumber,
                  bool           const  sockAddrPGiven,
                  SockAddr       const& sockAddr,
+                 bool           const  reusePort,
                  TServer *      const  serverP,
                  TChanSwitch ** const  chanSwitchPP) {
+/*----------------------------------------------------------------------------
+   'reusePort' means the server will have multiple acceptors, so the
+   channel switch we create must let theirs listen at the same address.
+-----------------------------------------------------------------------------*/
 
     const char * const serverName("XmlRpcServer");
 
@@ -598,9 +767,9 @@ createServerBare(bool           const  logFileNameGiven,
             socketFdGiven ?
                 newChanSwitchOsSocket(socketFd) :
             sockAddrPGiven ?
-                newChanSwitchSockAddr(sockAddr) :
+                newChanSwitchSockAddr(sockAddr, reusePort) :
             portNumberGiven ?
-                newChanSwitchIpV4Port(portNumber) :
+                newChanSwitchIpV4Port(portNumber, reusePort) :
                 NULL);
 
         assert(chanSwitchP);
@@ -654,6 +823,16 @@ setAdditionalServerParms(TServer *                   const  serverP,
     ServerSetAdvertise(serverP, !opt.value.dontAdvertise);
     if (opt.value.expectSigchld)
         ServerUseSigchld(serverP);
+    ServerSetEventDriven(serverP, opt.value.eventDriven);
+    if (opt.present.connQueueDepth)
+        ServerSetConnQueueDepth(serverP, opt.value.connQueueDepth);
+    if (opt.present.acceptorCount)
+        ServerSetAcceptorCount(serverP, opt.value.acceptorCount);
+    ServerSetAcceptorAffinity(serverP, opt.value.pinAcceptors);
+    if (opt.present.preforkMaxWorkers)
+        ServerSetPrefork(serverP, opt.value.preforkMinWorkers,
+                         opt.value.preforkMaxWorkers,
+                         opt.value.preforkMaxRequests);
 }
 
 
@@ -667,7 +846,9 @@ setHttpReqHandlers(TServer *    const  serverP,
                    bool         const  doHttpAccessControl,
                    string       const& allowOrigin,
                    bool         const  accessCtlExpires,
-                   unsigned int const  accessCtlMaxAge) {
+                   unsigned int const  accessCtlMaxAge,
+                   unsigned int const  compressLevel,
+                   size_t       const  compressMinSize) {
 
     env_wrap env;
     xmlrpc_server_abyss_handler_parms parms;
@@ -680,10 +861,13 @@ setHttpReqHandlers(TServer *    const  serverP,
     parms.allow_origin = doHttpAccessControl ? allowOrigin.c_str() : NULL;
     parms.access_ctl_expires = accessCtlExpires;
     parms.access_ctl_max_age = accessCtlMaxAge;
+    parms.compress_level = compressLevel;
+    parms.compress_min_size = compressMinSize;
+    parms.xml_processor_async = &processXmlrpcCallAsync;
 
     xmlrpc_server_abyss_set_handler3(
         &env.env_c, serverP,
-        &parms, XMLRPC_AHPSIZE(access_ctl_max_age));
+        &parms, XMLRPC_AHPSIZE(xml_processor_async));
 
     if (env.env_c.fault_occurred)
         throwf("Failed to register the HTTP handler for XML-RPC "
@@ -710,6 +894,7 @@ createServer(serverAbyss::constrOpt_impl const& opt,
                      opt.present.portNumber,  opt.value.portNumber,
                      opt.present.sockAddrP,
                      SockAddr(opt.value.sockAddrP, opt.value.sockAddrLen),
+                     opt.present.acceptorCount && opt.value.acceptorCount > 1,
                      serverP, chanSwitchPP);
 
     try {
@@ -723,7 +908,9 @@ createServer(serverAbyss::constrOpt_impl const& opt,
                            opt.present.allowOrigin,
                            opt.value.allowOrigin,
                            opt.present.accessCtlMaxAge,
-                           opt.value.accessCtlMaxAge);
+                           opt.value.accessCtlMaxAge,
+                           opt.value.compressLevel,
+                           opt.value.compressMinSize);
 
         if (opt.present.portNumber || opt.present.socketFd ||
             opt.present.sockAddrP)
@@ -1014,6 +1201,22 @@ callInfo_abyss::callInfo_abyss(TSession * const abyssSessionP) :
 
 
 
+bool
+callInfo_abyss::canceled() const {
+
+    return SessionClientGone(this->abyssSessionP);
+}
+
+
+
+bool
+callInfo_abyss::timeLeft(unsigned int * const msLeftP) const {
+
+    return xmlrpc_server_abyss_get_time_left(this->abyssSessionP, msLeftP);
+}
+
+
+
 void
 processXmlrpcCall2(xmlrpc_env *        const envP,
                    void *              const arg,
@@ -1462,6 +1462,10 @@ serializeValue(xmlrpc_env *       const envP,
         formatOut(envP, outP, "null");
         break;
 
+    case XMLRPC_TYPE_PRESERIALIZED:
+        xmlrpc_faultf(envP, "Tried to serialize a preserialized XML value.");
+        break;
+
     case XMLRPC_TYPE_DEAD:
         xmlrpc_faultf(envP, "Tried to serialize a dead value.");
         break;
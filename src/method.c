@@ -25,6 +25,9 @@
 #include "xmlrpc-c/base.h"
 #include "registry.h"
 
+#include "method_cache.h"
+#include "single_flight.h"
+#include "bulkhead.h"
 #include "method.h"
 
 
@@ -302,6 +305,7 @@ void
 xmlrpc_methodCreate(xmlrpc_env *           const envP,
                     xmlrpc_method1               methodFnType1,
                     xmlrpc_method2               methodFnType2,
+                    xmlrpc_method_async          methodFnAsync,
                     void *                 const userData,
                     const char *           const signatureString,
                     const char *           const helpText,
@@ -320,9 +324,14 @@ xmlrpc_methodCreate(xmlrpc_env *           const envP,
     else {
         methodP->methodFnType1  = methodFnType1;
         methodP->methodFnType2  = methodFnType2;
+        methodP->methodFnAsync  = methodFnAsync;
         methodP->userData       = userData;
         methodP->helpText       = xmlrpc_strdupsol(helpText);
         methodP->stackSize      = stackSize;
+        methodP->cacheP         = NULL;
+        methodP->singleFlightP  = NULL;
+        methodP->parallelSafe   = false;
+        methodP->bulkheadP      = NULL;
 
         makeSignatureList(envP, signatureString, &methodP->signatureListP);
 
@@ -344,46 +353,98 @@ xmlrpc_methodDestroy(xmlrpc_methodInfo * const methodP) {
 
     xmlrpc_strfree(methodP->helpText);
 
+    if (methodP->cacheP)
+        xmlrpc_methodCacheDestroy(methodP->cacheP);
+
+    if (methodP->singleFlightP)
+        xmlrpc_singleFlightDestroy(methodP->singleFlightP);
+
+    if (methodP->bulkheadP)
+        xmlrpc_bulkheadDestroy(methodP->bulkheadP);
+
     free(methodP);
 }
 
 
 
-void
-xmlrpc_methodListCreate(xmlrpc_env *         const envP,
-                        xmlrpc_methodList ** const methodListPP) {
+#define MIN_SLOT_CT 16
 
-    xmlrpc_methodList * methodListP;
 
-    XMLRPC_ASSERT_ENV_OK(envP);
+
+static void
+methodListBuild(xmlrpc_env *          const envP,
+                unsigned int          const methodCt,
+                xmlrpc_methodNode **  const methods,
+                xmlrpc_methodList **  const methodListPP) {
+/*----------------------------------------------------------------------------
+   Create a method list of the 'methodCt' methods methods[], in that order.
+   methods[] is malloc'ed; we take ownership of it, even if we fail.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodList * methodListP;
 
     MALLOCVAR(methodListP);
 
-    if (methodListP == NULL)
+    if (methodListP == NULL) {
         xmlrpc_faultf(envP, "Couldn't allocate method list descriptor");
-    else {
-        methodListP->firstMethodP = NULL;
-        methodListP->lastMethodP = NULL;
+        free(methods);
+    } else {
+        for (methodListP->slotCt = MIN_SLOT_CT;
+             methodListP->slotCt < methodCt * 2;
+             methodListP->slotCt *= 2);
+
+        methodListP->slots =
+            calloc(methodListP->slotCt, sizeof(methodListP->slots[0]));
+
+        if (!methodListP->slots) {
+            xmlrpc_faultf(envP, "Couldn't allocate a %u-slot hash table "
+                          "for method list", methodListP->slotCt);
+            free(methods);
+            free(methodListP);
+        } else {
+            unsigned int const mask = methodListP->slotCt - 1;
+
+            unsigned int i;
+
+            for (i = 0; i < methodCt; ++i) {
+                unsigned int slot;
+
+                for (slot = methods[i]->nameHash & mask;
+                     methodListP->slots[slot];
+                     slot = (slot + 1) & mask);
 
-        *methodListPP = methodListP;
+                methodListP->slots[slot] = methods[i];
+            }
+            methodListP->methodCt = methodCt;
+            methodListP->methods  = methods;
+
+            *methodListPP = methodListP;
+        }
     }
 }
 
 
 
 void
-xmlrpc_methodListDestroy(xmlrpc_methodList * methodListP) {
+xmlrpc_methodListCreate(xmlrpc_env *         const envP,
+                        xmlrpc_methodList ** const methodListPP) {
+/*----------------------------------------------------------------------------
+   Create an empty method list.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
 
-    xmlrpc_methodNode * p;
-    xmlrpc_methodNode * nextP;
+    methodListBuild(envP, 0, NULL, methodListPP);
+}
 
-    for (p = methodListP->firstMethodP; p; p = nextP) {
-        nextP = p->nextP;
 
-        xmlrpc_methodDestroy(p->methodP);
-        xmlrpc_strfree(p->methodName);
-        free(p);
-    }
+
+void
+xmlrpc_methodListDestroy(xmlrpc_methodList * const methodListP) {
+/*----------------------------------------------------------------------------
+   Destroy the method list, but not the methods in it, which other
+   versions of the list may share.
+-----------------------------------------------------------------------------*/
+    free(methodListP->methods);
+    free(methodListP->slots);
 
     free(methodListP);
 }
@@ -391,43 +452,106 @@ xmlrpc_methodListDestroy(xmlrpc_methodList * methodListP) {
 
 
 void
-xmlrpc_methodListLookupByName(xmlrpc_methodList *  const methodListP,
-                              const char *         const methodName,
-                              xmlrpc_methodInfo ** const methodPP) {
+xmlrpc_methodNodeDestroy(xmlrpc_methodNode * const methodNodeP) {
 
+    xmlrpc_methodDestroy(methodNodeP->methodP);
+    xmlrpc_strfree(methodNodeP->methodName);
+    free(methodNodeP);
+}
 
-    /* We do a simple linear lookup along a linked list.
-       If speed is important, we can make this a binary tree instead.
-    */
 
-    xmlrpc_methodNode * p;
-    xmlrpc_methodInfo * methodP;
 
-    for (p = methodListP->firstMethodP, methodP = NULL;
-         p && !methodP;
-         p = p->nextP) {
-
-        if (xmlrpc_streq(p->methodName, methodName))
-            methodP = p->methodP;
+unsigned int
+xmlrpc_methodNameHash(const char * const methodName) {
+/*----------------------------------------------------------------------------
+   The hash by which a method list indexes method 'methodName': 32 bit
+   FNV-1a.
+-----------------------------------------------------------------------------*/
+    const unsigned char * p;
+    unsigned int hash;
+
+    for (p = (const unsigned char *)methodName, hash = 2166136261u;
+         *p;
+         ++p) {
+        hash ^= *p;
+        hash *= 16777619u;
     }
-    *methodPP = methodP;
+    return hash;
+}
+
+
+
+static xmlrpc_methodNode **
+slotForName(const xmlrpc_methodList * const methodListP,
+            const char *              const methodName,
+            unsigned int              const nameHash) {
+/*----------------------------------------------------------------------------
+   The hash table slot that has method 'methodName' (whose hash is
+   'nameHash') or, if there is no such method, the empty slot that ends
+   its probe sequence.
+-----------------------------------------------------------------------------*/
+    unsigned int const mask = methodListP->slotCt - 1;
+
+    unsigned int slot;
+
+    for (slot = nameHash & mask;
+         methodListP->slots[slot] &&
+             !(methodListP->slots[slot]->nameHash == nameHash &&
+               xmlrpc_streq(methodListP->slots[slot]->methodName,
+                            methodName));
+         slot = (slot + 1) & mask);
+
+    return &methodListP->slots[slot];
 }
 
 
 
 void
-xmlrpc_methodListAdd(xmlrpc_env *        const envP,
-                     xmlrpc_methodList * const methodListP,
-                     const char *        const methodName,
-                     xmlrpc_methodInfo * const methodP) {
-    
-    xmlrpc_methodInfo * existingMethodP;
+xmlrpc_methodListLookupByHash(const xmlrpc_methodList * const methodListP,
+                              const char *              const methodName,
+                              unsigned int              const nameHash,
+                              xmlrpc_methodInfo **      const methodPP) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_methodListLookupByName, for a caller that already has
+   the hash of the name ('nameHash').
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodNode * const nodeP =
+        *slotForName(methodListP, methodName, nameHash);
+
+    *methodPP = nodeP ? nodeP->methodP : NULL;
+}
+
+
+
+void
+xmlrpc_methodListLookupByName(const xmlrpc_methodList * const methodListP,
+                              const char *              const methodName,
+                              xmlrpc_methodInfo **      const methodPP) {
+
+    xmlrpc_methodListLookupByHash(methodListP, methodName,
+                                  xmlrpc_methodNameHash(methodName),
+                                  methodPP);
+}
+
+
+
+void
+xmlrpc_methodListAdd(xmlrpc_env *               const envP,
+                     const xmlrpc_methodList *  const methodListP,
+                     const char *               const methodName,
+                     xmlrpc_methodInfo *        const methodP,
+                     xmlrpc_methodList **       const newMethodListPP) {
+/*----------------------------------------------------------------------------
+   Create a new method list that is *methodListP plus method *methodP,
+   named 'methodName', at the end.  *methodListP doesn't change.
+
+   The new list owns *methodP.  If we fail, we don't take ownership.
+-----------------------------------------------------------------------------*/
+    unsigned int const nameHash = xmlrpc_methodNameHash(methodName);
 
     XMLRPC_ASSERT_ENV_OK(envP);
 
-    xmlrpc_methodListLookupByName(methodListP, methodName, &existingMethodP);
-    
-    if (existingMethodP)
+    if (*slotForName(methodListP, methodName, nameHash))
         xmlrpc_faultf(envP, "Method named '%s' already registered",
                       methodName);
     else {
@@ -438,18 +562,80 @@ xmlrpc_methodListAdd(xmlrpc_env *        const envP,
         if (methodNodeP == NULL)
             xmlrpc_faultf(envP, "Couldn't allocate method node");
         else {
-            methodNodeP->methodName = strdup(methodName);
-            methodNodeP->methodP = methodP;
-            methodNodeP->nextP = NULL;
-            
-            if (!methodListP->firstMethodP)
-                methodListP->firstMethodP = methodNodeP;
+            xmlrpc_methodNode ** methods;
+
+            MALLOCARRAY(methods, methodListP->methodCt + 1);
+
+            if (methods == NULL)
+                xmlrpc_faultf(envP, "Couldn't allocate a list of %u "
+                              "methods", methodListP->methodCt + 1);
+            else {
+                if (methodListP->methodCt > 0)
+                    memcpy(methods, methodListP->methods,
+                           methodListP->methodCt * sizeof(methods[0]));
 
-            if (methodListP->lastMethodP)
-                methodListP->lastMethodP->nextP = methodNodeP;
+                methodNodeP->methodName = strdup(methodName);
+                methodNodeP->methodP    = methodP;
+                methodNodeP->nameHash   = nameHash;
 
-            methodListP->lastMethodP = methodNodeP;
+                methods[methodListP->methodCt] = methodNodeP;
+
+                methodListBuild(envP, methodListP->methodCt + 1, methods,
+                                newMethodListPP);
+
+                if (envP->fault_occurred)
+                    xmlrpc_strfree(methodNodeP->methodName);
+            }
+            if (envP->fault_occurred)
+                free(methodNodeP);
         }
     }
 }
 
+
+
+void
+xmlrpc_methodListRemove(xmlrpc_env *               const envP,
+                        const xmlrpc_methodList *  const methodListP,
+                        const char *               const methodName,
+                        xmlrpc_methodList **       const newMethodListPP,
+                        xmlrpc_methodNode **       const removedNodePP) {
+/*----------------------------------------------------------------------------
+   Create a new method list that is *methodListP without the method named
+   'methodName'.  *methodListP doesn't change.
+
+   Return as *removedNodePP the method we left out.  The caller owns it
+   and may destroy it when nothing uses *methodListP anymore.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodNode * const nodeP =
+        *slotForName(methodListP, methodName,
+                     xmlrpc_methodNameHash(methodName));
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+
+    if (!nodeP)
+        xmlrpc_env_set_fault_formatted(
+            envP, XMLRPC_NO_SUCH_METHOD_ERROR,
+            "Method '%s' not defined", methodName);
+    else {
+        xmlrpc_methodNode ** methods;
+
+        MALLOCARRAY(methods, methodListP->methodCt);
+
+        if (methods == NULL)
+            xmlrpc_faultf(envP, "Couldn't allocate a list of %u methods",
+                          methodListP->methodCt);
+        else {
+            unsigned int i, j;
+
+            for (i = 0, j = 0; i < methodListP->methodCt; ++i) {
+                if (methodListP->methods[i] != nodeP)
+                    methods[j++] = methodListP->methods[i];
+            }
+            methodListBuild(envP, j, methods, newMethodListPP);
+
+            if (!envP->fault_occurred)
+                *removedNodePP = nodeP;
+        }
+    }
+}
@@ -32,9 +32,32 @@ typedef struct xmlrpc_signatureList {
     struct xmlrpc_signature * firstSignatureP;
 } xmlrpc_signatureList;
 
+struct lock;
+struct retiredMethodList;
+
 struct xmlrpc_registry {
     bool                        introspectionEnabled;
-    struct xmlrpc_methodList *  methodListP;
+    struct xmlrpc_methodList * volatile methodListP;
+        /* The current version of the registry's methods.  A change to the
+           registry makes a new version and swaps it in here atomically, so
+           a reader doesn't lock anything.  Read it via
+           xmlrpc_registryReadBegin().
+        */
+    long volatile               epoch;
+        /* Readers that start now count themselves in readerCt[epoch % 2].
+           Only a writer changes it.
+        */
+    long volatile               readerCt[2];
+        /* Number of readers between xmlrpc_registryReadBegin() and
+           xmlrpc_registryReadEnd(), by parity of the epoch in which they
+           began.
+        */
+    struct lock *               updateLockP;
+        /* Lock that writers hold, one at a time */
+    struct retiredMethodList *  retiredP;
+        /* Old versions of the method list that a reader may still be
+           using.  Writers free them when that can no longer be.
+        */
     xmlrpc_default_method       defaultMethodFunction;
     void *                      defaultMethodUserData;
     xmlrpc_preinvoke_method     preinvokeFunction;
@@ -48,14 +71,25 @@ struct xmlrpc_registry {
            that function, passed to it as argument.
         */
     xmlrpc_dialect dialect;
+    struct xmlrpc_callPool * multicallPoolP;
+        /* Workers that execute the parallel-safe calls of a
+           system.multicall.  NULL means system.multicall executes all
+           its calls itself, one at a time.
+        */
+    unsigned int multicallMaxFanout;
+        /* Maximum number of calls of one system.multicall in the pool at
+           once.  Meaningless if 'multicallPoolP' is NULL.
+        */
+    bool multicallAllParallel;
+        /* Every method is parallel-safe */
 };
 
 typedef struct {
 /*----------------------------------------------------------------------------
    Everything a registry knows about one XML-RPC method
 -----------------------------------------------------------------------------*/
-    /* One of the methodTypeX fields is NULL and the other isn't.
-       (The reason there are two is backward compatibility.  Old
+    /* Exactly one of the methodFnX fields is not NULL.
+       (The reason there are two types is backward compatibility.  Old
        programs set up the registry with Type 1; modern ones set it up
        with Type 2.
     */
@@ -63,6 +97,10 @@ typedef struct {
         /* The method function, if it's type 1.  Null if it's not */
     xmlrpc_method2 methodFnType2;
         /* The method function, if it's type 2.  Null if it's not */
+    xmlrpc_method_async methodFnAsync;
+        /* The method function, if the method is asynchronous.  Null if
+           it's not.
+        */
     void * userData;
         /* Passed to method function */
     size_t stackSize;
@@ -76,23 +114,61 @@ typedef struct {
         */
     const char * helpText;
         /* Stuff returned by system method system.methodHelp */
+    struct xmlrpc_methodCache * cacheP;
+        /* Cache of recent responses of the method, by parameter list.
+           NULL if responses of this method are not cached.
+        */
+    struct xmlrpc_singleFlight * singleFlightP;
+        /* Calls of the method executing right now, by parameter list, for
+           coalescing identical calls.  NULL if we don't coalesce.
+        */
+    bool parallelSafe;
+        /* Calls in a system.multicall may execute this method on a worker
+           thread, at the same time as each other.
+        */
+    struct xmlrpc_bulkhead * bulkheadP;
+        /* Limit on the number of calls of the method executing at once.
+           NULL if there is no limit.
+        */
 } xmlrpc_methodInfo;
 
 typedef struct xmlrpc_methodNode {
-    struct xmlrpc_methodNode * nextP;
+/*----------------------------------------------------------------------------
+   A method of a registry, by name.  All the versions of the registry's
+   method list that contain the method share this.
+-----------------------------------------------------------------------------*/
     const char * methodName;
+        /* malloc'ed */
+    unsigned int nameHash;
+        /* Hash of 'methodName' */
     xmlrpc_methodInfo * methodP;
 } xmlrpc_methodNode;
 
 typedef struct xmlrpc_methodList {
-    xmlrpc_methodNode * firstMethodP;
-    xmlrpc_methodNode * lastMethodP;
+/*----------------------------------------------------------------------------
+   One version of the set of methods of a registry.  It does not change
+   after we create it; to change the registry, we make a new version.
+-----------------------------------------------------------------------------*/
+    unsigned int methodCt;
+    xmlrpc_methodNode ** methods;
+        /* The methods in order of registration, which is the order in
+           which system.listMethods lists them.  'methodCt' entries.
+        */
+    xmlrpc_methodNode ** slots;
+        /* Hash table of the same methods, by name, with linear probing.
+           NULL is an empty slot.
+        */
+    unsigned int slotCt;
+        /* Number of entries in 'slots'; a power of two, at least twice
+           'methodCt', so there is always an empty slot.
+        */
 } xmlrpc_methodList;
 
 void
 xmlrpc_methodCreate(xmlrpc_env *           const envP,
                     xmlrpc_method1               methodFnType1,
                     xmlrpc_method2               methodFnType2,
+                    xmlrpc_method_async          methodFnAsync,
                     void *                 const userData,
                     const char *           const signatureString,
                     const char *           const helpText,
@@ -107,18 +183,38 @@ xmlrpc_methodListCreate(xmlrpc_env *         const envP,
                         xmlrpc_methodList ** const methodListPP);
 
 void
-xmlrpc_methodListDestroy(xmlrpc_methodList * methodListP);
+xmlrpc_methodListDestroy(xmlrpc_methodList * const methodListP);
+
+void
+xmlrpc_methodNodeDestroy(xmlrpc_methodNode * const methodNodeP);
+
+void
+xmlrpc_methodListLookupByName(const xmlrpc_methodList * const methodListP,
+                              const char *              const methodName,
+                              xmlrpc_methodInfo **      const methodPP);
+
+unsigned int
+xmlrpc_methodNameHash(const char * const methodName);
+
+void
+xmlrpc_methodListLookupByHash(const xmlrpc_methodList * const methodListP,
+                              const char *              const methodName,
+                              unsigned int              const nameHash,
+                              xmlrpc_methodInfo **      const methodPP);
 
 void
-xmlrpc_methodListLookupByName(xmlrpc_methodList *  const methodListP,
-                              const char *         const methodName,
-                              xmlrpc_methodInfo ** const methodPP);
+xmlrpc_methodListAdd(xmlrpc_env *               const envP,
+                     const xmlrpc_methodList *  const methodListP,
+                     const char *               const methodName,
+                     xmlrpc_methodInfo *        const methodP,
+                     xmlrpc_methodList **       const newMethodListPP);
 
 void
-xmlrpc_methodListAdd(xmlrpc_env *        const envP,
-                     xmlrpc_methodList * const methodListP,
-                     const char *        const methodName,
-                     xmlrpc_methodInfo * const methodP);
+xmlrpc_methodListRemove(xmlrpc_env *               const envP,
+                        const xmlrpc_methodList *  const methodListP,
+                        const char *               const methodName,
+                        xmlrpc_methodList **       const newMethodListPP,
+                        xmlrpc_methodNode **       const removedNodePP);
 
 
 
@@ -0,0 +1,443 @@
+/*=========================================================================
+  XML-RPC server method registry
+  Method response cache
+===========================================================================
+  A method response cache remembers the XML responses a method generated
+  for recent calls, by parameter list, so that a call with the same
+  parameters as one in the cache can be answered without executing the
+  method or serializing its result.
+
+  Entries expire a fixed time after they are created.  The cache holds a
+  limited number of entries; when it is full, a new entry replaces the
+  least recently used one.
+
+  Multiple threads use a cache at once (one per connection, in an Abyss
+  server), so the cache is split into shards, each with its own lock and
+  its own share of the entry limit.  A call's shard is determined by the
+  hash of its parameters, so calls with different parameters rarely
+  contend for a lock.
+=========================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bool.h"
+#include "int.h"
+#include "girmath.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/time_int.h"
+#include "xmlrpc-c/base_int.h"
+#include "xmlrpc-c/base.h"
+
+#include "method_cache.h"
+
+#define MAX_SHARD_CT 16
+
+#define DEFAULT_MAX_ENTRIES 1024
+
+
+typedef struct cacheEntry {
+    struct cacheEntry * nextInBucketP;
+    struct cacheEntry * newerP;
+        /* Next more recently used entry in the shard; NULL if this is the
+           most recently used one
+        */
+    struct cacheEntry * olderP;
+        /* Next less recently used entry in the shard; NULL if this is the
+           least recently used one.
+        */
+    unsigned int        paramHash;
+    xmlrpc_value *      paramArrayP;
+        /* The parameter list of the call.  We hold a reference. */
+    xmlrpc_dialect      dialect;
+        /* Dialect of 'responseXml' */
+    uint64_t            expiry;
+        /* Time at which this entry becomes invalid, as
+           xmlrpc_monotonic_ms() tells time
+        */
+    char *              responseXml;
+    size_t              responseXmlLen;
+} cacheEntry;
+
+
+
+typedef struct {
+    struct lock *  lockP;
+    cacheEntry **  buckets;
+        /* Hash table of the entries, chained */
+    unsigned int   bucketCt;
+    cacheEntry *   newestP;
+    cacheEntry *   oldestP;
+    unsigned int   entryCt;
+    unsigned int   maxEntryCt;
+    unsigned long  hitCt;
+    unsigned long  missCt;
+    unsigned long  evictionCt;
+} cacheShard;
+
+
+
+struct xmlrpc_methodCache {
+    unsigned int ttlMs;
+    unsigned int shardCt;
+    cacheShard   shard[MAX_SHARD_CT];
+};
+
+
+
+static void
+shardInit(xmlrpc_env * const envP,
+          cacheShard * const shardP,
+          unsigned int const maxEntryCt) {
+
+    shardP->maxEntryCt = maxEntryCt;
+    shardP->entryCt    = 0;
+    shardP->newestP    = NULL;
+    shardP->oldestP    = NULL;
+    shardP->hitCt      = 0;
+    shardP->missCt     = 0;
+    shardP->evictionCt = 0;
+
+    /* The table is at least as big as the entry limit, so chains are
+       short.
+    */
+    for (shardP->bucketCt = 1;
+         shardP->bucketCt < maxEntryCt && shardP->bucketCt < (1u << 30);
+         shardP->bucketCt *= 2);
+
+    shardP->buckets = calloc(shardP->bucketCt, sizeof(shardP->buckets[0]));
+
+    if (!shardP->buckets)
+        xmlrpc_faultf(envP, "Unable to allocate a %u-bucket hash table for "
+                      "a method response cache", shardP->bucketCt);
+    else {
+        shardP->lockP = xmlrpc_lock_create();
+
+        if (!shardP->lockP)
+            xmlrpc_faultf(envP, "Unable to create lock for method "
+                          "response cache");
+
+        if (envP->fault_occurred)
+            free(shardP->buckets);
+    }
+}
+
+
+
+static void
+entryDestroy(cacheEntry * const entryP) {
+
+    xmlrpc_DECREF(entryP->paramArrayP);
+    free(entryP->responseXml);
+    free(entryP);
+}
+
+
+
+static void
+shardTerm(cacheShard * const shardP) {
+
+    cacheEntry * entryP;
+
+    for (entryP = shardP->newestP; entryP; ) {
+        cacheEntry * const olderP = entryP->olderP;
+        entryDestroy(entryP);
+        entryP = olderP;
+    }
+    shardP->lockP->destroy(shardP->lockP);
+    free(shardP->buckets);
+}
+
+
+
+void
+xmlrpc_methodCacheCreate(xmlrpc_env *          const envP,
+                         unsigned int          const ttlMs,
+                         unsigned int          const maxEntries,
+                         xmlrpc_methodCache ** const cachePP) {
+/*----------------------------------------------------------------------------
+   Create a cache whose entries expire after 'ttlMs' milliseconds and which
+   holds at most about 'maxEntries' entries (zero means a default).
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodCache * cacheP;
+
+    MALLOCVAR(cacheP);
+
+    if (!cacheP)
+        xmlrpc_faultf(envP, "Unable to allocate memory for method "
+                      "response cache");
+    else {
+        unsigned int const entryCt =
+            maxEntries == 0 ? DEFAULT_MAX_ENTRIES : maxEntries;
+
+        unsigned int i;
+
+        cacheP->ttlMs   = ttlMs;
+        cacheP->shardCt = MIN(MAX_SHARD_CT, entryCt);
+
+        for (i = 0; i < cacheP->shardCt && !envP->fault_occurred; ++i) {
+            shardInit(envP, &cacheP->shard[i],
+                      (entryCt + cacheP->shardCt - 1) / cacheP->shardCt);
+
+            if (envP->fault_occurred) {
+                unsigned int j;
+                for (j = 0; j < i; ++j)
+                    shardTerm(&cacheP->shard[j]);
+            }
+        }
+        if (envP->fault_occurred)
+            free(cacheP);
+        else
+            *cachePP = cacheP;
+    }
+}
+
+
+
+void
+xmlrpc_methodCacheDestroy(xmlrpc_methodCache * const cacheP) {
+
+    unsigned int i;
+
+    for (i = 0; i < cacheP->shardCt; ++i)
+        shardTerm(&cacheP->shard[i]);
+
+    free(cacheP);
+}
+
+
+
+static cacheShard *
+shardForHash(xmlrpc_methodCache * const cacheP,
+             unsigned int         const paramHash) {
+
+    return &cacheP->shard[paramHash % cacheP->shardCt];
+}
+
+
+
+static cacheEntry **
+bucketForHash(xmlrpc_methodCache * const cacheP,
+              cacheShard *         const shardP,
+              unsigned int         const paramHash) {
+
+    /* The low bits chose the shard, so use the rest to choose the bucket */
+
+    return &shardP->buckets[(paramHash / cacheP->shardCt) %
+                            shardP->bucketCt];
+}
+
+
+
+static void
+lruUnlink(cacheShard * const shardP,
+          cacheEntry * const entryP) {
+
+    if (entryP->newerP)
+        entryP->newerP->olderP = entryP->olderP;
+    else
+        shardP->newestP = entryP->olderP;
+
+    if (entryP->olderP)
+        entryP->olderP->newerP = entryP->newerP;
+    else
+        shardP->oldestP = entryP->newerP;
+}
+
+
+
+static void
+lruLinkNewest(cacheShard * const shardP,
+              cacheEntry * const entryP) {
+
+    entryP->newerP = NULL;
+    entryP->olderP = shardP->newestP;
+
+    if (shardP->newestP)
+        shardP->newestP->newerP = entryP;
+    else
+        shardP->oldestP = entryP;
+
+    shardP->newestP = entryP;
+}
+
+
+
+static void
+removeEntry(xmlrpc_methodCache * const cacheP,
+            cacheShard *         const shardP,
+            cacheEntry *         const entryP) {
+
+    cacheEntry ** pP;
+
+    for (pP = bucketForHash(cacheP, shardP, entryP->paramHash);
+         *pP != entryP;
+         pP = &(*pP)->nextInBucketP);
+
+    *pP = entryP->nextInBucketP;
+
+    lruUnlink(shardP, entryP);
+
+    --shardP->entryCt;
+
+    entryDestroy(entryP);
+}
+
+
+
+static cacheEntry *
+findEntry(xmlrpc_methodCache * const cacheP,
+          cacheShard *         const shardP,
+          xmlrpc_value *       const paramArrayP,
+          unsigned int         const paramHash,
+          xmlrpc_dialect       const dialect) {
+
+    cacheEntry * entryP;
+
+    for (entryP = *bucketForHash(cacheP, shardP, paramHash);
+         entryP;
+         entryP = entryP->nextInBucketP) {
+
+        if (entryP->paramHash == paramHash && entryP->dialect == dialect &&
+            xmlrpc_value_equal(entryP->paramArrayP, paramArrayP))
+            return entryP;
+    }
+    return NULL;
+}
+
+
+
+void
+xmlrpc_methodCacheLookup(xmlrpc_env *         const envP,
+                         xmlrpc_methodCache * const cacheP,
+                         xmlrpc_value *       const paramArrayP,
+                         unsigned int         const paramHash,
+                         xmlrpc_dialect       const dialect,
+                         xmlrpc_mem_block *   const responseXmlP,
+                         bool *               const hitP) {
+/*----------------------------------------------------------------------------
+   Look up the response to a call with parameters *paramArrayP (whose hash
+   is 'paramHash'), in dialect 'dialect'.  If it's there, append it to
+   *responseXmlP and return *hitP true.
+-----------------------------------------------------------------------------*/
+    cacheShard * const shardP = shardForHash(cacheP, paramHash);
+
+    cacheEntry * entryP;
+
+    shardP->lockP->acquire(shardP->lockP);
+
+    entryP = findEntry(cacheP, shardP, paramArrayP, paramHash, dialect);
+
+    if (entryP && entryP->expiry <= xmlrpc_monotonic_ms()) {
+        removeEntry(cacheP, shardP, entryP);
+        entryP = NULL;
+    }
+    if (entryP) {
+        XMLRPC_MEMBLOCK_APPEND(char, envP, responseXmlP,
+                               entryP->responseXml, entryP->responseXmlLen);
+
+        lruUnlink(shardP, entryP);
+        lruLinkNewest(shardP, entryP);
+
+        ++shardP->hitCt;
+        *hitP = true;
+    } else {
+        ++shardP->missCt;
+        *hitP = false;
+    }
+    shardP->lockP->release(shardP->lockP);
+}
+
+
+
+void
+xmlrpc_methodCacheAdd(xmlrpc_methodCache * const cacheP,
+                      xmlrpc_value *       const paramArrayP,
+                      unsigned int         const paramHash,
+                      xmlrpc_dialect       const dialect,
+                      const char *         const responseXml,
+                      size_t               const responseXmlLen) {
+/*----------------------------------------------------------------------------
+   Remember that the response to a call with parameters *paramArrayP (whose
+   hash is 'paramHash') in dialect 'dialect' is 'responseXml'.
+
+   If we can't get the memory for it, we just don't remember it.
+-----------------------------------------------------------------------------*/
+    cacheShard * const shardP = shardForHash(cacheP, paramHash);
+
+    cacheEntry * entryP;
+
+    MALLOCVAR(entryP);
+
+    if (entryP) {
+        entryP->responseXml = malloc(responseXmlLen);
+
+        if (!entryP->responseXml)
+            free(entryP);
+        else {
+            cacheEntry * oldEntryP;
+            cacheEntry ** bucketP;
+
+            memcpy(entryP->responseXml, responseXml, responseXmlLen);
+            entryP->responseXmlLen = responseXmlLen;
+            entryP->paramHash      = paramHash;
+            entryP->dialect        = dialect;
+            entryP->expiry         = xmlrpc_monotonic_ms() + cacheP->ttlMs;
+            entryP->paramArrayP    = paramArrayP;
+            xmlrpc_INCREF(paramArrayP);
+
+            shardP->lockP->acquire(shardP->lockP);
+
+            /* Another thread may have added the same call while we were
+               executing the method.
+            */
+            oldEntryP =
+                findEntry(cacheP, shardP, paramArrayP, paramHash, dialect);
+            if (oldEntryP)
+                removeEntry(cacheP, shardP, oldEntryP);
+
+            if (shardP->entryCt >= shardP->maxEntryCt) {
+                removeEntry(cacheP, shardP, shardP->oldestP);
+                ++shardP->evictionCt;
+            }
+            bucketP = bucketForHash(cacheP, shardP, paramHash);
+            entryP->nextInBucketP = *bucketP;
+            *bucketP = entryP;
+            lruLinkNewest(shardP, entryP);
+            ++shardP->entryCt;
+
+            shardP->lockP->release(shardP->lockP);
+        }
+    }
+}
+
+
+
+void
+xmlrpc_methodCacheGetStats(xmlrpc_methodCache *               const cacheP,
+                           struct xmlrpc_method_cache_stats * const statsP) {
+
+    unsigned int i;
+
+    statsP->hits      = 0;
+    statsP->misses    = 0;
+    statsP->entries   = 0;
+    statsP->evictions = 0;
+
+    for (i = 0; i < cacheP->shardCt; ++i) {
+        cacheShard * const shardP = &cacheP->shard[i];
+
+        shardP->lockP->acquire(shardP->lockP);
+
+        statsP->hits      += shardP->hitCt;
+        statsP->misses    += shardP->missCt;
+        statsP->entries   += shardP->entryCt;
+        statsP->evictions += shardP->evictionCt;
+
+        shardP->lockP->release(shardP->lockP);
+    }
+}
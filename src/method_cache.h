@@ -0,0 +1,40 @@
+#ifndef METHOD_CACHE_H_INCLUDED
+#define METHOD_CACHE_H_INCLUDED
+
+#include "bool.h"
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/server.h"
+
+typedef struct xmlrpc_methodCache xmlrpc_methodCache;
+
+void
+xmlrpc_methodCacheCreate(xmlrpc_env *          const envP,
+                         unsigned int          const ttlMs,
+                         unsigned int          const maxEntries,
+                         xmlrpc_methodCache ** const cachePP);
+
+void
+xmlrpc_methodCacheDestroy(xmlrpc_methodCache * const cacheP);
+
+void
+xmlrpc_methodCacheLookup(xmlrpc_env *         const envP,
+                         xmlrpc_methodCache * const cacheP,
+                         xmlrpc_value *       const paramArrayP,
+                         unsigned int         const paramHash,
+                         xmlrpc_dialect       const dialect,
+                         xmlrpc_mem_block *   const responseXmlP,
+                         bool *               const hitP);
+
+void
+xmlrpc_methodCacheAdd(xmlrpc_methodCache * const cacheP,
+                      xmlrpc_value *       const paramArrayP,
+                      unsigned int         const paramHash,
+                      xmlrpc_dialect       const dialect,
+                      const char *         const responseXml,
+                      size_t               const responseXmlLen);
+
+void
+xmlrpc_methodCacheGetStats(xmlrpc_methodCache *               const cacheP,
+                           struct xmlrpc_method_cache_stats * const statsP);
+
+#endif
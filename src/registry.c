@@ -19,12 +19,22 @@
 
 #include "xmlrpc_config.h"
 #include "bool.h"
+#include "int.h"
 #include "mallocvar.h"
+#include "atomic.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
 #include "xmlrpc-c/base_int.h"
 #include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/thread_int.h"
+#include "xmlrpc-c/time_int.h"
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
 #include "method.h"
+#include "method_cache.h"
+#include "single_flight.h"
+#include "bulkhead.h"
+#include "call_pool.h"
 #include "system_method.h"
 #include "version.h"
 
@@ -49,6 +59,176 @@ xmlrpc_server_version(unsigned int * const majorP,
 
 
 
+/*=========================================================================
+  Versions of the method list
+
+  Threads can dispatch calls while another changes the registry.  The
+  method list doesn't change; a change makes a new version of it and swaps
+  that in as the current version.  A reader uses whatever version is
+  current when it begins (xmlrpc_registryReadBegin), until it ends
+  (xmlrpc_registryReadEnd), without locking anything.
+
+  Writers take turns via the registry's update lock.  We keep each replaced
+  version, and any method the change removed, until no reader can still be
+  using it, and free it during a later change, or when we free the
+  registry.
+
+  To know when that is, each reader counts itself in one of two counters,
+  chosen by the parity of the registry's epoch when it begins.  A writer
+  advances the epoch from E to E+1 only when the counter that readers in
+  epoch E+1 will use is zero, which means readers from epoch E-1 and
+  before are all done.  A reader that got an old version began in or
+  before the epoch in which we replaced it, so a version replaced in epoch
+  E is free to destroy once the epoch reaches E+2.
+=========================================================================*/
+
+struct retiredMethodList {
+    struct retiredMethodList * nextP;
+    xmlrpc_methodList * methodListP;
+        /* A version that was current in 'epoch' or earlier */
+    xmlrpc_methodNode * removedNodeP;
+        /* The method the change that replaced 'methodListP' removed;
+           NULL if none.
+        */
+    long epoch;
+        /* Epoch in which a new version replaced 'methodListP' */
+};
+
+
+
+static void
+destroyRetired(struct retiredMethodList * const retiredP) {
+
+    xmlrpc_methodListDestroy(retiredP->methodListP);
+
+    if (retiredP->removedNodeP)
+        xmlrpc_methodNodeDestroy(retiredP->removedNodeP);
+
+    free(retiredP);
+}
+
+
+
+static void
+reclaimRetired(xmlrpc_registry * const registryP) {
+/*----------------------------------------------------------------------------
+   Destroy the retired versions no reader can still be using, advancing
+   the epoch as far as readers allow.
+
+   Caller must hold the update lock.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    /* Two epochs past a version's retirement is as far as we ever need
+       to go.
+    */
+    for (i = 0; i < 2 && registryP->retiredP; ++i) {
+        long const nextEpoch = registryP->epoch + 1;
+
+        if (xmlrpc_atomicLoad(&registryP->readerCt[nextEpoch % 2]) == 0) {
+            struct retiredMethodList ** pP;
+
+            xmlrpc_atomicStore(&registryP->epoch, nextEpoch);
+
+            for (pP = &registryP->retiredP; *pP; ) {
+                struct retiredMethodList * const retiredP = *pP;
+
+                if (retiredP->epoch + 2 <= nextEpoch) {
+                    *pP = retiredP->nextP;
+                    destroyRetired(retiredP);
+                } else
+                    pP = &retiredP->nextP;
+            }
+        }
+    }
+}
+
+
+
+static void
+publishMethodList(xmlrpc_registry *          const registryP,
+                  xmlrpc_methodList *        const newMethodListP,
+                  xmlrpc_methodNode *        const removedNodeP,
+                  struct retiredMethodList * const retiredP) {
+/*----------------------------------------------------------------------------
+   Make *newMethodListP the current version of the registry's method list.
+   Retire the current version, and *removedNodeP if it isn't NULL, using
+   record *retiredP.
+
+   Caller must hold the update lock.
+-----------------------------------------------------------------------------*/
+    retiredP->methodListP  = registryP->methodListP;
+    retiredP->removedNodeP = removedNodeP;
+    retiredP->epoch        = registryP->epoch;
+    retiredP->nextP        = registryP->retiredP;
+
+    xmlrpc_atomicStorePtr((void * volatile *)&registryP->methodListP,
+                          newMethodListP);
+
+    registryP->retiredP = retiredP;
+
+    reclaimRetired(registryP);
+}
+
+
+
+void
+xmlrpc_registryReadBegin(xmlrpc_registry *    const registryP,
+                         xmlrpc_methodList ** const methodListPP,
+                         unsigned int *       const readerSlotP) {
+/*----------------------------------------------------------------------------
+   Get the current version of the registry's method list, for use until
+   xmlrpc_registryReadEnd().  It doesn't change in that time, and the
+   methods in it continue to exist.
+
+   Return as *readerSlotP what Caller must pass to xmlrpc_registryReadEnd.
+-----------------------------------------------------------------------------*/
+    unsigned int const slot = xmlrpc_atomicLoad(&registryP->epoch) % 2;
+
+    xmlrpc_atomicIncrement(&registryP->readerCt[slot]);
+
+    *methodListPP =
+        xmlrpc_atomicLoadPtr((void * volatile *)&registryP->methodListP);
+
+    *readerSlotP = slot;
+}
+
+
+
+void
+xmlrpc_registryReadEnd(xmlrpc_registry * const registryP,
+                       unsigned int      const readerSlot) {
+
+    xmlrpc_atomicDecrement(&registryP->readerCt[readerSlot]);
+}
+
+
+
+static void
+destroyMethods(xmlrpc_registry * const registryP) {
+/*----------------------------------------------------------------------------
+   Destroy all versions of the registry's method list and all the methods
+   in them.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodList * const methodListP = registryP->methodListP;
+
+    unsigned int i;
+
+    while (registryP->retiredP) {
+        struct retiredMethodList * const retiredP = registryP->retiredP;
+
+        registryP->retiredP = retiredP->nextP;
+
+        destroyRetired(retiredP);
+    }
+    for (i = 0; i < methodListP->methodCt; ++i)
+        xmlrpc_methodNodeDestroy(methodListP->methods[i]);
+
+    xmlrpc_methodListDestroy(methodListP);
+}
+
+
+
 xmlrpc_registry *
 xmlrpc_registry_new(xmlrpc_env * const envP) {
 
@@ -66,11 +246,34 @@ xmlrpc_registry_new(xmlrpc_env * const envP) {
         registryP->preinvokeFunction     = NULL;
         registryP->shutdownServerFn      = NULL;
         registryP->dialect               = xmlrpc_dialect_i8;
+        registryP->epoch                 = 0;
+        registryP->readerCt[0]           = 0;
+        registryP->readerCt[1]           = 0;
+        registryP->retiredP              = NULL;
+        registryP->multicallPoolP        = NULL;
+        registryP->multicallMaxFanout    = 0;
+        registryP->multicallAllParallel  = false;
+
+        registryP->updateLockP = xmlrpc_lock_create();
+
+        if (!registryP->updateLockP)
+            xmlrpc_faultf(envP, "Could not create lock for registry");
+        else {
+            xmlrpc_methodList * methodListP;
 
-        xmlrpc_methodListCreate(envP, &registryP->methodListP);
-        if (!envP->fault_occurred)
-            xmlrpc_installSystemMethods(envP, registryP);
+            xmlrpc_methodListCreate(envP, &methodListP);
+
+            if (!envP->fault_occurred) {
+                registryP->methodListP = methodListP;
 
+                xmlrpc_installSystemMethods(envP, registryP);
+
+                if (envP->fault_occurred)
+                    destroyMethods(registryP);
+            }
+            if (envP->fault_occurred)
+                registryP->updateLockP->destroy(registryP->updateLockP);
+        }
         if (envP->fault_occurred)
             free(registryP);
     }
@@ -81,26 +284,87 @@ xmlrpc_registry_new(xmlrpc_env * const envP) {
 
 void
 xmlrpc_registry_free(xmlrpc_registry * const registryP) {
-
+/*----------------------------------------------------------------------------
+   Nothing may be using the registry.
+-----------------------------------------------------------------------------*/
     XMLRPC_ASSERT_PTR_OK(registryP);
 
-    xmlrpc_methodListDestroy(registryP->methodListP);
+    if (registryP->multicallPoolP)
+        xmlrpc_callPoolDestroy(registryP->multicallPoolP);
+
+    destroyMethods(registryP);
+
+    registryP->updateLockP->destroy(registryP->updateLockP);
 
     free(registryP);
 }
 
 
 
+typedef struct {
+/*----------------------------------------------------------------------------
+   Optional ways the registry executes a method.  All zero means none.
+-----------------------------------------------------------------------------*/
+    unsigned int cacheTtl;
+    unsigned int cacheMaxEntries;
+    bool         singleFlight;
+    bool         parallelSafe;
+    unsigned int maxConcurrent;
+    unsigned int maxQueued;
+} methodOptions;
+
+static methodOptions const noOptions = {0, 0, false, false, 0, 0};
+
+
+
+static void
+addToMethodList(xmlrpc_env *        const envP,
+                xmlrpc_registry *   const registryP,
+                const char *        const methodName,
+                xmlrpc_methodInfo * const methodP) {
+/*----------------------------------------------------------------------------
+   Add method *methodP, named 'methodName', to the registry, while other
+   threads may be dispatching calls.
+-----------------------------------------------------------------------------*/
+    struct retiredMethodList * retiredP;
+
+    MALLOCVAR(retiredP);
+
+    if (retiredP == NULL)
+        xmlrpc_faultf(envP, "Couldn't allocate memory to retire the "
+                      "current method list");
+    else {
+        xmlrpc_methodList * newMethodListP;
+
+        registryP->updateLockP->acquire(registryP->updateLockP);
+
+        xmlrpc_methodListAdd(envP, registryP->methodListP, methodName,
+                             methodP, &newMethodListP);
+
+        if (!envP->fault_occurred)
+            publishMethodList(registryP, newMethodListP, NULL, retiredP);
+
+        registryP->updateLockP->release(registryP->updateLockP);
+
+        if (envP->fault_occurred)
+            free(retiredP);
+    }
+}
+
+
+
 static void
 registryAddMethod(xmlrpc_env *      const envP,
                   xmlrpc_registry * const registryP,
                   const char *      const methodName,
                   xmlrpc_method1          method1,
                   xmlrpc_method2          method2,
+                  xmlrpc_method_async     methodAsync,
                   const char *      const signatureString,
                   const char *      const help,
                   void *            const userData,
-                  size_t            const stackSize) {
+                  size_t            const stackSize,
+                  methodOptions     const options) {
 
     const char * const helpString =
         help ? help : "No help is available for this method.";
@@ -110,14 +374,28 @@ registryAddMethod(xmlrpc_env *      const envP,
     XMLRPC_ASSERT_ENV_OK(envP);
     XMLRPC_ASSERT_PTR_OK(registryP);
     XMLRPC_ASSERT_PTR_OK(methodName);
-    XMLRPC_ASSERT(method1 != NULL || method2 != NULL);
+    XMLRPC_ASSERT(method1 != NULL || method2 != NULL || methodAsync != NULL);
 
-    xmlrpc_methodCreate(envP, method1, method2, userData,
+    xmlrpc_methodCreate(envP, method1, method2, methodAsync, userData,
                         signatureString, helpString, stackSize, &methodP);
 
     if (!envP->fault_occurred) {
-        xmlrpc_methodListAdd(envP, registryP->methodListP, methodName,
-                             methodP);
+        if (options.cacheTtl > 0)
+            xmlrpc_methodCacheCreate(envP, options.cacheTtl,
+                                     options.cacheMaxEntries,
+                                     &methodP->cacheP);
+
+        if (!envP->fault_occurred && options.singleFlight)
+            xmlrpc_singleFlightCreate(envP, &methodP->singleFlightP);
+
+        methodP->parallelSafe = options.parallelSafe;
+
+        if (!envP->fault_occurred && options.maxConcurrent > 0)
+            xmlrpc_bulkheadCreate(envP, options.maxConcurrent,
+                                  options.maxQueued, &methodP->bulkheadP);
+
+        if (!envP->fault_occurred)
+            addToMethodList(envP, registryP, methodName, methodP);
 
         if (envP->fault_occurred)
             xmlrpc_methodDestroy(methodP);
@@ -139,8 +417,8 @@ xmlrpc_registry_add_method_w_doc(
 
     XMLRPC_ASSERT(host == NULL);
 
-    registryAddMethod(envP, registryP, methodName, method, NULL,
-                      signatureString, help, serverInfo, 0);
+    registryAddMethod(envP, registryP, methodName, method, NULL, NULL,
+                      signatureString, help, serverInfo, 0, noOptions);
 }
 
 
@@ -169,8 +447,31 @@ xmlrpc_registry_add_method2(xmlrpc_env *      const envP,
                             const char *      const help,
                             void *            const serverInfo) {
 
-    registryAddMethod(envP, registryP, methodName, NULL, method,
-                      signatureString, help, serverInfo, 0);
+    registryAddMethod(envP, registryP, methodName, NULL, method, NULL,
+                      signatureString, help, serverInfo, 0, noOptions);
+}
+
+
+
+void
+xmlrpc_registry_add_method_async(xmlrpc_env *        const envP,
+                                 xmlrpc_registry *   const registryP,
+                                 const char *        const methodName,
+                                 xmlrpc_method_async       method,
+                                 const char *        const signatureString,
+                                 const char *        const help,
+                                 void *              const serverInfo) {
+/*----------------------------------------------------------------------------
+   Add an asynchronous method: one that may complete the call after it
+   returns, with xmlrpc_completion_finish().
+
+   xmlrpc_registry_process_call_async() lets the call go on without a
+   thread.  Everything else that executes a call, e.g.
+   xmlrpc_registry_process_call2() and system.multicall, waits for the
+   method to complete it.
+-----------------------------------------------------------------------------*/
+    registryAddMethod(envP, registryP, methodName, NULL, NULL, method,
+                      signatureString, help, serverInfo, 0, noOptions);
 }
 
 
@@ -182,9 +483,225 @@ xmlrpc_registry_add_method3(
     const struct xmlrpc_method_info3 * const infoP) {
 
     registryAddMethod(envP, registryP, infoP->methodName, NULL,
-                      infoP->methodFunction,
+                      infoP->methodFunction, NULL,
                       infoP->signatureString, infoP->help, infoP->serverInfo,
-                      infoP->stackSize);
+                      infoP->stackSize, noOptions);
+}
+
+
+
+void
+xmlrpc_registry_add_method4(
+    xmlrpc_env *                       const envP,
+    xmlrpc_registry *                  const registryP,
+    const struct xmlrpc_method_info4 * const infoP,
+    unsigned int                       const infoSize) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_registry_add_method3(), plus optional response caching,
+   coalescing of identical concurrent calls, and a limit on concurrent
+   calls, and the option of an asynchronous method.
+
+   'infoSize' is the size of *infoP the caller knows about; members beyond
+   it take default values.
+-----------------------------------------------------------------------------*/
+    methodOptions options;
+    xmlrpc_method_async methodFunctionAsync;
+
+    options = noOptions;
+
+    if (infoSize >= XMLRPC_MI4SIZE(cacheTtl))
+        options.cacheTtl = infoP->cacheTtl;
+    if (infoSize >= XMLRPC_MI4SIZE(cacheMaxEntries))
+        options.cacheMaxEntries = infoP->cacheMaxEntries;
+    if (infoSize >= XMLRPC_MI4SIZE(singleFlight))
+        options.singleFlight = !!infoP->singleFlight;
+    if (infoSize >= XMLRPC_MI4SIZE(parallelSafe))
+        options.parallelSafe = !!infoP->parallelSafe;
+    if (infoSize >= XMLRPC_MI4SIZE(maxConcurrent))
+        options.maxConcurrent = infoP->maxConcurrent;
+    if (infoSize >= XMLRPC_MI4SIZE(maxQueued))
+        options.maxQueued = infoP->maxQueued;
+    if (infoSize >= XMLRPC_MI4SIZE(methodFunctionAsync))
+        methodFunctionAsync = infoP->methodFunctionAsync;
+    else
+        methodFunctionAsync = NULL;
+
+    if (infoSize < XMLRPC_MI4SIZE(help))
+        xmlrpc_faultf(envP, "Method information structure size %u is too "
+                      "small.  It must have at least the members of "
+                      "struct xmlrpc_method_info3", infoSize);
+    else if (methodFunctionAsync && infoP->methodFunction)
+        xmlrpc_faultf(envP, "Method has both a synchronous and an "
+                      "asynchronous function");
+    else if (methodFunctionAsync &&
+             (options.cacheTtl > 0 || options.singleFlight))
+        xmlrpc_faultf(envP, "An asynchronous method can't cache its "
+                      "responses or coalesce calls");
+    else
+        registryAddMethod(envP, registryP, infoP->methodName, NULL,
+                          infoP->methodFunction, methodFunctionAsync,
+                          infoP->signatureString, infoP->help,
+                          infoP->serverInfo, infoP->stackSize, options);
+}
+
+
+
+void
+xmlrpc_registry_remove_method(xmlrpc_env *      const envP,
+                              xmlrpc_registry * const registryP,
+                              const char *      const methodName) {
+/*----------------------------------------------------------------------------
+   Remove the method named 'methodName' from the registry.
+
+   Other threads may be dispatching calls meanwhile.  A call that
+   dispatches after we return doesn't find the method, but one already
+   executing it continues to, so the method's function and user data
+   must remain valid for that.
+-----------------------------------------------------------------------------*/
+    struct retiredMethodList * retiredP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+    XMLRPC_ASSERT_PTR_OK(methodName);
+
+    MALLOCVAR(retiredP);
+
+    if (retiredP == NULL)
+        xmlrpc_faultf(envP, "Couldn't allocate memory to retire the "
+                      "current method list");
+    else {
+        xmlrpc_methodList * newMethodListP;
+        xmlrpc_methodNode * removedNodeP;
+
+        registryP->updateLockP->acquire(registryP->updateLockP);
+
+        xmlrpc_methodListRemove(envP, registryP->methodListP, methodName,
+                                &newMethodListP, &removedNodeP);
+
+        if (!envP->fault_occurred)
+            publishMethodList(registryP, newMethodListP, removedNodeP,
+                              retiredP);
+
+        registryP->updateLockP->release(registryP->updateLockP);
+
+        if (envP->fault_occurred)
+            free(retiredP);
+    }
+}
+
+
+
+void
+xmlrpc_registry_get_method_cache_stats(
+    xmlrpc_env *                       const envP,
+    xmlrpc_registry *                  const registryP,
+    const char *                       const methodName,
+    struct xmlrpc_method_cache_stats * const statsP) {
+
+    xmlrpc_methodList * methodListP;
+    xmlrpc_methodInfo * methodP;
+    unsigned int readerSlot;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+
+    xmlrpc_registryReadBegin(registryP, &methodListP, &readerSlot);
+
+    xmlrpc_methodListLookupByName(methodListP, methodName, &methodP);
+
+    if (!methodP)
+        xmlrpc_env_set_fault_formatted(
+            envP, XMLRPC_NO_SUCH_METHOD_ERROR,
+            "Method '%s' not defined", methodName);
+    else if (!methodP->cacheP)
+        xmlrpc_faultf(envP, "Method '%s' does not cache its responses",
+                      methodName);
+    else
+        xmlrpc_methodCacheGetStats(methodP->cacheP, statsP);
+
+    xmlrpc_registryReadEnd(registryP, readerSlot);
+}
+
+
+
+void
+xmlrpc_registry_get_method_load_stats(
+    xmlrpc_env *                      const envP,
+    xmlrpc_registry *                 const registryP,
+    const char *                      const methodName,
+    struct xmlrpc_method_load_stats * const statsP) {
+
+    xmlrpc_methodList * methodListP;
+    xmlrpc_methodInfo * methodP;
+    unsigned int readerSlot;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+
+    xmlrpc_registryReadBegin(registryP, &methodListP, &readerSlot);
+
+    xmlrpc_methodListLookupByName(methodListP, methodName, &methodP);
+
+    if (!methodP)
+        xmlrpc_env_set_fault_formatted(
+            envP, XMLRPC_NO_SUCH_METHOD_ERROR,
+            "Method '%s' not defined", methodName);
+    else if (!methodP->bulkheadP)
+        xmlrpc_faultf(envP, "Method '%s' has no concurrency limit",
+                      methodName);
+    else
+        xmlrpc_bulkheadGetStats(methodP->bulkheadP, statsP);
+
+    xmlrpc_registryReadEnd(registryP, readerSlot);
+}
+
+
+
+void
+xmlrpc_registry_set_multicall_parallel(
+    xmlrpc_env *                          const envP,
+    xmlrpc_registry *                     const registryP,
+    const struct xmlrpc_multicall_parms * const parmsP,
+    unsigned int                          const parmSize) {
+/*----------------------------------------------------------------------------
+   Have system.multicall execute the calls of parallel-safe methods on a
+   pool of worker threads, at the same time as each other, instead of
+   one after another.  It still returns the results in the order of the
+   calls.
+
+   A call of a method that isn't parallel-safe still executes on the
+   multicall's own thread, after all the calls before it finish and
+   before any after it start.
+
+   Do this at most once, before the registry serves any calls.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+
+    if (parmSize < XMLRPC_MCPSIZE(threads))
+        xmlrpc_faultf(envP, "Multicall parameter structure size %u is too "
+                      "small.  It must have at least the 'threads' member",
+                      parmSize);
+    else if (parmsP->threads < 1)
+        xmlrpc_faultf(envP, "Multicall thread count must be at least 1");
+    else if (registryP->multicallPoolP)
+        xmlrpc_faultf(envP, "Parallel multicall is already set up "
+                      "for this registry");
+    else {
+        unsigned int const maxFanout =
+            parmSize >= XMLRPC_MCPSIZE(max_fanout) && parmsP->max_fanout > 0 ?
+            parmsP->max_fanout : parmsP->threads;
+
+        xmlrpc_callPoolCreate(envP, parmsP->threads,
+                              &registryP->multicallPoolP);
+
+        if (!envP->fault_occurred) {
+            registryP->multicallMaxFanout = maxFanout;
+            registryP->multicallAllParallel =
+                parmSize >= XMLRPC_MCPSIZE(all_parallel_safe) &&
+                parmsP->all_parallel_safe;
+        }
+    }
 }
 
 
@@ -234,15 +751,19 @@ xmlrpc_registry_max_stackSize(xmlrpc_registry * const registryP) {
 
    If there are no methods, return 0.
 -----------------------------------------------------------------------------*/
-    xmlrpc_methodNode * p;
+    xmlrpc_methodList * methodListP;
+    unsigned int readerSlot;
     size_t stackSize;
+    unsigned int i;
 
-    for (p = registryP->methodListP->firstMethodP, stackSize = 0;
-         p;
-         p = p->nextP) {
+    xmlrpc_registryReadBegin(registryP, &methodListP, &readerSlot);
 
-        stackSize = MAX(stackSize, methodStackSize(p->methodP));
+    for (i = 0, stackSize = 0; i < methodListP->methodCt; ++i) {
+        stackSize = MAX(stackSize,
+                        methodStackSize(methodListP->methods[i]->methodP));
     }
+    xmlrpc_registryReadEnd(registryP, readerSlot);
+
     return stackSize;
 }
 
@@ -295,14 +816,147 @@ xmlrpc_registry_set_dialect(xmlrpc_env *      const envP,
 
 
 
+/*=========================================================================
+  Completion of a call of an asynchronous method
+
+  Whoever executes the call decides what completing it does: either wake
+  up a thread that waits for it (waitForAsyncMethod) or serialize the
+  response and hand it over (see xmlrpc_registry_process_call_async).
+=========================================================================*/
+
+typedef void completionFinishFn(xmlrpc_completion * const completionP,
+                                const xmlrpc_env *  const faultP,
+                                xmlrpc_value *      const resultP);
+
+struct xmlrpc_completion {
+    completionFinishFn * finish;
+
+    /* For a thread that waits for the call: */
+
+    struct xmlrpc_event * doneEventP;
+    xmlrpc_env fault;
+        /* The fault with which the call failed */
+    xmlrpc_value * resultP;
+        /* The result of the call, if it succeeded */
+
+    /* For a call that goes on without a thread: */
+
+    xmlrpc_registry * registryP;
+    unsigned int readerSlot;
+        /* The method list version the call uses, which must stay until
+           the call completes (see xmlrpc_registryReadBegin).
+        */
+    xmlrpc_value * paramArrayP;
+        /* Our reference to the parameters, which the method may use
+           until the call completes.
+        */
+    struct xmlrpc_bulkhead * bulkheadP;
+        /* The method's concurrency limit, in which the call has a place
+           until it completes.  NULL if none.
+        */
+    xmlrpc_registry_response_handler handler;
+    void * handlerArg;
+};
+
+
+
+void
+xmlrpc_completion_finish(xmlrpc_completion * const completionP,
+                         const xmlrpc_env *  const faultP,
+                         xmlrpc_value *      const resultP) {
+
+    XMLRPC_ASSERT_PTR_OK(completionP);
+    XMLRPC_ASSERT(faultP == NULL || faultP->fault_occurred ||
+                  resultP != NULL);
+
+    completionP->finish(completionP, faultP, resultP);
+}
+
+
+
+static completionFinishFn wakeWaiter;
+
 static void
-callNamedMethod(xmlrpc_env *        const envP,
-                xmlrpc_methodInfo * const methodP,
-                xmlrpc_value *      const paramArrayP,
-                void *              const callInfoP,
-                xmlrpc_value **     const resultPP) {
+wakeWaiter(xmlrpc_completion * const completionP,
+           const xmlrpc_env *  const faultP,
+           xmlrpc_value *      const resultP) {
+
+    if (faultP && faultP->fault_occurred)
+        xmlrpc_env_set_fault(&completionP->fault, faultP->fault_code,
+                             faultP->fault_string);
+    else {
+        xmlrpc_INCREF(resultP);
+        completionP->resultP = resultP;
+    }
+    /* The waiter may destroy *completionP as soon as we do this */
+    xmlrpc_event_set(completionP->doneEventP);
+}
+
+
 
-    if (methodP->methodFnType2)
+static void
+waitForAsyncMethod(xmlrpc_env *        const envP,
+                   xmlrpc_methodInfo * const methodP,
+                   xmlrpc_value *      const paramArrayP,
+                   void *              const callInfoP,
+                   xmlrpc_value **     const resultPP) {
+/*----------------------------------------------------------------------------
+   Execute asynchronous method *methodP and wait for it to complete the
+   call.
+-----------------------------------------------------------------------------*/
+    xmlrpc_completion completion;
+    const char * error;
+
+    xmlrpc_event_create(&completion.doneEventP, &error);
+
+    if (error) {
+        xmlrpc_faultf(envP, "Unable to create an event on which to wait "
+                      "for asynchronous method.  %s", error);
+        xmlrpc_strfree(error);
+    } else {
+        completion.finish  = &wakeWaiter;
+        completion.resultP = NULL;
+        xmlrpc_env_init(&completion.fault);
+
+        methodP->methodFnAsync(paramArrayP, methodP->userData, callInfoP,
+                               &completion);
+
+        xmlrpc_event_wait(completion.doneEventP);
+
+        if (completion.fault.fault_occurred)
+            xmlrpc_env_set_fault(envP, completion.fault.fault_code,
+                                 completion.fault.fault_string);
+        else
+            *resultPP = completion.resultP;
+
+        xmlrpc_env_clean(&completion.fault);
+        xmlrpc_event_destroy(completion.doneEventP);
+    }
+}
+
+
+
+static void
+setBusyFault(xmlrpc_env * const envP) {
+
+    xmlrpc_env_set_fault(envP, XMLRPC_METHOD_BUSY_ERROR,
+                         "The method is executing as many calls as it may "
+                         "at once, and can't queue any more.  "
+                         "Try again later.");
+}
+
+
+
+static void
+callMethodFunction(xmlrpc_env *        const envP,
+                   xmlrpc_methodInfo * const methodP,
+                   xmlrpc_value *      const paramArrayP,
+                   void *              const callInfoP,
+                   xmlrpc_value **     const resultPP) {
+
+    if (methodP->methodFnAsync)
+        waitForAsyncMethod(envP, methodP, paramArrayP, callInfoP, resultPP);
+    else if (methodP->methodFnType2)
         *resultPP =
             methodP->methodFnType2(envP, paramArrayP,
                                    methodP->userData, callInfoP);
@@ -315,6 +969,85 @@ callNamedMethod(xmlrpc_env *        const envP,
 
 
 
+static void
+callNamedMethod(xmlrpc_env *        const envP,
+                xmlrpc_methodInfo * const methodP,
+                xmlrpc_value *      const paramArrayP,
+                void *              const callInfoP,
+                uint64_t            const deadlineMs,
+                xmlrpc_value **     const resultPP) {
+/*----------------------------------------------------------------------------
+   Call method *methodP, within its concurrency limit, if any: wait for
+   our turn if the method is at its limit, or fail if we can't even wait.
+
+   'deadlineMs' is when the client will give up on the call, as
+   xmlrpc_monotonic_ms() tells time; zero means never.  It orders the wait,
+   and if it passes during the wait, we fail the call instead of calling
+   the method.
+-----------------------------------------------------------------------------*/
+    xmlrpc_bulkhead * const bulkheadP = methodP->bulkheadP;
+
+    bool admitted;
+
+    if (bulkheadP)
+        xmlrpc_bulkheadEnter(envP, bulkheadP, true, deadlineMs, &admitted);
+    else
+        admitted = true;
+
+    if (!envP->fault_occurred) {
+        if (!admitted)
+            setBusyFault(envP);
+        else {
+            if (deadlineMs != 0 && xmlrpc_monotonic_ms() >= deadlineMs)
+                xmlrpc_env_set_fault(envP, XMLRPC_TIMEOUT_ERROR,
+                                     "The client's timeout expired while "
+                                     "the call waited to execute");
+            else
+                callMethodFunction(envP, methodP, paramArrayP, callInfoP,
+                                   resultPP);
+
+            if (bulkheadP)
+                xmlrpc_bulkheadLeave(bulkheadP);
+        }
+    }
+}
+
+
+
+static void
+callMethodOrDefault(xmlrpc_env *        const envP,
+                    xmlrpc_registry *   const registryP,
+                    xmlrpc_methodInfo * const methodP,
+                    const char *        const methodName,
+                    xmlrpc_value *      const paramArrayP,
+                    void *              const callInfoP,
+                    uint64_t            const deadlineMs,
+                    xmlrpc_value **     const resultPP) {
+/*----------------------------------------------------------------------------
+   Call method *methodP, or the registry's default method if 'methodP' is
+   NULL (i.e. there is no method named 'methodName').
+
+   'deadlineMs' is as for callNamedMethod().
+-----------------------------------------------------------------------------*/
+    if (methodP)
+        callNamedMethod(envP, methodP, paramArrayP, callInfoP, deadlineMs,
+                        resultPP);
+    else {
+        if (registryP->defaultMethodFunction)
+            *resultPP = registryP->defaultMethodFunction(
+                envP, callInfoP, methodName, paramArrayP,
+                registryP->defaultMethodUserData);
+        else {
+            /* No matching method, and no default. */
+            xmlrpc_env_set_fault_formatted(
+                envP, XMLRPC_NO_SUCH_METHOD_ERROR,
+                "Method '%s' not defined", methodName);
+        }
+    }
+}
+
+
+
 void
 xmlrpc_dispatchCall(xmlrpc_env *      const envP,
                     xmlrpc_registry * const registryP,
@@ -328,25 +1061,18 @@ xmlrpc_dispatchCall(xmlrpc_env *      const envP,
                                      registryP->preinvokeUserData);
 
     if (!envP->fault_occurred) {
+        xmlrpc_methodList * methodListP;
         xmlrpc_methodInfo * methodP;
+        unsigned int readerSlot;
 
-        xmlrpc_methodListLookupByName(registryP->methodListP, methodName,
-                                      &methodP);
+        xmlrpc_registryReadBegin(registryP, &methodListP, &readerSlot);
 
-        if (methodP)
-            callNamedMethod(envP, methodP, paramArrayP, callInfoP, resultPP);
-        else {
-            if (registryP->defaultMethodFunction)
-                *resultPP = registryP->defaultMethodFunction(
-                    envP, callInfoP, methodName, paramArrayP,
-                    registryP->defaultMethodUserData);
-            else {
-                /* No matching method, and no default. */
-                xmlrpc_env_set_fault_formatted(
-                    envP, XMLRPC_NO_SUCH_METHOD_ERROR,
-                    "Method '%s' not defined", methodName);
-            }
-        }
+        xmlrpc_methodListLookupByName(methodListP, methodName, &methodP);
+
+        callMethodOrDefault(envP, registryP, methodP, methodName,
+                            paramArrayP, callInfoP, 0, resultPP);
+
+        xmlrpc_registryReadEnd(registryP, readerSlot);
     }
     /* For backward compatibility, for sloppy users: */
     if (envP->fault_occurred)
@@ -385,71 +1111,483 @@ serializeFault(xmlrpc_env *       const envP,
 
 
 
-void
-xmlrpc_registry_process_call2(xmlrpc_env *        const envP,
-                              xmlrpc_registry *   const registryP,
-                              const char *        const callXml,
-                              size_t              const callXmlLen,
-                              void *              const callInfo,
-                              xmlrpc_mem_block ** const responseXmlPP) {
+static void
+executeMethod(xmlrpc_env *        const envP,
+              xmlrpc_registry *   const registryP,
+              xmlrpc_methodInfo * const methodP,
+              xmlrpc_value *      const paramArrayP,
+              unsigned int        const paramHash,
+              void *              const callInfo,
+              uint64_t            const deadlineMs,
+              xmlrpc_env *        const faultP,
+              xmlrpc_mem_block *  const responseXmlP) {
+/*----------------------------------------------------------------------------
+   Execute method *methodP and append its response to *responseXmlP.  If it
+   succeeds and the method caches its responses, add the response to the
+   cache.  We don't cache fault responses.
+-----------------------------------------------------------------------------*/
+    xmlrpc_value * resultP;
 
-    xmlrpc_mem_block * responseXmlP;
+    callNamedMethod(faultP, methodP, paramArrayP, callInfo, deadlineMs,
+                    &resultP);
 
-    XMLRPC_ASSERT_ENV_OK(envP);
-    XMLRPC_ASSERT_PTR_OK(callXml);
+    if (!faultP->fault_occurred) {
+        size_t const startSize = XMLRPC_MEMBLOCK_SIZE(char, responseXmlP);
 
-    xmlrpc_traceXml("XML-RPC CALL", callXml, callXmlLen);
+        xmlrpc_serialize_response2(envP, responseXmlP,
+                                   resultP, registryP->dialect);
+
+        if (!envP->fault_occurred && methodP->cacheP)
+            xmlrpc_methodCacheAdd(
+                methodP->cacheP, paramArrayP, paramHash, registryP->dialect,
+                XMLRPC_MEMBLOCK_CONTENTS(char, responseXmlP) + startSize,
+                XMLRPC_MEMBLOCK_SIZE(char, responseXmlP) - startSize);
+
+        xmlrpc_DECREF(resultP);
+    }
+}
+
+
+
+static void
+executeMethodSingleFlight(xmlrpc_env *        const envP,
+                          xmlrpc_registry *   const registryP,
+                          xmlrpc_methodInfo * const methodP,
+                          xmlrpc_value *      const paramArrayP,
+                          unsigned int        const paramHash,
+                          void *              const callInfo,
+                          uint64_t            const deadlineMs,
+                          xmlrpc_env *        const faultP,
+                          xmlrpc_mem_block *  const responseXmlP) {
+/*----------------------------------------------------------------------------
+   Same as executeMethod(), except that if a call of the method with the
+   same parameters is executing right now, wait for it and use its response
+   instead of executing the method again.
+
+   Note that in that case, the method never sees this call's 'callInfo'.
+-----------------------------------------------------------------------------*/
+    xmlrpc_singleFlight * const singleFlightP = methodP->singleFlightP;
+
+    xmlrpc_flight * flightP;
+    bool isLeader;
+
+    xmlrpc_singleFlightJoin(envP, singleFlightP, paramArrayP, paramHash,
+                            registryP->dialect, &flightP, &isLeader);
 
-    /* Allocate our output buffer.
-    ** If this fails, we need to die in a special fashion. */
-    responseXmlP = XMLRPC_MEMBLOCK_NEW(char, envP, 0);
     if (!envP->fault_occurred) {
-        const char * methodName;
-        xmlrpc_value * paramArrayP;
-        xmlrpc_env fault;
-        xmlrpc_env parseEnv;
+        if (isLeader) {
+            size_t const startSize = XMLRPC_MEMBLOCK_SIZE(char, responseXmlP);
+
+            executeMethod(envP, registryP, methodP, paramArrayP, paramHash,
+                          callInfo, deadlineMs, faultP, responseXmlP);
+
+            xmlrpc_singleFlightLand(
+                singleFlightP, flightP, faultP,
+                envP->fault_occurred ? NULL :
+                XMLRPC_MEMBLOCK_CONTENTS(char, responseXmlP) + startSize,
+                envP->fault_occurred ? 0 :
+                XMLRPC_MEMBLOCK_SIZE(char, responseXmlP) - startSize);
+        } else {
+            bool gotResult;
+
+            xmlrpc_singleFlightAwait(envP, singleFlightP, flightP,
+                                     faultP, responseXmlP, &gotResult);
+
+            if (!envP->fault_occurred && !gotResult)
+                executeMethod(envP, registryP, methodP, paramArrayP,
+                              paramHash, callInfo, deadlineMs, faultP,
+                              responseXmlP);
+        }
+    }
+}
 
-        xmlrpc_env_init(&fault);
-        xmlrpc_env_init(&parseEnv);
 
-        xmlrpc_parse_call(&parseEnv, callXml, callXmlLen,
-                          &methodName, &paramArrayP);
 
-        if (parseEnv.fault_occurred)
-            xmlrpc_env_set_fault_formatted(
-                &fault, XMLRPC_PARSE_ERROR,
-                "Call XML not a proper XML-RPC call.  %s",
-                parseEnv.fault_string);
+static void
+processSharedCall(xmlrpc_env *        const envP,
+                  xmlrpc_registry *   const registryP,
+                  xmlrpc_methodInfo * const methodP,
+                  xmlrpc_value *      const paramArrayP,
+                  void *              const callInfo,
+                  uint64_t            const deadlineMs,
+                  xmlrpc_env *        const faultP,
+                  xmlrpc_mem_block *  const responseXmlP) {
+/*----------------------------------------------------------------------------
+   Same as processCall(), for a method that caches its responses or
+   coalesces identical concurrent calls, or both.  Both are keyed by the
+   parameter list.
+-----------------------------------------------------------------------------*/
+    unsigned int const paramHash = xmlrpc_value_hash(paramArrayP);
+
+    bool hit;
+
+    if (methodP->cacheP)
+        xmlrpc_methodCacheLookup(envP, methodP->cacheP, paramArrayP,
+                                 paramHash, registryP->dialect,
+                                 responseXmlP, &hit);
+    else
+        hit = false;
+
+    if (!envP->fault_occurred && !hit) {
+        if (methodP->singleFlightP)
+            executeMethodSingleFlight(envP, registryP, methodP, paramArrayP,
+                                      paramHash, callInfo, deadlineMs, faultP,
+                                      responseXmlP);
+        else
+            executeMethod(envP, registryP, methodP, paramArrayP, paramHash,
+                          callInfo, deadlineMs, faultP, responseXmlP);
+    }
+}
+
+
+
+static void
+startAsyncCall(xmlrpc_registry *   const registryP,
+               xmlrpc_methodInfo * const methodP,
+               unsigned int        const readerSlot,
+               xmlrpc_value *      const paramArrayP,
+               void *              const callInfo,
+               xmlrpc_completion * const completionP,
+               xmlrpc_env *        const faultP,
+               bool *              const startedP) {
+/*----------------------------------------------------------------------------
+   Start asynchronous method *methodP on a call that goes on without a
+   thread, which *completionP completes.  The completion takes over our
+   read of the registry ('readerSlot').
+
+   Without a thread, the call can't wait in the method's concurrency limit
+   queue, so if the method is at its limit, we fail the call as *faultP
+   and return *startedP false.
+-----------------------------------------------------------------------------*/
+    xmlrpc_bulkhead * const bulkheadP = methodP->bulkheadP;
+
+    bool admitted;
+
+    if (bulkheadP)
+        xmlrpc_bulkheadEnter(faultP, bulkheadP, false, 0, &admitted);
+    else
+        admitted = true;
+
+    if (!faultP->fault_occurred && !admitted)
+        setBusyFault(faultP);
+
+    if (faultP->fault_occurred)
+        *startedP = false;
+    else {
+        completionP->registryP   = registryP;
+        completionP->readerSlot  = readerSlot;
+        completionP->paramArrayP = paramArrayP;
+        completionP->bulkheadP   = bulkheadP;
+
+        xmlrpc_INCREF(paramArrayP);
+
+        /* The method may complete the call, which destroys *completionP,
+           before it returns.
+        */
+        methodP->methodFnAsync(paramArrayP, methodP->userData, callInfo,
+                               completionP);
+
+        *startedP = true;
+    }
+}
+
+
+
+static void
+processCall(xmlrpc_env *        const envP,
+            xmlrpc_registry *   const registryP,
+            const char *        const methodName,
+            xmlrpc_value *      const paramArrayP,
+            void *              const callInfo,
+            uint64_t            const deadlineMs,
+            xmlrpc_completion * const completionP,
+            xmlrpc_env *        const faultP,
+            xmlrpc_mem_block *  const responseXmlP,
+            bool *              const deferredP) {
+/*----------------------------------------------------------------------------
+   Execute the call of method 'methodName' with parameters *paramArrayP and
+   append the XML-RPC response to *responseXmlP.
+
+   If the call fails, return the fault as *faultP and append nothing.
+
+   If we fail to produce a response at all, return the failure as *envP.
+
+   If 'completionP' is not NULL and the method is asynchronous, we don't
+   wait for the method; *completionP completes the call and we return
+   *deferredP true and nothing else (unless the method is at its
+   concurrency limit, in which case the call fails).
+
+   'deadlineMs' is as for callNamedMethod().
+-----------------------------------------------------------------------------*/
+    *deferredP = false;
+
+    if (registryP->preinvokeFunction)
+        registryP->preinvokeFunction(faultP, methodName, paramArrayP,
+                                     registryP->preinvokeUserData);
+
+    if (!faultP->fault_occurred) {
+        xmlrpc_methodList * methodListP;
+        xmlrpc_methodInfo * methodP;
+        unsigned int readerSlot;
+
+        /* We keep the method list version through the call, so the
+           method continues to exist even if someone removes it.
+        */
+        xmlrpc_registryReadBegin(registryP, &methodListP, &readerSlot);
+
+        xmlrpc_methodListLookupByName(methodListP, methodName, &methodP);
+
+        if (completionP && methodP && methodP->methodFnAsync)
+            startAsyncCall(registryP, methodP, readerSlot, paramArrayP,
+                           callInfo, completionP, faultP, deferredP);
+        else if (methodP && (methodP->cacheP || methodP->singleFlightP))
+            processSharedCall(envP, registryP, methodP, paramArrayP,
+                              callInfo, deadlineMs, faultP, responseXmlP);
         else {
             xmlrpc_value * resultP;
 
-            xmlrpc_dispatchCall(&fault, registryP, methodName, paramArrayP,
-                                callInfo, &resultP);
+            callMethodOrDefault(faultP, registryP, methodP, methodName,
+                                paramArrayP, callInfo, deadlineMs, &resultP);
 
-            if (!fault.fault_occurred) {
+            if (!faultP->fault_occurred) {
                 xmlrpc_serialize_response2(envP, responseXmlP,
                                            resultP, registryP->dialect);
 
                 xmlrpc_DECREF(resultP);
             }
-            xmlrpc_strfree(methodName);
-            xmlrpc_DECREF(paramArrayP);
         }
-        if (!envP->fault_occurred && fault.fault_occurred)
-            serializeFault(envP, fault, responseXmlP);
+        if (!*deferredP)
+            xmlrpc_registryReadEnd(registryP, readerSlot);
+    }
+}
+
 
-        xmlrpc_env_clean(&parseEnv);
-        xmlrpc_env_clean(&fault);
+
+static void
+processCallXml(xmlrpc_env *        const envP,
+               xmlrpc_registry *   const registryP,
+               const char *        const callXml,
+               size_t              const callXmlLen,
+               void *              const callInfo,
+               uint64_t            const deadlineMs,
+               xmlrpc_completion * const completionP,
+               xmlrpc_mem_block *  const responseXmlP,
+               bool *              const deferredP) {
+/*----------------------------------------------------------------------------
+   Execute the XML-RPC call 'callXml' and append the response, which may be
+   a fault response, to *responseXmlP.
+
+   'deadlineMs', 'completionP', and *deferredP are as for processCall().
+-----------------------------------------------------------------------------*/
+    const char * methodName;
+    xmlrpc_value * paramArrayP;
+    xmlrpc_env fault;
+    xmlrpc_env parseEnv;
+
+    xmlrpc_traceXml("XML-RPC CALL", callXml, callXmlLen);
+
+    xmlrpc_env_init(&fault);
+    xmlrpc_env_init(&parseEnv);
+
+    xmlrpc_parse_call(&parseEnv, callXml, callXmlLen,
+                      &methodName, &paramArrayP);
+
+    if (parseEnv.fault_occurred) {
+        xmlrpc_env_set_fault_formatted(
+            &fault, XMLRPC_PARSE_ERROR,
+            "Call XML not a proper XML-RPC call.  %s",
+            parseEnv.fault_string);
+        *deferredP = false;
+    } else {
+        processCall(envP, registryP, methodName, paramArrayP, callInfo,
+                    deadlineMs, completionP, &fault, responseXmlP, deferredP);
+
+        xmlrpc_strfree(methodName);
+        xmlrpc_DECREF(paramArrayP);
+    }
+    if (!envP->fault_occurred && fault.fault_occurred)
+        serializeFault(envP, fault, responseXmlP);
+
+    if (!envP->fault_occurred && !*deferredP)
+        xmlrpc_traceXml("XML-RPC RESPONSE",
+                        XMLRPC_MEMBLOCK_CONTENTS(char, responseXmlP),
+                        XMLRPC_MEMBLOCK_SIZE(char, responseXmlP));
+
+    xmlrpc_env_clean(&parseEnv);
+    xmlrpc_env_clean(&fault);
+}
+
+
+
+static void
+processCallDeadline(xmlrpc_env *        const envP,
+                    xmlrpc_registry *   const registryP,
+                    const char *        const callXml,
+                    size_t              const callXmlLen,
+                    void *              const callInfo,
+                    uint64_t            const deadlineMs,
+                    xmlrpc_mem_block ** const responseXmlPP) {
+
+    xmlrpc_mem_block * responseXmlP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(callXml);
+
+    /* Allocate our output buffer.
+    ** If this fails, we need to die in a special fashion. */
+    responseXmlP = XMLRPC_MEMBLOCK_NEW(char, envP, 0);
+    if (!envP->fault_occurred) {
+        bool deferred;
+
+        processCallXml(envP, registryP, callXml, callXmlLen, callInfo,
+                       deadlineMs, NULL, responseXmlP, &deferred);
+
+        assert(!deferred);
 
         if (envP->fault_occurred)
             XMLRPC_MEMBLOCK_FREE(char, responseXmlP);
-        else {
+        else
             *responseXmlPP = responseXmlP;
+    }
+}
+
+
+
+void
+xmlrpc_registry_process_call2(xmlrpc_env *        const envP,
+                              xmlrpc_registry *   const registryP,
+                              const char *        const callXml,
+                              size_t              const callXmlLen,
+                              void *              const callInfo,
+                              xmlrpc_mem_block ** const responseXmlPP) {
+
+    processCallDeadline(envP, registryP, callXml, callXmlLen, callInfo, 0,
+                        responseXmlPP);
+}
+
+
+
+void
+xmlrpc_registry_process_call_deadline(
+    xmlrpc_env *        const envP,
+    xmlrpc_registry *   const registryP,
+    const char *        const callXml,
+    size_t              const callXmlLen,
+    void *              const callInfo,
+    unsigned int        const msLeft,
+    xmlrpc_mem_block ** const responseXmlPP) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_registry_process_call2(), for a call whose client will
+   give up waiting for the response in 'msLeft' milliseconds.
+
+   If the method is at its concurrency limit, the call waits ahead of calls
+   with later deadlines or none.  If the deadline passes while it waits,
+   the call fails with XMLRPC_TIMEOUT_ERROR instead of executing.
+-----------------------------------------------------------------------------*/
+    processCallDeadline(envP, registryP, callXml, callXmlLen, callInfo,
+                        xmlrpc_monotonic_ms() + msLeft, responseXmlPP);
+}
+
+
+
+static completionFinishFn finishAsyncCall;
+
+static void
+finishAsyncCall(xmlrpc_completion * const completionP,
+                const xmlrpc_env *  const faultP,
+                xmlrpc_value *      const resultP) {
+/*----------------------------------------------------------------------------
+   Complete a call that xmlrpc_registry_process_call_async() started:
+   make its response and hand it to the caller's response handler.
+-----------------------------------------------------------------------------*/
+    xmlrpc_registry * const registryP = completionP->registryP;
+
+    xmlrpc_env env;
+    xmlrpc_mem_block * responseXmlP;
+
+    xmlrpc_env_init(&env);
+
+    responseXmlP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    if (!env.fault_occurred) {
+        if (faultP && faultP->fault_occurred)
+            serializeFault(&env, *faultP, responseXmlP);
+        else
+            xmlrpc_serialize_response2(&env, responseXmlP,
+                                       resultP, registryP->dialect);
+
+        if (env.fault_occurred)
+            XMLRPC_MEMBLOCK_FREE(char, responseXmlP);
+        else
             xmlrpc_traceXml("XML-RPC RESPONSE",
                             XMLRPC_MEMBLOCK_CONTENTS(char, responseXmlP),
                             XMLRPC_MEMBLOCK_SIZE(char, responseXmlP));
+    }
+    xmlrpc_DECREF(completionP->paramArrayP);
+
+    if (completionP->bulkheadP)
+        xmlrpc_bulkheadLeave(completionP->bulkheadP);
+
+    xmlrpc_registryReadEnd(registryP, completionP->readerSlot);
+
+    completionP->handler(&env, completionP->handlerArg,
+                         env.fault_occurred ? NULL : responseXmlP);
+
+    free(completionP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+void
+xmlrpc_registry_process_call_async(
+    xmlrpc_registry *                const registryP,
+    const char *                     const callXml,
+    size_t                           const callXmlLen,
+    void *                           const callInfo,
+    xmlrpc_registry_response_handler       handler,
+    void *                           const handlerArg) {
+
+    xmlrpc_env env;
+    xmlrpc_completion * completionP;
+    xmlrpc_mem_block * responseXmlP;
+    bool deferred;
+
+    XMLRPC_ASSERT_PTR_OK(registryP);
+    XMLRPC_ASSERT_PTR_OK(callXml);
+
+    xmlrpc_env_init(&env);
+
+    deferred = false;
+
+    MALLOCVAR(completionP);
+
+    if (completionP == NULL)
+        xmlrpc_faultf(&env, "Unable to allocate memory for the completion "
+                      "of an XML-RPC call");
+    else {
+        completionP->finish     = &finishAsyncCall;
+        completionP->handler    = handler;
+        completionP->handlerArg = handlerArg;
+
+        responseXmlP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+        if (!env.fault_occurred) {
+            processCallXml(&env, registryP, callXml, callXmlLen, callInfo,
+                           0, completionP, responseXmlP, &deferred);
+
+            /* If the call is deferred, the method owns *completionP now
+               and may even have destroyed it already.
+            */
+            if (env.fault_occurred || deferred)
+                XMLRPC_MEMBLOCK_FREE(char, responseXmlP);
         }
+        if (!deferred)
+            free(completionP);
     }
+    if (!deferred)
+        handler(&env, handlerArg, env.fault_occurred ? NULL : responseXmlP);
+
+    xmlrpc_env_clean(&env);
 }
 
 
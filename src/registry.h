@@ -4,6 +4,17 @@
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
 
+struct xmlrpc_methodList;
+
+void
+xmlrpc_registryReadBegin(struct xmlrpc_registry *    const registryP,
+                         struct xmlrpc_methodList ** const methodListPP,
+                         unsigned int *              const readerSlotP);
+
+void
+xmlrpc_registryReadEnd(struct xmlrpc_registry * const registryP,
+                       unsigned int             const readerSlot);
+
 void
 xmlrpc_dispatchCall(struct _xmlrpc_env *     const envP, 
                     struct xmlrpc_registry * const registryP,
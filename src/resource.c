@@ -10,7 +10,9 @@
 
 static size_t limits[XMLRPC_LAST_LIMIT_ID + 1] = {
     XMLRPC_NESTING_LIMIT_DEFAULT,
-    XMLRPC_XML_SIZE_LIMIT_DEFAULT
+    XMLRPC_XML_SIZE_LIMIT_DEFAULT,
+    XMLRPC_SERIALIZE_THREADS_LIMIT_DEFAULT,
+    XMLRPC_SERIALIZE_PARALLEL_MIN_LIMIT_DEFAULT
 };
 
 void
@@ -0,0 +1,313 @@
+/*=========================================================================
+  XML-RPC server method registry
+  Single-flight call coalescing
+===========================================================================
+  A single-flight table keeps track of the calls of a method that are
+  executing right now, by parameter list.  When a call arrives with the same
+  parameters as one that is executing, it doesn't execute the method again;
+  it waits for the executing call (the "leader") to finish and uses the
+  leader's result as its own.
+
+  A "flight" is one execution and the calls that share its result.  The
+  flight is in the table from when the leader starts until it lands;
+  calls that arrive after that start a new flight.
+=========================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bool.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/thread_int.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/base_int.h"
+#include "xmlrpc-c/base.h"
+
+#include "single_flight.h"
+
+#define BUCKET_CT 64
+
+
+typedef enum {
+    RESULT_NONE,
+        /* Leader could not produce a result; waiters must execute the
+           method themselves
+        */
+    RESULT_FAULT,
+    RESULT_RESPONSE
+} resultType;
+
+struct xmlrpc_flight {
+    struct xmlrpc_flight * nextInBucketP;
+    unsigned int           paramHash;
+    xmlrpc_value *         paramArrayP;
+        /* The parameter list of the call.  We hold a reference. */
+    xmlrpc_dialect         dialect;
+    unsigned int           refCt;
+        /* Number of calls (leader and waiters) using this flight.
+           Protected by the table lock.
+        */
+    struct xmlrpc_event *  landedP;
+        /* Set when the leader has landed and the result is valid */
+    resultType             resultType;
+    xmlrpc_env             fault;
+        /* The method's fault.  Meaningful only for RESULT_FAULT */
+    char *                 responseXml;
+    size_t                 responseXmlLen;
+        /* Meaningful only for RESULT_RESPONSE */
+};
+
+struct xmlrpc_singleFlight {
+    struct lock *     lockP;
+    xmlrpc_flight *   buckets[BUCKET_CT];
+        /* Hash table of flights in the air */
+};
+
+
+
+void
+xmlrpc_singleFlightCreate(xmlrpc_env *           const envP,
+                          xmlrpc_singleFlight ** const singleFlightPP) {
+
+    xmlrpc_singleFlight * singleFlightP;
+
+    MALLOCVAR(singleFlightP);
+
+    if (!singleFlightP)
+        xmlrpc_faultf(envP, "Unable to allocate memory for single-flight "
+                      "table");
+    else {
+        unsigned int i;
+
+        for (i = 0; i < BUCKET_CT; ++i)
+            singleFlightP->buckets[i] = NULL;
+
+        singleFlightP->lockP = xmlrpc_lock_create();
+
+        if (!singleFlightP->lockP) {
+            xmlrpc_faultf(envP, "Unable to create lock for single-flight "
+                          "table");
+            free(singleFlightP);
+        } else
+            *singleFlightPP = singleFlightP;
+    }
+}
+
+
+
+void
+xmlrpc_singleFlightDestroy(xmlrpc_singleFlight * const singleFlightP) {
+/*----------------------------------------------------------------------------
+   Destroy the table.  There must be no flights in the air; i.e. no calls
+   may be executing.
+-----------------------------------------------------------------------------*/
+    singleFlightP->lockP->destroy(singleFlightP->lockP);
+
+    free(singleFlightP);
+}
+
+
+
+static void
+flightDestroy(xmlrpc_flight * const flightP) {
+
+    xmlrpc_DECREF(flightP->paramArrayP);
+    xmlrpc_event_destroy(flightP->landedP);
+    xmlrpc_env_clean(&flightP->fault);
+    if (flightP->responseXml)
+        free(flightP->responseXml);
+    free(flightP);
+}
+
+
+
+static void
+flightCreate(xmlrpc_env *     const envP,
+             xmlrpc_value *   const paramArrayP,
+             unsigned int     const paramHash,
+             xmlrpc_dialect   const dialect,
+             xmlrpc_flight ** const flightPP) {
+
+    xmlrpc_flight * flightP;
+
+    MALLOCVAR(flightP);
+
+    if (!flightP)
+        xmlrpc_faultf(envP, "Unable to allocate memory for a flight");
+    else {
+        const char * error;
+
+        xmlrpc_event_create(&flightP->landedP, &error);
+
+        if (error) {
+            xmlrpc_faultf(envP, "Unable to create event for a flight.  %s",
+                          error);
+            xmlrpc_strfree(error);
+            free(flightP);
+        } else {
+            flightP->paramHash      = paramHash;
+            flightP->paramArrayP    = paramArrayP;
+            flightP->dialect        = dialect;
+            flightP->refCt          = 1;
+            flightP->resultType     = RESULT_NONE;
+            flightP->responseXml    = NULL;
+            flightP->responseXmlLen = 0;
+            xmlrpc_env_init(&flightP->fault);
+            xmlrpc_INCREF(paramArrayP);
+
+            *flightPP = flightP;
+        }
+    }
+}
+
+
+
+static void
+releaseFlight(xmlrpc_singleFlight * const singleFlightP,
+              xmlrpc_flight *       const flightP) {
+
+    bool isLast;
+
+    singleFlightP->lockP->acquire(singleFlightP->lockP);
+
+    --flightP->refCt;
+    isLast = (flightP->refCt == 0);
+
+    singleFlightP->lockP->release(singleFlightP->lockP);
+
+    if (isLast)
+        flightDestroy(flightP);
+}
+
+
+
+void
+xmlrpc_singleFlightJoin(xmlrpc_env *          const envP,
+                        xmlrpc_singleFlight * const singleFlightP,
+                        xmlrpc_value *        const paramArrayP,
+                        unsigned int          const paramHash,
+                        xmlrpc_dialect        const dialect,
+                        xmlrpc_flight **      const flightPP,
+                        bool *                const isLeaderP) {
+/*----------------------------------------------------------------------------
+   Join the flight for a call with parameters *paramArrayP (whose hash is
+   'paramHash') and response dialect 'dialect'.
+
+   If no such call is executing, start a flight and return *isLeaderP
+   true.  The caller must execute the call and then land the flight with
+   xmlrpc_singleFlightLand().
+
+   Otherwise, return *isLeaderP false.  The caller must get the leader's
+   result with xmlrpc_singleFlightAwait().
+-----------------------------------------------------------------------------*/
+    xmlrpc_flight ** const bucketP =
+        &singleFlightP->buckets[paramHash % BUCKET_CT];
+
+    xmlrpc_flight * flightP;
+
+    singleFlightP->lockP->acquire(singleFlightP->lockP);
+
+    for (flightP = *bucketP; flightP; flightP = flightP->nextInBucketP) {
+        if (flightP->paramHash == paramHash && flightP->dialect == dialect &&
+            xmlrpc_value_equal(flightP->paramArrayP, paramArrayP))
+            break;
+    }
+    if (flightP) {
+        ++flightP->refCt;
+        *isLeaderP = false;
+        *flightPP = flightP;
+    } else {
+        flightCreate(envP, paramArrayP, paramHash, dialect, &flightP);
+
+        if (!envP->fault_occurred) {
+            flightP->nextInBucketP = *bucketP;
+            *bucketP = flightP;
+            *isLeaderP = true;
+            *flightPP = flightP;
+        }
+    }
+    singleFlightP->lockP->release(singleFlightP->lockP);
+}
+
+
+
+void
+xmlrpc_singleFlightLand(xmlrpc_singleFlight * const singleFlightP,
+                        xmlrpc_flight *       const flightP,
+                        const xmlrpc_env *    const faultP,
+                        const char *          const responseXml,
+                        size_t                const responseXmlLen) {
+/*----------------------------------------------------------------------------
+   The leader of flight *flightP is done.  Give its result to the waiters.
+
+   If *faultP is a fault, that is the result.  Otherwise, if 'responseXml'
+   is non-null, the response XML is the result.  Otherwise, the leader has
+   no result and the waiters have to get their own.
+-----------------------------------------------------------------------------*/
+    xmlrpc_flight ** pP;
+
+    singleFlightP->lockP->acquire(singleFlightP->lockP);
+
+    /* Calls arriving from now on start a new flight */
+    for (pP = &singleFlightP->buckets[flightP->paramHash % BUCKET_CT];
+         *pP != flightP;
+         pP = &(*pP)->nextInBucketP);
+
+    *pP = flightP->nextInBucketP;
+
+    singleFlightP->lockP->release(singleFlightP->lockP);
+
+    if (faultP->fault_occurred) {
+        xmlrpc_env_set_fault(&flightP->fault, faultP->fault_code,
+                             faultP->fault_string);
+        flightP->resultType = RESULT_FAULT;
+    } else if (responseXml) {
+        flightP->responseXml = malloc(responseXmlLen);
+        if (flightP->responseXml) {
+            memcpy(flightP->responseXml, responseXml, responseXmlLen);
+            flightP->responseXmlLen = responseXmlLen;
+            flightP->resultType = RESULT_RESPONSE;
+        }
+    }
+    xmlrpc_event_set(flightP->landedP);
+
+    releaseFlight(singleFlightP, flightP);
+}
+
+
+
+void
+xmlrpc_singleFlightAwait(xmlrpc_env *          const envP,
+                         xmlrpc_singleFlight * const singleFlightP,
+                         xmlrpc_flight *       const flightP,
+                         xmlrpc_env *          const faultP,
+                         xmlrpc_mem_block *    const responseXmlP,
+                         bool *                const gotResultP) {
+/*----------------------------------------------------------------------------
+   Wait for the leader of flight *flightP to land and take its result:
+   either return its fault as *faultP or append its response to
+   *responseXmlP.  Return *gotResultP false if the leader had no result.
+-----------------------------------------------------------------------------*/
+    xmlrpc_event_wait(flightP->landedP);
+
+    switch (flightP->resultType) {
+    case RESULT_NONE:
+        *gotResultP = false;
+        break;
+    case RESULT_FAULT:
+        xmlrpc_env_set_fault(faultP, flightP->fault.fault_code,
+                             flightP->fault.fault_string);
+        *gotResultP = true;
+        break;
+    case RESULT_RESPONSE:
+        XMLRPC_MEMBLOCK_APPEND(char, envP, responseXmlP,
+                               flightP->responseXml, flightP->responseXmlLen);
+        *gotResultP = true;
+        break;
+    }
+    releaseFlight(singleFlightP, flightP);
+}
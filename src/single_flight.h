@@ -0,0 +1,42 @@
+#ifndef SINGLE_FLIGHT_H_INCLUDED
+#define SINGLE_FLIGHT_H_INCLUDED
+
+#include "bool.h"
+#include "xmlrpc-c/base.h"
+
+typedef struct xmlrpc_singleFlight xmlrpc_singleFlight;
+
+typedef struct xmlrpc_flight xmlrpc_flight;
+
+void
+xmlrpc_singleFlightCreate(xmlrpc_env *           const envP,
+                          xmlrpc_singleFlight ** const singleFlightPP);
+
+void
+xmlrpc_singleFlightDestroy(xmlrpc_singleFlight * const singleFlightP);
+
+void
+xmlrpc_singleFlightJoin(xmlrpc_env *          const envP,
+                        xmlrpc_singleFlight * const singleFlightP,
+                        xmlrpc_value *        const paramArrayP,
+                        unsigned int          const paramHash,
+                        xmlrpc_dialect        const dialect,
+                        xmlrpc_flight **      const flightPP,
+                        bool *                const isLeaderP);
+
+void
+xmlrpc_singleFlightLand(xmlrpc_singleFlight * const singleFlightP,
+                        xmlrpc_flight *       const flightP,
+                        const xmlrpc_env *    const faultP,
+                        const char *          const responseXml,
+                        size_t                const responseXmlLen);
+
+void
+xmlrpc_singleFlightAwait(xmlrpc_env *          const envP,
+                         xmlrpc_singleFlight * const singleFlightP,
+                         xmlrpc_flight *       const flightP,
+                         xmlrpc_env *          const faultP,
+                         xmlrpc_mem_block *    const responseXmlP,
+                         bool *                const gotResultP);
+
+#endif
@@ -6,13 +6,16 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "mallocvar.h"
 #include "xmlrpc-c/base_int.h"
 #include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/thread_int.h"
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
 #include "version.h"
 #include "registry.h"
 #include "method.h"
+#include "call_pool.h"
 
 #include "system_method.h"
 
@@ -137,6 +140,263 @@ getMethListFromMulticallPlist(xmlrpc_env *    const envP,
 
 
 
+typedef struct {
+/*----------------------------------------------------------------------------
+   One call of a system.multicall that executes in parallel with others.
+-----------------------------------------------------------------------------*/
+    xmlrpc_registry *     registryP;
+    xmlrpc_value *        rpcDescP;
+        /* The element of the multicall array that describes the call */
+    void *                callInfo;
+    xmlrpc_env            env;
+        /* Failure to produce a result (as opposed to the method failing,
+           which is a result)
+        */
+    xmlrpc_value *        resultP;
+        /* The result.  Meaningful only if 'env' shows no failure. */
+    struct xmlrpc_event * doneP;
+        /* Set when a pool worker has executed the call.  NULL if the
+           multicall's own thread executed it.
+        */
+} subCall;
+
+
+
+static xmlrpc_callPoolJob executeSubCall;
+
+static void
+executeSubCall(void * const arg) {
+
+    subCall * const subCallP = arg;
+
+    callOneMethod(&subCallP->env, subCallP->registryP, subCallP->rpcDescP,
+                  subCallP->callInfo, &subCallP->resultP);
+
+    if (subCallP->doneP)
+        xmlrpc_event_set(subCallP->doneP);
+}
+
+
+
+static bool
+isParallelSafe(xmlrpc_registry * const registryP,
+               xmlrpc_value *    const rpcDescP) {
+/*----------------------------------------------------------------------------
+   The call described by multicall element *rpcDescP may execute in
+   parallel with other calls.
+
+   If *rpcDescP isn't valid, we say no, and let the multicall's thread
+   discover that.
+-----------------------------------------------------------------------------*/
+    bool retval;
+
+    if (xmlrpc_value_type(rpcDescP) != XMLRPC_TYPE_STRUCT)
+        retval = false;
+    else if (registryP->multicallAllParallel)
+        retval = true;
+    else {
+        xmlrpc_env env;
+        xmlrpc_value * methodNameP;
+
+        xmlrpc_env_init(&env);
+
+        xmlrpc_struct_find_value(&env, rpcDescP, "methodName", &methodNameP);
+
+        if (env.fault_occurred || !methodNameP)
+            retval = false;
+        else {
+            const char * methodName;
+
+            xmlrpc_read_string(&env, methodNameP, &methodName);
+
+            if (env.fault_occurred)
+                retval = false;
+            else {
+                xmlrpc_methodList * methodListP;
+                xmlrpc_methodInfo * methodP;
+                unsigned int readerSlot;
+
+                xmlrpc_registryReadBegin(registryP, &methodListP,
+                                         &readerSlot);
+
+                xmlrpc_methodListLookupByName(methodListP, methodName,
+                                              &methodP);
+
+                retval = methodP && methodP->parallelSafe;
+
+                xmlrpc_registryReadEnd(registryP, readerSlot);
+
+                xmlrpc_strfree(methodName);
+            }
+            xmlrpc_DECREF(methodNameP);
+        }
+        xmlrpc_env_clean(&env);
+    }
+    return retval;
+}
+
+
+
+static void
+startSubCall(xmlrpc_registry * const registryP,
+             subCall *         const subCallP) {
+/*----------------------------------------------------------------------------
+   Have a worker of the registry's multicall pool execute *subCallP.
+
+   If we can't, execute it ourselves.
+-----------------------------------------------------------------------------*/
+    const char * error;
+
+    xmlrpc_event_create(&subCallP->doneP, &error);
+
+    if (error) {
+        xmlrpc_strfree(error);
+        subCallP->doneP = NULL;
+    } else {
+        xmlrpc_env env;
+
+        xmlrpc_env_init(&env);
+
+        xmlrpc_callPoolSubmit(&env, registryP->multicallPoolP,
+                              &executeSubCall, subCallP);
+
+        if (env.fault_occurred) {
+            xmlrpc_event_destroy(subCallP->doneP);
+            subCallP->doneP = NULL;
+        }
+        xmlrpc_env_clean(&env);
+    }
+    if (!subCallP->doneP)
+        executeSubCall(subCallP);
+}
+
+
+
+static void
+finishSubCall(xmlrpc_env *   const envP,
+              subCall *      const subCallP,
+              xmlrpc_value * const resultsP) {
+/*----------------------------------------------------------------------------
+   Wait for *subCallP to finish executing, then append its result to
+   *resultsP, unless we failed already.
+-----------------------------------------------------------------------------*/
+    if (subCallP->doneP) {
+        xmlrpc_event_wait(subCallP->doneP);
+        xmlrpc_event_destroy(subCallP->doneP);
+    }
+    if (subCallP->env.fault_occurred) {
+        if (!envP->fault_occurred)
+            xmlrpc_env_set_fault(envP, subCallP->env.fault_code,
+                                 subCallP->env.fault_string);
+    } else {
+        if (!envP->fault_occurred)
+            xmlrpc_array_append_item(envP, resultsP, subCallP->resultP);
+
+        xmlrpc_DECREF(subCallP->resultP);
+    }
+    xmlrpc_env_clean(&subCallP->env);
+}
+
+
+
+static void
+executeCallsParallel(xmlrpc_env *      const envP,
+                     xmlrpc_registry * const registryP,
+                     xmlrpc_value *    const methlistP,
+                     unsigned int      const methodCount,
+                     void *            const callInfo,
+                     xmlrpc_value *    const resultsP) {
+/*----------------------------------------------------------------------------
+   Execute the calls in multicall array *methlistP and append their results
+   to *resultsP, in order.
+
+   Calls of parallel-safe methods execute in the registry's multicall pool,
+   at most registryP->multicallMaxFanout at a time.  We execute any other
+   call ourselves, when all the calls before it have finished.
+-----------------------------------------------------------------------------*/
+    unsigned int const maxFanout = registryP->multicallMaxFanout;
+
+    subCall * subCalls;
+
+    MALLOCARRAY(subCalls, methodCount);
+
+    if (subCalls == NULL)
+        xmlrpc_faultf(envP, "Couldn't allocate memory for %u calls",
+                      methodCount);
+    else {
+        unsigned int startedCt;
+        unsigned int finishedCt;
+
+        for (startedCt = 0, finishedCt = 0;
+             startedCt < methodCount && !envP->fault_occurred;
+             ++startedCt) {
+
+            subCall * const subCallP = &subCalls[startedCt];
+
+            subCallP->registryP = registryP;
+            subCallP->rpcDescP  =
+                xmlrpc_array_get_item(envP, methlistP, startedCt);
+            subCallP->callInfo  = callInfo;
+            subCallP->doneP     = NULL;
+            xmlrpc_env_init(&subCallP->env);
+
+            XMLRPC_ASSERT_ENV_OK(envP);
+
+            if (isParallelSafe(registryP, subCallP->rpcDescP)) {
+                while (startedCt - finishedCt >= maxFanout)
+                    finishSubCall(envP, &subCalls[finishedCt++], resultsP);
+
+                startSubCall(registryP, subCallP);
+            } else {
+                while (finishedCt < startedCt)
+                    finishSubCall(envP, &subCalls[finishedCt++], resultsP);
+
+                executeSubCall(subCallP);
+            }
+        }
+        /* Even if we failed, we must wait for the calls in the pool */
+        while (finishedCt < startedCt)
+            finishSubCall(envP, &subCalls[finishedCt++], resultsP);
+
+        free(subCalls);
+    }
+}
+
+
+
+static void
+executeCallsSerial(xmlrpc_env *      const envP,
+                   xmlrpc_registry * const registryP,
+                   xmlrpc_value *    const methlistP,
+                   unsigned int      const methodCount,
+                   void *            const callInfo,
+                   xmlrpc_value *    const resultsP) {
+/*----------------------------------------------------------------------------
+   Execute the calls in multicall array *methlistP, one at a time, and
+   append their results to *resultsP.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    for (i = 0; i < methodCount && !envP->fault_occurred; ++i) {
+        xmlrpc_value * const methinfoP = 
+            xmlrpc_array_get_item(envP, methlistP, i);
+            
+        xmlrpc_value * resultP;
+            
+        XMLRPC_ASSERT_ENV_OK(envP);
+            
+        callOneMethod(envP, registryP, methinfoP, callInfo, &resultP);
+            
+        if (!envP->fault_occurred) {
+            /* Append this method result to our master array. */
+            xmlrpc_array_append_item(envP, resultsP, resultP);
+            xmlrpc_DECREF(resultP);
+        }
+    }
+}
+
+
+
 static xmlrpc_value *
 system_multicall(xmlrpc_env *   const envP,
                  xmlrpc_value * const paramArrayP,
@@ -161,26 +421,16 @@ system_multicall(xmlrpc_env *   const envP,
         /* Create an initially empty result list. */
         resultsP = xmlrpc_array_new(envP);
         if (!envP->fault_occurred) {
-            /* Loop over our input list, calling each method in turn. */
             unsigned int const methodCount =
                 xmlrpc_array_size(envP, methlistP);
-            unsigned int i;
-            for (i = 0; i < methodCount && !envP->fault_occurred; ++i) {
-                xmlrpc_value * const methinfoP = 
-                    xmlrpc_array_get_item(envP, methlistP, i);
-            
-                xmlrpc_value * resultP;
-            
-                XMLRPC_ASSERT_ENV_OK(envP);
-            
-                callOneMethod(envP, registryP, methinfoP, callInfo, &resultP);
-            
-                if (!envP->fault_occurred) {
-                    /* Append this method result to our master array. */
-                    xmlrpc_array_append_item(envP, resultsP, resultP);
-                    xmlrpc_DECREF(resultP);
-                }
-            }
+
+            if (registryP->multicallPoolP && methodCount > 1)
+                executeCallsParallel(envP, registryP, methlistP,
+                                     methodCount, callInfo, resultsP);
+            else
+                executeCallsSerial(envP, registryP, methlistP,
+                                   methodCount, callInfo, resultsP);
+
             if (envP->fault_occurred)
                 xmlrpc_DECREF(resultsP);
             xmlrpc_DECREF(methlistP);
@@ -225,14 +475,21 @@ createMethodListArray(xmlrpc_env *      const envP,
     methodListP = xmlrpc_array_new(envP);
 
     if (!envP->fault_occurred) {
-        xmlrpc_methodNode * methodNodeP;
-        for (methodNodeP = registryP->methodListP->firstMethodP;
-             methodNodeP && !envP->fault_occurred;
-             methodNodeP = methodNodeP->nextP) {
+        xmlrpc_methodList * registryMethodListP;
+        unsigned int readerSlot;
+        unsigned int i;
+
+        xmlrpc_registryReadBegin(registryP, &registryMethodListP,
+                                 &readerSlot);
+
+        for (i = 0;
+             i < registryMethodListP->methodCt && !envP->fault_occurred;
+             ++i) {
             
             xmlrpc_value * methodNameVP;
             
-            methodNameVP = xmlrpc_string_new(envP, methodNodeP->methodName);
+            methodNameVP = xmlrpc_string_new(
+                envP, registryMethodListP->methods[i]->methodName);
             
             if (!envP->fault_occurred) {
                 xmlrpc_array_append_item(envP, methodListP, methodNameVP);
@@ -240,6 +497,8 @@ createMethodListArray(xmlrpc_env *      const envP,
                 xmlrpc_DECREF(methodNameVP);
             }
         }
+        xmlrpc_registryReadEnd(registryP, readerSlot);
+
         if (envP->fault_occurred)
             xmlrpc_DECREF(methodListP);
     }
@@ -296,10 +555,15 @@ determineMethodExistence(xmlrpc_env *      const envP,
                          xmlrpc_registry * const registryP,
                          xmlrpc_value **   const existsPP) {
 
+    xmlrpc_methodList * methodListP;
     xmlrpc_methodInfo * methodP;
+    unsigned int readerSlot;
+
+    xmlrpc_registryReadBegin(registryP, &methodListP, &readerSlot);
+
+    xmlrpc_methodListLookupByName(methodListP, methodName, &methodP);
 
-    xmlrpc_methodListLookupByName(registryP->methodListP, methodName,
-                                  &methodP);
+    xmlrpc_registryReadEnd(registryP, readerSlot);
 
     *existsPP = xmlrpc_bool_new(envP, !!methodP);
 }
@@ -355,10 +619,13 @@ getHelpString(xmlrpc_env *      const envP,
               xmlrpc_registry * const registryP,
               xmlrpc_value **   const helpStringPP) {
 
+    xmlrpc_methodList * methodListP;
     xmlrpc_methodInfo * methodP;
+    unsigned int readerSlot;
 
-    xmlrpc_methodListLookupByName(registryP->methodListP, methodName,
-                                  &methodP);
+    xmlrpc_registryReadBegin(registryP, &methodListP, &readerSlot);
+
+    xmlrpc_methodListLookupByName(methodListP, methodName, &methodP);
 
     if (!methodP)
         xmlrpc_env_set_fault_formatted(
@@ -366,6 +633,8 @@ getHelpString(xmlrpc_env *      const envP,
             "Method '%s' does not exist", methodName);
     else
         *helpStringPP = xmlrpc_string_new(envP, methodP->helpText);
+
+    xmlrpc_registryReadEnd(registryP, readerSlot);
 }
     
 
@@ -487,10 +756,13 @@ getSignatureList(xmlrpc_env *      const envP,
 
   Nonexistent method is considered a failure.
 -----------------------------------------------------------------------------*/
+    xmlrpc_methodList * methodListP;
     xmlrpc_methodInfo * methodP;
+    unsigned int readerSlot;
+
+    xmlrpc_registryReadBegin(registryP, &methodListP, &readerSlot);
 
-    xmlrpc_methodListLookupByName(registryP->methodListP, methodName,
-                                  &methodP);
+    xmlrpc_methodListLookupByName(methodListP, methodName, &methodP);
 
     if (!methodP)
         xmlrpc_env_set_fault_formatted(
@@ -525,6 +797,7 @@ getSignatureList(xmlrpc_env *      const envP,
             *signatureListPP = signatureListP;
         }
     }
+    xmlrpc_registryReadEnd(registryP, readerSlot);
 }
 
 
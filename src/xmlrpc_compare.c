@@ -0,0 +1,437 @@
+/*=============================================================================
+                              xmlrpc_compare
+===============================================================================
+
+  Hashing and equality of xmlrpc_values.
+
+  Two values are equal if they are of the same type and represent the same
+  XML-RPC value.  In particular, the members of a struct are unordered, so
+  two structs with the same members in a different order are equal, and
+  have the same hash.  An int and an i8 are never equal, even if they have
+  the same numerical value, because they would go over the wire as
+  different XML-RPC values.
+
+  These are for things like caches that must recognize that one call's
+  parameters are the same as another's.
+
+============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <string.h>
+
+#include "bool.h"
+#include "int.h"
+#include "girmath.h"
+
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/base_int.h"
+
+
+
+/* We use the 32 bit FNV-1a hash for byte strings */
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME        16777619u
+
+static uint32_t
+hashBytes(uint32_t     const startHash,
+          const void * const bytes,
+          size_t       const len) {
+
+    const unsigned char * const p = bytes;
+
+    uint32_t hash;
+    size_t i;
+
+    for (i = 0, hash = startHash; i < len; ++i) {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+
+
+static uint32_t
+hashBlock(uint32_t           const startHash,
+          xmlrpc_mem_block * const blockP) {
+
+    return hashBytes(startHash,
+                     XMLRPC_MEMBLOCK_CONTENTS(char, blockP),
+                     XMLRPC_MEMBLOCK_SIZE(char, blockP));
+}
+
+
+
+/* How much of a file-backed base64 value we read at a time */
+#define BASE64_READ_SIZE 4096
+
+static const unsigned char *
+base64Contents(xmlrpc_value * const valueP) {
+/*----------------------------------------------------------------------------
+   The bytes of base64 value *valueP, if they are in memory; NULL if they
+   are in a file.
+-----------------------------------------------------------------------------*/
+    return valueP->blockP ?
+        XMLRPC_MEMBLOCK_CONTENTS(unsigned char, valueP->blockP) :
+        valueP->_value.extBytes.bytes;
+}
+
+
+
+static uint32_t
+hashBase64(uint32_t       const startHash,
+           xmlrpc_value * const valueP) {
+
+    size_t const size = xmlrpc_base64Size(valueP);
+    const unsigned char * const contents = base64Contents(valueP);
+
+    uint32_t hash;
+
+    if (contents)
+        hash = hashBytes(startHash, contents, size);
+    else {
+        /* If we can't read the file, we hash what we could read; the
+           value won't be equal to anything anyway.
+        */
+        xmlrpc_env env;
+        unsigned char buffer[BASE64_READ_SIZE];
+        size_t done;
+
+        xmlrpc_env_init(&env);
+
+        for (done = 0, hash = startHash;
+             done < size && !env.fault_occurred;
+             done += BASE64_READ_SIZE) {
+            size_t const chunkSize = MIN(size - done, BASE64_READ_SIZE);
+
+            xmlrpc_base64Read(&env, valueP, done, chunkSize, buffer);
+
+            if (!env.fault_occurred)
+                hash = hashBytes(hash, buffer, chunkSize);
+        }
+        xmlrpc_env_clean(&env);
+    }
+    return hash;
+}
+
+
+
+static uint32_t
+hashValue(uint32_t       const startHash,
+          xmlrpc_value * const valueP);
+
+
+
+static uint32_t
+hashArray(uint32_t       const startHash,
+          xmlrpc_value * const arrayP) {
+
+    size_t const size =
+        XMLRPC_MEMBLOCK_SIZE(xmlrpc_value *, arrayP->blockP);
+    xmlrpc_value ** const items =
+        XMLRPC_MEMBLOCK_CONTENTS(xmlrpc_value *, arrayP->blockP);
+
+    uint32_t hash;
+    size_t i;
+
+    for (i = 0, hash = startHash; i < size; ++i)
+        hash = hashValue(hash, items[i]);
+
+    return hash;
+}
+
+
+
+static uint32_t
+hashStruct(uint32_t       const startHash,
+           xmlrpc_value * const structP) {
+/*----------------------------------------------------------------------------
+   The members of a struct are unordered, so we hash each member separately
+   and combine them with an operation that doesn't care about order.
+-----------------------------------------------------------------------------*/
+    size_t const size =
+        XMLRPC_MEMBLOCK_SIZE(_struct_member, structP->blockP);
+    _struct_member * const members =
+        XMLRPC_MEMBLOCK_CONTENTS(_struct_member, structP->blockP);
+
+    uint32_t membersHash;
+    size_t i;
+
+    for (i = 0, membersHash = 0; i < size; ++i) {
+        uint32_t const keyHash =
+            hashBlock(FNV_OFFSET_BASIS, members[i].key->blockP);
+
+        membersHash += hashValue(keyHash, members[i].value);
+    }
+    return hashBytes(startHash, &membersHash, sizeof(membersHash));
+}
+
+
+
+static uint32_t
+hashValue(uint32_t       const startHash,
+          xmlrpc_value * const valueP) {
+
+    xmlrpc_type const type = valueP->_type;
+
+    uint32_t const typeHash = hashBytes(startHash, &type, sizeof(type));
+
+    switch (type) {
+    case XMLRPC_TYPE_INT:
+        return hashBytes(typeHash, &valueP->_value.i,
+                         sizeof(valueP->_value.i));
+    case XMLRPC_TYPE_I8:
+        return hashBytes(typeHash, &valueP->_value.i8,
+                         sizeof(valueP->_value.i8));
+    case XMLRPC_TYPE_BOOL: {
+        unsigned char const b = valueP->_value.b ? 1 : 0;
+        return hashBytes(typeHash, &b, sizeof(b));
+    }
+    case XMLRPC_TYPE_DOUBLE: {
+        /* 0.0 and -0.0 are equal, so must hash the same */
+        double const d = valueP->_value.d == 0.0 ? 0.0 : valueP->_value.d;
+        return hashBytes(typeHash, &d, sizeof(d));
+    }
+    case XMLRPC_TYPE_DATETIME: {
+        const xmlrpc_datetime * const dtP = &valueP->_value.dt;
+        unsigned int const parts[] = {
+            dtP->Y, dtP->M, dtP->D, dtP->h, dtP->m, dtP->s, dtP->u
+        };
+        return hashBytes(typeHash, parts, sizeof(parts));
+    }
+    case XMLRPC_TYPE_STRING:
+        return hashBlock(typeHash, valueP->blockP);
+    case XMLRPC_TYPE_BASE64:
+        return hashBase64(typeHash, valueP);
+    case XMLRPC_TYPE_PRESERIALIZED:
+        return hashBlock(hashBytes(typeHash, &valueP->_value.dialect,
+                                   sizeof(valueP->_value.dialect)),
+                         valueP->blockP);
+    case XMLRPC_TYPE_ARRAY:
+        return hashArray(typeHash, valueP);
+    case XMLRPC_TYPE_STRUCT:
+        return hashStruct(typeHash, valueP);
+    case XMLRPC_TYPE_C_PTR:
+        return hashBytes(typeHash, &valueP->_value.cptr.objectP,
+                         sizeof(valueP->_value.cptr.objectP));
+    case XMLRPC_TYPE_NIL:
+    case XMLRPC_TYPE_DEAD:
+        return typeHash;
+    }
+    return typeHash;
+}
+
+
+
+unsigned int
+xmlrpc_value_hash(xmlrpc_value * const valueP) {
+/*----------------------------------------------------------------------------
+   A hash of value *valueP.  Equal values (per xmlrpc_value_equal()) have
+   equal hashes.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_VALUE_OK(valueP);
+
+    return hashValue(FNV_OFFSET_BASIS, valueP);
+}
+
+
+
+static bool
+blocksEqual(xmlrpc_mem_block * const aP,
+            xmlrpc_mem_block * const bP) {
+
+    size_t const size = XMLRPC_MEMBLOCK_SIZE(char, aP);
+
+    return
+        size == XMLRPC_MEMBLOCK_SIZE(char, bP) &&
+        memcmp(XMLRPC_MEMBLOCK_CONTENTS(char, aP),
+               XMLRPC_MEMBLOCK_CONTENTS(char, bP), size) == 0;
+}
+
+
+
+static bool
+base64sEqual(xmlrpc_value * const aP,
+             xmlrpc_value * const bP) {
+
+    size_t const size = xmlrpc_base64Size(aP);
+    const unsigned char * const aContents = base64Contents(aP);
+    const unsigned char * const bContents = base64Contents(bP);
+
+    bool equal;
+
+    if (size != xmlrpc_base64Size(bP))
+        equal = false;
+    else if (aContents && bContents)
+        equal = memcmp(aContents, bContents, size) == 0;
+    else {
+        /* At least one is in a file; compare a piece at a time */
+        xmlrpc_env env;
+        unsigned char aBuffer[BASE64_READ_SIZE];
+        unsigned char bBuffer[BASE64_READ_SIZE];
+        size_t done;
+
+        xmlrpc_env_init(&env);
+
+        for (done = 0, equal = true;
+             done < size && equal;
+             done += BASE64_READ_SIZE) {
+            size_t const chunkSize = MIN(size - done, BASE64_READ_SIZE);
+
+            xmlrpc_base64Read(&env, aP, done, chunkSize, aBuffer);
+            if (!env.fault_occurred)
+                xmlrpc_base64Read(&env, bP, done, chunkSize, bBuffer);
+
+            equal = !env.fault_occurred &&
+                memcmp(aBuffer, bBuffer, chunkSize) == 0;
+        }
+        xmlrpc_env_clean(&env);
+    }
+    return equal;
+}
+
+
+
+static bool
+arraysEqual(xmlrpc_value * const aP,
+            xmlrpc_value * const bP) {
+
+    size_t const size = XMLRPC_MEMBLOCK_SIZE(xmlrpc_value *, aP->blockP);
+
+    bool equal;
+
+    if (size != XMLRPC_MEMBLOCK_SIZE(xmlrpc_value *, bP->blockP))
+        equal = false;
+    else {
+        xmlrpc_value ** const aItems =
+            XMLRPC_MEMBLOCK_CONTENTS(xmlrpc_value *, aP->blockP);
+        xmlrpc_value ** const bItems =
+            XMLRPC_MEMBLOCK_CONTENTS(xmlrpc_value *, bP->blockP);
+
+        size_t i;
+
+        for (i = 0, equal = true; i < size && equal; ++i)
+            equal = xmlrpc_value_equal(aItems[i], bItems[i]);
+    }
+    return equal;
+}
+
+
+
+static xmlrpc_value *
+structMemberValue(xmlrpc_value *         const structP,
+                  const _struct_member * const memberP) {
+/*----------------------------------------------------------------------------
+   The value of the member of *structP that has the same key as *memberP
+   (a member of some other struct).  NULL if none.
+-----------------------------------------------------------------------------*/
+    size_t const size =
+        XMLRPC_MEMBLOCK_SIZE(_struct_member, structP->blockP);
+    _struct_member * const members =
+        XMLRPC_MEMBLOCK_CONTENTS(_struct_member, structP->blockP);
+
+    size_t i;
+
+    for (i = 0; i < size; ++i) {
+        if (members[i].keyHash == memberP->keyHash &&
+            blocksEqual(members[i].key->blockP, memberP->key->blockP))
+            return members[i].value;
+    }
+    return NULL;
+}
+
+
+
+static bool
+structsEqual(xmlrpc_value * const aP,
+             xmlrpc_value * const bP) {
+/*----------------------------------------------------------------------------
+   A struct can't have two members with the same key, so if the two structs
+   have the same number of members and every member of *aP is in *bP with
+   an equal value, they are equal.
+-----------------------------------------------------------------------------*/
+    size_t const size = XMLRPC_MEMBLOCK_SIZE(_struct_member, aP->blockP);
+
+    bool equal;
+
+    if (size != XMLRPC_MEMBLOCK_SIZE(_struct_member, bP->blockP))
+        equal = false;
+    else {
+        _struct_member * const aMembers =
+            XMLRPC_MEMBLOCK_CONTENTS(_struct_member, aP->blockP);
+
+        size_t i;
+
+        for (i = 0, equal = true; i < size && equal; ++i) {
+            xmlrpc_value * const bValueP =
+                structMemberValue(bP, &aMembers[i]);
+
+            equal = bValueP && xmlrpc_value_equal(aMembers[i].value, bValueP);
+        }
+    }
+    return equal;
+}
+
+
+
+static bool
+datetimesEqual(const xmlrpc_datetime * const aP,
+               const xmlrpc_datetime * const bP) {
+
+    return
+        aP->Y == bP->Y && aP->M == bP->M && aP->D == bP->D &&
+        aP->h == bP->h && aP->m == bP->m && aP->s == bP->s &&
+        aP->u == bP->u;
+}
+
+
+
+xmlrpc_bool
+xmlrpc_value_equal(xmlrpc_value * const aP,
+                   xmlrpc_value * const bP) {
+/*----------------------------------------------------------------------------
+   Whether *aP and *bP represent the same XML-RPC value.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_VALUE_OK(aP);
+    XMLRPC_ASSERT_VALUE_OK(bP);
+
+    if (aP == bP)
+        return true;
+
+    if (aP->_type != bP->_type)
+        return false;
+
+    switch (aP->_type) {
+    case XMLRPC_TYPE_INT:
+        return aP->_value.i == bP->_value.i;
+    case XMLRPC_TYPE_I8:
+        return aP->_value.i8 == bP->_value.i8;
+    case XMLRPC_TYPE_BOOL:
+        return !aP->_value.b == !bP->_value.b;
+    case XMLRPC_TYPE_DOUBLE:
+        return aP->_value.d == bP->_value.d;
+    case XMLRPC_TYPE_DATETIME:
+        return datetimesEqual(&aP->_value.dt, &bP->_value.dt);
+    case XMLRPC_TYPE_STRING:
+        return blocksEqual(aP->blockP, bP->blockP);
+    case XMLRPC_TYPE_BASE64:
+        return base64sEqual(aP, bP);
+    case XMLRPC_TYPE_PRESERIALIZED:
+        return
+            aP->_value.dialect == bP->_value.dialect &&
+            blocksEqual(aP->blockP, bP->blockP);
+    case XMLRPC_TYPE_ARRAY:
+        return arraysEqual(aP, bP);
+    case XMLRPC_TYPE_STRUCT:
+        return structsEqual(aP, bP);
+    case XMLRPC_TYPE_C_PTR:
+        return aP->_value.cptr.objectP == bP->_value.cptr.objectP;
+    case XMLRPC_TYPE_NIL:
+        return true;
+    case XMLRPC_TYPE_DEAD:
+        return false;
+    }
+    return false;
+}
@@ -8,8 +8,16 @@
 #include <stdarg.h>
 #include <string.h>
 #include <math.h>
+#include <errno.h>
+#if MSVCRT
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 #include "bool.h"
+#include "c_util.h"
+#include "girmath.h"
 #include "mallocvar.h"
 
 #include "xmlrpc-c/lock.h"
@@ -49,6 +57,41 @@ destroyCptr(xmlrpc_value * const valueP) {
 
 
 
+static void
+destroyBase64(xmlrpc_value * const valueP) {
+
+    if (valueP->blockP)
+        xmlrpc_mem_block_free(valueP->blockP);
+    else {
+        if (valueP->_value.extBytes.fd >= 0) {
+            close(valueP->_value.extBytes.fd);
+            if (valueP->_cache)
+                free(valueP->_cache);
+        }
+        if (valueP->_value.extBytes.dtor)
+            valueP->_value.extBytes.dtor(
+                valueP->_value.extBytes.dtorContext,
+                (void *)valueP->_value.extBytes.bytes);
+    }
+}
+
+
+
+static void
+destroyMemo(xmlrpc_value * const valueP) {
+
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(valueP->_memo); ++i) {
+        if (valueP->_memo[i]) {
+            xmlrpc_mem_block_free(valueP->_memo[i]);
+            valueP->_memo[i] = NULL;
+        }
+    }
+}
+
+
+
 static void
 destroyValue(xmlrpc_value * const valueP) {
 
@@ -72,7 +115,7 @@ destroyValue(xmlrpc_value * const valueP) {
         break;
 
     case XMLRPC_TYPE_BASE64:
-        xmlrpc_mem_block_free(valueP->blockP);
+        destroyBase64(valueP);
         break;
 
     case XMLRPC_TYPE_ARRAY:
@@ -93,6 +136,10 @@ destroyValue(xmlrpc_value * const valueP) {
     case XMLRPC_TYPE_I8:
         break;
 
+    case XMLRPC_TYPE_PRESERIALIZED:
+        xmlrpc_mem_block_free(valueP->blockP);
+        break;
+
     case XMLRPC_TYPE_DEAD:
         XMLRPC_ASSERT(false); /* Can't happen, per entry conditions */
         break;
@@ -101,6 +148,8 @@ destroyValue(xmlrpc_value * const valueP) {
         XMLRPC_ASSERT(false); /* There are no other possible values */
     }
 
+    destroyMemo(valueP);
+
     valueP->lockP->destroy(valueP->lockP);
 
     /* Next, we mark this value as invalid, to help catch refcount errors.
@@ -180,6 +229,7 @@ xmlrpc_type_name(xmlrpc_type const type) {
     case XMLRPC_TYPE_C_PTR:    return "C_PTR";
     case XMLRPC_TYPE_NIL:      return "NIL";
     case XMLRPC_TYPE_I8:       return "I8";
+    case XMLRPC_TYPE_PRESERIALIZED: return "PRESERIALIZED";
     case XMLRPC_TYPE_DEAD:     return "DEAD";
     default:                   return "???";
 
@@ -255,6 +305,92 @@ xmlrpc_read_double(xmlrpc_env *         const envP,
 
 
 
+size_t
+xmlrpc_base64Size(const xmlrpc_value * const valueP) {
+
+    return valueP->blockP ?
+        XMLRPC_MEMBLOCK_SIZE(char, valueP->blockP) :
+        valueP->_value.extBytes.size;
+}
+
+
+
+static void
+readFile(xmlrpc_env *         const envP,
+         const xmlrpc_value * const valueP,
+         xmlrpc_int64         const position,
+         size_t               const len,
+         unsigned char *      const buffer) {
+/*----------------------------------------------------------------------------
+   Read 'len' bytes at 'position' in the file of file-backed base64 value
+   *valueP into 'buffer'.
+-----------------------------------------------------------------------------*/
+    int const fd = valueP->_value.extBytes.fd;
+
+    size_t bytesRead;
+
+#if MSVCRT
+    /* There is no pread(); make the seek and read atomic */
+    valueP->lockP->acquire(valueP->lockP);
+
+    if (_lseeki64(fd, position, SEEK_SET) < 0)
+        xmlrpc_faultf(envP, "Unable to seek to position %lld of the file "
+                      "for a base64 value.  errno = %d (%s)",
+                      (long long)position, errno, strerror(errno));
+#endif
+    for (bytesRead = 0; bytesRead < len && !envP->fault_occurred; ) {
+#if MSVCRT
+        unsigned int const chunkSize =
+            (unsigned int)MIN(len - bytesRead, 1024*1024*1024);
+        int const rc = _read(fd, buffer + bytesRead, chunkSize);
+#else
+        ssize_t const rc = pread(fd, buffer + bytesRead, len - bytesRead,
+                                 (off_t)(position + bytesRead));
+#endif
+        if (rc < 0) {
+            if (errno != EINTR)
+                xmlrpc_faultf(envP, "Unable to read the file for a base64 "
+                              "value.  errno = %d (%s)",
+                              errno, strerror(errno));
+        } else if (rc == 0)
+            xmlrpc_faultf(envP, "The file for a base64 value ends before "
+                          "the %u bytes of the value",
+                          (unsigned)valueP->_value.extBytes.size);
+        else
+            bytesRead += rc;
+    }
+#if MSVCRT
+    valueP->lockP->release(valueP->lockP);
+#endif
+}
+
+
+
+void
+xmlrpc_base64Read(xmlrpc_env *         const envP,
+                  const xmlrpc_value * const valueP,
+                  size_t               const start,
+                  size_t               const len,
+                  unsigned char *      const buffer) {
+/*----------------------------------------------------------------------------
+   Copy bytes 'start' through 'start' + 'len' - 1 of base64 value *valueP
+   into 'buffer', from wherever they are.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT(start + len <= xmlrpc_base64Size(valueP));
+
+    if (valueP->blockP)
+        memcpy(buffer,
+               XMLRPC_MEMBLOCK_CONTENTS(unsigned char, valueP->blockP) + start,
+               len);
+    else if (valueP->_value.extBytes.fd < 0)
+        memcpy(buffer, valueP->_value.extBytes.bytes + start, len);
+    else
+        readFile(envP, valueP, valueP->_value.extBytes.offset + start,
+                 len, buffer);
+}
+
+
+
 void
 xmlrpc_read_base64(xmlrpc_env *           const envP,
                    const xmlrpc_value *   const valueP,
@@ -263,12 +399,9 @@ xmlrpc_read_base64(xmlrpc_env *           const envP,
 
     validateType(envP, valueP, XMLRPC_TYPE_BASE64);
     if (!envP->fault_occurred) {
-        size_t const size =
-            XMLRPC_MEMBLOCK_SIZE(char, valueP->blockP);
-        const char * const contents =
-            XMLRPC_MEMBLOCK_CONTENTS(char, valueP->blockP);
+        size_t const size = xmlrpc_base64Size(valueP);
 
-        char * byteStringValue;
+        unsigned char * byteStringValue;
 
         byteStringValue = malloc(size);
         if (byteStringValue == NULL)
@@ -276,9 +409,14 @@ xmlrpc_read_base64(xmlrpc_env *           const envP,
                           "Unable to allocate %u bytes for byte string.",
                           (unsigned)size);
         else {
-            memcpy(byteStringValue, contents, size);
-            *byteStringValueP = (const unsigned char *)byteStringValue;
-            *lengthP = size;
+            xmlrpc_base64Read(envP, valueP, 0, size, byteStringValue);
+
+            if (envP->fault_occurred)
+                free(byteStringValue);
+            else {
+                *byteStringValueP = byteStringValue;
+                *lengthP = size;
+            }
         }
     }
 }
@@ -293,10 +431,51 @@ xmlrpc_read_base64_old(xmlrpc_env *           const envP,
 
     validateType(envP, valueP, XMLRPC_TYPE_BASE64);
     if (!envP->fault_occurred) {
-        *lengthP =
-            XMLRPC_MEMBLOCK_SIZE(char, valueP->blockP);
-        *byteStringValueP = (const unsigned char *)
-            XMLRPC_MEMBLOCK_CONTENTS(char, valueP->blockP);
+        if (valueP->blockP) {
+            *lengthP =
+                XMLRPC_MEMBLOCK_SIZE(char, valueP->blockP);
+            *byteStringValueP = (const unsigned char *)
+                XMLRPC_MEMBLOCK_CONTENTS(char, valueP->blockP);
+        } else if (valueP->_value.extBytes.fd < 0) {
+            *lengthP = valueP->_value.extBytes.size;
+            *byteStringValueP = valueP->_value.extBytes.bytes;
+        } else {
+            /* The bytes are in a file, so we read them into memory that
+               belongs to the value (valueP->_cache), once.  Reading the
+               file may take the value's lock (see readFile()), so we read
+               without holding it and hold it only to install the copy.
+            */
+            const unsigned char * cache;
+
+            valueP->lockP->acquire(valueP->lockP);
+            cache = valueP->_cache;
+            valueP->lockP->release(valueP->lockP);
+
+            if (!cache) {
+                const unsigned char * bytes;
+                size_t size;
+
+                xmlrpc_read_base64(envP, valueP, &size, &bytes);
+
+                if (!envP->fault_occurred) {
+                    valueP->lockP->acquire(valueP->lockP);
+
+                    if (valueP->_cache)
+                        /* Another thread installed its copy meanwhile */
+                        free((void *)bytes);
+                    else
+                        ((xmlrpc_value *)valueP)->_cache = (void *)bytes;
+
+                    cache = valueP->_cache;
+
+                    valueP->lockP->release(valueP->lockP);
+                }
+            }
+            if (!envP->fault_occurred) {
+                *lengthP = valueP->_value.extBytes.size;
+                *byteStringValueP = cache;
+            }
+        }
     }
 }
 
@@ -309,7 +488,7 @@ xmlrpc_read_base64_size(xmlrpc_env *           const envP,
 
     validateType(envP, valueP, XMLRPC_TYPE_BASE64);
     if (!envP->fault_occurred)
-        *lengthP = XMLRPC_MEMBLOCK_SIZE(char, valueP->blockP);
+        *lengthP = xmlrpc_base64Size(valueP);
 }
 
 
@@ -378,8 +557,12 @@ xmlrpc_createXmlrpcValue(xmlrpc_env *    const envP,
         if (!valP->lockP)
             xmlrpc_faultf(envP, "Could not allocate memory for lock for "
                           "xmlrpc_value");
-        else
+        else {
             valP->refcount = 1;
+            valP->_memoize = false;
+            valP->_memo[xmlrpc_dialect_i8]     = NULL;
+            valP->_memo[xmlrpc_dialect_apache] = NULL;
+        }
 
         if (envP->fault_occurred) {
             free(valP);
@@ -418,6 +601,11 @@ xmlrpc_value_new(xmlrpc_env *   const envP,
         return xmlrpc_cptr_new_value(envP, sourceValP);
     case XMLRPC_TYPE_NIL:
         return xmlrpc_nil_new(envP);
+    case XMLRPC_TYPE_PRESERIALIZED:
+        return xmlrpc_preserialized_new(
+            envP, sourceValP->_value.dialect,
+            xmlrpc_mem_block_contents(sourceValP->blockP),
+            xmlrpc_mem_block_size(sourceValP->blockP));
     case XMLRPC_TYPE_DEAD:
         xmlrpc_faultf(envP, "Attempt to copy a dead xmlrpc_value");
         return NULL;
@@ -606,6 +794,83 @@ xmlrpc_base64_new(xmlrpc_env *          const envP,
 
 
 
+xmlrpc_value *
+xmlrpc_base64_new_fd(xmlrpc_env * const envP,
+                     int          const fd,
+                     size_t       const length) {
+
+    xmlrpc_value * valP;
+
+#if MSVCRT
+    xmlrpc_int64 const position = _lseeki64(fd, 0, SEEK_CUR);
+#else
+    xmlrpc_int64 const position = lseek(fd, 0, SEEK_CUR);
+#endif
+
+    if (position < 0) {
+        xmlrpc_faultf(envP, "Unable to determine the current position of "
+                      "file descriptor %d.  It must be a seekable file.  "
+                      "errno = %d (%s)", fd, errno, strerror(errno));
+        valP = NULL;
+    } else {
+        xmlrpc_createXmlrpcValue(envP, &valP);
+
+        if (!envP->fault_occurred) {
+            valP->_type = XMLRPC_TYPE_BASE64;
+            valP->blockP = NULL;
+            valP->_cache = NULL;
+            valP->_value.extBytes.offset      = position;
+            valP->_value.extBytes.size        = length;
+            valP->_value.extBytes.bytes       = NULL;
+            valP->_value.extBytes.dtor        = NULL;
+            valP->_value.extBytes.dtorContext = NULL;
+#if MSVCRT
+            valP->_value.extBytes.fd = _dup(fd);
+#else
+            valP->_value.extBytes.fd = dup(fd);
+#endif
+            if (valP->_value.extBytes.fd < 0) {
+                xmlrpc_faultf(envP, "Unable to duplicate file descriptor "
+                              "%d.  errno = %d (%s)",
+                              fd, errno, strerror(errno));
+                valP->lockP->destroy(valP->lockP);
+                free(valP);
+                valP = NULL;
+            }
+        }
+    }
+    return valP;
+}
+
+
+
+xmlrpc_value *
+xmlrpc_base64_new_mapped(xmlrpc_env *          const envP,
+                         size_t                const length,
+                         const unsigned char * const value,
+                         xmlrpc_cptr_dtor_fn   const dtor,
+                         void *                const dtorContext) {
+
+    xmlrpc_value * valP;
+
+    xmlrpc_createXmlrpcValue(envP, &valP);
+
+    if (!envP->fault_occurred) {
+        valP->_type = XMLRPC_TYPE_BASE64;
+        valP->blockP = NULL;
+        valP->_cache = NULL;
+        valP->_value.extBytes.fd          = -1;
+        valP->_value.extBytes.offset      = 0;
+        valP->_value.extBytes.size        = length;
+        valP->_value.extBytes.bytes       = value;
+        valP->_value.extBytes.dtor        = dtor;
+        valP->_value.extBytes.dtorContext = dtorContext;
+    }
+    return valP;
+}
+
+
+
 xmlrpc_value *
 xmlrpc_base64_new_value(xmlrpc_env *   const envP,
                         xmlrpc_value * const valueP) {
@@ -617,11 +882,24 @@ xmlrpc_base64_new_value(xmlrpc_env *   const envP,
                                        "Value is not a datetime.  "
                                        "It is type #%d", valueP->_type);
         retval = NULL;
-    } else
+    } else if (valueP->blockP)
         retval = xmlrpc_base64_new(envP,
                                    xmlrpc_mem_block_size(valueP->blockP),
                                    xmlrpc_mem_block_contents(valueP->blockP));
+    else {
+        /* The copy has its own copy of the bytes, in memory */
+        const unsigned char * bytes;
+        size_t size;
 
+        xmlrpc_read_base64(envP, valueP, &size, &bytes);
+
+        if (envP->fault_occurred)
+            retval = NULL;
+        else {
+            retval = xmlrpc_base64_new(envP, size, bytes);
+            free((void *)bytes);
+        }
+    }
     return retval;
 }
 
@@ -695,6 +973,71 @@ xmlrpc_nil_new(xmlrpc_env *    const envP) {
 
 
 
+xmlrpc_value *
+xmlrpc_preserialized_new(xmlrpc_env *   const envP,
+                         xmlrpc_dialect const dialect,
+                         const char *   const xml,
+                         size_t         const xmlLength) {
+/*----------------------------------------------------------------------------
+   Create a value whose XML-RPC representation is already known: 'xml' is
+   the content of a <value> element in XML-RPC dialect 'dialect', e.g.
+   "<struct>...</struct>".
+
+   We don't parse or validate 'xml'; the serializer just copies it into its
+   output.  So if you have a large value you send over and over, you can
+   serialize it once (see xmlrpc_preserialize()) and save the work.
+-----------------------------------------------------------------------------*/
+    xmlrpc_value * valP;
+
+    xmlrpc_createXmlrpcValue(envP, &valP);
+
+    if (!envP->fault_occurred) {
+        valP->_type = XMLRPC_TYPE_PRESERIALIZED;
+        valP->_value.dialect = dialect;
+
+        valP->blockP = xmlrpc_mem_block_new(envP, xmlLength);
+        if (!envP->fault_occurred) {
+            char * const contents =
+                xmlrpc_mem_block_contents(valP->blockP);
+            memcpy(contents, xml, xmlLength);
+        }
+        if (envP->fault_occurred) {
+            valP->lockP->destroy(valP->lockP);
+            free(valP);
+        }
+    }
+    return valP;
+}
+
+
+
+void
+xmlrpc_value_set_memoize(xmlrpc_value * const valueP,
+                         xmlrpc_bool    const memoize) {
+/*----------------------------------------------------------------------------
+   Tell whether the serializer may remember the XML it generates for
+   *valueP and use it again the next time it serializes *valueP.
+
+   Turn this on only for a value that no one will modify again, including
+   the members of an array or struct.  The remembered XML does not track
+   changes.
+
+   Turning it off discards anything remembered.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_VALUE_OK(valueP);
+
+    valueP->lockP->acquire(valueP->lockP);
+
+    valueP->_memoize = !!memoize;
+
+    if (!valueP->_memoize)
+        destroyMemo(valueP);
+
+    valueP->lockP->release(valueP->lockP);
+}
+
+
+
 /* Copyright (C) 2001 by First Peer, Inc. All rights reserved.
 ** Copyright (C) 2001 by Eric Kidd. All rights reserved.
 **
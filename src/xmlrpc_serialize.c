@@ -20,6 +20,10 @@
 #include <float.h>
 
 #include "int.h"
+#include "girmath.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/thread_int.h"
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/base_int.h"
 #include "xmlrpc-c/string_int.h"
@@ -31,6 +35,14 @@
 #define XMLNS_APACHE "xmlns:ex=\"" APACHE_URL "\""
 
 
+static void
+serializeValue(xmlrpc_env *       const envP,
+               xmlrpc_mem_block * const outputP,
+               xmlrpc_value *     const valueP,
+               xmlrpc_dialect     const dialect,
+               bool               const parallelOk);
+
+
 static void
 addString(xmlrpc_env *       const envP,
           xmlrpc_mem_block * const outputP,
@@ -282,6 +294,103 @@ xmlrpc_serialize_base64_data(xmlrpc_env *       const envP,
 
 
 
+/* The number of bytes of a base64 value we encode at a time.  It is a
+   multiple of the 57 bytes that make one line of base64 ASCII, so the
+   result is the same as if we encoded the whole value at once.
+*/
+#define BASE64_CHUNK_SIZE (57 * 1024)
+
+
+
+static void
+reserveForBase64(xmlrpc_env *       const envP,
+                 xmlrpc_mem_block * const outputP,
+                 size_t             const size) {
+/*----------------------------------------------------------------------------
+   Make *outputP big enough that appending 'size' bytes in base64 ASCII
+   doesn't have to grow it.
+
+   A large block grows a megabyte at a time, copying all its contents each
+   time, so appending a large value a chunk at a time would otherwise copy
+   the response over and over, and hold two copies of it while doing so.
+-----------------------------------------------------------------------------*/
+    size_t const outputSize = XMLRPC_MEMBLOCK_SIZE(char, outputP);
+
+    /* Four characters for every three bytes, and a CRLF after every line
+       of up to 57 bytes
+    */
+    size_t const encodedSize = 4 * ((size + 2) / 3) + 2 * ((size + 56) / 57);
+
+    XMLRPC_MEMBLOCK_RESIZE(char, envP, outputP, outputSize + encodedSize);
+
+    /* Shrinking the block leaves its memory allocated */
+    if (!envP->fault_occurred)
+        XMLRPC_MEMBLOCK_RESIZE(char, envP, outputP, outputSize);
+}
+
+
+
+static void
+serializeBase64Bytes(xmlrpc_env *       const envP,
+                     xmlrpc_mem_block * const outputP,
+                     xmlrpc_value *     const valueP) {
+/*----------------------------------------------------------------------------
+   Append the bytes of base64 value *valueP to *outputP, in base64 ASCII.
+
+   We do it a chunk at a time, so the memory we need besides *outputP is
+   small no matter how big the value is.  If the bytes are in a file, we
+   read them a chunk at a time too.  *outputP itself grows by the whole
+   encoded value, about 4/3 of its size.
+-----------------------------------------------------------------------------*/
+    size_t const size = xmlrpc_base64Size(valueP);
+
+    if (size == 0)
+        xmlrpc_serialize_base64_data(envP, outputP, NULL, 0);
+    else {
+        const unsigned char * const contents =
+            valueP->blockP ?
+            XMLRPC_MEMBLOCK_CONTENTS(unsigned char, valueP->blockP) :
+            valueP->_value.extBytes.bytes;
+
+        unsigned char * buffer;
+
+        reserveForBase64(envP, outputP, size);
+
+        if (envP->fault_occurred || contents)
+            buffer = NULL;
+        else {
+            buffer = malloc(MIN(size, BASE64_CHUNK_SIZE));
+            if (!buffer)
+                xmlrpc_faultf(envP, "Unable to allocate a buffer for "
+                              "reading a base64 value's file");
+        }
+        if (!envP->fault_occurred) {
+            size_t done;
+
+            for (done = 0; done < size && !envP->fault_occurred; ) {
+                size_t const chunkSize = MIN(size - done, BASE64_CHUNK_SIZE);
+
+                if (contents)
+                    xmlrpc_serialize_base64_data(
+                        envP, outputP, (unsigned char *)contents + done,
+                        chunkSize);
+                else {
+                    xmlrpc_base64Read(envP, valueP, done, chunkSize, buffer);
+
+                    if (!envP->fault_occurred)
+                        xmlrpc_serialize_base64_data(envP, outputP,
+                                                     buffer, chunkSize);
+                }
+                done += chunkSize;
+            }
+            if (buffer)
+                free(buffer);
+        }
+    }
+}
+
+
+
 static void
 serializeDatetime(xmlrpc_env *       const envP,
                   xmlrpc_mem_block * const outputP,
@@ -327,7 +436,8 @@ serializeStructMember(xmlrpc_env *       const envP,
                       xmlrpc_mem_block * const outputP,
                       xmlrpc_value *     const memberKeyP,
                       xmlrpc_value *     const memberValueP,
-                      xmlrpc_dialect     const dialect) {
+                      xmlrpc_dialect     const dialect,
+                      bool               const parallelOk) {
 
     addString(envP, outputP, "<member><name>");
 
@@ -338,7 +448,8 @@ serializeStructMember(xmlrpc_env *       const envP,
             addString(envP, outputP, "</name>"CRLF);
 
             if (!envP->fault_occurred) {
-                xmlrpc_serialize_value2(envP, outputP, memberValueP, dialect);
+                serializeValue(envP, outputP, memberValueP, dialect,
+                               parallelOk);
 
                 if (!envP->fault_occurred) {
                     addString(envP, outputP, "</member>"CRLF);
@@ -354,7 +465,8 @@ static void
 serializeStruct(xmlrpc_env *       const envP,
                 xmlrpc_mem_block * const outputP,
                 xmlrpc_value *     const structP,
-                xmlrpc_dialect     const dialect) {
+                xmlrpc_dialect     const dialect,
+                bool               const parallelOk) {
 /*----------------------------------------------------------------------------
    Add to *outputP the content of a <value> element to represent
    the structure value *valueP.  I.e. "<struct> ... </struct>".
@@ -372,7 +484,8 @@ serializeStruct(xmlrpc_env *       const envP,
                                                 &memberKeyP, &memberValueP);
                 if (!envP->fault_occurred) {
                     serializeStructMember(envP, outputP,
-                                          memberKeyP, memberValueP, dialect);
+                                          memberKeyP, memberValueP, dialect,
+                                          parallelOk);
                 }
             }
             if (!envP->fault_occurred)
@@ -383,31 +496,187 @@ serializeStruct(xmlrpc_env *       const envP,
 
 
 
+static void
+serializeArrayItems(xmlrpc_env *       const envP,
+                    xmlrpc_mem_block * const outputP,
+                    xmlrpc_value *     const arrayP,
+                    unsigned int       const begin,
+                    unsigned int       const end,
+                    xmlrpc_dialect     const dialect,
+                    bool               const parallelOk) {
+/*----------------------------------------------------------------------------
+   Add to *outputP the <value> elements for items 'begin' through 'end' - 1
+   of array *arrayP, each followed by a line delimiter.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    for (i = begin; i < end && !envP->fault_occurred; ++i) {
+        xmlrpc_value * const itemP =
+            xmlrpc_array_get_item(envP, arrayP, i);
+        if (!envP->fault_occurred) {
+            serializeValue(envP, outputP, itemP, dialect, parallelOk);
+            if (!envP->fault_occurred)
+                addString(envP, outputP, CRLF);
+        }
+    }
+}
+
+
+
+typedef struct {
+/*----------------------------------------------------------------------------
+   A range of the items of an array, to be serialized by its own thread.
+-----------------------------------------------------------------------------*/
+    xmlrpc_value *         arrayP;
+    unsigned int           begin;
+    unsigned int           end;
+    xmlrpc_dialect         dialect;
+    struct xmlrpc_thread * threadP;
+        /* The thread serializing this range.  NULL if we couldn't create
+           a thread for it, so the caller's thread must do it.
+        */
+    xmlrpc_env             env;
+        /* Result of serializing the range */
+    xmlrpc_mem_block *     outputP;
+        /* The XML for the range.  Meaningful only if 'env' shows no
+           failure.
+        */
+} itemRange;
+
+
+
+static xmlrpc_threadFn serializeItemRange;
+
+static void
+serializeItemRange(void * const arg) {
+
+    itemRange * const rangeP = arg;
+
+    rangeP->outputP = XMLRPC_MEMBLOCK_NEW(char, &rangeP->env, 0);
+
+    if (!rangeP->env.fault_occurred) {
+        /* We don't let a member of this range go parallel itself; the
+           caller already has all the threads it asked for.
+        */
+        serializeArrayItems(&rangeP->env, rangeP->outputP, rangeP->arrayP,
+                            rangeP->begin, rangeP->end, rangeP->dialect,
+                            false);
+
+        if (rangeP->env.fault_occurred)
+            XMLRPC_MEMBLOCK_FREE(char, rangeP->outputP);
+    }
+}
+
+
+
+static void
+serializeArrayItemsParallel(xmlrpc_env *       const envP,
+                            xmlrpc_mem_block * const outputP,
+                            xmlrpc_value *     const arrayP,
+                            unsigned int       const size,
+                            unsigned int       const threadCt,
+                            xmlrpc_dialect     const dialect) {
+/*----------------------------------------------------------------------------
+   Same as serializeArrayItems() for all the items of *arrayP, but split the
+   items into 'threadCt' ranges and serialize each in its own thread, into
+   its own buffer.  Then append the buffers to *outputP in order.
+
+   The caller's thread does the first range, directly into *outputP.  If we
+   can't create a thread for some range, the caller's thread does that one
+   too.
+-----------------------------------------------------------------------------*/
+    itemRange * ranges;
+
+    MALLOCARRAY(ranges, threadCt);
+
+    if (!ranges)
+        xmlrpc_faultf(envP, "Couldn't allocate memory for %u array "
+                      "serialization ranges", threadCt);
+    else {
+        unsigned int i;
+
+        for (i = 1; i < threadCt; ++i) {
+            itemRange * const rangeP = &ranges[i];
+            const char * error;
+
+            rangeP->arrayP  = arrayP;
+            rangeP->begin   = (unsigned int)((uint64_t)size * i / threadCt);
+            rangeP->end     =
+                (unsigned int)((uint64_t)size * (i+1) / threadCt);
+            rangeP->dialect = dialect;
+            xmlrpc_env_init(&rangeP->env);
+
+            xmlrpc_thread_create(&rangeP->threadP, &serializeItemRange,
+                                 rangeP, &error);
+            if (error) {
+                xmlrpc_strfree(error);
+                rangeP->threadP = NULL;
+            }
+        }
+        serializeArrayItems(envP, outputP, arrayP,
+                            0, (unsigned int)((uint64_t)size / threadCt),
+                            dialect, false);
+
+        for (i = 1; i < threadCt; ++i) {
+            itemRange * const rangeP = &ranges[i];
+
+            if (rangeP->threadP)
+                xmlrpc_thread_join(rangeP->threadP);
+            else
+                serializeItemRange(rangeP);
+
+            if (!rangeP->env.fault_occurred) {
+                if (!envP->fault_occurred)
+                    XMLRPC_MEMBLOCK_APPEND(
+                        char, envP, outputP,
+                        XMLRPC_MEMBLOCK_CONTENTS(char, rangeP->outputP),
+                        XMLRPC_MEMBLOCK_SIZE(char, rangeP->outputP));
+
+                XMLRPC_MEMBLOCK_FREE(char, rangeP->outputP);
+            } else if (!envP->fault_occurred)
+                xmlrpc_env_set_fault(envP, rangeP->env.fault_code,
+                                     rangeP->env.fault_string);
+
+            xmlrpc_env_clean(&rangeP->env);
+        }
+        free(ranges);
+    }
+}
+
+
+
 static void
 serializeArray(xmlrpc_env *       const envP,
                xmlrpc_mem_block * const outputP,
                xmlrpc_value *     const valueP,
-               xmlrpc_dialect     const dialect) {
+               xmlrpc_dialect     const dialect,
+               bool               const parallelOk) {
 /*----------------------------------------------------------------------------
    Add to *outputP the content of a <value> element to represent
    the array value *valueP.  I.e. "<array> ... </array>".
+
+   If 'parallelOk' and the array is big enough, serialize it with multiple
+   threads, per the XMLRPC_SERIALIZE_THREADS_LIMIT_ID and
+   XMLRPC_SERIALIZE_PARALLEL_MIN_LIMIT_ID limits.
 -----------------------------------------------------------------------------*/
     int const size = xmlrpc_array_size(envP, valueP);
 
     if (!envP->fault_occurred) {
         addString(envP, outputP, "<array><data>"CRLF);
         if (!envP->fault_occurred) {
-            int i;
-            /* Serialize each item. */
-            for (i = 0; i < size && !envP->fault_occurred; ++i) {
-                xmlrpc_value * const itemP =
-                    xmlrpc_array_get_item(envP, valueP, i);
-                if (!envP->fault_occurred) {
-                    xmlrpc_serialize_value2(envP, outputP, itemP, dialect);
-                    if (!envP->fault_occurred)
-                        addString(envP, outputP, CRLF);
-                }
-            }
+            size_t const threadLimit =
+                xmlrpc_limit_get(XMLRPC_SERIALIZE_THREADS_LIMIT_ID);
+            size_t const parallelMin =
+                xmlrpc_limit_get(XMLRPC_SERIALIZE_PARALLEL_MIN_LIMIT_ID);
+
+            if (parallelOk && threadLimit > 1 && size > 1 &&
+                (size_t)size >= parallelMin)
+                serializeArrayItemsParallel(
+                    envP, outputP, valueP, size,
+                    MIN(threadLimit, (size_t)size), dialect);
+            else
+                serializeArrayItems(envP, outputP, valueP, 0, size, dialect,
+                                    parallelOk);
         }
     }
     if (!envP->fault_occurred)
@@ -416,14 +685,51 @@ serializeArray(xmlrpc_env *       const envP,
 
 
 
+static const char *
+dialectName(xmlrpc_dialect const dialect) {
+
+    switch (dialect) {
+    case xmlrpc_dialect_i8:     return "i8";
+    case xmlrpc_dialect_apache: return "apache";
+    default:                    return "???";
+    }
+}
+
+
+
 static void
-formatValueContent(xmlrpc_env *       const envP,
-                   xmlrpc_mem_block * const outputP,
-                   xmlrpc_value *     const valueP,
-                   xmlrpc_dialect     const dialect) {
+serializePreserialized(xmlrpc_env *       const envP,
+                       xmlrpc_mem_block * const outputP,
+                       xmlrpc_value *     const valueP,
+                       xmlrpc_dialect     const dialect) {
+/*----------------------------------------------------------------------------
+   Add to *outputP the content of a <value> element to represent
+   the preserialized value *valueP, which is just the XML in it.
+-----------------------------------------------------------------------------*/
+    if (valueP->_value.dialect != dialect)
+        xmlrpc_faultf(envP, "Preserialized value is in the '%s' dialect "
+                      "of XML-RPC, but we are generating the '%s' dialect",
+                      dialectName(valueP->_value.dialect),
+                      dialectName(dialect));
+    else
+        XMLRPC_MEMBLOCK_APPEND(char, envP, outputP,
+                               XMLRPC_MEMBLOCK_CONTENTS(char, valueP->blockP),
+                               XMLRPC_MEMBLOCK_SIZE(char, valueP->blockP));
+}
+
+
+
+static void
+generateValueContent(xmlrpc_env *       const envP,
+                     xmlrpc_mem_block * const outputP,
+                     xmlrpc_value *     const valueP,
+                     xmlrpc_dialect     const dialect,
+                     bool               const parallelOk) {
 /*----------------------------------------------------------------------------
    Add to *outputP the content of a <value> element to represent
    value *valueP.  E.g. "<int>42</int>"
+
+   Don't use or update any memoized XML for *valueP itself.
 -----------------------------------------------------------------------------*/
     XMLRPC_ASSERT_ENV_OK(envP);
 
@@ -471,25 +777,21 @@ formatValueContent(xmlrpc_env *       const envP,
         }
         break;
 
-    case XMLRPC_TYPE_BASE64: {
-        unsigned char * const contents =
-            XMLRPC_MEMBLOCK_CONTENTS(unsigned char, valueP->blockP);
-        size_t const size =
-            XMLRPC_MEMBLOCK_SIZE(unsigned char, valueP->blockP);
+    case XMLRPC_TYPE_BASE64:
         addString(envP, outputP, "<base64>"CRLF);
         if (!envP->fault_occurred) {
-            xmlrpc_serialize_base64_data(envP, outputP, contents, size);
+            serializeBase64Bytes(envP, outputP, valueP);
             if (!envP->fault_occurred)
                 addString(envP, outputP, "</base64>");
         }
-    } break;
+        break;
 
     case XMLRPC_TYPE_ARRAY:
-        serializeArray(envP, outputP, valueP, dialect);
+        serializeArray(envP, outputP, valueP, dialect, parallelOk);
         break;
 
     case XMLRPC_TYPE_STRUCT:
-        serializeStruct(envP, outputP, valueP, dialect);
+        serializeStruct(envP, outputP, valueP, dialect, parallelOk);
         break;
 
     case XMLRPC_TYPE_C_PTR:
@@ -502,6 +804,10 @@ formatValueContent(xmlrpc_env *       const envP,
         formatOut(envP, outputP, "<%s/>", elemName);
     } break;
 
+    case XMLRPC_TYPE_PRESERIALIZED:
+        serializePreserialized(envP, outputP, valueP, dialect);
+        break;
+
     case XMLRPC_TYPE_DEAD:
         xmlrpc_faultf(envP, "Tried to serialize a dead value.");
         break;
@@ -513,15 +819,98 @@ formatValueContent(xmlrpc_env *       const envP,
 
 
 
-void
-xmlrpc_serialize_value2(xmlrpc_env *       const envP,
-                        xmlrpc_mem_block * const outputP,
-                        xmlrpc_value *     const valueP,
-                        xmlrpc_dialect     const dialect) {
+static void
+formatMemoizedValueContent(xmlrpc_env *       const envP,
+                           xmlrpc_mem_block * const outputP,
+                           xmlrpc_value *     const valueP,
+                           xmlrpc_dialect     const dialect,
+                           bool               const parallelOk) {
+/*----------------------------------------------------------------------------
+   Same as formatValueContent(), for a value that has memoization turned on.
+
+   If we have generated the XML for *valueP in this dialect before, we
+   copy that.  Otherwise, we generate it and remember it for next time.
+
+   We don't hold the value's lock while we generate the XML, so two threads
+   may generate it at the same time; the loser just discards its copy.
+-----------------------------------------------------------------------------*/
+    xmlrpc_mem_block * memoP;
+
+    valueP->lockP->acquire(valueP->lockP);
+    memoP = valueP->_memo[dialect];
+    if (memoP)
+        XMLRPC_MEMBLOCK_APPEND(char, envP, outputP,
+                               XMLRPC_MEMBLOCK_CONTENTS(char, memoP),
+                               XMLRPC_MEMBLOCK_SIZE(char, memoP));
+    valueP->lockP->release(valueP->lockP);
+
+    if (!memoP) {
+        xmlrpc_mem_block * const newMemoP = XMLRPC_MEMBLOCK_NEW(char, envP, 0);
+
+        if (!envP->fault_occurred) {
+            generateValueContent(envP, newMemoP, valueP, dialect,
+                                 parallelOk);
+
+            if (!envP->fault_occurred) {
+                bool saved;
+
+                XMLRPC_MEMBLOCK_APPEND(
+                    char, envP, outputP,
+                    XMLRPC_MEMBLOCK_CONTENTS(char, newMemoP),
+                    XMLRPC_MEMBLOCK_SIZE(char, newMemoP));
+
+                valueP->lockP->acquire(valueP->lockP);
+                if (valueP->_memoize && !valueP->_memo[dialect]) {
+                    valueP->_memo[dialect] = newMemoP;
+                    saved = true;
+                } else
+                    saved = false;
+                valueP->lockP->release(valueP->lockP);
+
+                if (!saved)
+                    XMLRPC_MEMBLOCK_FREE(char, newMemoP);
+            } else
+                XMLRPC_MEMBLOCK_FREE(char, newMemoP);
+        }
+    }
+}
+
+
+
+static void
+formatValueContent(xmlrpc_env *       const envP,
+                   xmlrpc_mem_block * const outputP,
+                   xmlrpc_value *     const valueP,
+                   xmlrpc_dialect     const dialect,
+                   bool               const parallelOk) {
+/*----------------------------------------------------------------------------
+   Add to *outputP the content of a <value> element to represent
+   value *valueP.  E.g. "<int>42</int>"
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+
+    if (valueP->_memoize)
+        formatMemoizedValueContent(envP, outputP, valueP, dialect,
+                                   parallelOk);
+    else
+        generateValueContent(envP, outputP, valueP, dialect, parallelOk);
+}
+
+
+
+static void
+serializeValue(xmlrpc_env *       const envP,
+               xmlrpc_mem_block * const outputP,
+               xmlrpc_value *     const valueP,
+               xmlrpc_dialect     const dialect,
+               bool               const parallelOk) {
 /*----------------------------------------------------------------------------
    Generate the XML to represent XML-RPC value 'valueP' in XML-RPC.
 
    Add it to *outputP.
+
+   'parallelOk' means we may use multiple threads to serialize large arrays
+   in it.
 -----------------------------------------------------------------------------*/
     XMLRPC_ASSERT_ENV_OK(envP);
     XMLRPC_ASSERT(outputP != NULL);
@@ -530,7 +919,7 @@ xmlrpc_serialize_value2(xmlrpc_env *       const envP,
     addString(envP, outputP, "<value>");
 
     if (!envP->fault_occurred) {
-        formatValueContent(envP, outputP, valueP, dialect);
+        formatValueContent(envP, outputP, valueP, dialect, parallelOk);
 
         if (!envP->fault_occurred)
             addString(envP, outputP, "</value>");
@@ -539,6 +928,21 @@ xmlrpc_serialize_value2(xmlrpc_env *       const envP,
 
 
 
+void
+xmlrpc_serialize_value2(xmlrpc_env *       const envP,
+                        xmlrpc_mem_block * const outputP,
+                        xmlrpc_value *     const valueP,
+                        xmlrpc_dialect     const dialect) {
+/*----------------------------------------------------------------------------
+   Generate the XML to represent XML-RPC value 'valueP' in XML-RPC.
+
+   Add it to *outputP.
+-----------------------------------------------------------------------------*/
+    serializeValue(envP, outputP, valueP, dialect, true);
+}
+
+
+
 void
 xmlrpc_serialize_value(xmlrpc_env *       const envP,
                        xmlrpc_mem_block * const outputP,
@@ -754,6 +1158,40 @@ xmlrpc_serialize_fault(xmlrpc_env *       const envP,
 
 
 
+xmlrpc_value *
+xmlrpc_preserialize(xmlrpc_env *   const envP,
+                    xmlrpc_value * const valueP,
+                    xmlrpc_dialect const dialect) {
+/*----------------------------------------------------------------------------
+   Create a preserialized value (see xmlrpc_preserialized_new()) that
+   represents the same thing as *valueP in dialect 'dialect'.
+-----------------------------------------------------------------------------*/
+    xmlrpc_value * retval;
+    xmlrpc_mem_block * xmlP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_VALUE_OK(valueP);
+
+    xmlP = XMLRPC_MEMBLOCK_NEW(char, envP, 0);
+    if (!envP->fault_occurred) {
+        formatValueContent(envP, xmlP, valueP, dialect, true);
+
+        if (!envP->fault_occurred)
+            retval = xmlrpc_preserialized_new(
+                envP, dialect,
+                XMLRPC_MEMBLOCK_CONTENTS(char, xmlP),
+                XMLRPC_MEMBLOCK_SIZE(char, xmlP));
+
+        XMLRPC_MEMBLOCK_FREE(char, xmlP);
+    }
+    if (envP->fault_occurred)
+        retval = NULL;
+
+    return retval;
+}
+
+
+
 /* Copyright (C) 2001 by First Peer, Inc. All rights reserved.
 **
 ** Redistribution and use in source and binary forms, with or without
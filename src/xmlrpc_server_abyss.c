@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <errno.h>
 #include <time.h>
 #include <fcntl.h>
@@ -28,6 +29,9 @@
 #include "mallocvar.h"
 
 #include "xmlrpc-c/abyss.h"
+#if HAVE_ABYSS_OPENSSL
+#include "xmlrpc-c/abyss_openssl.h"
+#endif
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
 #include "xmlrpc-c/base_int.h"
@@ -42,6 +46,8 @@ struct xmlrpc_server_abyss {
     TChanSwitch * chanSwitchP;
     bool          shutdownEnabled;
         /* User wants system.shutdown to succeed */
+    bool          tls;
+        /* The server serves HTTPS; *chanSwitchP is an OpenSSL one */
 };
 
 
@@ -138,10 +144,35 @@ processXmlrpcCall(xmlrpc_env *        const envP,
 
     xmlrpc_registry * const registryP = arg;
 
-    xmlrpc_registry_process_call2(envP, registryP,
-                                  callXml, callXmlLen, abyssSessionP,
-                                  responseXmlPP);
+    unsigned int msLeft;
+
+    if (xmlrpc_server_abyss_get_time_left(abyssSessionP, &msLeft))
+        xmlrpc_registry_process_call_deadline(envP, registryP,
+                                              callXml, callXmlLen,
+                                              abyssSessionP, msLeft,
+                                              responseXmlPP);
+    else
+        xmlrpc_registry_process_call2(envP, registryP,
+                                      callXml, callXmlLen, abyssSessionP,
+                                      responseXmlPP);
+}
+
+
+
+static void
+processXmlrpcCallAsync(
+    void *                           const arg,
+    const char *                     const callXml,
+    size_t                           const callXmlLen,
+    TSession *                       const abyssSessionP,
+    xmlrpc_registry_response_handler       responseHandler,
+    void *                           const responseHandlerArg) {
+
+    xmlrpc_registry * const registryP = arg;
 
+    xmlrpc_registry_process_call_async(registryP,
+                                       callXml, callXmlLen, abyssSessionP,
+                                       responseHandler, responseHandlerArg);
 }
 
 
@@ -175,6 +206,23 @@ setHandler(xmlrpc_env *              const envP,
 
 
 
+static void
+validateCompressLevel(xmlrpc_env * const envP,
+                      unsigned int const compressLevel) {
+/*----------------------------------------------------------------------------
+   Fail if 'compressLevel' is not a response compression level we can do.
+-----------------------------------------------------------------------------*/
+    if (compressLevel > 0 && !HAVE_ZLIB_H)
+        xmlrpc_faultf(envP, "This Xmlrpc-c was built without zlib, so it "
+                      "cannot compress responses.  "
+                      "'compress_level' must be zero");
+    else if (compressLevel > 9)
+        xmlrpc_faultf(envP, "'compress_level' must be 0-9.  "
+                      "You specified %u", compressLevel);
+}
+
+
+
 static void
 interpretHttpAccessControl(
     const xmlrpc_server_abyss_handler_parms * const parmsP,
@@ -241,6 +289,10 @@ xmlrpc_server_abyss_set_handler3(
             xmlrpc_faultf(envP, "Parameter too short to contain the required "
                           "'xml_processor_max_stack' member");
     }
+    if (!envP->fault_occurred) {
+        if (parmSize >= XMLRPC_AHPSIZE(compress_level))
+            validateCompressLevel(envP, parmsP->compress_level);
+    }
     if (!envP->fault_occurred) {
         if (parmSize >= XMLRPC_AHPSIZE(uri_path) && parmsP->uri_path)
             uriHandlerXmlrpcP->uriPath = xmlrpc_strdupsol(parmsP->uri_path);
@@ -253,14 +305,40 @@ xmlrpc_server_abyss_set_handler3(
         else
             uriHandlerXmlrpcP->chunkResponse = false;
 
+        if (parmSize >= XMLRPC_AHPSIZE(compress_level))
+            uriHandlerXmlrpcP->compressLevel = parmsP->compress_level;
+        else
+            uriHandlerXmlrpcP->compressLevel = 0;
+
+        if (parmSize >= XMLRPC_AHPSIZE(compress_min_size) &&
+            parmsP->compress_min_size > 0)
+            uriHandlerXmlrpcP->compressMinSize = parmsP->compress_min_size;
+        else
+            uriHandlerXmlrpcP->compressMinSize = 1024;
+
+        if (parmSize >= XMLRPC_AHPSIZE(xml_processor_async))
+            uriHandlerXmlrpcP->xmlProcessorAsync =
+                parmsP->xml_processor_async;
+        else
+            uriHandlerXmlrpcP->xmlProcessorAsync = NULL;
+
         interpretHttpAccessControl(parmsP, parmSize,
                                    &uriHandlerXmlrpcP->accessControl);
 
-        if (envP->fault_occurred)
+        xmlrpc_initBodyCache(envP, &uriHandlerXmlrpcP->bodyCacheP);
+
+        if (!envP->fault_occurred) {
+            setHandler(envP, srvP, uriHandlerXmlrpcP,
+                       xmlProcessorMaxStackSize);
+
+            if (envP->fault_occurred)
+                xmlrpc_termBodyCache(uriHandlerXmlrpcP->bodyCacheP);
+        }
+        if (envP->fault_occurred) {
             xmlrpc_termAccessControl(&uriHandlerXmlrpcP->accessControl);
+            xmlrpc_strfree(uriHandlerXmlrpcP->uriPath);
+        }
     }
-    if (!envP->fault_occurred)
-        setHandler(envP, srvP, uriHandlerXmlrpcP, xmlProcessorMaxStackSize);
 
     if (envP->fault_occurred)
         free(uriHandlerXmlrpcP);
@@ -311,9 +389,16 @@ xmlrpc_server_abyss_set_handler(xmlrpc_env *      const envP,
     parms.xml_processor_arg = registryP;
     parms.xml_processor_max_stack = xmlrpc_registry_max_stackSize(registryP);
     parms.uri_path = uriPath;
+    parms.chunk_response = false;
+    parms.allow_origin = NULL;
+    parms.access_ctl_expires = false;
+    parms.access_ctl_max_age = 0;
+    parms.compress_level = 0;
+    parms.compress_min_size = 0;
+    parms.xml_processor_async = &processXmlrpcCallAsync;
 
-    xmlrpc_server_abyss_set_handler3(envP, srvP,
-                                     &parms, XMLRPC_AHPSIZE(uri_path));
+    xmlrpc_server_abyss_set_handler3(
+        envP, srvP, &parms, XMLRPC_AHPSIZE(xml_processor_async));
 }
 
 
@@ -333,7 +418,9 @@ setHandlersRegistry(TServer *         const srvP,
                     bool              const chunkResponse,
                     const char *      const allowOrigin,
                     bool              const expires,
-                    unsigned int      const maxAge) {
+                    unsigned int      const maxAge,
+                    unsigned int      const compressLevel,
+                    size_t            const compressMinSize) {
 
     xmlrpc_env env;
     xmlrpc_server_abyss_handler_parms parms;
@@ -348,9 +435,12 @@ setHandlersRegistry(TServer *         const srvP,
     parms.allow_origin = allowOrigin;
     parms.access_ctl_expires = expires;
     parms.access_ctl_max_age = maxAge;
+    parms.compress_level = compressLevel;
+    parms.compress_min_size = compressMinSize;
+    parms.xml_processor_async = &processXmlrpcCallAsync;
 
     xmlrpc_server_abyss_set_handler3(
-        &env, srvP, &parms, XMLRPC_AHPSIZE(access_ctl_max_age));
+        &env, srvP, &parms, XMLRPC_AHPSIZE(xml_processor_async));
 
     if (env.fault_occurred)
         abort();
@@ -367,7 +457,8 @@ xmlrpc_server_abyss_set_handlers2(TServer *         const srvP,
                                   const char *      const uriPath,
                                   xmlrpc_registry * const registryP) {
 
-    setHandlersRegistry(srvP, uriPath, registryP, false, NULL, false, 0);
+    setHandlersRegistry(srvP, uriPath, registryP, false, NULL, false, 0,
+                        0, 0);
 }
 
 
@@ -376,7 +467,8 @@ void
 xmlrpc_server_abyss_set_handlers(TServer *         const srvP,
                                  xmlrpc_registry * const registryP) {
 
-    setHandlersRegistry(srvP, "/RPC2", registryP, false, NULL, false, 0);
+    setHandlersRegistry(srvP, "/RPC2", registryP, false, NULL, false, 0,
+                        0, 0);
 }
 
 
@@ -413,6 +505,35 @@ setAdditionalServerParms(const xmlrpc_server_abyss_parms * const parmsP,
         if (parmsP->max_rpc_mem != 0)
             ServerSetMaxSessionMem(serverP, parmsP->max_rpc_mem);
     }
+    if (parmSize >= XMLRPC_APSIZE(event_driven))
+        ServerSetEventDriven(serverP, parmsP->event_driven);
+    if (parmSize >= XMLRPC_APSIZE(conn_queue_depth)) {
+        if (parmsP->conn_queue_depth != 0)
+            ServerSetConnQueueDepth(serverP, parmsP->conn_queue_depth);
+    }
+    if (parmSize >= XMLRPC_APSIZE(acceptor_count)) {
+        if (parmsP->acceptor_count != 0)
+            ServerSetAcceptorCount(serverP, parmsP->acceptor_count);
+    }
+    if (parmSize >= XMLRPC_APSIZE(pin_acceptors))
+        ServerSetAcceptorAffinity(serverP, parmsP->pin_acceptors);
+    if (parmSize >= XMLRPC_APSIZE(prefork_max_requests)) {
+        if (parmsP->prefork_max_workers != 0)
+            ServerSetPrefork(serverP, parmsP->prefork_min_workers,
+                             parmsP->prefork_max_workers,
+                             parmsP->prefork_max_requests);
+    }
+    if (parmSize >= XMLRPC_APSIZE(shed_retry_after)) {
+        if (parmsP->shed_target_ms != 0)
+            ServerSetLoadShedding(serverP, parmsP->shed_target_ms,
+                                  parmsP->shed_interval_ms,
+                                  parmsP->shed_retry_after);
+    }
+    if (parmSize >= XMLRPC_APSIZE(log_drop_when_full)) {
+        if (parmsP->log_buffer_size != 0)
+            ServerSetLogBuffer(serverP, parmsP->log_buffer_size,
+                               parmsP->log_drop_when_full);
+    }
 }
 
 
@@ -555,15 +676,24 @@ static void
 chanSwitchCreateSockAddr(int                     const protocolFamily,
                          const struct sockaddr * const sockAddrP,
                          socklen_t               const sockAddrLen,
+                         bool                    const reusePort,
                          TChanSwitch **          const chanSwitchPP,
                          const char **           const errorP) {
-
+/*----------------------------------------------------------------------------
+   'reusePort' means let other channel switches listen at the same address,
+   for a server with multiple acceptors.  On Windows, where there are no
+   multiple acceptors, we ignore it.
+-----------------------------------------------------------------------------*/
 #if MSVCRT
     ChanSwitchWinCreate2(protocolFamily, sockAddrP, sockAddrLen,
                           chanSwitchPP, errorP);
 #else
-    ChanSwitchUnixCreate2(protocolFamily, sockAddrP, sockAddrLen,
-                          chanSwitchPP, errorP);
+    if (reusePort)
+        ChanSwitchUnixCreateReusePort(protocolFamily, sockAddrP, sockAddrLen,
+                                      chanSwitchPP, errorP);
+    else
+        ChanSwitchUnixCreate2(protocolFamily, sockAddrP, sockAddrLen,
+                              chanSwitchPP, errorP);
 #endif
 
 }
@@ -574,6 +704,7 @@ static void
 createChanSwitchSockAddr(xmlrpc_env *            const envP,
                          const struct sockaddr * const sockAddrP,
                          socklen_t               const sockAddrLen,
+                         bool                    const reusePort,
                          TChanSwitch **          const chanSwitchPP) {
 
     int protocolFamily;
@@ -597,7 +728,7 @@ createChanSwitchSockAddr(xmlrpc_env *            const envP,
         const char * error;
 
         chanSwitchCreateSockAddr(protocolFamily, sockAddrP, sockAddrLen,
-                                 chanSwitchPP, &error);
+                                 reusePort, chanSwitchPP, &error);
 
         if (error) {
             xmlrpc_faultf(envP, "Unable to create Abyss channel switch "
@@ -612,6 +743,7 @@ createChanSwitchSockAddr(xmlrpc_env *            const envP,
 static void
 createChanSwitchIpv4Port(xmlrpc_env *          const envP,
                          unsigned int          const portNumber,
+                         bool                  const reusePort,
                          TChanSwitch **        const chanSwitchPP) {
 
     struct sockaddr_in sockAddr;
@@ -622,7 +754,7 @@ createChanSwitchIpv4Port(xmlrpc_env *          const envP,
     sockAddr.sin_addr.s_addr = INADDR_ANY;
 
     chanSwitchCreateSockAddr(PF_INET, (const struct sockaddr *)&sockAddr,
-                             sizeof(sockAddr),
+                             sizeof(sockAddr), reusePort,
                              chanSwitchPP, &error);
 
     if (error) {
@@ -635,6 +767,122 @@ createChanSwitchIpv4Port(xmlrpc_env *          const envP,
 
 
 
+static struct ssl_ctx_st *
+sslCtxParm(const xmlrpc_server_abyss_parms * const parmsP,
+           unsigned int                      const parmSize) {
+
+    return parmSize >= XMLRPC_APSIZE(ssl_ctx_p) ? parmsP->ssl_ctx_p : NULL;
+}
+
+
+
+#if HAVE_ABYSS_OPENSSL
+
+static void
+setTlsSessionParms(xmlrpc_env *                      const envP,
+                   const xmlrpc_server_abyss_parms * const parmsP,
+                   unsigned int                      const parmSize,
+                   TChanSwitch *                     const chanSwitchP) {
+
+    struct abyss_openSsl_sessionparms sessionParms;
+    const char * error;
+
+    sessionParms.cacheSize =
+        parmSize >= XMLRPC_APSIZE(ssl_session_cache_size) &&
+        parmsP->ssl_session_cache_size > 0 ?
+        parmsP->ssl_session_cache_size : SSL_SESSION_CACHE_MAX_SIZE_DEFAULT;
+    sessionParms.timeout =
+        parmSize >= XMLRPC_APSIZE(ssl_session_timeout) ?
+        parmsP->ssl_session_timeout : 0;
+    sessionParms.tickets =
+        !(parmSize >= XMLRPC_APSIZE(ssl_no_session_tickets) &&
+          parmsP->ssl_no_session_tickets);
+    sessionParms.ticketKeyLifetime =
+        parmSize >= XMLRPC_APSIZE(ssl_ticket_key_lifetime) ?
+        parmsP->ssl_ticket_key_lifetime : 0;
+    if (parmSize >= XMLRPC_APSIZE(ssl_ticket_secret_len)) {
+        sessionParms.ticketSecret    = parmsP->ssl_ticket_secret;
+        sessionParms.ticketSecretLen = parmsP->ssl_ticket_secret_len;
+    } else {
+        sessionParms.ticketSecret    = NULL;
+        sessionParms.ticketSecretLen = 0;
+    }
+    ChanSwitchOpenSslSetSessionParms(chanSwitchP, &sessionParms, &error);
+
+    if (error) {
+        xmlrpc_faultf(envP, "Unable to set up TLS session resumption.  %s",
+                      error);
+        xmlrpc_strfree(error);
+    }
+}
+
+#endif
+
+
+
+static void
+createChanSwitchOpenSsl(xmlrpc_env *                      const envP,
+                        const xmlrpc_server_abyss_parms * const parmsP,
+                        unsigned int                      const parmSize,
+                        bool                              const socketBound,
+                        TOsSocket                         const socketFd,
+                        const struct sockaddr *           const sockAddrP,
+                        socklen_t                         const sockAddrLen,
+                        unsigned int                      const portNumber,
+                        TChanSwitch **                    const chanSwitchPP) {
+/*----------------------------------------------------------------------------
+   Create a channel switch for an HTTPS server, with the OpenSSL context the
+   parameters give, listening where the parameters say.
+-----------------------------------------------------------------------------*/
+#if HAVE_ABYSS_OPENSSL
+    SSL_CTX * const sslCtxP = sslCtxParm(parmsP, parmSize);
+
+    TChanSwitch * chanSwitchP;
+    const char * error;
+
+    if (socketBound)
+        ChanSwitchOpenSslCreateFd(socketFd, sslCtxP, &chanSwitchP, &error);
+    else if (sockAddrP)
+        ChanSwitchOpenSslCreate(sockAddrP->sa_family == AF_INET6 ?
+                                PF_INET6 : PF_INET,
+                                sockAddrP, sockAddrLen, sslCtxP,
+                                &chanSwitchP, &error);
+    else
+        ChanSwitchOpenSslCreateIpV4Port(portNumber, sslCtxP,
+                                        &chanSwitchP, &error);
+
+    if (error) {
+        xmlrpc_faultf(envP, "Unable to create OpenSSL Abyss channel "
+                      "switch.  %s", error);
+        xmlrpc_strfree(error);
+    } else {
+        setTlsSessionParms(envP, parmsP, parmSize, chanSwitchP);
+
+        if (envP->fault_occurred)
+            ChanSwitchDestroy(chanSwitchP);
+        else
+            *chanSwitchPP = chanSwitchP;
+    }
+#else
+    xmlrpc_faultf(envP, "This Xmlrpc-c was built without OpenSSL, "
+                  "so it can't serve HTTPS");
+#endif
+}
+
+
+
+static unsigned int
+acceptorCountParm(const xmlrpc_server_abyss_parms * const parmsP,
+                  unsigned int                      const parmSize) {
+
+    return
+        parmSize >= XMLRPC_APSIZE(acceptor_count) &&
+        parmsP->acceptor_count > 0 ?
+        parmsP->acceptor_count : 1;
+}
+
+
+
 static void
 createServerBare(xmlrpc_env *                      const envP,
                  const xmlrpc_server_abyss_parms * const parmsP,
@@ -658,16 +906,31 @@ createServerBare(xmlrpc_env *                      const envP,
                              &logFileName);
 
     if (!envP->fault_occurred) {
+        bool const reusePort = acceptorCountParm(parmsP, parmSize) > 1;
+            /* The acceptors other than the first get listening sockets of
+               their own at the same address.  (If the user supplies the
+               socket, it is the user's job to make it allow that).
+            */
         TChanSwitch * chanSwitchP;
 
-        if (socketBound)
+        if (sslCtxParm(parmsP, parmSize)) {
+            if (reusePort)
+                xmlrpc_faultf(envP, "An HTTPS server can't have multiple "
+                              "acceptors");
+            else
+                createChanSwitchOpenSsl(envP, parmsP, parmSize,
+                                        socketBound, socketFd,
+                                        sockAddrP, sockAddrLen, portNumber,
+                                        &chanSwitchP);
+        } else if (socketBound)
             createChanSwitchOsSocket(envP, socketFd, &chanSwitchP);
         else {
             if (sockAddrP)
                 createChanSwitchSockAddr(envP, sockAddrP, sockAddrLen,
-                                         &chanSwitchP);
+                                         reusePort, &chanSwitchP);
             else
-                createChanSwitchIpv4Port(envP, portNumber, &chanSwitchP);
+                createChanSwitchIpv4Port(envP, portNumber, reusePort,
+                                         &chanSwitchP);
         }
         if (!envP->fault_occurred) {
             const char * error;
@@ -756,6 +1019,28 @@ maxAgeParm(const xmlrpc_server_abyss_parms * const parmsP,
 
 
 
+static unsigned int
+compressLevelParm(const xmlrpc_server_abyss_parms * const parmsP,
+                  unsigned int                      const parmSize) {
+
+    return
+        parmSize >= XMLRPC_APSIZE(compress_level) ?
+        parmsP->compress_level : 0;
+}
+
+
+
+static size_t
+compressMinSizeParm(const xmlrpc_server_abyss_parms * const parmsP,
+                    unsigned int                      const parmSize) {
+
+    return
+        parmSize >= XMLRPC_APSIZE(compress_min_size) ?
+        parmsP->compress_min_size : 0;
+}
+
+
+
 static void
 createServer(xmlrpc_env *                      const envP,
              const xmlrpc_server_abyss_parms * const parmsP,
@@ -763,7 +1048,10 @@ createServer(xmlrpc_env *                      const envP,
              TServer *                         const abyssServerP,
              TChanSwitch **                    const chanSwitchPP) {
 
-    createServerBare(envP, parmsP, parmSize, abyssServerP, chanSwitchPP);
+    validateCompressLevel(envP, compressLevelParm(parmsP, parmSize));
+
+    if (!envP->fault_occurred)
+        createServerBare(envP, parmsP, parmSize, abyssServerP, chanSwitchPP);
 
     if (!envP->fault_occurred) {
         const char * error;
@@ -775,7 +1063,9 @@ createServer(xmlrpc_env *                      const envP,
                             chunkResponseParm(parmsP, parmSize),
                             allowOriginParm(parmsP, parmSize),
                             expiresParm(parmsP, parmSize),
-                            maxAgeParm(parmsP, parmSize));
+                            maxAgeParm(parmsP, parmSize),
+                            compressLevelParm(parmsP, parmSize),
+                            compressMinSizeParm(parmsP, parmSize));
 
         ServerInit2(abyssServerP, &error);
 
@@ -871,6 +1161,8 @@ xmlrpc_server_abyss_create(xmlrpc_env *                      const envP,
                     serverP->shutdownEnabled =
                         enableShutdownParm(parmsP, parmSize);
 
+                    serverP->tls = !!sslCtxParm(parmsP, parmSize);
+
                     xmlrpc_registry_set_shutdown(
                         parmsP->registryP, &shutdownAbyss, serverP);
 
@@ -909,6 +1201,103 @@ xmlrpc_server_abyss_use_sigchld(xmlrpc_server_abyss_t * const serverP) {
 
 
 
+void
+xmlrpc_server_abyss_get_tls_stats(
+    xmlrpc_env *                           const envP,
+    xmlrpc_server_abyss_t *                const serverP,
+    struct xmlrpc_server_abyss_tls_stats * const statsP) {
+/*----------------------------------------------------------------------------
+   Counts of the TLS handshakes the server has done, full and resumed.  With
+   a forking or pre-forking server, these are only the ones this process
+   did.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+
+    if (!serverP->tls)
+        xmlrpc_faultf(envP, "Server does not serve HTTPS");
+    else {
+#if HAVE_ABYSS_OPENSSL
+        struct abyss_openSsl_stats stats;
+
+        ChanSwitchOpenSslGetStats(serverP->chanSwitchP, &stats);
+
+        statsP->full_handshakes    = stats.fullHandshakes;
+        statsP->resumed_handshakes = stats.resumedHandshakes;
+        statsP->failed_handshakes  = stats.failedHandshakes;
+#else
+        XMLRPC_ASSERT(false);
+#endif
+    }
+}
+
+
+
+xmlrpc_bool
+xmlrpc_server_abyss_get_canceled(TSession * const abyssSessionP) {
+/*----------------------------------------------------------------------------
+   The call whose Abyss session is *abyssSessionP is canceled: its client
+   has closed the connection, so the result will go nowhere.  A method that
+   takes a long time can check this now and then and stop early, e.g. by
+   failing.
+
+   Each check is a nonblocking system call.  On Windows, we can't tell, so
+   the answer is always false.
+
+   A client that only shut down its sending side after sending the call
+   looks canceled too, though it still waits for the response, so this is
+   a hint for stopping lengthy work, not a reason to refuse a call.  See
+   SessionClientGone().
+-----------------------------------------------------------------------------*/
+    return SessionClientGone(abyssSessionP);
+}
+
+
+
+xmlrpc_bool
+xmlrpc_server_abyss_get_time_left(TSession *     const abyssSessionP,
+                                  unsigned int * const msLeftP) {
+/*----------------------------------------------------------------------------
+   The call whose Abyss session is *abyssSessionP has a deadline: its client
+   said (with an X-Xmlrpc-Timeout HTTP header, which the Xmlrpc-c Curl
+   transport sends when the user set a timeout) how long it would wait for
+   the response.  Return *msLeftP how many milliseconds of that remain,
+   counting from when the request arrived (which includes any time it
+   waited for a server thread).  Zero means the client has probably given
+   up already.
+
+   Return false and no *msLeftP if the client didn't give a timeout, or
+   gave one we can't understand or one too long to matter.
+-----------------------------------------------------------------------------*/
+    const char * const timeoutValue =
+        RequestHeaderValue(abyssSessionP, "x-xmlrpc-timeout");
+
+    xmlrpc_bool retval;
+
+    if (!timeoutValue || timeoutValue[0] == '\0')
+        retval = false;
+    else {
+        unsigned long timeoutMs;
+        char * tail;
+
+        errno = 0;
+        timeoutMs = strtoul(timeoutValue, &tail, 10);
+
+        if (*tail != '\0' || errno != 0 || timeoutMs == 0 ||
+            timeoutMs > UINT_MAX)
+            retval = false;
+        else {
+            unsigned long const ageMs = SessionGetAgeMs(abyssSessionP);
+
+            *msLeftP = timeoutMs > ageMs ? timeoutMs - ageMs : 0;
+
+            retval = true;
+        }
+    }
+    return retval;
+}
+
+
+
 void
 xmlrpc_server_abyss_run_server(xmlrpc_env *            const envP ATTR_UNUSED,
                                xmlrpc_server_abyss_t * const serverP) {
@@ -1127,7 +1516,7 @@ oldHighLevelAbyssRun(xmlrpc_env *                      const envP,
         assert(parmSize >= XMLRPC_APSIZE(registryP));
 
         setHandlersRegistry(&server, "/RPC2", parmsP->registryP, false, NULL,
-                            false, 0);
+                            false, 0, 0, 0);
 
         ServerInit(&server);
 
@@ -1251,7 +1640,7 @@ xmlrpc_server_abyss_init_registry(void) {
     xmlrpc_env_clean(&env);
 
     setHandlersRegistry(&globalSrv, "/RPC2", builtin_registryP, false, NULL,
-                        false, 0);
+                        false, 0, 0, 0);
 }
 
 
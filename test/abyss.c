@@ -1,6 +1,6 @@
-/* None of the tests in here rely on a client existing, or even a network
-   connection.  We should figure out how to create a test client and do
-   such tests.
+/* Most of the tests in here don't rely on a client existing, or even a
+   network connection.  testPipelining() and the tests after it are clients
+   of a server on the loopback interface.
 */
 #define WIN32_LEAN_AND_MEAN  /* required by xmlrpc-c/abyss.h */
 
@@ -9,9 +9,12 @@
 #ifndef _WIN32
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <arpa/inet.h>
 #endif
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "xmlrpc_config.h"
 
@@ -20,6 +23,7 @@
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
 #include "xmlrpc-c/abyss.h"
+#include "xmlrpc-c/thread_int.h"
 
 #include "testtool.h"
 
@@ -380,6 +384,507 @@ testServerCreate(void) {
 
 
 
+#ifndef _WIN32
+
+static char
+bodyByte(size_t const i) {
+/*----------------------------------------------------------------------------
+   The byte at position 'i' of a request body for URI /readlen.
+-----------------------------------------------------------------------------*/
+    return 'a' + i % 26;
+}
+
+
+
+static void
+handlePipelineReq(void *       const handler ATTR_UNUSED,
+                  TSession *   const sessionP,
+                  abyss_bool * const handledP) {
+/*----------------------------------------------------------------------------
+   Respond with the request URI and, for URI /read, the request body.  For
+   URI /readlen, read as many bytes of body as the X-Read-Length header
+   says and respond with "ok" if they are the bytes bodyByte() says and
+   "error" if the read fails.  For other URIs, leave the body unread, so
+   the server has to skip it to get to the next request.
+-----------------------------------------------------------------------------*/
+    const TRequestInfo * requestInfoP;
+    const char * contentLength;
+    const char * readLength;
+    char body[64];
+    char response[128];
+
+    SessionGetRequestInfo(sessionP, &requestInfoP);
+
+    contentLength = RequestHeaderValue(sessionP, "content-length");
+    readLength    = RequestHeaderValue(sessionP, "x-read-length");
+
+    body[0] = '\0';
+
+    if (readLength && strcmp(requestInfoP->uri, "/readlen") == 0) {
+        size_t const len = atoi(readLength);
+        char * const buffer = malloc(len);
+        const char * error;
+
+        TEST(buffer != NULL);
+
+        SessionReadBody(sessionP, len, buffer, &error);
+
+        if (error) {
+            strcpy(body, "error");
+            strfree(error);
+        } else {
+            size_t i;
+            bool matches;
+
+            for (i = 0, matches = true; i < len; ++i) {
+                if (buffer[i] != bodyByte(i))
+                    matches = false;
+            }
+            strcpy(body, matches ? "ok" : "wrong");
+        }
+        free(buffer);
+    } else if (contentLength && strcmp(requestInfoP->uri, "/read") == 0) {
+        size_t const contentSize = atoi(contentLength);
+        const char * error;
+
+        TEST(contentSize < sizeof(body));
+
+        /* Fields Abyss knows and one it doesn't */
+        TEST(strcmp(RequestHeaderValue(sessionP, "host"),
+                    "localhost") == 0);
+        TEST(strcmp(RequestHeaderValue(sessionP, "content-length"),
+                    "5") == 0);
+        TEST(strcmp(RequestHeaderValue(sessionP, "x-test"),
+                    "Pipelined") == 0);
+        TEST(RequestHeaderValue(sessionP, "content-type") == NULL);
+
+        SessionReadBody(sessionP, contentSize, body, &error);
+        TEST_NULL_STRING(error);
+        body[contentSize] = '\0';
+    }
+    snprintf(response, sizeof(response), "%s %s", requestInfoP->uri, body);
+
+    ResponseStatus(sessionP, 200);
+    ResponseContentLength(sessionP, strlen(response));
+    ResponseWriteStart(sessionP);
+    ResponseWriteBody(sessionP, response, strlen(response));
+    ResponseWriteEnd(sessionP);
+
+    *handledP = true;
+}
+
+
+
+static void
+runServer(void * const arg) {
+
+    TServer * const serverP = arg;
+
+    ServerRun(serverP);
+}
+
+
+
+static void
+startServer(size_t                   const maxSessionMem,
+            const char *             const filesPath,
+            TServer *                const serverP,
+            TChanSwitch **           const chanSwitchPP,
+            struct xmlrpc_thread **  const serverThreadPP,
+            struct sockaddr_in *     const addrP) {
+/*----------------------------------------------------------------------------
+   Start a server on a loopback port of the system's choosing, using the
+   handler handlePipelineReq(), in a thread of its own.  Return as *addrP
+   the address to which to connect.
+
+   But if 'filesPath' is non-null, the server instead serves the files in
+   directory 'filesPath', with the built-in handler.
+-----------------------------------------------------------------------------*/
+    struct ServerReqHandler3 const handlerDesc = {
+        /* .term               = */ NULL,
+        /* .handleReq          = */ &handlePipelineReq,
+        /* .userdata           = */ NULL,
+        /* .handleReqStackSize = */ 0
+    };
+    socklen_t addrLen;
+    const char * error;
+    abyss_bool success;
+    int listenFd;
+
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST(listenFd >= 0);
+
+    /* Let the system choose the port */
+    memset(addrP, 0, sizeof(*addrP));
+    addrP->sin_family      = AF_INET;
+    addrP->sin_port        = 0;
+    addrP->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST(bind(listenFd, (struct sockaddr *)addrP, sizeof(*addrP)) == 0);
+    addrLen = sizeof(*addrP);
+    TEST(getsockname(listenFd, (struct sockaddr *)addrP, &addrLen) == 0);
+
+    chanSwitchCreateFd(listenFd, chanSwitchPP, &error);
+    TEST_NULL_STRING(error);
+
+    ServerCreateSwitch(serverP, *chanSwitchPP, &error);
+    TEST_NULL_STRING(error);
+
+    if (maxSessionMem)
+        ServerSetMaxSessionMem(serverP, maxSessionMem);
+
+    if (filesPath)
+        ServerSetFilesPath(serverP, filesPath);
+    else {
+        ServerAddHandler3(serverP, &handlerDesc, &success);
+        TEST(success);
+    }
+
+    ServerInit2(serverP, &error);
+    TEST_NULL_STRING(error);
+
+    xmlrpc_thread_create(serverThreadPP, &runServer, serverP, &error);
+    TEST_NULL_STRING(error);
+}
+
+
+
+static void
+stopServer(TServer *              const serverP,
+           TChanSwitch *          const chanSwitchP,
+           struct xmlrpc_thread * const serverThreadP) {
+
+    ServerTerminate(serverP);
+
+    xmlrpc_thread_join(serverThreadP);
+
+    ServerFree(serverP);
+
+    ChanSwitchDestroy(chanSwitchP);
+}
+
+
+
+static void
+sendAndReceive(const struct sockaddr_in * const addrP,
+               const char *               const requests,
+               char *                     const response,
+               size_t                     const responseSize) {
+/*----------------------------------------------------------------------------
+   Send 'requests' to the server at *addrP in one write, shut down our
+   sending side, and return everything the server sends back before it
+   closes the connection.
+-----------------------------------------------------------------------------*/
+    size_t responseLen;
+    ssize_t rc;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST(fd >= 0);
+    TEST(connect(fd, (const struct sockaddr *)addrP, sizeof(*addrP)) == 0);
+
+    TEST(write(fd, requests, strlen(requests)) == (ssize_t)strlen(requests));
+    TEST(shutdown(fd, SHUT_WR) == 0);
+
+    responseLen = 0;
+    do {
+        rc = read(fd, &response[responseLen],
+                  responseSize - 1 - responseLen);
+        if (rc > 0)
+            responseLen += rc;
+    } while (rc > 0 && responseLen < responseSize - 1);
+
+    response[responseLen] = '\0';
+
+    closesock(fd);
+}
+
+
+
+static void
+testPipelining(void) {
+/*----------------------------------------------------------------------------
+   Send several requests on one connection without waiting for responses,
+   all in one write, and check that the server answers each of them, in
+   order.
+-----------------------------------------------------------------------------*/
+    const char * const requests =
+        "POST /read HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "X-Test: Pipelined\r\n"
+        "Content-Length: 5\r\n"
+        "\r\n"
+        "hello"
+        "POST /skip HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Content-Length: 9\r\n"
+        "\r\n"
+        "unread..."
+        "GET /last HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Connection: close\r\n"
+        "\r\n";
+
+    TServer server;
+    TChanSwitch * chanSwitchP;
+    struct xmlrpc_thread * serverThreadP;
+    struct sockaddr_in addr;
+    char response[4096];
+
+    startServer(0, NULL, &server, &chanSwitchP, &serverThreadP, &addr);
+
+    /* The server closes the connection after the last response */
+    sendAndReceive(&addr, requests, response, sizeof(response));
+
+    {
+        const char * const readP = strstr(response, "/read hello");
+        const char * const skipP = strstr(response, "/skip ");
+        const char * const lastP = strstr(response, "/last ");
+
+        TEST(readP != NULL);
+        TEST(skipP != NULL);
+        TEST(lastP != NULL);
+        TEST(readP < skipP && skipP < lastP);
+    }
+    TEST(strstr(response, "HTTP/1.1 200") == response);
+
+    stopServer(&server, chanSwitchP, serverThreadP);
+}
+
+
+
+static void
+testSessionMemLimit(void) {
+/*----------------------------------------------------------------------------
+   Check that the server refuses a request whose header needs more memory
+   than the server lets a session have, but serves ordinary requests on the
+   same connection before it.
+-----------------------------------------------------------------------------*/
+    TServer server;
+    TChanSwitch * chanSwitchP;
+    struct xmlrpc_thread * serverThreadP;
+    struct sockaddr_in addr;
+    char requests[8192];
+    char response[4096];
+    unsigned int i;
+
+    startServer(2048, NULL, &server, &chanSwitchP, &serverThreadP, &addr);
+
+    strcpy(requests,
+           "GET /first HTTP/1.1\r\n"
+           "Host: localhost\r\n"
+           "\r\n"
+           "GET /second HTTP/1.1\r\n"
+           "Host: localhost\r\n"
+           "\r\n"
+           "GET /huge HTTP/1.1\r\n"
+           "Host: localhost\r\n");
+
+    /* About 4K of header, twice the limit, in lines of ordinary size */
+    for (i = 0; i < 40; ++i) {
+        size_t const len = strlen(requests);
+        snprintf(&requests[len], sizeof(requests) - len,
+                 "X-Filler-%02u: %080u\r\n", i, i);
+    }
+    strcat(requests, "\r\n");
+
+    sendAndReceive(&addr, requests, response, sizeof(response));
+
+    {
+        const char * const firstP  = strstr(response, "/first ");
+        const char * const secondP = strstr(response, "/second ");
+        const char * const errorP  = strstr(response, "HTTP/1.1 413");
+
+        TEST(firstP != NULL);
+        TEST(secondP != NULL);
+        TEST(errorP != NULL);
+        TEST(firstP < secondP && secondP < errorP);
+        TEST(strstr(response, "/huge ") == NULL);
+    }
+    stopServer(&server, chanSwitchP, serverThreadP);
+}
+
+
+
+static void
+testReadBodyStraddling(void) {
+/*----------------------------------------------------------------------------
+   Check that SessionReadBody() reads a body that starts in the connection
+   buffer and continues past its end, where it comes straight from the
+   channel.
+-----------------------------------------------------------------------------*/
+    size_t const bodyLen = 10000;  /* more than a connection bufferful */
+
+    TServer server;
+    TChanSwitch * chanSwitchP;
+    struct xmlrpc_thread * serverThreadP;
+    struct sockaddr_in addr;
+    char * request;
+    size_t headerLen;
+    size_t i;
+    char response[4096];
+
+    request = malloc(256 + bodyLen + 1);
+    TEST(request != NULL);
+
+    sprintf(request,
+            "POST /readlen HTTP/1.1\r\n"
+            "Host: localhost\r\n"
+            "Content-Length: %u\r\n"
+            "X-Read-Length: %u\r\n"
+            "Connection: close\r\n"
+            "\r\n", (unsigned)bodyLen, (unsigned)bodyLen);
+
+    headerLen = strlen(request);
+
+    for (i = 0; i < bodyLen; ++i)
+        request[headerLen + i] = bodyByte(i);
+    request[headerLen + bodyLen] = '\0';
+
+    startServer(0, NULL, &server, &chanSwitchP, &serverThreadP, &addr);
+
+    sendAndReceive(&addr, request, response, sizeof(response));
+
+    TEST(strstr(response, "HTTP/1.1 200") == response);
+    TEST(strstr(response, "/readlen ok") != NULL);
+
+    stopServer(&server, chanSwitchP, serverThreadP);
+
+    free(request);
+}
+
+
+
+static void
+testReadBodyEarlyEof(void) {
+/*----------------------------------------------------------------------------
+   Check that SessionReadBody() fails right away, rather than waiting for
+   the rest of the body, when the client stops sending before the end of
+   the body its Content-Length promised.
+-----------------------------------------------------------------------------*/
+    TServer server;
+    TChanSwitch * chanSwitchP;
+    struct xmlrpc_thread * serverThreadP;
+    struct sockaddr_in addr;
+    char response[4096];
+    time_t startTime;
+
+    startServer(0, NULL, &server, &chanSwitchP, &serverThreadP, &addr);
+
+    startTime = time(NULL);
+
+    /* The server's read timeout is 15 seconds */
+    sendAndReceive(&addr,
+                   "POST /readlen HTTP/1.1\r\n"
+                   "Host: localhost\r\n"
+                   "Content-Length: 100\r\n"
+                   "X-Read-Length: 100\r\n"
+                   "\r\n"
+                   "abcdefghij",
+                   response, sizeof(response));
+
+    TEST(time(NULL) - startTime < 5);
+
+    TEST(strstr(response, "/readlen error") != NULL);
+
+    stopServer(&server, chanSwitchP, serverThreadP);
+}
+
+
+
+static void
+testReadBodyChunked(void) {
+/*----------------------------------------------------------------------------
+   Check that SessionReadBody() reads a chunked body across its chunks.
+-----------------------------------------------------------------------------*/
+    TServer server;
+    TChanSwitch * chanSwitchP;
+    struct xmlrpc_thread * serverThreadP;
+    struct sockaddr_in addr;
+    char response[4096];
+
+    startServer(0, NULL, &server, &chanSwitchP, &serverThreadP, &addr);
+
+    sendAndReceive(&addr,
+                   "POST /readlen HTTP/1.1\r\n"
+                   "Host: localhost\r\n"
+                   "Transfer-Encoding: chunked\r\n"
+                   "X-Read-Length: 30\r\n"
+                   "Connection: close\r\n"
+                   "\r\n"
+                   "10\r\n"
+                   "abcdefghijklmnop\r\n"
+                   "E\r\n"
+                   "qrstuvwxyzabcd\r\n"
+                   "0\r\n"
+                   "\r\n",
+                   response, sizeof(response));
+
+    TEST(strstr(response, "HTTP/1.1 200") == response);
+    TEST(strstr(response, "/readlen ok") != NULL);
+
+    stopServer(&server, chanSwitchP, serverThreadP);
+}
+
+
+
+static void
+testFileRange(void) {
+/*----------------------------------------------------------------------------
+   Check that the built-in file handler answers a GET with a Range header
+   with just the requested bytes of the file.
+-----------------------------------------------------------------------------*/
+    const char * const content = "abcdefghijklmnopqrstuvwxyz"
+                                 "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+    TServer server;
+    TChanSwitch * chanSwitchP;
+    struct xmlrpc_thread * serverThreadP;
+    struct sockaddr_in addr;
+    char dirName[] = "/tmp/xmlrpc_test_rangeXXXXXX";
+    const char * fileName;
+    FILE * fileP;
+    char response[4096];
+
+    TEST(mkdtemp(dirName) != NULL);
+
+    casprintf(&fileName, "%s/file.txt", dirName);
+
+    fileP = fopen(fileName, "w");
+    TEST(fileP != NULL);
+    TEST(fputs(content, fileP) >= 0);
+    TEST(fclose(fileP) == 0);
+
+    startServer(0, dirName, &server, &chanSwitchP, &serverThreadP, &addr);
+
+    sendAndReceive(&addr,
+                   "GET /file.txt HTTP/1.1\r\n"
+                   "Host: localhost\r\n"
+                   "Range: bytes=10-19\r\n"
+                   "Connection: close\r\n"
+                   "\r\n",
+                   response, sizeof(response));
+
+    TEST(strstr(response, "HTTP/1.1 206") == response);
+    TEST(strstr(response, "Content-range: bytes 10-19/52\r\n") != NULL);
+    {
+        const char * const bodyP = strstr(response, "\r\n\r\n");
+
+        TEST(bodyP != NULL);
+        if (bodyP)
+            TEST(strcmp(bodyP + 4, "klmnopqrst") == 0);
+    }
+    stopServer(&server, chanSwitchP, serverThreadP);
+
+    TEST(remove(fileName) == 0);
+    TEST(rmdir(dirName) == 0);
+
+    strfree(fileName);
+}
+
+#endif
+
+
+
 void
 test_abyss(void) {
 
@@ -406,6 +911,20 @@ test_abyss(void) {
 
     testServerCreate();
 
+#ifndef _WIN32
+    testPipelining();
+
+    testSessionMemLimit();
+
+    testReadBodyStraddling();
+
+    testReadBodyEarlyEof();
+
+    testReadBodyChunked();
+
+    testFileRange();
+#endif
+
     ChannelTerm();
     ChanSwitchTerm();
     AbyssTerm();
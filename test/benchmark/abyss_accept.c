@@ -0,0 +1,215 @@
+/*============================================================================
+  Measure how many connections per second an Abyss XML-RPC server can
+  accept and serve, as the number of acceptors (threads that accept
+  connections, each from a listening socket of its own) grows.
+
+  For each acceptor count 1, 2, 4, ... up to MAXACCEPTORS, we run a server
+  and have CLIENTS client threads for SECONDS seconds each repeatedly
+  connect, call a method that does nothing, and disconnect.
+
+  Usage: abyss_accept [MAXACCEPTORS [CLIENTS [SECONDS [PIN [PORT]]]]]
+
+  PIN nonzero means have each acceptor run on a CPU of its own.
+============================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xmlrpc_config.h"
+
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/server.h"
+#include "xmlrpc-c/server_abyss.h"
+#include "xmlrpc-c/thread_int.h"
+
+#include "bench.h"
+
+#define MAX_CLIENTS 256
+
+struct client {
+    unsigned short port;
+    double         endTime;
+    unsigned long  callCt;
+    unsigned long  failureCt;
+};
+
+struct serverArgs {
+    xmlrpc_server_abyss_t * serverP;
+};
+
+
+
+static xmlrpc_value *
+nothing(xmlrpc_env *   const envP,
+        xmlrpc_value * const paramArrayP ATTR_UNUSED,
+        void *         const serverInfo ATTR_UNUSED,
+        void *         const channelInfo ATTR_UNUSED) {
+
+    return xmlrpc_int_new(envP, 0);
+}
+
+
+
+static void
+runServer(void * const arg) {
+
+    struct serverArgs * const argsP = arg;
+
+    xmlrpc_env env;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_run_server(&env, argsP->serverP);
+    benchDieIfFault(&env, "Running server");
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+runClient(void * const arg) {
+
+    struct client * const clientP = arg;
+
+    while (benchNow() < clientP->endTime) {
+        if (benchRawCall(clientP->port, "bench.nothing"))
+            ++clientP->callCt;
+        else
+            ++clientP->failureCt;
+    }
+}
+
+
+
+static void
+measure(xmlrpc_registry * const registryP,
+        unsigned int      const acceptorCt,
+        bool              const pin,
+        unsigned int      const clientCt,
+        unsigned int      const seconds,
+        unsigned short    const port) {
+
+    xmlrpc_env env;
+    xmlrpc_server_abyss_parms parms;
+    struct serverArgs serverArgs;
+    struct xmlrpc_thread * serverThreadP;
+    struct xmlrpc_thread * clientThreadP[MAX_CLIENTS];
+    struct client client[MAX_CLIENTS];
+    const char * error;
+    double start, elapsed;
+    unsigned long callCt, failureCt;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    memset(&parms, 0, sizeof(parms));
+    parms.registryP      = registryP;
+    parms.port_number    = port;
+    parms.max_conn       = 16;
+    parms.acceptor_count = acceptorCt;
+    parms.pin_acceptors  = pin;
+
+    xmlrpc_server_abyss_create(&env, &parms, XMLRPC_APSIZE(pin_acceptors),
+                               &serverArgs.serverP);
+    benchDieIfFault(&env, "Creating server");
+
+    xmlrpc_thread_create(&serverThreadP, &runServer, &serverArgs, &error);
+    if (error) {
+        fprintf(stderr, "Can't create server thread.  %s\n", error);
+        exit(1);
+    }
+    start = benchNow();
+
+    for (i = 0; i < clientCt; ++i) {
+        client[i].port      = port;
+        client[i].endTime   = start + seconds;
+        client[i].callCt    = 0;
+        client[i].failureCt = 0;
+
+        xmlrpc_thread_create(&clientThreadP[i], &runClient, &client[i],
+                             &error);
+        if (error) {
+            fprintf(stderr, "Can't create client thread.  %s\n", error);
+            exit(1);
+        }
+    }
+    for (i = 0, callCt = 0, failureCt = 0; i < clientCt; ++i) {
+        xmlrpc_thread_join(clientThreadP[i]);
+
+        callCt    += client[i].callCt;
+        failureCt += client[i].failureCt;
+    }
+    elapsed = benchNow() - start;
+
+    printf("%10u %14.1f %10lu\n", acceptorCt, callCt / elapsed, failureCt);
+
+    xmlrpc_server_abyss_terminate(&env, serverArgs.serverP);
+    benchDieIfFault(&env, "Terminating server");
+
+    xmlrpc_thread_join(serverThreadP);
+
+    xmlrpc_server_abyss_destroy(serverArgs.serverP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+int
+main(int const argc, const char ** const argv) {
+
+    unsigned long const maxAcceptorCt = benchArgUlong(argc, argv, 1, 4);
+    unsigned long const clientCt      = benchArgUlong(argc, argv, 2, 16);
+    unsigned long const seconds       = benchArgUlong(argc, argv, 3, 2);
+    unsigned long const pin           = benchArgUlong(argc, argv, 4, 0);
+    unsigned long const port          = benchArgUlong(argc, argv, 5, 8147);
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    unsigned int acceptorCt;
+    unsigned int round;
+
+    if (clientCt > MAX_CLIENTS) {
+        fprintf(stderr, "At most %u clients\n", MAX_CLIENTS);
+        exit(1);
+    }
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_global_init(&env);
+    benchDieIfFault(&env, "Global initialization");
+
+    registryP = xmlrpc_registry_new(&env);
+    benchDieIfFault(&env, "Creating registry");
+
+    {
+        struct xmlrpc_method_info3 methodInfo;
+
+        memset(&methodInfo, 0, sizeof(methodInfo));
+        methodInfo.methodName     = "bench.nothing";
+        methodInfo.methodFunction = &nothing;
+
+        xmlrpc_registry_add_method3(&env, registryP, &methodInfo);
+        benchDieIfFault(&env, "Registering method");
+    }
+    printf("%lu clients for %lu s each round%s\n",
+           clientCt, seconds, pin ? ", acceptors pinned to CPUs" : "");
+    printf("%10s %14s %10s\n", "acceptors", "connections/s", "failures");
+
+    /* We use a different port each round so connections in TIME_WAIT
+       from the previous round don't get in the way.
+    */
+    for (acceptorCt = 1, round = 0;
+         acceptorCt <= maxAcceptorCt;
+         acceptorCt *= 2, ++round)
+        measure(registryP, acceptorCt, !!pin, clientCt, seconds,
+                port + round);
+
+    xmlrpc_registry_free(registryP);
+    xmlrpc_server_abyss_global_term();
+
+    xmlrpc_env_clean(&env);
+
+    return 0;
+}
@@ -0,0 +1,329 @@
+/*============================================================================
+  Measure what it costs an Abyss request handler to get a request body, in
+  system calls and in bytes copied in user space, the old way and the new
+  way:
+
+    refill: take what's in the connection buffer with SessionGetReadData(),
+            append it to a growing buffer, and SessionRefillBuffer() for
+            more, as the Xmlrpc-c handler used to.
+
+    direct: allocate a buffer the size of the body and SessionReadBody()
+            into it, as the Xmlrpc-c handler does now.
+
+  For each body size 64 KiB, 1 MiB, ... up to MAXSIZE, a client POSTs
+  bodies of that size, one at a time on one keep-alive connection, for
+  SECONDS seconds with each way.  We count the server's recv() calls by
+  supplying our own recv(), which the Abyss library calls instead of the C
+  library's.
+
+  Usage: abyss_body [MAXSIZE_KIB [SECONDS [PORT]]]
+============================================================================*/
+
+#define _DEFAULT_SOURCE /* New name for SVID & BSD source defines */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "xmlrpc_config.h"
+
+#include "girmath.h"
+#include "xmlrpc-c/abyss.h"
+#include "xmlrpc-c/thread_int.h"
+
+#include "bench.h"
+
+static unsigned long recvCt;
+    /* Number of recv() calls, by anybody */
+
+static double bytesCopied;
+    /* Bytes the request handler has copied in user space */
+
+
+
+ssize_t
+recv(int    const fd,
+     void * const buf,
+     size_t const len,
+     int    const flags) {
+
+    ++recvCt;
+
+    return recvfrom(fd, buf, len, flags, NULL, NULL);
+}
+
+
+
+static void
+readBodyRefill(TSession * const sessionP,
+               size_t     const contentSize) {
+
+    char * body;
+    size_t allocated;
+    size_t bytesRead;
+    bool failed;
+
+    body      = NULL;
+    allocated = 0;
+
+    for (bytesRead = 0, failed = false;
+         bytesRead < contentSize && !failed; ) {
+        const char * chunk;
+        size_t chunkLen;
+
+        SessionGetReadData(sessionP, contentSize - bytesRead,
+                           &chunk, &chunkLen);
+
+        if (bytesRead + chunkLen > allocated) {
+            /* Growing the buffer moves what's in it */
+            bytesCopied += bytesRead;
+            allocated = (bytesRead + chunkLen) * 2;
+            body = realloc(body, allocated);
+        }
+        memcpy(&body[bytesRead], chunk, chunkLen);
+        bytesCopied += chunkLen;
+        bytesRead += chunkLen;
+
+        if (bytesRead < contentSize)
+            failed = !SessionRefillBuffer(sessionP);
+    }
+    free(body);
+}
+
+
+
+static void
+readBodyDirect(TSession * const sessionP,
+               size_t     const contentSize) {
+
+    char * const body = malloc(contentSize);
+
+    const char * error;
+
+    /* What is already in the connection buffer gets copied */
+    bytesCopied += MIN(SessionReadDataAvail(sessionP), contentSize);
+
+    SessionReadBody(sessionP, contentSize, body, &error);
+
+    if (error) {
+        fprintf(stderr, "SessionReadBody failed.  %s\n", error);
+        exit(1);
+    }
+    free(body);
+}
+
+
+
+static void
+handleReq(void *       const handler ATTR_UNUSED,
+          TSession *   const sessionP,
+          abyss_bool * const handledP) {
+
+    const TRequestInfo * requestInfoP;
+    const char * contentLength;
+
+    SessionGetRequestInfo(sessionP, &requestInfoP);
+
+    contentLength = RequestHeaderValue(sessionP, "content-length");
+
+    if (contentLength) {
+        size_t const contentSize = strtoul(contentLength, NULL, 10);
+
+        if (strcmp(requestInfoP->uri, "/direct") == 0)
+            readBodyDirect(sessionP, contentSize);
+        else
+            readBodyRefill(sessionP, contentSize);
+    }
+    ResponseStatus(sessionP, 200);
+    ResponseContentLength(sessionP, 0);
+    ResponseWriteStart(sessionP);
+    ResponseWriteEnd(sessionP);
+
+    *handledP = true;
+}
+
+
+
+static void
+runServer(void * const arg) {
+
+    TServer * const serverP = arg;
+
+    ServerRun(serverP);
+}
+
+
+
+static int
+connectToServer(unsigned short const port) {
+
+    int const fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Can't connect to server\n");
+        exit(1);
+    }
+    return fd;
+}
+
+
+
+static void
+post(int          const fd,
+     const char * const path,
+     const char * const body,
+     size_t       const bodySize) {
+/*----------------------------------------------------------------------------
+   POST 'body' to 'path' on the connection 'fd' and wait for the (empty)
+   response.
+-----------------------------------------------------------------------------*/
+    char header[256];
+    char response[1024];
+    size_t written;
+    ssize_t rc;
+
+    snprintf(header, sizeof(header),
+             "POST %s HTTP/1.1\r\n"
+             "Host: localhost\r\n"
+             "Content-Type: application/octet-stream\r\n"
+             "Content-Length: %lu\r\n"
+             "\r\n",
+             path, (unsigned long)bodySize);
+
+    if (write(fd, header, strlen(header)) != (ssize_t)strlen(header)) {
+        fprintf(stderr, "Failed to send request header\n");
+        exit(1);
+    }
+    for (written = 0; written < bodySize; written += rc) {
+        rc = write(fd, &body[written], bodySize - written);
+        if (rc <= 0) {
+            fprintf(stderr, "Failed to send request body\n");
+            exit(1);
+        }
+    }
+    /* The response has no body, so it arrives all at once */
+    rc = read(fd, response, sizeof(response));
+    if (rc <= 0) {
+        fprintf(stderr, "No response from server\n");
+        exit(1);
+    }
+}
+
+
+
+static void
+measure(unsigned short const port,
+        const char *   const path,
+        const char *   const body,
+        size_t         const bodySize,
+        unsigned int   const seconds) {
+
+    int const fd = connectToServer(port);
+
+    double start, elapsed, mib;
+    unsigned long postCt;
+
+    recvCt      = 0;
+    bytesCopied = 0;
+    start       = benchNow();
+
+    for (postCt = 0; benchNow() - start < seconds; ++postCt)
+        post(fd, path, body, bodySize);
+
+    elapsed = benchNow() - start;
+    mib     = (double)postCt * bodySize / (1024 * 1024);
+
+    close(fd);
+
+    printf("%10lu %8s %10.1f %12.1f %12.2f\n",
+           (unsigned long)bodySize / 1024, path + 1,
+           mib / elapsed, recvCt / mib, bytesCopied / (1024 * 1024) / mib);
+}
+
+
+
+int
+main(int const argc, const char ** const argv) {
+
+    unsigned long const maxSizeKib = benchArgUlong(argc, argv, 1, 16384);
+    unsigned long const seconds    = benchArgUlong(argc, argv, 2, 2);
+    unsigned long const port       = benchArgUlong(argc, argv, 3, 8149);
+
+    struct ServerReqHandler3 const handlerDesc = {
+        /* .term               = */ NULL,
+        /* .handleReq          = */ &handleReq,
+        /* .userdata           = */ NULL,
+        /* .handleReqStackSize = */ 0
+    };
+    TServer server;
+    struct xmlrpc_thread * serverThreadP;
+    const char * error;
+    abyss_bool success;
+    char * body;
+    unsigned long sizeKib;
+
+    AbyssInit(&error);
+    if (error) {
+        fprintf(stderr, "Can't initialize Abyss.  %s\n", error);
+        exit(1);
+    }
+    if (!ServerCreate(&server, "abyss_body", port, NULL, NULL)) {
+        fprintf(stderr, "Can't create server\n");
+        exit(1);
+    }
+    ServerSetKeepaliveMaxConn(&server, 1000000);
+
+    ServerAddHandler3(&server, &handlerDesc, &success);
+    if (!success) {
+        fprintf(stderr, "Can't add request handler\n");
+        exit(1);
+    }
+    ServerInit2(&server, &error);
+    if (error) {
+        fprintf(stderr, "Can't initialize server.  %s\n", error);
+        exit(1);
+    }
+    xmlrpc_thread_create(&serverThreadP, &runServer, &server, &error);
+    if (error) {
+        fprintf(stderr, "Can't create server thread.  %s\n", error);
+        exit(1);
+    }
+    body = malloc(maxSizeKib * 1024);
+    if (!body) {
+        fprintf(stderr, "Can't allocate %lu KiB for the body\n", maxSizeKib);
+        exit(1);
+    }
+    memset(body, 'x', maxSizeKib * 1024);
+
+    printf("%lu s each round\n", seconds);
+    printf("%10s %8s %10s %12s %12s\n",
+           "KiB", "way", "MiB/s", "recv/MiB", "copied/MiB");
+
+    for (sizeKib = 64; sizeKib <= maxSizeKib; sizeKib *= 16) {
+        measure(port, "/refill", body, sizeKib * 1024, seconds);
+        measure(port, "/direct", body, sizeKib * 1024, seconds);
+    }
+    free(body);
+
+    ServerTerminate(&server);
+
+    xmlrpc_thread_join(serverThreadP);
+
+    ServerFree(&server);
+
+    AbyssTerm();
+
+    return 0;
+}
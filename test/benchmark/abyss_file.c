@@ -0,0 +1,298 @@
+/*============================================================================
+  Measure how fast an Abyss server serves a static file, whole and as a
+  single byte range.
+
+  For each file size 64 KiB, 1 MiB, ... up to MAXSIZE, we write a file of
+  that size in a temporary directory, run an Abyss server with that
+  directory as its document root, and have CLIENTS client threads for
+  SECONDS seconds each repeatedly connect, GET the file, read the whole
+  response, and disconnect.  Then we do the same, but asking for the middle
+  half of the file with a Range header.
+
+  Usage: abyss_file [MAXSIZE_KIB [CLIENTS [SECONDS [PORT]]]]
+============================================================================*/
+
+#define _DEFAULT_SOURCE /* New name for SVID & BSD source defines */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "xmlrpc_config.h"
+
+#include "xmlrpc-c/abyss.h"
+#include "xmlrpc-c/thread_int.h"
+
+#include "bench.h"
+
+#define MAX_CLIENTS 256
+
+struct client {
+    unsigned short port;
+    unsigned long  fileSize;
+    bool           range;
+    double         endTime;
+    unsigned long  getCt;
+    double         byteCt;
+    unsigned long  failureCt;
+};
+
+
+
+static void
+runServer(void * const arg) {
+
+    TServer * const serverP = arg;
+
+    ServerRun(serverP);
+}
+
+
+
+static unsigned long
+get(unsigned short const port,
+    unsigned long  const fileSize,
+    bool           const range) {
+/*----------------------------------------------------------------------------
+   GET the benchmark file from the server at TCP port 'port' on this host.
+   If 'range', ask for only the middle half of it.
+
+   Return the number of body bytes we received; zero if we didn't get the
+   response we expected.
+-----------------------------------------------------------------------------*/
+    int const fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    unsigned long const first = range ? fileSize / 4 : 0;
+    unsigned long const last  = range ? fileSize / 4 * 3 - 1 : fileSize - 1;
+
+    struct sockaddr_in addr;
+    char request[256];
+    char rangeHeader[64];
+    char response[16384];
+    unsigned long responseLen;
+    unsigned long retval;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (range)
+        snprintf(rangeHeader, sizeof(rangeHeader),
+                 "Range: bytes=%lu-%lu\r\n", first, last);
+    else
+        rangeHeader[0] = '\0';
+
+    snprintf(request, sizeof(request),
+             "GET /bench.dat HTTP/1.1\r\n"
+             "Host: localhost\r\n"
+             "Connection: close\r\n"
+             "%s"
+             "\r\n",
+             rangeHeader);
+
+    responseLen = 0;
+
+    if (fd >= 0) {
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+            write(fd, request, strlen(request)) == (ssize_t)strlen(request)) {
+
+            /* The server closes the connection after the response.  We
+               don't look at the data; 'response' is just somewhere to put
+               it.
+            */
+            ssize_t rc;
+
+            do {
+                rc = read(fd, response, sizeof(response));
+                if (rc > 0)
+                    responseLen += rc;
+            } while (rc > 0);
+        }
+        close(fd);
+    }
+    /* The header is small next to the body, so this is close enough to
+       know we got the whole thing.
+    */
+    if (responseLen > last - first + 1)
+        retval = last - first + 1;
+    else
+        retval = 0;
+
+    return retval;
+}
+
+
+
+static void
+runClient(void * const arg) {
+
+    struct client * const clientP = arg;
+
+    while (benchNow() < clientP->endTime) {
+        unsigned long const bytesReceived =
+            get(clientP->port, clientP->fileSize, clientP->range);
+
+        if (bytesReceived > 0) {
+            ++clientP->getCt;
+            clientP->byteCt += bytesReceived;
+        } else
+            ++clientP->failureCt;
+    }
+}
+
+
+
+static void
+writeFile(const char *  const dirName,
+          unsigned long const size) {
+
+    char fileName[256];
+    FILE * fileP;
+    unsigned long i;
+
+    snprintf(fileName, sizeof(fileName), "%s/bench.dat", dirName);
+
+    fileP = fopen(fileName, "wb");
+    if (!fileP) {
+        fprintf(stderr, "Can't create file '%s'\n", fileName);
+        exit(1);
+    }
+    for (i = 0; i < size; ++i)
+        fputc('a' + i % 26, fileP);
+
+    fclose(fileP);
+}
+
+
+
+static void
+measure(const char *   const dirName,
+        unsigned long  const fileSize,
+        bool           const range,
+        unsigned int   const clientCt,
+        unsigned int   const seconds,
+        unsigned short const port) {
+
+    TServer server;
+    struct xmlrpc_thread * serverThreadP;
+    struct xmlrpc_thread * clientThreadP[MAX_CLIENTS];
+    struct client client[MAX_CLIENTS];
+    const char * error;
+    double start, elapsed;
+    unsigned long getCt, failureCt;
+    double byteCt;
+    unsigned int i;
+
+    if (!ServerCreate(&server, "abyss_file", port, dirName, NULL)) {
+        fprintf(stderr, "Can't create server\n");
+        exit(1);
+    }
+    ServerSetMaxConn(&server, 16);
+
+    ServerInit2(&server, &error);
+    if (error) {
+        fprintf(stderr, "Can't initialize server.  %s\n", error);
+        exit(1);
+    }
+    xmlrpc_thread_create(&serverThreadP, &runServer, &server, &error);
+    if (error) {
+        fprintf(stderr, "Can't create server thread.  %s\n", error);
+        exit(1);
+    }
+    start = benchNow();
+
+    for (i = 0; i < clientCt; ++i) {
+        client[i].port      = port;
+        client[i].fileSize  = fileSize;
+        client[i].range     = range;
+        client[i].endTime   = start + seconds;
+        client[i].getCt     = 0;
+        client[i].byteCt    = 0;
+        client[i].failureCt = 0;
+
+        xmlrpc_thread_create(&clientThreadP[i], &runClient, &client[i],
+                             &error);
+        if (error) {
+            fprintf(stderr, "Can't create client thread.  %s\n", error);
+            exit(1);
+        }
+    }
+    for (i = 0, getCt = 0, byteCt = 0, failureCt = 0; i < clientCt; ++i) {
+        xmlrpc_thread_join(clientThreadP[i]);
+
+        getCt     += client[i].getCt;
+        byteCt    += client[i].byteCt;
+        failureCt += client[i].failureCt;
+    }
+    elapsed = benchNow() - start;
+
+    printf("%10lu %6s %10.1f %10.1f %10lu\n",
+           fileSize / 1024, range ? "range" : "whole",
+           getCt / elapsed, byteCt / elapsed / (1024 * 1024), failureCt);
+
+    ServerTerminate(&server);
+
+    xmlrpc_thread_join(serverThreadP);
+
+    ServerFree(&server);
+}
+
+
+
+int
+main(int const argc, const char ** const argv) {
+
+    unsigned long const maxSizeKib = benchArgUlong(argc, argv, 1, 16384);
+    unsigned long const clientCt   = benchArgUlong(argc, argv, 2, 4);
+    unsigned long const seconds    = benchArgUlong(argc, argv, 3, 2);
+    unsigned long const port       = benchArgUlong(argc, argv, 4, 8148);
+
+    char dirName[] = "/tmp/abyss_file_XXXXXX";
+    const char * error;
+    unsigned long sizeKib;
+    unsigned int round;
+
+    if (clientCt > MAX_CLIENTS) {
+        fprintf(stderr, "At most %u clients\n", MAX_CLIENTS);
+        exit(1);
+    }
+    if (!mkdtemp(dirName)) {
+        fprintf(stderr, "Can't create a temporary directory\n");
+        exit(1);
+    }
+    AbyssInit(&error);
+    if (error) {
+        fprintf(stderr, "Can't initialize Abyss.  %s\n", error);
+        exit(1);
+    }
+    printf("%lu clients for %lu s each round\n", clientCt, seconds);
+    printf("%10s %6s %10s %10s %10s\n",
+           "KiB", "part", "GETs/s", "MiB/s", "failures");
+
+    /* We use a different port each round so connections in TIME_WAIT
+       from the previous round don't get in the way.
+    */
+    for (sizeKib = 64, round = 0; sizeKib <= maxSizeKib; sizeKib *= 16) {
+        writeFile(dirName, sizeKib * 1024);
+
+        measure(dirName, sizeKib * 1024, false, clientCt, seconds,
+                port + round++);
+        measure(dirName, sizeKib * 1024, true,  clientCt, seconds,
+                port + round++);
+    }
+    {
+        char fileName[256];
+        snprintf(fileName, sizeof(fileName), "%s/bench.dat", dirName);
+        unlink(fileName);
+        rmdir(dirName);
+    }
+    AbyssTerm();
+
+    return 0;
+}
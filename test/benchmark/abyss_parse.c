@@ -0,0 +1,285 @@
+/*============================================================================
+  Measure how fast an Abyss server parses HTTP request headers.
+
+  A client sends small GET requests on a keep-alive loopback connection,
+  DEPTH at a time in one write, so there are few system calls per request
+  and header parsing is a large share of the work.  The request
+  handler looks up a few header fields by name, as the Xmlrpc-c handler
+  does.  For each number of header fields 2, 8, 32, it does that for
+  SECONDS seconds and prints requests per second and the time per request
+  and per header field.
+
+  Usage: abyss_parse [SECONDS [DEPTH [PORT]]]
+============================================================================*/
+
+#define _DEFAULT_SOURCE /* New name for SVID & BSD source defines */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "xmlrpc_config.h"
+
+#include "xmlrpc-c/abyss.h"
+#include "xmlrpc-c/thread_int.h"
+
+#include "bench.h"
+
+#define MAX_DEPTH 256
+
+static char const responseBody[] = "\001";
+    /* A byte that never appears in a response header, so the client can
+       count responses by counting it.
+    */
+
+static const char * const fieldNames[] = {
+    /* Names of the filler fields we add to the realistic ones */
+    "Accept", "Accept-Language", "Cache-Control", "Pragma", "Origin",
+    "X-Forwarded-For", "X-Forwarded-Proto", "X-Request-Id", "X-Trace-Id",
+    "X-Client-Version", "Via", "DNT"
+};
+
+
+
+static void
+handleReq(void *       const handler ATTR_UNUSED,
+          TSession *   const sessionP,
+          abyss_bool * const handledP) {
+
+    /* The lookups Abyss and the Xmlrpc-c handler do for a typical call */
+    RequestHeaderValue(sessionP, "content-type");
+    RequestHeaderValue(sessionP, "content-length");
+    RequestHeaderValue(sessionP, "content-encoding");
+    RequestHeaderValue(sessionP, "accept-encoding");
+    RequestHeaderValue(sessionP, "authorization");
+    RequestHeaderValue(sessionP, "cookie");
+
+    ResponseStatus(sessionP, 200);
+    ResponseContentLength(sessionP, strlen(responseBody));
+    ResponseWriteStart(sessionP);
+    ResponseWriteBody(sessionP, responseBody, strlen(responseBody));
+    ResponseWriteEnd(sessionP);
+
+    *handledP = true;
+}
+
+
+
+static void
+runServer(void * const arg) {
+
+    TServer * const serverP = arg;
+
+    ServerRun(serverP);
+}
+
+
+
+static int
+connectToServer(unsigned short const port) {
+
+    int const fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Can't connect to server\n");
+        exit(1);
+    }
+    return fd;
+}
+
+
+
+static void
+buildRequest(unsigned int const fieldCt,
+             char *       const request,
+             size_t       const requestSize) {
+/*----------------------------------------------------------------------------
+   Build a GET request with 'fieldCt' header fields (at least 2).
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    snprintf(request, requestSize,
+             "GET /RPC2 HTTP/1.1\r\n"
+             "Host: localhost:8080\r\n"
+             "User-Agent: Xmlrpc-c/1.60 Curl/7.88\r\n");
+
+    for (i = 2; i < fieldCt; ++i) {
+        size_t const len = strlen(request);
+
+        unsigned int const nameCt =
+            sizeof(fieldNames)/sizeof(fieldNames[0]);
+
+        snprintf(&request[len], requestSize - len, "%s-%u: value %u\r\n",
+                 fieldNames[i % nameCt], i, i * 12345);
+    }
+    strncat(request, "\r\n", requestSize - strlen(request) - 1);
+}
+
+
+
+static void
+getBatch(int          const fd,
+         const char * const requests,
+         size_t       const requestsLen,
+         unsigned int const depth) {
+
+    char response[16384];
+    unsigned int responseCt;
+    size_t written;
+
+    for (written = 0; written < requestsLen; ) {
+        ssize_t const rc =
+            write(fd, &requests[written], requestsLen - written);
+        if (rc <= 0) {
+            fprintf(stderr, "Failed to send requests\n");
+            exit(1);
+        }
+        written += rc;
+    }
+    for (responseCt = 0; responseCt < depth; ) {
+        ssize_t const rc = read(fd, response, sizeof(response));
+
+        ssize_t i;
+
+        if (rc <= 0) {
+            fprintf(stderr, "Server closed the connection after %u of %u "
+                    "responses\n", responseCt, depth);
+            exit(1);
+        }
+        for (i = 0; i < rc; ++i) {
+            if (response[i] == responseBody[0])
+                ++responseCt;
+        }
+    }
+}
+
+
+
+static void
+measure(unsigned short const port,
+        unsigned int   const fieldCt,
+        unsigned int   const depth,
+        unsigned int   const seconds) {
+
+    int const fd = connectToServer(port);
+
+    char request[4096];
+    char * requests;
+    size_t requestsLen;
+    double start, elapsed, perReq;
+    unsigned long requestCt;
+    unsigned int i;
+
+    buildRequest(fieldCt, request, sizeof(request));
+
+    requestsLen = strlen(request) * depth;
+    requests = malloc(requestsLen + 1);
+    if (!requests) {
+        fprintf(stderr, "Can't allocate request buffer\n");
+        exit(1);
+    }
+    for (i = 0, requests[0] = '\0'; i < depth; ++i)
+        strcat(requests, request);
+
+    requestCt = 0;
+    start     = benchNow();
+
+    while (benchNow() - start < seconds) {
+        getBatch(fd, requests, requestsLen, depth);
+        requestCt += depth;
+    }
+    elapsed = benchNow() - start;
+
+    close(fd);
+    free(requests);
+
+    perReq = elapsed / requestCt * 1e9;
+
+    printf("%7u %8u %12.0f %10.0f %12.1f\n",
+           fieldCt, (unsigned)strlen(request),
+           requestCt / elapsed, perReq, perReq / fieldCt);
+}
+
+
+
+int
+main(int const argc, const char ** const argv) {
+
+    unsigned long const seconds = benchArgUlong(argc, argv, 1, 2);
+    unsigned long const depth   = benchArgUlong(argc, argv, 2, 64);
+    unsigned long const port    = benchArgUlong(argc, argv, 3, 8151);
+
+    struct ServerReqHandler3 const handlerDesc = {
+        /* .term               = */ NULL,
+        /* .handleReq          = */ &handleReq,
+        /* .userdata           = */ NULL,
+        /* .handleReqStackSize = */ 0
+    };
+    TServer server;
+    struct xmlrpc_thread * serverThreadP;
+    const char * error;
+    abyss_bool success;
+    unsigned int fieldCt;
+
+    if (depth < 1 || depth > MAX_DEPTH) {
+        fprintf(stderr, "DEPTH must be 1-%u\n", MAX_DEPTH);
+        exit(1);
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    AbyssInit(&error);
+    if (error) {
+        fprintf(stderr, "Can't initialize Abyss.  %s\n", error);
+        exit(1);
+    }
+    if (!ServerCreate(&server, "abyss_parse", port, NULL, NULL)) {
+        fprintf(stderr, "Can't create server\n");
+        exit(1);
+    }
+    ServerSetKeepaliveMaxConn(&server, 1000000000);
+
+    ServerAddHandler3(&server, &handlerDesc, &success);
+    if (!success) {
+        fprintf(stderr, "Can't add request handler\n");
+        exit(1);
+    }
+    ServerInit2(&server, &error);
+    if (error) {
+        fprintf(stderr, "Can't initialize server.  %s\n", error);
+        exit(1);
+    }
+    xmlrpc_thread_create(&serverThreadP, &runServer, &server, &error);
+    if (error) {
+        fprintf(stderr, "Can't create server thread.  %s\n", error);
+        exit(1);
+    }
+    printf("%lu s each round, %lu requests per write\n", seconds, depth);
+    printf("%7s %8s %12s %10s %12s\n",
+           "fields", "bytes", "requests/s", "ns/req", "ns/field");
+
+    for (fieldCt = 2; fieldCt <= 32; fieldCt *= 4)
+        measure(port, fieldCt, depth, seconds);
+
+    ServerTerminate(&server);
+
+    xmlrpc_thread_join(serverThreadP);
+
+    ServerFree(&server);
+
+    AbyssTerm();
+
+    return 0;
+}
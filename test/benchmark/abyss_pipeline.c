@@ -0,0 +1,235 @@
+/*============================================================================
+  Measure how an Abyss server handles a client that pipelines HTTP requests,
+  i.e. sends several on a keep-alive connection without waiting for the
+  responses.
+
+  For each pipeline depth 1, 4, 16, 64, a client sends that many small GET
+  requests in one write, then reads all the responses, repeatedly for
+  SECONDS seconds.  Depth 1 is an ordinary keep-alive client.  We count the
+  server's send() calls by supplying our own send(), which the Abyss library
+  calls instead of the C library's, to see how well the server coalesces
+  responses.
+
+  Usage: abyss_pipeline [SECONDS [PORT]]
+============================================================================*/
+
+#define _DEFAULT_SOURCE /* New name for SVID & BSD source defines */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "xmlrpc_config.h"
+
+#include "xmlrpc-c/abyss.h"
+#include "xmlrpc-c/thread_int.h"
+
+#include "bench.h"
+
+#define MAX_DEPTH 64
+
+static char const responseBody[] = "\001";
+    /* A byte that never appears in a response header, so the client can
+       count responses by counting it.
+    */
+
+static unsigned long sendCt;
+    /* Number of send() calls, by anybody */
+
+
+
+ssize_t
+send(int          const fd,
+     const void * const buf,
+     size_t       const len,
+     int          const flags) {
+
+    ++sendCt;
+
+    return sendto(fd, buf, len, flags, NULL, 0);
+}
+
+
+
+static void
+handleReq(void *       const handler ATTR_UNUSED,
+          TSession *   const sessionP,
+          abyss_bool * const handledP) {
+
+    ResponseStatus(sessionP, 200);
+    ResponseContentLength(sessionP, strlen(responseBody));
+    ResponseWriteStart(sessionP);
+    ResponseWriteBody(sessionP, responseBody, strlen(responseBody));
+    ResponseWriteEnd(sessionP);
+
+    *handledP = true;
+}
+
+
+
+static void
+runServer(void * const arg) {
+
+    TServer * const serverP = arg;
+
+    ServerRun(serverP);
+}
+
+
+
+static int
+connectToServer(unsigned short const port) {
+
+    int const fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Can't connect to server\n");
+        exit(1);
+    }
+    return fd;
+}
+
+
+
+static void
+getBatch(int          const fd,
+         const char * const requests,
+         unsigned int const depth) {
+/*----------------------------------------------------------------------------
+   Send 'depth' requests, which are 'requests', in one write and wait for
+   all the responses.
+-----------------------------------------------------------------------------*/
+    char response[16384];
+    unsigned int responseCt;
+
+    if (write(fd, requests, strlen(requests)) != (ssize_t)strlen(requests)) {
+        fprintf(stderr, "Failed to send requests\n");
+        exit(1);
+    }
+    for (responseCt = 0; responseCt < depth; ) {
+        ssize_t const rc = read(fd, response, sizeof(response));
+
+        ssize_t i;
+
+        if (rc <= 0) {
+            fprintf(stderr, "Server closed the connection after %u of %u "
+                    "responses\n", responseCt, depth);
+            exit(1);
+        }
+        for (i = 0; i < rc; ++i) {
+            if (response[i] == responseBody[0])
+                ++responseCt;
+        }
+    }
+}
+
+
+
+static void
+measure(unsigned short const port,
+        unsigned int   const depth,
+        unsigned int   const seconds) {
+
+    int const fd = connectToServer(port);
+
+    char requests[MAX_DEPTH * 64];
+    double start, elapsed;
+    unsigned long requestCt;
+    unsigned int i;
+
+    for (i = 0, requests[0] = '\0'; i < depth; ++i)
+        strcat(requests, "GET /x HTTP/1.1\r\nHost: localhost\r\n\r\n");
+
+    sendCt    = 0;
+    requestCt = 0;
+    start     = benchNow();
+
+    while (benchNow() - start < seconds) {
+        getBatch(fd, requests, depth);
+        requestCt += depth;
+    }
+    elapsed = benchNow() - start;
+
+    close(fd);
+
+    printf("%6u %12.0f %10.2f\n",
+           depth, requestCt / elapsed, (double)sendCt / requestCt);
+}
+
+
+
+int
+main(int const argc, const char ** const argv) {
+
+    unsigned long const seconds = benchArgUlong(argc, argv, 1, 2);
+    unsigned long const port    = benchArgUlong(argc, argv, 2, 8150);
+
+    struct ServerReqHandler3 const handlerDesc = {
+        /* .term               = */ NULL,
+        /* .handleReq          = */ &handleReq,
+        /* .userdata           = */ NULL,
+        /* .handleReqStackSize = */ 0
+    };
+    TServer server;
+    struct xmlrpc_thread * serverThreadP;
+    const char * error;
+    abyss_bool success;
+    unsigned int depth;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    AbyssInit(&error);
+    if (error) {
+        fprintf(stderr, "Can't initialize Abyss.  %s\n", error);
+        exit(1);
+    }
+    if (!ServerCreate(&server, "abyss_pipeline", port, NULL, NULL)) {
+        fprintf(stderr, "Can't create server\n");
+        exit(1);
+    }
+    ServerSetKeepaliveMaxConn(&server, 1000000000);
+
+    ServerAddHandler3(&server, &handlerDesc, &success);
+    if (!success) {
+        fprintf(stderr, "Can't add request handler\n");
+        exit(1);
+    }
+    ServerInit2(&server, &error);
+    if (error) {
+        fprintf(stderr, "Can't initialize server.  %s\n", error);
+        exit(1);
+    }
+    xmlrpc_thread_create(&serverThreadP, &runServer, &server, &error);
+    if (error) {
+        fprintf(stderr, "Can't create server thread.  %s\n", error);
+        exit(1);
+    }
+    printf("%lu s each round\n", seconds);
+    printf("%6s %12s %10s\n", "depth", "requests/s", "sends/req");
+
+    for (depth = 1; depth <= MAX_DEPTH; depth *= 4)
+        measure(port, depth, seconds);
+
+    ServerTerminate(&server);
+
+    xmlrpc_thread_join(serverThreadP);
+
+    ServerFree(&server);
+
+    AbyssTerm();
+
+    return 0;
+}
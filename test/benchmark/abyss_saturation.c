@@ -0,0 +1,211 @@
+/*============================================================================
+  Measure how long a client waits for an Abyss XML-RPC server to serve it
+  when the server is saturated, i.e. every connection slot (maxConn) is
+  busy and clients are waiting for one to free up.
+
+  Each of CLIENTS client threads repeatedly connects, does one XML-RPC call
+  of a method that takes METHODMS milliseconds, and disconnects.  The
+  server allows only MAXCONN connections at once.  We report the time from
+  connecting to having the response, compared to the method's own time.
+
+  Usage: abyss_saturation [CLIENTS [CALLS [MAXCONN [METHODMS [PORT]]]]]
+============================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xmlrpc_config.h"
+
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/server.h"
+#include "xmlrpc-c/server_abyss.h"
+#include "xmlrpc-c/sleep_int.h"
+#include "xmlrpc-c/thread_int.h"
+
+#include "bench.h"
+
+#define MAX_CLIENTS 256
+
+struct client {
+    unsigned short port;
+    unsigned int   callCt;
+    double         totalWait;
+    double         maxWait;
+    unsigned int   failureCt;
+};
+
+struct serverArgs {
+    xmlrpc_server_abyss_t * serverP;
+};
+
+
+
+static xmlrpc_value *
+work(xmlrpc_env *   const envP,
+     xmlrpc_value * const paramArrayP ATTR_UNUSED,
+     void *         const serverInfo,
+     void *         const channelInfo ATTR_UNUSED) {
+
+    unsigned int const * const methodMsP = serverInfo;
+
+    xmlrpc_millisecond_sleep(*methodMsP);
+
+    return xmlrpc_int_new(envP, 0);
+}
+
+
+
+static void
+runServer(void * const arg) {
+
+    struct serverArgs * const argsP = arg;
+
+    xmlrpc_env env;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_run_server(&env, argsP->serverP);
+    benchDieIfFault(&env, "Running server");
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+runClient(void * const arg) {
+
+    struct client * const clientP = arg;
+
+    unsigned int i;
+
+    for (i = 0; i < clientP->callCt; ++i) {
+        double const start = benchNow();
+
+        if (benchRawCall(clientP->port, "bench.work")) {
+            double const wait = benchNow() - start;
+
+            clientP->totalWait += wait;
+            if (wait > clientP->maxWait)
+                clientP->maxWait = wait;
+        } else
+            ++clientP->failureCt;
+    }
+}
+
+
+
+int
+main(int const argc, const char ** const argv) {
+
+    unsigned long const clientCt = benchArgUlong(argc, argv, 1, 16);
+    unsigned long const callCt   = benchArgUlong(argc, argv, 2, 10);
+    unsigned long const maxConn  = benchArgUlong(argc, argv, 3, 4);
+    unsigned long const methodMs = benchArgUlong(argc, argv, 4, 20);
+    unsigned long const port     = benchArgUlong(argc, argv, 5, 8137);
+
+    unsigned int const methodMsArg = methodMs;
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    xmlrpc_server_abyss_parms parms;
+    struct serverArgs serverArgs;
+    struct xmlrpc_thread * serverThreadP;
+    struct xmlrpc_thread * clientThreadP[MAX_CLIENTS];
+    struct client client[MAX_CLIENTS];
+    const char * error;
+    double start, elapsed, totalWait, maxWait;
+    unsigned int failureCt;
+    unsigned int i;
+
+    if (clientCt > MAX_CLIENTS) {
+        fprintf(stderr, "At most %u clients\n", MAX_CLIENTS);
+        exit(1);
+    }
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_global_init(&env);
+    benchDieIfFault(&env, "Global initialization");
+
+    registryP = xmlrpc_registry_new(&env);
+    benchDieIfFault(&env, "Creating registry");
+
+    {
+        struct xmlrpc_method_info3 methodInfo;
+
+        memset(&methodInfo, 0, sizeof(methodInfo));
+        methodInfo.methodName     = "bench.work";
+        methodInfo.methodFunction = &work;
+        methodInfo.serverInfo     = (void *)&methodMsArg;
+
+        xmlrpc_registry_add_method3(&env, registryP, &methodInfo);
+        benchDieIfFault(&env, "Registering method");
+    }
+    memset(&parms, 0, sizeof(parms));
+    parms.registryP   = registryP;
+    parms.port_number = port;
+    parms.max_conn    = maxConn;
+
+    xmlrpc_server_abyss_create(&env, &parms, XMLRPC_APSIZE(max_conn),
+                               &serverArgs.serverP);
+    benchDieIfFault(&env, "Creating server");
+
+    xmlrpc_thread_create(&serverThreadP, &runServer, &serverArgs, &error);
+    if (error) {
+        fprintf(stderr, "Can't create server thread.  %s\n", error);
+        exit(1);
+    }
+    printf("%lu clients x %lu calls, %lu-ms method, maxConn %lu\n",
+           clientCt, callCt, methodMs, maxConn);
+
+    start = benchNow();
+
+    for (i = 0; i < clientCt; ++i) {
+        client[i].port      = port;
+        client[i].callCt    = callCt;
+        client[i].totalWait = 0.0;
+        client[i].maxWait   = 0.0;
+        client[i].failureCt = 0;
+
+        xmlrpc_thread_create(&clientThreadP[i], &runClient, &client[i],
+                             &error);
+        if (error) {
+            fprintf(stderr, "Can't create client thread.  %s\n", error);
+            exit(1);
+        }
+    }
+    for (i = 0, totalWait = 0.0, maxWait = 0.0, failureCt = 0;
+         i < clientCt;
+         ++i) {
+        xmlrpc_thread_join(clientThreadP[i]);
+
+        totalWait += client[i].totalWait;
+        if (client[i].maxWait > maxWait)
+            maxWait = client[i].maxWait;
+        failureCt += client[i].failureCt;
+    }
+    elapsed = benchNow() - start;
+
+    printf("%12s %12s %12s %12s %10s\n",
+           "calls/s", "avg wait ms", "max wait ms", "ideal ms", "failures");
+    printf("%12.1f %12.1f %12.1f %12.1f %10u\n",
+           clientCt * callCt / elapsed,
+           totalWait / (clientCt * callCt - failureCt) * 1000.0,
+           maxWait * 1000.0,
+           (double)methodMs * clientCt / maxConn,
+           failureCt);
+
+    xmlrpc_server_abyss_terminate(&env, serverArgs.serverP);
+    benchDieIfFault(&env, "Terminating server");
+
+    xmlrpc_thread_join(serverThreadP);
+
+    xmlrpc_server_abyss_destroy(serverArgs.serverP);
+    xmlrpc_registry_free(registryP);
+    xmlrpc_server_abyss_global_term();
+
+    xmlrpc_env_clean(&env);
+
+    return 0;
+}
@@ -0,0 +1,302 @@
+/*============================================================================
+  Measure what load shedding (xmlrpc_server_abyss_parms.shed_target_ms)
+  does to the latency clients see from an overloaded Abyss XML-RPC server.
+
+  Each of CLIENTS client threads does CALLS XML-RPC calls, one connection
+  each, of a method that takes METHODMS milliseconds.  The server has only
+  MAXCONN threads, so connections queue for them.  A client the server
+  refuses with a 503 response waits METHODMS milliseconds and goes on to
+  its next call.
+
+  We do this once with a server that serves everything it accepts and once
+  with one that sheds load with a target of TARGETMS milliseconds, and for
+  each report the 50th and 99th percentile and maximum time from connecting
+  to having the response of the calls the server served, and how many it
+  refused.
+
+  Usage: abyss_shedding [CLIENTS [CALLS [MAXCONN [METHODMS [TARGETMS [PORT]]]]]]
+============================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xmlrpc_config.h"
+
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/server.h"
+#include "xmlrpc-c/server_abyss.h"
+#include "xmlrpc-c/sleep_int.h"
+#include "xmlrpc-c/thread_int.h"
+
+#include "bench.h"
+
+#define MAX_CLIENTS 256
+
+struct client {
+    unsigned short port;
+    unsigned int   callCt;
+    unsigned int   backoffMs;
+    double *       latency;
+        /* Times of the calls the server served; array of 'servedCt' */
+    unsigned int   servedCt;
+    unsigned int   refusedCt;
+    unsigned int   failureCt;
+};
+
+struct serverArgs {
+    xmlrpc_server_abyss_t * serverP;
+};
+
+
+
+static xmlrpc_value *
+work(xmlrpc_env *   const envP,
+     xmlrpc_value * const paramArrayP ATTR_UNUSED,
+     void *         const serverInfo,
+     void *         const channelInfo ATTR_UNUSED) {
+
+    unsigned int const * const methodMsP = serverInfo;
+
+    xmlrpc_millisecond_sleep(*methodMsP);
+
+    return xmlrpc_int_new(envP, 0);
+}
+
+
+
+static void
+runServer(void * const arg) {
+
+    struct serverArgs * const argsP = arg;
+
+    xmlrpc_env env;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_run_server(&env, argsP->serverP);
+    benchDieIfFault(&env, "Running server");
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+runClient(void * const arg) {
+
+    struct client * const clientP = arg;
+
+    unsigned int i;
+
+    for (i = 0; i < clientP->callCt; ++i) {
+        double const start = benchNow();
+
+        unsigned int status;
+
+        if (!benchRawCallStatus(clientP->port, "bench.work", &status))
+            ++clientP->failureCt;
+        else if (status == 503) {
+            ++clientP->refusedCt;
+            xmlrpc_millisecond_sleep(clientP->backoffMs);
+        } else if (status == 200)
+            clientP->latency[clientP->servedCt++] = benchNow() - start;
+        else
+            ++clientP->failureCt;
+    }
+}
+
+
+
+static int
+compareDouble(const void * const aP,
+              const void * const bP) {
+
+    double const a = *(const double *)aP;
+    double const b = *(const double *)bP;
+
+    return a < b ? -1 : a > b ? 1 : 0;
+}
+
+
+
+static void
+measure(xmlrpc_registry * const registryP,
+        unsigned int      const clientCt,
+        unsigned int      const callCt,
+        unsigned int      const maxConn,
+        unsigned int      const methodMs,
+        unsigned int      const targetMs,
+        unsigned short    const port) {
+/*----------------------------------------------------------------------------
+   Run the clients against a new server that sheds load with target
+   'targetMs' (zero means it doesn't) and print one line of results.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_server_abyss_parms parms;
+    struct serverArgs serverArgs;
+    struct xmlrpc_thread * serverThreadP;
+    struct xmlrpc_thread * clientThreadP[MAX_CLIENTS];
+    struct client client[MAX_CLIENTS];
+    double * latency;
+    const char * error;
+    unsigned int servedCt, refusedCt, failureCt;
+    double start, elapsed;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    /* We make room for every client in the server's queue, so that the
+       clients wait where the server can see how long they wait, not in
+       the OS's queue of connections the server hasn't accepted.
+    */
+    memset(&parms, 0, sizeof(parms));
+    parms.registryP        = registryP;
+    parms.port_number      = port;
+    parms.max_conn         = maxConn;
+    parms.max_conn_backlog = clientCt;
+    parms.conn_queue_depth = clientCt;
+    parms.shed_target_ms   = targetMs;
+
+    xmlrpc_server_abyss_create(&env, &parms, XMLRPC_APSIZE(shed_retry_after),
+                               &serverArgs.serverP);
+    benchDieIfFault(&env, "Creating server");
+
+    xmlrpc_thread_create(&serverThreadP, &runServer, &serverArgs, &error);
+    if (error) {
+        fprintf(stderr, "Can't create server thread.  %s\n", error);
+        exit(1);
+    }
+    start = benchNow();
+
+    for (i = 0; i < clientCt; ++i) {
+        client[i].port      = port;
+        client[i].callCt    = callCt;
+        client[i].backoffMs = methodMs;
+        client[i].latency   = malloc(callCt * sizeof(client[i].latency[0]));
+        client[i].servedCt  = 0;
+        client[i].refusedCt = 0;
+        client[i].failureCt = 0;
+
+        if (!client[i].latency) {
+            fprintf(stderr, "Can't allocate latency array\n");
+            exit(1);
+        }
+        xmlrpc_thread_create(&clientThreadP[i], &runClient, &client[i],
+                             &error);
+        if (error) {
+            fprintf(stderr, "Can't create client thread.  %s\n", error);
+            exit(1);
+        }
+    }
+    latency = malloc(clientCt * callCt * sizeof(latency[0]));
+    if (!latency) {
+        fprintf(stderr, "Can't allocate latency array\n");
+        exit(1);
+    }
+    for (i = 0, servedCt = 0, refusedCt = 0, failureCt = 0;
+         i < clientCt;
+         ++i) {
+        xmlrpc_thread_join(clientThreadP[i]);
+
+        memcpy(&latency[servedCt], client[i].latency,
+               client[i].servedCt * sizeof(latency[0]));
+        servedCt  += client[i].servedCt;
+        refusedCt += client[i].refusedCt;
+        failureCt += client[i].failureCt;
+
+        free(client[i].latency);
+    }
+    elapsed = benchNow() - start;
+
+    qsort(latency, servedCt, sizeof(latency[0]), &compareDouble);
+
+    if (targetMs > 0)
+        printf("%10u", targetMs);
+    else
+        printf("%10s", "none");
+
+    if (servedCt > 0)
+        printf(" %10.1f %10.1f %10.1f %10.1f",
+               servedCt / elapsed,
+               latency[servedCt / 2] * 1000.0,
+               latency[servedCt * 99 / 100] * 1000.0,
+               latency[servedCt - 1] * 1000.0);
+    else
+        printf(" %10s %10s %10s %10s", "-", "-", "-", "-");
+
+    printf(" %10u %10u\n", refusedCt, failureCt);
+
+    free(latency);
+
+    xmlrpc_server_abyss_terminate(&env, serverArgs.serverP);
+    benchDieIfFault(&env, "Terminating server");
+
+    xmlrpc_thread_join(serverThreadP);
+
+    xmlrpc_server_abyss_destroy(serverArgs.serverP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+int
+main(int const argc, const char ** const argv) {
+
+    unsigned long const clientCt = benchArgUlong(argc, argv, 1, 64);
+    unsigned long const callCt   = benchArgUlong(argc, argv, 2, 20);
+    unsigned long const maxConn  = benchArgUlong(argc, argv, 3, 4);
+    unsigned long const methodMs = benchArgUlong(argc, argv, 4, 10);
+    unsigned long const targetMs = benchArgUlong(argc, argv, 5, 5);
+    unsigned long const port     = benchArgUlong(argc, argv, 6, 8153);
+
+    unsigned int const methodMsArg = methodMs;
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+
+    if (clientCt > MAX_CLIENTS) {
+        fprintf(stderr, "At most %u clients\n", MAX_CLIENTS);
+        exit(1);
+    }
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_global_init(&env);
+    benchDieIfFault(&env, "Global initialization");
+
+    registryP = xmlrpc_registry_new(&env);
+    benchDieIfFault(&env, "Creating registry");
+
+    {
+        struct xmlrpc_method_info3 methodInfo;
+
+        memset(&methodInfo, 0, sizeof(methodInfo));
+        methodInfo.methodName     = "bench.work";
+        methodInfo.methodFunction = &work;
+        methodInfo.serverInfo     = (void *)&methodMsArg;
+
+        xmlrpc_registry_add_method3(&env, registryP, &methodInfo);
+        benchDieIfFault(&env, "Registering method");
+    }
+    printf("%lu clients x %lu calls, %lu-ms method, maxConn %lu\n",
+           clientCt, callCt, methodMs, maxConn);
+
+    printf("%10s %10s %10s %10s %10s %10s %10s\n",
+           "target ms", "served/s", "p50 ms", "p99 ms", "max ms",
+           "refused", "failures");
+
+    /* A separate port for each server, so the second doesn't have to wait
+       for the first's connections to leave TIME_WAIT.
+    */
+    measure(registryP, clientCt, callCt, maxConn, methodMs, 0, port);
+    measure(registryP, clientCt, callCt, maxConn, methodMs, targetMs,
+            port + 1);
+
+    xmlrpc_registry_free(registryP);
+    xmlrpc_server_abyss_global_term();
+
+    xmlrpc_env_clean(&env);
+
+    return 0;
+}
@@ -0,0 +1,340 @@
+/*============================================================================
+  Measure how fast an HTTPS Abyss server sets up connections, with and
+  without TLS session resumption.
+
+  A client makes connections one after another on loopback, each for one
+  small request, and offers to resume the session from the previous
+  connection.  It does that for SECONDS seconds in each of three setups of
+  the server: no resumption (every handshake is full), a server-side session
+  cache, and stateless session tickets.  For each it prints connections per
+  second and how many of the server's handshakes were full and resumed.
+
+  The server's certificate is a self-signed P-256 one we make at startup.
+
+  Usage: abyss_tls [SECONDS [PORT]]
+============================================================================*/
+
+#define _DEFAULT_SOURCE /* New name for SVID & BSD source defines */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <openssl/evp.h>
+
+#include "xmlrpc_config.h"
+
+#include "xmlrpc-c/abyss.h"
+#include "xmlrpc-c/abyss_openssl.h"
+#include "xmlrpc-c/thread_int.h"
+
+#include "bench.h"
+
+static char const request[] =
+    "GET /x HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+
+static char const responseBody[] = "\001";
+
+
+
+static void
+handleReq(void *       const handler ATTR_UNUSED,
+          TSession *   const sessionP,
+          abyss_bool * const handledP) {
+
+    ResponseStatus(sessionP, 200);
+    ResponseContentLength(sessionP, strlen(responseBody));
+    ResponseWriteStart(sessionP);
+    ResponseWriteBody(sessionP, responseBody, strlen(responseBody));
+    ResponseWriteEnd(sessionP);
+
+    *handledP = true;
+}
+
+
+
+static void
+runServer(void * const arg) {
+
+    TServer * const serverP = arg;
+
+    ServerRun(serverP);
+}
+
+
+
+static void
+die(const char * const message) {
+
+    fprintf(stderr, "%s\n", message);
+    exit(1);
+}
+
+
+
+static SSL_CTX *
+makeServerCtx(void) {
+/*----------------------------------------------------------------------------
+   An SSL context with a new self-signed certificate for "localhost".
+-----------------------------------------------------------------------------*/
+    SSL_CTX * const sslCtxP = SSL_CTX_new(TLS_server_method());
+    EVP_PKEY * const pkeyP = EVP_EC_gen("P-256");
+    X509 * const certP = X509_new();
+
+    X509_NAME * nameP;
+
+    if (!sslCtxP || !pkeyP || !certP)
+        die("Can't create SSL context, key, or certificate");
+
+    ASN1_INTEGER_set(X509_get_serialNumber(certP), 1);
+    X509_gmtime_adj(X509_getm_notBefore(certP), 0);
+    X509_gmtime_adj(X509_getm_notAfter(certP), 24 * 3600);
+    X509_set_pubkey(certP, pkeyP);
+
+    nameP = X509_get_subject_name(certP);
+    X509_NAME_add_entry_by_txt(nameP, "CN", MBSTRING_ASC,
+                               (const unsigned char *)"localhost", -1, -1, 0);
+    X509_set_issuer_name(certP, nameP);
+
+    if (!X509_sign(certP, pkeyP, EVP_sha256()))
+        die("Can't sign certificate");
+
+    if (SSL_CTX_use_certificate(sslCtxP, certP) != 1 ||
+        SSL_CTX_use_PrivateKey(sslCtxP, pkeyP) != 1)
+        die("Can't give certificate to SSL context");
+
+    X509_free(certP);
+    EVP_PKEY_free(pkeyP);
+
+    return sslCtxP;
+}
+
+
+
+static int
+connectToServer(unsigned short const port) {
+
+    int const fd = socket(AF_INET, SOCK_STREAM, 0);
+    int const one = 1;
+
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        die("Can't connect to server");
+
+    /* As HTTP clients such as Curl do.  Otherwise, the client's last
+       handshake message and the request can wait for a delayed ACK.
+    */
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    return fd;
+}
+
+
+
+static void
+doConnection(SSL_CTX *       const clientCtxP,
+             unsigned short  const port,
+             SSL_SESSION **  const sessionPP) {
+/*----------------------------------------------------------------------------
+   Connect, resuming session **sessionPP if it isn't NULL, get a response
+   to one request, and disconnect.  Return the session to resume next time
+   as *sessionPP.
+-----------------------------------------------------------------------------*/
+    int const fd = connectToServer(port);
+    SSL * const sslP = SSL_new(clientCtxP);
+
+    char response[1024];
+    int rc;
+
+    if (!sslP)
+        die("SSL_new() failed");
+
+    SSL_set_fd(sslP, fd);
+
+    if (*sessionPP)
+        SSL_set_session(sslP, *sessionPP);
+
+    if (SSL_connect(sslP) != 1)
+        die("TLS handshake failed");
+
+    if (SSL_write(sslP, request, strlen(request)) != (int)strlen(request))
+        die("Failed to send request");
+
+    /* The server closes the connection after the response.  By then we
+       have also received any session ticket, which comes after the
+       handshake in TLS 1.3.
+    */
+    do
+        rc = SSL_read(sslP, response, sizeof(response));
+    while (rc > 0);
+
+    if (*sessionPP)
+        SSL_SESSION_free(*sessionPP);
+    *sessionPP = SSL_get1_session(sslP);
+
+    SSL_shutdown(sslP);
+    SSL_free(sslP);
+    close(fd);
+}
+
+
+
+static void
+measure(const char *                              const label,
+        TChanSwitch *                             const chanSwitchP,
+        const struct abyss_openSsl_sessionparms * const parmsP,
+        unsigned short                            const port,
+        unsigned int                              const seconds) {
+
+    SSL_CTX * const clientCtxP = SSL_CTX_new(TLS_client_method());
+
+    SSL_SESSION * sessionP;
+    struct abyss_openSsl_stats before, after;
+    const char * error;
+    double start, elapsed;
+    unsigned long connCt;
+
+    if (!clientCtxP)
+        die("Can't create client SSL context");
+
+    ChanSwitchOpenSslSetSessionParms(chanSwitchP, parmsP, &error);
+    if (error) {
+        fprintf(stderr, "Can't set session parameters.  %s\n", error);
+        exit(1);
+    }
+    ChanSwitchOpenSslGetStats(chanSwitchP, &before);
+
+    sessionP = NULL;
+    connCt   = 0;
+    start    = benchNow();
+
+    while (benchNow() - start < seconds) {
+        doConnection(clientCtxP, port, &sessionP);
+        ++connCt;
+    }
+    elapsed = benchNow() - start;
+
+    /* The server may still be finishing the last connection */
+    sleep(1);
+
+    ChanSwitchOpenSslGetStats(chanSwitchP, &after);
+
+    printf("%-8s %10.0f %10lu %10lu\n", label, connCt / elapsed,
+           after.fullHandshakes    - before.fullHandshakes,
+           after.resumedHandshakes - before.resumedHandshakes);
+
+    if (sessionP)
+        SSL_SESSION_free(sessionP);
+    SSL_CTX_free(clientCtxP);
+}
+
+
+
+int
+main(int const argc, const char ** const argv) {
+
+    unsigned long const seconds = benchArgUlong(argc, argv, 1, 2);
+    unsigned long const port    = benchArgUlong(argc, argv, 2, 8152);
+
+    struct ServerReqHandler3 const handlerDesc = {
+        /* .term               = */ NULL,
+        /* .handleReq          = */ &handleReq,
+        /* .userdata           = */ NULL,
+        /* .handleReqStackSize = */ 0
+    };
+    struct abyss_openSsl_sessionparms parms;
+    SSL_CTX * sslCtxP;
+    TChanSwitch * chanSwitchP;
+    TServer server;
+    struct xmlrpc_thread * serverThreadP;
+    const char * error;
+    abyss_bool success;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    AbyssInit(&error);
+    if (error) {
+        fprintf(stderr, "Can't initialize Abyss.  %s\n", error);
+        exit(1);
+    }
+    sslCtxP = makeServerCtx();
+
+    ChanSwitchOpenSslCreateIpV4Port(port, sslCtxP, &chanSwitchP, &error);
+    if (error) {
+        fprintf(stderr, "Can't create channel switch.  %s\n", error);
+        exit(1);
+    }
+    ServerCreateSwitch(&server, chanSwitchP, &error);
+    if (error) {
+        fprintf(stderr, "Can't create server.  %s\n", error);
+        exit(1);
+    }
+    ServerAddHandler3(&server, &handlerDesc, &success);
+    if (!success)
+        die("Can't add request handler");
+
+    ServerInit2(&server, &error);
+    if (error) {
+        fprintf(stderr, "Can't initialize server.  %s\n", error);
+        exit(1);
+    }
+    xmlrpc_thread_create(&serverThreadP, &runServer, &server, &error);
+    if (error) {
+        fprintf(stderr, "Can't create server thread.  %s\n", error);
+        exit(1);
+    }
+    printf("%lu s each round\n", seconds);
+    printf("%-8s %10s %10s %10s\n", "resume", "conn/s", "full", "resumed");
+
+    memset(&parms, 0, sizeof(parms));
+
+    measure("none", chanSwitchP, &parms, port, seconds);
+
+    parms.cacheSize = 1024;
+    measure("cache", chanSwitchP, &parms, port, seconds);
+
+    parms.cacheSize = 0;
+    parms.tickets   = true;
+    measure("tickets", chanSwitchP, &parms, port, seconds);
+
+    ServerTerminate(&server);
+
+    /* The OpenSSL channel switch waits for a connection without noticing
+       the termination request, so give it one.
+    */
+    {
+        SSL_CTX * const clientCtxP = SSL_CTX_new(TLS_client_method());
+        SSL_SESSION * sessionP = NULL;
+
+        doConnection(clientCtxP, port, &sessionP);
+
+        SSL_SESSION_free(sessionP);
+        SSL_CTX_free(clientCtxP);
+    }
+    xmlrpc_thread_join(serverThreadP);
+
+    ServerFree(&server);
+
+    ChanSwitchDestroy(chanSwitchP);
+
+    SSL_CTX_free(sslCtxP);
+
+    AbyssTerm();
+
+    return 0;
+}
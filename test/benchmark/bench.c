@@ -0,0 +1,156 @@
+/*============================================================================
+  Facilities shared by the benchmark programs in this directory.
+============================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "xmlrpc_config.h"
+
+#include "bool.h"
+
+#include "xmlrpc-c/util.h"
+#include "xmlrpc-c/time_int.h"
+
+#include "bench.h"
+
+
+
+double
+benchNow(void) {
+/*----------------------------------------------------------------------------
+   The current time, in seconds since the epoch, with sub-second resolution.
+-----------------------------------------------------------------------------*/
+    xmlrpc_timespec now;
+
+    xmlrpc_gettimeofday(&now);
+
+    return now.tv_sec + now.tv_nsec / 1.0E9;
+}
+
+
+
+void
+benchDieIfFault(xmlrpc_env * const envP,
+                const char * const what) {
+
+    if (envP->fault_occurred) {
+        fprintf(stderr, "%s failed.  %s (%d)\n",
+                what, envP->fault_string, envP->fault_code);
+        exit(1);
+    }
+}
+
+
+
+unsigned long
+benchArgUlong(int           const argc,
+              const char ** const argv,
+              unsigned int  const argn,
+              unsigned long const defaultValue) {
+/*----------------------------------------------------------------------------
+   The value of positional command line argument 'argn' (1 is the first),
+   or 'defaultValue' if there isn't one.
+-----------------------------------------------------------------------------*/
+    if ((unsigned int)argc > argn)
+        return strtoul(argv[argn], NULL, 10);
+    else
+        return defaultValue;
+}
+
+
+
+bool
+benchRawCallStatus(unsigned short const port,
+                   const char *   const methodName,
+                   unsigned int * const statusP) {
+/*----------------------------------------------------------------------------
+   Connect to the XML-RPC server at TCP port 'port' on this host, call
+   method 'methodName' with no parameters, read the whole response, and
+   disconnect.  Return whether we got a response, and if so, its HTTP
+   status code as *statusP.
+
+   We talk to the socket directly so the client's own overhead doesn't
+   hide the server's.
+-----------------------------------------------------------------------------*/
+    int const fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    struct sockaddr_in addr;
+    char body[512];
+    char request[1024];
+    char response[4096];
+    bool gotResponse;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    snprintf(body, sizeof(body),
+             "<?xml version=\"1.0\"?>\r\n"
+             "<methodCall><methodName>%s</methodName>"
+             "<params></params></methodCall>\r\n",
+             methodName);
+
+    snprintf(request, sizeof(request),
+             "POST /RPC2 HTTP/1.1\r\n"
+             "Host: localhost\r\n"
+             "Connection: close\r\n"
+             "Content-Type: text/xml\r\n"
+             "Content-Length: %u\r\n"
+             "\r\n"
+             "%s",
+             (unsigned)strlen(body), body);
+
+    *statusP = 0;
+
+    if (fd < 0)
+        gotResponse = false;
+    else {
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+            gotResponse = false;
+        else if (write(fd, request, strlen(request)) !=
+                 (ssize_t)strlen(request))
+            gotResponse = false;
+        else {
+            /* The server closes the connection after the response */
+            size_t responseLen;
+            ssize_t rc;
+
+            responseLen = 0;
+            do {
+                rc = read(fd, response, sizeof(response) - 1);
+                if (rc > 0) {
+                    if (responseLen == 0) {
+                        /* The status line starts the first piece */
+                        response[rc] = '\0';
+                        sscanf(response, "HTTP/%*s %u", statusP);
+                    }
+                    responseLen += rc;
+                }
+            } while (rc > 0);
+
+            gotResponse = (responseLen > 0);
+        }
+        close(fd);
+    }
+    return gotResponse;
+}
+
+
+
+bool
+benchRawCall(unsigned short const port,
+             const char *   const methodName) {
+/*----------------------------------------------------------------------------
+   Same as benchRawCallStatus(), but don't tell the status.
+-----------------------------------------------------------------------------*/
+    unsigned int status;
+
+    return benchRawCallStatus(port, methodName, &status);
+}
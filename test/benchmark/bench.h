@@ -0,0 +1,33 @@
+#ifndef BENCH_H_INCLUDED
+#define BENCH_H_INCLUDED
+
+/*============================================================================
+  Facilities shared by the benchmark programs in this directory.
+============================================================================*/
+
+#include "bool.h"
+#include "xmlrpc-c/util.h"
+
+double
+benchNow(void);
+
+void
+benchDieIfFault(xmlrpc_env * const envP,
+                const char * const what);
+
+unsigned long
+benchArgUlong(int          const argc,
+              const char ** const argv,
+              unsigned int const argn,
+              unsigned long const defaultValue);
+
+bool
+benchRawCallStatus(unsigned short const port,
+                   const char *   const methodName,
+                   unsigned int * const statusP);
+
+bool
+benchRawCall(unsigned short const port,
+             const char *   const methodName);
+
+#endif
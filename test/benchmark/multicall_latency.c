@@ -0,0 +1,178 @@
+/*============================================================================
+  Measure how long a system.multicall takes, with its calls executing one
+  at a time and in parallel.
+
+  The multicall has 100 calls of a method that takes 1 millisecond, as one
+  waiting for a database or another server would.  For SECONDS seconds in
+  each of three setups of the registry -- no parallel multicall, and 8 and
+  32 worker threads -- it passes the registry such multicalls one after
+  another and prints the time per multicall.
+
+  Usage: multicall_latency [SECONDS]
+============================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "xmlrpc_config.h"
+
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/server.h"
+#include "xmlrpc-c/sleep_int.h"
+
+#include "bench.h"
+
+#define CALL_CT 100
+
+
+
+static xmlrpc_value *
+waitingMethod(xmlrpc_env *   const envP,
+              xmlrpc_value * const paramArrayP ATTR_UNUSED,
+              void *         const serverInfo ATTR_UNUSED,
+              void *         const callInfo ATTR_UNUSED) {
+
+    xmlrpc_millisecond_sleep(1);
+
+    return xmlrpc_nil_new(envP);
+}
+
+
+
+static xmlrpc_mem_block *
+multicallXml(void) {
+
+    xmlrpc_env env;
+    xmlrpc_value * callsP;
+    xmlrpc_value * paramsP;
+    xmlrpc_mem_block * xmlP;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    callsP = xmlrpc_array_new(&env);
+    benchDieIfFault(&env, "create call array");
+
+    for (i = 0; i < CALL_CT; ++i) {
+        xmlrpc_value * const callP =
+            xmlrpc_build_value(&env, "{s:s,s:()}",
+                               "methodName", "db.lookup", "params");
+        benchDieIfFault(&env, "build call");
+
+        xmlrpc_array_append_item(&env, callsP, callP);
+        benchDieIfFault(&env, "add call");
+
+        xmlrpc_DECREF(callP);
+    }
+    paramsP = xmlrpc_build_value(&env, "(A)", callsP);
+    benchDieIfFault(&env, "build multicall parameters");
+
+    xmlP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    benchDieIfFault(&env, "create memory block");
+
+    xmlrpc_serialize_call(&env, xmlP, "system.multicall", paramsP);
+    benchDieIfFault(&env, "serialize multicall");
+
+    xmlrpc_DECREF(paramsP);
+    xmlrpc_DECREF(callsP);
+
+    xmlrpc_env_clean(&env);
+
+    return xmlP;
+}
+
+
+
+static void
+measure(unsigned int       const threadCt,
+        xmlrpc_mem_block * const callP,
+        unsigned int       const seconds) {
+/*----------------------------------------------------------------------------
+   Measure with 'threadCt' worker threads; zero means no parallel multicall.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct xmlrpc_method_info4 methodInfo;
+    double start, elapsed;
+    unsigned long multicallCt;
+
+    xmlrpc_env_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    benchDieIfFault(&env, "create registry");
+
+    methodInfo.methodName      = "db.lookup";
+    methodInfo.methodFunction  = &waitingMethod;
+    methodInfo.serverInfo      = NULL;
+    methodInfo.stackSize       = 0;
+    methodInfo.signatureString = "?";
+    methodInfo.help            = NULL;
+    methodInfo.cacheTtl        = 0;
+    methodInfo.cacheMaxEntries = 0;
+    methodInfo.singleFlight    = false;
+    methodInfo.parallelSafe    = true;
+
+    xmlrpc_registry_add_method4(&env, registryP, &methodInfo,
+                                XMLRPC_MI4SIZE(parallelSafe));
+    benchDieIfFault(&env, "register method");
+
+    if (threadCt > 0) {
+        struct xmlrpc_multicall_parms parms;
+
+        parms.threads    = threadCt;
+        parms.max_fanout = 0;
+
+        xmlrpc_registry_set_multicall_parallel(&env, registryP, &parms,
+                                               XMLRPC_MCPSIZE(max_fanout));
+        benchDieIfFault(&env, "set up parallel multicall");
+    }
+    multicallCt = 0;
+    start       = benchNow();
+
+    while (benchNow() - start < seconds) {
+        xmlrpc_mem_block * responseP;
+
+        xmlrpc_registry_process_call2(&env, registryP,
+                                      XMLRPC_MEMBLOCK_CONTENTS(char, callP),
+                                      XMLRPC_MEMBLOCK_SIZE(char, callP),
+                                      NULL, &responseP);
+        benchDieIfFault(&env, "process multicall");
+
+        XMLRPC_MEMBLOCK_FREE(char, responseP);
+
+        ++multicallCt;
+    }
+    elapsed = benchNow() - start;
+
+    printf("%8u %12.2f\n", threadCt, elapsed / multicallCt * 1e3);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+int
+main(int const argc, const char ** const argv) {
+
+    unsigned long const seconds = benchArgUlong(argc, argv, 1, 2);
+
+    static unsigned int const threadCt[] = {0, 8, 32};
+
+    xmlrpc_mem_block * callP;
+    unsigned int i;
+
+    callP = multicallXml();
+
+    printf("%lu s each round, %u calls of 1 ms per multicall\n",
+           seconds, CALL_CT);
+    printf("%8s %12s\n", "threads", "ms/multicall");
+
+    for (i = 0; i < sizeof(threadCt)/sizeof(threadCt[0]); ++i)
+        measure(threadCt[i], callP, seconds);
+
+    XMLRPC_MEMBLOCK_FREE(char, callP);
+
+    return 0;
+}
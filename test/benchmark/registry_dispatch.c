@@ -0,0 +1,156 @@
+/*============================================================================
+  Measure how the time to dispatch an XML-RPC call depends on how many
+  methods the registry has.
+
+  For each registry size 10, 100, 800, 3200, it registers that many
+  trivial methods with names like those of a real service, then for
+  SECONDS seconds passes the registry calls of those methods, cycling
+  through all of them, and prints calls per second and the time per call.
+  The time includes parsing the call and serializing the response, which
+  don't depend on the registry size.
+
+  Usage: registry_dispatch [SECONDS]
+============================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xmlrpc_config.h"
+
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/server.h"
+
+#include "bench.h"
+
+
+
+static xmlrpc_value *
+nullMethod(xmlrpc_env *   const envP,
+           xmlrpc_value * const paramArrayP ATTR_UNUSED,
+           void *         const serverInfo ATTR_UNUSED,
+           void *         const callInfo ATTR_UNUSED) {
+
+    return xmlrpc_nil_new(envP);
+}
+
+
+
+static const char *
+methodName(unsigned int const n) {
+/*----------------------------------------------------------------------------
+   Name of the nth method, in newly malloc'ed storage.  Names share long
+   prefixes, as in a real service.
+-----------------------------------------------------------------------------*/
+    char * const name = malloc(64);
+
+    if (!name) {
+        fprintf(stderr, "Can't allocate method name\n");
+        exit(1);
+    }
+    snprintf(name, 64, "inventory.warehouse%u.item%u.getQuantity",
+             n / 20, n % 20);
+
+    return name;
+}
+
+
+
+static void
+measure(unsigned int const methodCt,
+        unsigned int const seconds) {
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    char ** calls;
+    size_t * callLens;
+    double start, elapsed;
+    unsigned long callCt;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    benchDieIfFault(&env, "create registry");
+
+    calls    = malloc(methodCt * sizeof(calls[0]));
+    callLens = malloc(methodCt * sizeof(callLens[0]));
+
+    if (!calls || !callLens) {
+        fprintf(stderr, "Can't allocate calls\n");
+        exit(1);
+    }
+    for (i = 0; i < methodCt; ++i) {
+        const char * const name = methodName(i);
+
+        xmlrpc_registry_add_method2(&env, registryP, name, &nullMethod,
+                                    NULL, NULL, NULL);
+        benchDieIfFault(&env, "register method");
+
+        calls[i] = malloc(256);
+        if (!calls[i]) {
+            fprintf(stderr, "Can't allocate call\n");
+            exit(1);
+        }
+        snprintf(calls[i], 256,
+                 "<?xml version=\"1.0\"?>\r\n"
+                 "<methodCall><methodName>%s</methodName>"
+                 "<params/></methodCall>\r\n", name);
+        callLens[i] = strlen(calls[i]);
+
+        free((void *)name);
+    }
+
+    callCt = 0;
+    start  = benchNow();
+
+    while (benchNow() - start < seconds) {
+        unsigned int j;
+
+        for (j = 0; j < 1000; ++j) {
+            unsigned int const n = callCt++ % methodCt;
+
+            xmlrpc_mem_block * responseP;
+
+            xmlrpc_registry_process_call2(&env, registryP,
+                                          calls[n], callLens[n],
+                                          NULL, &responseP);
+            benchDieIfFault(&env, "process call");
+
+            xmlrpc_mem_block_free(responseP);
+        }
+    }
+    elapsed = benchNow() - start;
+
+    printf("%8u %12.0f %10.0f\n",
+           methodCt, callCt / elapsed, elapsed / callCt * 1e9);
+
+    for (i = 0; i < methodCt; ++i)
+        free(calls[i]);
+    free(callLens);
+    free(calls);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+int
+main(int const argc, const char ** const argv) {
+
+    unsigned long const seconds = benchArgUlong(argc, argv, 1, 2);
+
+    static unsigned int const methodCt[] = {10, 100, 800, 3200};
+
+    unsigned int i;
+
+    printf("%lu s each round\n", seconds);
+    printf("%8s %12s %10s\n", "methods", "calls/s", "ns/call");
+
+    for (i = 0; i < sizeof(methodCt)/sizeof(methodCt[0]); ++i)
+        measure(methodCt[i], seconds);
+
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*============================================================================
+  Measure how serialization of one very large array scales with the number
+  of threads the serializer may use (XMLRPC_SERIALIZE_THREADS_LIMIT_ID).
+
+  Usage: serialize_array [ITEMCOUNT [REPETITIONS]]
+============================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "xmlrpc_config.h"
+
+#include "xmlrpc-c/base.h"
+
+#include "bench.h"
+
+
+
+static xmlrpc_value *
+bigArray(xmlrpc_env * const envP,
+         unsigned int const itemCt) {
+/*----------------------------------------------------------------------------
+   An array of 'itemCt' small structs, typical of a large query result.
+-----------------------------------------------------------------------------*/
+    xmlrpc_value * const arrayP = xmlrpc_array_new(envP);
+
+    unsigned int i;
+
+    for (i = 0; i < itemCt && !envP->fault_occurred; ++i) {
+        xmlrpc_value * const itemP =
+            xmlrpc_build_value(envP, "{s:i,s:s,s:d,s:b}",
+                               "id", (xmlrpc_int32)i,
+                               "name", "some <escaped> & unescaped text",
+                               "score", i / 7.0,
+                               "active", (xmlrpc_bool)(i % 2));
+        if (!envP->fault_occurred) {
+            xmlrpc_array_append_item(envP, arrayP, itemP);
+            xmlrpc_DECREF(itemP);
+        }
+    }
+    return arrayP;
+}
+
+
+
+static double
+timeSerialization(xmlrpc_value * const arrayP,
+                  unsigned int   const repetitions,
+                  size_t *       const xmlSizeP) {
+
+    double const start = benchNow();
+
+    unsigned int i;
+
+    for (i = 0; i < repetitions; ++i) {
+        xmlrpc_env env;
+        xmlrpc_mem_block * outputP;
+
+        xmlrpc_env_init(&env);
+
+        outputP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+        benchDieIfFault(&env, "Creating output buffer");
+        xmlrpc_serialize_response(&env, outputP, arrayP);
+        benchDieIfFault(&env, "Serializing");
+
+        *xmlSizeP = XMLRPC_MEMBLOCK_SIZE(char, outputP);
+
+        XMLRPC_MEMBLOCK_FREE(char, outputP);
+        xmlrpc_env_clean(&env);
+    }
+    return (benchNow() - start) / repetitions;
+}
+
+
+
+int
+main(int const argc, const char ** const argv) {
+
+    unsigned long const itemCt      = benchArgUlong(argc, argv, 1, 1000000);
+    unsigned long const repetitions = benchArgUlong(argc, argv, 2, 3);
+
+    xmlrpc_env env;
+    xmlrpc_value * arrayP;
+    double serialTime;
+    unsigned int threadCt;
+
+    xmlrpc_env_init(&env);
+
+    arrayP = bigArray(&env, itemCt);
+    benchDieIfFault(&env, "Building array");
+
+    xmlrpc_limit_set(XMLRPC_SERIALIZE_PARALLEL_MIN_LIMIT_ID, 2);
+
+    printf("%lu-item array, average of %lu runs\n", itemCt, repetitions);
+    printf("%8s %12s %10s %10s %8s\n",
+           "threads", "XML bytes", "seconds", "MB/s", "speedup");
+
+    for (threadCt = 1, serialTime = 0.0; threadCt <= 16; threadCt *= 2) {
+        size_t xmlSize;
+        double secs;
+
+        xmlrpc_limit_set(XMLRPC_SERIALIZE_THREADS_LIMIT_ID, threadCt);
+
+        secs = timeSerialization(arrayP, repetitions, &xmlSize);
+
+        if (threadCt == 1)
+            serialTime = secs;
+
+        printf("%8u %12lu %10.4f %10.1f %8.2f\n",
+               threadCt, (unsigned long)xmlSize, secs,
+               xmlSize / secs / 1.0E6, serialTime / secs);
+    }
+    xmlrpc_DECREF(arrayP);
+    xmlrpc_env_clean(&env);
+
+    return 0;
+}
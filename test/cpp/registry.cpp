@@ -477,6 +477,74 @@ public:
 
 
 
+class sampleAddAsyncMethod : public asyncMethod {
+public:
+    sampleAddAsyncMethod() {
+        this->_signature = "i:ii";
+        this->_help = "This method adds two integers together";
+    }
+    void
+    execute(xmlrpc_c::paramList        const& paramList,
+            const xmlrpc_c::callInfo * const,
+            xmlrpc_c::completion       const  completion) {
+
+        int const addend(paramList.getInt(0));
+        int const adder(paramList.getInt(1));
+
+        paramList.verifyEnd(2);
+
+        completion.complete(value_int(addend + adder));
+    }
+};
+
+
+
+class concurrencyLimitTestSuite : public testSuite {
+
+public:
+    virtual string suiteName() {
+        return "concurrencyLimitTestSuite";
+    }
+    virtual void runtests(unsigned int const) {
+
+        registry myRegistry;
+
+        myRegistry.addMethod("sample.add", methodPtr(new sampleAddMethod),
+                             concurrencyLimit(2, 1));
+        myRegistry.addMethod("echo", methodPtr(new echoMethod));
+
+        {
+            string response;
+            myRegistry.processCall(sampleAddGoodCallXml, &response);
+            TEST(response == sampleAddGoodResponseXml);
+        }
+        struct xmlrpc_method_load_stats const stats(
+            myRegistry.methodLoadStats("sample.add"));
+
+        TEST(stats.inFlight == 0);
+        TEST(stats.queued == 0);
+        TEST(stats.rejected == 0);
+
+        EXPECT_ERROR(  // no limit
+            myRegistry.methodLoadStats("echo");
+            );
+
+        registry asyncRegistry;
+
+        asyncRegistry.addMethod("sample.add",
+                                methodPtr(new sampleAddAsyncMethod),
+                                concurrencyLimit(1));
+        {
+            string response;
+            asyncRegistry.processCall(sampleAddGoodCallXml, &response);
+            TEST(response == sampleAddGoodResponseXml);
+        }
+        TEST(asyncRegistry.methodLoadStats("sample.add").inFlight == 0);
+    }
+};
+
+
+
 class testShutdown : public xmlrpc_c::registry::shutdown {
 /*----------------------------------------------------------------------------
    This class is logically local to
@@ -545,6 +613,8 @@ registryTestSuite::runtests(unsigned int const indentation) {
 
     registryShutdownTestSuite().run(indentation+1);
 
+    concurrencyLimitTestSuite().run(indentation+1);
+
     TEST(myRegistry.maxStackSize() >= 256);
 
 }
@@ -328,6 +328,13 @@ public:
                                     .logFileName("/tmp/logfile")
                                     .serverOwnsSignals(false)
                                     .expectSigchld(true)
+                                    .eventDriven(true)
+                                    .connQueueDepth(20)
+                                    .acceptorCount(4)
+                                    .pinAcceptors(true)
+                                    .preforkMinWorkers(2)
+                                    .preforkMaxWorkers(8)
+                                    .preforkMaxRequests(1000)
                 );
     
         }
@@ -359,6 +366,9 @@ public:
 
         TEST(callInfoP->serverAbyssP != NULL);
         TEST(callInfoP->abyssSessionP != NULL);
+        TEST(!callInfoP->canceled());
+        unsigned int msLeft;
+        TEST(!callInfoP->timeLeft(&msLeft));
         
         *retvalP = value_nil();
     }
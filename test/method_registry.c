@@ -1,12 +1,17 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "bool.h"
 #include "int.h"
 #include "casprintf.h"
 #include "girstring.h"
 
 #include "xmlrpc_config.h"
 
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/thread_int.h"
+#include "xmlrpc-c/sleep_int.h"
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
 
@@ -1050,6 +1055,1566 @@ test_apache_dialect(void) {
 
 
 
+static xmlrpc_value *
+test_counted(xmlrpc_env *   const envP,
+             xmlrpc_value * const paramArrayP,
+             void *         const serverInfo,
+             void *         const callInfo ATTR_UNUSED) {
+/*----------------------------------------------------------------------------
+   A method that returns its first parameter and counts how many times it
+   has executed, in the unsigned int at 'serverInfo'.  A negative parameter
+   makes it fail.
+-----------------------------------------------------------------------------*/
+    unsigned int * const callCountP = serverInfo;
+
+    xmlrpc_int32 x;
+
+    ++*callCountP;
+
+    xmlrpc_decompose_value(envP, paramArrayP, "(i)", &x);
+
+    if (envP->fault_occurred)
+        return NULL;
+    else if (x < 0) {
+        xmlrpc_env_set_fault(envP, 42, "negative");
+        return NULL;
+    } else
+        return xmlrpc_int_new(envP, x);
+}
+
+
+
+static void
+test_method_cache(void) {
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct xmlrpc_method_info4 methodInfo;
+    struct xmlrpc_method_cache_stats stats;
+    xmlrpc_value * argArrayP;
+    xmlrpc_value * resultP;
+    xmlrpc_int32 result;
+    unsigned int callCount;
+
+    xmlrpc_env_init(&env);
+
+    printf("  Running method cache tests.");
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    callCount = 0;
+
+    methodInfo.methodName      = "test.counted";
+    methodInfo.methodFunction  = &test_counted;
+    methodInfo.serverInfo      = &callCount;
+    methodInfo.stackSize       = 0;
+    methodInfo.signatureString = "i:i";
+    methodInfo.help            = NULL;
+    methodInfo.cacheTtl        = 60 * 1000;
+    methodInfo.cacheMaxEntries = 1;
+
+    xmlrpc_registry_add_method4(&env, registryP, &methodInfo,
+                                XMLRPC_MI4SIZE(help) - 1);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+
+    xmlrpc_registry_add_method4(&env, registryP, &methodInfo,
+                                XMLRPC_MI4SIZE(cacheMaxEntries));
+    TEST_NO_FAULT(&env);
+
+    /* First call executes; second identical call comes from the cache */
+    argArrayP = xmlrpc_build_value(&env, "(i)", 5);
+    doRpc(&env, registryP, "test.counted", argArrayP, FOO_CALLINFO, &resultP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_DECREF(resultP);
+    doRpc(&env, registryP, "test.counted", argArrayP, FOO_CALLINFO, &resultP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_read_int(&env, resultP, &result);
+    TEST_NO_FAULT(&env);
+    TEST(result == 5);
+    TEST(callCount == 1);
+    xmlrpc_DECREF(resultP);
+    xmlrpc_DECREF(argArrayP);
+
+    /* Different parameters execute, and evict the first entry */
+    argArrayP = xmlrpc_build_value(&env, "(i)", 6);
+    doRpc(&env, registryP, "test.counted", argArrayP, FOO_CALLINFO, &resultP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_DECREF(resultP);
+    xmlrpc_DECREF(argArrayP);
+    TEST(callCount == 2);
+
+    /* Faults aren't cached */
+    argArrayP = xmlrpc_build_value(&env, "(i)", -1);
+    doRpc(&env, registryP, "test.counted", argArrayP, FOO_CALLINFO, &resultP);
+    TEST_FAULT(&env, 42);
+    doRpc(&env, registryP, "test.counted", argArrayP, FOO_CALLINFO, &resultP);
+    TEST_FAULT(&env, 42);
+    xmlrpc_DECREF(argArrayP);
+    TEST(callCount == 4);
+
+    xmlrpc_registry_get_method_cache_stats(&env, registryP, "test.counted",
+                                           &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.hits == 1);
+    TEST(stats.misses == 4);
+    TEST(stats.entries == 1);
+    TEST(stats.evictions == 1);
+
+    xmlrpc_registry_get_method_cache_stats(&env, registryP, "nosuchmethod",
+                                           &stats);
+    TEST_FAULT(&env, XMLRPC_NO_SUCH_METHOD_ERROR);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+static xmlrpc_value *
+test_slow(xmlrpc_env *   const envP,
+          xmlrpc_value * const paramArrayP,
+          void *         const serverInfo,
+          void *         const callInfo ATTR_UNUSED) {
+/*----------------------------------------------------------------------------
+   A method that takes a while, returns its first parameter, and counts how
+   many times it has executed, in the unsigned int at 'serverInfo'.
+-----------------------------------------------------------------------------*/
+    unsigned int * const callCountP = serverInfo;
+
+    xmlrpc_int32 x;
+
+    xmlrpc_decompose_value(envP, paramArrayP, "(i)", &x);
+
+    if (envP->fault_occurred)
+        return NULL;
+    else {
+        xmlrpc_millisecond_sleep(500);
+
+        ++*callCountP;
+
+        return xmlrpc_int_new(envP, x);
+    }
+}
+
+
+
+struct callerCtx {
+    xmlrpc_registry *  registryP;
+    xmlrpc_mem_block * callP;
+    xmlrpc_int32       result;
+    bool               failed;
+};
+
+
+
+static void
+callerThread(void * const arg) {
+
+    struct callerCtx * const ctxP = arg;
+
+    xmlrpc_env env;
+    xmlrpc_mem_block * responseP;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_registry_process_call2(&env, ctxP->registryP,
+                                  XMLRPC_MEMBLOCK_CONTENTS(char, ctxP->callP),
+                                  XMLRPC_MEMBLOCK_SIZE(char, ctxP->callP),
+                                  NULL, &responseP);
+    if (env.fault_occurred)
+        ctxP->failed = true;
+    else {
+        xmlrpc_value * const resultP =
+            xmlrpc_parse_response(&env,
+                                  XMLRPC_MEMBLOCK_CONTENTS(char, responseP),
+                                  XMLRPC_MEMBLOCK_SIZE(char, responseP));
+        if (env.fault_occurred)
+            ctxP->failed = true;
+        else {
+            xmlrpc_read_int(&env, resultP, &ctxP->result);
+            ctxP->failed = env.fault_occurred;
+            xmlrpc_DECREF(resultP);
+        }
+        XMLRPC_MEMBLOCK_FREE(char, responseP);
+    }
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+test_single_flight(void) {
+
+#define CALLER_CT 6
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct xmlrpc_method_info4 methodInfo;
+    xmlrpc_value * argArrayP;
+    xmlrpc_mem_block * callP;
+    struct xmlrpc_thread * threadP[CALLER_CT];
+    struct callerCtx ctx[CALLER_CT];
+    unsigned int callCount;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    printf("  Running single-flight tests.");
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    callCount = 0;
+
+    methodInfo.methodName      = "test.slow";
+    methodInfo.methodFunction  = &test_slow;
+    methodInfo.serverInfo      = &callCount;
+    methodInfo.stackSize       = 0;
+    methodInfo.signatureString = "i:i";
+    methodInfo.help            = NULL;
+    methodInfo.cacheTtl        = 0;
+    methodInfo.cacheMaxEntries = 0;
+    methodInfo.singleFlight    = true;
+
+    xmlrpc_registry_add_method4(&env, registryP, &methodInfo,
+                                XMLRPC_MI4SIZE(singleFlight));
+    TEST_NO_FAULT(&env);
+
+    argArrayP = xmlrpc_build_value(&env, "(i)", 9);
+    TEST_NO_FAULT(&env);
+    callP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_call(&env, callP, "test.slow", argArrayP);
+    TEST_NO_FAULT(&env);
+
+    /* The calls all arrive while the first is executing, so they share its
+       execution.
+    */
+    for (i = 0; i < CALLER_CT; ++i) {
+        const char * error;
+
+        ctx[i].registryP = registryP;
+        ctx[i].callP     = callP;
+        ctx[i].failed    = true;
+
+        xmlrpc_thread_create(&threadP[i], &callerThread, &ctx[i], &error);
+        TEST(error == NULL);
+    }
+    for (i = 0; i < CALLER_CT; ++i) {
+        xmlrpc_thread_join(threadP[i]);
+        TEST(!ctx[i].failed);
+        TEST(ctx[i].result == 9);
+    }
+    TEST(callCount == 1);
+
+    /* A later call is a new flight */
+    callerThread(&ctx[0]);
+    TEST(!ctx[0].failed);
+    TEST(callCount == 2);
+
+    XMLRPC_MEMBLOCK_FREE(char, callP);
+    xmlrpc_DECREF(argArrayP);
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+
+#undef CALLER_CT
+}
+
+
+
+static xmlrpc_value *
+test_index(xmlrpc_env *   const envP,
+           xmlrpc_value * const paramArrayP ATTR_UNUSED,
+           void *         const serverInfo,
+           void *         const callInfo ATTR_UNUSED) {
+/*----------------------------------------------------------------------------
+   A method that returns the number at 'serverInfo'.
+-----------------------------------------------------------------------------*/
+    unsigned int * const indexP = serverInfo;
+
+    return xmlrpc_int_new(envP, *indexP);
+}
+
+
+
+#define MANY_METHOD_CT 300
+
+static void
+test_many_methods(void) {
+/*----------------------------------------------------------------------------
+   Test a registry with enough methods that it has to grow its index, and
+   check that system.listMethods still lists them in order of registration.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    xmlrpc_value * argArrayP;
+    xmlrpc_value * resultP;
+    unsigned int index[MANY_METHOD_CT];
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    printf("  Running many-methods tests.");
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    for (i = 0; i < MANY_METHOD_CT; ++i) {
+        /* Register in descending order, so order of registration isn't
+           alphabetical order.
+        */
+        unsigned int const n = MANY_METHOD_CT - 1 - i;
+        const char * methodName;
+
+        index[n] = n;
+        casprintf(&methodName, "many.m%u", n);
+        xmlrpc_registry_add_method2(&env, registryP, methodName,
+                                    test_index, NULL, NULL, &index[n]);
+        TEST_NO_FAULT(&env);
+        strfree(methodName);
+    }
+
+    /* Same name again */
+    xmlrpc_registry_add_method2(&env, registryP, "many.m7",
+                                test_index, NULL, NULL, &index[7]);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    xmlrpc_env_clean(&env);
+    xmlrpc_env_init(&env);
+
+    argArrayP = xmlrpc_array_new(&env);
+    TEST_NO_FAULT(&env);
+
+    for (i = 0; i < MANY_METHOD_CT; i += 37) {
+        const char * methodName;
+        xmlrpc_int32 n;
+
+        casprintf(&methodName, "many.m%u", i);
+        doRpc(&env, registryP, methodName, argArrayP, NULL, &resultP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_read_int(&env, resultP, &n);
+        TEST_NO_FAULT(&env);
+        TEST(n == (xmlrpc_int32)i);
+        xmlrpc_DECREF(resultP);
+        strfree(methodName);
+    }
+
+    doRpc(&env, registryP, "many.m", argArrayP, NULL, &resultP);
+    TEST_FAULT(&env, XMLRPC_NO_SUCH_METHOD_ERROR);
+    xmlrpc_env_clean(&env);
+    xmlrpc_env_init(&env);
+
+    doRpc(&env, registryP, "system.listMethods", argArrayP, NULL, &resultP);
+    TEST_NO_FAULT(&env);
+    {
+        unsigned int const sysMethodCt = 8;
+            /* system.listMethods ... system.getCapabilities */
+
+        TEST(xmlrpc_array_size(&env, resultP) ==
+             (int)(sysMethodCt + MANY_METHOD_CT));
+
+        for (i = 0; i < MANY_METHOD_CT; ++i) {
+            xmlrpc_value * itemP;
+            const char * methodName;
+            const char * expectedName;
+
+            xmlrpc_array_read_item(&env, resultP, sysMethodCt + i, &itemP);
+            TEST_NO_FAULT(&env);
+            xmlrpc_read_string(&env, itemP, &methodName);
+            TEST_NO_FAULT(&env);
+            casprintf(&expectedName, "many.m%u", MANY_METHOD_CT - 1 - i);
+            TEST(streq(methodName, expectedName));
+            strfree(expectedName);
+            strfree(methodName);
+            xmlrpc_DECREF(itemP);
+        }
+    }
+    xmlrpc_DECREF(resultP);
+    xmlrpc_DECREF(argArrayP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+struct dispatcherCtx {
+    xmlrpc_registry *  registryP;
+    xmlrpc_mem_block * callP;
+    unsigned int       callCt;
+    unsigned int       failureCt;
+};
+
+
+
+static void
+dispatcherThread(void * const arg) {
+/*----------------------------------------------------------------------------
+   Make the same call 'callCt' times and count the ones that fail.
+-----------------------------------------------------------------------------*/
+    struct dispatcherCtx * const ctxP = arg;
+
+    unsigned int i;
+
+    for (i = 0, ctxP->failureCt = 0; i < ctxP->callCt; ++i) {
+        xmlrpc_env env;
+        xmlrpc_mem_block * responseP;
+
+        xmlrpc_env_init(&env);
+
+        xmlrpc_registry_process_call2(&env, ctxP->registryP,
+                                      XMLRPC_MEMBLOCK_CONTENTS(char,
+                                                               ctxP->callP),
+                                      XMLRPC_MEMBLOCK_SIZE(char, ctxP->callP),
+                                      NULL, &responseP);
+        if (env.fault_occurred)
+            ++ctxP->failureCt;
+        else {
+            xmlrpc_value * const resultP =
+                xmlrpc_parse_response(
+                    &env,
+                    XMLRPC_MEMBLOCK_CONTENTS(char, responseP),
+                    XMLRPC_MEMBLOCK_SIZE(char, responseP));
+            if (env.fault_occurred)
+                ++ctxP->failureCt;
+            else
+                xmlrpc_DECREF(resultP);
+
+            XMLRPC_MEMBLOCK_FREE(char, responseP);
+        }
+        xmlrpc_env_clean(&env);
+    }
+}
+
+
+
+#define DISPATCHER_CT 4
+
+static void
+test_update_while_serving(void) {
+/*----------------------------------------------------------------------------
+   Test removing methods, and adding and removing them while other threads
+   dispatch calls.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    xmlrpc_value * argArrayP;
+    xmlrpc_value * resultP;
+    unsigned int index[1];
+    unsigned int slowCallCt;
+
+    xmlrpc_env_init(&env);
+
+    printf("  Running registry update tests.");
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    argArrayP = xmlrpc_array_new(&env);
+    TEST_NO_FAULT(&env);
+
+    index[0] = 0;
+
+    xmlrpc_registry_add_method2(&env, registryP, "stable",
+                                test_index, NULL, NULL, &index[0]);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_add_method2(&env, registryP, "plugin.x",
+                                test_index, NULL, NULL, &index[0]);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_remove_method(&env, registryP, "plugin.x");
+    TEST_NO_FAULT(&env);
+
+    doRpc(&env, registryP, "plugin.x", argArrayP, NULL, &resultP);
+    TEST_FAULT(&env, XMLRPC_NO_SUCH_METHOD_ERROR);
+    xmlrpc_env_clean(&env);
+    xmlrpc_env_init(&env);
+
+    xmlrpc_registry_remove_method(&env, registryP, "plugin.x");
+    TEST_FAULT(&env, XMLRPC_NO_SUCH_METHOD_ERROR);
+    xmlrpc_env_clean(&env);
+    xmlrpc_env_init(&env);
+
+    xmlrpc_registry_add_method2(&env, registryP, "plugin.x",
+                                test_index, NULL, NULL, &index[0]);
+    TEST_NO_FAULT(&env);
+
+    doRpc(&env, registryP, "stable", argArrayP, NULL, &resultP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_DECREF(resultP);
+
+    {
+        /* A call in progress finishes after we remove its method */
+
+        struct xmlrpc_method_info3 const methodInfo = {
+            /* .methodName      = */ "plugin.slow",
+            /* .methodFunction  = */ &test_slow,
+            /* .serverInfo      = */ &slowCallCt,
+            /* .stackSize       = */ 0,
+            /* .signatureString = */ NULL,
+            /* .help            = */ NULL
+        };
+        xmlrpc_value * paramArrayP;
+        struct callerCtx ctx;
+        struct xmlrpc_thread * threadP;
+        const char * error;
+
+        slowCallCt = 0;
+
+        xmlrpc_registry_add_method3(&env, registryP, &methodInfo);
+        TEST_NO_FAULT(&env);
+
+        paramArrayP = xmlrpc_build_value(&env, "(i)", (xmlrpc_int32)7);
+        ctx.registryP = registryP;
+        ctx.callP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+        xmlrpc_serialize_call(&env, ctx.callP, "plugin.slow", paramArrayP);
+        TEST_NO_FAULT(&env);
+
+        xmlrpc_thread_create(&threadP, &callerThread, &ctx, &error);
+        TEST_NULL_STRING(error);
+
+        xmlrpc_millisecond_sleep(100);
+
+        xmlrpc_registry_remove_method(&env, registryP, "plugin.slow");
+        TEST_NO_FAULT(&env);
+
+        xmlrpc_thread_join(threadP);
+
+        TEST(!ctx.failed);
+        TEST(ctx.result == 7);
+        TEST(slowCallCt == 1);
+
+        XMLRPC_MEMBLOCK_FREE(char, ctx.callP);
+        xmlrpc_DECREF(paramArrayP);
+    }
+    {
+        /* Many updates during many calls */
+
+        struct dispatcherCtx ctx[DISPATCHER_CT];
+        struct xmlrpc_thread * threadP[DISPATCHER_CT];
+        xmlrpc_mem_block * callP;
+        unsigned int i;
+
+        callP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+        xmlrpc_serialize_call(&env, callP, "stable", argArrayP);
+        TEST_NO_FAULT(&env);
+
+        for (i = 0; i < DISPATCHER_CT; ++i) {
+            const char * error;
+
+            ctx[i].registryP = registryP;
+            ctx[i].callP     = callP;
+            ctx[i].callCt    = 2000;
+
+            xmlrpc_thread_create(&threadP[i], &dispatcherThread, &ctx[i],
+                                 &error);
+            TEST_NULL_STRING(error);
+        }
+        for (i = 0; i < 500; ++i) {
+            const char * methodName;
+
+            casprintf(&methodName, "plugin.m%u", i % 20);
+
+            if (i < 20)
+                xmlrpc_registry_add_method2(&env, registryP, methodName,
+                                            test_index, NULL, NULL,
+                                            &index[0]);
+            else {
+                xmlrpc_registry_remove_method(&env, registryP, methodName);
+                TEST_NO_FAULT(&env);
+                xmlrpc_registry_add_method2(&env, registryP, methodName,
+                                            test_index, NULL, NULL,
+                                            &index[0]);
+            }
+            TEST_NO_FAULT(&env);
+            strfree(methodName);
+        }
+        for (i = 0; i < DISPATCHER_CT; ++i) {
+            xmlrpc_thread_join(threadP[i]);
+            TEST(ctx[i].failureCt == 0);
+        }
+        XMLRPC_MEMBLOCK_FREE(char, callP);
+    }
+    xmlrpc_DECREF(argArrayP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+struct concurrency {
+    struct lock * lockP;
+    unsigned int  runningCt;
+    unsigned int  maxRunningCt;
+    bool          exclusiveOverlapped;
+        /* An exclusive call executed at the same time as another call */
+};
+
+
+
+static xmlrpc_value *
+concurrentCall(xmlrpc_env *         const envP,
+               xmlrpc_value *       const paramArrayP,
+               struct concurrency * const concP,
+               bool                 const exclusive) {
+/*----------------------------------------------------------------------------
+   Take a while to return the first parameter, or fail if it is negative,
+   and record in *concP how many calls executed at once.
+-----------------------------------------------------------------------------*/
+    xmlrpc_int32 x;
+
+    xmlrpc_decompose_value(envP, paramArrayP, "(i)", &x);
+
+    if (envP->fault_occurred)
+        return NULL;
+    else {
+        concP->lockP->acquire(concP->lockP);
+        ++concP->runningCt;
+        if (concP->runningCt > concP->maxRunningCt)
+            concP->maxRunningCt = concP->runningCt;
+        if (exclusive && concP->runningCt > 1)
+            concP->exclusiveOverlapped = true;
+        concP->lockP->release(concP->lockP);
+
+        xmlrpc_millisecond_sleep(50);
+
+        concP->lockP->acquire(concP->lockP);
+        if (exclusive && concP->runningCt > 1)
+            concP->exclusiveOverlapped = true;
+        --concP->runningCt;
+        concP->lockP->release(concP->lockP);
+
+        if (x < 0) {
+            xmlrpc_env_set_fault(envP, 456, "Negative");
+            return NULL;
+        } else
+            return xmlrpc_int_new(envP, x);
+    }
+}
+
+
+
+static xmlrpc_value *
+test_parallel(xmlrpc_env *   const envP,
+              xmlrpc_value * const paramArrayP,
+              void *         const serverInfo,
+              void *         const callInfo ATTR_UNUSED) {
+
+    return concurrentCall(envP, paramArrayP, serverInfo, false);
+}
+
+
+
+static xmlrpc_value *
+test_exclusive(xmlrpc_env *   const envP,
+               xmlrpc_value * const paramArrayP,
+               void *         const serverInfo,
+               void *         const callInfo ATTR_UNUSED) {
+
+    return concurrentCall(envP, paramArrayP, serverInfo, true);
+}
+
+
+
+static void
+test_parallel_multicall(void) {
+/*----------------------------------------------------------------------------
+   Test system.multicall executing calls in parallel.
+-----------------------------------------------------------------------------*/
+#define CALL_CT 12
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct xmlrpc_method_info4 methodInfo;
+    struct xmlrpc_multicall_parms parms;
+    struct concurrency conc;
+    xmlrpc_value * callsP;
+    xmlrpc_value * multiP;
+    xmlrpc_value * resultsP;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    printf("  Running parallel multicall tests.");
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    conc.lockP               = xmlrpc_lock_create();
+    conc.runningCt           = 0;
+    conc.maxRunningCt        = 0;
+    conc.exclusiveOverlapped = false;
+
+    methodInfo.methodName      = "par.parallel";
+    methodInfo.methodFunction  = &test_parallel;
+    methodInfo.serverInfo      = &conc;
+    methodInfo.stackSize       = 0;
+    methodInfo.signatureString = "i:i";
+    methodInfo.help            = NULL;
+    methodInfo.cacheTtl        = 0;
+    methodInfo.cacheMaxEntries = 0;
+    methodInfo.singleFlight    = false;
+    methodInfo.parallelSafe    = true;
+
+    xmlrpc_registry_add_method4(&env, registryP, &methodInfo,
+                                XMLRPC_MI4SIZE(parallelSafe));
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_add_method2(&env, registryP, "par.exclusive",
+                                &test_exclusive, "i:i", NULL, &conc);
+    TEST_NO_FAULT(&env);
+
+    parms.threads    = 4;
+    parms.max_fanout = 3;
+
+    xmlrpc_registry_set_multicall_parallel(&env, registryP, &parms,
+                                           XMLRPC_MCPSIZE(max_fanout));
+    TEST_NO_FAULT(&env);
+
+    /* Only once per registry */
+    xmlrpc_registry_set_multicall_parallel(&env, registryP, &parms,
+                                           XMLRPC_MCPSIZE(max_fanout));
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    xmlrpc_env_clean(&env);
+    xmlrpc_env_init(&env);
+
+    /* Parallel calls, an exclusive one in the middle, and a failing one */
+    callsP = xmlrpc_array_new(&env);
+    TEST_NO_FAULT(&env);
+
+    for (i = 0; i < CALL_CT; ++i) {
+        xmlrpc_value * const callP =
+            xmlrpc_build_value(&env, "{s:s,s:(i)}",
+                               "methodName",
+                               i == 5 ? "par.exclusive" : "par.parallel",
+                               "params", i == 8 ? -1 : (xmlrpc_int32)i);
+        TEST_NO_FAULT(&env);
+        xmlrpc_array_append_item(&env, callsP, callP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_DECREF(callP);
+    }
+    multiP = xmlrpc_build_value(&env, "(A)", callsP);
+    TEST_NO_FAULT(&env);
+
+    doRpc(&env, registryP, "system.multicall", multiP, NULL, &resultsP);
+    TEST_NO_FAULT(&env);
+
+    TEST(xmlrpc_array_size(&env, resultsP) == CALL_CT);
+
+    for (i = 0; i < CALL_CT; ++i) {
+        xmlrpc_value * const resultP =
+            xmlrpc_array_get_item(&env, resultsP, i);
+        TEST_NO_FAULT(&env);
+
+        if (i == 8) {
+            xmlrpc_int32 faultCode;
+            xmlrpc_decompose_value(&env, resultP, "{s:i,*}",
+                                   "faultCode", &faultCode);
+            TEST_NO_FAULT(&env);
+            TEST(faultCode == 456);
+        } else {
+            xmlrpc_int32 x;
+            xmlrpc_decompose_value(&env, resultP, "(i)", &x);
+            TEST_NO_FAULT(&env);
+            TEST(x == (xmlrpc_int32)i);
+        }
+    }
+    TEST(conc.maxRunningCt > 1);
+    TEST(conc.maxRunningCt <= 3);
+    TEST(!conc.exclusiveOverlapped);
+
+    xmlrpc_DECREF(resultsP);
+    xmlrpc_DECREF(multiP);
+    xmlrpc_DECREF(callsP);
+
+    xmlrpc_registry_free(registryP);
+
+    conc.lockP->destroy(conc.lockP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+
+#undef CALL_CT
+}
+
+
+
+#define ASYNC_THREAD_MAX 8
+
+struct asyncMethodCtx {
+    struct xmlrpc_thread * threadP[ASYNC_THREAD_MAX];
+        /* Threads that complete calls, for us to join */
+    unsigned int           threadCt;
+    struct xmlrpc_event *  releaseEventP;
+        /* A call with a parameter of 100 or more waits for this */
+};
+
+struct asyncCompleter {
+    struct asyncMethodCtx * ctxP;
+    xmlrpc_completion *     completionP;
+    xmlrpc_int32            x;
+};
+
+
+
+static void
+completerThread(void * const arg) {
+
+    struct asyncCompleter * const completerP = arg;
+
+    xmlrpc_env env;
+    xmlrpc_value * resultP;
+
+    xmlrpc_env_init(&env);
+
+    if (completerP->x >= 100)
+        xmlrpc_event_wait(completerP->ctxP->releaseEventP);
+    else
+        xmlrpc_millisecond_sleep(20);
+
+    resultP = xmlrpc_int_new(&env, completerP->x * 2);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_completion_finish(completerP->completionP, NULL, resultP);
+
+    xmlrpc_DECREF(resultP);
+
+    free(completerP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+test_async(xmlrpc_value *      const paramArrayP,
+           void *              const serverInfo,
+           void *              const callInfo ATTR_UNUSED,
+           xmlrpc_completion * const completionP) {
+/*----------------------------------------------------------------------------
+   An asynchronous method that returns twice its parameter, from another
+   thread.  But -1 fails and -2 succeeds (with -4) before returning.
+-----------------------------------------------------------------------------*/
+    struct asyncMethodCtx * const ctxP = serverInfo;
+
+    xmlrpc_env env;
+    xmlrpc_int32 x;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_decompose_value(&env, paramArrayP, "(i)", &x);
+
+    if (!env.fault_occurred && x == -1)
+        xmlrpc_env_set_fault(&env, 42, "Failed as requested");
+
+    if (env.fault_occurred)
+        xmlrpc_completion_finish(completionP, &env, NULL);
+    else if (x == -2) {
+        xmlrpc_value * const resultP = xmlrpc_int_new(&env, x * 2);
+        TEST_NO_FAULT(&env);
+
+        xmlrpc_completion_finish(completionP, NULL, resultP);
+
+        xmlrpc_DECREF(resultP);
+    } else {
+        struct asyncCompleter * completerP;
+        const char * error;
+
+        completerP = malloc(sizeof(*completerP));
+        TEST(completerP != NULL);
+        TEST(ctxP->threadCt < ASYNC_THREAD_MAX);
+
+        completerP->ctxP        = ctxP;
+        completerP->completionP = completionP;
+        completerP->x           = x;
+
+        xmlrpc_thread_create(&ctxP->threadP[ctxP->threadCt++],
+                             &completerThread, completerP, &error);
+        TEST(!error);
+    }
+    xmlrpc_env_clean(&env);
+}
+
+
+
+struct responseCatcher {
+    struct xmlrpc_event * eventP;
+    bool                  delivered;
+    xmlrpc_mem_block *    responseP;
+};
+
+
+
+static void
+catchResponse(const xmlrpc_env * const envP,
+              void *             const arg,
+              xmlrpc_mem_block * const responseXmlP) {
+
+    struct responseCatcher * const catcherP = arg;
+
+    TEST_NO_FAULT(envP);
+    TEST(!catcherP->delivered);
+
+    catcherP->responseP = responseXmlP;
+    catcherP->delivered = true;
+
+    xmlrpc_event_set(catcherP->eventP);
+}
+
+
+
+static void
+processCallAsync(xmlrpc_registry *        const registryP,
+                 const char *             const methodName,
+                 xmlrpc_value *           const paramArrayP,
+                 struct responseCatcher * const catcherP) {
+
+    xmlrpc_env env;
+    xmlrpc_mem_block * callP;
+    const char * error;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_event_create(&catcherP->eventP, &error);
+    TEST(!error);
+    catcherP->delivered = false;
+
+    callP = xmlrpc_mem_block_new(&env, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_call(&env, callP, methodName, paramArrayP);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_process_call_async(registryP,
+                                       XMLRPC_MEMBLOCK_CONTENTS(char, callP),
+                                       XMLRPC_MEMBLOCK_SIZE(char, callP),
+                                       FOO_CALLINFO, &catchResponse, catcherP);
+
+    xmlrpc_mem_block_free(callP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static xmlrpc_int32
+awaitIntResponse(struct responseCatcher * const catcherP) {
+
+    xmlrpc_env env;
+    xmlrpc_value * resultP;
+    xmlrpc_int32 x;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_event_wait(catcherP->eventP);
+    xmlrpc_event_destroy(catcherP->eventP);
+
+    TEST(catcherP->delivered);
+
+    resultP = xmlrpc_parse_response(
+        &env,
+        XMLRPC_MEMBLOCK_CONTENTS(char, catcherP->responseP),
+        XMLRPC_MEMBLOCK_SIZE(char, catcherP->responseP));
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_read_int(&env, resultP, &x);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_DECREF(resultP);
+    XMLRPC_MEMBLOCK_FREE(char, catcherP->responseP);
+
+    xmlrpc_env_clean(&env);
+
+    return x;
+}
+
+
+
+static void
+test_async_method(void) {
+/*----------------------------------------------------------------------------
+   Test asynchronous methods, both where the registry waits for them and
+   where it delivers the response whenever the method completes the call.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct asyncMethodCtx ctx;
+    struct responseCatcher catcher;
+    xmlrpc_value * argArrayP;
+    xmlrpc_value * resultP;
+    xmlrpc_int32 x;
+    const char * error;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    printf("  Running asynchronous method tests.");
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    ctx.threadCt = 0;
+    xmlrpc_event_create(&ctx.releaseEventP, &error);
+    TEST(!error);
+
+    xmlrpc_registry_add_method_async(&env, registryP, "test.async",
+                                     &test_async, "i:i", NULL, &ctx);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_add_method2(&env, registryP, "test.foo", &test_foo,
+                                NULL, NULL, FOO_SERVERINFO);
+    TEST_NO_FAULT(&env);
+
+    /* The registry waits for the method to complete the call */
+    argArrayP = xmlrpc_build_value(&env, "(i)", (xmlrpc_int32) 5);
+    doRpc(&env, registryP, "test.async", argArrayP, FOO_CALLINFO, &resultP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_read_int(&env, resultP, &x);
+    TEST_NO_FAULT(&env);
+    TEST(x == 10);
+    xmlrpc_DECREF(resultP);
+    xmlrpc_DECREF(argArrayP);
+
+    argArrayP = xmlrpc_build_value(&env, "(i)", (xmlrpc_int32) -1);
+    doRpc(&env, registryP, "test.async", argArrayP, FOO_CALLINFO, &resultP);
+    TEST_FAULT(&env, 42);
+    xmlrpc_DECREF(argArrayP);
+    xmlrpc_env_clean(&env);
+    xmlrpc_env_init(&env);
+
+    /* The response comes after process_call_async returns */
+    argArrayP = xmlrpc_build_value(&env, "(i)", (xmlrpc_int32) 100);
+    processCallAsync(registryP, "test.async", argArrayP, &catcher);
+    TEST(!catcher.delivered);
+    xmlrpc_event_set(ctx.releaseEventP);
+    TEST(awaitIntResponse(&catcher) == 200);
+    xmlrpc_DECREF(argArrayP);
+
+    /* The method completes the call before returning */
+    argArrayP = xmlrpc_build_value(&env, "(i)", (xmlrpc_int32) -2);
+    processCallAsync(registryP, "test.async", argArrayP, &catcher);
+    TEST(catcher.delivered);
+    TEST(awaitIntResponse(&catcher) == -4);
+    xmlrpc_DECREF(argArrayP);
+
+    /* An ordinary method works with process_call_async too */
+    argArrayP = xmlrpc_build_value(&env, "(ii)",
+                                   (xmlrpc_int32) 25, (xmlrpc_int32) 17);
+    processCallAsync(registryP, "test.foo", argArrayP, &catcher);
+    TEST(catcher.delivered);
+    TEST(awaitIntResponse(&catcher) == 42);
+    xmlrpc_DECREF(argArrayP);
+
+    /* In a system.multicall, which waits for it */
+    argArrayP = xmlrpc_build_value(&env, "(({s:s,s:(i)}{s:s,s:(i)}))",
+                                   "methodName", "test.async",
+                                   "params", (xmlrpc_int32) 1,
+                                   "methodName", "test.async",
+                                   "params", (xmlrpc_int32) 2);
+    TEST_NO_FAULT(&env);
+    doRpc(&env, registryP, "system.multicall", argArrayP, MULTI_CALLINFO,
+          &resultP);
+    TEST_NO_FAULT(&env);
+    {
+        xmlrpc_int32 a, b;
+        xmlrpc_decompose_value(&env, resultP, "((i)(i))", &a, &b);
+        TEST_NO_FAULT(&env);
+        TEST(a == 2);
+        TEST(b == 4);
+    }
+    xmlrpc_DECREF(resultP);
+    xmlrpc_DECREF(argArrayP);
+
+    for (i = 0; i < ctx.threadCt; ++i)
+        xmlrpc_thread_join(ctx.threadP[i]);
+
+    xmlrpc_event_destroy(ctx.releaseEventP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+static xmlrpc_value *
+test_gated(xmlrpc_env *   const envP,
+           xmlrpc_value * const paramArrayP,
+           void *         const serverInfo,
+           void *         const callInfo ATTR_UNUSED) {
+/*----------------------------------------------------------------------------
+   A method that returns its first parameter once the event at 'serverInfo'
+   is set.
+-----------------------------------------------------------------------------*/
+    struct xmlrpc_event * const gateP = serverInfo;
+
+    xmlrpc_int32 x;
+
+    xmlrpc_decompose_value(envP, paramArrayP, "(i)", &x);
+
+    if (envP->fault_occurred)
+        return NULL;
+    else {
+        xmlrpc_event_wait(gateP);
+
+        return xmlrpc_int_new(envP, x);
+    }
+}
+
+
+
+static void
+awaitLoad(xmlrpc_registry * const registryP,
+          const char *      const methodName,
+          unsigned long     const inFlight,
+          unsigned long     const queued) {
+/*----------------------------------------------------------------------------
+   Wait until the method has 'inFlight' calls executing and 'queued'
+   waiting.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    struct xmlrpc_method_load_stats stats;
+
+    xmlrpc_env_init(&env);
+
+    do {
+        xmlrpc_millisecond_sleep(10);
+
+        xmlrpc_registry_get_method_load_stats(&env, registryP, methodName,
+                                              &stats);
+        TEST_NO_FAULT(&env);
+    } while (stats.inFlight != inFlight || stats.queued != queued);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+test_method_limits(void) {
+/*----------------------------------------------------------------------------
+   Test per-method limits on concurrent calls.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct xmlrpc_method_info4 methodInfo;
+    struct xmlrpc_method_load_stats stats;
+    struct xmlrpc_event * gateP;
+    struct asyncMethodCtx ctx;
+    struct responseCatcher catcher;
+    xmlrpc_value * argArrayP;
+    xmlrpc_value * resultP;
+    xmlrpc_mem_block * callP;
+    struct xmlrpc_thread * threadP[2];
+    struct callerCtx callerCtx[2];
+    const char * error;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    printf("  Running method concurrency limit tests.");
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_event_create(&gateP, &error);
+    TEST(!error);
+    ctx.threadCt = 0;
+    xmlrpc_event_create(&ctx.releaseEventP, &error);
+    TEST(!error);
+
+    methodInfo.methodName          = "test.gated";
+    methodInfo.methodFunction      = &test_gated;
+    methodInfo.serverInfo          = gateP;
+    methodInfo.stackSize           = 0;
+    methodInfo.signatureString     = "i:i";
+    methodInfo.help                = NULL;
+    methodInfo.cacheTtl            = 0;
+    methodInfo.cacheMaxEntries     = 0;
+    methodInfo.singleFlight        = false;
+    methodInfo.parallelSafe        = false;
+    methodInfo.maxConcurrent       = 1;
+    methodInfo.maxQueued           = 1;
+    methodInfo.methodFunctionAsync = NULL;
+
+    xmlrpc_registry_add_method4(&env, registryP, &methodInfo,
+                                XMLRPC_MI4SIZE(methodFunctionAsync));
+    TEST_NO_FAULT(&env);
+
+    methodInfo.methodName          = "test.async";
+    methodInfo.methodFunction      = NULL;
+    methodInfo.methodFunctionAsync = &test_async;
+    methodInfo.serverInfo          = &ctx;
+    methodInfo.maxQueued           = 5;
+
+    xmlrpc_registry_add_method4(&env, registryP, &methodInfo,
+                                XMLRPC_MI4SIZE(methodFunctionAsync));
+    TEST_NO_FAULT(&env);
+
+    /* An asynchronous method can't also be synchronous or cache */
+    methodInfo.methodName     = "test.bad";
+    methodInfo.methodFunction = &test_gated;
+    xmlrpc_registry_add_method4(&env, registryP, &methodInfo,
+                                XMLRPC_MI4SIZE(methodFunctionAsync));
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    methodInfo.methodFunction = NULL;
+    methodInfo.cacheTtl       = 1000;
+    xmlrpc_registry_add_method4(&env, registryP, &methodInfo,
+                                XMLRPC_MI4SIZE(methodFunctionAsync));
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+
+    xmlrpc_registry_add_method2(&env, registryP, "test.foo", &test_foo,
+                                NULL, NULL, FOO_SERVERINFO);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_get_method_load_stats(&env, registryP, "test.foo",
+                                          &stats);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    xmlrpc_registry_get_method_load_stats(&env, registryP, "test.nosuch",
+                                          &stats);
+    TEST_FAULT(&env, XMLRPC_NO_SUCH_METHOD_ERROR);
+
+    argArrayP = xmlrpc_build_value(&env, "(i)", (xmlrpc_int32) 7);
+    TEST_NO_FAULT(&env);
+    callP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_call(&env, callP, "test.gated", argArrayP);
+    TEST_NO_FAULT(&env);
+
+    /* One call executes, one waits, and a third fails right away */
+    for (i = 0; i < 2; ++i) {
+        callerCtx[i].registryP = registryP;
+        callerCtx[i].callP     = callP;
+        callerCtx[i].failed    = true;
+
+        xmlrpc_thread_create(&threadP[i], &callerThread, &callerCtx[i],
+                             &error);
+        TEST(!error);
+
+        awaitLoad(registryP, "test.gated", 1, i);
+    }
+    doRpc(&env, registryP, "test.gated", argArrayP, NULL, &resultP);
+    TEST_FAULT(&env, XMLRPC_METHOD_BUSY_ERROR);
+
+    /* The limit is per method */
+    {
+        xmlrpc_value * const fooArgArrayP =
+            xmlrpc_build_value(&env, "(ii)",
+                               (xmlrpc_int32) 25, (xmlrpc_int32) 17);
+
+        doRpc(&env, registryP, "test.foo", fooArgArrayP, FOO_CALLINFO,
+              &resultP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_DECREF(resultP);
+        xmlrpc_DECREF(fooArgArrayP);
+    }
+    xmlrpc_registry_get_method_load_stats(&env, registryP, "test.gated",
+                                          &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.inFlight == 1);
+    TEST(stats.queued == 1);
+    TEST(stats.rejected == 1);
+
+    xmlrpc_event_set(gateP);
+
+    for (i = 0; i < 2; ++i) {
+        xmlrpc_thread_join(threadP[i]);
+        TEST(!callerCtx[i].failed);
+        TEST(callerCtx[i].result == 7);
+    }
+    xmlrpc_registry_get_method_load_stats(&env, registryP, "test.gated",
+                                          &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.inFlight == 0);
+    TEST(stats.queued == 0);
+    TEST(stats.rejected == 1);
+
+    XMLRPC_MEMBLOCK_FREE(char, callP);
+    xmlrpc_DECREF(argArrayP);
+
+    /* A call without a thread holds its place until it completes, and one
+       that finds no place fails instead of waiting.
+    */
+    argArrayP = xmlrpc_build_value(&env, "(i)", (xmlrpc_int32) 100);
+    processCallAsync(registryP, "test.async", argArrayP, &catcher);
+    TEST(!catcher.delivered);
+    xmlrpc_registry_get_method_load_stats(&env, registryP, "test.async",
+                                          &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.inFlight == 1);
+    {
+        struct responseCatcher busyCatcher;
+
+        processCallAsync(registryP, "test.async", argArrayP, &busyCatcher);
+        TEST(busyCatcher.delivered);
+        xmlrpc_event_destroy(busyCatcher.eventP);
+
+        resultP = xmlrpc_parse_response(
+            &env,
+            XMLRPC_MEMBLOCK_CONTENTS(char, busyCatcher.responseP),
+            XMLRPC_MEMBLOCK_SIZE(char, busyCatcher.responseP));
+        TEST_FAULT(&env, XMLRPC_METHOD_BUSY_ERROR);
+        XMLRPC_MEMBLOCK_FREE(char, busyCatcher.responseP);
+    }
+    xmlrpc_event_set(ctx.releaseEventP);
+    TEST(awaitIntResponse(&catcher) == 200);
+    xmlrpc_DECREF(argArrayP);
+
+    xmlrpc_registry_get_method_load_stats(&env, registryP, "test.async",
+                                          &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.inFlight == 0);
+    TEST(stats.rejected == 1);
+
+    for (i = 0; i < ctx.threadCt; ++i)
+        xmlrpc_thread_join(ctx.threadP[i]);
+
+    xmlrpc_event_destroy(ctx.releaseEventP);
+    xmlrpc_event_destroy(gateP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+#undef ASYNC_THREAD_MAX
+
+
+
+struct orderedMethodCtx {
+    struct xmlrpc_event * gateP;
+    xmlrpc_int32          order[8];
+        /* The parameters of the calls, in the order they executed */
+    unsigned int          orderCt;
+};
+
+
+
+static xmlrpc_value *
+test_ordered(xmlrpc_env *   const envP,
+             xmlrpc_value * const paramArrayP,
+             void *         const serverInfo,
+             void *         const callInfo ATTR_UNUSED) {
+/*----------------------------------------------------------------------------
+   Like test_gated(), but record the order in which calls execute.  The
+   method's concurrency limit of 1 serializes them.
+-----------------------------------------------------------------------------*/
+    struct orderedMethodCtx * const ctxP = serverInfo;
+
+    xmlrpc_int32 x;
+
+    xmlrpc_decompose_value(envP, paramArrayP, "(i)", &x);
+
+    if (envP->fault_occurred)
+        return NULL;
+    else {
+        xmlrpc_event_wait(ctxP->gateP);
+
+        ctxP->order[ctxP->orderCt++] = x;
+
+        return xmlrpc_int_new(envP, x);
+    }
+}
+
+
+
+struct deadlineCallerCtx {
+    xmlrpc_registry * registryP;
+    xmlrpc_int32      arg;
+    bool              hasDeadline;
+    unsigned int      msLeft;
+    int               faultCode;
+        /* Code of the fault response; zero if the call succeeded */
+};
+
+
+
+static void
+deadlineCallerThread(void * const arg) {
+
+    struct deadlineCallerCtx * const ctxP = arg;
+
+    xmlrpc_env env;
+    xmlrpc_value * argArrayP;
+    xmlrpc_mem_block * callP;
+    xmlrpc_mem_block * responseP;
+    xmlrpc_value * resultP;
+
+    xmlrpc_env_init(&env);
+
+    argArrayP = xmlrpc_build_value(&env, "(i)", ctxP->arg);
+    TEST_NO_FAULT(&env);
+    callP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_call(&env, callP, "test.ordered", argArrayP);
+    TEST_NO_FAULT(&env);
+
+    if (ctxP->hasDeadline)
+        xmlrpc_registry_process_call_deadline(
+            &env, ctxP->registryP,
+            XMLRPC_MEMBLOCK_CONTENTS(char, callP),
+            XMLRPC_MEMBLOCK_SIZE(char, callP),
+            NULL, ctxP->msLeft, &responseP);
+    else
+        xmlrpc_registry_process_call2(
+            &env, ctxP->registryP,
+            XMLRPC_MEMBLOCK_CONTENTS(char, callP),
+            XMLRPC_MEMBLOCK_SIZE(char, callP),
+            NULL, &responseP);
+    TEST_NO_FAULT(&env);
+
+    resultP = xmlrpc_parse_response(&env,
+                                    XMLRPC_MEMBLOCK_CONTENTS(char, responseP),
+                                    XMLRPC_MEMBLOCK_SIZE(char, responseP));
+    if (env.fault_occurred)
+        ctxP->faultCode = env.fault_code;
+    else {
+        ctxP->faultCode = 0;
+        xmlrpc_DECREF(resultP);
+    }
+    XMLRPC_MEMBLOCK_FREE(char, responseP);
+    XMLRPC_MEMBLOCK_FREE(char, callP);
+    xmlrpc_DECREF(argArrayP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+test_method_deadlines(void) {
+/*----------------------------------------------------------------------------
+   Test calls with deadlines: they wait for a method's concurrency limit in
+   order of deadline, and fail instead of executing once the deadline has
+   passed.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct xmlrpc_method_info4 methodInfo;
+    struct orderedMethodCtx methodCtx;
+    struct deadlineCallerCtx callerCtx[5];
+    struct xmlrpc_thread * threadP[5];
+    xmlrpc_value * argArrayP;
+    xmlrpc_mem_block * callP;
+    xmlrpc_mem_block * responseP;
+    const char * error;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    printf("  Running call deadline tests.");
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_event_create(&methodCtx.gateP, &error);
+    TEST(!error);
+    methodCtx.orderCt = 0;
+
+    methodInfo.methodName          = "test.ordered";
+    methodInfo.methodFunction      = &test_ordered;
+    methodInfo.serverInfo          = &methodCtx;
+    methodInfo.stackSize           = 0;
+    methodInfo.signatureString     = "i:i";
+    methodInfo.help                = NULL;
+    methodInfo.cacheTtl            = 0;
+    methodInfo.cacheMaxEntries     = 0;
+    methodInfo.singleFlight        = false;
+    methodInfo.parallelSafe        = false;
+    methodInfo.maxConcurrent       = 1;
+    methodInfo.maxQueued           = 4;
+    methodInfo.methodFunctionAsync = NULL;
+
+    xmlrpc_registry_add_method4(&env, registryP, &methodInfo,
+                                XMLRPC_MI4SIZE(methodFunctionAsync));
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_add_method2(&env, registryP, "test.foo", &test_foo,
+                                NULL, NULL, FOO_SERVERINFO);
+    TEST_NO_FAULT(&env);
+
+    /* A call whose deadline has already passed doesn't execute */
+    argArrayP = xmlrpc_build_value(&env, "(ii)",
+                                   (xmlrpc_int32) 25, (xmlrpc_int32) 17);
+    TEST_NO_FAULT(&env);
+    callP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_call(&env, callP, "test.foo", argArrayP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_process_call_deadline(
+        &env, registryP,
+        XMLRPC_MEMBLOCK_CONTENTS(char, callP),
+        XMLRPC_MEMBLOCK_SIZE(char, callP),
+        FOO_CALLINFO, 0, &responseP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_parse_response(&env,
+                          XMLRPC_MEMBLOCK_CONTENTS(char, responseP),
+                          XMLRPC_MEMBLOCK_SIZE(char, responseP));
+    TEST_FAULT(&env, XMLRPC_TIMEOUT_ERROR);
+    XMLRPC_MEMBLOCK_FREE(char, responseP);
+    XMLRPC_MEMBLOCK_FREE(char, callP);
+    xmlrpc_DECREF(argArrayP);
+
+    /* The first call executes and the rest queue behind it: two without
+       deadlines, then two with deadlines, the later one first, then one
+       whose deadline will pass while it waits.
+    */
+    for (i = 0; i < 5; ++i) {
+        callerCtx[i].registryP   = registryP;
+        callerCtx[i].arg         = i + 1;
+        callerCtx[i].hasDeadline = i >= 2;
+        callerCtx[i].msLeft      = i == 2 ? 60000 : i == 3 ? 30000 : 1;
+        callerCtx[i].faultCode   = -1;
+
+        xmlrpc_thread_create(&threadP[i], &deadlineCallerThread,
+                             &callerCtx[i], &error);
+        TEST(!error);
+
+        awaitLoad(registryP, "test.ordered", 1, i);
+    }
+    xmlrpc_event_set(methodCtx.gateP);
+
+    for (i = 0; i < 5; ++i)
+        xmlrpc_thread_join(threadP[i]);
+
+    for (i = 0; i < 4; ++i)
+        TEST(callerCtx[i].faultCode == 0);
+    TEST(callerCtx[4].faultCode == XMLRPC_TIMEOUT_ERROR);
+
+    TEST(methodCtx.orderCt == 4);
+    TEST(methodCtx.order[0] == 1);
+    TEST(methodCtx.order[1] == 4);
+    TEST(methodCtx.order[2] == 3);
+    TEST(methodCtx.order[3] == 2);
+
+    xmlrpc_event_destroy(methodCtx.gateP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
 void
 test_method_registry(void) {
 
@@ -1082,6 +2647,21 @@ test_method_registry(void) {
 
     test_system_multicall(registryP);
 
+    {
+        /* The same, with all calls of a multicall executing in parallel */
+        struct xmlrpc_multicall_parms parms;
+
+        parms.threads           = 2;
+        parms.max_fanout        = 0;
+        parms.all_parallel_safe = true;
+
+        xmlrpc_registry_set_multicall_parallel(
+            &env, registryP, &parms, XMLRPC_MCPSIZE(all_parallel_safe));
+        TEST_NO_FAULT(&env);
+
+        test_system_multicall(registryP);
+    }
+
     xmlrpc_env_init(&env2);
     xmlrpc_registry_process_call2(&env, registryP,
                                   expat_error_data,
@@ -1103,6 +2683,8 @@ test_method_registry(void) {
 
     test_system_listMethods(registryP);
 
+    test_many_methods();
+
     test_system_methodExist(registryP);
 
     test_system_methodHelp(registryP);
@@ -1116,6 +2698,18 @@ test_method_registry(void) {
     test_disable_introspection();
 
     test_apache_dialect();
+
+    test_method_cache();
+
+    test_single_flight();
+
+    test_update_while_serving();
+
+    test_parallel_multicall();
+
+    test_async_method();
+    test_method_limits();
+    test_method_deadlines();
     
     /* Test cleanup code (w/memprof). */
     xmlrpc_registry_free(registryP);
@@ -1,10 +1,13 @@
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 #include <limits.h>
 
 #include "xmlrpc_config.h"
 
+#include "bool.h"
 #include "xmlrpc-c/base.h"
+#include "xmlrpc-c/base_int.h"
 
 #include "testtool.h"
 #include "xml_data.h"
@@ -298,6 +301,299 @@ test_serialize_apache(void) {
 
 
 
+static void
+test_serialize_preserialized(void) {
+
+    char const serializedData[] =
+        "<value><array><data>\r\n"
+            "<value><i4>7</i4></value>\r\n"
+            "<value><ex:i8>8</ex:i8></value>\r\n"
+            "<value><ex:nil/></value>\r\n"
+        "</data></array></value>";
+
+    xmlrpc_env env;
+    xmlrpc_value * valueP;
+    xmlrpc_value * preserP;
+    xmlrpc_value * rawP;
+    xmlrpc_mem_block * outputP;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    valueP = xmlrpc_build_value(&env, "(iIn)", 7, (xmlrpc_int64)8);
+    TEST_NO_FAULT(&env);
+
+    preserP = xmlrpc_preserialize(&env, valueP, xmlrpc_dialect_apache);
+    TEST_NO_FAULT(&env);
+    TEST(xmlrpc_value_type(preserP) == XMLRPC_TYPE_PRESERIALIZED);
+
+    outputP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_value2(&env, outputP, preserP, xmlrpc_dialect_apache);
+    TEST_NO_FAULT(&env);
+    TEST(XMLRPC_MEMBLOCK_SIZE(char, outputP) == strlen(serializedData));
+    TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, outputP), serializedData,
+               strlen(serializedData)));
+    XMLRPC_MEMBLOCK_FREE(char, outputP);
+
+    /* Wrong dialect */
+    outputP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_value2(&env, outputP, preserP, xmlrpc_dialect_i8);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    XMLRPC_MEMBLOCK_FREE(char, outputP);
+
+    /* XML supplied directly by the user, inside an array */
+    rawP = xmlrpc_preserialized_new(&env, xmlrpc_dialect_i8,
+                                    "<i4>5</i4>", 10);
+    TEST_NO_FAULT(&env);
+    {
+        xmlrpc_value * const arrayP = xmlrpc_array_new(&env);
+        TEST_NO_FAULT(&env);
+        xmlrpc_array_append_item(&env, arrayP, rawP);
+        TEST_NO_FAULT(&env);
+        outputP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+        TEST_NO_FAULT(&env);
+        xmlrpc_serialize_value2(&env, outputP, arrayP, xmlrpc_dialect_i8);
+        TEST_NO_FAULT(&env);
+        TEST(XMLRPC_MEMBLOCK_SIZE(char, outputP) ==
+             strlen("<value><array><data>\r\n"
+                    "<value><i4>5</i4></value>\r\n"
+                    "</data></array></value>"));
+        XMLRPC_MEMBLOCK_FREE(char, outputP);
+        xmlrpc_DECREF(arrayP);
+    }
+    xmlrpc_DECREF(rawP);
+
+    /* Memoization: same output every time, in each dialect */
+    xmlrpc_value_set_memoize(valueP, true);
+    for (i = 0; i < 3; ++i) {
+        outputP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+        TEST_NO_FAULT(&env);
+        xmlrpc_serialize_value2(&env, outputP, valueP, xmlrpc_dialect_apache);
+        TEST_NO_FAULT(&env);
+        TEST(XMLRPC_MEMBLOCK_SIZE(char, outputP) == strlen(serializedData));
+        TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, outputP), serializedData,
+                   strlen(serializedData)));
+        XMLRPC_MEMBLOCK_FREE(char, outputP);
+
+        outputP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+        TEST_NO_FAULT(&env);
+        xmlrpc_serialize_value2(&env, outputP, valueP, xmlrpc_dialect_i8);
+        TEST_NO_FAULT(&env);
+        TEST(XMLRPC_MEMBLOCK_SIZE(char, outputP) ==
+             strlen(serializedData) - strlen("ex:ex:ex:"));
+        XMLRPC_MEMBLOCK_FREE(char, outputP);
+    }
+    xmlrpc_value_set_memoize(valueP, false);
+
+    xmlrpc_DECREF(preserP);
+    xmlrpc_DECREF(valueP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+test_serialize_parallel(void) {
+
+    /* Serialize a big array with multiple threads and make sure we get
+       exactly what we get with one.
+    */
+    xmlrpc_env env;
+    xmlrpc_value * arrayP;
+    xmlrpc_mem_block * serialP;
+    xmlrpc_mem_block * parallelP;
+    size_t const threadsSave =
+        xmlrpc_limit_get(XMLRPC_SERIALIZE_THREADS_LIMIT_ID);
+    size_t const minSave =
+        xmlrpc_limit_get(XMLRPC_SERIALIZE_PARALLEL_MIN_LIMIT_ID);
+    unsigned int threadCt;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    arrayP = xmlrpc_array_new(&env);
+    TEST_NO_FAULT(&env);
+
+    for (i = 0; i < 1000; ++i) {
+        xmlrpc_value * const itemP =
+            xmlrpc_build_value(&env, "{s:i,s:(ss)}",
+                               "seq", i, "names", "a<b", "c&d");
+        TEST_NO_FAULT(&env);
+        xmlrpc_array_append_item(&env, arrayP, itemP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_DECREF(itemP);
+    }
+    serialP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_value(&env, serialP, arrayP);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_limit_set(XMLRPC_SERIALIZE_PARALLEL_MIN_LIMIT_ID, 2);
+
+    for (threadCt = 2; threadCt <= 7; ++threadCt) {
+        xmlrpc_limit_set(XMLRPC_SERIALIZE_THREADS_LIMIT_ID, threadCt);
+
+        parallelP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+        TEST_NO_FAULT(&env);
+        xmlrpc_serialize_value(&env, parallelP, arrayP);
+        TEST_NO_FAULT(&env);
+
+        TEST(XMLRPC_MEMBLOCK_SIZE(char, parallelP) ==
+             XMLRPC_MEMBLOCK_SIZE(char, serialP));
+        TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, parallelP),
+                   XMLRPC_MEMBLOCK_CONTENTS(char, serialP),
+                   XMLRPC_MEMBLOCK_SIZE(char, serialP)));
+        XMLRPC_MEMBLOCK_FREE(char, parallelP);
+    }
+
+    /* A failure in one of the ranges */
+    {
+        xmlrpc_value * const cptrP = xmlrpc_cptr_new(&env, NULL);
+        TEST_NO_FAULT(&env);
+        xmlrpc_array_append_item(&env, arrayP, cptrP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_DECREF(cptrP);
+
+        parallelP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+        TEST_NO_FAULT(&env);
+        xmlrpc_serialize_value(&env, parallelP, arrayP);
+        TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+        XMLRPC_MEMBLOCK_FREE(char, parallelP);
+    }
+    xmlrpc_limit_set(XMLRPC_SERIALIZE_THREADS_LIMIT_ID, threadsSave);
+    xmlrpc_limit_set(XMLRPC_SERIALIZE_PARALLEL_MIN_LIMIT_ID, minSave);
+
+    XMLRPC_MEMBLOCK_FREE(char, serialP);
+    xmlrpc_DECREF(arrayP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+unmapDtor(void * const context,
+          void * const objectP ATTR_UNUSED) {
+
+    bool * const unmappedP = context;
+
+    *unmappedP = true;
+}
+
+
+
+static void
+test_serialize_base64_external(void) {
+/*----------------------------------------------------------------------------
+   Base64 values whose bytes are in a file or in memory the value doesn't
+   own serialize the same as an ordinary one.
+-----------------------------------------------------------------------------*/
+    /* Big enough to take multiple chunks, and not a whole number of lines */
+    size_t const size = 200 * 1000 + 7;
+
+    xmlrpc_env env;
+    unsigned char * bytes;
+    FILE * fileP;
+    xmlrpc_value * memValueP;
+    xmlrpc_value * fdValueP;
+    xmlrpc_value * mappedValueP;
+    xmlrpc_mem_block * memOutputP;
+    xmlrpc_mem_block * fdOutputP;
+    xmlrpc_mem_block * mappedOutputP;
+    const unsigned char * readBytes;
+    size_t readSize;
+    bool unmapped;
+    size_t i;
+
+    xmlrpc_env_init(&env);
+
+    bytes = malloc(size);
+    TEST(bytes != NULL);
+    for (i = 0; i < size; ++i)
+        bytes[i] = (unsigned char)(i * 7 + i / 256);
+
+    fileP = tmpfile();
+    TEST(fileP != NULL);
+    fputs("junk", fileP);
+    TEST(fwrite(bytes, 1, size, fileP) == size);
+    fputs("more junk", fileP);
+    fflush(fileP);
+    fseek(fileP, 4, SEEK_SET);  /* The value starts after the junk */
+
+    memValueP = xmlrpc_base64_new(&env, size, bytes);
+    TEST_NO_FAULT(&env);
+    fdValueP = xmlrpc_base64_new_fd(&env, fileno(fileP), size);
+    TEST_NO_FAULT(&env);
+    unmapped = false;
+    mappedValueP = xmlrpc_base64_new_mapped(&env, size, bytes,
+                                            &unmapDtor, &unmapped);
+    TEST_NO_FAULT(&env);
+
+    /* The value has its own file descriptor */
+    fclose(fileP);
+
+    memOutputP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    xmlrpc_serialize_value(&env, memOutputP, memValueP);
+    TEST_NO_FAULT(&env);
+    fdOutputP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    xmlrpc_serialize_value(&env, fdOutputP, fdValueP);
+    TEST_NO_FAULT(&env);
+    mappedOutputP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    xmlrpc_serialize_value(&env, mappedOutputP, mappedValueP);
+    TEST_NO_FAULT(&env);
+
+    TEST(XMLRPC_MEMBLOCK_SIZE(char, fdOutputP) ==
+         XMLRPC_MEMBLOCK_SIZE(char, memOutputP));
+    TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, fdOutputP),
+               XMLRPC_MEMBLOCK_CONTENTS(char, memOutputP),
+               XMLRPC_MEMBLOCK_SIZE(char, memOutputP)));
+    TEST(XMLRPC_MEMBLOCK_SIZE(char, mappedOutputP) ==
+         XMLRPC_MEMBLOCK_SIZE(char, memOutputP));
+    TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, mappedOutputP),
+               XMLRPC_MEMBLOCK_CONTENTS(char, memOutputP),
+               XMLRPC_MEMBLOCK_SIZE(char, memOutputP)));
+
+    XMLRPC_MEMBLOCK_FREE(char, mappedOutputP);
+    XMLRPC_MEMBLOCK_FREE(char, fdOutputP);
+    XMLRPC_MEMBLOCK_FREE(char, memOutputP);
+
+    xmlrpc_read_base64(&env, fdValueP, &readSize, &readBytes);
+    TEST_NO_FAULT(&env);
+    TEST(readSize == size);
+    TEST(memeq(readBytes, bytes, size));
+    free((void *)readBytes);
+
+    xmlrpc_read_base64_old(&env, fdValueP, &readSize, &readBytes);
+    TEST_NO_FAULT(&env);
+    TEST(readSize == size);
+    TEST(memeq(readBytes, bytes, size));
+    {
+        /* The second read gets the copy the first one cached */
+        const unsigned char * readBytes2;
+
+        xmlrpc_read_base64_old(&env, fdValueP, &readSize, &readBytes2);
+        TEST_NO_FAULT(&env);
+        TEST(readBytes2 == readBytes);
+    }
+
+    TEST(xmlrpc_value_equal(fdValueP, memValueP));
+    TEST(xmlrpc_value_equal(mappedValueP, fdValueP));
+    TEST(xmlrpc_value_hash(fdValueP) == xmlrpc_value_hash(memValueP));
+
+    xmlrpc_DECREF(mappedValueP);
+    TEST(unmapped);
+    xmlrpc_DECREF(fdValueP);
+    xmlrpc_DECREF(memValueP);
+    free(bytes);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
 void 
 test_serialize(void) {
 
@@ -310,6 +606,9 @@ test_serialize(void) {
     test_serialize_methodCall();
     test_serialize_fault();
     test_serialize_apache();
+    test_serialize_preserialized();
+    test_serialize_parallel();
+    test_serialize_base64_external();
 
     printf("\n");
     printf("Serialize tests done.\n");
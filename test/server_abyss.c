@@ -2,15 +2,42 @@
 
 #include "unistdx.h"
 #include <stdio.h>
+#include <string.h>
 #include "bool.h"
 
 #include "xmlrpc_config.h"
 
+#if HAVE_ZLIB_H && !defined(_WIN32)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <zlib.h>
+#endif
+
+#if HAVE_ABYSS_OPENSSL && !defined(_WIN32)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <openssl/evp.h>
+#endif
+
+#if !defined(_WIN32)
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
 #include "girstring.h"
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
 #include "xmlrpc-c/abyss.h"
 #include "xmlrpc-c/server_abyss.h"
+#include "xmlrpc-c/thread_int.h"
+#include "xmlrpc-c/sleep_int.h"
 
 #include "testtool.h"
 
@@ -59,6 +86,17 @@ testSetHandlers(TServer * const abyssServerP) {
         &env, abyssServerP, &parms, XMLRPC_AHPSIZE(allow_origin));
     TEST_NO_FAULT(&env);
 
+    parms.uri_path = "/RPC7";
+    parms.compress_level = 10;
+    parms.compress_min_size = 256;
+    xmlrpc_server_abyss_set_handler3(
+        &env, abyssServerP, &parms, XMLRPC_AHPSIZE(compress_min_size));
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);  /* Invalid level */
+    parms.compress_level = HAVE_ZLIB_H ? 6 : 0;
+    xmlrpc_server_abyss_set_handler3(
+        &env, abyssServerP, &parms, XMLRPC_AHPSIZE(compress_min_size));
+    TEST_NO_FAULT(&env);
+
     xmlrpc_server_abyss_set_handler2(abyssServerP, "/RPC5",
                                      &myXmlProcessor, NULL, 512, true);
 
@@ -107,6 +145,20 @@ testServerParms(void) {
     parms.sockaddr_p = &sockaddr;
     parms.sockaddrlen = sizeof(sockaddr);
     parms.log_file_name = "/tmp/xmlrpc_logfile";
+    parms.event_driven = true;
+    parms.conn_queue_depth = 20;
+    parms.acceptor_count = 4;
+    parms.pin_acceptors = true;
+    parms.prefork_min_workers = 2;
+    parms.prefork_max_workers = 8;
+    parms.prefork_max_requests = 1000;
+    parms.compress_level = 6;
+    parms.compress_min_size = 256;
+    parms.shed_target_ms = 5;
+    parms.shed_interval_ms = 100;
+    parms.shed_retry_after = 1;
+    parms.log_buffer_size = 4096;
+    parms.log_drop_when_full = false;
 
     if (parms.config_file_name) {}  // Defeat set-but-unused compiler warning
 };
@@ -247,30 +299,1964 @@ testObject(void) {
 
 
 
-void
-test_server_abyss(void) {
+#if !defined(_WIN32)
 
-    TServer abyssServer;
+struct loopbackServer {
+/*----------------------------------------------------------------------------
+   A server on a loopback port of the system's choosing, which runs in a
+   thread of its own.
+-----------------------------------------------------------------------------*/
+    TServer                server;
+    TChanSwitch *          chanSwitchP;
+    struct xmlrpc_thread * threadP;
+    struct sockaddr_in     addr;
+        /* The address to which to connect */
+};
 
-    printf("Running Abyss XML-RPC server tests...\n");
 
-    ServerCreate(&abyssServer, "testserver", 8080, NULL, NULL);
-    
-    testSetHandlers(&abyssServer);
 
-    ServerSetMaxConn(&abyssServer, 10);
-    ServerSetMaxConnBacklog(&abyssServer, 10);
-    ServerSetMaxSessionMem(&abyssServer, 64*1024);
-    ServerSetKeepaliveTimeout(&abyssServer, 60);
-    ServerSetKeepaliveMaxConn(&abyssServer, 10);
-    ServerSetTimeout(&abyssServer, 0);
-    ServerSetAdvertise(&abyssServer, false);
+static void
+bindLoopback(int *                const listenFdP,
+             struct sockaddr_in * const addrP) {
+/*----------------------------------------------------------------------------
+   Create a TCP socket bound to a loopback port of the system's choosing.
+   Return as *addrP the address to which to connect.
+-----------------------------------------------------------------------------*/
+    socklen_t addrLen;
+    int listenFd;
+
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST(listenFd >= 0);
+
+    memset(addrP, 0, sizeof(*addrP));
+    addrP->sin_family      = AF_INET;
+    addrP->sin_port        = 0;
+    addrP->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST(bind(listenFd, (struct sockaddr *)addrP, sizeof(*addrP)) == 0);
+    addrLen = sizeof(*addrP);
+    TEST(getsockname(listenFd, (struct sockaddr *)addrP, &addrLen) == 0);
+
+    *listenFdP = listenFd;
+}
 
-    ServerFree(&abyssServer);
 
-    testServerParms();
 
-    testObject();
+static void
+createLoopbackServer(struct loopbackServer * const lsP) {
+/*----------------------------------------------------------------------------
+   Create the server, for the caller to configure and then start with
+   startLoopbackServer().
+-----------------------------------------------------------------------------*/
+    const char * error;
+    int listenFd;
+
+    bindLoopback(&listenFd, &lsP->addr);
+
+    ChanSwitchUnixCreateFd(listenFd, &lsP->chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+
+    ServerCreateSwitch(&lsP->server, lsP->chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+}
+
+
+
+static void
+runServer(void * const arg) {
+
+    TServer * const serverP = arg;
+
+    ServerRun(serverP);
+}
+
+
+
+static void
+startLoopbackServer(struct loopbackServer * const lsP) {
+
+    const char * error;
+
+    ServerInit2(&lsP->server, &error);
+    TEST_NULL_STRING(error);
+
+    xmlrpc_thread_create(&lsP->threadP, &runServer, &lsP->server, &error);
+    TEST_NULL_STRING(error);
+}
+
+
+
+static void
+stopLoopbackServer(struct loopbackServer * const lsP) {
+
+    ServerTerminate(&lsP->server);
+
+    xmlrpc_thread_join(lsP->threadP);
+
+    ServerFree(&lsP->server);
+
+    ChanSwitchDestroy(lsP->chanSwitchP);
+}
+
+
+
+static int
+connectLoopback(const struct sockaddr_in * const addrP) {
+
+    int const fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    TEST(fd >= 0);
+    TEST(connect(fd, (const struct sockaddr *)addrP, sizeof(*addrP)) == 0);
+
+    return fd;
+}
+
+#endif
+
+
+
+#if HAVE_ZLIB_H && !defined(_WIN32)
+
+static xmlrpc_call_processor echoXmlProcessor;
+
+static void
+echoXmlProcessor(xmlrpc_env *        const envP,
+                 void *              const processorArg ATTR_UNUSED,
+                 const char *        const callXml,
+                 size_t              const callXmlLen,
+                 TSession *          const abyssSessionP ATTR_UNUSED,
+                 xmlrpc_mem_block ** const responseXmlPP) {
+/*----------------------------------------------------------------------------
+   Respond with the call, so the client can see that the call got
+   decompressed and the response compressed without loss.
+-----------------------------------------------------------------------------*/
+    *responseXmlPP = XMLRPC_MEMBLOCK_NEW(char, envP, 0);
+    if (!envP->fault_occurred)
+        XMLRPC_MEMBLOCK_APPEND(char, envP, *responseXmlPP,
+                               callXml, callXmlLen);
+}
+
+
+
+static void
+postGzipped(const struct sockaddr_in * const addrP,
+            const char *               const contentEncoding,
+            const char *               const body,
+            size_t                     const bodySize,
+            char *                     const response,
+            size_t                     const responseSize,
+            size_t *                   const responseLenP) {
+/*----------------------------------------------------------------------------
+   POST 'body', gzipped, to the server at *addrP, saying it is encoded
+   'contentEncoding', and return the server's whole response.
+-----------------------------------------------------------------------------*/
+    unsigned char compressed[4096];
+    char header[256];
+    z_stream z;
+    size_t compressedLen;
+    size_t responseLen;
+    ssize_t rc;
+    int fd;
+
+    memset(&z, 0, sizeof(z));
+    TEST(deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                      Z_DEFAULT_STRATEGY) == Z_OK);
+    z.next_in   = (unsigned char *)body;
+    z.avail_in  = bodySize;
+    z.next_out  = compressed;
+    z.avail_out = sizeof(compressed);
+    TEST(deflate(&z, Z_FINISH) == Z_STREAM_END);
+    compressedLen = z.total_out;
+    deflateEnd(&z);
+
+    snprintf(header, sizeof(header),
+             "POST /RPC2 HTTP/1.1\r\n"
+             "Host: localhost\r\n"
+             "Content-Type: text/xml\r\n"
+             "Content-Encoding: %s\r\n"
+             "Accept-Encoding: gzip\r\n"
+             "Content-Length: %u\r\n"
+             "Connection: close\r\n"
+             "\r\n",
+             contentEncoding, (unsigned int)compressedLen);
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST(fd >= 0);
+    TEST(connect(fd, (const struct sockaddr *)addrP, sizeof(*addrP)) == 0);
+
+    TEST(write(fd, header, strlen(header)) == (ssize_t)strlen(header));
+    TEST(write(fd, compressed, compressedLen) == (ssize_t)compressedLen);
+
+    /* The server closes the connection after the response */
+    responseLen = 0;
+    do {
+        rc = read(fd, &response[responseLen],
+                  responseSize - 1 - responseLen);
+        if (rc > 0)
+            responseLen += rc;
+    } while (rc > 0 && responseLen < responseSize - 1);
+
+    response[responseLen] = '\0';
+    *responseLenP = responseLen;
+
+    close(fd);
+}
+
+
+
+static void
+inflateChunked(const char * const chunked,
+               char *       const body,
+               size_t       const bodySize,
+               size_t *     const bodyLenP) {
+/*----------------------------------------------------------------------------
+   Dechunk the chunked HTTP response body 'chunked' and gunzip it into
+   body[].
+-----------------------------------------------------------------------------*/
+    unsigned char compressed[4096];
+    size_t compressedLen;
+    const char * p;
+    unsigned long chunkLen;
+    z_stream z;
+
+    for (p = chunked, compressedLen = 0, chunkLen = 1; chunkLen > 0; ) {
+        char * end;
+        chunkLen = strtoul(p, &end, 16);
+        TEST(strncmp(end, "\r\n", 2) == 0);
+        p = end + 2;
+        TEST(compressedLen + chunkLen <= sizeof(compressed));
+        memcpy(&compressed[compressedLen], p, chunkLen);
+        compressedLen += chunkLen;
+        p += chunkLen + 2;
+    }
+    memset(&z, 0, sizeof(z));
+    TEST(inflateInit2(&z, 15 + 16) == Z_OK);
+    z.next_in   = compressed;
+    z.avail_in  = compressedLen;
+    z.next_out  = (unsigned char *)body;
+    z.avail_out = bodySize;
+    TEST(inflate(&z, Z_FINISH) == Z_STREAM_END);
+    *bodyLenP = z.total_out;
+    inflateEnd(&z);
+}
+
+
+
+static void
+testCompression(void) {
+/*----------------------------------------------------------------------------
+   Send a gzipped call to a server on the loopback interface and check that
+   the handler decompresses it and gzips the response.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_server_abyss_handler_parms parms;
+    struct loopbackServer ls;
+    char call[2048];
+    char response[8192];
+    char responseBody[4096];
+    size_t responseLen;
+    size_t responseBodyLen;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_global_init(&env);
+    TEST_NO_FAULT(&env);
+
+    for (i = 0, call[0] = '\0'; strlen(call) + 32 < sizeof(call); ++i)
+        strcat(call, "<value><i4>12345</i4></value>\n");
+
+    createLoopbackServer(&ls);
+
+    parms.xml_processor           = &echoXmlProcessor;
+    parms.xml_processor_arg       = NULL;
+    parms.xml_processor_max_stack = 512;
+    parms.uri_path                = "/RPC2";
+    parms.chunk_response          = false;
+    parms.allow_origin            = NULL;
+    parms.access_ctl_expires      = false;
+    parms.access_ctl_max_age      = 0;
+    parms.compress_level          = 6;
+    parms.compress_min_size       = 256;
+
+    xmlrpc_server_abyss_set_handler3(
+        &env, &ls.server, &parms, XMLRPC_AHPSIZE(compress_min_size));
+    TEST_NO_FAULT(&env);
+
+    startLoopbackServer(&ls);
+
+    postGzipped(&ls.addr, "gzip", call, strlen(call),
+                response, sizeof(response), &responseLen);
+
+    TEST(strstr(response, "HTTP/1.1 200") == response);
+    TEST(strstr(response, "Content-Encoding: gzip\r\n") != NULL);
+    TEST(strstr(response, "Vary: Accept-Encoding\r\n") != NULL);
+    TEST(strstr(response, "\r\n\r\n") != NULL);
+
+    inflateChunked(strstr(response, "\r\n\r\n") + 4,
+                   responseBody, sizeof(responseBody), &responseBodyLen);
+
+    TEST(responseBodyLen == strlen(call));
+    TEST(memcmp(responseBody, call, responseBodyLen) == 0);
+
+    postGzipped(&ls.addr, "compress", call, strlen(call),
+                response, sizeof(response), &responseLen);
+
+    TEST(strstr(response, "HTTP/1.1 415") == response);
+
+    stopLoopbackServer(&ls);
+
+    xmlrpc_server_abyss_global_term();
+
+    xmlrpc_env_clean(&env);
+}
+
+#endif
+
+
+
+#if HAVE_ABYSS_OPENSSL && !defined(_WIN32)
+
+static SSL_CTX *
+makeServerSslCtx(void) {
+/*----------------------------------------------------------------------------
+   An SSL context with a new self-signed certificate.
+-----------------------------------------------------------------------------*/
+    SSL_CTX * const sslCtxP = SSL_CTX_new(TLS_server_method());
+    EVP_PKEY * const pkeyP = EVP_EC_gen("P-256");
+    X509 * const certP = X509_new();
+
+    X509_NAME * nameP;
+
+    TEST(sslCtxP && pkeyP && certP);
+
+    ASN1_INTEGER_set(X509_get_serialNumber(certP), 1);
+    X509_gmtime_adj(X509_getm_notBefore(certP), 0);
+    X509_gmtime_adj(X509_getm_notAfter(certP), 3600);
+    X509_set_pubkey(certP, pkeyP);
+    nameP = X509_get_subject_name(certP);
+    X509_NAME_add_entry_by_txt(nameP, "CN", MBSTRING_ASC,
+                               (const unsigned char *)"localhost", -1, -1, 0);
+    X509_set_issuer_name(certP, nameP);
+    TEST(X509_sign(certP, pkeyP, EVP_sha256()));
+
+    TEST(SSL_CTX_use_certificate(sslCtxP, certP) == 1);
+    TEST(SSL_CTX_use_PrivateKey(sslCtxP, pkeyP) == 1);
+
+    X509_free(certP);
+    EVP_PKEY_free(pkeyP);
+
+    return sslCtxP;
+}
+
+
+
+static void
+runXmlrpcServer(void * const arg) {
+
+    xmlrpc_server_abyss_t * const serverP = arg;
+
+    xmlrpc_env env;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_run_server(&env, serverP);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+startTlsServer(const unsigned char *     const ticketSecret,
+               xmlrpc_registry *         const registryP,
+               SSL_CTX **                const sslCtxPP,
+               xmlrpc_server_abyss_t **  const serverPP,
+               struct xmlrpc_thread **   const serverThreadPP,
+               struct sockaddr_in *      const addrP) {
+/*----------------------------------------------------------------------------
+   Start an HTTPS server that issues session tickets made from secret
+   'ticketSecret', on a loopback port of the system's choosing.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_server_abyss_parms parms;
+    const char * error;
+    int listenFd;
+
+    xmlrpc_env_init(&env);
+
+    bindLoopback(&listenFd, addrP);
+
+    *sslCtxPP = makeServerSslCtx();
+
+    MEMSZERO(&parms);
+
+    parms.registryP             = registryP;
+    parms.socket_bound          = true;
+    parms.socket_handle         = listenFd;
+    parms.ssl_ctx_p             = *sslCtxPP;
+    parms.ssl_ticket_secret     = ticketSecret;
+    parms.ssl_ticket_secret_len = strlen((const char *)ticketSecret);
+
+    xmlrpc_server_abyss_create(&env, &parms,
+                               XMLRPC_APSIZE(ssl_ticket_secret_len),
+                               serverPP);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_thread_create(serverThreadPP, &runXmlrpcServer, *serverPP,
+                         &error);
+    TEST_NULL_STRING(error);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+tlsConnect(const struct sockaddr_in * const addrP,
+           SSL_CTX *                  const clientCtxP,
+           SSL_SESSION **             const sessionPP) {
+/*----------------------------------------------------------------------------
+   Connect to the HTTPS server at *addrP, resuming session *sessionPP if it
+   isn't NULL, send one request, and read the response.  Return the new
+   session as *sessionPP.
+-----------------------------------------------------------------------------*/
+    const char * const request =
+        "GET /x HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    int const one = 1;
+
+    SSL * sslP;
+    char response[1024];
+    int fd;
+    int rc;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST(fd >= 0);
+    TEST(connect(fd, (const struct sockaddr *)addrP, sizeof(*addrP)) == 0);
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    sslP = SSL_new(clientCtxP);
+    TEST(sslP != NULL);
+    SSL_set_fd(sslP, fd);
+    if (*sessionPP)
+        SSL_set_session(sslP, *sessionPP);
+
+    TEST(SSL_connect(sslP) == 1);
+    TEST(SSL_write(sslP, request, strlen(request)) == (int)strlen(request));
+
+    /* Read to the end, which gets the session ticket too */
+    do
+        rc = SSL_read(sslP, response, sizeof(response));
+    while (rc > 0);
+
+    if (*sessionPP)
+        SSL_SESSION_free(*sessionPP);
+    *sessionPP = SSL_get1_session(sslP);
+
+    SSL_shutdown(sslP);
+    SSL_free(sslP);
+    close(fd);
+}
+
+
+
+static void
+stopTlsServer(xmlrpc_server_abyss_t * const serverP,
+              struct xmlrpc_thread *  const serverThreadP,
+              SSL_CTX *               const sslCtxP,
+              struct sockaddr_in *    const addrP) {
+
+    xmlrpc_env env;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_terminate(&env, serverP);
+    TEST_NO_FAULT(&env);
+
+    {
+        /* The OpenSSL channel switch doesn't notice termination while it
+           waits for a connection, so give it one.
+        */
+        SSL_CTX * const clientCtxP = SSL_CTX_new(TLS_client_method());
+        SSL_SESSION * sessionP = NULL;
+
+        tlsConnect(addrP, clientCtxP, &sessionP);
+
+        SSL_SESSION_free(sessionP);
+        SSL_CTX_free(clientCtxP);
+    }
+    xmlrpc_thread_join(serverThreadP);
+
+    xmlrpc_server_abyss_destroy(serverP);
+
+    SSL_CTX_free(sslCtxP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testTlsResumption(void) {
+/*----------------------------------------------------------------------------
+   Check that a client can resume a TLS session with a session ticket, both
+   with the server that issued it and with another server that has the same
+   ticket secret, and that the servers count the handshakes.
+-----------------------------------------------------------------------------*/
+    const unsigned char * const secret =
+        (const unsigned char *)"test ticket secret";
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    SSL_CTX * clientCtxP;
+    SSL_SESSION * sessionP;
+    SSL_CTX * sslCtx1P;
+    SSL_CTX * sslCtx2P;
+    xmlrpc_server_abyss_t * server1P;
+    xmlrpc_server_abyss_t * server2P;
+    struct xmlrpc_thread * serverThread1P;
+    struct xmlrpc_thread * serverThread2P;
+    struct sockaddr_in addr1, addr2;
+    struct xmlrpc_server_abyss_tls_stats stats;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_global_init(&env);
+    TEST_NO_FAULT(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    startTlsServer(secret, registryP,
+                   &sslCtx1P, &server1P, &serverThread1P, &addr1);
+    startTlsServer(secret, registryP,
+                   &sslCtx2P, &server2P, &serverThread2P, &addr2);
+
+    clientCtxP = SSL_CTX_new(TLS_client_method());
+    TEST(clientCtxP != NULL);
+
+    sessionP = NULL;
+
+    tlsConnect(&addr1, clientCtxP, &sessionP);
+    tlsConnect(&addr1, clientCtxP, &sessionP);
+    tlsConnect(&addr2, clientCtxP, &sessionP);
+
+    xmlrpc_server_abyss_get_tls_stats(&env, server1P, &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.full_handshakes == 1);
+    TEST(stats.resumed_handshakes == 1);
+    TEST(stats.failed_handshakes == 0);
+
+    xmlrpc_server_abyss_get_tls_stats(&env, server2P, &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.full_handshakes == 0);
+    TEST(stats.resumed_handshakes == 1);
+
+    SSL_SESSION_free(sessionP);
+    SSL_CTX_free(clientCtxP);
+
+    stopTlsServer(server1P, serverThread1P, sslCtx1P, &addr1);
+    stopTlsServer(server2P, serverThread2P, sslCtx2P, &addr2);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_server_abyss_global_term();
+
+    xmlrpc_env_clean(&env);
+}
+
+#endif
+
+
+
+#if !defined(_WIN32)
+
+struct deferredCall {
+    struct xmlrpc_event * calledEventP;
+        /* Set when test.later has a call it hasn't completed */
+    xmlrpc_completion *   completionP;
+};
+
+
+
+static void
+laterMethod(xmlrpc_value *      const paramArrayP,
+            void *              const serverInfo,
+            void *              const callInfo ATTR_UNUSED,
+            xmlrpc_completion * const completionP) {
+/*----------------------------------------------------------------------------
+   An asynchronous method that returns the negative of a negative
+   parameter right away, but leaves a call with a positive parameter for
+   the test to complete.
+-----------------------------------------------------------------------------*/
+    struct deferredCall * const deferredP = serverInfo;
+
+    xmlrpc_env env;
+    xmlrpc_int32 x;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_decompose_value(&env, paramArrayP, "(i)", &x);
+    TEST_NO_FAULT(&env);
+
+    if (x < 0) {
+        xmlrpc_value * const resultP = xmlrpc_int_new(&env, -x);
+
+        xmlrpc_completion_finish(completionP, NULL, resultP);
+
+        xmlrpc_DECREF(resultP);
+    } else {
+        deferredP->completionP = completionP;
+        xmlrpc_event_set(deferredP->calledEventP);
+    }
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+formatIntCall(const char * const methodName,
+              xmlrpc_int32 const x,
+              const char * const extraHeaders,
+              char *       const request,
+              size_t       const size) {
+/*----------------------------------------------------------------------------
+   Format a call of method 'methodName' with the one integer parameter 'x',
+   in an HTTP request that keeps the connection alive.  'extraHeaders' is
+   additional header lines, each with its CRLF.
+-----------------------------------------------------------------------------*/
+    char body[256];
+
+    snprintf(body, sizeof(body),
+             "<?xml version=\"1.0\"?>\r\n"
+             "<methodCall><methodName>%s</methodName>"
+             "<params><param><value><i4>%d</i4></value></param></params>"
+             "</methodCall>\r\n", methodName, x);
+
+    snprintf(request, size,
+             "POST /RPC2 HTTP/1.1\r\n"
+             "Host: localhost\r\n"
+             "Content-Type: text/xml\r\n"
+             "%s"
+             "Content-Length: %u\r\n"
+             "\r\n"
+             "%s", extraHeaders, (unsigned int)strlen(body), body);
+}
+
+
+
+static void
+sendLaterCall(int          const fd,
+              xmlrpc_int32 const x) {
+/*----------------------------------------------------------------------------
+   Send a call of test.later, in an HTTP request that keeps the connection
+   alive.
+-----------------------------------------------------------------------------*/
+    char request[512];
+
+    formatIntCall("test.later", x, "", request, sizeof(request));
+
+    TEST(write(fd, request, strlen(request)) == (ssize_t)strlen(request));
+}
+
+
+
+static xmlrpc_int32
+readLaterResponse(int const fd) {
+/*----------------------------------------------------------------------------
+   Read one HTTP response with a Content-Length and return the integer
+   result of the XML-RPC response in it.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    char response[4096];
+    size_t len;
+    const char * body;
+    size_t contentLength;
+    xmlrpc_value * resultP;
+    xmlrpc_int32 x;
+
+    xmlrpc_env_init(&env);
+
+    for (len = 0, body = NULL, contentLength = 0;
+         !body || len < (size_t)(body - response) + contentLength; ) {
+
+        ssize_t const rc =
+            read(fd, &response[len], sizeof(response) - 1 - len);
+
+        TEST(rc > 0);
+        len += rc;
+        response[len] = '\0';
+
+        if (!body && strstr(response, "\r\n\r\n")) {
+            const char * const clField =
+                strstr(response, "Content-length:");
+
+            TEST(clField != NULL);
+            contentLength = strtoul(clField + strlen("Content-length:"),
+                                    NULL, 10);
+            body = strstr(response, "\r\n\r\n") + 4;
+        }
+    }
+    TEST(strstr(response, "HTTP/1.1 200") == response);
+
+    resultP = xmlrpc_parse_response(&env, body, contentLength);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_read_int(&env, resultP, &x);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_DECREF(resultP);
+
+    xmlrpc_env_clean(&env);
+
+    return x;
+}
+
+
+
+static void
+finishLater(void * const arg) {
+/*----------------------------------------------------------------------------
+   After a while, complete the held call of test.later with result 22.
+-----------------------------------------------------------------------------*/
+    struct deferredCall * const deferredP = arg;
+
+    xmlrpc_env env;
+    xmlrpc_value * resultP;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_millisecond_sleep(100);
+
+    resultP = xmlrpc_int_new(&env, 22);
+    xmlrpc_completion_finish(deferredP->completionP, NULL, resultP);
+    xmlrpc_DECREF(resultP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testDeferredResponse(void) {
+/*----------------------------------------------------------------------------
+   Check that an event-driven server with one worker thread serves other
+   clients while an asynchronous method holds a call, and sends the
+   response, and keeps the connection alive, when the method completes it.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct deferredCall deferred;
+    struct loopbackServer ls;
+    struct xmlrpc_thread * finisherP;
+    const char * error;
+    struct pollfd pollFd;
+    xmlrpc_value * resultP;
+    int fdA, fdB;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_global_init(&env);
+    TEST_NO_FAULT(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_event_create(&deferred.calledEventP, &error);
+    TEST_NULL_STRING(error);
+
+    xmlrpc_registry_add_method_async(&env, registryP, "test.later",
+                                     &laterMethod, "i:i", NULL, &deferred);
+    TEST_NO_FAULT(&env);
+
+    createLoopbackServer(&ls);
+
+    ServerSetEventDriven(&ls.server, true);
+    ServerSetMaxConn(&ls.server, 1);
+
+    xmlrpc_server_abyss_set_handlers2(&ls.server, "/RPC2", registryP);
+
+    startLoopbackServer(&ls);
+
+    fdA = connectLoopback(&ls.addr);
+    sendLaterCall(fdA, 21);
+    xmlrpc_event_wait(deferred.calledEventP);
+
+    /* The one worker is free for another client */
+    fdB = connectLoopback(&ls.addr);
+    sendLaterCall(fdB, -5);
+    TEST(readLaterResponse(fdB) == 5);
+
+    /* No response to the first call until the method completes it */
+    pollFd.fd     = fdA;
+    pollFd.events = POLLIN;
+    TEST(poll(&pollFd, 1, 100) == 0);
+
+    resultP = xmlrpc_int_new(&env, 42);
+    xmlrpc_completion_finish(deferred.completionP, NULL, resultP);
+    xmlrpc_DECREF(resultP);
+
+    TEST(readLaterResponse(fdA) == 42);
+
+    /* The connection is still alive */
+    sendLaterCall(fdA, -7);
+    TEST(readLaterResponse(fdA) == 7);
+
+    close(fdB);
+
+    /* Shutting down, the server waits for a held call to be completed */
+    xmlrpc_event_destroy(deferred.calledEventP);
+    xmlrpc_event_create(&deferred.calledEventP, &error);
+    TEST_NULL_STRING(error);
+
+    sendLaterCall(fdA, 22);
+    xmlrpc_event_wait(deferred.calledEventP);
+
+    xmlrpc_thread_create(&finisherP, &finishLater, &deferred, &error);
+    TEST_NULL_STRING(error);
+
+    stopLoopbackServer(&ls);
+
+    xmlrpc_thread_join(finisherP);
+
+    TEST(readLaterResponse(fdA) == 22);
+    close(fdA);
+
+    xmlrpc_event_destroy(deferred.calledEventP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_server_abyss_global_term();
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testEventDriven(void) {
+/*----------------------------------------------------------------------------
+   Check that an event-driven server serves several requests on a
+   keep-alive connection and closes the connection when it has been idle
+   for the keep-alive timeout.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct deferredCall deferred;
+    struct loopbackServer ls;
+    const char * error;
+    struct pollfd pollFd;
+    char c;
+    int fd;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_global_init(&env);
+    TEST_NO_FAULT(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_event_create(&deferred.calledEventP, &error);
+    TEST_NULL_STRING(error);
+
+    xmlrpc_registry_add_method_async(&env, registryP, "test.later",
+                                     &laterMethod, "i:i", NULL, &deferred);
+    TEST_NO_FAULT(&env);
+
+    createLoopbackServer(&ls);
+
+    ServerSetEventDriven(&ls.server, true);
+    ServerSetMaxConn(&ls.server, 1);
+    ServerSetKeepaliveTimeout(&ls.server, 1);
+    ServerSetKeepaliveMaxConn(&ls.server, 100);
+
+    xmlrpc_server_abyss_set_handlers2(&ls.server, "/RPC2", registryP);
+
+    startLoopbackServer(&ls);
+
+    fd = connectLoopback(&ls.addr);
+
+    for (i = 1; i <= 5; ++i) {
+        sendLaterCall(fd, -(xmlrpc_int32)i);
+        TEST(readLaterResponse(fd) == (xmlrpc_int32)i);
+    }
+    /* Now the server closes the idle connection within the keep-alive
+       timeout plus the reactor's scan interval.
+    */
+    pollFd.fd     = fd;
+    pollFd.events = POLLIN;
+    TEST(poll(&pollFd, 1, 5000) == 1);
+    TEST(read(fd, &c, 1) == 0);
+    close(fd);
+
+    stopLoopbackServer(&ls);
+
+    xmlrpc_event_destroy(deferred.calledEventP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_server_abyss_global_term();
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testReactorFull(void) {
+/*----------------------------------------------------------------------------
+   Check that an event-driven server whose reactor is full of idle
+   connections serves a new connection as soon as one of them leaves.
+
+   The keep-alive timeout is long, so that no idle connection leaves on
+   its own while we fill the reactor.
+-----------------------------------------------------------------------------*/
+    /* This is CONNS_PER_WORKER in reactor.c, times the one worker */
+    unsigned int const reactorCapacity = 64;
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct deferredCall deferred;
+    struct loopbackServer ls;
+    const char * error;
+    struct pollfd pollFd;
+    int idleFd[64];
+    int fd;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_global_init(&env);
+    TEST_NO_FAULT(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_event_create(&deferred.calledEventP, &error);
+    TEST_NULL_STRING(error);
+
+    xmlrpc_registry_add_method_async(&env, registryP, "test.later",
+                                     &laterMethod, "i:i", NULL, &deferred);
+    TEST_NO_FAULT(&env);
+
+    createLoopbackServer(&ls);
+
+    ServerSetEventDriven(&ls.server, true);
+    ServerSetMaxConn(&ls.server, 1);
+    ServerSetKeepaliveTimeout(&ls.server, 60);
+    ServerSetKeepaliveMaxConn(&ls.server, 100);
+
+    xmlrpc_server_abyss_set_handlers2(&ls.server, "/RPC2", registryP);
+
+    startLoopbackServer(&ls);
+
+    /* Each idle connection's request makes sure the server has taken it
+       into the reactor.
+    */
+    for (i = 0; i < reactorCapacity; ++i) {
+        idleFd[i] = connectLoopback(&ls.addr);
+        sendLaterCall(idleFd[i], -1);
+        TEST(readLaterResponse(idleFd[i]) == 1);
+    }
+    fd = connectLoopback(&ls.addr);
+    sendLaterCall(fd, -7);
+
+    /* No room for it until an idle connection leaves */
+    pollFd.fd     = fd;
+    pollFd.events = POLLIN;
+    TEST(poll(&pollFd, 1, 100) == 0);
+
+    close(idleFd[0]);
+
+    TEST(readLaterResponse(fd) == 7);
+    close(fd);
+
+    for (i = 1; i < reactorCapacity; ++i)
+        close(idleFd[i]);
+
+    stopLoopbackServer(&ls);
+
+    xmlrpc_event_destroy(deferred.calledEventP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_server_abyss_global_term();
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+readRefusal(int const fd) {
+/*----------------------------------------------------------------------------
+   Read the response with which an overloaded server refuses a connection,
+   through the end of the connection, and check it.
+-----------------------------------------------------------------------------*/
+    char response[1024];
+    size_t len;
+    ssize_t rc;
+
+    for (len = 0, rc = 1; rc > 0; ) {
+        rc = read(fd, &response[len], sizeof(response) - 1 - len);
+        TEST(rc >= 0);
+        len += rc;
+    }
+    response[len] = '\0';
+
+    TEST(strstr(response, "HTTP/1.1 503") == response);
+    TEST(strstr(response, "Retry-After: 7\r\n") != NULL);
+}
+
+
+
+static void
+testLoadShedding(void) {
+/*----------------------------------------------------------------------------
+   Check that a server with one thread refuses a connection that waited for
+   the thread longer than the shedding interval, and serves the next one,
+   which doesn't wait.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct deferredCall deferred;
+    struct loopbackServer ls;
+    const char * error;
+    xmlrpc_value * resultP;
+    int fdA, fdB, fdC;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_global_init(&env);
+    TEST_NO_FAULT(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_event_create(&deferred.calledEventP, &error);
+    TEST_NULL_STRING(error);
+
+    xmlrpc_registry_add_method_async(&env, registryP, "test.later",
+                                     &laterMethod, "i:i", NULL, &deferred);
+    TEST_NO_FAULT(&env);
+
+    createLoopbackServer(&ls);
+
+    ServerSetMaxConn(&ls.server, 1);
+    ServerSetLoadShedding(&ls.server, 20, 20, 7);
+
+    xmlrpc_server_abyss_set_handlers2(&ls.server, "/RPC2", registryP);
+
+    startLoopbackServer(&ls);
+
+    /* The first client holds the one thread */
+    fdA = connectLoopback(&ls.addr);
+    sendLaterCall(fdA, 21);
+    xmlrpc_event_wait(deferred.calledEventP);
+
+    /* The second waits for it much longer than the interval */
+    fdB = connectLoopback(&ls.addr);
+    sendLaterCall(fdB, -5);
+    xmlrpc_millisecond_sleep(200);
+
+    resultP = xmlrpc_int_new(&env, 42);
+    xmlrpc_completion_finish(deferred.completionP, NULL, resultP);
+    xmlrpc_DECREF(resultP);
+
+    TEST(readLaterResponse(fdA) == 42);
+    close(fdA);
+
+    readRefusal(fdB);
+    close(fdB);
+
+    /* The thread is free now, so the next client doesn't wait */
+    fdC = connectLoopback(&ls.addr);
+    sendLaterCall(fdC, -5);
+    TEST(readLaterResponse(fdC) == 5);
+    close(fdC);
+
+    stopLoopbackServer(&ls);
+
+    xmlrpc_event_destroy(deferred.calledEventP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_server_abyss_global_term();
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+struct watchedCall {
+    struct xmlrpc_event * startedEventP;
+        /* Set when test.watch has started */
+    struct xmlrpc_event * doneEventP;
+        /* Set when test.watch has finished */
+    bool canceledAtStart;
+    bool canceledAtEnd;
+};
+
+
+
+static xmlrpc_value *
+watchMethod(xmlrpc_env *   const envP,
+            xmlrpc_value * const paramArrayP ATTR_UNUSED,
+            void *         const serverInfo,
+            void *         const callInfo) {
+/*----------------------------------------------------------------------------
+   A method that works until its client goes away, or for 5 seconds.
+-----------------------------------------------------------------------------*/
+    struct watchedCall * const watchedP = serverInfo;
+    TSession *           const abyssSessionP = callInfo;
+
+    unsigned int i;
+
+    watchedP->canceledAtStart =
+        xmlrpc_server_abyss_get_canceled(abyssSessionP);
+
+    xmlrpc_event_set(watchedP->startedEventP);
+
+    for (i = 0; i < 500 && !xmlrpc_server_abyss_get_canceled(abyssSessionP);
+         ++i)
+        xmlrpc_millisecond_sleep(10);
+
+    watchedP->canceledAtEnd = xmlrpc_server_abyss_get_canceled(abyssSessionP);
+
+    xmlrpc_event_set(watchedP->doneEventP);
+
+    return xmlrpc_int_new(envP, 0);
+}
+
+
+
+static void
+testCanceled(void) {
+/*----------------------------------------------------------------------------
+   Check that a method sees that the call is canceled when its client
+   closes the connection while the method runs.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct watchedCall watched;
+    struct loopbackServer ls;
+    const char * error;
+    int fd;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_global_init(&env);
+    TEST_NO_FAULT(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_event_create(&watched.startedEventP, &error);
+    TEST_NULL_STRING(error);
+    xmlrpc_event_create(&watched.doneEventP, &error);
+    TEST_NULL_STRING(error);
+
+    {
+        struct xmlrpc_method_info3 methodInfo;
+
+        memset(&methodInfo, 0, sizeof(methodInfo));
+        methodInfo.methodName     = "test.watch";
+        methodInfo.methodFunction = &watchMethod;
+        methodInfo.serverInfo     = &watched;
+
+        xmlrpc_registry_add_method3(&env, registryP, &methodInfo);
+        TEST_NO_FAULT(&env);
+    }
+    createLoopbackServer(&ls);
+
+    xmlrpc_server_abyss_set_handlers2(&ls.server, "/RPC2", registryP);
+
+    startLoopbackServer(&ls);
+
+    {
+        static const char * const body =
+            "<?xml version=\"1.0\"?>\r\n"
+            "<methodCall><methodName>test.watch</methodName>"
+            "<params/></methodCall>\r\n";
+
+        char request[512];
+
+        snprintf(request, sizeof(request),
+                 "POST /RPC2 HTTP/1.1\r\n"
+                 "Host: localhost\r\n"
+                 "Content-Type: text/xml\r\n"
+                 "Content-Length: %u\r\n"
+                 "\r\n"
+                 "%s", (unsigned int)strlen(body), body);
+
+        fd = connectLoopback(&ls.addr);
+
+        TEST(write(fd, request, strlen(request)) ==
+             (ssize_t)strlen(request));
+    }
+    xmlrpc_event_wait(watched.startedEventP);
+
+    close(fd);
+
+    xmlrpc_event_wait(watched.doneEventP);
+
+    TEST(!watched.canceledAtStart);
+    TEST(watched.canceledAtEnd);
+
+    stopLoopbackServer(&ls);
+
+    xmlrpc_event_destroy(watched.doneEventP);
+    xmlrpc_event_destroy(watched.startedEventP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_server_abyss_global_term();
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static xmlrpc_value *
+timeLeftMethod(xmlrpc_env *   const envP,
+               xmlrpc_value * const paramArrayP ATTR_UNUSED,
+               void *         const serverInfo ATTR_UNUSED,
+               void *         const callInfo) {
+/*----------------------------------------------------------------------------
+   A method that returns how many milliseconds its client will still wait
+   for the response, or -1 if the client didn't say.
+-----------------------------------------------------------------------------*/
+    TSession * const abyssSessionP = callInfo;
+
+    unsigned int msLeft;
+
+    if (!xmlrpc_server_abyss_get_time_left(abyssSessionP, &msLeft))
+        msLeft = (unsigned int)-1;
+
+    return xmlrpc_int_new(envP, (xmlrpc_int32)msLeft);
+}
+
+
+
+static void
+testTimeLeft(void) {
+/*----------------------------------------------------------------------------
+   Check that a method sees the time its client said it would wait for the
+   response, less the time the call has taken so far, and sees that there
+   is no limit when the client didn't say.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct loopbackServer ls;
+    char request[512];
+    xmlrpc_int32 msLeft;
+    int fd;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_global_init(&env);
+    TEST_NO_FAULT(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    {
+        struct xmlrpc_method_info3 methodInfo;
+
+        memset(&methodInfo, 0, sizeof(methodInfo));
+        methodInfo.methodName     = "test.timeLeft";
+        methodInfo.methodFunction = &timeLeftMethod;
+
+        xmlrpc_registry_add_method3(&env, registryP, &methodInfo);
+        TEST_NO_FAULT(&env);
+    }
+    createLoopbackServer(&ls);
+
+    xmlrpc_server_abyss_set_handlers2(&ls.server, "/RPC2", registryP);
+
+    startLoopbackServer(&ls);
+
+    fd = connectLoopback(&ls.addr);
+
+    formatIntCall("test.timeLeft", 0, "X-Xmlrpc-Timeout: 60000\r\n",
+                  request, sizeof(request));
+    TEST(write(fd, request, strlen(request)) == (ssize_t)strlen(request));
+    msLeft = readLaterResponse(fd);
+    TEST(msLeft > 0 && msLeft <= 60000);
+
+    formatIntCall("test.timeLeft", 0, "", request, sizeof(request));
+    TEST(write(fd, request, strlen(request)) == (ssize_t)strlen(request));
+    TEST(readLaterResponse(fd) == -1);
+
+    close(fd);
+
+    stopLoopbackServer(&ls);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_server_abyss_global_term();
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testExpiredTimeout(void) {
+/*----------------------------------------------------------------------------
+   Check that a server doesn't execute a call whose client's timeout
+   expired while the call waited for a server thread, but answers it
+   with 408 (Request Timeout).
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct deferredCall deferred;
+    struct loopbackServer ls;
+    const char * error;
+    xmlrpc_value * resultP;
+    char request[512];
+    char response[1024];
+    size_t len;
+    ssize_t rc;
+    int fdA, fdB;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_global_init(&env);
+    TEST_NO_FAULT(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_event_create(&deferred.calledEventP, &error);
+    TEST_NULL_STRING(error);
+
+    xmlrpc_registry_add_method_async(&env, registryP, "test.later",
+                                     &laterMethod, "i:i", NULL, &deferred);
+    TEST_NO_FAULT(&env);
+
+    createLoopbackServer(&ls);
+
+    ServerSetMaxConn(&ls.server, 1);
+
+    xmlrpc_server_abyss_set_handlers2(&ls.server, "/RPC2", registryP);
+
+    startLoopbackServer(&ls);
+
+    /* The first client holds the one thread while the second one's
+       one-millisecond timeout expires.
+    */
+    fdA = connectLoopback(&ls.addr);
+    sendLaterCall(fdA, 21);
+    xmlrpc_event_wait(deferred.calledEventP);
+
+    fdB = connectLoopback(&ls.addr);
+    formatIntCall("test.later", -5, "X-Xmlrpc-Timeout: 1\r\n",
+                  request, sizeof(request));
+    TEST(write(fdB, request, strlen(request)) == (ssize_t)strlen(request));
+    TEST(shutdown(fdB, SHUT_WR) == 0);
+    xmlrpc_millisecond_sleep(50);
+
+    resultP = xmlrpc_int_new(&env, 42);
+    xmlrpc_completion_finish(deferred.completionP, NULL, resultP);
+    xmlrpc_DECREF(resultP);
+
+    TEST(readLaterResponse(fdA) == 42);
+    close(fdA);
+
+    /* Had the server executed the call, it would have answered 200 */
+    for (len = 0, rc = 1; rc > 0; ) {
+        rc = read(fdB, &response[len], sizeof(response) - 1 - len);
+        TEST(rc >= 0);
+        len += rc;
+    }
+    response[len] = '\0';
+
+    TEST(strstr(response, "HTTP/1.1 408") == response);
+    close(fdB);
+
+    stopLoopbackServer(&ls);
+
+    xmlrpc_event_destroy(deferred.calledEventP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_server_abyss_global_term();
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testHalfClosed(void) {
+/*----------------------------------------------------------------------------
+   Check that a server executes and answers a call whose client shut down
+   its sending side right after sending the call.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct deferredCall deferred;
+    struct loopbackServer ls;
+    const char * error;
+    xmlrpc_value * resultP;
+    int fdA, fdB;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_global_init(&env);
+    TEST_NO_FAULT(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_event_create(&deferred.calledEventP, &error);
+    TEST_NULL_STRING(error);
+
+    xmlrpc_registry_add_method_async(&env, registryP, "test.later",
+                                     &laterMethod, "i:i", NULL, &deferred);
+    TEST_NO_FAULT(&env);
+
+    createLoopbackServer(&ls);
+
+    ServerSetMaxConn(&ls.server, 1);
+
+    xmlrpc_server_abyss_set_handlers2(&ls.server, "/RPC2", registryP);
+
+    startLoopbackServer(&ls);
+
+    /* The first client holds the one thread, so that the server gets to
+       the second one's call only after the second one has shut down.
+    */
+    fdA = connectLoopback(&ls.addr);
+    sendLaterCall(fdA, 21);
+    xmlrpc_event_wait(deferred.calledEventP);
+
+    fdB = connectLoopback(&ls.addr);
+    sendLaterCall(fdB, -5);
+    TEST(shutdown(fdB, SHUT_WR) == 0);
+    xmlrpc_millisecond_sleep(50);
+
+    resultP = xmlrpc_int_new(&env, 42);
+    xmlrpc_completion_finish(deferred.completionP, NULL, resultP);
+    xmlrpc_DECREF(resultP);
+
+    TEST(readLaterResponse(fdA) == 42);
+    close(fdA);
+
+    TEST(readLaterResponse(fdB) == 5);
+    close(fdB);
+
+    stopLoopbackServer(&ls);
+
+    xmlrpc_event_destroy(deferred.calledEventP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_server_abyss_global_term();
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+#define CONCURRENT_CLIENT_CT 8
+
+static void
+callLaterConcurrently(const struct sockaddr_in * const addrP) {
+/*----------------------------------------------------------------------------
+   Have CONCURRENT_CLIENT_CT clients connect and send their calls of
+   test.later all at once, then read the responses in order, each client
+   closing its connection after its response.
+
+   A server thread that has answered a client holds the connection for the
+   client's next request, so the server gets to later clients only as
+   earlier ones close.
+-----------------------------------------------------------------------------*/
+    int fd[CONCURRENT_CLIENT_CT];
+    unsigned int i;
+
+    for (i = 0; i < CONCURRENT_CLIENT_CT; ++i) {
+        fd[i] = connectLoopback(addrP);
+        sendLaterCall(fd[i], -(xmlrpc_int32)(i + 1));
+    }
+    for (i = 0; i < CONCURRENT_CLIENT_CT; ++i) {
+        TEST(readLaterResponse(fd[i]) == (xmlrpc_int32)(i + 1));
+        close(fd[i]);
+    }
+}
+
+
+
+static void
+testConnPool(void) {
+/*----------------------------------------------------------------------------
+   Check that a server serves more concurrent clients than its connection
+   pool has threads and its queue has room for.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct deferredCall deferred;
+    struct loopbackServer ls;
+    const char * error;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_global_init(&env);
+    TEST_NO_FAULT(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_event_create(&deferred.calledEventP, &error);
+    TEST_NULL_STRING(error);
+
+    xmlrpc_registry_add_method_async(&env, registryP, "test.later",
+                                     &laterMethod, "i:i", NULL, &deferred);
+    TEST_NO_FAULT(&env);
+
+    createLoopbackServer(&ls);
+
+    ServerSetMaxConn(&ls.server, 2);
+    ServerSetConnQueueDepth(&ls.server, 2);
+
+    xmlrpc_server_abyss_set_handlers2(&ls.server, "/RPC2", registryP);
+
+    startLoopbackServer(&ls);
+
+    callLaterConcurrently(&ls.addr);
+
+    stopLoopbackServer(&ls);
+
+    xmlrpc_event_destroy(deferred.calledEventP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_server_abyss_global_term();
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testAcceptors(void) {
+/*----------------------------------------------------------------------------
+   Check that a server with several acceptors, each with its own listening
+   socket at the same address and a single thread, serves concurrent
+   clients.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct deferredCall deferred;
+    struct loopbackServer ls;
+    struct sockaddr_in bindAddr;
+    struct sockaddr * listenAddrP;
+    size_t listenAddrLen;
+    const char * error;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_global_init(&env);
+    TEST_NO_FAULT(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_event_create(&deferred.calledEventP, &error);
+    TEST_NULL_STRING(error);
+
+    xmlrpc_registry_add_method_async(&env, registryP, "test.later",
+                                     &laterMethod, "i:i", NULL, &deferred);
+    TEST_NO_FAULT(&env);
+
+    /* The acceptors' listening sockets can share the address only if the
+       one we supply allows it.
+    */
+    memset(&bindAddr, 0, sizeof(bindAddr));
+    bindAddr.sin_family      = AF_INET;
+    bindAddr.sin_port        = 0;
+    bindAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    ChanSwitchUnixCreateReusePort(PF_INET, (const struct sockaddr *)&bindAddr,
+                                  sizeof(bindAddr), &ls.chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+
+    ServerCreateSwitch(&ls.server, ls.chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+
+    ServerSetAcceptorCount(&ls.server, 3);
+    ServerSetMaxConn(&ls.server, 1);
+
+    xmlrpc_server_abyss_set_handlers2(&ls.server, "/RPC2", registryP);
+
+    startLoopbackServer(&ls);
+
+    ChanSwitchUnixGetListenName(ls.chanSwitchP, &listenAddrP, &listenAddrLen,
+                                &error);
+    TEST_NULL_STRING(error);
+    TEST(listenAddrLen == sizeof(ls.addr));
+    memcpy(&ls.addr, listenAddrP, sizeof(ls.addr));
+    free(listenAddrP);
+
+    callLaterConcurrently(&ls.addr);
+
+    stopLoopbackServer(&ls);
+
+    xmlrpc_event_destroy(deferred.calledEventP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_server_abyss_global_term();
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static xmlrpc_value *
+negateMethod(xmlrpc_env *   const envP,
+             xmlrpc_value * const paramArrayP,
+             void *         const serverInfo ATTR_UNUSED) {
+/*----------------------------------------------------------------------------
+   A method that returns the negative of its parameter.
+
+   It doesn't use TEST, because it runs in pre-forked worker processes,
+   where a test result would never get counted.
+-----------------------------------------------------------------------------*/
+    xmlrpc_int32 x;
+    xmlrpc_value * retvalP;
+
+    xmlrpc_decompose_value(envP, paramArrayP, "(i)", &x);
+
+    if (envP->fault_occurred)
+        retvalP = NULL;
+    else
+        retvalP = xmlrpc_int_new(envP, -x);
+
+    return retvalP;
+}
+
+
+
+static bool
+callNegate(const struct sockaddr_in * const addrP,
+           xmlrpc_int32               const x,
+           xmlrpc_int32 *             const resultP) {
+/*----------------------------------------------------------------------------
+   Call test.negate on a connection of its own and return its result as
+   *resultP.  Return false if we don't get a proper response.
+
+   We don't use TEST here, because a pre-forked worker process forked
+   while we have unflushed test output would print that output again
+   when it exits.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    char request[512];
+    char response[4096];
+    size_t len;
+    bool eof;
+    bool success;
+    int fd;
+
+    xmlrpc_env_init(&env);
+
+    formatIntCall("test.negate", x, "", request, sizeof(request));
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    success = false;
+
+    if (fd >= 0) {
+        if (connect(fd, (const struct sockaddr *)addrP, sizeof(*addrP)) == 0 &&
+            write(fd, request, strlen(request)) == (ssize_t)strlen(request) &&
+            shutdown(fd, SHUT_WR) == 0) {
+
+            for (len = 0, eof = false; !eof && len < sizeof(response) - 1; ) {
+                ssize_t const rc =
+                    read(fd, &response[len], sizeof(response) - 1 - len);
+
+                if (rc <= 0)
+                    eof = true;
+                else
+                    len += rc;
+            }
+            response[len] = '\0';
+
+            if (strstr(response, "HTTP/1.1 200") == response) {
+                const char * const body = strstr(response, "\r\n\r\n");
+
+                if (body) {
+                    xmlrpc_value * const resultValP =
+                        xmlrpc_parse_response(
+                            &env, body + 4, len - (body + 4 - response));
+
+                    if (!env.fault_occurred) {
+                        xmlrpc_read_int(&env, resultValP, resultP);
+
+                        success = !env.fault_occurred;
+
+                        xmlrpc_DECREF(resultValP);
+                    }
+                }
+            }
+        }
+        close(fd);
+    }
+    xmlrpc_env_clean(&env);
+
+    return success;
+}
+
+
+
+#define PREFORK_CALL_CT 10
+
+static void
+testPrefork(void) {
+/*----------------------------------------------------------------------------
+   Check that a pre-forked server whose workers retire after a couple of
+   requests answers every one of many more requests than that, as the
+   master replaces the retired workers.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct loopbackServer ls;
+    const char * error;
+    const char * threadError;
+    bool answered[PREFORK_CALL_CT];
+    xmlrpc_int32 result[PREFORK_CALL_CT];
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_global_init(&env);
+    TEST_NO_FAULT(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_add_method(&env, registryP, NULL, "test.negate",
+                               &negateMethod, NULL);
+    TEST_NO_FAULT(&env);
+
+    createLoopbackServer(&ls);
+
+    ServerSetPrefork(&ls.server, 1, 2, 2);
+
+    xmlrpc_server_abyss_set_handlers2(&ls.server, "/RPC2", registryP);
+
+    ServerInit2(&ls.server, &error);
+    TEST_NULL_STRING(error);
+
+    /* Workers get a copy of our stdio buffers, so we don't produce test
+       output until they are gone; see callNegate().
+    */
+    fflush(stdout);
+
+    xmlrpc_thread_create(&ls.threadP, &runServer, &ls.server, &threadError);
+
+    if (!threadError) {
+        for (i = 0; i < PREFORK_CALL_CT; ++i)
+            answered[i] = callNegate(&ls.addr, i, &result[i]);
+
+        stopLoopbackServer(&ls);
+
+        for (i = 0; i < PREFORK_CALL_CT; ++i) {
+            TEST(answered[i]);
+            if (answered[i])
+                TEST(result[i] == -(xmlrpc_int32)i);
+        }
+    }
+    TEST_NULL_STRING(threadError);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_server_abyss_global_term();
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+#define LOG_THREAD_CT 4
+#define LOG_LINE_CT 500
+
+struct logWriter {
+    TServer *    serverP;
+    unsigned int id;
+};
+
+
+
+static void
+writeLogLines(void * const arg) {
+
+    struct logWriter * const writerP = arg;
+
+    unsigned int i;
+
+    for (i = 0; i < LOG_LINE_CT; ++i) {
+        char line[64];
+
+        sprintf(line, "thread %u line %u", writerP->id, i);
+
+        LogWrite(writerP->serverP, line);
+    }
+}
+
+
+
+static void
+testBufferedLog1(bool            const dropWhenFull,
+                 unsigned int *  const lineCtP,
+                 unsigned long * const droppedCtP) {
+/*----------------------------------------------------------------------------
+   Have several threads log lines through a server that buffers its log
+   file in buffers too small to hold them all, free the server, and check
+   the log file.  Return the number of lines in it as *lineCtP and the
+   number the server says it dropped as *droppedCtP.
+-----------------------------------------------------------------------------*/
+    char logFileName[] = "/tmp/xmlrpc_test_bufferedlogXXXXXX";
+
+    TServer server;
+    struct logWriter writer[LOG_THREAD_CT];
+    struct xmlrpc_thread * threadP[LOG_THREAD_CT];
+    unsigned int nextLine[LOG_THREAD_CT];
+    char line[64];
+    FILE * fileP;
+    unsigned int i;
+    int fd;
+
+    fd = mkstemp(logFileName);
+    TEST(fd >= 0);
+    close(fd);
+
+    ServerCreate(&server, "testserver", 0, NULL, logFileName);
+
+    ServerSetLogBuffer(&server, 256, dropWhenFull);
+
+    for (i = 0; i < LOG_THREAD_CT; ++i) {
+        const char * error;
+
+        writer[i].serverP = &server;
+        writer[i].id      = i;
+
+        xmlrpc_thread_create(&threadP[i], &writeLogLines, &writer[i], &error);
+        TEST_NULL_STRING(error);
+    }
+    for (i = 0; i < LOG_THREAD_CT; ++i)
+        xmlrpc_thread_join(threadP[i]);
+
+    *droppedCtP = ServerGetLogDroppedCt(&server);
+
+    /* This writes what the threads still have buffered */
+    ServerFree(&server);
+
+    fileP = fopen(logFileName, "r");
+    TEST(fileP != NULL);
+
+    for (i = 0; i < LOG_THREAD_CT; ++i)
+        nextLine[i] = 0;
+
+    *lineCtP = 0;
+
+    while (fgets(line, sizeof(line), fileP)) {
+        unsigned int id, lineNum;
+
+        TEST(sscanf(line, "thread %u line %u\n", &id, &lineNum) == 2);
+        TEST(line[strlen(line)-1] == '\n');
+        TEST(id < LOG_THREAD_CT);
+        /* A thread's lines are in order; dropped ones are just missing */
+        if (dropWhenFull)
+            TEST(lineNum >= nextLine[id]);
+        else
+            TEST(lineNum == nextLine[id]);
+        nextLine[id] = lineNum + 1;
+        ++*lineCtP;
+    }
+    fclose(fileP);
+    unlink(logFileName);
+}
+
+
+
+static void
+testBufferedLog(void) {
+
+    unsigned int lineCt;
+    unsigned long droppedCt;
+
+    testBufferedLog1(false, &lineCt, &droppedCt);
+    TEST(lineCt == LOG_THREAD_CT * LOG_LINE_CT);
+    TEST(droppedCt == 0);
+
+    /* Every line is either in the file or counted as dropped */
+    testBufferedLog1(true, &lineCt, &droppedCt);
+    TEST(lineCt > 0);
+    TEST(lineCt + droppedCt == LOG_THREAD_CT * LOG_LINE_CT);
+}
+
+#endif
+
+
+
+void
+test_server_abyss(void) {
+
+    TServer abyssServer;
+
+    printf("Running Abyss XML-RPC server tests...\n");
+
+    ServerCreate(&abyssServer, "testserver", 8080, NULL, NULL);
+    
+    testSetHandlers(&abyssServer);
+
+    ServerSetMaxConn(&abyssServer, 10);
+    ServerSetMaxConnBacklog(&abyssServer, 10);
+    ServerSetMaxSessionMem(&abyssServer, 64*1024);
+    ServerSetKeepaliveTimeout(&abyssServer, 60);
+    ServerSetKeepaliveMaxConn(&abyssServer, 10);
+    ServerSetTimeout(&abyssServer, 0);
+    ServerSetAdvertise(&abyssServer, false);
+    ServerSetEventDriven(&abyssServer, true);
+    ServerSetConnQueueDepth(&abyssServer, 20);
+    ServerSetAcceptorCount(&abyssServer, 4);
+    ServerSetAcceptorAffinity(&abyssServer, true);
+    ServerSetPrefork(&abyssServer, 2, 8, 1000);
+    ServerSetLoadShedding(&abyssServer, 5, 100, 1);
+    ServerSetLogBuffer(&abyssServer, 4096, false);
+
+    ServerFree(&abyssServer);
+
+    testServerParms();
+
+    testObject();
+
+#if HAVE_ZLIB_H && !defined(_WIN32)
+    testCompression();
+#endif
+
+#if HAVE_ABYSS_OPENSSL && !defined(_WIN32)
+    testTlsResumption();
+#endif
+
+#if !defined(_WIN32)
+    testDeferredResponse();
+    testEventDriven();
+    testReactorFull();
+    testLoadShedding();
+    testCanceled();
+    testTimeLeft();
+    testExpiredTimeout();
+    testHalfClosed();
+    testConnPool();
+    testAcceptors();
+    testPrefork();
+    testBufferedLog();
+#endif
 
     printf("\n");
     printf("Abyss XML-RPC server tests done.\n");
@@ -2002,6 +2002,60 @@ test_struct (void) {
 
 
 
+static void
+test_value_compare(void) {
+
+    xmlrpc_env env;
+    xmlrpc_value * v1P;
+    xmlrpc_value * v2P;
+    xmlrpc_value * v3P;
+
+    xmlrpc_env_init(&env);
+
+    /* Structs are equal regardless of member order */
+    v1P = xmlrpc_build_value(&env, "({s:i,s:s}d)",
+                             "a", 1, "b", "two", 3.0);
+    TEST_NO_FAULT(&env);
+    v2P = xmlrpc_build_value(&env, "({s:s,s:i}d)",
+                             "b", "two", "a", 1, 3.0);
+    TEST_NO_FAULT(&env);
+    v3P = xmlrpc_build_value(&env, "({s:i,s:s}d)",
+                             "a", 1, "b", "twO", 3.0);
+    TEST_NO_FAULT(&env);
+
+    TEST(xmlrpc_value_equal(v1P, v1P));
+    TEST(xmlrpc_value_equal(v1P, v2P));
+    TEST(xmlrpc_value_hash(v1P) == xmlrpc_value_hash(v2P));
+    TEST(!xmlrpc_value_equal(v1P, v3P));
+
+    xmlrpc_DECREF(v3P);
+    xmlrpc_DECREF(v2P);
+    xmlrpc_DECREF(v1P);
+
+    /* Same number, different type */
+    v1P = xmlrpc_int_new(&env, 7);
+    v2P = xmlrpc_i8_new(&env, 7);
+    TEST(!xmlrpc_value_equal(v1P, v2P));
+    xmlrpc_DECREF(v2P);
+    xmlrpc_DECREF(v1P);
+
+    /* Byte strings, including NULs */
+    v1P = xmlrpc_base64_new(&env, 3, (const unsigned char *)"a\0b");
+    v2P = xmlrpc_base64_new(&env, 3, (const unsigned char *)"a\0b");
+    v3P = xmlrpc_base64_new(&env, 3, (const unsigned char *)"a\0c");
+    TEST_NO_FAULT(&env);
+    TEST(xmlrpc_value_equal(v1P, v2P));
+    TEST(xmlrpc_value_hash(v1P) == xmlrpc_value_hash(v2P));
+    TEST(!xmlrpc_value_equal(v1P, v3P));
+    xmlrpc_DECREF(v3P);
+    xmlrpc_DECREF(v2P);
+    xmlrpc_DECREF(v1P);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
 void 
 test_value(void) {
 
@@ -2036,6 +2090,7 @@ test_value(void) {
     test_value_missing_struct_delim();
     test_value_invalid_struct();
     test_value_parse_value();
+    test_value_compare();
     test_struct();
 
     printf("\n");